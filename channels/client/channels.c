@@ -610,6 +610,13 @@ static UINT32 FREERDP_CC MyVirtualChannelWrite(UINT32 openHandle, void* pData, U
 
 	InterlockedPushEntrySList(channels->pSyncDataList, &(item->ItemEntry));
 
+	/* channel tests drive the channels without a context */
+	if (channels->instance->context != NULL)
+	{
+		METRICS_RECORD(channels->instance->context->metrics, METRICS_CHANNEL_QUEUE_DEPTH,
+				QueryDepthSList(channels->pSyncDataList));
+	}
+
 	/* set the event */
 	wait_obj_set(channels->signal);
 
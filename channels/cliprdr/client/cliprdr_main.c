@@ -266,6 +266,20 @@ static void cliprdr_process_event(rdpSvcPlugin* plugin, RDP_EVENT* event)
 	freerdp_event_free(event);
 }
 
+/**
+ * Messages too large to be reassembled are almost always format data
+ * responses: fail the pending request instead of leaving it unanswered.
+ */
+static void cliprdr_process_drop(rdpSvcPlugin* plugin, UINT32 length)
+{
+	RDP_EVENT* event;
+
+	DEBUG_WARN("discarded %d byte message", length);
+
+	event = freerdp_event_new(RDP_EVENT_CLASS_CLIPRDR, RDP_EVENT_TYPE_CB_DATA_RESPONSE, NULL, NULL);
+	svc_plugin_send_event(plugin, event);
+}
+
 static void cliprdr_process_terminate(rdpSvcPlugin* plugin)
 {
 	free(plugin);
@@ -289,10 +303,13 @@ const int VirtualChannelEntry(PCHANNEL_ENTRY_POINTS pEntryPoints)
 
 	strcpy(_p->plugin.channel_def.name, "cliprdr");
 
+	_p->plugin.max_data_length = CLIPRDR_MAX_DATA_LENGTH;
+
 	_p->plugin.connect_callback = cliprdr_process_connect;
 	_p->plugin.receive_callback = cliprdr_process_receive;
 	_p->plugin.event_callback = cliprdr_process_event;
 	_p->plugin.terminate_callback = cliprdr_process_terminate;
+	_p->plugin.drop_callback = cliprdr_process_drop;
 
 	svc_plugin_init((rdpSvcPlugin*) _p, pEntryPoints);
 
@@ -45,6 +45,9 @@ struct cliprdr_plugin
 };
 typedef struct cliprdr_plugin cliprdrPlugin;
 
+/* format data responses carry whole clipboard contents */
+#define CLIPRDR_MAX_DATA_LENGTH		(512 * 1024 * 1024)
+
 STREAM* cliprdr_packet_new(UINT16 msgType, UINT16 msgFlags, UINT32 dataLen);
 void cliprdr_packet_send(cliprdrPlugin* cliprdr, STREAM* data_out);
 
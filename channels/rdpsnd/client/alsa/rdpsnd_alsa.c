@@ -279,7 +279,6 @@ static BOOL rdpsnd_alsa_format_supported(rdpsndDevicePlugin* device, rdpsndForma
 			break;
 
 		case 2: /* MS ADPCM */
-		case 0x11: /* IMA ADPCM */
 			if (format->nSamplesPerSec <= 48000 &&
 				format->wBitsPerSample == 4 &&
 				(format->nChannels == 1 || format->nChannels == 2))
@@ -287,6 +286,15 @@ static BOOL rdpsnd_alsa_format_supported(rdpsndDevicePlugin* device, rdpsndForma
 				return TRUE;
 			}
 			break;
+
+		case 0x11: /* IMA ADPCM */
+			if (format->nSamplesPerSec <= 48000 &&
+				format->wBitsPerSample == 4 &&
+				freerdp_dsp_ima_adpcm_block_size_valid(format->nChannels, format->nBlockAlign))
+			{
+				return TRUE;
+			}
+			break;
 	}
 	return FALSE;
 }
@@ -396,7 +396,6 @@ static BOOL rdpsnd_pulse_format_supported(rdpsndDevicePlugin* device, rdpsndForm
 			break;
 
 		case 2: /* MS ADPCM */
-		case 0x11: /* IMA ADPCM */
 			if ((format->nSamplesPerSec <= PA_RATE_MAX) &&
 				(format->wBitsPerSample == 4) &&
 				(format->nChannels == 1 || format->nChannels == 2))
@@ -404,6 +403,15 @@ static BOOL rdpsnd_pulse_format_supported(rdpsndDevicePlugin* device, rdpsndForm
 				return TRUE;
 			}
 			break;
+
+		case 0x11: /* IMA ADPCM */
+			if ((format->nSamplesPerSec <= PA_RATE_MAX) &&
+				(format->wBitsPerSample == 4) &&
+				freerdp_dsp_ima_adpcm_block_size_valid(format->nChannels, format->nBlockAlign))
+			{
+				return TRUE;
+			}
+			break;
 	}
 	return FALSE;
 }
@@ -29,12 +29,30 @@
 
 #include <freerdp/utils/stream.h>
 #include <freerdp/utils/memory.h>
+#include <freerdp/utils/time.h>
 #include <freerdp/utils/dsp.h>
 #include <freerdp/utils/thread.h>
 #include <freerdp/utils/wait_obj.h>
 #include <freerdp/channels/wtsvc.h>
 #include <freerdp/server/rdpsnd.h>
 
+/* shortest packet sent, before the measured jitter is taken into account */
+#define RDPSND_MIN_PACKET_DURATION	20
+
+/* default for max_latency, on top of the client's own playback delay */
+#define RDPSND_DEFAULT_MAX_LATENCY	200
+
+/* a block not confirmed in time is assumed lost and no longer waited for */
+#define RDPSND_BLOCK_TIMEOUT		2000
+
+struct _rdpsnd_block
+{
+	BOOL pending;
+	UINT32 sent_time;
+	UINT16 wTimeStamp;
+};
+typedef struct _rdpsnd_block rdpsnd_block;
+
 typedef struct _rdpsnd_server
 {
 	rdpsnd_server_context context;
@@ -48,6 +66,15 @@ typedef struct _rdpsnd_server
 	int out_buffer_size;
 	int out_frames;
 	int out_pending_frames;
+	int max_out_frames;
+	int frame_unit;
+
+	/* PCM in the client format waiting for a whole ADPCM block */
+	BYTE* enc_buffer;
+	int enc_buffer_size;
+	int enc_pending_size;
+
+	rdpsnd_block blocks[256];
 
 	UINT32 src_bytes_per_sample;
 	UINT32 src_bytes_per_frame;
@@ -159,6 +186,72 @@ static BOOL rdpsnd_server_recv_formats(rdpsnd_server* rdpsnd, STREAM* s)
 	return TRUE;
 }
 
+/**
+ * The confirm round trip includes the time the client held the block before
+ * playing it, which it reports back by adding it to wTimeStamp. Latency and
+ * jitter are smoothed like TCP's SRTT and RTTVAR.
+ */
+static BOOL rdpsnd_server_recv_wave_confirm(rdpsnd_server* rdpsnd, STREAM* s)
+{
+	int i;
+	INT32 rtt;
+	INT32 delta;
+	UINT32 now;
+	UINT16 wTimeStamp;
+	BYTE cConfirmedBlockNo;
+	rdpsnd_block* block;
+	rdpsnd_server_context* context = &rdpsnd->context;
+
+	if (stream_get_left(s) < 4)
+		return FALSE;
+
+	stream_read_UINT16(s, wTimeStamp);
+	stream_read_BYTE(s, cConfirmedBlockNo);
+	stream_seek_BYTE(s); /* bPad */
+
+	now = freerdp_get_tick_count();
+
+	freerdp_thread_lock(rdpsnd->rdpsnd_channel_thread);
+
+	block = &rdpsnd->blocks[cConfirmedBlockNo];
+
+	if (block->pending)
+	{
+		rtt = (INT32) (now - block->sent_time);
+
+		if (context->confirmed_blocks == 0)
+		{
+			context->latency = rtt;
+			context->jitter = rtt / 2;
+		}
+		else
+		{
+			delta = rtt - (INT32) context->latency;
+			context->latency = (INT32) context->latency + delta / 8;
+			context->jitter = (INT32) context->jitter + ((delta < 0 ? -delta : delta) - (INT32) context->jitter) / 4;
+		}
+
+		context->client_delay = (UINT16) (wTimeStamp - block->wTimeStamp);
+
+		if (context->client_delay > (UINT32) rtt)
+			context->client_delay = rtt;
+
+		context->confirmed_blocks++;
+
+		/* blocks are played in order, older ones still pending will not be confirmed anymore */
+		for (i = 0; i < 256 && block->pending; i++)
+		{
+			block->pending = FALSE;
+			cConfirmedBlockNo--;
+			block = &rdpsnd->blocks[cConfirmedBlockNo];
+		}
+	}
+
+	freerdp_thread_unlock(rdpsnd->rdpsnd_channel_thread);
+
+	return TRUE;
+}
+
 static void* rdpsnd_server_thread_func(void* arg)
 {
 	void* fd;
@@ -218,6 +311,9 @@ static void* rdpsnd_server_thread_func(void* arg)
 					IFCALL(rdpsnd->context.Activated, &rdpsnd->context);
 				}
 				break;
+			case SNDC_WAVECONFIRM:
+				rdpsnd_server_recv_wave_confirm(rdpsnd, s);
+				break;
 			default:
 				break;
 		}
@@ -249,9 +345,71 @@ static BOOL rdpsnd_server_initialize(rdpsnd_server_context* context)
 	}
 }
 
+/**
+ * Packets are sized from the measured jitter: the steadier the client confirms,
+ * the less audio waits in out_buffer before going out. Encoded formats are kept
+ * to whole ADPCM blocks (frame_unit), and out_buffer bounds the packet size.
+ */
+static int rdpsnd_server_packet_frames(rdpsnd_server* rdpsnd)
+{
+	int frames;
+	UINT32 duration;
+
+	duration = RDPSND_MIN_PACKET_DURATION + 2 * rdpsnd->context.jitter;
+	frames = duration * rdpsnd->context.src_format.nSamplesPerSec / 1000;
+	frames = ((frames + rdpsnd->frame_unit - 1) / rdpsnd->frame_unit) * rdpsnd->frame_unit;
+
+	if (frames > rdpsnd->max_out_frames)
+		frames = rdpsnd->max_out_frames;
+
+	if (frames < rdpsnd->frame_unit)
+		frames = rdpsnd->frame_unit;
+
+	return frames;
+}
+
+/**
+ * The client is considered congested when a block is still unconfirmed well
+ * after it should have been played. Blocks that are never confirmed expire.
+ */
+static BOOL rdpsnd_server_is_congested(rdpsnd_server* rdpsnd, UINT32 now)
+{
+	int i;
+	UINT32 age;
+	UINT32 max_age;
+	BOOL congested = FALSE;
+	rdpsnd_block* block;
+
+	max_age = rdpsnd->context.max_latency ? rdpsnd->context.max_latency : RDPSND_DEFAULT_MAX_LATENCY;
+	max_age += rdpsnd->context.client_delay;
+
+	freerdp_thread_lock(rdpsnd->rdpsnd_channel_thread);
+
+	for (i = 0; i < 256; i++)
+	{
+		block = &rdpsnd->blocks[i];
+
+		if (!block->pending)
+			continue;
+
+		age = now - block->sent_time;
+
+		if (age > RDPSND_BLOCK_TIMEOUT)
+			block->pending = FALSE;
+		else if (age > max_age)
+			congested = TRUE;
+	}
+
+	freerdp_thread_unlock(rdpsnd->rdpsnd_channel_thread);
+
+	/* the client's playback delay is unknown until its first confirm */
+	return (congested && (rdpsnd->context.confirmed_blocks > 0));
+}
+
 static void rdpsnd_server_select_format(rdpsnd_server_context* context, int client_format_index)
 {
 	int bs;
+	int unit;
 	int out_buffer_size;
 	rdpsndFormat *format;
 	rdpsnd_server* rdpsnd = (rdpsnd_server*) context;
@@ -272,24 +430,33 @@ static void rdpsnd_server_select_format(rdpsnd_server_context* context, int clie
 	{
 		bs = (format->nBlockAlign - 4 * format->nChannels) * 4;
 		rdpsnd->out_frames = (format->nBlockAlign * 4 * format->nChannels * 2 / bs + 1) * bs / (format->nChannels * 2);
+		unit = bs / (format->nChannels * 2);
 	}
 	else if (format->wFormatTag == 0x02)
 	{
 		bs = (format->nBlockAlign - 7 * format->nChannels) * 2 / format->nChannels + 2;
 		rdpsnd->out_frames = bs * 4;
+		unit = bs;
 	}
 	else
 	{
 		rdpsnd->out_frames = 0x4000 / rdpsnd->src_bytes_per_frame;
+		unit = format->nSamplesPerSec / 100;
 	}
 
 	if (format->nSamplesPerSec != context->src_format.nSamplesPerSec)
 	{
 		rdpsnd->out_frames = (rdpsnd->out_frames * context->src_format.nSamplesPerSec + format->nSamplesPerSec - 100) / format->nSamplesPerSec;
+		unit = (unit * context->src_format.nSamplesPerSec + format->nSamplesPerSec - 100) / format->nSamplesPerSec;
 	}
+
+	rdpsnd->max_out_frames = rdpsnd->out_frames;
+	rdpsnd->frame_unit = (unit > 0) ? MIN(unit, rdpsnd->max_out_frames) : 1;
+	rdpsnd->out_frames = rdpsnd_server_packet_frames(rdpsnd);
 	rdpsnd->out_pending_frames = 0;
+	rdpsnd->enc_pending_size = 0;
 
-	out_buffer_size = rdpsnd->out_frames * rdpsnd->src_bytes_per_frame;
+	out_buffer_size = rdpsnd->max_out_frames * rdpsnd->src_bytes_per_frame;
 	
 	if (rdpsnd->out_buffer_size < out_buffer_size)
 	{
@@ -298,24 +465,58 @@ static void rdpsnd_server_select_format(rdpsnd_server_context* context, int clie
 	}
 
 	freerdp_dsp_context_reset_adpcm(rdpsnd->dsp_context);
+	freerdp_dsp_context_reset_resampler(rdpsnd->dsp_context);
 }
 
-static BOOL rdpsnd_server_send_audio_pdu(rdpsnd_server* rdpsnd)
+/**
+ * Frames of 16-bit PCM making up one ADPCM block, 0 for other formats.
+ */
+static int rdpsnd_server_block_frames(rdpsndFormat* format)
+{
+	if (format->wFormatTag == 0x11)
+		return (format->nBlockAlign - 4 * format->nChannels) * 2 / format->nChannels;
+	else if (format->wFormatTag == 0x02)
+		return 2 + (format->nBlockAlign - 7 * format->nChannels) * 2 / format->nChannels;
+
+	return 0;
+}
+
+/**
+ * Send the pending frames. ADPCM formats only go out in whole blocks, the
+ * PCM past the last whole block waits in enc_buffer for the next packet.
+ * Only the final packet, sent with flush on close, is padded to nBlockAlign.
+ */
+static BOOL rdpsnd_server_send_audio_pdu(rdpsnd_server* rdpsnd, BOOL flush)
 {
 	int size;
 	BOOL r;
 	BYTE* src;
+	UINT32 now;
 	int frames;
 	int fill_size;
+	int block_size;
 	rdpsndFormat* format;
+	rdpsnd_block* block;
 	int tbytes_per_frame;
 	STREAM* s = rdpsnd->rdpsnd_pdu;
 
+	now = freerdp_get_tick_count();
+
+	if (rdpsnd_server_is_congested(rdpsnd, now))
+	{
+		/* the client is behind, sending more would only add to the lag */
+		rdpsnd->context.dropped_frames += rdpsnd->out_pending_frames;
+		rdpsnd->out_pending_frames = 0;
+		rdpsnd->enc_pending_size = 0;
+		return TRUE;
+	}
+
 	format = &rdpsnd->context.client_formats[rdpsnd->context.selected_client_format];
 	tbytes_per_frame = format->nChannels * rdpsnd->src_bytes_per_sample;
 
-	if ((format->nSamplesPerSec == rdpsnd->context.src_format.nSamplesPerSec) &&
-			(format->nChannels == rdpsnd->context.src_format.nChannels))
+	if (((format->nSamplesPerSec == rdpsnd->context.src_format.nSamplesPerSec) &&
+			(format->nChannels == rdpsnd->context.src_format.nChannels)) ||
+			(rdpsnd->out_pending_frames == 0))
 	{
 		src = rdpsnd->out_buffer;
 		frames = rdpsnd->out_pending_frames;
@@ -330,26 +531,55 @@ static BOOL rdpsnd_server_send_audio_pdu(rdpsnd_server* rdpsnd)
 	}
 	size = frames * tbytes_per_frame;
 
-	if (format->wFormatTag == 0x11)
-	{
-		rdpsnd->dsp_context->encode_ima_adpcm(rdpsnd->dsp_context,
-			src, size, format->nChannels, format->nBlockAlign);
-		src = rdpsnd->dsp_context->adpcm_buffer;
-		size = rdpsnd->dsp_context->adpcm_size;
-	}
-	else if (format->wFormatTag == 0x02)
+	rdpsnd->out_pending_frames = 0;
+	rdpsnd->out_frames = rdpsnd_server_packet_frames(rdpsnd);
+
+	if ((format->wFormatTag == 0x11) || (format->wFormatTag == 0x02))
 	{
-		rdpsnd->dsp_context->encode_ms_adpcm(rdpsnd->dsp_context,
-			src, size, format->nChannels, format->nBlockAlign);
+		if (rdpsnd->enc_pending_size + size > rdpsnd->enc_buffer_size)
+		{
+			rdpsnd->enc_buffer_size = rdpsnd->enc_pending_size + size;
+			rdpsnd->enc_buffer = (BYTE*) realloc(rdpsnd->enc_buffer, rdpsnd->enc_buffer_size);
+		}
+
+		memcpy(rdpsnd->enc_buffer + rdpsnd->enc_pending_size, src, size);
+		rdpsnd->enc_pending_size += size;
+
+		block_size = rdpsnd_server_block_frames(format) * tbytes_per_frame;
+		size = rdpsnd->enc_pending_size;
+
+		if (!flush)
+			size = (size / block_size) * block_size;
+
+		if (size == 0)
+			return TRUE;
+
+		if (format->wFormatTag == 0x11)
+		{
+			rdpsnd->dsp_context->encode_ima_adpcm(rdpsnd->dsp_context,
+				rdpsnd->enc_buffer, size, format->nChannels, format->nBlockAlign);
+		}
+		else
+		{
+			rdpsnd->dsp_context->encode_ms_adpcm(rdpsnd->dsp_context,
+				rdpsnd->enc_buffer, size, format->nChannels, format->nBlockAlign);
+		}
+
+		rdpsnd->enc_pending_size -= size;
+		MoveMemory(rdpsnd->enc_buffer, rdpsnd->enc_buffer + size, rdpsnd->enc_pending_size);
+
 		src = rdpsnd->dsp_context->adpcm_buffer;
 		size = rdpsnd->dsp_context->adpcm_size;
 	}
 
+	if (size < 4)
+		return TRUE;
+
 	rdpsnd->context.block_no = (rdpsnd->context.block_no + 1) % 256;
 
-	/* Fill to nBlockAlign for the last audio packet */
-	if ((format->wFormatTag == 0x11 || format->wFormatTag == 0x02) &&
-		rdpsnd->out_pending_frames < rdpsnd->out_frames && (size % format->nBlockAlign) != 0)
+	/* Fill the last packet to nBlockAlign, the client expects whole blocks */
+	if (flush && (format->wFormatTag == 0x11 || format->wFormatTag == 0x02) &&
+		(size % format->nBlockAlign) != 0)
 		fill_size = format->nBlockAlign - (size % format->nBlockAlign);
 	else
 		fill_size = 0;
@@ -360,7 +590,7 @@ static BOOL rdpsnd_server_send_audio_pdu(rdpsnd_server* rdpsnd)
 	stream_write_BYTE(s, 0); /* bPad */
 	stream_write_UINT16(s, size + fill_size + 8); /* BodySize */
 
-	stream_write_UINT16(s, 0); /* wTimeStamp */
+	stream_write_UINT16(s, (UINT16) now); /* wTimeStamp */
 	stream_write_UINT16(s, rdpsnd->context.selected_client_format); /* wFormatNo */
 	stream_write_BYTE(s, rdpsnd->context.block_no); /* cBlockNo */
 	stream_seek(s, 3); /* bPad */
@@ -380,7 +610,12 @@ static BOOL rdpsnd_server_send_audio_pdu(rdpsnd_server* rdpsnd)
 	r = WTSVirtualChannelWrite(rdpsnd->rdpsnd_channel, stream_get_head(s), stream_get_length(s), NULL);
 	stream_set_pos(s, 0);
 
-	rdpsnd->out_pending_frames = 0;
+	freerdp_thread_lock(rdpsnd->rdpsnd_channel_thread);
+	block = &rdpsnd->blocks[rdpsnd->context.block_no];
+	block->pending = TRUE;
+	block->sent_time = now;
+	block->wTimeStamp = (UINT16) now;
+	freerdp_thread_unlock(rdpsnd->rdpsnd_channel_thread);
 
 	return r;
 }
@@ -406,7 +641,7 @@ static BOOL rdpsnd_server_send_samples(rdpsnd_server_context* context, const voi
 
 		if (rdpsnd->out_pending_frames >= rdpsnd->out_frames)
 		{
-			if (!rdpsnd_server_send_audio_pdu(rdpsnd))
+			if (!rdpsnd_server_send_audio_pdu(rdpsnd, FALSE))
 				return FALSE;
 		}
 	}
@@ -435,9 +670,9 @@ static BOOL rdpsnd_server_close(rdpsnd_server_context* context)
 	if (rdpsnd->context.selected_client_format < 0)
 		return FALSE;
 
-	if (rdpsnd->out_pending_frames > 0)
+	if ((rdpsnd->out_pending_frames > 0) || (rdpsnd->enc_pending_size > 0))
 	{
-		if (!rdpsnd_server_send_audio_pdu(rdpsnd))
+		if (!rdpsnd_server_send_audio_pdu(rdpsnd, TRUE))
 			return FALSE;
 	}
 
@@ -484,6 +719,9 @@ void rdpsnd_server_context_free(rdpsnd_server_context* context)
 	if (rdpsnd->out_buffer)
 		free(rdpsnd->out_buffer);
 
+	if (rdpsnd->enc_buffer)
+		free(rdpsnd->enc_buffer);
+
 	if (rdpsnd->dsp_context)
 		freerdp_dsp_context_free(rdpsnd->dsp_context);
 
@@ -66,10 +66,14 @@ typedef struct wts_data_item
 	UINT16 channel_id;
 	BYTE* buffer;
 	UINT32 length;
+	REASSEMBLY_CHAIN chain;
 } wts_data_item;
 
 static void wts_data_item_free(wts_data_item* item)
 {
+	if (item->chain.head != NULL)
+		reassembly_chain_free(&item->chain);
+
 	free(item->buffer);
 	free(item);
 }
@@ -111,6 +115,27 @@ static void wts_queue_receive_data(rdpPeerChannel* channel, const BYTE* buffer,
 	wait_obj_set(channel->receive_event);
 }
 
+static void wts_queue_receive_chain(rdpPeerChannel* channel)
+{
+	wts_data_item* item;
+
+	item = xnew(wts_data_item);
+
+	if (!reassembly_detach(channel->receive_reassembly, &item->chain))
+	{
+		free(item);
+		return;
+	}
+
+	item->length = item->chain.length;
+
+	WaitForSingleObject(channel->mutex, INFINITE);
+	list_enqueue(channel->receive_queue, item);
+	ReleaseMutex(channel->mutex);
+
+	wait_obj_set(channel->receive_event);
+}
+
 static void wts_queue_send_item(rdpPeerChannel* channel, wts_data_item* item)
 {
 	WTSVirtualChannelManager* vcm;
@@ -188,38 +213,47 @@ static void wts_read_drdynvc_create_response(rdpPeerChannel* channel, STREAM* s,
 static void wts_read_drdynvc_data_first(rdpPeerChannel* channel, STREAM* s, int cbLen, UINT32 length)
 {
 	int value;
+	UINT32 total_length;
 
-	value = wts_read_variable_uint(s, cbLen, &channel->dvc_total_length);
+	channel->dvc_total_length = 0;
+	value = wts_read_variable_uint(s, cbLen, &total_length);
 
 	if (value == 0)
 		return;
 
 	length -= value;
 
-	if (length > channel->dvc_total_length)
+	if (length > total_length)
 		return;
 
-	stream_set_pos(channel->receive_data, 0);
-	stream_check_size(channel->receive_data, (int) channel->dvc_total_length);
-	stream_write(channel->receive_data, stream_get_tail(s), length);
+	if (!reassembly_begin(channel->receive_reassembly, total_length))
+	{
+		printf("wts_read_drdynvc_data_first: message too large (%d bytes), discarded.\n", total_length);
+		return;
+	}
+
+	reassembly_append(channel->receive_reassembly, stream_get_tail(s), length);
+
+	if (reassembly_is_complete(channel->receive_reassembly))
+		wts_queue_receive_chain(channel);
+	else
+		channel->dvc_total_length = total_length;
 }
 
 static void wts_read_drdynvc_data(rdpPeerChannel* channel, STREAM* s, UINT32 length)
 {
 	if (channel->dvc_total_length > 0)
 	{
-		if (stream_get_length(channel->receive_data) + length > channel->dvc_total_length)
+		if (!reassembly_append(channel->receive_reassembly, stream_get_tail(s), length))
 		{
 			channel->dvc_total_length = 0;
 			printf("wts_read_drdynvc_data: incorrect fragment data, discarded.\n");
 			return;
 		}
 
-		stream_write(channel->receive_data, stream_get_tail(s), length);
-
-		if (stream_get_length(channel->receive_data) >= (int) channel->dvc_total_length)
+		if (reassembly_is_complete(channel->receive_reassembly))
 		{
-			wts_queue_receive_data(channel, stream_get_head(channel->receive_data), channel->dvc_total_length);
+			wts_queue_receive_chain(channel);
 			channel->dvc_total_length = 0;
 		}
 	}
@@ -356,6 +390,37 @@ static void wts_write_drdynvc_create_request(STREAM *s, UINT32 ChannelId, const
 
 static void WTSProcessChannelData(rdpPeerChannel* channel, int channelId, BYTE* data, int size, int flags, int total_size)
 {
+	if (channel != channel->vcm->drdynvc_channel)
+	{
+		if (flags & CHANNEL_FLAG_FIRST)
+		{
+			if (!reassembly_begin(channel->receive_reassembly, total_size))
+				printf("WTSProcessChannelData: message too large (%d bytes), discarded\n", total_size);
+		}
+
+		if (channel->receive_reassembly->overflow)
+			return;
+
+		if (!reassembly_append(channel->receive_reassembly, data, size))
+		{
+			printf("WTSProcessChannelData: fragment exceeds total length, discarded\n");
+			return;
+		}
+
+		if (flags & CHANNEL_FLAG_LAST)
+		{
+			if (reassembly_is_complete(channel->receive_reassembly))
+				wts_queue_receive_chain(channel);
+			else
+				printf("WTSProcessChannelData: read error\n");
+
+			reassembly_reset(channel->receive_reassembly);
+		}
+
+		return;
+	}
+
+	/* drdynvc PDUs are parsed in place, so they are kept contiguous */
 	if (flags & CHANNEL_FLAG_FIRST)
 	{
 		stream_set_pos(channel->receive_data, 0);
@@ -370,14 +435,8 @@ static void WTSProcessChannelData(rdpPeerChannel* channel, int channelId, BYTE*
 		{
 			printf("WTSProcessChannelData: read error\n");
 		}
-		if (channel == channel->vcm->drdynvc_channel)
-		{
-			wts_read_drdynvc_pdu(channel);
-		}
-		else
-		{
-			wts_queue_receive_data(channel, stream_get_head(channel->receive_data), stream_get_length(channel->receive_data));
-		}
+
+		wts_read_drdynvc_pdu(channel);
 		stream_set_pos(channel->receive_data, 0);
 	}
 }
@@ -419,6 +478,7 @@ WTSVirtualChannelManager* WTSCreateVirtualChannelManager(freerdp_peer* client)
 		vcm->send_event = wait_obj_new();
 		vcm->send_queue = list_new();
 		vcm->mutex = CreateMutex(NULL, FALSE, NULL);
+		vcm->segment_pool = segment_pool_new(0);
 		vcm->dvc_channel_id_seq = 1;
 		vcm->dvc_channel_list = list_new();
 
@@ -457,6 +517,10 @@ void WTSDestroyVirtualChannelManager(WTSVirtualChannelManager* vcm)
 
 		list_free(vcm->send_queue);
 		CloseHandle(vcm->mutex);
+
+		/* static channels must have been closed by now, they hold segments from this pool */
+		segment_pool_free(vcm->segment_pool);
+
 		free(vcm);
 	}
 }
@@ -539,7 +603,7 @@ void* WTSVirtualChannelOpenEx(
 		channel->vcm = vcm;
 		channel->client = client;
 		channel->channel_type = RDP_PEER_CHANNEL_TYPE_DVC;
-		channel->receive_data = stream_new(client->settings->vc_chunk_size);
+		channel->receive_reassembly = reassembly_new(vcm->segment_pool, 0);
 		channel->receive_event = wait_obj_new();
 		channel->receive_queue = list_new();
 		channel->mutex = CreateMutex(NULL, FALSE, NULL);
@@ -586,6 +650,7 @@ void* WTSVirtualChannelOpenEx(
 			channel->index = i;
 			channel->channel_type = RDP_PEER_CHANNEL_TYPE_SVC;
 			channel->receive_data = stream_new(client->settings->vc_chunk_size);
+			channel->receive_reassembly = reassembly_new(vcm->segment_pool, 0);
 			channel->receive_event = wait_obj_new();
 			channel->receive_queue = list_new();
 			channel->mutex = CreateMutex(NULL, FALSE, NULL);
@@ -693,8 +758,12 @@ BOOL WTSVirtualChannelRead(
 
 	ReleaseMutex(channel->mutex);
 
-	memcpy(Buffer, item->buffer, item->length);
-	wts_data_item_free(item) ;
+	if (item->chain.head != NULL)
+		reassembly_chain_copy(&item->chain, Buffer, item->length);
+	else
+		memcpy(Buffer, item->buffer, item->length);
+
+	wts_data_item_free(item);
 
 	return TRUE;
 }
@@ -812,6 +881,9 @@ BOOL WTSVirtualChannelClose(
 		if (channel->receive_data)
 			stream_free(channel->receive_data);
 
+		if (channel->receive_reassembly)
+			reassembly_free(channel->receive_reassembly);
+
 		if (channel->receive_event)
 			wait_obj_free(channel->receive_event);
 
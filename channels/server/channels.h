@@ -26,6 +26,7 @@
 #include <freerdp/utils/list.h>
 #include <freerdp/utils/debug.h>
 #include <freerdp/utils/wait_obj.h>
+#include <freerdp/utils/reassembly.h>
 #include <freerdp/channels/wtsvc.h>
 
 #include <winpr/synch.h>
@@ -67,6 +68,7 @@ struct rdp_peer_channel
 	UINT16 index;
 
 	STREAM* receive_data;
+	rdpReassembly* receive_reassembly;
 	struct wait_obj* receive_event;
 	LIST* receive_queue;
 	HANDLE mutex;
@@ -81,6 +83,7 @@ struct WTSVirtualChannelManager
 	struct wait_obj* send_event;
 	LIST* send_queue;
 	HANDLE mutex;
+	rdpSegmentPool* segment_pool;
 
 	rdpPeerChannel* drdynvc_channel;
 	BYTE drdynvc_state;
@@ -40,7 +40,6 @@
 #include <freerdp/utils/list.h>
 #include <freerdp/utils/thread.h>
 #include <freerdp/utils/event.h>
-#include <freerdp/utils/sleep.h>
 #include <freerdp/client/tsmf.h>
 
 #include <winpr/synch.h>
@@ -55,6 +54,19 @@
 
 #define AUDIO_TOLERANCE 10000000LL
 
+/* Times are in 100ns units, like the sample timestamps. */
+
+/* Delay given to video before its first frame when there is no audio to follow. */
+#define TSMF_JITTER_BUFFER_TIME		1000000LL
+/* Frames later than this, and later than their own duration, are dropped. */
+#define TSMF_LATE_THRESHOLD		200000LL
+/* A frame this far off the presentation clock means a discontinuity, the clock is reset. */
+#define TSMF_RESYNC_THRESHOLD		10000000LL
+/* Longest a stream thread sleeps without being signaled. */
+#define TSMF_IDLE_WAIT_MS		100
+/* Deepest a sample queue may grow; past it the oldest queued sample is dropped. */
+#define TSMF_MAX_QUEUED_SAMPLES		256
+
 struct _TSMF_PRESENTATION
 {
 	BYTE presentation_id[GUID_SIZE];
@@ -82,6 +94,15 @@ struct _TSMF_PRESENTATION
 	UINT64 audio_start_time;
 	UINT64 audio_end_time;
 
+	/**
+	 * Presentation clock: the sample time clock_media is due at system time clock_system.
+	 * Audio streams drive it as they play, video streams schedule their frames on it.
+	 * Protected by the presentation mutex.
+	 */
+	BOOL clock_valid;
+	UINT64 clock_media;
+	UINT64 clock_system;
+
 	/* The stream list could be accessed by different threads and need to be protected. */
 	HANDLE mutex;
 
@@ -108,15 +129,22 @@ struct _TSMF_STREAM
 
 	/* The end_time of last played sample */
 	UINT64 last_end_time;
-	/* Next sample should not start before this system time. */
-	UINT64 next_start_time;
+
+	/* Incremented on flush, so that a frame waiting for its due time is dropped. */
+	UINT32 flush_count;
 
 	freerdp_thread* thread;
 
-	LIST* sample_list;
+	/* Samples waiting to be decoded, protected by the thread lock. */
+	TSMF_SAMPLE* sample_head;
+	TSMF_SAMPLE* sample_tail;
+	int sample_count;
 
 	/* The sample ack response queue will be accessed only by the stream thread. */
-	LIST* sample_ack_list;
+	TSMF_SAMPLE* ack_head;
+	TSMF_SAMPLE* ack_tail;
+
+	TSMF_STREAM_STATISTICS statistics;
 };
 
 struct _TSMF_SAMPLE
@@ -134,6 +162,8 @@ struct _TSMF_SAMPLE
 	TSMF_STREAM* stream;
 	IWTSVirtualChannelCallback* channel_callback;
 	UINT64 ack_time;
+
+	TSMF_SAMPLE* next;
 };
 
 static LIST* presentation_list = NULL;
@@ -157,7 +187,7 @@ static TSMF_SAMPLE* tsmf_stream_pop_sample(TSMF_STREAM* stream, int sync)
 	BOOL pending = FALSE;
 	TSMF_PRESENTATION* presentation = stream->presentation;
 
-	if (list_size(stream->sample_list) == 0)
+	if (stream->sample_count == 0)
 		return NULL;
 
 	if (sync)
@@ -204,7 +234,20 @@ static TSMF_SAMPLE* tsmf_stream_pop_sample(TSMF_STREAM* stream, int sync)
 		return NULL;
 
 	freerdp_thread_lock(stream->thread);
-	sample = (TSMF_SAMPLE*) list_dequeue(stream->sample_list);
+
+	sample = stream->sample_head;
+
+	if (sample)
+	{
+		stream->sample_head = sample->next;
+
+		if (!stream->sample_head)
+			stream->sample_tail = NULL;
+
+		stream->sample_count--;
+		sample->next = NULL;
+	}
+
 	freerdp_thread_unlock(stream->thread);
 
 	if (sample && sample->end_time > stream->last_end_time)
@@ -229,7 +272,31 @@ static void tsmf_sample_queue_ack(TSMF_SAMPLE* sample)
 {
 	TSMF_STREAM* stream = sample->stream;
 
-	list_enqueue(stream->sample_ack_list, sample);
+	sample->next = NULL;
+
+	if (stream->ack_tail)
+		stream->ack_tail->next = sample;
+	else
+		stream->ack_head = sample;
+
+	stream->ack_tail = sample;
+}
+
+static TSMF_SAMPLE* tsmf_stream_dequeue_ack(TSMF_STREAM* stream)
+{
+	TSMF_SAMPLE* sample = stream->ack_head;
+
+	if (sample)
+	{
+		stream->ack_head = sample->next;
+
+		if (!stream->ack_head)
+			stream->ack_tail = NULL;
+
+		sample->next = NULL;
+	}
+
+	return sample;
 }
 
 static void tsmf_stream_process_ack(TSMF_STREAM* stream)
@@ -238,18 +305,124 @@ static void tsmf_stream_process_ack(TSMF_STREAM* stream)
 	UINT64 ack_time;
 
 	ack_time = get_current_time();
-	while (list_size(stream->sample_ack_list) > 0 && !freerdp_thread_is_stopped(stream->thread))
+	while (stream->ack_head && !freerdp_thread_is_stopped(stream->thread))
 	{
-		sample = (TSMF_SAMPLE*) list_peek(stream->sample_ack_list);
-		if (!sample || sample->ack_time > ack_time)
+		if (stream->ack_head->ack_time > ack_time)
 			break;
 
-		sample = list_dequeue(stream->sample_ack_list);
+		sample = tsmf_stream_dequeue_ack(stream);
 		tsmf_sample_ack(sample);
 		tsmf_sample_free(sample);
 	}
 }
 
+/**
+ * How long the stream thread may sleep: until the next ack is due, at most
+ * TSMF_IDLE_WAIT_MS. New samples and progress of the other streams wake it earlier.
+ */
+static int tsmf_stream_wait_time(TSMF_STREAM* stream)
+{
+	UINT64 now;
+	UINT64 wait_ms;
+
+	if (!stream->ack_head)
+		return TSMF_IDLE_WAIT_MS;
+
+	now = get_current_time();
+
+	if (stream->ack_head->ack_time <= now)
+		return 0;
+
+	wait_ms = (stream->ack_head->ack_time - now + 9999) / 10000;
+
+	return (wait_ms < TSMF_IDLE_WAIT_MS) ? (int) wait_ms : TSMF_IDLE_WAIT_MS;
+}
+
+/* Wakes up the other streams of the presentation, which may be waiting for this one to catch up. */
+static void tsmf_presentation_signal_streams(TSMF_PRESENTATION* presentation, TSMF_STREAM* stream)
+{
+	LIST_ITEM* item;
+	TSMF_STREAM* s;
+
+	WaitForSingleObject(presentation->mutex, INFINITE);
+
+	for (item = presentation->stream_list->head; item; item = item->next)
+	{
+		s = (TSMF_STREAM*) item->data;
+
+		if (s != stream)
+			freerdp_thread_signal(s->thread);
+	}
+
+	ReleaseMutex(presentation->mutex);
+}
+
+static void tsmf_presentation_set_clock(TSMF_PRESENTATION* presentation, UINT64 media_time, UINT64 system_time)
+{
+	WaitForSingleObject(presentation->mutex, INFINITE);
+	presentation->clock_media = media_time;
+	presentation->clock_system = system_time;
+	presentation->clock_valid = TRUE;
+	ReleaseMutex(presentation->mutex);
+}
+
+static void tsmf_presentation_reset_clock(TSMF_PRESENTATION* presentation)
+{
+	WaitForSingleObject(presentation->mutex, INFINITE);
+	presentation->clock_valid = FALSE;
+	ReleaseMutex(presentation->mutex);
+}
+
+/**
+ * System time at which the given sample time is due on the presentation clock.
+ * Without a clock yet, or far off it, the clock starts over from this sample,
+ * leaving TSMF_JITTER_BUFFER_TIME for the following samples to arrive.
+ */
+static UINT64 tsmf_presentation_get_due_time(TSMF_PRESENTATION* presentation, UINT64 media_time, UINT64 now)
+{
+	INT64 due;
+
+	WaitForSingleObject(presentation->mutex, INFINITE);
+
+	due = (INT64) presentation->clock_system + ((INT64) media_time - (INT64) presentation->clock_media);
+
+	if (!presentation->clock_valid ||
+		(due > (INT64) now + TSMF_RESYNC_THRESHOLD) || (due < (INT64) now - TSMF_RESYNC_THRESHOLD))
+	{
+		presentation->clock_media = media_time;
+		presentation->clock_system = now + TSMF_JITTER_BUFFER_TIME;
+		presentation->clock_valid = TRUE;
+		due = (INT64) presentation->clock_system;
+	}
+
+	ReleaseMutex(presentation->mutex);
+
+	return (UINT64) due;
+}
+
+/**
+ * Waits until the sample is due. Returns FALSE if the stream was stopped or
+ * flushed in the meantime and the sample must not be presented.
+ */
+static BOOL tsmf_stream_wait_until(TSMF_STREAM* stream, UINT64 due)
+{
+	UINT64 now;
+	UINT32 flush_count = stream->flush_count;
+
+	while ((now = get_current_time()) + 10000 <= due)
+	{
+		if (freerdp_thread_is_stopped(stream->thread) || stream->flush_count != flush_count)
+			return FALSE;
+
+		freerdp_thread_wait_timeout(stream->thread, (int) ((due - now) / 10000));
+
+		/* new samples are picked up by the playback loop, which checks its queue after this frame */
+		freerdp_thread_reset(stream->thread);
+	}
+
+	return (stream->flush_count == flush_count);
+}
+
 TSMF_PRESENTATION* tsmf_presentation_new(const BYTE* guid, IWTSVirtualChannelCallback* pChannelCallback)
 {
 	TSMF_PRESENTATION* presentation;
@@ -324,6 +497,7 @@ static void tsmf_presentation_restore_last_video_frame(TSMF_PRESENTATION* presen
 static void tsmf_sample_playback_video(TSMF_SAMPLE* sample)
 {
 	UINT64 t;
+	UINT64 due;
 	RDP_VIDEO_FRAME_EVENT* vevent;
 	TSMF_STREAM* stream = sample->stream;
 	TSMF_PRESENTATION* presentation = stream->presentation;
@@ -334,14 +508,26 @@ static void tsmf_sample_playback_video(TSMF_SAMPLE* sample)
 	if (sample->data)
 	{
 		t = get_current_time();
+		due = tsmf_presentation_get_due_time(presentation, sample->start_time, t);
+
+		if ((t > due + TSMF_LATE_THRESHOLD) && (t > due + sample->duration))
+		{
+			/* the next frame is already due, showing this one would only add to the lag */
+			stream->statistics.dropped_frames++;
+			return;
+		}
 
-		if (stream->next_start_time > t &&
-			(sample->end_time >= presentation->audio_start_time ||
-			sample->end_time < stream->last_end_time))
+		if (t > due)
+		{
+			stream->statistics.late_frames++;
+		}
+		else if (!tsmf_stream_wait_until(stream, due))
 		{
-			freerdp_usleep((stream->next_start_time - t) / 10);
+			stream->statistics.dropped_frames++;
+			return;
 		}
-		stream->next_start_time = t + sample->duration - 50000;
+
+		stream->statistics.presented_frames++;
 
 		if (presentation->last_x != presentation->output_x ||
 			presentation->last_y != presentation->output_y ||
@@ -451,6 +637,12 @@ static void tsmf_sample_playback_audio(TSMF_SAMPLE* sample)
 	stream->last_end_time = sample->end_time + latency;
 	stream->presentation->audio_start_time = sample->start_time + latency;
 	stream->presentation->audio_end_time = sample->end_time + latency;
+
+	/* the sample starts playing once the device has played what it already holds */
+	if (stream->audio)
+		tsmf_presentation_set_clock(stream->presentation, sample->start_time, sample->ack_time);
+
+	stream->statistics.presented_frames++;
 }
 
 static void tsmf_sample_playback(TSMF_SAMPLE* sample)
@@ -659,12 +851,21 @@ static void* tsmf_stream_playback_func(void* arg)
 	}
 	while (!freerdp_thread_is_stopped(stream->thread))
 	{
+		/* clear the wakeup before looking at the queues, a sample pushed from now on signals again */
+		freerdp_thread_reset(stream->thread);
+
 		tsmf_stream_process_ack(stream);
 		sample = tsmf_stream_pop_sample(stream, 1);
+
 		if (sample)
+		{
 			tsmf_sample_playback(sample);
+			tsmf_presentation_signal_streams(presentation, stream);
+		}
 		else
-			freerdp_usleep(5000);
+		{
+			freerdp_thread_wait_timeout(stream->thread, tsmf_stream_wait_time(stream));
+		}
 	}
 	if (stream->eos || presentation->eos)
 	{
@@ -679,7 +880,9 @@ static void* tsmf_stream_playback_func(void* arg)
 
 	freerdp_thread_quit(stream->thread);
 
-	DEBUG_DVC("out %d", stream->stream_id);
+	DEBUG_DVC("out %d presented %d late %d dropped %d max queued %d", stream->stream_id,
+		stream->statistics.presented_frames, stream->statistics.late_frames,
+		stream->statistics.dropped_frames, stream->statistics.max_queued_samples);
 
 	return NULL;
 }
@@ -776,6 +979,8 @@ void tsmf_presentation_paused(TSMF_PRESENTATION* presentation)
 		stream = (TSMF_STREAM*) item->data;
 		tsmf_stream_pause(stream);
 	}
+
+	tsmf_presentation_reset_clock(presentation);
 }
 
 void tsmf_presentation_restarted(TSMF_PRESENTATION* presentation)
@@ -788,6 +993,8 @@ void tsmf_presentation_restarted(TSMF_PRESENTATION* presentation)
 		stream = (TSMF_STREAM*) item->data;
 		tsmf_stream_restart(stream);
 	}
+
+	tsmf_presentation_reset_clock(presentation);
 }
 
 void tsmf_presentation_start(TSMF_PRESENTATION* presentation)
@@ -857,7 +1064,7 @@ static void tsmf_stream_flush(TSMF_STREAM* stream)
 	while ((sample = tsmf_stream_pop_sample(stream, 0)) != NULL)
 		tsmf_sample_free(sample);
 
-	while ((sample = list_dequeue(stream->sample_ack_list)) != NULL)
+	while ((sample = tsmf_stream_dequeue_ack(stream)) != NULL)
 		tsmf_sample_free(sample);
 
 	if (stream->audio)
@@ -865,7 +1072,8 @@ static void tsmf_stream_flush(TSMF_STREAM* stream)
 
 	stream->eos = 0;
 	stream->last_end_time = 0;
-	stream->next_start_time = 0;
+	stream->flush_count++;
+	freerdp_thread_signal(stream->thread);
 	if (stream->major_type == TSMF_MAJOR_TYPE_AUDIO)
 	{
 		stream->presentation->audio_start_time = 0;
@@ -887,6 +1095,8 @@ void tsmf_presentation_flush(TSMF_PRESENTATION* presentation)
 	presentation->eos = 0;
 	presentation->audio_start_time = 0;
 	presentation->audio_end_time = 0;
+
+	tsmf_presentation_reset_clock(presentation);
 }
 
 void tsmf_presentation_free(TSMF_PRESENTATION* presentation)
@@ -926,8 +1136,6 @@ TSMF_STREAM* tsmf_stream_new(TSMF_PRESENTATION* presentation, UINT32 stream_id)
 	stream->stream_id = stream_id;
 	stream->presentation = presentation;
 	stream->thread = freerdp_thread_new();
-	stream->sample_list = list_new();
-	stream->sample_ack_list = list_new();
 
 	WaitForSingleObject(presentation->mutex, INFINITE);
 	list_enqueue(presentation->stream_list, stream);
@@ -1004,9 +1212,6 @@ void tsmf_stream_free(TSMF_STREAM* stream)
 	list_remove(presentation->stream_list, stream);
 	ReleaseMutex(presentation->mutex);
 
-	list_free(stream->sample_list);
-	list_free(stream->sample_ack_list);
-
 	if (stream->decoder)
 	{
 		stream->decoder->Free(stream->decoder);
@@ -1024,6 +1229,7 @@ void tsmf_stream_push_sample(TSMF_STREAM* stream, IWTSVirtualChannelCallback* pC
 	UINT32 data_size, BYTE* data)
 {
 	TSMF_SAMPLE* sample;
+	TSMF_SAMPLE* dropped = NULL;
 
 	WaitForSingleObject(tsmf_mutex, INFINITE);
 	
@@ -1049,8 +1255,38 @@ void tsmf_stream_push_sample(TSMF_STREAM* stream, IWTSVirtualChannelCallback* pC
 	memcpy(sample->data, data, data_size);
 
 	freerdp_thread_lock(stream->thread);
-	list_enqueue(stream->sample_list, sample);
+
+	if (stream->sample_count >= TSMF_MAX_QUEUED_SAMPLES)
+	{
+		/* the server sends faster than we present, give up the oldest sample */
+		dropped = stream->sample_head;
+		stream->sample_head = dropped->next;
+		stream->sample_count--;
+		dropped->next = NULL;
+		stream->statistics.dropped_frames++;
+	}
+
+	if (stream->sample_tail)
+		stream->sample_tail->next = sample;
+	else
+		stream->sample_head = sample;
+
+	stream->sample_tail = sample;
+	stream->sample_count++;
+
+	if (stream->sample_count > stream->statistics.max_queued_samples)
+		stream->statistics.max_queued_samples = stream->sample_count;
+
 	freerdp_thread_unlock(stream->thread);
+
+	if (dropped)
+	{
+		/* still ack it, the server keeps its own account of what is outstanding */
+		tsmf_sample_ack(dropped);
+		tsmf_sample_free(dropped);
+	}
+
+	freerdp_thread_signal(stream->thread);
 }
 
 #ifndef _WIN32
@@ -32,6 +32,21 @@ typedef struct _TSMF_STREAM TSMF_STREAM;
 
 typedef struct _TSMF_SAMPLE TSMF_SAMPLE;
 
+/**
+ * Playback statistics of a stream. Frames are video frames or audio samples;
+ * late frames were presented after their due time, dropped frames were decoded
+ * but not presented because they were too late or flushed while waiting, or
+ * discarded from a full sample queue.
+ */
+struct _TSMF_STREAM_STATISTICS
+{
+	UINT32 presented_frames;
+	UINT32 late_frames;
+	UINT32 dropped_frames;
+	int max_queued_samples;
+};
+typedef struct _TSMF_STREAM_STATISTICS TSMF_STREAM_STATISTICS;
+
 TSMF_PRESENTATION* tsmf_presentation_new(const BYTE* guid, IWTSVirtualChannelCallback* pChannelCallback);
 TSMF_PRESENTATION* tsmf_presentation_find_by_id(const BYTE* guid);
 void tsmf_presentation_start(TSMF_PRESENTATION* presentation);
@@ -0,0 +1,246 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * FreeRDP Session Replay
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Replays a capture recorded with --dump-pdu into a frame buffer in memory,
+ * without sockets or a display, and reports the decoding throughput:
+ *
+ * freerdp-replay [-w width] [-h height] [-a bpp] [-n iterations] [-c checksum] capture.pcap
+ *
+ * The desktop size and color depth must be those of the recorded session.
+ * The frame buffer checksum is printed, the exit status is 1 if it does not
+ * match the expected one.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <freerdp/freerdp.h>
+#include <freerdp/replay.h>
+#include <freerdp/constants.h>
+#include <freerdp/gdi/gdi.h>
+
+struct replay_histogram
+{
+	int index;
+	char* name;
+};
+
+static const struct replay_histogram replay_histograms[] =
+{
+	{ METRICS_ORDERS, "orders" },
+	{ METRICS_BITMAP_DECOMPRESS, "bitmap" },
+	{ METRICS_SURFACE_UNCOMPRESSED, "uncompressed" },
+	{ METRICS_SURFACE_NSCODEC, "nscodec" },
+	{ METRICS_SURFACE_REMOTEFX, "remotefx" },
+	{ METRICS_RFX_RLGR_DECODE, "  rlgr" },
+	{ METRICS_RFX_DWT_DECODE, "  dwt" },
+	{ METRICS_RFX_COLOR_CONVERT, "  color" }
+};
+
+static freerdp* replay_instance_new(int width, int height, int bpp)
+{
+	freerdp* instance;
+
+	instance = freerdp_new();
+	freerdp_context_new(instance);
+
+	instance->settings->width = width;
+	instance->settings->height = height;
+	instance->settings->color_depth = bpp;
+
+	gdi_init(instance, CLRCONV_ALPHA | CLRBUF_32BPP, NULL);
+
+	return instance;
+}
+
+static void replay_instance_free(freerdp* instance)
+{
+	gdi_free(instance);
+	freerdp_context_free(instance);
+	freerdp_free(instance);
+}
+
+static void replay_print_stats(rdpReplayStats* stats, int iterations)
+{
+	int i;
+	double seconds;
+	rdpMetricsHistogram* histogram;
+
+	seconds = stats->elapsed / 1000000000.0;
+
+	printf("%d PDUs (%d skipped), %llu bytes in %.3f ms\n",
+		stats->pdus, stats->skipped, (unsigned long long) stats->bytes, seconds * 1000);
+
+	if (seconds > 0)
+	{
+		printf("%.0f PDUs/s, %.2f Mpixels/s, %.2f MB/s\n", stats->pdus / seconds,
+			stats->metrics.counters[METRICS_UPDATE_PIXELS] / seconds / 1000000,
+			stats->bytes / seconds / 1000000);
+	}
+
+	printf("\n%-14s %8s %10s %6s %10s %10s\n", "", "calls", "ms", "%", "p50 us", "p99 us");
+
+	for (i = 0; i < (int) (sizeof(replay_histograms) / sizeof(replay_histograms[0])); i++)
+	{
+		histogram = &stats->metrics.histograms[replay_histograms[i].index];
+
+		if (histogram->count == 0)
+			continue;
+
+		printf("%-14s %8llu %10.3f %6.1f %10.1f %10.1f\n", replay_histograms[i].name,
+			(unsigned long long) histogram->count / iterations,
+			histogram->sum / 1000000.0 / iterations,
+			(stats->elapsed > 0) ? (histogram->sum * 100.0) / stats->elapsed : 0,
+			metrics_histogram_percentile(histogram, 50) / 1000.0,
+			metrics_histogram_percentile(histogram, 99) / 1000.0);
+	}
+}
+
+static void replay_merge_stats(rdpReplayStats* total, rdpReplayStats* stats)
+{
+	int i, j;
+
+	total->pdus += stats->pdus;
+	total->skipped += stats->skipped;
+	total->bytes += stats->bytes;
+	total->elapsed += stats->elapsed;
+
+	for (i = 0; i < METRICS_COUNTER_COUNT; i++)
+		total->metrics.counters[i] += stats->metrics.counters[i];
+
+	for (i = 0; i < METRICS_HISTOGRAM_COUNT; i++)
+	{
+		total->metrics.histograms[i].count += stats->metrics.histograms[i].count;
+		total->metrics.histograms[i].sum += stats->metrics.histograms[i].sum;
+
+		for (j = 0; j < METRICS_HISTOGRAM_BUCKETS; j++)
+			total->metrics.histograms[i].buckets[j] += stats->metrics.histograms[i].buckets[j];
+	}
+}
+
+static void replay_usage(char* name)
+{
+	printf("Usage: %s [options] capture.pcap\n"
+		"  -w: desktop width, default is 1024\n"
+		"  -h: desktop height, default is 768\n"
+		"  -a: color depth, default is 32\n"
+		"  -n: number of times the capture is replayed, default is 1\n"
+		"  -c: expected frame buffer checksum, in hexadecimal\n", name);
+}
+
+int main(int argc, char* argv[])
+{
+	int index;
+	int width = 1024;
+	int height = 768;
+	int bpp = 32;
+	int iterations = 1;
+	char* name = NULL;
+	char* expected = NULL;
+	UINT32 checksum = 0;
+	freerdp* instance;
+	rdpGdi* gdi;
+	rdpReplayStats stats;
+	rdpReplayStats total;
+
+	for (index = 1; index < argc; index++)
+	{
+		if ((argv[index][0] == '-') && (index + 1 < argc))
+		{
+			switch (argv[index][1])
+			{
+				case 'w':
+					width = atoi(argv[++index]);
+					break;
+
+				case 'h':
+					height = atoi(argv[++index]);
+					break;
+
+				case 'a':
+					bpp = atoi(argv[++index]);
+					break;
+
+				case 'n':
+					iterations = atoi(argv[++index]);
+					break;
+
+				case 'c':
+					expected = argv[++index];
+					break;
+
+				default:
+					replay_usage(argv[0]);
+					return 1;
+			}
+		}
+		else if (argv[index][0] != '-')
+		{
+			name = argv[index];
+		}
+		else
+		{
+			replay_usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if ((name == NULL) || (width <= 0) || (height <= 0) || (iterations <= 0))
+	{
+		replay_usage(argv[0]);
+		return 1;
+	}
+
+	memset(&total, 0, sizeof(rdpReplayStats));
+
+	/* every iteration starts from a blank frame buffer and fresh codec state */
+	for (index = 0; index < iterations; index++)
+	{
+		instance = replay_instance_new(width, height, bpp);
+
+		if (!freerdp_replay(instance, name, &stats))
+		{
+			fprintf(stderr, "%s: replay failed\n", name);
+			replay_instance_free(instance);
+			return 1;
+		}
+
+		gdi = instance->context->gdi;
+		checksum = freerdp_replay_checksum(gdi->primary_buffer, gdi->width * gdi->height * gdi->bytesPerPixel);
+
+		replay_instance_free(instance);
+		replay_merge_stats(&total, &stats);
+	}
+
+	printf("%s: ", name);
+	replay_print_stats(&total, iterations);
+	printf("\nchecksum %08X\n", checksum);
+
+	if ((expected != NULL) && (strtoul(expected, NULL, 16) != checksum))
+	{
+		fprintf(stderr, "checksum mismatch, expected %s\n", expected);
+		return 1;
+	}
+
+	return 0;
+}
@@ -245,17 +245,18 @@ void cpuid(unsigned info, unsigned *eax, unsigned *ebx, unsigned *ecx, unsigned
 #if defined(__GNUC__)
 #if defined(__i386__) || defined(__x86_64__)
 	*eax = info;
+	*ecx = 0;
 	__asm volatile
 		("mov %%ebx, %%edi;" /* 32bit PIC: don't clobber ebx */
 		 "cpuid;"
 		 "mov %%ebx, %%esi;"
 		 "mov %%edi, %%ebx;"
-		 :"+a" (*eax), "=S" (*ebx), "=c" (*ecx), "=d" (*edx)
+		 :"+a" (*eax), "=S" (*ebx), "+c" (*ecx), "=d" (*edx)
 		 : :"edi");
 #endif
 #elif defined(_MSC_VER)
 	int a[4];
-	__cpuid(a, info);
+	__cpuidex(a, info, 0);
 	*eax = a[0];
 	*ebx = a[1];
 	*ecx = a[2];
@@ -267,7 +268,9 @@ UINT32 wfi_detect_cpu()
 {
 	UINT32 cpu_opt = 0;
 	unsigned int eax, ebx, ecx, edx = 0;
+	unsigned int max_level;
 
+	cpuid(0, &max_level, &ebx, &ecx, &edx);
 	cpuid(1, &eax, &ebx, &ecx, &edx);
 
 	if (edx & (1<<26))
@@ -275,6 +278,17 @@ UINT32 wfi_detect_cpu()
 		cpu_opt |= CPU_SSE2;
 	}
 
+#if defined(_MSC_VER)
+	/* AVX2 needs the OS to save the YMM registers (OSXSAVE, AVX and XCR0) */
+	if ((max_level >= 7) && (ecx & (1<<27)) && (ecx & (1<<28)) && ((_xgetbv(0) & 6) == 6))
+	{
+		cpuid(7, &eax, &ebx, &ecx, &edx);
+
+		if (ebx & (1<<5))
+			cpu_opt |= CPU_AVX2;
+	}
+#endif
+
 	return cpu_opt;
 }
 
@@ -22,12 +22,12 @@
 #endif
 
 #include <stdlib.h>
+#include <string.h>
 #include <X11/Xlib.h>
 #include <X11/Xatom.h>
 
 #include <freerdp/utils/event.h>
-#include <freerdp/utils/stream.h>
-#include <freerdp/utils/unicode.h>
+#include <freerdp/utils/clipboard.h>
 #include <freerdp/client/cliprdr.h>
 
 #include "xf_cliprdr.h"
@@ -66,12 +66,19 @@ struct clipboard_context
 	Window owner;
 	int request_index;
 	BOOL sync;
+	CLIPBOARD_STREAM* request_stream;
 
 	/* INCR mechanism */
 	Atom incr_atom;
 	BOOL incr_starts;
-	BYTE* incr_data;
-	int incr_data_length;
+	int incr_max_size;
+
+	/* outgoing INCR transfer, converted from data as the requestor reads it */
+	Window incr_requestor;
+	Atom incr_property;
+	Atom incr_target;
+	int incr_offset;
+	CLIPBOARD_STREAM* incr_stream;
 };
 
 void xf_cliprdr_init(xfInfo* xfi, rdpChannels* chanman)
@@ -141,6 +148,7 @@ void xf_cliprdr_init(xfInfo* xfi, rdpChannels* chanman)
 	cb->num_targets = 2;
 
 	cb->incr_atom = XInternAtom(xfi->display, "INCR", FALSE);
+	cb->incr_max_size = (int) (XMaxRequestSize(xfi->display) * 4) - 32;
 }
 
 void xf_cliprdr_uninit(xfInfo* xfi)
@@ -152,84 +160,13 @@ void xf_cliprdr_uninit(xfInfo* xfi)
 		free(cb->formats);
 		free(cb->data);
 		free(cb->respond);
-		free(cb->incr_data);
+		clipboard_stream_free(cb->request_stream);
+		clipboard_stream_free(cb->incr_stream);
 		free(cb);
 		xfi->clipboard_context = NULL;
 	}
 }
 
-static BYTE* lf2crlf(BYTE* data, int* size)
-{
-	BYTE c;
-	BYTE* outbuf;
-	BYTE* out;
-	BYTE* in_end;
-	BYTE* in;
-	int out_size;
-
-	out_size = (*size) * 2 + 1;
-	outbuf = (BYTE*) xzalloc(out_size);
-	out = outbuf;
-	in = data;
-	in_end = data + (*size);
-
-	while (in < in_end)
-	{
-		c = *in++;
-		if (c == '\n')
-		{
-			*out++ = '\r';
-			*out++ = '\n';
-		}
-		else
-		{
-			*out++ = c;
-		}
-	}
-
-	*out++ = 0;
-	*size = out - outbuf;
-
-	return outbuf;
-}
-
-static void crlf2lf(BYTE* data, int* size)
-{
-	BYTE c;
-	BYTE* out;
-	BYTE* in;
-	BYTE* in_end;
-
-	out = data;
-	in = data;
-	in_end = data + (*size);
-
-	while (in < in_end)
-	{
-		c = *in++;
-
-		if (c != '\r')
-			*out++ = c;
-	}
-
-	*size = out - data;
-}
-
-static void be2le(BYTE* data, int size)
-{
-	BYTE c;
-
-	while (size >= 2)
-	{
-		c = data[0];
-		data[0] = data[1];
-		data[1] = c;
-
-		data += 2;
-		size -= 2;
-	}
-}
-
 static BOOL xf_cliprdr_is_self_owned(xfInfo* xfi)
 {
 	Atom type;
@@ -516,176 +453,45 @@ static void xf_cliprdr_get_requested_targets(xfInfo* xfi)
 	}
 }
 
-static BYTE* xf_cliprdr_process_requested_raw(BYTE* data, int* size)
-{
-	BYTE* outbuf;
-
-	outbuf = (BYTE*) malloc(*size);
-	memcpy(outbuf, data, *size);
-	return outbuf;
-}
-
-static BYTE* xf_cliprdr_process_requested_unicodetext(BYTE* data, int* size)
-{
-	char* inbuf;
-	WCHAR* outbuf;
-	int out_size;
-
-	inbuf = (char*) lf2crlf(data, size);
-	out_size = freerdp_AsciiToUnicodeAlloc(inbuf, &outbuf, 0);
-	free(inbuf);
-
-	*size = (int) ((out_size + 1) * 2);
-
-	return (BYTE*) outbuf;
-}
-
-static BYTE* xf_cliprdr_process_requested_text(BYTE* data, int* size)
+static void xf_cliprdr_begin_requested_data(xfInfo* xfi, int length)
 {
-	BYTE* outbuf;
-
-	outbuf = lf2crlf(data, size);
-
-	return outbuf;
-}
-
-static BYTE* xf_cliprdr_process_requested_dib(BYTE* data, int* size)
-{
-	BYTE* outbuf;
-
-	/* length should be at least BMP header (14) + sizeof(BITMAPINFOHEADER) */
-	if (*size < 54)
-	{
-		DEBUG_X11_CLIPRDR("bmp length %d too short", *size);
-		return NULL;
-	}
-
-	*size -= 14;
-	outbuf = (BYTE*) xzalloc(*size);
-	memcpy(outbuf, data + 14, *size);
-
-	return outbuf;
-}
-
-static BYTE* xf_cliprdr_process_requested_html(BYTE* data, int* size)
-{
-	char* inbuf;
-	BYTE* in;
-	BYTE* outbuf;
-	char num[11];
-
-	inbuf = NULL;
-
-	if (*size > 2)
-	{
-		if ((BYTE) data[0] == 0xFE && (BYTE) data[1] == 0xFF)
-		{
-			be2le(data, *size);
-		}
-
-		if ((BYTE) data[0] == 0xFF && (BYTE) data[1] == 0xFE)
-		{
-			freerdp_UnicodeToAsciiAlloc((WCHAR*) (data + 2), &inbuf, (*size - 2) / 2);
-		}
-	}
-
-	if (inbuf == NULL)
-	{
-		inbuf = xzalloc(*size + 1);
-		memcpy(inbuf, data, *size);
-	}
-
-	outbuf = (BYTE*) xzalloc(*size + 200);
-	strcpy((char*) outbuf,
-		"Version:0.9\r\n"
-		"StartHTML:0000000000\r\n"
-		"EndHTML:0000000000\r\n"
-		"StartFragment:0000000000\r\n"
-		"EndFragment:0000000000\r\n");
-
-	in = (BYTE*) strstr((char*) inbuf, "<body");
-	if (in == NULL)
-	{
-		in = (BYTE*) strstr((char*) inbuf, "<BODY");
-	}
-	/* StartHTML */
-	snprintf(num, sizeof(num), "%010lu", (unsigned long) strlen((char*) outbuf));
-	memcpy(outbuf + 23, num, 10);
-	if (in == NULL)
-	{
-		strcat((char*) outbuf, "<HTML><BODY>");
-	}
-	strcat((char*) outbuf, "<!--StartFragment-->");
-	/* StartFragment */
-	snprintf(num, sizeof(num), "%010lu", (unsigned long) strlen((char*) outbuf));
-	memcpy(outbuf + 69, num, 10);
-	strcat((char*) outbuf, (char*) inbuf);
-	/* EndFragment */
-	snprintf(num, sizeof(num), "%010lu", (unsigned long) strlen((char*) outbuf));
-	memcpy(outbuf + 93, num, 10);
-	strcat((char*) outbuf, "<!--EndFragment-->");
-	if (in == NULL)
-	{
-		strcat((char*) outbuf, "</BODY></HTML>");
-	}
-	/* EndHTML */
-	snprintf(num, sizeof(num), "%010lu", (unsigned long) strlen((char*) outbuf));
-	memcpy(outbuf + 43, num, 10);
-
-	*size = strlen((char*) outbuf) + 1;
-	free(inbuf);
+	clipboardContext* cb = (clipboardContext*) xfi->clipboard_context;
 
-	return outbuf;
+	clipboard_stream_free(cb->request_stream);
+	cb->request_stream = clipboard_stream_new(cb->format_mappings[cb->request_index].format_id, TRUE, length);
 }
 
-static void xf_cliprdr_process_requested_data(xfInfo* xfi, BOOL has_data, BYTE* data, int size)
+static void xf_cliprdr_process_requested_data(xfInfo* xfi, BOOL has_data)
 {
+	int size;
 	BYTE* outbuf;
 	clipboardContext* cb = (clipboardContext*) xfi->clipboard_context;
 
 	if (cb->incr_starts && has_data)
 		return;
 
-	if (!has_data || data == NULL)
+	if (!has_data || cb->request_stream == NULL)
 	{
+		clipboard_stream_free(cb->request_stream);
+		cb->request_stream = NULL;
+		cb->incr_starts = FALSE;
 		xf_cliprdr_send_null_data_response(xfi);
 		return;
 	}
 
-	switch (cb->format_mappings[cb->request_index].format_id)
+	if (clipboard_stream_finish(cb->request_stream))
 	{
-		case CB_FORMAT_RAW:
-		case CB_FORMAT_PNG:
-		case CB_FORMAT_JPEG:
-		case CB_FORMAT_GIF:
-			outbuf = xf_cliprdr_process_requested_raw(data, &size);
-			break;
-
-		case CB_FORMAT_UNICODETEXT:
-			outbuf = xf_cliprdr_process_requested_unicodetext(data, &size);
-			break;
-
-		case CB_FORMAT_TEXT:
-			outbuf = xf_cliprdr_process_requested_text(data, &size);
-			break;
-
-		case CB_FORMAT_DIB:
-			outbuf = xf_cliprdr_process_requested_dib(data, &size);
-			break;
-
-		case CB_FORMAT_HTML:
-			outbuf = xf_cliprdr_process_requested_html(data, &size);
-			break;
-
-		default:
-			outbuf = NULL;
-			break;
-	}
-
-	if (outbuf)
+		outbuf = clipboard_stream_detach(cb->request_stream, &size);
 		xf_cliprdr_send_data_response(xfi, outbuf, size);
+	}
 	else
+	{
+		DEBUG_X11_CLIPRDR("unable to convert format %d", cb->request_stream->format);
 		xf_cliprdr_send_null_data_response(xfi);
+	}
+
+	clipboard_stream_free(cb->request_stream);
+	cb->request_stream = NULL;
 
 	/* Resend the format list, otherwise the server won't request again for the next paste */
 	xf_cliprdr_send_format_list(xfi);
@@ -695,6 +501,7 @@ static BOOL xf_cliprdr_get_requested_data(xfInfo* xfi, Atom target)
 {
 	Atom type;
 	int format;
+	int length_hint;
 	BYTE* data = NULL;
 	BOOL has_data = FALSE;
 	unsigned long length, bytes_left, dummy;
@@ -728,13 +535,23 @@ static BOOL xf_cliprdr_get_requested_data(xfInfo* xfi, Atom target)
 	{
 		DEBUG_X11("INCR started");
 		cb->incr_starts = TRUE;
-		if (cb->incr_data)
+
+		/* The INCR property holds a lower bound of the data size */
+		length_hint = 0;
+		if (XGetWindowProperty(xfi->display, xfi->drawable,
+			cb->property_atom, 0, 1, 0, cb->incr_atom,
+			&type, &format, &length, &dummy, &data) == Success)
 		{
-			free(cb->incr_data);
-			cb->incr_data = NULL;
+			if (data && length > 0 && format == 32)
+				length_hint = (int) *((long*) data);
 		}
-		cb->incr_data_length = 0;
-		/* Data will be followed in PropertyNotify event */
+		if (data)
+		{
+			XFree(data);
+			data = NULL;
+		}
+		xf_cliprdr_begin_requested_data(xfi, length_hint);
+		/* Data will be followed in PropertyNotify event, and converted as it arrives */
 		has_data = TRUE;
 	}
 	else
@@ -742,11 +559,7 @@ static BOOL xf_cliprdr_get_requested_data(xfInfo* xfi, Atom target)
 		if (bytes_left <= 0)
 		{
 			/* INCR finish */
-			data = cb->incr_data;
-			cb->incr_data = NULL;
-			bytes_left = cb->incr_data_length;
-			cb->incr_data_length = 0;
-			cb->incr_starts = 0;
+			cb->incr_starts = FALSE;
 			DEBUG_X11("INCR finished");
 			has_data = TRUE;
 		}
@@ -754,16 +567,14 @@ static BOOL xf_cliprdr_get_requested_data(xfInfo* xfi, Atom target)
 			cb->property_atom, 0, bytes_left, 0, target,
 			&type, &format, &length, &dummy, &data) == Success)
 		{
-			if (cb->incr_starts)
-			{
-				bytes_left = length * format / 8;
-				DEBUG_X11("%d bytes", (int)bytes_left);
-				cb->incr_data = (BYTE*) realloc(cb->incr_data, cb->incr_data_length + bytes_left);
-				memcpy(cb->incr_data + cb->incr_data_length, data, bytes_left);
-				cb->incr_data_length += bytes_left;
-				XFree(data);
-				data = NULL;
-			}
+			if (!cb->incr_starts)
+				xf_cliprdr_begin_requested_data(xfi, (int) bytes_left);
+			bytes_left = length * format / 8;
+			DEBUG_X11("%d bytes", (int)bytes_left);
+			if (cb->request_stream)
+				clipboard_stream_write(cb->request_stream, data, (int) bytes_left);
+			XFree(data);
+			data = NULL;
 			has_data = TRUE;
 		}
 		else
@@ -773,10 +584,7 @@ static BOOL xf_cliprdr_get_requested_data(xfInfo* xfi, Atom target)
 	}
 	XDeleteProperty(xfi->display, xfi->drawable, cb->property_atom);
 
-	xf_cliprdr_process_requested_data(xfi, has_data, data, (int) bytes_left);
-
-	if (data)
-		XFree(data);
+	xf_cliprdr_process_requested_data(xfi, has_data);
 
 	return TRUE;
 }
@@ -811,18 +619,134 @@ static void xf_cliprdr_provide_targets(xfInfo* xfi, XEvent* respond)
 	}
 }
 
+static void xf_cliprdr_end_incr(xfInfo* xfi)
+{
+	clipboardContext* cb = (clipboardContext*) xfi->clipboard_context;
+
+	XSelectInput(xfi->display, cb->incr_requestor, NoEventMask);
+	clipboard_stream_free(cb->incr_stream);
+	cb->incr_stream = NULL;
+	cb->incr_requestor = None;
+}
+
+static void xf_cliprdr_free_data(xfInfo* xfi)
+{
+	clipboardContext* cb = (clipboardContext*) xfi->clipboard_context;
+
+	if (cb->incr_requestor != None)
+		xf_cliprdr_end_incr(xfi);
+
+	if (cb->data)
+	{
+		free(cb->data);
+		cb->data = NULL;
+	}
+	cb->data_length = 0;
+}
+
+static void xf_cliprdr_provide_incr_data(xfInfo* xfi)
+{
+	int size;
+	CLIPBOARD_STREAM* stream;
+	clipboardContext* cb = (clipboardContext*) xfi->clipboard_context;
+
+	/* Convert just enough data for the next piece, the output stays below the request size */
+	stream = cb->incr_stream;
+	stream->length = 0;
+
+	while ((stream->length < cb->incr_max_size / 2) && (cb->incr_offset < cb->data_length))
+	{
+		size = cb->data_length - cb->incr_offset;
+		if (size > cb->incr_max_size / 4)
+			size = cb->incr_max_size / 4;
+
+		clipboard_stream_write(stream, &cb->data[cb->incr_offset], size);
+		cb->incr_offset += size;
+
+		if (cb->incr_offset >= cb->data_length)
+			clipboard_stream_finish(stream);
+	}
+
+	if (stream->failed)
+	{
+		DEBUG_X11_CLIPRDR("unable to convert format %d", stream->format);
+		stream->length = 0;
+	}
+
+	DEBUG_X11_CLIPRDR("INCR %d bytes", stream->length);
+
+	XChangeProperty(xfi->display, cb->incr_requestor, cb->incr_property,
+		cb->incr_target, 8, PropModeReplace, stream->data, stream->length);
+
+	/* A zero-length property ends the transfer */
+	if (stream->length == 0)
+		xf_cliprdr_end_incr(xfi);
+
+	XFlush(xfi->display);
+}
+
 static void xf_cliprdr_provide_data(xfInfo* xfi, XEvent* respond)
 {
+	long length;
+	CLIPBOARD_STREAM* stream;
 	clipboardContext* cb = (clipboardContext*) xfi->clipboard_context;
 
-	if (respond->xselection.property != None)
+	if (respond->xselection.property == None)
+		return;
+
+	/* The data is kept as received from the server and converted each time it is provided */
+	stream = clipboard_stream_new(cb->data_format, FALSE, cb->data_length);
+
+	if (stream == NULL)
+	{
+		respond->xselection.property = None;
+		return;
+	}
+
+	if (cb->data_length > cb->incr_max_size / 2)
+	{
+		if (cb->incr_requestor != None)
+		{
+			DEBUG_X11_CLIPRDR("INCR transfer already in progress");
+			clipboard_stream_free(stream);
+			respond->xselection.property = None;
+			return;
+		}
+
+		/* Too large for a single request, the requestor reads it in pieces */
+		cb->incr_stream = stream;
+		cb->incr_requestor = respond->xselection.requestor;
+		cb->incr_property = respond->xselection.property;
+		cb->incr_target = respond->xselection.target;
+		cb->incr_offset = 0;
+
+		XSelectInput(xfi->display, cb->incr_requestor, PropertyChangeMask);
+
+		length = cb->data_length;
+		XChangeProperty(xfi->display,
+			respond->xselection.requestor,
+			respond->xselection.property,
+			cb->incr_atom, 32, PropModeReplace,
+			(BYTE*) &length, 1);
+		return;
+	}
+
+	if (clipboard_stream_write(stream, cb->data, cb->data_length) &&
+		clipboard_stream_finish(stream))
 	{
 		XChangeProperty(xfi->display,
 			respond->xselection.requestor,
 			respond->xselection.property,
 			respond->xselection.target, 8, PropModeReplace,
-			(BYTE*) cb->data, cb->data_length);
+			stream->data, stream->length);
 	}
+	else
+	{
+		DEBUG_X11_CLIPRDR("unable to convert format %d", cb->data_format);
+		respond->xselection.property = None;
+	}
+
+	clipboard_stream_free(stream);
 }
 
 static void xf_cliprdr_process_cb_format_list_event(xfInfo* xfi, RDP_CB_FORMAT_LIST_EVENT* event)
@@ -830,11 +754,7 @@ static void xf_cliprdr_process_cb_format_list_event(xfInfo* xfi, RDP_CB_FORMAT_L
 	int i, j;
 	clipboardContext* cb = (clipboardContext*) xfi->clipboard_context;
 
-	if (cb->data)
-	{
-		free(cb->data);
-		cb->data = NULL;
-	}
+	xf_cliprdr_free_data(xfi);
 
 	if (cb->formats)
 		free(cb->formats);
@@ -868,87 +788,6 @@ static void xf_cliprdr_process_cb_format_list_event(xfInfo* xfi, RDP_CB_FORMAT_L
 	XFlush(xfi->display);
 }
 
-static void xf_cliprdr_process_text(clipboardContext* cb, BYTE* data, int size)
-{
-	cb->data = (BYTE*) malloc(size);
-	memcpy(cb->data, data, size);
-	cb->data_length = size;
-	crlf2lf(cb->data, &cb->data_length);
-}
-
-static void xf_cliprdr_process_unicodetext(clipboardContext* cb, BYTE* data, int size)
-{
-	cb->data_length = freerdp_UnicodeToAsciiAlloc((WCHAR*) data, (CHAR**) &(cb->data), size / 2);
-	crlf2lf(cb->data, &cb->data_length);
-}
-
-static void xf_cliprdr_process_dib(clipboardContext* cb, BYTE* data, int size)
-{
-	STREAM* s;
-	UINT16 bpp;
-	UINT32 offset;
-	UINT32 ncolors;
-
-	/* size should be at least sizeof(BITMAPINFOHEADER) */
-	if (size < 40)
-	{
-		DEBUG_X11_CLIPRDR("dib size %d too short", size);
-		return;
-	}
-
-	s = stream_new(0);
-	stream_attach(s, data, size);
-	stream_seek(s, 14);
-	stream_read_UINT16(s, bpp);
-	stream_read_UINT32(s, ncolors);
-	offset = 14 + 40 + (bpp <= 8 ? (ncolors == 0 ? (1 << bpp) : ncolors) * 4 : 0);
-	stream_detach(s);
-	stream_free(s);
-
-	DEBUG_X11_CLIPRDR("offset=%d bpp=%d ncolors=%d", offset, bpp, ncolors);
-
-	s = stream_new(14 + size);
-	stream_write_BYTE(s, 'B');
-	stream_write_BYTE(s, 'M');
-	stream_write_UINT32(s, 14 + size);
-	stream_write_UINT32(s, 0);
-	stream_write_UINT32(s, offset);
-	stream_write(s, data, size);
-
-	cb->data = stream_get_head(s);
-	cb->data_length = stream_get_length(s);
-	stream_detach(s);
-	stream_free(s);
-}
-
-static void xf_cliprdr_process_html(clipboardContext* cb, BYTE* data, int size)
-{
-	char* start_str;
-	char* end_str;
-	int start;
-	int end;
-
-	start_str = strstr((char*) data, "StartHTML:");
-	end_str = strstr((char*) data, "EndHTML:");
-	if (start_str == NULL || end_str == NULL)
-	{
-		DEBUG_X11_CLIPRDR("invalid HTML clipboard format");
-		return;
-	}
-	start = atoi(start_str + 10);
-	end = atoi(end_str + 8);
-	if (start > size || end > size || start >= end)
-	{
-		DEBUG_X11_CLIPRDR("invalid HTML offset");
-		return;
-	}
-
-	cb->data = (BYTE*) malloc(size - start + 1);
-	memcpy(cb->data, data + start, end - start);
-	cb->data_length = end - start;
-	crlf2lf(cb->data, &cb->data_length);
-}
-
 static void xf_cliprdr_process_cb_data_response_event(xfInfo* xfi, RDP_CB_DATA_RESPONSE_EVENT* event)
 {
 	clipboardContext* cb = (clipboardContext*) xfi->clipboard_context;
@@ -967,43 +806,13 @@ static void xf_cliprdr_process_cb_data_response_event(xfInfo* xfi, RDP_CB_DATA_R
 	}
 	else
 	{
-		if (cb->data)
-		{
-			free(cb->data);
-			cb->data = NULL;
-		}
-		switch (cb->data_format)
-		{
-			case CB_FORMAT_RAW:
-			case CB_FORMAT_PNG:
-			case CB_FORMAT_JPEG:
-			case CB_FORMAT_GIF:
-				cb->data = event->data;
-				cb->data_length = event->size;
-				event->data = NULL;
-				event->size = 0;
-				break;
-
-			case CB_FORMAT_TEXT:
-				xf_cliprdr_process_text(cb, event->data, event->size);
-				break;
-
-			case CB_FORMAT_UNICODETEXT:
-				xf_cliprdr_process_unicodetext(cb, event->data, event->size);
-				break;
-
-			case CB_FORMAT_DIB:
-				xf_cliprdr_process_dib(cb, event->data, event->size);
-				break;
-
-			case CB_FORMAT_HTML:
-				xf_cliprdr_process_html(cb, event->data, event->size);
-				break;
-
-			default:
-				cb->respond->xselection.property = None;
-				break;
-		}
+		/* The channel delivers the whole response at once, take it over and convert it when provided */
+		xf_cliprdr_free_data(xfi);
+		cb->data = event->data;
+		cb->data_length = event->size;
+		event->data = NULL;
+		event->size = 0;
+
 		xf_cliprdr_provide_data(xfi, cb->respond);
 	}
 
@@ -1147,11 +956,7 @@ BOOL xf_cliprdr_process_selection_request(xfInfo* xfi, XEvent* xevent)
 				 * Send clipboard data request to the server.
 				 * Response will be postponed after receiving the data
 				 */
-				if (cb->data)
-				{
-					free(cb->data);
-					cb->data = NULL;
-				}
+				xf_cliprdr_free_data(xfi);
 
 				respond->xselection.property = xevent->xselectionrequest.property;
 				cb->respond = respond;
@@ -1190,6 +995,18 @@ BOOL xf_cliprdr_process_property_notify(xfInfo* xfi, XEvent* xevent)
 {
 	clipboardContext* cb = (clipboardContext*) xfi->clipboard_context;
 
+	if ((cb->incr_requestor != None) && (xevent->xproperty.window == cb->incr_requestor))
+	{
+		/* The requestor deleted the last piece, send the next one */
+		if (xevent->xproperty.atom == cb->incr_property &&
+			xevent->xproperty.state == PropertyDelete)
+		{
+			xf_cliprdr_provide_incr_data(xfi);
+		}
+
+		return TRUE;
+	}
+
 	if (xevent->xproperty.atom != cb->property_atom)
 		return FALSE; /* Not cliprdr-related */
 
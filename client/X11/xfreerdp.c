@@ -50,6 +50,7 @@
 #include <freerdp/codec/rfx.h>
 #include <freerdp/codec/color.h>
 #include <freerdp/codec/bitmap.h>
+#include <freerdp/gdi/rop.h>
 #include <freerdp/utils/args.h>
 #include <freerdp/utils/memory.h>
 #include <freerdp/utils/event.h>
@@ -654,17 +655,36 @@ void cpuid(unsigned info, unsigned *eax, unsigned *ebx, unsigned *ecx, unsigned
 		"xchg %%rbx, %%rsi;"
 #endif
 		: "=a" (*eax), "=S" (*ebx), "=c" (*ecx), "=d" (*edx)
-		: "0" (info)
+		: "0" (info), "2" (0)
 	);
 #endif
 #endif
 }
 
+/* Returns the state components enabled by the OS in XCR0 */
+unsigned xgetbv()
+{
+	unsigned eax = 0, edx = 0;
+#ifdef __GNUC__
+#if defined(__i386__) || defined(__x86_64__)
+	__asm volatile
+	(
+		".byte 0x0f, 0x01, 0xd0;" /* xgetbv */
+		: "=a" (eax), "=d" (edx)
+		: "c" (0)
+	);
+#endif
+#endif
+	return eax;
+}
+
 UINT32 xf_detect_cpu()
 {
 	unsigned int eax, ebx, ecx, edx = 0;
+	unsigned int max_level;
 	UINT32 cpu_opt = 0;
 
+	cpuid(0, &max_level, &ebx, &ecx, &edx);
 	cpuid(1, &eax, &ebx, &ecx, &edx);
 
 	if (edx & (1<<26)) 
@@ -673,6 +693,18 @@ UINT32 xf_detect_cpu()
 		cpu_opt |= CPU_SSE2;
 	}
 
+	/* AVX2 needs the OS to save the YMM registers (OSXSAVE, AVX and XCR0) */
+	if ((max_level >= 7) && (ecx & (1<<27)) && (ecx & (1<<28)) && ((xgetbv() & 6) == 6))
+	{
+		cpuid(7, &eax, &ebx, &ecx, &edx);
+
+		if (ebx & (1<<5))
+		{
+			DEBUG("AVX2 detected");
+			cpu_opt |= CPU_AVX2;
+		}
+	}
+
 	return cpu_opt;
 }
 
@@ -730,6 +762,7 @@ BOOL xf_post_connect(freerdp* instance)
 		if (instance->settings->rfx_codec)
 		{
 			rfx_context = (void*) rfx_context_new();
+			((RFX_CONTEXT*) rfx_context)->metrics = instance->context->metrics;
 			xfi->rfx_context = rfx_context;
 		}
 
@@ -747,6 +780,8 @@ BOOL xf_post_connect(freerdp* instance)
 		rfx_context_set_cpu_opt(rfx_context, cpu);
 	if (nsc_context)
 		nsc_context_set_cpu_opt(nsc_context, cpu);
+	if (xfi->sw_gdi)
+		gdi_rop_set_cpu_opt(cpu);
 #endif
 
 	xfi->width = instance->settings->width;
@@ -195,14 +195,14 @@ void freerdp_client_parse_rdp_file_integer_unicode(rdpFile* file, WCHAR* name, W
 	char* nameA;
 	char* valueA;
 
-	length = _wcslen(name);
+	length = WideCharToMultiByte(CP_UTF8, 0, name, _wcslen(name), NULL, 0, NULL, NULL);
 	nameA = (char*) malloc(length + 1);
-	WideCharToMultiByte(CP_UTF8, 0, name, length, nameA, length, NULL, NULL);
+	WideCharToMultiByte(CP_UTF8, 0, name, _wcslen(name), nameA, length, NULL, NULL);
 	nameA[length] = '\0';
 
-	length = _wcslen(value);
+	length = WideCharToMultiByte(CP_UTF8, 0, value, _wcslen(value), NULL, 0, NULL, NULL);
 	valueA = (char*) malloc(length + 1);
-	WideCharToMultiByte(CP_UTF8, 0, value, length, valueA, length, NULL, NULL);
+	WideCharToMultiByte(CP_UTF8, 0, value, _wcslen(value), valueA, length, NULL, NULL);
 	valueA[length] = '\0';
 
 	ivalue = atoi(valueA);
@@ -272,14 +272,14 @@ void freerdp_client_parse_rdp_file_string_unicode(rdpFile* file, WCHAR* name, WC
 	char* nameA;
 	char* valueA;
 
-	length = _wcslen(name);
+	length = WideCharToMultiByte(CP_UTF8, 0, name, _wcslen(name), NULL, 0, NULL, NULL);
 	nameA = (char*) malloc(length + 1);
-	WideCharToMultiByte(CP_UTF8, 0, name, length, nameA, length, NULL, NULL);
+	WideCharToMultiByte(CP_UTF8, 0, name, _wcslen(name), nameA, length, NULL, NULL);
 	nameA[length] = '\0';
 
-	length = _wcslen(value);
+	length = WideCharToMultiByte(CP_UTF8, 0, value, _wcslen(value), NULL, 0, NULL, NULL);
 	valueA = (char*) malloc(length + 1);
-	WideCharToMultiByte(CP_UTF8, 0, value, length, valueA, length, NULL, NULL);
+	WideCharToMultiByte(CP_UTF8, 0, value, _wcslen(value), valueA, length, NULL, NULL);
 	valueA[length] = '\0';
 
 	if (!freerdp_client_rdp_file_set_string(file, nameA, valueA))
@@ -16,6 +16,12 @@ else()
 	option(WITH_SSE2 "Enable SSE2 optimization." OFF)
 endif()
 
+if((TARGET_ARCH MATCHES "x86|x64") AND (NOT DEFINED WITH_AVX2))
+	option(WITH_AVX2 "Enable AVX2 optimization." ON)
+else()
+	option(WITH_AVX2 "Enable AVX2 optimization." OFF)
+endif()
+
 if((TARGET_ARCH MATCHES "ARM") AND (NOT DEFINED WITH_NEON))
 	option(WITH_NEON "Enable NEON optimization." ON)
 else()
@@ -35,6 +41,7 @@ endif()
 
 option(BUILD_TESTING "Build unit tests" OFF)
 option(WITH_SAMPLE "Build sample code" OFF)
+option(WITH_REPLAY "Build the session replay benchmark" OFF)
 
 if(${CMAKE_VERSION} VERSION_GREATER 2.8.8)
 	if(ANDROID)
@@ -0,0 +1,204 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Clipboard Format Conversion Unit Tests
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <freerdp/freerdp.h>
+#include <freerdp/utils/memory.h>
+#include <freerdp/utils/stream.h>
+#include <freerdp/utils/clipboard.h>
+#include <freerdp/client/cliprdr.h>
+
+#include "test_clipboard.h"
+
+int init_clipboard_suite(void)
+{
+	return 0;
+}
+
+int clean_clipboard_suite(void)
+{
+	return 0;
+}
+
+int add_clipboard_suite(void)
+{
+	add_test_suite(clipboard);
+
+	add_test_function(clipboard_text);
+	add_test_function(clipboard_unicodetext);
+	add_test_function(clipboard_html);
+	add_test_function(clipboard_dib);
+
+	return 0;
+}
+
+static const int test_chunk_sizes[] = { 1, 2, 3, 5, 7, 64, 0x7FFFFFFF };
+
+static BYTE* test_clipboard_convert(UINT32 format, BOOL encode, BYTE* data, int size, int chunk, int* length)
+{
+	int offset;
+	int count;
+	BYTE* output;
+	CLIPBOARD_STREAM* stream;
+
+	stream = clipboard_stream_new(format, encode, size);
+
+	for (offset = 0; offset < size; offset += count)
+	{
+		count = (size - offset < chunk) ? size - offset : chunk;
+		clipboard_stream_write(stream, &data[offset], count);
+	}
+
+	if (!clipboard_stream_finish(stream))
+	{
+		clipboard_stream_free(stream);
+		*length = -1;
+		return NULL;
+	}
+
+	output = clipboard_stream_detach(stream, length);
+	clipboard_stream_free(stream);
+
+	return output;
+}
+
+/* the result must not depend on how the input is split into chunks */
+
+static void test_clipboard_check(UINT32 format, BOOL encode, BYTE* data, int size, BYTE* expected, int expected_length)
+{
+	int i;
+	int length;
+	BYTE* output;
+
+	for (i = 0; i < ARRAY_SIZE(test_chunk_sizes); i++)
+	{
+		output = test_clipboard_convert(format, encode, data, size, test_chunk_sizes[i], &length);
+
+		CU_ASSERT(length == expected_length);
+
+		if ((length == expected_length) && (length > 0))
+			CU_ASSERT(memcmp(output, expected, length) == 0);
+
+		free(output);
+	}
+}
+
+void test_clipboard_text(void)
+{
+	test_clipboard_check(CB_FORMAT_TEXT, TRUE, (BYTE*) "a\nb\r\nc\n", 7, (BYTE*) "a\r\nb\r\nc\r\n", 10);
+	test_clipboard_check(CB_FORMAT_TEXT, FALSE, (BYTE*) "a\r\nb\r\r\nc\0xyz", 12, (BYTE*) "a\nb\r\nc", 6);
+	test_clipboard_check(CB_FORMAT_TEXT, FALSE, (BYTE*) "ab\r", 3, (BYTE*) "ab\r", 3);
+}
+
+static const BYTE test_utf8_text[] = "h\xC3\xA9llo\n\xE2\x82\xAC\xF0\x9D\x84\x9E\r\nend";
+
+static const BYTE test_utf16_text[] =
+	"\x68\x00\xE9\x00\x6C\x00\x6C\x00\x6F\x00\x0D\x00\x0A\x00\xAC\x20"
+	"\x34\xD8\x1E\xDD\x0D\x00\x0A\x00\x65\x00\x6E\x00\x64\x00\x00\x00";
+
+static const BYTE test_utf8_lf_text[] = "h\xC3\xA9llo\n\xE2\x82\xAC\xF0\x9D\x84\x9E\nend";
+
+void test_clipboard_unicodetext(void)
+{
+	BYTE data[64];
+
+	test_clipboard_check(CB_FORMAT_UNICODETEXT, TRUE, (BYTE*) test_utf8_text, sizeof(test_utf8_text) - 1,
+		(BYTE*) test_utf16_text, sizeof(test_utf16_text) - 1);
+
+	/* anything after the terminator is ignored */
+	memcpy(data, test_utf16_text, sizeof(test_utf16_text) - 1);
+	memcpy(&data[sizeof(test_utf16_text) - 1], "\x41\x00\x42\x00", 4);
+
+	test_clipboard_check(CB_FORMAT_UNICODETEXT, FALSE, data, sizeof(test_utf16_text) + 3,
+		(BYTE*) test_utf8_lf_text, sizeof(test_utf8_lf_text) - 1);
+
+	/* truncated sequences are replaced, not dropped */
+	test_clipboard_check(CB_FORMAT_UNICODETEXT, TRUE, (BYTE*) "a\xE2\x82", 3,
+		(BYTE*) "\x61\x00\xFD\xFF\x00\x00", 6);
+}
+
+void test_clipboard_html(void)
+{
+	char expected[256];
+	const char* body;
+	const char* header =
+		"Version:0.9\r\n"
+		"StartHTML:%010d\r\n"
+		"EndHTML:%010d\r\n"
+		"StartFragment:%010d\r\n"
+		"EndFragment:%010d\r\n";
+
+	/* a fragment is wrapped in a document */
+	sprintf(expected, header, 105, 178, 137, 146);
+	strcat(expected, "<HTML><BODY><!--StartFragment--><b>hi</b><!--EndFragment--></BODY></HTML>");
+
+	test_clipboard_check(CB_FORMAT_HTML, TRUE, (BYTE*) "<b>hi</b>", 9, (BYTE*) expected, strlen(expected) + 1);
+
+	body = "<HTML><BODY><!--StartFragment--><b>hi</b><!--EndFragment--></BODY></HTML>";
+	test_clipboard_check(CB_FORMAT_HTML, FALSE, (BYTE*) expected, strlen(expected) + 1, (BYTE*) body, strlen(body));
+
+	/* a UTF-16 document with a byte order mark */
+	sprintf(expected, header, 105, 157, 125, 139);
+	strcat(expected, "<!--StartFragment--><body>x</body><!--EndFragment-->");
+
+	test_clipboard_check(CB_FORMAT_HTML, TRUE,
+		(BYTE*) "\xFF\xFE<\0b\0o\0d\0y\0>\0x\0<\0/\0b\0o\0d\0y\0>\0", 30,
+		(BYTE*) expected, strlen(expected) + 1);
+
+	test_clipboard_check(CB_FORMAT_HTML, TRUE,
+		(BYTE*) "\xFE\xFF\0<\0b\0o\0d\0y\0>\0x\0<\0/\0b\0o\0d\0y\0>", 30,
+		(BYTE*) expected, strlen(expected) + 1);
+
+	test_clipboard_check(CB_FORMAT_HTML, FALSE, (BYTE*) "Version:0.9\r\nStartHTML:x", 24, NULL, -1);
+}
+
+void test_clipboard_dib(void)
+{
+	STREAM* s;
+	BYTE bmp[66];
+
+	s = stream_new(0);
+	stream_attach(s, bmp, sizeof(bmp));
+	stream_write_BYTE(s, 'B');
+	stream_write_BYTE(s, 'M');
+	stream_write_UINT32(s, sizeof(bmp)); /* bfSize */
+	stream_write_UINT32(s, 0); /* bfReserved1, bfReserved2 */
+	stream_write_UINT32(s, 62); /* bfOffBits */
+	stream_write_UINT32(s, 40); /* biSize */
+	stream_write_UINT32(s, 1); /* biWidth */
+	stream_write_UINT32(s, 1); /* biHeight */
+	stream_write_UINT16(s, 1); /* biPlanes */
+	stream_write_UINT16(s, 1); /* biBitCount */
+	stream_write_UINT32(s, 0); /* biCompression */
+	stream_write_zero(s, 12); /* biSizeImage, biXPelsPerMeter, biYPelsPerMeter */
+	stream_write_UINT32(s, 2); /* biClrUsed */
+	stream_write_UINT32(s, 0); /* biClrImportant */
+	stream_write_UINT32(s, 0x00000000); /* palette */
+	stream_write_UINT32(s, 0x00FFFFFF);
+	stream_write_UINT32(s, 0x80000000); /* pixels */
+	stream_detach(s);
+	stream_free(s);
+
+	test_clipboard_check(CB_FORMAT_DIB, TRUE, bmp, sizeof(bmp), &bmp[14], sizeof(bmp) - 14);
+	test_clipboard_check(CB_FORMAT_DIB, FALSE, &bmp[14], sizeof(bmp) - 14, bmp, sizeof(bmp));
+
+	test_clipboard_check(CB_FORMAT_DIB, TRUE, bmp, 53, NULL, -1);
+	test_clipboard_check(CB_FORMAT_DIB, FALSE, &bmp[14], 39, NULL, -1);
+}
@@ -20,12 +20,14 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <sys/time.h>
 #include <freerdp/freerdp.h>
 #include <freerdp/constants.h>
 #include <freerdp/channels/channels.h>
 #include <freerdp/utils/event.h>
 #include <freerdp/utils/hexdump.h>
 #include <freerdp/utils/memory.h>
+#include <freerdp/utils/clipboard.h>
 #include <freerdp/client/cliprdr.h>
 
 #include "test_cliprdr.h"
@@ -47,6 +49,8 @@ int add_cliprdr_suite(void)
 	add_test_suite(cliprdr);
 
 	add_test_function(cliprdr);
+	add_test_function(cliprdr_oversized);
+	add_test_function(cliprdr_benchmark);
 
 	return 0;
 }
@@ -246,3 +250,226 @@ void test_cliprdr(void)
 	freerdp_channels_close(channels, &instance);
 	freerdp_channels_free(channels);
 }
+
+/* a format data response too large to be reassembled fails the request */
+void test_cliprdr_oversized(void)
+{
+	rdpChannels* channels;
+	rdpSettings settings = { 0 };
+	freerdp instance = { 0 };
+	RDP_EVENT* event;
+
+	settings.hostname = "testhost";
+	instance.settings = &settings;
+	instance.SendChannelData = test_rdp_channel_data;
+
+	channels = freerdp_channels_new();
+
+	freerdp_channels_load_plugin(channels, &settings, "../channels/cliprdr/cliprdr.so", NULL);
+	freerdp_channels_pre_connect(channels, &instance);
+	freerdp_channels_post_connect(channels, &instance);
+
+	/* first fragment of a response announcing more than the channel accepts */
+	freerdp_channels_data(&instance, 0, (char*)test_data_response_data, sizeof(test_data_response_data) - 1,
+		CHANNEL_FLAG_FIRST, 0x7FFFFFFF);
+
+	while ((event = freerdp_channels_pop_event(channels)) == NULL)
+	{
+		freerdp_channels_check_fds(channels, &instance);
+	}
+
+	CU_ASSERT(event->event_type == RDP_EVENT_TYPE_CB_DATA_RESPONSE);
+	if (event->event_type == RDP_EVENT_TYPE_CB_DATA_RESPONSE)
+		CU_ASSERT(((RDP_CB_DATA_RESPONSE_EVENT*) event)->size == 0);
+	freerdp_event_free(event);
+
+	freerdp_channels_close(channels, &instance);
+	freerdp_channels_free(channels);
+}
+
+#define TEST_BENCHMARK_SIZE		(32 * 1024 * 1024)
+#define TEST_INCR_CHUNK_SIZE		(256 * 1024)
+#define TEST_MAX_REQUEST_SIZE		(65535 * 4 - 32)
+
+static int test_sent_length;
+
+static int test_count_channel_data(freerdp* instance, int chan_id, BYTE* data, int data_size)
+{
+	test_sent_length += data_size;
+	return 0;
+}
+
+static long test_cliprdr_elapsed(struct timeval* start_time)
+{
+	struct timeval end_time;
+
+	gettimeofday(&end_time, NULL);
+
+	return ((end_time.tv_sec - start_time->tv_sec) * 1000000) + (end_time.tv_usec - start_time->tv_usec);
+}
+
+/**
+ * A synthetic server pastes a large log excerpt to the client over the
+ * channel, fragmented as it would be on the wire. The response is then
+ * provided to an X11 requestor piece by piece, the way the X11 client does.
+ * The same excerpt is copied back, read in INCR chunks and converted as it
+ * arrives before it is sent to the server.
+ */
+
+void test_cliprdr_benchmark(void)
+{
+	int size;
+	int peak;
+	int count;
+	int flags;
+	int offset;
+	int length;
+	long duration;
+	BYTE* log;
+	BYTE* pdu;
+	BYTE* wire;
+	BYTE* output;
+	rdpChannels* channels;
+	rdpSettings settings = { 0 };
+	freerdp instance = { 0 };
+	RDP_EVENT* event;
+	CLIPBOARD_STREAM* stream;
+	RDP_CB_DATA_RESPONSE_EVENT* data_response_event;
+	struct timeval start_time;
+
+	settings.hostname = "testhost";
+	instance.settings = &settings;
+	instance.SendChannelData = test_count_channel_data;
+
+	channels = freerdp_channels_new();
+
+	freerdp_channels_load_plugin(channels, &settings, "../channels/cliprdr/cliprdr.so", NULL);
+	freerdp_channels_pre_connect(channels, &instance);
+	freerdp_channels_post_connect(channels, &instance);
+
+	log = (BYTE*) malloc(TEST_BENCHMARK_SIZE + 128);
+
+	for (size = 0; size < TEST_BENCHMARK_SIZE; )
+	{
+		size += sprintf((char*) &log[size], "2013-02-01 12:%02d:%02d connexion %d accept\xC3\xA9" "e depuis 10.0.%d.%d\n",
+			(size / 60) % 60, size % 60, size, (size >> 8) & 0xFF, size & 0xFF);
+	}
+
+	/* the server's format data response, as CF_UNICODETEXT */
+	stream = clipboard_stream_new(CB_FORMAT_UNICODETEXT, TRUE, size);
+	clipboard_stream_write(stream, log, size);
+	clipboard_stream_finish(stream);
+
+	length = stream->length + 8;
+	pdu = (BYTE*) malloc(length);
+	pdu[0] = 0x05; /* CB_FORMAT_DATA_RESPONSE */
+	pdu[1] = 0x00;
+	pdu[2] = 0x01; /* CB_RESPONSE_OK */
+	pdu[3] = 0x00;
+	pdu[4] = stream->length & 0xFF;
+	pdu[5] = (stream->length >> 8) & 0xFF;
+	pdu[6] = (stream->length >> 16) & 0xFF;
+	pdu[7] = (stream->length >> 24) & 0xFF;
+	memcpy(&pdu[8], stream->data, stream->length);
+	clipboard_stream_free(stream);
+
+	gettimeofday(&start_time, NULL);
+
+	for (offset = 0; offset < length; offset += count)
+	{
+		count = (length - offset < CHANNEL_CHUNK_LENGTH) ? length - offset : CHANNEL_CHUNK_LENGTH;
+		flags = (offset == 0) ? CHANNEL_FLAG_FIRST : 0;
+		flags |= (offset + count == length) ? CHANNEL_FLAG_LAST : 0;
+		freerdp_channels_data(&instance, 0, (char*) &pdu[offset], count, flags, length);
+	}
+
+	while ((event = freerdp_channels_pop_event(channels)) == NULL)
+	{
+		freerdp_channels_check_fds(channels, &instance);
+	}
+
+	CU_ASSERT(event->event_type == RDP_EVENT_TYPE_CB_DATA_RESPONSE);
+	data_response_event = (RDP_CB_DATA_RESPONSE_EVENT*) event;
+	wire = data_response_event->data;
+	length = data_response_event->size;
+
+	peak = 0;
+	offset = 0;
+	output = (BYTE*) malloc(size);
+	stream = clipboard_stream_new(CB_FORMAT_UNICODETEXT, FALSE, length);
+
+	for (count = 0; offset < length; )
+	{
+		stream->length = 0;
+
+		while ((stream->length < TEST_MAX_REQUEST_SIZE / 2) && (offset < length))
+		{
+			clipboard_stream_write(stream, &wire[offset], (length - offset < TEST_MAX_REQUEST_SIZE / 4) ?
+				length - offset : TEST_MAX_REQUEST_SIZE / 4);
+			offset += TEST_MAX_REQUEST_SIZE / 4;
+
+			if (offset >= length)
+				clipboard_stream_finish(stream);
+		}
+
+		if (stream->length > peak)
+			peak = stream->length;
+
+		if (count + stream->length <= size)
+			memcpy(&output[count], stream->data, stream->length);
+
+		count += stream->length;
+	}
+
+	duration = test_cliprdr_elapsed(&start_time);
+	printf("\ncliprdr paste from server: %d MB in %ld us (%.1f MB/s), largest piece %d bytes", size >> 20, duration,
+		(double) size / (duration > 0 ? duration : 1), peak);
+
+	CU_ASSERT(peak <= TEST_MAX_REQUEST_SIZE);
+	CU_ASSERT(stream->size <= 4 * TEST_MAX_REQUEST_SIZE);
+	CU_ASSERT(count == size);
+	CU_ASSERT(memcmp(output, log, size) == 0);
+
+	clipboard_stream_free(stream);
+	freerdp_event_free(event);
+	free(output);
+	free(pdu);
+
+	/* the client reads the excerpt from an X11 INCR transfer and sends it to the server */
+	gettimeofday(&start_time, NULL);
+
+	stream = clipboard_stream_new(CB_FORMAT_UNICODETEXT, TRUE, size);
+
+	for (offset = 0; offset < size; offset += count)
+	{
+		count = (size - offset < TEST_INCR_CHUNK_SIZE) ? size - offset : TEST_INCR_CHUNK_SIZE;
+		clipboard_stream_write(stream, &log[offset], count);
+	}
+
+	CU_ASSERT(clipboard_stream_finish(stream));
+
+	event = freerdp_event_new(RDP_EVENT_CLASS_CLIPRDR, RDP_EVENT_TYPE_CB_DATA_RESPONSE, event_process_callback, NULL);
+	data_response_event = (RDP_CB_DATA_RESPONSE_EVENT*) event;
+	data_response_event->data = clipboard_stream_detach(stream, &length);
+	data_response_event->size = length;
+	clipboard_stream_free(stream);
+
+	test_sent_length = 0;
+	event_processed = 0;
+	freerdp_channels_send_event(channels, event);
+
+	while (!event_processed || (test_sent_length < length + 8))
+	{
+		freerdp_channels_check_fds(channels, &instance);
+	}
+
+	duration = test_cliprdr_elapsed(&start_time);
+	printf("\ncliprdr copy to server: %d MB in %ld us (%.1f MB/s)", size >> 20, duration,
+		(double) size / (duration > 0 ? duration : 1));
+
+	CU_ASSERT(test_sent_length == length + 8);
+
+	freerdp_channels_close(channels, &instance);
+	freerdp_channels_free(channels);
+	free(log);
+}
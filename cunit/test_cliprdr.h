@@ -24,3 +24,5 @@ int clean_cliprdr_suite(void);
 int add_cliprdr_suite(void);
 
 void test_cliprdr(void);
+void test_cliprdr_oversized(void);
+void test_cliprdr_benchmark(void);
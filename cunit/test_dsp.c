@@ -0,0 +1,1020 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Digital Sound Processing Unit Tests
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <freerdp/freerdp.h>
+#include <freerdp/utils/dsp.h>
+
+#include "test_dsp.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+int init_dsp_suite(void)
+{
+	return 0;
+}
+
+int clean_dsp_suite(void)
+{
+	return 0;
+}
+
+int add_dsp_suite(void)
+{
+	add_test_suite(dsp);
+
+	add_test_function(dsp_resample_quality);
+	add_test_function(dsp_resample_chunked);
+	add_test_function(dsp_resample_benchmark);
+	add_test_function(dsp_adpcm_bit_exact);
+	add_test_function(dsp_adpcm_buffers);
+	add_test_function(dsp_adpcm_benchmark);
+
+	return 0;
+}
+
+static INT16* dsp_test_tone(double frequency, UINT32 rate, UINT32 channels, int frames)
+{
+	int i;
+	UINT32 c;
+	INT16* samples;
+
+	samples = (INT16*) malloc(frames * channels * sizeof(INT16));
+
+	for (i = 0; i < frames; i++)
+	{
+		for (c = 0; c < channels; c++)
+			samples[i * channels + c] = (INT16) (16000.0 * sin(2.0 * M_PI * frequency * i / rate));
+	}
+
+	return samples;
+}
+
+/**
+ * Signal to noise ratio (dB) of the first channel against an ideal tone,
+ * skipping the filter warm-up at both ends.
+ */
+static double dsp_test_snr(const INT16* samples, UINT32 channels, int frames,
+	double frequency, UINT32 rate, double amplitude)
+{
+	int i;
+	double ref;
+	double signal = 0.0;
+	double noise = 0.0;
+
+	for (i = 64; i < frames - 64; i++)
+	{
+		ref = amplitude * sin(2.0 * M_PI * frequency * i / rate);
+		signal += ref * ref;
+		noise += (samples[i * channels] - ref) * (samples[i * channels] - ref);
+	}
+
+	return 10.0 * log10(signal / (noise + 1.0));
+}
+
+static double dsp_test_rms(const INT16* samples, UINT32 channels, int frames)
+{
+	int i;
+	double sum = 0.0;
+
+	for (i = 64; i < frames - 64; i++)
+		sum += (double) samples[i * channels] * samples[i * channels];
+
+	return sqrt(sum / (frames - 128));
+}
+
+void test_dsp_resample_quality(void)
+{
+	INT16* tone;
+	INT16* out;
+	int frames = 4410;
+	double snr_nearest;
+	double snr_sinc;
+	FREERDP_DSP_CONTEXT* context;
+
+	context = freerdp_dsp_context_new();
+
+	/* 1 kHz tone, 44.1 kHz to 22.05 kHz */
+	tone = dsp_test_tone(1000.0, 44100, 2, frames);
+
+	freerdp_dsp_context_set_resample_quality(context, FREERDP_DSP_RESAMPLE_NEAREST);
+	context->resample(context, (BYTE*) tone, 2, 2, 44100, frames, 2, 22050);
+	out = (INT16*) context->resampled_buffer;
+	snr_nearest = dsp_test_snr(out, 2, context->resampled_frames, 1000.0, 22050, 16000.0);
+
+	freerdp_dsp_context_set_resample_quality(context, FREERDP_DSP_RESAMPLE_MEDIUM);
+	context->resample(context, (BYTE*) tone, 2, 2, 44100, frames, 2, 22050);
+	out = (INT16*) context->resampled_buffer;
+	snr_sinc = dsp_test_snr(out, 2, context->resampled_frames, 1000.0, 22050, 16000.0);
+
+	CU_ASSERT(context->resampled_frames >= (UINT32) frames / 2 - 8);
+	CU_ASSERT(snr_sinc > 60.0);
+	CU_ASSERT(snr_sinc > snr_nearest);
+	free(tone);
+
+	/* 1 kHz tone, 22.05 kHz to 44.1 kHz, mono to stereo */
+	freerdp_dsp_context_reset_resampler(context);
+	tone = dsp_test_tone(1000.0, 22050, 1, frames);
+	context->resample(context, (BYTE*) tone, 2, 1, 22050, frames, 2, 44100);
+	out = (INT16*) context->resampled_buffer;
+	CU_ASSERT(dsp_test_snr(out, 2, context->resampled_frames, 1000.0, 44100, 16000.0) > 40.0);
+	CU_ASSERT(memcmp(&out[0], &out[1], sizeof(INT16)) == 0);
+	free(tone);
+
+	/* a 15 kHz tone cannot be represented at 22.05 kHz and must not alias back */
+	freerdp_dsp_context_reset_resampler(context);
+	tone = dsp_test_tone(15000.0, 44100, 1, frames);
+	freerdp_dsp_context_set_resample_quality(context, FREERDP_DSP_RESAMPLE_HIGH);
+	context->resample(context, (BYTE*) tone, 2, 1, 44100, frames, 1, 22050);
+	out = (INT16*) context->resampled_buffer;
+	CU_ASSERT(dsp_test_rms(out, 1, context->resampled_frames) < 16000.0 / sqrt(2.0) / 100.0);
+	free(tone);
+
+	freerdp_dsp_context_free(context);
+}
+
+void test_dsp_resample_chunked(void)
+{
+	int i;
+	int chunk;
+	INT16* tone;
+	BYTE* whole;
+	UINT32 whole_size;
+	UINT32 offset;
+	int frames = 4410;
+	FREERDP_DSP_CONTEXT* context;
+
+	context = freerdp_dsp_context_new();
+	tone = dsp_test_tone(440.0, 44100, 2, frames);
+
+	context->resample(context, (BYTE*) tone, 2, 2, 44100, frames, 2, 48000);
+	whole_size = context->resampled_size;
+	whole = (BYTE*) malloc(whole_size);
+	memcpy(whole, context->resampled_buffer, whole_size);
+
+	/* the same stream in odd sized pieces must give the same samples */
+	freerdp_dsp_context_reset_resampler(context);
+	offset = 0;
+
+	for (i = 0; i < frames; i += chunk)
+	{
+		chunk = 1 + (i * 7) % 331;
+
+		if (i + chunk > frames)
+			chunk = frames - i;
+
+		context->resample(context, (BYTE*) &tone[i * 2], 2, 2, 44100, chunk, 2, 48000);
+
+		CU_ASSERT(offset + context->resampled_size <= whole_size);
+
+		if (offset + context->resampled_size <= whole_size)
+			CU_ASSERT(memcmp(&whole[offset], context->resampled_buffer, context->resampled_size) == 0);
+
+		offset += context->resampled_size;
+	}
+
+	CU_ASSERT(offset == whole_size);
+
+	free(whole);
+	free(tone);
+	freerdp_dsp_context_free(context);
+}
+
+static long dsp_test_throughput(FREERDP_DSP_CONTEXT* context, int quality, INT16* tone, int frames)
+{
+	int i;
+	struct timeval start_time;
+	struct timeval end_time;
+
+	freerdp_dsp_context_set_resample_quality(context, quality);
+	freerdp_dsp_context_reset_resampler(context);
+
+	gettimeofday(&start_time, NULL);
+
+	for (i = 0; i < 100; i++)
+		context->resample(context, (BYTE*) tone, 2, 2, 44100, frames, 2, 22050);
+
+	gettimeofday(&end_time, NULL);
+
+	return ((end_time.tv_sec - start_time.tv_sec) * 1000000) + (end_time.tv_usec - start_time.tv_usec);
+}
+
+void test_dsp_resample_benchmark(void)
+{
+	int quality;
+	INT16* tone;
+	long duration;
+	int frames = 4410;
+	FREERDP_DSP_CONTEXT* context;
+	const char* names[] = { "nearest", "low", "medium", "high" };
+
+	context = freerdp_dsp_context_new();
+	tone = dsp_test_tone(1000.0, 44100, 2, frames);
+
+	for (quality = FREERDP_DSP_RESAMPLE_NEAREST; quality <= FREERDP_DSP_RESAMPLE_HIGH; quality++)
+	{
+		duration = dsp_test_throughput(context, quality, tone, frames);
+		CU_ASSERT(context->resampled_frames > 0);
+
+		printf("\ndsp resample %-7s: 10s of 44.1kHz stereo in %ld us", names[quality], duration);
+	}
+
+	free(tone);
+	freerdp_dsp_context_free(context);
+}
+
+/**
+ * Reference ADPCM codecs, as they were before the block codecs replaced them.
+ * The new implementation must produce the exact same bytes.
+ */
+
+static const INT16 ref_ima_step_index_table[] =
+{
+	-1, -1, -1, -1, 2, 4, 6, 8,
+	-1, -1, -1, -1, 2, 4, 6, 8
+};
+
+static const INT16 ref_ima_step_size_table[] =
+{
+	7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 
+	19, 21, 23, 25, 28, 31, 34, 37, 41, 45, 
+	50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 
+	130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+	337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
+	876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 
+	2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358,
+	5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899, 
+	15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767 
+};
+
+static UINT16 ref_decode_ima_adpcm_sample(ADPCM* adpcm,
+	int channel, BYTE sample)
+{
+	INT32 ss;
+	INT32 d;
+
+	ss = ref_ima_step_size_table[adpcm->ima.last_step[channel]];
+	d = (ss >> 3);
+	if (sample & 1)
+		d += (ss >> 2);
+	if (sample & 2)
+		d += (ss >> 1);
+	if (sample & 4)
+		d += ss;
+	if (sample & 8)
+		d = -d;
+	d += adpcm->ima.last_sample[channel];
+
+	if (d < -32768)
+		d = -32768;
+	else if (d > 32767)
+		d = 32767;
+
+	adpcm->ima.last_sample[channel] = (INT16) d;
+
+	adpcm->ima.last_step[channel] += ref_ima_step_index_table[sample];
+	if (adpcm->ima.last_step[channel] < 0)
+		adpcm->ima.last_step[channel] = 0;
+	else if (adpcm->ima.last_step[channel] > 88)
+		adpcm->ima.last_step[channel] = 88;
+
+	return (UINT16) d;
+}
+
+static void ref_decode_ima_adpcm(FREERDP_DSP_CONTEXT* context,
+	const BYTE* src, int size, int channels, int block_size)
+{
+	BYTE* dst;
+	BYTE sample;
+	UINT16 decoded;
+	UINT32 out_size;
+	int channel;
+	int i;
+
+	out_size = size * 4;
+	if (out_size > context->adpcm_maxlength)
+	{
+		context->adpcm_maxlength = out_size + 1024;
+		context->adpcm_buffer = realloc(context->adpcm_buffer, context->adpcm_maxlength);
+	}
+	dst = context->adpcm_buffer;
+	while (size > 0)
+	{
+		if (size % block_size == 0)
+		{
+			context->adpcm.ima.last_sample[0] = (INT16) (((UINT16)(*src)) | (((UINT16)(*(src + 1))) << 8));
+			context->adpcm.ima.last_step[0] = (INT16) (*(src + 2));
+			src += 4;
+			size -= 4;
+			out_size -= 16;
+			if (channels > 1)
+			{
+				context->adpcm.ima.last_sample[1] = (INT16) (((UINT16)(*src)) | (((UINT16)(*(src + 1))) << 8));
+				context->adpcm.ima.last_step[1] = (INT16) (*(src + 2));
+				src += 4;
+				size -= 4;
+				out_size -= 16;
+			}
+		}
+
+		if (channels > 1)
+		{
+			for (i = 0; i < 8; i++)
+			{
+				channel = (i < 4 ? 0 : 1);
+				sample = ((*src) & 0x0f);
+				decoded = ref_decode_ima_adpcm_sample(&context->adpcm, channel, sample);
+				dst[((i & 3) << 3) + (channel << 1)] = (decoded & 0xff);
+				dst[((i & 3) << 3) + (channel << 1) + 1] = (decoded >> 8);
+				sample = ((*src) >> 4);
+				decoded = ref_decode_ima_adpcm_sample(&context->adpcm, channel, sample);
+				dst[((i & 3) << 3) + (channel << 1) + 4] = (decoded & 0xff);
+				dst[((i & 3) << 3) + (channel << 1) + 5] = (decoded >> 8);
+				src++;
+			}
+			dst += 32;
+			size -= 8;
+		}
+		else
+		{
+			sample = ((*src) & 0x0f);
+			decoded = ref_decode_ima_adpcm_sample(&context->adpcm, 0, sample);
+			*dst++ = (decoded & 0xff);
+			*dst++ = (decoded >> 8);
+			sample = ((*src) >> 4);
+			decoded = ref_decode_ima_adpcm_sample(&context->adpcm, 0, sample);
+			*dst++ = (decoded & 0xff);
+			*dst++ = (decoded >> 8);
+			src++;
+			size--;
+		}
+	}
+
+	context->adpcm_size = dst - context->adpcm_buffer;
+}
+
+/**
+ * 0     1     2     3
+ * 2 0   6 4   10 8  14 12   <left>
+ *
+ * 4     5     6     7
+ * 3 1   7 5   11 9  15 13   <right>
+ */
+static const struct
+{
+	BYTE byte_num;
+	BYTE byte_shift;
+} ref_ima_stereo_encode_map[] =
+{
+	{ 0, 0 },
+	{ 4, 0 },
+	{ 0, 4 },
+	{ 4, 4 },
+	{ 1, 0 },
+	{ 5, 0 },
+	{ 1, 4 },
+	{ 5, 4 },
+	{ 2, 0 },
+	{ 6, 0 },
+	{ 2, 4 },
+	{ 6, 4 },
+	{ 3, 0 },
+	{ 7, 0 },
+	{ 3, 4 },
+	{ 7, 4 }
+};
+
+static BYTE ref_encode_ima_adpcm_sample(ADPCM* adpcm,
+	int channel, INT16 sample)
+{
+	INT32 e;
+	INT32 d;
+	INT32 ss;
+	BYTE enc;
+	INT32 diff;
+
+	ss = ref_ima_step_size_table[adpcm->ima.last_step[channel]];
+	d = e = sample - adpcm->ima.last_sample[channel];
+	diff = ss >> 3;
+	enc = 0;
+	if (e < 0)
+	{
+		enc = 8;
+		e = -e;
+	}
+	if (e >= ss)
+	{
+		enc |= 4;
+		e -= ss;
+	}
+	ss >>= 1;
+	if (e >= ss)
+	{
+		enc |= 2;
+		e -= ss;
+	}
+	ss >>= 1;
+	if (e >= ss)
+	{
+		enc |= 1;
+		e -= ss;
+	}
+
+	if (d < 0)
+		diff = d + e - diff;
+	else
+		diff = d - e + diff;
+
+	diff += adpcm->ima.last_sample[channel];
+	if (diff < -32768)
+		diff = -32768;
+	else if (diff > 32767)
+		diff = 32767;
+	adpcm->ima.last_sample[channel] = (INT16) diff;
+
+	adpcm->ima.last_step[channel] += ref_ima_step_index_table[enc];
+	if (adpcm->ima.last_step[channel] < 0)
+		adpcm->ima.last_step[channel] = 0;
+	else if (adpcm->ima.last_step[channel] > 88)
+		adpcm->ima.last_step[channel] = 88;
+
+	return enc;
+}
+
+static void ref_encode_ima_adpcm(FREERDP_DSP_CONTEXT* context,
+	const BYTE* src, int size, int channels, int block_size)
+{
+	BYTE* dst;
+	INT16 sample;
+	BYTE encoded;
+	UINT32 out_size;
+	int i;
+
+	out_size = size / 2;
+	if (out_size > context->adpcm_maxlength)
+	{
+		context->adpcm_maxlength = out_size + 1024;
+		context->adpcm_buffer = realloc(context->adpcm_buffer, context->adpcm_maxlength);
+	}
+	dst = context->adpcm_buffer;
+	while (size > 0)
+	{
+		if ((dst - context->adpcm_buffer) % block_size == 0)
+		{
+			*dst++ = context->adpcm.ima.last_sample[0] & 0xff;
+			*dst++ = (context->adpcm.ima.last_sample[0] >> 8) & 0xff;
+			*dst++ = (BYTE) context->adpcm.ima.last_step[0];
+			*dst++ = 0;
+			if (channels > 1)
+			{
+				*dst++ = context->adpcm.ima.last_sample[1] & 0xff;
+				*dst++ = (context->adpcm.ima.last_sample[1] >> 8) & 0xff;
+				*dst++ = (BYTE) context->adpcm.ima.last_step[1];
+				*dst++ = 0;
+			}
+		}
+
+		if (channels > 1)
+		{
+			memset(dst, 0, 8);
+			for (i = 0; i < 16; i++)
+			{
+				sample = (INT16) (((UINT16)(*src)) | (((UINT16)(*(src + 1))) << 8));
+				src += 2;
+				encoded = ref_encode_ima_adpcm_sample(&context->adpcm, i % 2, sample);
+				dst[ref_ima_stereo_encode_map[i].byte_num] |= encoded << ref_ima_stereo_encode_map[i].byte_shift;
+			}
+			dst += 8;
+			size -= 32;
+		}
+		else
+		{
+			sample = (INT16) (((UINT16)(*src)) | (((UINT16)(*(src + 1))) << 8));
+			src += 2;
+			encoded = ref_encode_ima_adpcm_sample(&context->adpcm, 0, sample);
+			sample = (INT16) (((UINT16)(*src)) | (((UINT16)(*(src + 1))) << 8));
+			src += 2;
+			encoded |= ref_encode_ima_adpcm_sample(&context->adpcm, 0, sample) << 4;
+			*dst++ = encoded;
+			size -= 4;
+		}
+	}
+	
+	context->adpcm_size = dst - context->adpcm_buffer;
+}
+
+/**
+ * Microsoft ADPCM Specification:
+ *
+ * http://wiki.multimedia.cx/index.php?title=Microsoft_ADPCM
+ */
+
+static const INT16 ref_ms_adpcm_adaptation_table[] =
+{
+	230, 230, 230, 230, 307, 409, 512, 614,
+	768, 614, 512, 409, 307, 230, 230, 230
+};
+
+static const INT16 ref_ms_adpcm_coeff1_table[] =
+{
+	256, 512, 0, 192, 240, 460, 392
+};
+
+static const INT16 ref_ms_adpcm_coeff2_table[] =
+{
+	0, -256, 0, 64, 0, -208, -232
+};
+
+static INT16 ref_decode_ms_adpcm_sample(ADPCM* adpcm, BYTE sample, int channel)
+{
+	INT8 nibble;
+	INT32 presample;
+
+	nibble = (sample & 0x08 ? (INT8)sample - 16 : sample);
+	presample = ((adpcm->ms.sample1[channel] * ref_ms_adpcm_coeff1_table[adpcm->ms.predictor[channel]]) +
+		(adpcm->ms.sample2[channel] * ref_ms_adpcm_coeff2_table[adpcm->ms.predictor[channel]])) / 256;
+	presample += nibble * adpcm->ms.delta[channel];
+	if (presample > 32767)
+		presample = 32767;
+	else if (presample < -32768)
+		presample = -32768;
+	adpcm->ms.sample2[channel] = adpcm->ms.sample1[channel];
+	adpcm->ms.sample1[channel] = presample;
+	adpcm->ms.delta[channel] = adpcm->ms.delta[channel] * ref_ms_adpcm_adaptation_table[sample] / 256;
+	if (adpcm->ms.delta[channel] < 16)
+		adpcm->ms.delta[channel] = 16;
+	return (INT16) presample;
+}
+
+static void ref_decode_ms_adpcm(FREERDP_DSP_CONTEXT* context,
+	const BYTE* src, int size, int channels, int block_size)
+{
+	BYTE* dst;
+	BYTE sample;
+	UINT32 out_size;
+
+	out_size = size * 4;
+	if (out_size > context->adpcm_maxlength)
+	{
+		context->adpcm_maxlength = out_size + 1024;
+		context->adpcm_buffer = realloc(context->adpcm_buffer, context->adpcm_maxlength);
+	}
+	dst = context->adpcm_buffer;
+	while (size > 0)
+	{
+		if (size % block_size == 0)
+		{
+			if (channels > 1)
+			{
+				context->adpcm.ms.predictor[0] = *src++;
+				context->adpcm.ms.predictor[1] = *src++;
+				context->adpcm.ms.delta[0] = *((INT16*)src);
+				src += 2;
+				context->adpcm.ms.delta[1] = *((INT16*)src);
+				src += 2;
+				context->adpcm.ms.sample1[0] = *((INT16*)src);
+				src += 2;
+				context->adpcm.ms.sample1[1] = *((INT16*)src);
+				src += 2;
+				context->adpcm.ms.sample2[0] = *((INT16*)src);
+				src += 2;
+				context->adpcm.ms.sample2[1] = *((INT16*)src);
+				src += 2;
+				size -= 14;
+
+				*((INT16*)dst) = context->adpcm.ms.sample2[0];
+				dst += 2;
+				*((INT16*)dst) = context->adpcm.ms.sample2[1];
+				dst += 2;
+				*((INT16*)dst) = context->adpcm.ms.sample1[0];
+				dst += 2;
+				*((INT16*)dst) = context->adpcm.ms.sample1[1];
+				dst += 2;
+			}
+			else
+			{
+				context->adpcm.ms.predictor[0] = *src++;
+				context->adpcm.ms.delta[0] = *((INT16*)src);
+				src += 2;
+				context->adpcm.ms.sample1[0] = *((INT16*)src);
+				src += 2;
+				context->adpcm.ms.sample2[0] = *((INT16*)src);
+				src += 2;
+				size -= 7;
+
+				*((INT16*)dst) = context->adpcm.ms.sample2[0];
+				dst += 2;
+				*((INT16*)dst) = context->adpcm.ms.sample1[0];
+				dst += 2;
+			}
+		}
+
+		if (channels > 1)
+		{
+			sample = *src++;
+			size--;
+			*((INT16*)dst) = ref_decode_ms_adpcm_sample(&context->adpcm, sample >> 4, 0);
+			dst += 2;
+			*((INT16*)dst) = ref_decode_ms_adpcm_sample(&context->adpcm, sample & 0x0F, 1);
+			dst += 2;
+
+			sample = *src++;
+			size--;
+			*((INT16*)dst) = ref_decode_ms_adpcm_sample(&context->adpcm, sample >> 4, 0);
+			dst += 2;
+			*((INT16*)dst) = ref_decode_ms_adpcm_sample(&context->adpcm, sample & 0x0F, 1);
+			dst += 2;
+		}
+		else
+		{
+			sample = *src++;
+			size--;
+			*((INT16*)dst) = ref_decode_ms_adpcm_sample(&context->adpcm, sample >> 4, 0);
+			dst += 2;
+			*((INT16*)dst) = ref_decode_ms_adpcm_sample(&context->adpcm, sample & 0x0F, 0);
+			dst += 2;
+		}
+	}
+
+	context->adpcm_size = dst - context->adpcm_buffer;
+}
+
+static BYTE ref_encode_ms_adpcm_sample(ADPCM* adpcm, INT32 sample, int channel)
+{
+	INT32 presample;
+	INT32 errordelta;
+
+	presample = ((adpcm->ms.sample1[channel] * ref_ms_adpcm_coeff1_table[adpcm->ms.predictor[channel]]) +
+		(adpcm->ms.sample2[channel] * ref_ms_adpcm_coeff2_table[adpcm->ms.predictor[channel]])) / 256;
+	errordelta = (sample - presample) / adpcm->ms.delta[channel];
+	if ((sample - presample) % adpcm->ms.delta[channel] > adpcm->ms.delta[channel] / 2)
+		errordelta++;
+	if (errordelta > 7)
+		errordelta = 7;
+	else if (errordelta < -8)
+		errordelta = -8;
+	presample += adpcm->ms.delta[channel] * errordelta;
+	if (presample > 32767)
+		presample = 32767;
+	else if (presample < -32768)
+		presample = -32768;
+	adpcm->ms.sample2[channel] = adpcm->ms.sample1[channel];
+	adpcm->ms.sample1[channel] = presample;
+	adpcm->ms.delta[channel] = adpcm->ms.delta[channel] * ref_ms_adpcm_adaptation_table[(((BYTE)errordelta) & 0x0F)] / 256;
+	if (adpcm->ms.delta[channel] < 16)
+		adpcm->ms.delta[channel] = 16;
+	return ((BYTE)errordelta) & 0x0F;
+}
+
+static void ref_encode_ms_adpcm(FREERDP_DSP_CONTEXT* context,
+	const BYTE* src, int size, int channels, int block_size)
+{
+	BYTE* dst;
+	INT32 sample;
+	UINT32 out_size;
+
+	out_size = size / 2;
+	if (out_size > context->adpcm_maxlength)
+	{
+		context->adpcm_maxlength = out_size + 1024;
+		context->adpcm_buffer = realloc(context->adpcm_buffer, context->adpcm_maxlength);
+	}
+	dst = context->adpcm_buffer;
+
+	if (context->adpcm.ms.delta[0] < 16)
+		context->adpcm.ms.delta[0] = 16;
+	if (context->adpcm.ms.delta[1] < 16)
+		context->adpcm.ms.delta[1] = 16;
+
+	while (size > 0)
+	{
+		if ((dst - context->adpcm_buffer) % block_size == 0)
+		{
+			if (channels > 1)
+			{
+				*dst++ = context->adpcm.ms.predictor[0];
+				*dst++ = context->adpcm.ms.predictor[1];
+				*dst++ = (BYTE) (context->adpcm.ms.delta[0] & 0xff);
+				*dst++ = (BYTE) ((context->adpcm.ms.delta[0] >> 8) & 0xff);
+				*dst++ = (BYTE) (context->adpcm.ms.delta[1] & 0xff);
+				*dst++ = (BYTE) ((context->adpcm.ms.delta[1] >> 8) & 0xff);
+				context->adpcm.ms.sample1[0] = *((INT16*) (src + 4));
+				context->adpcm.ms.sample1[1] = *((INT16*) (src + 6));
+				context->adpcm.ms.sample2[0] = *((INT16*) (src + 0));
+				context->adpcm.ms.sample2[1] = *((INT16*) (src + 2));
+				*((INT16*) (dst + 0)) = (INT16) context->adpcm.ms.sample1[0];
+				*((INT16*) (dst + 2)) = (INT16) context->adpcm.ms.sample1[1];
+				*((INT16*) (dst + 4)) = (INT16) context->adpcm.ms.sample2[0];
+				*((INT16*) (dst + 6)) = (INT16) context->adpcm.ms.sample2[1];
+				dst += 8;
+				src += 8;
+				size -= 8;
+			}
+			else
+			{
+				*dst++ = context->adpcm.ms.predictor[0];
+				*dst++ = (BYTE) (context->adpcm.ms.delta[0] & 0xff);
+				*dst++ = (BYTE) ((context->adpcm.ms.delta[0] >> 8) & 0xff);
+				context->adpcm.ms.sample1[0] = *((INT16*) (src + 2));
+				context->adpcm.ms.sample2[0] = *((INT16*) (src + 0));
+				*((INT16*) (dst + 0)) = (INT16) context->adpcm.ms.sample1[0];
+				*((INT16*) (dst + 2)) = (INT16) context->adpcm.ms.sample2[0];
+				dst += 4;
+				src += 4;
+				size -= 4;
+			}
+		}
+
+		sample = *((INT16*) src);
+		src += 2;
+		*dst = ref_encode_ms_adpcm_sample(&context->adpcm, sample, 0) << 4;
+		sample = *((INT16*) src);
+		src += 2;
+		*dst += ref_encode_ms_adpcm_sample(&context->adpcm, sample, channels > 1 ? 1 : 0);
+		dst++;
+		size -= 4;
+	}
+	
+	context->adpcm_size = dst - context->adpcm_buffer;
+}
+
+
+typedef int (*pAdpcmCodecTest)(ADPCM* adpcm, const BYTE* src, int size,
+	int channels, int block_size, BYTE* dst, int dst_size);
+typedef void (*pRefCodec)(FREERDP_DSP_CONTEXT* context,
+	const BYTE* src, int size, int channels, int block_size);
+
+static BYTE* dsp_test_pcm(int frames, int channels)
+{
+	int i;
+	int c;
+	BYTE* pcm;
+	INT32 value;
+	UINT32 seed = 1;
+
+	pcm = (BYTE*) malloc(frames * channels * 2);
+
+	for (i = 0; i < frames; i++)
+	{
+		for (c = 0; c < channels; c++)
+		{
+			/* tone with a noise floor and a few full scale clicks to exercise clamping */
+			seed = seed * 1103515245 + 12345;
+			value = (INT32) (12000.0 * sin(2.0 * M_PI * (440.0 + 220.0 * c) * i / 22050));
+			value += (INT32) ((seed >> 16) & 0x7FF) - 1024;
+
+			if ((i % 997) == 0)
+				value = (c ? -32768 : 32767);
+
+			if (value > 32767)
+				value = 32767;
+			else if (value < -32768)
+				value = -32768;
+
+			pcm[(i * channels + c) * 2] = (BYTE) (value & 0xFF);
+			pcm[(i * channels + c) * 2 + 1] = (BYTE) ((value >> 8) & 0xFF);
+		}
+	}
+
+	return pcm;
+}
+
+static void dsp_test_adpcm_codec(pRefCodec ref_encode, pRefCodec ref_decode,
+	pAdpcmCodecTest encode, pAdpcmCodecTest decode,
+	int channels, int block_size, int block_input)
+{
+	int i;
+	int size;
+	int length;
+	int offset;
+	BYTE* pcm;
+	BYTE* encoded;
+	BYTE* decoded;
+	int pcm_size;
+	int encoded_size;
+	ADPCM encoder;
+	ADPCM decoder;
+	FREERDP_DSP_CONTEXT* context;
+
+	/* three chunks: whole blocks, whole blocks again, then a partial block */
+	int chunks[3];
+
+	chunks[0] = 3 * block_input;
+	chunks[1] = 2 * block_input;
+	chunks[2] = 32 * 5;
+
+	pcm_size = chunks[0] + chunks[1] + chunks[2];
+	pcm = dsp_test_pcm(pcm_size / (2 * channels), channels);
+
+	context = freerdp_dsp_context_new();
+	memset(&encoder, 0, sizeof(ADPCM));
+	memset(&decoder, 0, sizeof(ADPCM));
+
+	for (i = 0, offset = 0; i < 3; offset += chunks[i++])
+	{
+		ref_encode(context, &pcm[offset], chunks[i], channels, block_size);
+
+		length = encode(&encoder, &pcm[offset], chunks[i], channels, block_size, NULL, 0);
+		CU_ASSERT(length == (int) context->adpcm_size);
+
+		encoded = (BYTE*) malloc(length);
+		size = encode(&encoder, &pcm[offset], chunks[i], channels, block_size, encoded, length);
+		CU_ASSERT(size == length);
+		CU_ASSERT(memcmp(encoded, context->adpcm_buffer, length) == 0);
+		CU_ASSERT(memcmp(&encoder, &context->adpcm, sizeof(ADPCM)) == 0);
+
+		/* decode what was just encoded, with both decoders */
+		encoded_size = length;
+		memcpy(&context->adpcm, &decoder, sizeof(ADPCM));
+		ref_decode(context, encoded, encoded_size, channels, block_size);
+
+		length = decode(&decoder, encoded, encoded_size, channels, block_size, NULL, 0);
+		CU_ASSERT(length == (int) context->adpcm_size);
+
+		decoded = (BYTE*) malloc(length);
+		size = decode(&decoder, encoded, encoded_size, channels, block_size, decoded, length);
+		CU_ASSERT(size == length);
+		CU_ASSERT(memcmp(decoded, context->adpcm_buffer, length) == 0);
+		CU_ASSERT(memcmp(&decoder, &context->adpcm, sizeof(ADPCM)) == 0);
+
+		memcpy(&context->adpcm, &encoder, sizeof(ADPCM));
+
+		free(encoded);
+		free(decoded);
+	}
+
+	free(pcm);
+	freerdp_dsp_context_free(context);
+}
+
+void test_dsp_adpcm_bit_exact(void)
+{
+	/* IMA ADPCM: each data byte holds two samples, four bytes of PCM */
+	dsp_test_adpcm_codec(ref_encode_ima_adpcm, ref_decode_ima_adpcm,
+		freerdp_dsp_encode_ima_adpcm_blocks, freerdp_dsp_decode_ima_adpcm_blocks, 1, 512, (512 - 4) * 4);
+	dsp_test_adpcm_codec(ref_encode_ima_adpcm, ref_decode_ima_adpcm,
+		freerdp_dsp_encode_ima_adpcm_blocks, freerdp_dsp_decode_ima_adpcm_blocks, 1, 1024, (1024 - 4) * 4);
+	dsp_test_adpcm_codec(ref_encode_ima_adpcm, ref_decode_ima_adpcm,
+		freerdp_dsp_encode_ima_adpcm_blocks, freerdp_dsp_decode_ima_adpcm_blocks, 2, 1024, (1024 - 8) * 4);
+	dsp_test_adpcm_codec(ref_encode_ima_adpcm, ref_decode_ima_adpcm,
+		freerdp_dsp_encode_ima_adpcm_blocks, freerdp_dsp_decode_ima_adpcm_blocks, 2, 2048, (2048 - 8) * 4);
+
+	/* MS ADPCM: two verbatim frames in the header, then four bytes of PCM per data byte */
+	dsp_test_adpcm_codec(ref_encode_ms_adpcm, ref_decode_ms_adpcm,
+		freerdp_dsp_encode_ms_adpcm_blocks, freerdp_dsp_decode_ms_adpcm_blocks, 1, 512, 4 + (512 - 7) * 4);
+	dsp_test_adpcm_codec(ref_encode_ms_adpcm, ref_decode_ms_adpcm,
+		freerdp_dsp_encode_ms_adpcm_blocks, freerdp_dsp_decode_ms_adpcm_blocks, 1, 1024, 4 + (1024 - 7) * 4);
+	dsp_test_adpcm_codec(ref_encode_ms_adpcm, ref_decode_ms_adpcm,
+		freerdp_dsp_encode_ms_adpcm_blocks, freerdp_dsp_decode_ms_adpcm_blocks, 2, 1024, 8 + (1024 - 14) * 4);
+	dsp_test_adpcm_codec(ref_encode_ms_adpcm, ref_decode_ms_adpcm,
+		freerdp_dsp_encode_ms_adpcm_blocks, freerdp_dsp_decode_ms_adpcm_blocks, 2, 2048, 8 + (2048 - 14) * 4);
+}
+
+void test_dsp_adpcm_buffers(void)
+{
+	int length;
+	BYTE* pcm;
+	BYTE* encoded;
+	ADPCM adpcm;
+	int pcm_size = (1024 - 8) * 4 * 2;
+
+	pcm = dsp_test_pcm(pcm_size / 4, 2);
+	memset(&adpcm, 0, sizeof(ADPCM));
+
+	length = freerdp_dsp_encode_ima_adpcm_blocks(&adpcm, pcm, pcm_size, 2, 1024, NULL, 0);
+	CU_ASSERT(length == 2 * 1024);
+
+	/* a short buffer is refused without touching the codec state */
+	encoded = (BYTE*) malloc(length);
+	CU_ASSERT(freerdp_dsp_encode_ima_adpcm_blocks(&adpcm, pcm, pcm_size, 2, 1024, encoded, length - 1) == -1);
+	CU_ASSERT(adpcm.ima.last_sample[0] == 0 && adpcm.ima.last_step[0] == 0);
+	CU_ASSERT(freerdp_dsp_encode_ima_adpcm_blocks(&adpcm, pcm, pcm_size, 2, 1024, encoded, length) == length);
+
+	/* decoding yields the PCM size, minus the header sample IMA blocks do not output */
+	CU_ASSERT(freerdp_dsp_decode_ima_adpcm_blocks(&adpcm, encoded, length, 2, 1024, NULL, 0) == pcm_size);
+
+	/* invalid layouts */
+	CU_ASSERT(freerdp_dsp_encode_ima_adpcm_blocks(&adpcm, pcm, pcm_size, 3, 1024, NULL, 0) == -1);
+	CU_ASSERT(freerdp_dsp_encode_ima_adpcm_blocks(&adpcm, pcm, pcm_size, 2, 8, NULL, 0) == -1);
+	CU_ASSERT(freerdp_dsp_decode_ms_adpcm_blocks(&adpcm, encoded, length, 2, 14, NULL, 0) == -1);
+
+	/* stereo IMA blocks leaving a partial 8 byte group are refused by both directions */
+	CU_ASSERT(freerdp_dsp_ima_adpcm_block_size_valid(2, 1024) == TRUE);
+	CU_ASSERT(freerdp_dsp_ima_adpcm_block_size_valid(1, 1025) == TRUE);
+	CU_ASSERT(freerdp_dsp_ima_adpcm_block_size_valid(2, 1028) == FALSE);
+	CU_ASSERT(freerdp_dsp_encode_ima_adpcm_blocks(&adpcm, pcm, pcm_size, 2, 1028, NULL, 0) == -1);
+	CU_ASSERT(freerdp_dsp_decode_ima_adpcm_blocks(&adpcm, encoded, length, 2, 1028, NULL, 0) == -1);
+
+	free(encoded);
+	free(pcm);
+}
+
+static long dsp_test_elapsed(struct timeval* start_time)
+{
+	struct timeval end_time;
+
+	gettimeofday(&end_time, NULL);
+
+	return ((end_time.tv_sec - start_time->tv_sec) * 1000000) + (end_time.tv_usec - start_time->tv_usec);
+}
+
+void test_dsp_adpcm_benchmark(void)
+{
+	int i;
+	BYTE* pcm;
+	BYTE* encoded;
+	BYTE* decoded;
+	int encoded_size;
+	int pcm_size = 20 * (2048 - 8) * 4;
+	ADPCM adpcm;
+	long ref_time;
+	long new_time;
+	struct timeval start_time;
+	FREERDP_DSP_CONTEXT* context;
+
+	/* about 10 seconds of 22.05 kHz stereo, 20 IMA blocks per call */
+	context = freerdp_dsp_context_new();
+	pcm = dsp_test_pcm(pcm_size / 4, 2);
+	encoded = (BYTE*) malloc(pcm_size);
+	decoded = (BYTE*) malloc(2 * pcm_size);
+	memset(&adpcm, 0, sizeof(ADPCM));
+
+	gettimeofday(&start_time, NULL);
+	for (i = 0; i < 70; i++)
+		ref_encode_ima_adpcm(context, pcm, pcm_size, 2, 2048);
+	ref_time = dsp_test_elapsed(&start_time);
+
+	gettimeofday(&start_time, NULL);
+	for (i = 0; i < 70; i++)
+		encoded_size = freerdp_dsp_encode_ima_adpcm_blocks(&adpcm, pcm, pcm_size, 2, 2048, encoded, pcm_size);
+	new_time = dsp_test_elapsed(&start_time);
+
+	printf("\nima adpcm encode: reference %ld us, blocks %ld us", ref_time, new_time);
+
+	gettimeofday(&start_time, NULL);
+	for (i = 0; i < 70; i++)
+		ref_decode_ima_adpcm(context, encoded, encoded_size, 2, 2048);
+	ref_time = dsp_test_elapsed(&start_time);
+
+	gettimeofday(&start_time, NULL);
+	for (i = 0; i < 70; i++)
+		freerdp_dsp_decode_ima_adpcm_blocks(&adpcm, encoded, encoded_size, 2, 2048, decoded, 2 * pcm_size);
+	new_time = dsp_test_elapsed(&start_time);
+
+	printf("\nima adpcm decode: reference %ld us, blocks %ld us", ref_time, new_time);
+
+	memset(&adpcm, 0, sizeof(ADPCM));
+	memset(&context->adpcm, 0, sizeof(ADPCM));
+
+	gettimeofday(&start_time, NULL);
+	for (i = 0; i < 70; i++)
+		ref_encode_ms_adpcm(context, pcm, pcm_size, 2, 2048);
+	ref_time = dsp_test_elapsed(&start_time);
+
+	gettimeofday(&start_time, NULL);
+	for (i = 0; i < 70; i++)
+		encoded_size = freerdp_dsp_encode_ms_adpcm_blocks(&adpcm, pcm, pcm_size, 2, 2048, encoded, pcm_size);
+	new_time = dsp_test_elapsed(&start_time);
+
+	printf("\nms adpcm encode: reference %ld us, blocks %ld us", ref_time, new_time);
+
+	gettimeofday(&start_time, NULL);
+	for (i = 0; i < 70; i++)
+		ref_decode_ms_adpcm(context, encoded, encoded_size, 2, 2048);
+	ref_time = dsp_test_elapsed(&start_time);
+
+	gettimeofday(&start_time, NULL);
+	for (i = 0; i < 70; i++)
+		freerdp_dsp_decode_ms_adpcm_blocks(&adpcm, encoded, encoded_size, 2, 2048, decoded, 2 * pcm_size);
+	new_time = dsp_test_elapsed(&start_time);
+
+	printf("\nms adpcm decode: reference %ld us, blocks %ld us", ref_time, new_time);
+
+	CU_ASSERT(encoded_size > 0);
+
+	free(decoded);
+	free(encoded);
+	free(pcm);
+	freerdp_dsp_context_free(context);
+}
@@ -0,0 +1,29 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Digital Sound Processing Unit Tests
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "test_freerdp.h"
+
+int init_dsp_suite(void);
+int clean_dsp_suite(void);
+int add_dsp_suite(void);
+
+void test_dsp_resample_quality(void);
+void test_dsp_resample_chunked(void);
+void test_dsp_resample_benchmark(void);
+void test_dsp_adpcm_bit_exact(void);
+void test_dsp_adpcm_buffers(void);
+void test_dsp_adpcm_benchmark(void);
@@ -19,20 +19,40 @@
 
 #include <CUnit/Basic.h>
 
+#include <freerdp/freerdp.h>
+#include <freerdp/graphics.h>
+#include <freerdp/cache/cache.h>
+#include <freerdp/utils/memory.h>
+
 #include "test_gcc.h"
 #include "test_mcs.h"
+#include "test_metrics.h"
 #include "test_color.h"
 #include "test_bitmap.h"
 #include "test_gdi.h"
+#include "test_glyph.h"
+#include "test_offscreen.h"
 #include "test_orders.h"
+#include "test_orders_enc.h"
 #include "test_ntlm.h"
 #include "test_license.h"
 #include "test_cliprdr.h"
+#include "test_clipboard.h"
 #include "test_drdynvc.h"
+#include "test_dsp.h"
 #include "test_rfx.h"
+#include "test_rpc.h"
+#include "test_rdpsnd.h"
+#include "test_reconnect.h"
+#include "test_replay.h"
+#include "test_security.h"
 #include "test_nsc.h"
 #include "test_freerdp.h"
 #include "test_rail.h"
+#include "test_window_list.h"
+#include "test_reassembly.h"
+#include "test_persistent.h"
+#include "test_pointer.h"
 #include "test_pcap.h"
 #include "test_mppc.h"
 #include "test_mppc_enc.h"
@@ -104,6 +124,59 @@ void assert_stream(STREAM* s, BYTE* data, int length, const char* func, int line
 	}
 }
 
+/**
+ * A client context without a connection, for the suites driving the caches
+ * through their update callbacks: the instance, its settings and update with
+ * empty callback tables, the graphics module and the cache.
+ */
+
+rdpContext* test_context_new(void)
+{
+	freerdp* instance;
+	rdpUpdate* update;
+	rdpContext* context;
+
+	instance = xnew(freerdp);
+	update = xnew(rdpUpdate);
+	context = xnew(rdpContext);
+
+	instance->context = context;
+	instance->update = update;
+	instance->settings = settings_new(NULL);
+	instance->settings->instance = instance;
+
+	update->context = context;
+	update->primary = xnew(rdpPrimaryUpdate);
+	update->secondary = xnew(rdpSecondaryUpdate);
+	update->altsec = xnew(rdpAltSecUpdate);
+	update->pointer = xnew(rdpPointerUpdate);
+
+	context->instance = instance;
+	context->graphics = graphics_new(context);
+	context->cache = xnew(rdpCache);
+
+	return context;
+}
+
+void test_context_free(rdpContext* context)
+{
+	freerdp* instance = context->instance;
+	rdpUpdate* update = instance->update;
+
+	free(update->primary);
+	free(update->secondary);
+	free(update->altsec);
+	free(update->pointer);
+	free(update);
+
+	free(context->cache);
+	graphics_free(context->graphics);
+	settings_free(instance->settings);
+
+	free(context);
+	free(instance);
+}
+
 typedef BOOL (*pInitTestSuite)(void);
 
 struct _test_suite
@@ -117,19 +190,34 @@ const static test_suite suites[] =
 {
 	{ "bitmap", add_bitmap_suite },
 	//{ "cliprdr", add_cliprdr_suite },
+	{ "clipboard", add_clipboard_suite },
 	{ "color", add_color_suite },
 	//{ "drdynvc", add_drdynvc_suite },
+	{ "dsp", add_dsp_suite },
 	//{ "gcc", add_gcc_suite },
 	{ "gdi", add_gdi_suite },
+	{ "glyph", add_glyph_suite },
 	{ "license", add_license_suite },
 	//{ "mcs", add_mcs_suite },
+	{ "metrics", add_metrics_suite },
 	{ "mppc", add_mppc_suite },
 	{ "mppc_enc", add_mppc_enc_suite },
 	{ "ntlm", add_ntlm_suite },
+	{ "offscreen", add_offscreen_suite },
 	//{ "orders", add_orders_suite },
+	{ "orders_enc", add_orders_enc_suite },
 	{ "pcap", add_pcap_suite },
 	//{ "rail", add_rail_suite },
+	{ "reassembly", add_reassembly_suite },
+	{ "persistent", add_persistent_suite },
+	{ "pointer", add_pointer_suite },
+	{ "rdpsnd", add_rdpsnd_suite },
+	{ "reconnect", add_reconnect_suite },
 	{ "rfx", add_rfx_suite },
+	{ "rpc", add_rpc_suite },
+	{ "replay", add_replay_suite },
+	{ "security", add_security_suite },
+	{ "window_list", add_window_list_suite },
 	{ "nsc", add_nsc_suite }
 };
 #define N_SUITES (sizeof suites / sizeof suites[0])
@@ -22,6 +22,7 @@
 #include <string.h>
 #include <CUnit/CUnit.h>
 #include <freerdp/types.h>
+#include <freerdp/freerdp.h>
 #include <freerdp/utils/stream.h>
 #include <freerdp/utils/hexdump.h>
 
@@ -41,3 +42,6 @@ void dump_data(unsigned char * p, int len, int width, char* name);
 void assert_stream(STREAM* s, BYTE* data, int length, const char* func, int line);
 
 #define ASSERT_STREAM(_s, _data, _length) assert_stream(_s, _data, _length, __FUNCTION__, __LINE__)
+
+rdpContext* test_context_new(void);
+void test_context_free(rdpContext* context);
@@ -20,7 +20,9 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <sys/time.h>
 #include <freerdp/freerdp.h>
+#include <freerdp/constants.h>
 
 #include <freerdp/gdi/gdi.h>
 
@@ -35,6 +37,8 @@
 #include <freerdp/gdi/drawing.h>
 #include <freerdp/gdi/clipping.h>
 #include <freerdp/gdi/32bpp.h>
+#include <freerdp/gdi/16bpp.h>
+#include <freerdp/gdi/rop.h>
 
 #include "test_gdi.h"
 
@@ -74,6 +78,9 @@ int add_gdi_suite(void)
 	add_test_function(gdi_BitBlt_8bpp);
 	add_test_function(gdi_ClipCoords);
 	add_test_function(gdi_InvalidateRegion);
+	add_test_function(gdi_order_batch);
+	add_test_function(gdi_rop);
+	add_test_function(gdi_rop_benchmark);
 
 	return 0;
 }
@@ -2989,3 +2996,477 @@ void test_gdi_InvalidateRegion(void)
 	gdi_InvalidateRegion(hdc, rgn1->x, rgn1->y, rgn1->w, rgn1->h);
 	CU_ASSERT(gdi_EqualRgn(invalid, rgn2) == 1);
 }
+
+static int batch_calls;
+
+static void test_batch_memblt(rdpContext* context, MEMBLT_ORDER* memblt)
+{
+	batch_calls++;
+}
+
+static ORDER_BATCH_ENTRY* test_batch_add(ORDER_BATCH* batch, UINT32 orderType, int x, int y, int w, int h)
+{
+	ORDER_BATCH_ENTRY* entry = &batch->entries[batch->count++];
+
+	memset(entry, 0, sizeof(ORDER_BATCH_ENTRY));
+	entry->orderType = orderType;
+
+	if (orderType == ORDER_BATCH_MEMBLT)
+	{
+		entry->order.memblt.nLeftRect = x;
+		entry->order.memblt.nTopRect = y;
+		entry->order.memblt.nWidth = w;
+		entry->order.memblt.nHeight = h;
+	}
+	else if (orderType == ORDER_BATCH_SCRBLT)
+	{
+		entry->order.scrblt.nLeftRect = x;
+		entry->order.scrblt.nTopRect = y;
+		entry->order.scrblt.nWidth = w;
+		entry->order.scrblt.nHeight = h;
+		entry->order.scrblt.nXSrc = x;
+		entry->order.scrblt.nYSrc = y;
+		entry->order.scrblt.bRop = GDI_SRCCOPY;
+	}
+	else
+	{
+		entry->order.opaque_rect.nLeftRect = x;
+		entry->order.opaque_rect.nTopRect = y;
+		entry->order.opaque_rect.nWidth = w;
+		entry->order.opaque_rect.nHeight = h;
+	}
+
+	return entry;
+}
+
+static void test_batch_bound(ORDER_BATCH_ENTRY* entry, int left, int top, int right, int bottom)
+{
+	entry->bounded = TRUE;
+	entry->bounds.left = left;
+	entry->bounds.top = top;
+	entry->bounds.right = right;
+	entry->bounds.bottom = bottom;
+}
+
+void test_gdi_order_batch(void)
+{
+	rdpGdi gdi;
+	gdiBitmap surface;
+	freerdp instance;
+	rdpUpdate update;
+	rdpContext context;
+	ORDER_BATCH batch;
+	HGDI_BITMAP hBmp;
+	CLRCONV clrconv;
+	rdpPalette palette;
+	rdpPrimaryUpdate primary;
+	ORDER_BATCH_ENTRY entries[16];
+	ORDER_BATCH_ENTRY* entry;
+
+	memset(&gdi, 0, sizeof(rdpGdi));
+	memset(&surface, 0, sizeof(gdiBitmap));
+	memset(&instance, 0, sizeof(freerdp));
+	memset(&update, 0, sizeof(rdpUpdate));
+	memset(&context, 0, sizeof(rdpContext));
+	memset(&clrconv, 0, sizeof(CLRCONV));
+	memset(&palette, 0, sizeof(rdpPalette));
+	memset(&primary, 0, sizeof(rdpPrimaryUpdate));
+
+	context.gdi = &gdi;
+	context.instance = &instance;
+	instance.update = &update;
+	update.primary = &primary;
+	primary.MemBlt = test_batch_memblt;
+
+	/* orders without a cache index are drawn straight onto the surface */
+	gdi.width = 320;
+	gdi.height = 240;
+	gdi.srcBpp = 32;
+	gdi.dstBpp = 32;
+	gdi.bytesPerPixel = 4;
+	gdi.clrconv = &clrconv;
+	clrconv.palette = &palette;
+	gdi.hdc = gdi_GetDC();
+	gdi.hdc->bitsPerPixel = 32;
+	gdi.hdc->bytesPerPixel = 4;
+	hBmp = gdi_CreateCompatibleBitmap(gdi.hdc, gdi.width, gdi.height);
+	surface.hdc = gdi_CreateCompatibleDC(gdi.hdc);
+	gdi_SelectObject(surface.hdc, (HGDIOBJECT) hBmp);
+	gdi.primary = gdi.drawing = &surface;
+	memset(hBmp->data, 0, gdi.width * gdi.height * 4);
+
+	batch.entries = entries;
+	batch.size = 16;
+
+	/* a memblt covered by a later opaque rectangle is skipped */
+	batch.count = 0;
+	batch_calls = 0;
+	test_batch_add(&batch, ORDER_BATCH_MEMBLT, 10, 10, 20, 20);
+	entry = test_batch_add(&batch, ORDER_BATCH_OPAQUE_RECT, 0, 0, 100, 100);
+	entry->order.opaque_rect.color = 0x00FF00;
+	gdi_order_batch(&context, &batch);
+	CU_ASSERT(batch_calls == 0);
+	CU_ASSERT(gdi_GetPixel_32bpp(hBmp, 15, 15) != 0);
+	CU_ASSERT(gdi_GetPixel_32bpp(hBmp, 99, 99) != 0);
+	CU_ASSERT(gdi_GetPixel_32bpp(hBmp, 100, 100) == 0);
+
+	/* unless a screen to screen blit reads it in between */
+	batch.count = 0;
+	batch_calls = 0;
+	test_batch_add(&batch, ORDER_BATCH_MEMBLT, 10, 10, 20, 20);
+	test_batch_add(&batch, ORDER_BATCH_SCRBLT, 200, 200, 20, 20);
+	test_batch_add(&batch, ORDER_BATCH_OPAQUE_RECT, 0, 0, 100, 100);
+	gdi_order_batch(&context, &batch);
+	CU_ASSERT(batch_calls == 1);
+
+	/* adjacent opaque rectangles of the same color are merged */
+	memset(hBmp->data, 0, gdi.width * gdi.height * 4);
+	batch.count = 0;
+	batch_calls = 0;
+	test_batch_add(&batch, ORDER_BATCH_OPAQUE_RECT, 0, 0, 100, 10)->order.opaque_rect.color = 0x00FF00;
+	test_batch_add(&batch, ORDER_BATCH_OPAQUE_RECT, 0, 10, 100, 10)->order.opaque_rect.color = 0x00FF00;
+	test_batch_add(&batch, ORDER_BATCH_OPAQUE_RECT, 0, 20, 100, 10)->order.opaque_rect.color = 0x00FF00;
+	test_batch_add(&batch, ORDER_BATCH_OPAQUE_RECT, 0, 30, 100, 10)->order.opaque_rect.color = 0xFF;
+	gdi_order_batch(&context, &batch);
+	CU_ASSERT(entries[0].order.opaque_rect.nHeight == 30);
+	CU_ASSERT(entries[1].skip && entries[2].skip && !entries[3].skip);
+	CU_ASSERT(gdi_GetPixel_32bpp(hBmp, 50, 25) == gdi_GetPixel_32bpp(hBmp, 50, 5));
+	CU_ASSERT(gdi_GetPixel_32bpp(hBmp, 50, 35) != gdi_GetPixel_32bpp(hBmp, 50, 5));
+	CU_ASSERT(gdi_GetPixel_32bpp(hBmp, 50, 35) != 0);
+	CU_ASSERT(gdi_GetPixel_32bpp(hBmp, 50, 45) == 0);
+
+	/* bounded opaque rectangles are clipped up front, other orders share the clipping region */
+	memset(hBmp->data, 0, gdi.width * gdi.height * 4);
+	batch.count = 0;
+	batch_calls = 0;
+	entry = test_batch_add(&batch, ORDER_BATCH_OPAQUE_RECT, 0, 0, 100, 100);
+	entry->order.opaque_rect.color = 0x00FF00;
+	test_batch_bound(entry, 50, 40, 59, 49);
+	entry = test_batch_add(&batch, ORDER_BATCH_MEMBLT, 200, 0, 100, 100);
+	test_batch_bound(entry, 200, 0, 210, 10);
+	entry = test_batch_add(&batch, ORDER_BATCH_MEMBLT, 205, 0, 100, 100);
+	test_batch_bound(entry, 200, 0, 210, 10);
+	gdi_order_batch(&context, &batch);
+	CU_ASSERT(batch_calls == 2);
+	CU_ASSERT(entries[0].order.opaque_rect.nLeftRect == 50);
+	CU_ASSERT(entries[0].order.opaque_rect.nTopRect == 40);
+	CU_ASSERT(entries[0].order.opaque_rect.nWidth == 10);
+	CU_ASSERT(entries[0].order.opaque_rect.nHeight == 10);
+	CU_ASSERT(gdi_GetPixel_32bpp(hBmp, 50, 40) != 0);
+	CU_ASSERT(gdi_GetPixel_32bpp(hBmp, 59, 49) != 0);
+	CU_ASSERT(gdi_GetPixel_32bpp(hBmp, 49, 45) == 0);
+	CU_ASSERT(gdi_GetPixel_32bpp(hBmp, 60, 45) == 0);
+	CU_ASSERT(gdi_GetPixel_32bpp(hBmp, 55, 50) == 0);
+	CU_ASSERT(gdi.drawing->hdc->clip->null == 1);
+
+	gdi_DeleteObject((HGDIOBJECT) hBmp);
+	gdi_DeleteDC(surface.hdc);
+	gdi_DeleteDC(gdi.hdc);
+}
+
+/* Evaluate a ternary raster operation from its truth table, one bit at a time */
+
+static BYTE test_rop3(int rop, BYTE d, BYTE s, BYTE p)
+{
+	int bit;
+	int index;
+	BYTE result = 0;
+
+	for (bit = 0; bit < 8; bit++)
+	{
+		index = (((p >> bit) & 1) << 2) | (((s >> bit) & 1) << 1) | ((d >> bit) & 1);
+		result |= ((rop >> (16 + index)) & 1) << bit;
+	}
+
+	return result;
+}
+
+static HGDI_DC test_rop_dc(int bpp, int width, int height)
+{
+	int i;
+	BYTE* data;
+	HGDI_DC hdc;
+
+	hdc = gdi_GetDC();
+	hdc->bytesPerPixel = bpp / 8;
+	hdc->bitsPerPixel = bpp;
+	hdc->alpha = 0;
+	hdc->invert = 0;
+	hdc->rgb555 = 0;
+	hdc->textColor = 0x00123456;
+	hdc->brush = NULL;
+
+	data = (BYTE*) malloc(width * height * hdc->bytesPerPixel);
+
+	for (i = 0; i < width * height * hdc->bytesPerPixel; i++)
+		data[i] = rand();
+
+	gdi_SelectObject(hdc, (HGDIOBJECT) gdi_CreateBitmap(width, height, bpp, data));
+
+	return hdc;
+}
+
+static void test_rop_dc_free(HGDI_DC hdc)
+{
+	gdi_DeleteObject(hdc->selectedObject);
+	gdi_DeleteDC(hdc);
+}
+
+/**
+ * Blit a rectangle at odd offsets, so that the vector kernels see
+ * both full vectors and leftover bytes, and check every byte of the
+ * destination against the truth table. The pattern is the brush pattern
+ * unless a solid color is given, a 1bpp source is expanded to the
+ * destination depth.
+ */
+
+static BOOL test_rop_check(HGDI_DC hdcDst, HGDI_DC hdcSrc, int rop, BYTE* color)
+{
+	int x, y, b;
+	int bpp, srcBpp;
+	BYTE d, s, p;
+	BYTE* data;
+	BYTE* original;
+	BYTE* pattern = NULL;
+	HGDI_BITMAP hBmpDst;
+	HGDI_BITMAP hBmpSrc;
+	BOOL status = TRUE;
+
+	bpp = hdcDst->bytesPerPixel;
+	srcBpp = hdcSrc->bytesPerPixel;
+	hBmpDst = (HGDI_BITMAP) hdcDst->selectedObject;
+	hBmpSrc = (HGDI_BITMAP) hdcSrc->selectedObject;
+
+	if ((color == NULL) && (hdcDst->brush != NULL))
+		pattern = hdcDst->brush->pattern->data;
+
+	original = (BYTE*) malloc(hBmpDst->scanline * hBmpDst->height);
+	memcpy(original, hBmpDst->data, hBmpDst->scanline * hBmpDst->height);
+
+	gdi_BitBlt(hdcDst, 3, 2, 61, 10, hdcSrc, 1, 1, rop);
+
+	data = hBmpDst->data;
+
+	for (y = 0; y < hBmpDst->height; y++)
+	{
+		for (x = 0; x < hBmpDst->width; x++)
+		{
+			for (b = 0; b < bpp; b++)
+			{
+				d = original[(y * hBmpDst->width + x) * bpp + b];
+
+				if ((x >= 3) && (x < 64) && (y >= 2) && (y < 12))
+				{
+					s = hBmpSrc->data[((y - 1) * hBmpSrc->width + (x - 2)) * srcBpp + ((srcBpp == 1) ? 0 : b)];
+					p = pattern ? pattern[(((y - 2) % 8) * 8 + ((x - 3) % 8)) * bpp + b] : color[b];
+					d = test_rop3(rop, d, s, p);
+				}
+
+				if (data[(y * hBmpDst->width + x) * bpp + b] != d)
+					status = FALSE;
+			}
+		}
+	}
+
+	free(original);
+
+	return status;
+}
+
+void test_gdi_rop(void)
+{
+	int i, j, k;
+	UINT16 color16;
+	UINT32 color32;
+	HGDI_DC hdcSrc;
+	HGDI_DC hdcDst;
+	HGDI_DC hdcMono;
+	HGDI_DC hdcPat;
+	HGDI_BRUSH hBrush;
+	HGDI_BITMAP hBmp;
+	BYTE* original;
+	BYTE* data;
+	BOOL status;
+	int bpps[3] = { 8, 16, 32 };
+	UINT32 cpu_opts[2] = { 0, CPU_SSE2 };
+	int rops[17] =
+	{
+		GDI_NOTSRCCOPY, GDI_DSTINVERT, GDI_SRCERASE, GDI_NOTSRCERASE, GDI_SRCINVERT,
+		GDI_SRCAND, GDI_SRCPAINT, GDI_PSDPxax, GDI_SPna, GDI_DSna, GDI_DPa, GDI_PDxn,
+		GDI_MERGECOPY, GDI_MERGEPAINT, GDI_PATCOPY, GDI_PATINVERT, GDI_PATPAINT
+	};
+
+	CU_ASSERT(GDI_ROP_USES_SRC(GDI_SRCCOPY) && !GDI_ROP_USES_PAT(GDI_SRCCOPY));
+	CU_ASSERT(!GDI_ROP_USES_SRC(GDI_PATINVERT) && GDI_ROP_USES_PAT(GDI_PATINVERT));
+	CU_ASSERT(GDI_ROP_USES_SRC(GDI_DSPDxax) && GDI_ROP_USES_PAT(GDI_DSPDxax));
+	CU_ASSERT(!GDI_ROP_USES_SRC(GDI_DSTINVERT) && !GDI_ROP_USES_PAT(GDI_DSTINVERT));
+	CU_ASSERT(gdi_rop_get_row(GDI_SRCCOPY) == NULL);
+
+	for (k = 0; k < 2; k++)
+	{
+		gdi_rop_set_cpu_opt(cpu_opts[k]);
+
+		for (j = 0; j < 3; j++)
+		{
+			hdcSrc = test_rop_dc(bpps[j], 67, 13);
+			hdcDst = test_rop_dc(bpps[j], 67, 13);
+			hdcPat = test_rop_dc(bpps[j], 8, 8);
+
+			/* brush pattern */
+			hBrush = gdi_CreatePatternBrush((HGDI_BITMAP) hdcPat->selectedObject);
+			gdi_SelectObject(hdcDst, (HGDIOBJECT) hBrush);
+
+			for (i = 0; i < 17; i++)
+			{
+				status = test_rop_check(hdcDst, hdcSrc, rops[i], NULL);
+				CU_ASSERT(status);
+
+				if (!status)
+					printf("\nrop 0x%08X failed at %dbpp, cpu_opt %d", rops[i], bpps[j], cpu_opts[k]);
+			}
+
+			gdi_DeleteObject((HGDIOBJECT) hBrush);
+
+			/* solid brush */
+			hBrush = gdi_CreateSolidBrush(0x00ABCDEF);
+			gdi_SelectObject(hdcDst, (HGDIOBJECT) hBrush);
+
+			if (bpps[j] == 32)
+			{
+				color32 = gdi_get_color_32bpp(hdcDst, hBrush->color);
+				CU_ASSERT(test_rop_check(hdcDst, hdcSrc, GDI_PATCOPY, (BYTE*) &color32));
+				CU_ASSERT(test_rop_check(hdcDst, hdcSrc, GDI_PATINVERT, (BYTE*) &color32));
+				CU_ASSERT(test_rop_check(hdcDst, hdcSrc, GDI_PSDPxax, (BYTE*) &color32));
+			}
+			else if (bpps[j] == 16)
+			{
+				color16 = gdi_get_color_16bpp(hdcDst, hBrush->color);
+				CU_ASSERT(test_rop_check(hdcDst, hdcSrc, GDI_PATCOPY, (BYTE*) &color16));
+				CU_ASSERT(test_rop_check(hdcDst, hdcSrc, GDI_PATINVERT, (BYTE*) &color16));
+				CU_ASSERT(test_rop_check(hdcDst, hdcSrc, GDI_PSDPxax, (BYTE*) &color16));
+			}
+
+			gdi_DeleteObject((HGDIOBJECT) hBrush);
+			hdcDst->brush = NULL;
+
+			/* glyphs, drawn from a 1bpp source in the text color */
+			if (bpps[j] > 8)
+			{
+				hdcMono = test_rop_dc(8, 67, 13);
+				hBmp = (HGDI_BITMAP) hdcMono->selectedObject;
+
+				for (i = 0; i < 67 * 13; i++)
+					hBmp->data[i] = (hBmp->data[i] & 1) ? 0xFF : 0;
+
+				color32 = gdi_get_color_32bpp(hdcDst, hdcDst->textColor);
+				color16 = gdi_get_color_16bpp(hdcDst, hdcDst->textColor);
+
+				CU_ASSERT(test_rop_check(hdcDst, hdcMono, GDI_DSPDxax,
+					(bpps[j] == 32) ? (BYTE*) &color32 : (BYTE*) &color16));
+
+				test_rop_dc_free(hdcMono);
+			}
+
+			/* overlapping blits read the source as it was before the blit */
+			hBmp = (HGDI_BITMAP) hdcDst->selectedObject;
+			original = (BYTE*) malloc(hBmp->scanline * hBmp->height);
+			memcpy(original, hBmp->data, hBmp->scanline * hBmp->height);
+
+			gdi_BitBlt(hdcDst, 1, 0, 66, 13, hdcDst, 0, 0, GDI_SRCINVERT);
+			gdi_BitBlt(hdcDst, 0, 1, 67, 12, hdcDst, 0, 0, GDI_SRCINVERT);
+
+			data = hBmp->data;
+			status = TRUE;
+
+			for (i = hBmp->scanline * hBmp->height - 1; i >= 0; i--)
+			{
+				if ((i % hBmp->scanline) >= hBmp->bytesPerPixel)
+					original[i] ^= original[i - hBmp->bytesPerPixel];
+			}
+
+			for (i = hBmp->scanline * hBmp->height - 1; i >= hBmp->scanline; i--)
+				original[i] ^= original[i - hBmp->scanline];
+
+			for (i = 0; i < hBmp->scanline * hBmp->height; i++)
+			{
+				if (data[i] != original[i])
+					status = FALSE;
+			}
+
+			CU_ASSERT(status);
+
+			free(original);
+			gdi_DeleteDC(hdcPat);
+			test_rop_dc_free(hdcDst);
+			test_rop_dc_free(hdcSrc);
+		}
+	}
+
+	gdi_rop_set_cpu_opt(CPU_SSE2);
+}
+
+static long test_rop_elapsed(struct timeval* start_time)
+{
+	struct timeval end_time;
+
+	gettimeofday(&end_time, NULL);
+
+	return ((end_time.tv_sec - start_time->tv_sec) * 1000000) + (end_time.tv_usec - start_time->tv_usec);
+}
+
+/**
+ * Full screen blits at 32bpp as seen from the software GDI: a patterned
+ * background, a source blit and glyph drawing, with and without SSE2.
+ */
+
+void test_gdi_rop_benchmark(void)
+{
+	int i, j, k;
+	long duration;
+	HGDI_DC hdcSrc;
+	HGDI_DC hdcDst;
+	HGDI_DC hdcPat;
+	HGDI_DC hdcMono;
+	HGDI_BRUSH hBrush;
+	struct timeval start_time;
+	UINT32 cpu_opts[2] = { 0, CPU_SSE2 };
+	int rops[3] = { GDI_PATINVERT, GDI_SRCINVERT, GDI_DSPDxax };
+	char* names[3] = { "PATINVERT", "SRCINVERT", "DSPDxax" };
+
+	hdcSrc = test_rop_dc(32, 1024, 768);
+	hdcDst = test_rop_dc(32, 1024, 768);
+	hdcPat = test_rop_dc(32, 8, 8);
+	hdcMono = test_rop_dc(8, 1024, 768);
+
+	hBrush = gdi_CreatePatternBrush((HGDI_BITMAP) hdcPat->selectedObject);
+	gdi_SelectObject(hdcDst, (HGDIOBJECT) hBrush);
+
+	for (k = 0; k < 2; k++)
+	{
+		gdi_rop_set_cpu_opt(cpu_opts[k]);
+
+		for (j = 0; j < 3; j++)
+		{
+			gettimeofday(&start_time, NULL);
+
+			for (i = 0; i < 50; i++)
+			{
+				gdi_BitBlt(hdcDst, 0, 0, 1024, 768, (rops[j] == GDI_DSPDxax) ? hdcMono : hdcSrc,
+					0, 0, rops[j]);
+			}
+
+			duration = test_rop_elapsed(&start_time);
+			printf("\n%s %s: 50 blits of 1024x768 in %ld us (%.1f Mpixels/s)", names[j],
+				cpu_opts[k] ? "sse2" : "generic", duration,
+				(50.0 * 1024 * 768) / (duration > 0 ? duration : 1));
+		}
+	}
+
+	gdi_rop_set_cpu_opt(CPU_SSE2);
+
+	gdi_DeleteObject((HGDIOBJECT) hBrush);
+	test_rop_dc_free(hdcMono);
+	gdi_DeleteDC(hdcPat);
+	test_rop_dc_free(hdcDst);
+	test_rop_dc_free(hdcSrc);
+}
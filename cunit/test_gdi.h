@@ -45,3 +45,6 @@ void test_gdi_BitBlt_16bpp(void);
 void test_gdi_BitBlt_8bpp(void);
 void test_gdi_ClipCoords(void);
 void test_gdi_InvalidateRegion(void);
+void test_gdi_order_batch(void);
+void test_gdi_rop(void);
+void test_gdi_rop_benchmark(void);
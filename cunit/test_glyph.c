@@ -0,0 +1,266 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Glyph Cache Unit Tests
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <freerdp/freerdp.h>
+#include <freerdp/graphics.h>
+#include <freerdp/utils/memory.h>
+#include <freerdp/cache/glyph.h>
+
+#include "test_glyph.h"
+
+static rdpContext* context;
+static rdpUpdate* update;
+static rdpSettings* settings;
+static rdpGlyphCache* glyph_cache;
+
+static int glyph_news;
+static int glyph_draws;
+static rdpGlyph* last_drawn;
+static int last_x;
+static int last_y;
+
+static void test_Glyph_New(rdpContext* context, rdpGlyph* glyph)
+{
+	glyph_news++;
+}
+
+static void test_Glyph_Free(rdpContext* context, rdpGlyph* glyph)
+{
+
+}
+
+static void test_Glyph_Draw(rdpContext* context, rdpGlyph* glyph, int x, int y)
+{
+	glyph_draws++;
+	last_drawn = glyph;
+	last_x = x;
+	last_y = y;
+}
+
+static void test_Glyph_BeginDraw(rdpContext* context, int x, int y, int width, int height, UINT32 bgcolor, UINT32 fgcolor)
+{
+
+}
+
+static void test_Glyph_EndDraw(rdpContext* context, int x, int y, int width, int height, UINT32 bgcolor, UINT32 fgcolor)
+{
+
+}
+
+int init_glyph_suite(void)
+{
+	int i;
+	rdpGlyph glyph;
+
+	memset(&glyph, 0, sizeof(rdpGlyph));
+	glyph.size = sizeof(rdpGlyph);
+	glyph.New = test_Glyph_New;
+	glyph.Free = test_Glyph_Free;
+	glyph.Draw = test_Glyph_Draw;
+	glyph.BeginDraw = test_Glyph_BeginDraw;
+	glyph.EndDraw = test_Glyph_EndDraw;
+
+	context = test_context_new();
+	update = context->instance->update;
+	settings = context->instance->settings;
+
+	for (i = 0; i < 10; i++)
+	{
+		settings->glyphCache[i].cacheEntries = 64;
+		settings->glyphCache[i].cacheMaximumCellSize = 256;
+	}
+
+	graphics_register_glyph(context->graphics, &glyph);
+
+	glyph_cache = glyph_cache_new(settings);
+	context->cache->glyph = glyph_cache;
+	glyph_cache_register_callbacks(update);
+
+	return 0;
+}
+
+int clean_glyph_suite(void)
+{
+	glyph_cache_free(glyph_cache);
+	test_context_free(context);
+	return 0;
+}
+
+int add_glyph_suite(void)
+{
+	add_test_suite(glyph);
+
+	add_test_function(glyph_run_cache);
+	add_test_function(glyph_run_composite);
+	add_test_function(glyph_run_eviction);
+
+	return 0;
+}
+
+static BYTE glyph_a[] = { 0xF0, 0x90, 0x90, 0xF0 }; /* 4x4 box */
+static BYTE glyph_b[] = { 0xFF, 0x80, 0x00, 0x00, 0x7F, 0x80 }; /* 9x3 */
+static BYTE glyph_c[] = { 0x00, 0x00, 0xC0, 0x00, 0x00, 0x00 }; /* 9x3 */
+
+static void test_glyph_put(UINT32 id, UINT32 index, int cx, int cy, BYTE* aj, int cb)
+{
+	rdpGlyph* glyph;
+
+	glyph = Glyph_Alloc(context);
+	glyph->x = 0;
+	glyph->y = -cy;
+	glyph->cx = cx;
+	glyph->cy = cy;
+	glyph->cb = cb;
+	glyph->aj = (BYTE*) malloc(cb);
+	memcpy(glyph->aj, aj, cb);
+	Glyph_New(context, glyph);
+
+	glyph_cache_put(glyph_cache, id, index, glyph);
+}
+
+static void test_glyph_index(UINT32 cacheId, BYTE* data, int length, int x, int y)
+{
+	GLYPH_INDEX_ORDER glyph_index;
+
+	memset(&glyph_index, 0, sizeof(GLYPH_INDEX_ORDER));
+	glyph_index.cacheId = cacheId;
+	glyph_index.flAccel = SO_CHAR_INC_EQUAL_BM_BASE;
+	glyph_index.x = x;
+	glyph_index.y = y;
+	glyph_index.cbData = length;
+	memcpy(glyph_index.data, data, length);
+
+	IFCALL(update->primary->GlyphIndex, context, &glyph_index);
+}
+
+void test_glyph_run_cache(void)
+{
+	BYTE text[] = { 1, 2, 1 };
+	BYTE other[] = { 2, 1, 2 };
+	rdpGlyph* run;
+
+	glyph_cache_run_reset(glyph_cache);
+	test_glyph_put(0, 1, 4, 4, glyph_a, sizeof(glyph_a));
+	test_glyph_put(0, 2, 9, 3, glyph_b, sizeof(glyph_b));
+
+	/* drawn glyph by glyph the first time */
+	glyph_draws = glyph_news = 0;
+	test_glyph_index(0, text, sizeof(text), 10, 20);
+	CU_ASSERT(glyph_draws == 3);
+	CU_ASSERT(glyph_news == 0);
+	CU_ASSERT(last_x == 10 + 4 + 9);
+	CU_ASSERT(last_y == 20 - 4);
+	CU_ASSERT(glyph_cache->runCache.misses == 1);
+
+	/* composited the second time, at a different origin */
+	glyph_draws = 0;
+	test_glyph_index(0, text, sizeof(text), 100, 200);
+	CU_ASSERT(glyph_draws == 1);
+	CU_ASSERT(glyph_news == 1);
+	CU_ASSERT(last_x == 100);
+	CU_ASSERT(last_y == 200 - 4);
+	CU_ASSERT(last_drawn->cx == 17);
+	CU_ASSERT(last_drawn->cy == 4);
+	CU_ASSERT(glyph_cache->runCache.hits == 1);
+
+	run = last_drawn;
+	glyph_draws = 0;
+	test_glyph_index(0, text, sizeof(text), 0, 0);
+	CU_ASSERT(glyph_draws == 1);
+	CU_ASSERT(last_drawn == run);
+	CU_ASSERT(glyph_news == 1);
+	CU_ASSERT(glyph_cache->runCache.hits == 2);
+
+	/* a different run or glyph cache misses */
+	glyph_draws = 0;
+	test_glyph_index(0, other, sizeof(other), 0, 0);
+	CU_ASSERT(glyph_draws == 3);
+	CU_ASSERT(glyph_cache->runCache.misses == 2);
+
+	/* replacing a glyph invalidates the runs using it */
+	test_glyph_put(0, 2, 9, 3, glyph_c, sizeof(glyph_c));
+	glyph_draws = 0;
+	test_glyph_index(0, text, sizeof(text), 0, 0);
+	CU_ASSERT(glyph_draws == 3);
+	CU_ASSERT(glyph_news == 2);
+
+	glyph_draws = 0;
+	test_glyph_index(0, text, sizeof(text), 0, 0);
+	CU_ASSERT(glyph_draws == 1);
+	CU_ASSERT(glyph_news == 3);
+	CU_ASSERT(last_drawn->aj[6] == 0x9C);
+	CU_ASSERT(glyph_cache->runCache.count == 2);
+}
+
+void test_glyph_run_composite(void)
+{
+	int i;
+	BYTE text[] = { 3, 4, 3 };
+	BYTE expected[] =
+	{
+		0x80, 0x20,
+		0xFF, 0xE0,
+		0x80, 0x20,
+		0xBF, 0xE0
+	};
+	BYTE column[] = { 0x80, 0x80, 0x80, 0x80 }; /* 1x4 */
+
+	glyph_cache_run_reset(glyph_cache);
+	test_glyph_put(1, 3, 1, 4, column, sizeof(column));
+	test_glyph_put(1, 4, 9, 3, glyph_b, sizeof(glyph_b));
+
+	/* glyphs are placed at odd bit offsets within the mask */
+	for (i = 0; i < 2; i++)
+		test_glyph_index(1, text, sizeof(text), 0, 0);
+
+	CU_ASSERT(last_drawn->cx == 11);
+	CU_ASSERT(last_drawn->cy == 4);
+	CU_ASSERT(last_drawn->cb == sizeof(expected));
+	CU_ASSERT(memcmp(last_drawn->aj, expected, sizeof(expected)) == 0);
+}
+
+void test_glyph_run_eviction(void)
+{
+	int i;
+	BYTE text[2];
+
+	glyph_cache_run_reset(glyph_cache);
+	test_glyph_put(2, 1, 4, 4, glyph_a, sizeof(glyph_a));
+
+	text[0] = 1;
+	text[1] = 1;
+
+	/* runs of the same glyph drawn with a different width each time */
+	for (i = 0; i < GLYPH_RUN_CACHE_SIZE + 10; i++)
+	{
+		glyph_cache->glyphCache[2].entries[1]->cx = 4 + i;
+		test_glyph_index(2, text, 2, 0, 0);
+	}
+
+	CU_ASSERT(glyph_cache->runCache.count == GLYPH_RUN_CACHE_SIZE);
+	CU_ASSERT(glyph_cache->runCache.evictions == 10);
+	CU_ASSERT(glyph_cache->runCache.misses == GLYPH_RUN_CACHE_SIZE + 10);
+
+	glyph_cache_run_reset(glyph_cache);
+	CU_ASSERT(glyph_cache->runCache.count == 0);
+	CU_ASSERT(glyph_cache->runCache.head == NULL);
+	CU_ASSERT(glyph_cache->runCache.tail == NULL);
+}
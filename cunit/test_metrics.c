@@ -0,0 +1,265 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Runtime Metrics Unit Tests
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "rdp.h"
+
+#include <freerdp/freerdp.h>
+#include <freerdp/utils/metrics.h>
+
+#include "test_metrics.h"
+
+static rdpMetricsSnapshot snapshot;
+
+int init_metrics_suite(void)
+{
+	return 0;
+}
+
+int clean_metrics_suite(void)
+{
+	return 0;
+}
+
+int add_metrics_suite(void)
+{
+	add_test_suite(metrics);
+
+	add_test_function(metrics_disabled);
+	add_test_function(metrics_histogram_buckets);
+	add_test_function(metrics_percentile);
+	add_test_function(metrics_concurrent_writers);
+	add_test_function(metrics_overflow_shard);
+	add_test_function(metrics_connection);
+
+	return 0;
+}
+
+void test_metrics_disabled(void)
+{
+	rdpMetrics* metrics;
+
+	metrics = metrics_new();
+
+	METRICS_ADD(metrics, METRICS_TRANSPORT_READS, 1);
+	metrics_record(metrics, METRICS_RFX_RLGR_DECODE, 100);
+	CU_ASSERT(metrics_start(metrics) == 0);
+
+	metrics_snapshot(metrics, &snapshot);
+	CU_ASSERT(snapshot.counters[METRICS_TRANSPORT_READS] == 0);
+	CU_ASSERT(snapshot.histograms[METRICS_RFX_RLGR_DECODE].count == 0);
+	CU_ASSERT(metrics->shard_count == 0);
+
+	metrics_enable(metrics, TRUE);
+	METRICS_ADD(metrics, METRICS_TRANSPORT_READS, 3);
+
+	metrics_snapshot(metrics, &snapshot);
+	CU_ASSERT(snapshot.counters[METRICS_TRANSPORT_READS] == 3);
+
+	metrics_free(metrics);
+
+	/* a connection without metrics records nothing */
+	METRICS_ADD((rdpMetrics*) NULL, METRICS_TRANSPORT_READS, 1);
+	metrics_snapshot(NULL, &snapshot);
+	CU_ASSERT(snapshot.counters[METRICS_TRANSPORT_READS] == 0);
+}
+
+void test_metrics_histogram_buckets(void)
+{
+	int bucket;
+	UINT64 value;
+	BOOL ordered = TRUE;
+
+	CU_ASSERT(metrics_histogram_bucket(0) == 0);
+	CU_ASSERT(metrics_histogram_bucket(3) == 3);
+	CU_ASSERT(metrics_histogram_bucket(4) == 4);
+	CU_ASSERT(metrics_histogram_bucket(7) == 7);
+	CU_ASSERT(metrics_histogram_bucket(8) == 8);
+	CU_ASSERT(metrics_histogram_bucket(9) == 8);
+	CU_ASSERT(metrics_histogram_bucket(10) == 9);
+	CU_ASSERT(metrics_histogram_bucket(0xFFFFFFFFFFFFFFFFULL) == METRICS_HISTOGRAM_BUCKETS - 1);
+
+	/* every bucket starts where the previous one ends */
+	for (bucket = 0; bucket < METRICS_HISTOGRAM_BUCKETS; bucket++)
+	{
+		value = metrics_histogram_bucket_value(bucket);
+
+		if (metrics_histogram_bucket(value) != bucket)
+			ordered = FALSE;
+
+		if ((bucket > 0) && (metrics_histogram_bucket(value - 1) != bucket - 1))
+			ordered = FALSE;
+	}
+
+	CU_ASSERT(ordered == TRUE);
+}
+
+void test_metrics_percentile(void)
+{
+	int i;
+	UINT64 p50, p99;
+	rdpMetrics* metrics;
+
+	metrics = metrics_new();
+	metrics_enable(metrics, TRUE);
+
+	for (i = 1; i <= 1000; i++)
+		metrics_record(metrics, METRICS_RFX_DWT_DECODE, i * 1000);
+
+	metrics_snapshot(metrics, &snapshot);
+
+	p50 = metrics_histogram_percentile(&snapshot.histograms[METRICS_RFX_DWT_DECODE], 50);
+	p99 = metrics_histogram_percentile(&snapshot.histograms[METRICS_RFX_DWT_DECODE], 99);
+
+	CU_ASSERT(snapshot.histograms[METRICS_RFX_DWT_DECODE].count == 1000);
+	CU_ASSERT(snapshot.histograms[METRICS_RFX_DWT_DECODE].sum == 500500000ULL);
+
+	/* within the 25% resolution of the buckets */
+	CU_ASSERT((p50 <= 500000) && (p50 * 5 / 4 >= 500000));
+	CU_ASSERT((p99 <= 990000) && (p99 * 5 / 4 >= 990000));
+
+	CU_ASSERT(metrics_histogram_percentile(&snapshot.histograms[METRICS_RFX_RLGR_DECODE], 50) == 0);
+
+	metrics_free(metrics);
+}
+
+#define TEST_METRICS_ITERATIONS		200000
+
+struct test_metrics_writer
+{
+	rdpMetrics* metrics;
+	int iterations;
+	int id;
+};
+
+static void* test_metrics_writer_thread(void* arg)
+{
+	int i;
+	struct test_metrics_writer* writer = (struct test_metrics_writer*) arg;
+
+	for (i = 0; i < writer->iterations; i++)
+	{
+		METRICS_ADD(writer->metrics, METRICS_TRANSPORT_READS, 1);
+		METRICS_ADD(writer->metrics, METRICS_TRANSPORT_READ_BYTES, writer->id);
+		METRICS_RECORD(writer->metrics, METRICS_CHANNEL_QUEUE_DEPTH, i % 64);
+	}
+
+	return NULL;
+}
+
+static void test_metrics_run_writers(rdpMetrics* metrics, int count, int iterations)
+{
+	int i;
+	pthread_t* threads;
+	struct test_metrics_writer* writers;
+
+	threads = (pthread_t*) malloc(sizeof(pthread_t) * count);
+	writers = (struct test_metrics_writer*) malloc(sizeof(struct test_metrics_writer) * count);
+
+	for (i = 0; i < count; i++)
+	{
+		writers[i].metrics = metrics;
+		writers[i].iterations = iterations;
+		writers[i].id = i + 1;
+		pthread_create(&threads[i], NULL, test_metrics_writer_thread, &writers[i]);
+	}
+
+	/* snapshots taken while writing must not disturb the writers */
+	for (i = 0; i < 10; i++)
+		metrics_snapshot(metrics, &snapshot);
+
+	for (i = 0; i < count; i++)
+		pthread_join(threads[i], NULL);
+
+	free(writers);
+	free(threads);
+}
+
+static void test_metrics_check_totals(rdpMetrics* metrics, int count, int iterations)
+{
+	int i;
+	UINT64 bucket_total = 0;
+	UINT64 depth_sum = 0;
+	rdpMetricsHistogram* depth;
+
+	metrics_snapshot(metrics, &snapshot);
+	depth = &snapshot.histograms[METRICS_CHANNEL_QUEUE_DEPTH];
+
+	for (i = 0; i < iterations; i++)
+		depth_sum += i % 64;
+
+	for (i = 0; i < METRICS_HISTOGRAM_BUCKETS; i++)
+		bucket_total += depth->buckets[i];
+
+	CU_ASSERT(snapshot.counters[METRICS_TRANSPORT_READS] == (UINT64) count * iterations);
+	CU_ASSERT(snapshot.counters[METRICS_TRANSPORT_READ_BYTES] == (UINT64) iterations * count * (count + 1) / 2);
+	CU_ASSERT(depth->count == (UINT64) count * iterations);
+	CU_ASSERT(depth->sum == depth_sum * count);
+	CU_ASSERT(bucket_total == depth->count);
+}
+
+void test_metrics_concurrent_writers(void)
+{
+	rdpMetrics* metrics;
+
+	metrics = metrics_new();
+	metrics_enable(metrics, TRUE);
+
+	test_metrics_run_writers(metrics, 8, TEST_METRICS_ITERATIONS);
+	test_metrics_check_totals(metrics, 8, TEST_METRICS_ITERATIONS);
+	CU_ASSERT(metrics->shard_count == 8);
+
+	/* shards of exited threads stay part of the totals */
+	test_metrics_run_writers(metrics, 8, TEST_METRICS_ITERATIONS);
+	metrics_snapshot(metrics, &snapshot);
+	CU_ASSERT(snapshot.counters[METRICS_TRANSPORT_READS] == 16ULL * TEST_METRICS_ITERATIONS);
+
+	metrics_free(metrics);
+}
+
+void test_metrics_overflow_shard(void)
+{
+	int count;
+	rdpMetrics* metrics;
+
+	metrics = metrics_new();
+	metrics_enable(metrics, TRUE);
+
+	/* threads beyond the shard slots share the overflow shard */
+	count = METRICS_MAX_SHARDS + 16;
+	test_metrics_run_writers(metrics, count, 20000);
+	test_metrics_check_totals(metrics, count, 20000);
+
+	metrics_free(metrics);
+}
+
+void test_metrics_connection(void)
+{
+	rdpRdp* rdp;
+
+	rdp = rdp_new(NULL);
+
+	CU_ASSERT(rdp->metrics != NULL);
+	CU_ASSERT(rdp->transport->metrics == rdp->metrics);
+	CU_ASSERT(rdp->metrics->enabled == FALSE);
+
+	rdp_free(rdp);
+}
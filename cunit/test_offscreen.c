@@ -0,0 +1,410 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Offscreen Cache Unit Tests
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <freerdp/freerdp.h>
+#include <freerdp/graphics.h>
+#include <freerdp/utils/memory.h>
+#include <freerdp/cache/offscreen.h>
+
+#include "test_offscreen.h"
+
+static rdpContext* context;
+static rdpUpdate* update;
+static rdpSettings* settings;
+static rdpOffscreenCache* offscreen_cache;
+
+static int bitmap_news;
+static int bitmap_frees;
+static rdpBitmap* surface;
+
+static int pressures;
+static UINT32 pressure_used;
+static UINT32 pressure_max;
+
+static void test_Bitmap_New(rdpContext* context, rdpBitmap* bitmap)
+{
+	bitmap_news++;
+}
+
+static void test_Bitmap_Free(rdpContext* context, rdpBitmap* bitmap)
+{
+	bitmap_frees++;
+}
+
+static void test_Bitmap_SetSurface(rdpContext* context, rdpBitmap* bitmap, BOOL primary)
+{
+	surface = primary ? NULL : bitmap;
+}
+
+static void test_OffscreenPressure(rdpContext* context, UINT32 usedBytes, UINT32 maxBytes)
+{
+	pressures++;
+	pressure_used = usedBytes;
+	pressure_max = maxBytes;
+}
+
+int init_offscreen_suite(void)
+{
+	rdpBitmap bitmap;
+
+	memset(&bitmap, 0, sizeof(rdpBitmap));
+	bitmap.size = sizeof(rdpBitmap);
+	bitmap.New = test_Bitmap_New;
+	bitmap.Free = test_Bitmap_Free;
+	bitmap.SetSurface = test_Bitmap_SetSurface;
+
+	context = test_context_new();
+	update = context->instance->update;
+	settings = context->instance->settings;
+	settings->color_depth = 16;
+
+	graphics_register_bitmap(context->graphics, &bitmap);
+	offscreen_cache_register_callbacks(update);
+
+	return 0;
+}
+
+int clean_offscreen_suite(void)
+{
+	test_context_free(context);
+	return 0;
+}
+
+int add_offscreen_suite(void)
+{
+	add_test_suite(offscreen);
+
+	add_test_function(offscreen_accounting);
+	add_test_function(offscreen_lru);
+	add_test_function(offscreen_budget);
+	add_test_function(offscreen_unsupported);
+	add_test_function(offscreen_sequence);
+
+	return 0;
+}
+
+static void test_offscreen_reset(UINT32 maxBytes)
+{
+	offscreen_cache = offscreen_cache_new(settings);
+	context->cache->offscreen = offscreen_cache;
+
+	if (maxBytes > 0)
+		offscreen_cache->maxBytes = maxBytes;
+
+	offscreen_cache->OffscreenPressure = test_OffscreenPressure;
+
+	bitmap_news = 0;
+	bitmap_frees = 0;
+	surface = NULL;
+	pressures = 0;
+}
+
+static void test_offscreen_done(void)
+{
+	offscreen_cache_free(offscreen_cache);
+	context->cache->offscreen = NULL;
+
+	CU_ASSERT(bitmap_news == bitmap_frees);
+}
+
+static void test_offscreen_create(UINT32 id, UINT32 cx, UINT32 cy, UINT16* indices, UINT32 count)
+{
+	CREATE_OFFSCREEN_BITMAP_ORDER create_offscreen_bitmap;
+
+	create_offscreen_bitmap.id = id;
+	create_offscreen_bitmap.cx = cx;
+	create_offscreen_bitmap.cy = cy;
+	create_offscreen_bitmap.deleteList.sIndices = count;
+	create_offscreen_bitmap.deleteList.cIndices = count;
+	create_offscreen_bitmap.deleteList.indices = indices;
+
+	IFCALL(update->altsec->CreateOffscreenBitmap, context, &create_offscreen_bitmap);
+}
+
+static void test_offscreen_switch(UINT32 id)
+{
+	SWITCH_SURFACE_ORDER switch_surface;
+
+	switch_surface.bitmapId = id;
+
+	IFCALL(update->altsec->SwitchSurface, context, &switch_surface);
+}
+
+/**
+ * Check the byte count against the bitmaps in the cache,
+ * and the LRU list against the cache entries.
+ */
+
+static BOOL test_offscreen_check(void)
+{
+	UINT32 i;
+	UINT32 used;
+	UINT32 count;
+	UINT32 linked;
+	rdpBitmap* bitmap;
+	OFFSCREEN_CACHE_ENTRY* entry;
+
+	used = 0;
+	count = 0;
+
+	for (i = 0; i < offscreen_cache->maxEntries; i++)
+	{
+		bitmap = offscreen_cache->entries[i];
+
+		if (bitmap != NULL)
+		{
+			used += bitmap->width * bitmap->height * 2;
+			count++;
+
+			if (offscreen_cache->lru[i].size != bitmap->width * bitmap->height * 2)
+				return FALSE;
+		}
+		else if (offscreen_cache->lru[i].size != 0)
+		{
+			return FALSE;
+		}
+	}
+
+	linked = 0;
+
+	for (entry = offscreen_cache->head; entry != NULL; entry = entry->next)
+	{
+		if (offscreen_cache->entries[entry - offscreen_cache->lru] == NULL)
+			return FALSE;
+
+		if ((entry->next != NULL) && (entry->next->prev != entry))
+			return FALSE;
+
+		if ((entry->next == NULL) && (offscreen_cache->tail != entry))
+			return FALSE;
+
+		linked++;
+	}
+
+	return ((used == offscreen_cache->usedBytes) && (linked == count)) ? TRUE : FALSE;
+}
+
+void test_offscreen_accounting(void)
+{
+	UINT16 indices[2];
+
+	test_offscreen_reset(0);
+
+	CU_ASSERT(offscreen_cache->maxBytes == 7680 * 1024);
+	CU_ASSERT(offscreen_cache->usedBytes == 0);
+
+	test_offscreen_create(0, 64, 64, NULL, 0);
+	test_offscreen_create(1, 100, 30, NULL, 0);
+	test_offscreen_create(2, 256, 256, NULL, 0);
+	CU_ASSERT(offscreen_cache->usedBytes == (64 * 64 + 100 * 30 + 256 * 256) * 2);
+	CU_ASSERT(test_offscreen_check());
+
+	/* creating over an existing bitmap replaces its size */
+	test_offscreen_create(1, 10, 10, NULL, 0);
+	CU_ASSERT(offscreen_cache->usedBytes == (64 * 64 + 10 * 10 + 256 * 256) * 2);
+	CU_ASSERT(bitmap_frees == 1);
+	CU_ASSERT(test_offscreen_check());
+
+	/* the delete list is applied before the new bitmap is created */
+	indices[0] = 0;
+	indices[1] = 3;
+	test_offscreen_create(3, 32, 32, indices, 2);
+	CU_ASSERT(offscreen_cache->entries[0] == NULL);
+	CU_ASSERT(offscreen_cache->entries[3] != NULL);
+	CU_ASSERT(offscreen_cache->usedBytes == (32 * 32 + 10 * 10 + 256 * 256) * 2);
+	CU_ASSERT(test_offscreen_check());
+
+	test_offscreen_switch(2);
+	CU_ASSERT(surface == offscreen_cache->entries[2]);
+	test_offscreen_switch(SCREEN_BITMAP_SURFACE);
+	CU_ASSERT(surface == NULL);
+	CU_ASSERT(test_offscreen_check());
+
+	offscreen_cache_delete(offscreen_cache, 2);
+	offscreen_cache_delete(offscreen_cache, 2);
+	CU_ASSERT(offscreen_cache->usedBytes == (32 * 32 + 10 * 10) * 2);
+	CU_ASSERT(test_offscreen_check());
+
+	CU_ASSERT(pressures == 0);
+	test_offscreen_done();
+}
+
+void test_offscreen_lru(void)
+{
+	int i;
+	OFFSCREEN_CACHE_ENTRY* lru;
+
+	test_offscreen_reset(0);
+	lru = offscreen_cache->lru;
+
+	for (i = 0; i < 4; i++)
+		test_offscreen_create(i, 16, 16, NULL, 0);
+
+	/* most recently created first */
+	CU_ASSERT(offscreen_cache->head == &lru[3]);
+	CU_ASSERT(offscreen_cache->tail == &lru[0]);
+
+	/* switching surfaces and drawing from a bitmap touch it */
+	test_offscreen_switch(0);
+	CU_ASSERT(offscreen_cache->head == &lru[0]);
+	CU_ASSERT(offscreen_cache->tail == &lru[1]);
+
+	offscreen_cache_get(offscreen_cache, 1);
+	CU_ASSERT(offscreen_cache->head == &lru[1]);
+	CU_ASSERT(offscreen_cache->tail == &lru[2]);
+
+	CU_ASSERT(lru[1].next == &lru[0]);
+	CU_ASSERT(lru[0].next == &lru[3]);
+	CU_ASSERT(lru[3].next == &lru[2]);
+	CU_ASSERT(test_offscreen_check());
+
+	test_offscreen_switch(SCREEN_BITMAP_SURFACE);
+	test_offscreen_done();
+}
+
+void test_offscreen_budget(void)
+{
+	int i;
+	UINT16 indices[3];
+
+	/* room for four 64x64 bitmaps at 16bpp */
+	test_offscreen_reset(4 * 64 * 64 * 2);
+
+	for (i = 0; i < 4; i++)
+		test_offscreen_create(i, 64, 64, NULL, 0);
+
+	CU_ASSERT(pressures == 0);
+	CU_ASSERT(offscreen_cache->usedBytes == offscreen_cache->maxBytes);
+
+	/* going over the ceiling is reported, the bitmaps the server may still draw from are kept */
+	test_offscreen_create(4, 64, 64, NULL, 0);
+	CU_ASSERT(pressures == 1);
+	CU_ASSERT(pressure_used == 5 * 64 * 64 * 2);
+	CU_ASSERT(pressure_max == offscreen_cache->maxBytes);
+
+	for (i = 0; i < 5; i++)
+		CU_ASSERT(offscreen_cache->entries[i] != NULL);
+
+	CU_ASSERT(bitmap_frees == 0);
+	CU_ASSERT(test_offscreen_check());
+
+	/* every create while over the ceiling is reported */
+	test_offscreen_create(5, 128, 128, NULL, 0);
+	CU_ASSERT(pressures == 2);
+	CU_ASSERT(pressure_used == (5 * 64 * 64 + 128 * 128) * 2);
+	CU_ASSERT(offscreen_cache->entries[5] != NULL);
+	CU_ASSERT(test_offscreen_check());
+
+	/* a server making room with the delete list is back under the ceiling */
+	pressures = 0;
+
+	indices[0] = 0;
+	indices[1] = 1;
+	indices[2] = 5;
+	test_offscreen_create(6, 64, 64, indices, 3);
+
+	CU_ASSERT(pressures == 0);
+	CU_ASSERT(offscreen_cache->usedBytes == offscreen_cache->maxBytes);
+	CU_ASSERT(test_offscreen_check());
+
+	test_offscreen_done();
+}
+
+void test_offscreen_unsupported(void)
+{
+	int i;
+
+	/* without offscreen bitmap support there is no ceiling to go over */
+	settings->offscreen_bitmap_cache = FALSE;
+	test_offscreen_reset(0);
+	settings->offscreen_bitmap_cache = TRUE;
+
+	CU_ASSERT(offscreen_cache->maxBytes == 0);
+
+	for (i = 0; i < 4; i++)
+		test_offscreen_create(i, 1024, 1024, NULL, 0);
+
+	CU_ASSERT(pressures == 0);
+	CU_ASSERT(offscreen_cache->usedBytes == 4 * 1024 * 1024 * 2);
+	CU_ASSERT(test_offscreen_check());
+
+	test_offscreen_done();
+}
+
+/**
+ * A scripted sequence of creates with delete lists, deletes and surface
+ * switches over a small cache, checking the accounting after each step.
+ */
+
+#define TEST_OFFSCREEN_STEPS		5000
+
+void test_offscreen_sequence(void)
+{
+	int i;
+	int op;
+	BOOL exact;
+	UINT32 id;
+	UINT32 seed;
+	UINT16 indices[4];
+
+	test_offscreen_reset(512 * 1024);
+
+	seed = 4321;
+	exact = TRUE;
+
+	for (i = 0; i < TEST_OFFSCREEN_STEPS; i++)
+	{
+		seed = seed * 1103515245 + 12345;
+		op = (seed >> 16) % 8;
+		id = (seed >> 8) % 64;
+
+		if (op < 4)
+		{
+			indices[0] = (seed >> 20) % 64;
+			indices[1] = (seed >> 24) % 64;
+			test_offscreen_create(id, 8 + (seed >> 4) % 300, 8 + (seed >> 12) % 200, indices, op % 3);
+		}
+		else if (op < 6)
+		{
+			if (offscreen_cache->entries[id] != NULL)
+				test_offscreen_switch(id);
+		}
+		else if (op < 7)
+		{
+			test_offscreen_switch(SCREEN_BITMAP_SURFACE);
+		}
+		else
+		{
+			if (id != offscreen_cache->currentSurface)
+				offscreen_cache_delete(offscreen_cache, id);
+		}
+
+		if (!test_offscreen_check())
+			exact = FALSE;
+	}
+
+	CU_ASSERT(exact);
+	CU_ASSERT(pressures > 0);
+	CU_ASSERT(bitmap_news - bitmap_frees > 0);
+
+	test_offscreen_switch(SCREEN_BITMAP_SURFACE);
+	test_offscreen_done();
+}
@@ -0,0 +1,668 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Drawing Order Encoder Unit Tests
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <freerdp/freerdp.h>
+#include <freerdp/utils/stream.h>
+#include <freerdp/cache/server.h>
+
+#include "test_orders_enc.h"
+#include "libfreerdp/core/orders.h"
+#include "libfreerdp/core/update.h"
+
+static rdpUpdate* server;
+static rdpUpdate* client;
+static STREAM* s;
+
+static int bounds_count;
+static BOOL bounds_set;
+static rdpBounds bounds_received;
+
+static void test_set_bounds(rdpContext* context, rdpBounds* bounds)
+{
+	bounds_count++;
+	bounds_set = (bounds != NULL) ? TRUE : FALSE;
+
+	if (bounds != NULL)
+		memcpy(&bounds_received, bounds, sizeof(rdpBounds));
+}
+
+int init_orders_enc_suite(void)
+{
+	server = update_new(NULL);
+	client = update_new(NULL);
+	s = stream_new(1024);
+
+	client->SetBounds = test_set_bounds;
+
+	return 0;
+}
+
+int clean_orders_enc_suite(void)
+{
+	stream_free(s);
+	update_free(server);
+	update_free(client);
+	return 0;
+}
+
+int add_orders_enc_suite(void)
+{
+	add_test_suite(orders_enc);
+
+	add_test_function(orders_enc_primary);
+	add_test_function(orders_enc_delta);
+	add_test_function(orders_enc_bounds);
+	add_test_function(orders_enc_secondary);
+	add_test_function(orders_enc_server_cache);
+	add_test_function(orders_enc_batch);
+
+	return 0;
+}
+
+static void test_orders_enc_reset(void)
+{
+	update_reset_state(server);
+	update_reset_state(client);
+	server->primary->bounded = FALSE;
+}
+
+/* encode a primary order on the server side and parse it back on the client side */
+
+static int test_orders_enc_roundtrip(BYTE orderType, void* order)
+{
+	int length;
+
+	stream_set_pos(s, 0);
+
+	if (!update_write_primary_order(s, server->primary, orderType, order))
+		return -1;
+
+	length = stream_get_pos(s);
+	stream_set_pos(s, 0);
+
+	if (!update_recv_order(client, s))
+		return -1;
+
+	if (stream_get_pos(s) != length)
+		return -1;
+
+	return length;
+}
+
+static BOOL test_brush_equal(rdpBrush* brush, rdpBrush* decoded)
+{
+	BYTE* data = (brush->data != NULL) ? brush->data : brush->p8x8;
+
+	if ((brush->x != decoded->x) || (brush->y != decoded->y) ||
+			(brush->style != decoded->style) || (brush->hatch != decoded->hatch))
+		return FALSE;
+
+	if (decoded->data == NULL)
+		return (memcmp(&data[1], "\0\0\0\0\0\0\0", 7) == 0);
+
+	return (memcmp(&data[1], &decoded->data[1], 7) == 0);
+}
+
+static void test_orders_enc_init_brush(rdpBrush* brush, int seed)
+{
+	int i;
+
+	memset(brush, 0, sizeof(rdpBrush));
+	brush->x = seed & 7;
+	brush->y = (seed >> 1) & 7;
+	brush->style = 3; /* BS_PATTERN */
+	brush->hatch = 0xAA;
+
+	for (i = 1; i < 8; i++)
+		brush->p8x8[i] = (BYTE) (seed * 17 + i);
+}
+
+void test_orders_enc_primary(void)
+{
+	int i;
+	DSTBLT_ORDER dstblt;
+	PATBLT_ORDER patblt;
+	SCRBLT_ORDER scrblt;
+	LINE_TO_ORDER line_to;
+	MEMBLT_ORDER memblt;
+	MEM3BLT_ORDER mem3blt;
+	OPAQUE_RECT_ORDER opaque_rect;
+	GLYPH_INDEX_ORDER glyph_index;
+
+	test_orders_enc_reset();
+
+	for (i = 0; i < 40; i++)
+	{
+		memset(&opaque_rect, 0, sizeof(OPAQUE_RECT_ORDER));
+		opaque_rect.nLeftRect = (i % 3 == 0) ? i * 100 : i;
+		opaque_rect.nTopRect = -i;
+		opaque_rect.nWidth = 64 + (i % 4);
+		opaque_rect.nHeight = 16;
+		opaque_rect.color = 0x00102030 * (i % 5);
+		CU_ASSERT(test_orders_enc_roundtrip(ORDER_TYPE_OPAQUE_RECT, &opaque_rect) > 0);
+		CU_ASSERT(memcmp(&opaque_rect, &client->primary->opaque_rect, sizeof(OPAQUE_RECT_ORDER)) == 0);
+
+		memset(&memblt, 0, sizeof(MEMBLT_ORDER));
+		memblt.cacheId = i % 3;
+		memblt.colorIndex = (i % 7 == 0) ? 1 : 0;
+		memblt.nLeftRect = i * 64;
+		memblt.nTopRect = (i / 8) * 64;
+		memblt.nWidth = 64;
+		memblt.nHeight = 64;
+		memblt.bRop = 0xCC;
+		memblt.nXSrc = 0;
+		memblt.nYSrc = i % 2;
+		memblt.cacheIndex = i * 13;
+		CU_ASSERT(test_orders_enc_roundtrip(ORDER_TYPE_MEMBLT, &memblt) > 0);
+		CU_ASSERT(memcmp(&memblt, &client->primary->memblt, sizeof(MEMBLT_ORDER)) == 0);
+
+		memset(&scrblt, 0, sizeof(SCRBLT_ORDER));
+		scrblt.nLeftRect = 10;
+		scrblt.nTopRect = 20 + i;
+		scrblt.nWidth = 300;
+		scrblt.nHeight = 200 - i;
+		scrblt.bRop = 0xCC;
+		scrblt.nXSrc = 10;
+		scrblt.nYSrc = 40 + i * 3;
+		CU_ASSERT(test_orders_enc_roundtrip(ORDER_TYPE_SCRBLT, &scrblt) > 0);
+		CU_ASSERT(memcmp(&scrblt, &client->primary->scrblt, sizeof(SCRBLT_ORDER)) == 0);
+
+		memset(&dstblt, 0, sizeof(DSTBLT_ORDER));
+		dstblt.nLeftRect = 1000 - i * 50;
+		dstblt.nTopRect = 700;
+		dstblt.nWidth = i;
+		dstblt.nHeight = i;
+		dstblt.bRop = (i % 2) ? 0x55 : 0x00;
+		CU_ASSERT(test_orders_enc_roundtrip(ORDER_TYPE_DSTBLT, &dstblt) > 0);
+		CU_ASSERT(memcmp(&dstblt, &client->primary->dstblt, sizeof(DSTBLT_ORDER)) == 0);
+
+		memset(&line_to, 0, sizeof(LINE_TO_ORDER));
+		line_to.backMode = 1;
+		line_to.nXStart = i;
+		line_to.nYStart = 2 * i;
+		line_to.nXEnd = 500 - i;
+		line_to.nYEnd = 3 * i;
+		line_to.backColor = 0xFFFFFF;
+		line_to.bRop2 = 0x0D;
+		line_to.penWidth = 1;
+		line_to.penColor = i * 0x010101;
+		CU_ASSERT(test_orders_enc_roundtrip(ORDER_TYPE_LINE_TO, &line_to) > 0);
+		CU_ASSERT(memcmp(&line_to, &client->primary->line_to, sizeof(LINE_TO_ORDER)) == 0);
+
+		memset(&patblt, 0, sizeof(PATBLT_ORDER));
+		patblt.nLeftRect = i * 8;
+		patblt.nTopRect = 8;
+		patblt.nWidth = 8;
+		patblt.nHeight = 8;
+		patblt.bRop = 0xF0;
+		patblt.backColor = 0x112233;
+		patblt.foreColor = 0x445566 + (i % 2);
+		test_orders_enc_init_brush(&patblt.brush, i / 4);
+		CU_ASSERT(test_orders_enc_roundtrip(ORDER_TYPE_PATBLT, &patblt) > 0);
+		CU_ASSERT(memcmp(&patblt, &client->primary->patblt, sizeof(INT32) * 4 + sizeof(UINT32) * 3) == 0);
+		CU_ASSERT(test_brush_equal(&patblt.brush, &client->primary->patblt.brush));
+
+		memset(&mem3blt, 0, sizeof(MEM3BLT_ORDER));
+		mem3blt.cacheId = 1;
+		mem3blt.nLeftRect = 100;
+		mem3blt.nTopRect = 100 + i;
+		mem3blt.nWidth = 32;
+		mem3blt.nHeight = 32;
+		mem3blt.bRop = 0xB8;
+		mem3blt.backColor = 0xFFFFFF;
+		mem3blt.foreColor = i;
+		mem3blt.cacheIndex = 600 - i;
+		test_orders_enc_init_brush(&mem3blt.brush, i / 8);
+		CU_ASSERT(test_orders_enc_roundtrip(ORDER_TYPE_MEM3BLT, &mem3blt) > 0);
+		CU_ASSERT(client->primary->mem3blt.cacheId == mem3blt.cacheId);
+		CU_ASSERT(client->primary->mem3blt.nTopRect == mem3blt.nTopRect);
+		CU_ASSERT(client->primary->mem3blt.foreColor == mem3blt.foreColor);
+		CU_ASSERT(client->primary->mem3blt.cacheIndex == mem3blt.cacheIndex);
+		CU_ASSERT(test_brush_equal(&mem3blt.brush, &client->primary->mem3blt.brush));
+
+		memset(&glyph_index, 0, sizeof(GLYPH_INDEX_ORDER));
+		glyph_index.cacheId = 7;
+		glyph_index.flAccel = 3;
+		glyph_index.fOpRedundant = 1;
+		glyph_index.backColor = 0xFFFFFF;
+		glyph_index.foreColor = 0x000000;
+		glyph_index.bkLeft = 20;
+		glyph_index.bkTop = 30 + (i / 2) * 16;
+		glyph_index.bkRight = 400;
+		glyph_index.bkBottom = glyph_index.bkTop + 16;
+		glyph_index.opLeft = glyph_index.bkLeft;
+		glyph_index.opTop = glyph_index.bkTop;
+		glyph_index.opRight = glyph_index.bkRight;
+		glyph_index.opBottom = glyph_index.bkBottom;
+		glyph_index.x = 20;
+		glyph_index.y = glyph_index.bkTop + 12;
+		glyph_index.cbData = 4 + (i % 3) * 2;
+		memset(glyph_index.data, i / 2, glyph_index.cbData);
+		CU_ASSERT(test_orders_enc_roundtrip(ORDER_TYPE_GLYPH_INDEX, &glyph_index) > 0);
+		CU_ASSERT(memcmp(&glyph_index, &client->primary->glyph_index, sizeof(UINT32) * 6 + sizeof(INT32) * 8) == 0);
+		CU_ASSERT(client->primary->glyph_index.x == glyph_index.x);
+		CU_ASSERT(client->primary->glyph_index.y == glyph_index.y);
+		CU_ASSERT(client->primary->glyph_index.cbData == glyph_index.cbData);
+		CU_ASSERT(memcmp(client->primary->glyph_index.data, glyph_index.data, glyph_index.cbData) == 0);
+	}
+
+	CU_ASSERT(test_orders_enc_roundtrip(0x03, &opaque_rect) == -1);
+}
+
+void test_orders_enc_delta(void)
+{
+	OPAQUE_RECT_ORDER opaque_rect;
+
+	test_orders_enc_reset();
+
+	memset(&opaque_rect, 0, sizeof(OPAQUE_RECT_ORDER));
+	opaque_rect.nLeftRect = 1000;
+	opaque_rect.nTopRect = 500;
+	opaque_rect.nWidth = 80;
+	opaque_rect.nHeight = 12;
+	opaque_rect.color = 0x00FF00;
+
+	/* controlFlags, orderType, fieldFlags, four absolute coordinates, green */
+	CU_ASSERT(test_orders_enc_roundtrip(ORDER_TYPE_OPAQUE_RECT, &opaque_rect) == 12);
+
+	/* an identical order is sent as its control flags only */
+	CU_ASSERT(test_orders_enc_roundtrip(ORDER_TYPE_OPAQUE_RECT, &opaque_rect) == 1);
+
+	/* controlFlags, fieldFlags and one delta coordinate */
+	opaque_rect.nTopRect += 12;
+	CU_ASSERT(test_orders_enc_roundtrip(ORDER_TYPE_OPAQUE_RECT, &opaque_rect) == 3);
+	CU_ASSERT(client->primary->opaque_rect.nTopRect == 512);
+
+	/* a move out of delta range falls back to absolute coordinates */
+	opaque_rect.nLeftRect -= 900;
+	opaque_rect.nTopRect += 1;
+	CU_ASSERT(test_orders_enc_roundtrip(ORDER_TYPE_OPAQUE_RECT, &opaque_rect) == 6);
+	CU_ASSERT(memcmp(&opaque_rect, &client->primary->opaque_rect, sizeof(OPAQUE_RECT_ORDER)) == 0);
+
+	/* negative deltas */
+	opaque_rect.nLeftRect -= 128;
+	opaque_rect.nWidth -= 1;
+	CU_ASSERT(test_orders_enc_roundtrip(ORDER_TYPE_OPAQUE_RECT, &opaque_rect) == 4);
+	CU_ASSERT(memcmp(&opaque_rect, &client->primary->opaque_rect, sizeof(OPAQUE_RECT_ORDER)) == 0);
+}
+
+static void test_orders_enc_set_bounds(rdpBounds* bounds)
+{
+	server->primary->bounded = (bounds != NULL) ? TRUE : FALSE;
+
+	if (bounds != NULL)
+		memcpy(&(server->primary->bounds), bounds, sizeof(rdpBounds));
+}
+
+void test_orders_enc_bounds(void)
+{
+	int length;
+	rdpBounds bounds;
+	OPAQUE_RECT_ORDER opaque_rect;
+
+	test_orders_enc_reset();
+
+	memset(&opaque_rect, 0, sizeof(OPAQUE_RECT_ORDER));
+	opaque_rect.nWidth = 10;
+	opaque_rect.nHeight = 10;
+
+	bounds.left = 10;
+	bounds.top = 20;
+	bounds.right = 1000;
+	bounds.bottom = 30;
+
+	bounds_count = 0;
+	test_orders_enc_set_bounds(&bounds);
+
+	length = test_orders_enc_roundtrip(ORDER_TYPE_OPAQUE_RECT, &opaque_rect);
+	CU_ASSERT(length > 0);
+	CU_ASSERT(bounds_count == 2);
+	CU_ASSERT(bounds_set == FALSE);
+	CU_ASSERT(memcmp(&bounds, &bounds_received, sizeof(rdpBounds)) == 0);
+
+	/* unchanged bounds are not sent again */
+	opaque_rect.nLeftRect = 5;
+	CU_ASSERT(test_orders_enc_roundtrip(ORDER_TYPE_OPAQUE_RECT, &opaque_rect) == 3);
+	CU_ASSERT(memcmp(&bounds, &bounds_received, sizeof(rdpBounds)) == 0);
+
+	/* a small change uses a delta, a large change an absolute bound */
+	bounds.top -= 4;
+	bounds.bottom += 1000;
+	test_orders_enc_set_bounds(&bounds);
+	CU_ASSERT(test_orders_enc_roundtrip(ORDER_TYPE_OPAQUE_RECT, &opaque_rect) == 5);
+	CU_ASSERT(memcmp(&bounds, &bounds_received, sizeof(rdpBounds)) == 0);
+
+	/* unbounded orders leave the client bounds alone */
+	test_orders_enc_set_bounds(NULL);
+	bounds_count = 0;
+	CU_ASSERT(test_orders_enc_roundtrip(ORDER_TYPE_OPAQUE_RECT, &opaque_rect) == 1);
+	CU_ASSERT(bounds_count == 0);
+}
+
+static int test_orders_enc_secondary_roundtrip(BYTE orderType, void* order)
+{
+	int bm, em;
+	UINT16 extraFlags;
+
+	stream_set_pos(s, 0);
+	bm = stream_get_pos(s);
+	stream_seek(s, SECONDARY_ORDER_HEADER_LENGTH);
+
+	if (orderType == ORDER_TYPE_CACHE_GLYPH)
+		update_write_cache_glyph_order(s, (CACHE_GLYPH_ORDER*) order, &extraFlags);
+	else
+		update_write_cache_bitmap_v2_order(s, (CACHE_BITMAP_V2_ORDER*) order,
+				(orderType == ORDER_TYPE_BITMAP_COMPRESSED_V2), &extraFlags);
+
+	em = stream_get_pos(s);
+	stream_set_pos(s, bm);
+	update_write_secondary_order_info(s, em - bm - SECONDARY_ORDER_HEADER_LENGTH, extraFlags, orderType);
+
+	stream_set_pos(s, 0);
+
+	if (!update_recv_order(client, s))
+		return -1;
+
+	if (stream_get_pos(s) != em)
+		return -1;
+
+	return em;
+}
+
+void test_orders_enc_secondary(void)
+{
+	int i;
+	BYTE data[512];
+	WCHAR unicode[2];
+	GLYPH_DATA glyphs[2];
+	CACHE_GLYPH_ORDER cache_glyph;
+	CACHE_GLYPH_ORDER* decoded_glyph;
+	CACHE_BITMAP_V2_ORDER cache_bitmap_v2;
+	CACHE_BITMAP_V2_ORDER* decoded_bitmap_v2;
+
+	for (i = 0; i < (int) sizeof(data); i++)
+		data[i] = (BYTE) (i * 7);
+
+	decoded_bitmap_v2 = &(client->secondary->cache_bitmap_v2_order);
+
+	memset(&cache_bitmap_v2, 0, sizeof(CACHE_BITMAP_V2_ORDER));
+	cache_bitmap_v2.cacheId = 2;
+	cache_bitmap_v2.flags = CBR2_PERSISTENT_KEY_PRESENT;
+	cache_bitmap_v2.key1 = 0x01234567;
+	cache_bitmap_v2.key2 = 0x89ABCDEF;
+	cache_bitmap_v2.bitmapBpp = 16;
+	cache_bitmap_v2.bitmapWidth = 16;
+	cache_bitmap_v2.bitmapHeight = 8;
+	cache_bitmap_v2.bitmapLength = 256;
+	cache_bitmap_v2.cacheIndex = 1500;
+	cache_bitmap_v2.bitmapDataStream = data;
+
+	CU_ASSERT(test_orders_enc_secondary_roundtrip(ORDER_TYPE_BITMAP_UNCOMPRESSED_V2, &cache_bitmap_v2) > 0);
+	CU_ASSERT(decoded_bitmap_v2->cacheId == 2);
+	CU_ASSERT(decoded_bitmap_v2->key1 == 0x01234567);
+	CU_ASSERT(decoded_bitmap_v2->key2 == 0x89ABCDEF);
+	CU_ASSERT(decoded_bitmap_v2->bitmapBpp == 16);
+	CU_ASSERT(decoded_bitmap_v2->bitmapWidth == 16);
+	CU_ASSERT(decoded_bitmap_v2->bitmapHeight == 8);
+	CU_ASSERT(decoded_bitmap_v2->bitmapLength == 256);
+	CU_ASSERT(decoded_bitmap_v2->cacheIndex == 1500);
+	CU_ASSERT(decoded_bitmap_v2->compressed == FALSE);
+	CU_ASSERT(memcmp(decoded_bitmap_v2->bitmapDataStream, data, 256) == 0);
+
+	memset(&cache_bitmap_v2, 0, sizeof(CACHE_BITMAP_V2_ORDER));
+	cache_bitmap_v2.cacheId = 1;
+	cache_bitmap_v2.bitmapBpp = 32;
+	cache_bitmap_v2.bitmapWidth = 64;
+	cache_bitmap_v2.bitmapHeight = 64;
+	cache_bitmap_v2.bitmapLength = 500;
+	cache_bitmap_v2.cacheIndex = 3;
+	cache_bitmap_v2.cbScanWidth = 256;
+	cache_bitmap_v2.cbUncompressedSize = 16384;
+	cache_bitmap_v2.bitmapDataStream = data;
+
+	CU_ASSERT(test_orders_enc_secondary_roundtrip(ORDER_TYPE_BITMAP_COMPRESSED_V2, &cache_bitmap_v2) > 0);
+	CU_ASSERT(decoded_bitmap_v2->cacheId == 1);
+	CU_ASSERT(decoded_bitmap_v2->bitmapBpp == 32);
+	CU_ASSERT(decoded_bitmap_v2->bitmapWidth == 64);
+	CU_ASSERT(decoded_bitmap_v2->bitmapHeight == 64);
+	CU_ASSERT(decoded_bitmap_v2->bitmapLength == 500);
+	CU_ASSERT(decoded_bitmap_v2->cbScanWidth == 256);
+	CU_ASSERT(decoded_bitmap_v2->cbUncompressedSize == 16384);
+	CU_ASSERT(decoded_bitmap_v2->cacheIndex == 3);
+	CU_ASSERT(decoded_bitmap_v2->compressed == TRUE);
+	CU_ASSERT(memcmp(decoded_bitmap_v2->bitmapDataStream, data, 500) == 0);
+
+	memset(&cache_glyph, 0, sizeof(CACHE_GLYPH_ORDER));
+	cache_glyph.cacheId = 4;
+	cache_glyph.cGlyphs = 2;
+
+	for (i = 0; i < 2; i++)
+	{
+		glyphs[i].cacheIndex = 100 + i;
+		glyphs[i].x = -1 - i;
+		glyphs[i].y = -12;
+		glyphs[i].cx = 7 + i * 4;
+		glyphs[i].cy = 13;
+		glyphs[i].cb = ((glyphs[i].cx + 7) / 8) * glyphs[i].cy;
+		glyphs[i].aj = &data[i * 64];
+		cache_glyph.glyphData[i] = &glyphs[i];
+		unicode[i] = 'a' + i;
+	}
+
+	cache_glyph.unicodeCharacters = (BYTE*) unicode;
+
+	CU_ASSERT(test_orders_enc_secondary_roundtrip(ORDER_TYPE_CACHE_GLYPH, &cache_glyph) > 0);
+
+	decoded_glyph = &(client->secondary->cache_glyph_order);
+	CU_ASSERT(decoded_glyph->cacheId == 4);
+	CU_ASSERT(decoded_glyph->cGlyphs == 2);
+
+	for (i = 0; i < (int) decoded_glyph->cGlyphs; i++)
+	{
+		CU_ASSERT(decoded_glyph->glyphData[i]->cacheIndex == glyphs[i].cacheIndex);
+		CU_ASSERT(decoded_glyph->glyphData[i]->x == glyphs[i].x);
+		CU_ASSERT(decoded_glyph->glyphData[i]->y == glyphs[i].y);
+		CU_ASSERT(decoded_glyph->glyphData[i]->cx == glyphs[i].cx);
+		CU_ASSERT(decoded_glyph->glyphData[i]->cy == glyphs[i].cy);
+		CU_ASSERT(memcmp(decoded_glyph->glyphData[i]->aj, glyphs[i].aj, glyphs[i].cb) == 0);
+
+		free(decoded_glyph->glyphData[i]->aj);
+		free(decoded_glyph->glyphData[i]);
+		decoded_glyph->glyphData[i] = NULL;
+	}
+}
+
+void test_orders_enc_server_cache(void)
+{
+	int i;
+	UINT32 index;
+	rdpSettings* settings;
+	rdpServerCache* server_cache;
+
+	settings = settings_new(NULL);
+
+	settings->bitmapCacheV2NumCells = 3;
+	settings->bitmapCacheV2CellInfo[0].numEntries = 4;
+	settings->bitmapCacheV2CellInfo[1].numEntries = 0;
+	settings->bitmapCacheV2CellInfo[2].numEntries = 100;
+
+	for (i = 0; i < 10; i++)
+	{
+		settings->glyphCache[i].cacheEntries = 0;
+		settings->glyphCache[i].cacheMaximumCellSize = 4 << i;
+	}
+
+	settings->glyphCache[3].cacheEntries = 2;
+	settings->glyphCache[5].cacheEntries = 254;
+
+	server_cache = server_cache_new(settings);
+
+	CU_ASSERT(server_cache_bitmap_id(server_cache, 16, 16) == 0);
+	CU_ASSERT(server_cache_bitmap_id(server_cache, 32, 32) == 2);
+	CU_ASSERT(server_cache_bitmap_id(server_cache, 64, 64) == 2);
+	CU_ASSERT(server_cache_bitmap_id(server_cache, 64, 65) == -1);
+
+	CU_ASSERT(server_cache_glyph_id(server_cache, 4) == 3);
+	CU_ASSERT(server_cache_glyph_id(server_cache, 100) == 5);
+	CU_ASSERT(server_cache_glyph_id(server_cache, 129) == -1);
+
+	/* fill cell 0, then touch key 1 so that key 2 becomes the least recently used */
+
+	for (i = 1; i <= 4; i++)
+	{
+		CU_ASSERT(server_cache_bitmap_lookup(server_cache, 0, i, &index) == FALSE);
+		CU_ASSERT(index == (UINT32) (i - 1));
+	}
+
+	CU_ASSERT(server_cache_bitmap_lookup(server_cache, 0, 1, &index) == TRUE);
+	CU_ASSERT(index == 0);
+
+	CU_ASSERT(server_cache_bitmap_lookup(server_cache, 0, 5, &index) == FALSE);
+	CU_ASSERT(index == 1);
+	CU_ASSERT(server_cache_bitmap_lookup(server_cache, 0, 2, &index) == FALSE);
+	CU_ASSERT(index == 2);
+	CU_ASSERT(server_cache_bitmap_lookup(server_cache, 0, 1, &index) == TRUE);
+	CU_ASSERT(index == 0);
+	CU_ASSERT(server_cache_bitmap_lookup(server_cache, 0, 5, &index) == TRUE);
+	CU_ASSERT(index == 1);
+	CU_ASSERT(server_cache->evictions == 2);
+
+	CU_ASSERT(server_cache_bitmap_lookup(server_cache, 1, 1, &index) == FALSE);
+	CU_ASSERT(index == SERVER_CACHE_NONE);
+	CU_ASSERT(server_cache_bitmap_lookup(server_cache, 3, 1, &index) == FALSE);
+	CU_ASSERT(index == SERVER_CACHE_NONE);
+
+	/* a stream of glyphs larger than the cache keeps the cache consistent */
+
+	for (i = 0; i < 10000; i++)
+	{
+		server_cache_glyph_lookup(server_cache, 5, server_cache_key((BYTE*) &i, sizeof(int)) % 300, &index);
+		CU_ASSERT(index < 254);
+	}
+
+	CU_ASSERT(server_cache_glyph_lookup(server_cache, 3, 7, &index) == FALSE);
+	CU_ASSERT(server_cache_glyph_lookup(server_cache, 3, 8, &index) == FALSE);
+	CU_ASSERT(server_cache_glyph_lookup(server_cache, 3, 7, &index) == TRUE);
+	CU_ASSERT(index == 0);
+
+	server_cache_reset(server_cache);
+	CU_ASSERT(server_cache_glyph_lookup(server_cache, 3, 7, &index) == FALSE);
+	CU_ASSERT(index == 0);
+	CU_ASSERT(server_cache->hits == 0);
+
+	server_cache_free(server_cache);
+	settings_free(settings);
+}
+
+static int batch_calls;
+static ORDER_BATCH_ENTRY batch_entries[4];
+static UINT32 batch_count;
+static BOOL batch_brush;
+
+static void test_order_batch(rdpContext* context, ORDER_BATCH* batch)
+{
+	PATBLT_ORDER* patblt;
+
+	batch_calls++;
+	batch_count = batch->count;
+
+	patblt = &batch->entries[0].order.patblt;
+
+	if (batch->entries[0].orderType == ORDER_BATCH_PATBLT)
+		batch_brush = (patblt->brush.data == (BYTE*) patblt->brush.p8x8) ? TRUE : FALSE;
+
+	if (batch->count <= 4)
+		memcpy(batch_entries, batch->entries, sizeof(ORDER_BATCH_ENTRY) * batch->count);
+}
+
+void test_orders_enc_batch(void)
+{
+	rdpBounds bounds;
+	MEMBLT_ORDER memblt;
+	PATBLT_ORDER patblt;
+	OPAQUE_RECT_ORDER opaque_rect;
+	CACHE_GLYPH_ORDER cache_glyph;
+
+	test_orders_enc_reset();
+	client->primary->OrderBatch = test_order_batch;
+	batch_calls = 0;
+	bounds_count = 0;
+
+	memset(&opaque_rect, 0, sizeof(OPAQUE_RECT_ORDER));
+	opaque_rect.nLeftRect = 10;
+	opaque_rect.nWidth = 20;
+	opaque_rect.nHeight = 20;
+	opaque_rect.color = 0x123456;
+	CU_ASSERT(test_orders_enc_roundtrip(ORDER_TYPE_OPAQUE_RECT, &opaque_rect) > 0);
+
+	bounds.left = 1;
+	bounds.top = 2;
+	bounds.right = 3;
+	bounds.bottom = 4;
+	test_orders_enc_set_bounds(&bounds);
+
+	memset(&memblt, 0, sizeof(MEMBLT_ORDER));
+	memblt.nWidth = 64;
+	memblt.nHeight = 64;
+	memblt.bRop = 0xCC;
+	memblt.cacheIndex = 5;
+	CU_ASSERT(test_orders_enc_roundtrip(ORDER_TYPE_MEMBLT, &memblt) > 0);
+
+	/* batched orders do not go through the bounds callback */
+	CU_ASSERT(batch_calls == 0);
+	CU_ASSERT(bounds_count == 0);
+	CU_ASSERT(client->primary->batch.count == 2);
+
+	/* a secondary order flushes the batch */
+	memset(&cache_glyph, 0, sizeof(CACHE_GLYPH_ORDER));
+	CU_ASSERT(test_orders_enc_secondary_roundtrip(ORDER_TYPE_CACHE_GLYPH, &cache_glyph) > 0);
+	CU_ASSERT(batch_calls == 1);
+	CU_ASSERT(batch_count == 2);
+	CU_ASSERT(batch_entries[0].orderType == ORDER_BATCH_OPAQUE_RECT);
+	CU_ASSERT(batch_entries[0].bounded == FALSE);
+	CU_ASSERT(memcmp(&batch_entries[0].order.opaque_rect, &opaque_rect, sizeof(OPAQUE_RECT_ORDER)) == 0);
+	CU_ASSERT(batch_entries[1].orderType == ORDER_BATCH_MEMBLT);
+	CU_ASSERT(batch_entries[1].bounded == TRUE);
+	CU_ASSERT(memcmp(&batch_entries[1].bounds, &bounds, sizeof(rdpBounds)) == 0);
+	CU_ASSERT(memcmp(&batch_entries[1].order.memblt, &memblt, sizeof(MEMBLT_ORDER)) == 0);
+
+	/* brush data points into the batch entry rather than the decoder state */
+	memset(&patblt, 0, sizeof(PATBLT_ORDER));
+	patblt.nWidth = 8;
+	patblt.nHeight = 8;
+	patblt.bRop = 0xF0;
+	test_orders_enc_init_brush(&patblt.brush, 3);
+	CU_ASSERT(test_orders_enc_roundtrip(ORDER_TYPE_PATBLT, &patblt) > 0);
+	CU_ASSERT(batch_calls == 1);
+
+	update_flush_order_batch(client);
+	CU_ASSERT(batch_calls == 2);
+	CU_ASSERT(batch_count == 1);
+	CU_ASSERT(batch_brush == TRUE);
+	CU_ASSERT(client->primary->batch.count == 0);
+
+	/* nothing left to flush */
+	update_flush_order_batch(client);
+	CU_ASSERT(batch_calls == 2);
+
+	client->primary->OrderBatch = NULL;
+	test_orders_enc_set_bounds(NULL);
+}
@@ -0,0 +1,380 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Persistent Bitmap Cache Unit Tests
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+
+#include <winpr/crt.h>
+
+#include "rdp.h"
+#include "transport.h"
+#include "activation.h"
+
+#include <freerdp/freerdp.h>
+#include <freerdp/cache/bitmap.h>
+#include <freerdp/utils/persistent.h>
+
+#include "test_persistent.h"
+
+#define TEST_CACHE_FILE		"test_persistent.bin"
+#define TEST_ENTRY_COUNT	3
+
+int init_persistent_suite(void)
+{
+	return 0;
+}
+
+int clean_persistent_suite(void)
+{
+	remove(TEST_CACHE_FILE);
+	return 0;
+}
+
+int add_persistent_suite(void)
+{
+	add_test_suite(persistent);
+
+	add_test_function(persistent_roundtrip);
+	add_test_function(persistent_corrupted);
+	add_test_function(persistent_key_list_limit);
+	add_test_function(persistent_connect_keys);
+
+	return 0;
+}
+
+static void test_persistent_write_entries(PERSISTENT_CACHE_ENTRY* entries)
+{
+	int i, j;
+	BYTE data[256];
+	PERSISTENT_CACHE_ENTRY* list[TEST_ENTRY_COUNT];
+
+	memset(entries, 0, sizeof(PERSISTENT_CACHE_ENTRY) * TEST_ENTRY_COUNT);
+
+	for (i = 0; i < TEST_ENTRY_COUNT; i++)
+	{
+		for (j = 0; j < (int) sizeof(data); j++)
+			data[j] = (BYTE) (i * 31 + j);
+
+		persistent_cache_entry_set(&entries[i], 0x0123456789ABCDEFULL + i, i % 2,
+				8 + i, 4 + i, 16, (i == 1), data, 64 * (i + 1));
+
+		list[i] = &entries[i];
+	}
+
+	CU_ASSERT(persistent_cache_write(TEST_CACHE_FILE, list, TEST_ENTRY_COUNT) == TRUE);
+}
+
+void test_persistent_roundtrip(void)
+{
+	int i;
+	PERSISTENT_CACHE_ENTRY* entry;
+	rdpPersistentCache* persistent;
+	PERSISTENT_CACHE_ENTRY entries[TEST_ENTRY_COUNT];
+
+	test_persistent_write_entries(entries);
+
+	persistent = persistent_cache_new();
+	CU_ASSERT(persistent_cache_open(persistent, TEST_CACHE_FILE) == TEST_ENTRY_COUNT);
+
+	for (i = 0; i < persistent->count; i++)
+	{
+		entry = &persistent->entries[i];
+
+		CU_ASSERT(entry->key == entries[i].key);
+		CU_ASSERT(entry->cacheId == entries[i].cacheId);
+		CU_ASSERT(entry->width == entries[i].width);
+		CU_ASSERT(entry->height == entries[i].height);
+		CU_ASSERT(entry->bpp == entries[i].bpp);
+		CU_ASSERT(entry->flags == entries[i].flags);
+		CU_ASSERT(entry->length == entries[i].length);
+		CU_ASSERT(memcmp(entry->data, entries[i].data, entry->length) == 0);
+		CU_ASSERT(entry->allocated == FALSE);
+	}
+
+	/* rewriting the file while it is mapped must not disturb the loaded entries */
+	for (i = 0; i < TEST_ENTRY_COUNT; i++)
+		persistent_cache_entry_clear(&entries[i]);
+
+	test_persistent_write_entries(entries);
+	CU_ASSERT(memcmp(persistent->entries[2].data, entries[2].data, entries[2].length) == 0);
+
+	persistent_cache_free(persistent);
+
+	for (i = 0; i < TEST_ENTRY_COUNT; i++)
+		persistent_cache_entry_clear(&entries[i]);
+}
+
+void test_persistent_corrupted(void)
+{
+	int i;
+	FILE* fp;
+	BYTE byte;
+	long offset;
+	rdpPersistentCache* persistent;
+	PERSISTENT_CACHE_ENTRY entries[TEST_ENTRY_COUNT];
+
+	persistent = persistent_cache_new();
+
+	/* a missing file is an empty cache */
+	remove(TEST_CACHE_FILE);
+	CU_ASSERT(persistent_cache_open(persistent, TEST_CACHE_FILE) == 0);
+
+	/* flip a data byte of the second entry, only the first one survives */
+	test_persistent_write_entries(entries);
+	offset = 16 + 24 + entries[0].length + 24 + 10;
+
+	fp = fopen(TEST_CACHE_FILE, "r+b");
+	fseek(fp, offset, SEEK_SET);
+	byte = (BYTE) fgetc(fp);
+	fseek(fp, offset, SEEK_SET);
+	fputc(byte ^ 0x40, fp);
+	fclose(fp);
+
+	CU_ASSERT(persistent_cache_open(persistent, TEST_CACHE_FILE) == 1);
+	CU_ASSERT(persistent->entries[0].key == entries[0].key);
+
+	/* a bad signature rejects the whole file */
+	fp = fopen(TEST_CACHE_FILE, "r+b");
+	fputc('X', fp);
+	fclose(fp);
+
+	CU_ASSERT(persistent_cache_open(persistent, TEST_CACHE_FILE) == -1);
+	CU_ASSERT(persistent->count == 0);
+
+	persistent_cache_free(persistent);
+
+	for (i = 0; i < TEST_ENTRY_COUNT; i++)
+		persistent_cache_entry_clear(&entries[i]);
+}
+
+struct test_persistent_reader
+{
+	int fd;
+	BYTE* data;
+	int length;
+};
+
+static void* test_persistent_reader_thread(void* arg)
+{
+	int status;
+	int size = 0;
+	struct test_persistent_reader* reader = (struct test_persistent_reader*) arg;
+
+	while (1)
+	{
+		if (reader->length + 4096 > size)
+		{
+			size = (size + 4096) * 2;
+			reader->data = (BYTE*) realloc(reader->data, size);
+		}
+
+		status = read(reader->fd, reader->data + reader->length, size - reader->length);
+
+		if (status <= 0)
+			break;
+
+		reader->length += status;
+	}
+
+	return NULL;
+}
+
+void test_persistent_key_list_limit(void)
+{
+	int i, j;
+	int fds[2];
+	STREAM* s;
+	BYTE flags;
+	BYTE type;
+	BYTE compressed_type;
+	UINT16 compressed_len;
+	UINT16 length;
+	UINT16 pdu_type;
+	UINT16 channel_id;
+	UINT32 share_id;
+	UINT32 key1, key2;
+	UINT32 count;
+	UINT32 received = 0;
+	int pdus = 0;
+	BYTE* next;
+	UINT16 numEntries[5];
+	UINT16 totalEntries[5];
+	UINT32 index[5] = { 0, 0, 0, 0, 0 };
+	rdpRdp* rdp;
+	rdpRdp* server;
+	rdpSettings* settings;
+	BITMAP_CACHE_V2_CELL_INFO* cellInfo;
+	pthread_t thread;
+	struct test_persistent_reader reader;
+
+	/* 5 x 60000 keys is more than the 262144 a client may advertise */
+	rdp = rdp_new(NULL);
+	settings = rdp->settings;
+	settings->server_mode = FALSE;
+	settings->persistent_bitmap_cache = TRUE;
+
+	for (i = 0; i < 5; i++)
+	{
+		cellInfo = &settings->bitmapCacheV2CellInfo[i];
+		cellInfo->persistent = TRUE;
+		cellInfo->numPersistentKeys = 60000;
+		cellInfo->persistentKeys = (UINT64*) malloc(sizeof(UINT64) * 60000);
+
+		for (j = 0; j < 60000; j++)
+			cellInfo->persistentKeys[j] = ((UINT64) (i + 1) << 32) | j;
+	}
+
+	CU_ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+	transport_attach(rdp->transport, fds[0]);
+
+	reader.fd = fds[1];
+	reader.data = NULL;
+	reader.length = 0;
+	pthread_create(&thread, NULL, test_persistent_reader_thread, &reader);
+
+	CU_ASSERT(rdp_send_client_persistent_key_list_pdu(rdp) == TRUE);
+	shutdown(fds[0], SHUT_WR);
+	pthread_join(thread, NULL);
+
+	/* parse the PDUs back as the server would, without an instance rdp_new() is in server mode */
+	server = rdp_new(NULL);
+
+	s = stream_new(0);
+	stream_attach(s, reader.data, reader.length);
+
+	while (stream_get_left(s) > 0)
+	{
+		next = stream_get_tail(s) + ((stream_get_tail(s)[2] << 8) | stream_get_tail(s)[3]);
+
+		CU_ASSERT(rdp_read_header(server, s, &length, &channel_id) == TRUE);
+		CU_ASSERT(rdp_read_share_control_header(s, &length, &pdu_type, &channel_id) == TRUE);
+		CU_ASSERT(rdp_read_share_data_header(s, &length, &type, &share_id,
+				&compressed_type, &compressed_len) == TRUE);
+		CU_ASSERT(type == DATA_PDU_TYPE_BITMAP_CACHE_PERSISTENT_LIST);
+
+		count = 0;
+
+		for (i = 0; i < 5; i++)
+		{
+			stream_read_UINT16(s, numEntries[i]);
+			count += numEntries[i];
+		}
+
+		for (i = 0; i < 5; i++)
+			stream_read_UINT16(s, totalEntries[i]);
+
+		stream_read_BYTE(s, flags);
+		stream_seek(s, 3);
+
+		/* the totals add up to the limit, every PDU advertises the same ones */
+		CU_ASSERT(totalEntries[0] + totalEntries[1] + totalEntries[2] +
+				totalEntries[3] + totalEntries[4] == PERSIST_MAX_ENTRIES);
+		CU_ASSERT(totalEntries[4] == PERSIST_MAX_ENTRIES - 4 * 60000);
+		CU_ASSERT(count <= PERSIST_MAX_PDU_ENTRIES);
+		CU_ASSERT(((flags & PERSIST_FIRST_PDU) != 0) == (pdus == 0));
+		CU_ASSERT(((flags & PERSIST_LAST_PDU) != 0) == (received + count == PERSIST_MAX_ENTRIES));
+
+		for (i = 0; i < 5; i++)
+		{
+			for (j = 0; j < numEntries[i]; j++)
+			{
+				stream_read_UINT32(s, key1);
+				stream_read_UINT32(s, key2);
+				CU_ASSERT(key1 == index[i]);
+				CU_ASSERT(key2 == (UINT32) (i + 1));
+				index[i]++;
+			}
+
+			CU_ASSERT(index[i] <= totalEntries[i]);
+		}
+
+		CU_ASSERT(stream_get_tail(s) == next);
+		stream_set_mark(s, next);
+
+		received += count;
+		pdus++;
+	}
+
+	CU_ASSERT(received == PERSIST_MAX_ENTRIES);
+	CU_ASSERT(pdus == (PERSIST_MAX_ENTRIES + PERSIST_MAX_PDU_ENTRIES - 1) / PERSIST_MAX_PDU_ENTRIES);
+
+	stream_detach(s);
+	stream_free(s);
+	free(reader.data);
+
+	rdp_free(server);
+	rdp_free(rdp);
+	close(fds[0]);
+	close(fds[1]);
+}
+
+void test_persistent_connect_keys(void)
+{
+	int i;
+	UINT64* keys;
+	rdpRdp* rdp;
+	rdpContext* context;
+	rdpSettings* settings;
+	rdpBitmapCache* bitmap_cache;
+	BITMAP_CACHE_V2_CELL_INFO* cellInfo;
+	PERSISTENT_CACHE_ENTRY entries[TEST_ENTRY_COUNT];
+
+	test_persistent_write_entries(entries);
+
+	context = test_context_new();
+	rdp = rdp_new(NULL);
+	settings = rdp->settings;
+	settings->instance = context->instance;
+	settings->persistent_bitmap_cache = TRUE;
+	settings->bitmap_cache_persist_file = _strdup(TEST_CACHE_FILE);
+	cellInfo = settings->bitmapCacheV2CellInfo;
+
+	/* the keys are loaded when connecting, before the client creates its bitmap cache */
+	rdp_client_load_persistent_keys(rdp);
+
+	CU_ASSERT(cellInfo[0].persistent == TRUE);
+	CU_ASSERT(cellInfo[0].numPersistentKeys == 2);
+	CU_ASSERT(cellInfo[0].persistentKeys[0] == entries[0].key);
+	CU_ASSERT(cellInfo[0].persistentKeys[1] == entries[2].key);
+	CU_ASSERT(cellInfo[1].numPersistentKeys == 1);
+	CU_ASSERT(cellInfo[1].persistentKeys[0] == entries[1].key);
+
+	/* the bitmap cache created later puts the bitmaps where the keys said */
+	bitmap_cache = bitmap_cache_new(settings);
+
+	CU_ASSERT(bitmap_cache->cells[0].persistent[0].key == entries[0].key);
+	CU_ASSERT(bitmap_cache->cells[0].persistent[1].key == entries[2].key);
+	CU_ASSERT(bitmap_cache->cells[1].persistent[0].key == entries[1].key);
+	CU_ASSERT(cellInfo[0].numPersistentKeys == 2);
+	CU_ASSERT(cellInfo[1].numPersistentKeys == 1);
+
+	/* reconnecting advertises the keys of the bitmap cache as they are */
+	keys = cellInfo[0].persistentKeys;
+	rdp_client_load_persistent_keys(rdp);
+	CU_ASSERT(cellInfo[0].persistentKeys == keys);
+
+	bitmap_cache_free(bitmap_cache);
+	rdp_free(rdp);
+	test_context_free(context);
+
+	for (i = 0; i < TEST_ENTRY_COUNT; i++)
+		persistent_cache_entry_clear(&entries[i]);
+}
@@ -0,0 +1,410 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Pointer Cache Unit Tests
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "update.h"
+
+#include <freerdp/freerdp.h>
+#include <freerdp/graphics.h>
+#include <freerdp/utils/memory.h>
+#include <freerdp/utils/stream.h>
+#include <freerdp/cache/pointer.h>
+
+#include "test_pointer.h"
+
+#define TEST_POINTER_SLOTS		20
+
+static rdpContext* context;
+static rdpUpdate* update;
+static rdpSettings* settings;
+static rdpPointerCache* pointer_cache;
+
+static int pointer_news;
+static int pointer_frees;
+static rdpPointer* current;
+
+static void test_Pointer_New(rdpContext* context, rdpPointer* pointer)
+{
+	pointer_news++;
+}
+
+static void test_Pointer_Free(rdpContext* context, rdpPointer* pointer)
+{
+	pointer_frees++;
+}
+
+static void test_Pointer_Set(rdpContext* context, rdpPointer* pointer)
+{
+	current = pointer;
+}
+
+static void test_Pointer_SetNull(rdpContext* context)
+{
+
+}
+
+static void test_Pointer_SetDefault(rdpContext* context)
+{
+
+}
+
+int init_pointer_suite(void)
+{
+	rdpPointer pointer;
+
+	memset(&pointer, 0, sizeof(rdpPointer));
+	pointer.size = sizeof(rdpPointer);
+	pointer.New = test_Pointer_New;
+	pointer.Free = test_Pointer_Free;
+	pointer.Set = test_Pointer_Set;
+	pointer.SetNull = test_Pointer_SetNull;
+	pointer.SetDefault = test_Pointer_SetDefault;
+
+	context = test_context_new();
+	update = context->instance->update;
+	settings = context->instance->settings;
+	settings->pointer_cache_size = TEST_POINTER_SLOTS;
+
+	graphics_register_pointer(context->graphics, &pointer);
+	pointer_cache_register_callbacks(update);
+
+	return 0;
+}
+
+int clean_pointer_suite(void)
+{
+	test_context_free(context);
+	return 0;
+}
+
+int add_pointer_suite(void)
+{
+	add_test_suite(pointer);
+
+	add_test_function(pointer_aliasing);
+	add_test_function(pointer_eviction);
+	add_test_function(pointer_churn);
+	add_test_function(pointer_large);
+
+	return 0;
+}
+
+static void test_pointer_reset(void)
+{
+	if (context->cache->pointer != NULL)
+		pointer_cache_free(context->cache->pointer);
+
+	pointer_cache = pointer_cache_new(settings);
+	context->cache->pointer = pointer_cache;
+
+	pointer_news = 0;
+	pointer_frees = 0;
+	current = NULL;
+}
+
+/**
+ * Send a 32x32 24bpp color pointer, the cursors of a shape differ in
+ * their xor mask only.
+ */
+
+static void test_pointer_send(UINT32 index, int shape, int xPos, int yPos)
+{
+	int i;
+	POINTER_NEW_UPDATE* pointer_new = &update->pointer->pointer_new;
+
+	pointer_new->xorBpp = 24;
+	pointer_new->colorPtrAttr.cacheIndex = index;
+	pointer_new->colorPtrAttr.xPos = xPos;
+	pointer_new->colorPtrAttr.yPos = yPos;
+	pointer_new->colorPtrAttr.width = 32;
+	pointer_new->colorPtrAttr.height = 32;
+	pointer_new->colorPtrAttr.lengthXorMask = 32 * 32 * 3;
+	pointer_new->colorPtrAttr.lengthAndMask = 32 * 32 / 8;
+	pointer_new->colorPtrAttr.xorMaskData = (BYTE*) malloc(32 * 32 * 3);
+	pointer_new->colorPtrAttr.andMaskData = (BYTE*) malloc(32 * 32 / 8);
+
+	for (i = 0; i < 32 * 32 * 3; i++)
+		pointer_new->colorPtrAttr.xorMaskData[i] = (BYTE) (i * (shape + 1));
+
+	memset(pointer_new->colorPtrAttr.andMaskData, 0xF0, 32 * 32 / 8);
+
+	IFCALL(update->pointer->PointerNew, context, pointer_new);
+}
+
+static UINT32 test_pointer_refs(rdpPointer* pointer)
+{
+	UINT32 i;
+
+	for (i = 0; i < pointer_cache->imageCount; i++)
+	{
+		if (pointer_cache->images[i].pointer == pointer)
+			return pointer_cache->images[i].refCount;
+	}
+
+	return 0;
+}
+
+void test_pointer_aliasing(void)
+{
+	rdpPointer* pointer;
+
+	test_pointer_reset();
+
+	test_pointer_send(0, 1, 0, 0);
+	pointer = current;
+	CU_ASSERT(pointer != NULL);
+	CU_ASSERT(pointer_news == 1);
+
+	/* the same cursor in other slots shares the converted one */
+	test_pointer_send(5, 1, 0, 0);
+	test_pointer_send(19, 1, 0, 0);
+	CU_ASSERT(pointer_news == 1);
+	CU_ASSERT(current == pointer);
+	CU_ASSERT(pointer_cache_get(pointer_cache, 5) == pointer);
+	CU_ASSERT(pointer_cache_get(pointer_cache, 19) == pointer);
+	CU_ASSERT(pointer_cache->imageCount == 1);
+	CU_ASSERT(test_pointer_refs(pointer) == 3);
+	CU_ASSERT(pointer_cache->hits == 2);
+	CU_ASSERT(pointer_cache->misses == 1);
+
+	/* other masks or another hotspot make another cursor */
+	test_pointer_send(1, 2, 0, 0);
+	CU_ASSERT(pointer_news == 2);
+	CU_ASSERT(current != pointer);
+
+	test_pointer_send(2, 1, 3, 4);
+	CU_ASSERT(pointer_news == 3);
+	CU_ASSERT(current != pointer);
+	CU_ASSERT(pointer_cache->imageCount == 3);
+
+	/* cached pointer updates select the shared cursor */
+	update->pointer->pointer_cached.cacheIndex = 19;
+	IFCALL(update->pointer->PointerCached, context, &update->pointer->pointer_cached);
+	CU_ASSERT(current == pointer);
+
+	CU_ASSERT(pointer_frees == 0);
+	test_pointer_reset();
+}
+
+void test_pointer_eviction(void)
+{
+	rdpPointer* pointer;
+
+	test_pointer_reset();
+
+	test_pointer_send(0, 1, 0, 0);
+	test_pointer_send(1, 1, 0, 0);
+	test_pointer_send(2, 1, 0, 0);
+	pointer = current;
+	CU_ASSERT(test_pointer_refs(pointer) == 3);
+
+	/* resending a slot its own cursor changes nothing */
+	test_pointer_send(1, 1, 0, 0);
+	CU_ASSERT(test_pointer_refs(pointer) == 3);
+	CU_ASSERT(pointer_news == 1);
+	CU_ASSERT(pointer_frees == 0);
+
+	/* the cursor is freed with the last slot referring to it */
+	test_pointer_send(0, 2, 0, 0);
+	CU_ASSERT(test_pointer_refs(pointer) == 2);
+	test_pointer_send(1, 2, 0, 0);
+	CU_ASSERT(test_pointer_refs(pointer) == 1);
+	CU_ASSERT(pointer_frees == 0);
+
+	test_pointer_send(2, 3, 0, 0);
+	CU_ASSERT(pointer_frees == 1);
+	CU_ASSERT(pointer_cache->imageCount == 2);
+
+	/* once freed, the shape is converted again */
+	test_pointer_send(3, 1, 0, 0);
+	CU_ASSERT(pointer_news == 4);
+
+	/* every cursor is freed once with the cache */
+	pointer_cache_free(pointer_cache);
+	context->cache->pointer = NULL;
+	CU_ASSERT(pointer_frees == 4);
+	CU_ASSERT(pointer_news == pointer_frees);
+}
+
+/**
+ * Cursor churn as seen from a server reassigning its pointer cache slots
+ * round robin while the user moves over a handful of cursor shapes, most
+ * of them often enough to be in several slots at once.
+ */
+
+#define TEST_POINTER_UPDATES		1000
+
+void test_pointer_churn(void)
+{
+	int i;
+	int shape;
+	UINT32 seed;
+	UINT32 index;
+	UINT32 converted;
+
+	test_pointer_reset();
+
+	seed = 12345;
+	index = 0;
+
+	for (i = 0; i < TEST_POINTER_UPDATES; i++)
+	{
+		seed = seed * 1103515245 + 12345;
+
+		/* 4 frequent shapes, 8 rare ones */
+		if (((seed >> 16) % 8) != 0)
+			shape = (seed >> 20) % 4;
+		else
+			shape = 4 + (seed >> 20) % 8;
+
+		test_pointer_send(index, shape, 0, 0);
+		index = (index + 1) % TEST_POINTER_SLOTS;
+	}
+
+	converted = pointer_news;
+
+	CU_ASSERT(pointer_cache->hits + pointer_cache->misses == TEST_POINTER_UPDATES);
+	CU_ASSERT(pointer_cache->misses == converted);
+	CU_ASSERT(pointer_cache->imageCount <= TEST_POINTER_SLOTS);
+	CU_ASSERT(pointer_news - pointer_frees == pointer_cache->imageCount);
+	CU_ASSERT(pointer_cache->hits * 10 >= TEST_POINTER_UPDATES * 8);
+
+	printf("\npointer churn: %d updates, %d conversions, hit rate %d%%\n",
+		TEST_POINTER_UPDATES, converted, pointer_cache->hits * 100 / TEST_POINTER_UPDATES);
+
+	test_pointer_reset();
+}
+
+static STREAM* test_pointer_large_stream(int width, int height)
+{
+	int i;
+	STREAM* s;
+	UINT32 lengthXorMask;
+	UINT32 lengthAndMask;
+
+	lengthXorMask = width * height * 4;
+	lengthAndMask = ((width + 15) / 16) * 2 * height;
+
+	s = stream_new(20 + lengthXorMask + lengthAndMask + 1);
+
+	stream_write_UINT16(s, 32); /* xorBpp */
+	stream_write_UINT16(s, 7); /* cacheIndex */
+	stream_write_UINT16(s, 10); /* hotSpot.xPos */
+	stream_write_UINT16(s, 20); /* hotSpot.yPos */
+	stream_write_UINT16(s, width); /* width */
+	stream_write_UINT16(s, height); /* height */
+	stream_write_UINT32(s, lengthAndMask); /* lengthAndMask */
+	stream_write_UINT32(s, lengthXorMask); /* lengthXorMask */
+
+	for (i = 0; i < (int) lengthXorMask; i++)
+		stream_write_BYTE(s, i & 0xFF);
+
+	for (i = 0; i < (int) lengthAndMask; i++)
+		stream_write_BYTE(s, 0);
+
+	stream_write_BYTE(s, 0); /* pad */
+	stream_seal(s);
+	stream_set_pos(s, 0);
+
+	return s;
+}
+
+void test_pointer_large(void)
+{
+	STREAM* s;
+	rdpPointer* pointer;
+	POINTER_LARGE_UPDATE* pointer_large = &update->pointer->pointer_large;
+
+	test_pointer_reset();
+
+	s = test_pointer_large_stream(384, 384);
+	update_read_pointer_large(s, pointer_large);
+	CU_ASSERT(stream_get_left(s) == 0);
+	CU_ASSERT(pointer_large->width == 384);
+	CU_ASSERT(pointer_large->height == 384);
+	CU_ASSERT(pointer_large->lengthXorMask == 384 * 384 * 4);
+	CU_ASSERT(pointer_large->xorMaskData[1000] == (1000 & 0xFF));
+	IFCALL(update->pointer->PointerLarge, context, pointer_large);
+	stream_free(s);
+
+	pointer = pointer_cache_get(pointer_cache, 7);
+	CU_ASSERT(pointer != NULL);
+	CU_ASSERT(current == pointer);
+	CU_ASSERT(pointer_news == 1);
+	CU_ASSERT(pointer->width == 384);
+	CU_ASSERT(pointer->xPos == 10);
+	CU_ASSERT(pointer->yPos == 20);
+	CU_ASSERT(pointer->xorBpp == 32);
+
+	/* large cursors are shared like the others */
+	s = test_pointer_large_stream(384, 384);
+	update_read_pointer_large(s, pointer_large);
+	pointer_large->cacheIndex = 8;
+	IFCALL(update->pointer->PointerLarge, context, pointer_large);
+	stream_free(s);
+
+	CU_ASSERT(pointer_cache_get(pointer_cache, 8) == pointer);
+	CU_ASSERT(pointer_news == 1);
+
+	/* cursors above 384x384 are rejected */
+	s = test_pointer_large_stream(385, 2);
+	update_read_pointer_large(s, pointer_large);
+	CU_ASSERT(pointer_large->width == 0);
+	CU_ASSERT(pointer_large->xorMaskData == NULL);
+	IFCALL(update->pointer->PointerLarge, context, pointer_large);
+	stream_free(s);
+
+	CU_ASSERT(pointer_news == 1);
+	CU_ASSERT(current == pointer);
+
+	/* so are masks too short for the size of the cursor */
+	s = test_pointer_large_stream(64, 64);
+	stream_set_pos(s, 12);
+	stream_write_UINT32(s, 8 * 63); /* lengthAndMask */
+	stream_set_pos(s, 0);
+	update_read_pointer_large(s, pointer_large);
+	CU_ASSERT(pointer_large->width == 0);
+	CU_ASSERT(pointer_large->xorMaskData == NULL);
+	CU_ASSERT(pointer_large->andMaskData == NULL);
+	stream_free(s);
+
+	s = test_pointer_large_stream(64, 64);
+	stream_set_pos(s, 16);
+	stream_write_UINT32(s, 64 * 63 * 4); /* lengthXorMask */
+	stream_set_pos(s, 0);
+	update_read_pointer_large(s, pointer_large);
+	CU_ASSERT(pointer_large->width == 0);
+	CU_ASSERT(pointer_large->xorMaskData == NULL);
+	stream_free(s);
+
+	/* and a header cut short */
+	s = test_pointer_large_stream(64, 64);
+	stream_set_pos(s, 12);
+	stream_seal(s);
+	stream_set_pos(s, 0);
+	update_read_pointer_large(s, pointer_large);
+	CU_ASSERT(pointer_large->width == 0);
+	CU_ASSERT(pointer_large->xorMaskData == NULL);
+	stream_free(s);
+
+	test_pointer_reset();
+	pointer_cache_free(pointer_cache);
+	context->cache->pointer = NULL;
+}
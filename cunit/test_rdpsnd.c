@@ -0,0 +1,505 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Server Audio Virtual Channel Unit Tests
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <freerdp/freerdp.h>
+#include <freerdp/constants.h>
+#include <freerdp/channels/channels.h>
+#include <freerdp/utils/dsp.h>
+#include <freerdp/utils/sleep.h>
+#include <freerdp/utils/memory.h>
+#include <freerdp/utils/stream.h>
+#include <freerdp/utils/load_plugin.h>
+#include <freerdp/channels/wtsvc.h>
+#include <freerdp/server/rdpsnd.h>
+
+#include "channels/rdpsnd/client/rdpsnd_main.h"
+
+#include "test_rdpsnd.h"
+
+/**
+ * The tests run a loopback session between the rdpsnd server and the rdpsnd
+ * client plugin: server PDUs are picked up from the peer's SendChannelData and
+ * handed to the client channels, client PDUs go back through the peer's
+ * ReceiveChannelData. The client plays into a capture device registered below.
+ */
+
+#define TEST_RDPSND_CHANNEL_ID		1004
+#define TEST_RDPSND_MAX_WAVES		256
+
+#define TEST_FORMAT_PCM			0
+#define TEST_FORMAT_IMA_ADPCM		1
+#define TEST_FORMAT_MS_ADPCM		2
+
+/* the client confirms a wave this long after receiving it */
+#define TEST_CLIENT_DELAY		250
+
+static const rdpsndFormat test_formats[] =
+{
+	{ 0x01, 2, 44100, 4, 16, 0, NULL },	/* PCM */
+	{ 0x11, 2, 22050, 1024, 4, 0, NULL },	/* IMA ADPCM */
+	{ 0x02, 1, 22050, 512, 4, 0, NULL }	/* MS ADPCM */
+};
+
+static const rdpsndFormat test_src_format = { 0x01, 2, 44100, 4, 16, 0, NULL };
+
+struct _test_wave
+{
+	int size;
+	BYTE* data;
+};
+typedef struct _test_wave test_wave;
+
+static freerdp_peer* test_client;
+static WTSVirtualChannelManager* test_vcm;
+static rdpsnd_server_context* test_context;
+static volatile BOOL test_activated;
+
+static freerdp test_instance;
+static rdpSettings test_settings;
+static rdpChannels* test_channels;
+
+/* written by the client plugin thread through the capture device */
+static test_wave test_waves[TEST_RDPSND_MAX_WAVES];
+static volatile UINT32 test_wave_count;
+static volatile UINT32 test_format_tag;
+static volatile BOOL test_started;
+
+static BOOL test_device_FormatSupported(rdpsndDevicePlugin* device, rdpsndFormat* format)
+{
+	return TRUE;
+}
+
+static void test_device_Open(rdpsndDevicePlugin* device, rdpsndFormat* format, int latency)
+{
+	test_format_tag = format->wFormatTag;
+}
+
+static void test_device_Play(rdpsndDevicePlugin* device, BYTE* data, int size)
+{
+	test_wave* wave;
+
+	if (test_wave_count >= TEST_RDPSND_MAX_WAVES)
+		return;
+
+	wave = &test_waves[test_wave_count];
+	wave->size = size;
+	wave->data = (BYTE*) malloc(size);
+	memcpy(wave->data, data, size);
+
+	test_wave_count++;
+}
+
+static void test_device_Start(rdpsndDevicePlugin* device)
+{
+	test_started = TRUE;
+}
+
+static void test_device_Free(rdpsndDevicePlugin* device)
+{
+	free(device);
+}
+
+static int test_device_entry(PFREERDP_RDPSND_DEVICE_ENTRY_POINTS pEntryPoints)
+{
+	rdpsndDevicePlugin* device;
+
+	device = xnew(rdpsndDevicePlugin);
+	device->FormatSupported = test_device_FormatSupported;
+	device->Open = test_device_Open;
+	device->SetFormat = test_device_Open;
+	device->Play = test_device_Play;
+	device->Start = test_device_Start;
+	device->Free = test_device_Free;
+
+	pEntryPoints->pRegisterRdpsndDevice(pEntryPoints->rdpsnd, device);
+
+	return 0;
+}
+
+int init_rdpsnd_suite(void)
+{
+	freerdp_channels_global_init();
+	freerdp_register_static_plugin("rdpsnd_test", RDPSND_DEVICE_EXPORT_FUNC_NAME, test_device_entry);
+	return 0;
+}
+
+int clean_rdpsnd_suite(void)
+{
+	freerdp_channels_global_uninit();
+	return 0;
+}
+
+int add_rdpsnd_suite(void)
+{
+	add_test_suite(rdpsnd);
+
+	add_test_function(rdpsnd_pcm_packets);
+	add_test_function(rdpsnd_adpcm_whole_blocks);
+	add_test_function(rdpsnd_confirm_latency);
+	add_test_function(rdpsnd_congestion);
+
+	return 0;
+}
+
+/* server to client */
+static int test_rdpsnd_send_channel_data(freerdp_peer* client, int channelId, BYTE* data, int size)
+{
+	freerdp_channels_data(&test_instance, 0, data, size, CHANNEL_FLAG_FIRST | CHANNEL_FLAG_LAST, size);
+	return TRUE;
+}
+
+/* client to server */
+static int test_rdpsnd_client_send_channel_data(freerdp* instance, int channelId, BYTE* data, int size)
+{
+	test_client->ReceiveChannelData(test_client, TEST_RDPSND_CHANNEL_ID,
+		data, size, CHANNEL_FLAG_FIRST | CHANNEL_FLAG_LAST, size);
+	return 0;
+}
+
+static void test_rdpsnd_activated(rdpsnd_server_context* context)
+{
+	test_activated = TRUE;
+}
+
+/**
+ * Pass PDUs both ways until the channel threads update a value, at most
+ * timeout milliseconds. With confirms set to FALSE, the client PDUs are
+ * held back, as on a congested link.
+ */
+static BOOL test_rdpsnd_loop(volatile UINT32* value, UINT32 expected, BOOL confirms, int timeout)
+{
+	int i;
+
+	for (i = 0; i < timeout; i++)
+	{
+		WTSVirtualChannelManagerCheckFileDescriptor(test_vcm);
+
+		if (confirms)
+			freerdp_channels_check_fds(test_channels, &test_instance);
+
+		if (*value == expected)
+			return TRUE;
+
+		freerdp_usleep(1000);
+	}
+
+	return FALSE;
+}
+
+static void test_rdpsnd_free_waves(void)
+{
+	int i;
+
+	for (i = 0; i < test_wave_count; i++)
+		free(test_waves[i].data);
+
+	test_wave_count = 0;
+}
+
+/**
+ * Send the queued server PDUs and wait for the client to play them, until
+ * it has been idle for 50 ms. Client PDUs are held back meanwhile.
+ * @return number of waves played
+ */
+static int test_rdpsnd_receive(void)
+{
+	int idle;
+	UINT32 count;
+
+	test_rdpsnd_free_waves();
+
+	for (idle = 0; idle < 50; idle++)
+	{
+		count = test_wave_count;
+		WTSVirtualChannelManagerCheckFileDescriptor(test_vcm);
+		freerdp_usleep(1000);
+
+		if (test_wave_count != count)
+			idle = 0;
+	}
+
+	return test_wave_count;
+}
+
+static void test_rdpsnd_open(int format)
+{
+	rdpSettings* settings;
+	RDP_PLUGIN_DATA* plugin_data;
+
+	test_client = xnew(freerdp_peer);
+	test_client->settings = settings = settings_new(NULL);
+	test_client->SendChannelData = test_rdpsnd_send_channel_data;
+
+	settings->num_channels = 1;
+	strcpy(settings->channels[0].name, "rdpsnd");
+	settings->channels[0].channel_id = TEST_RDPSND_CHANNEL_ID;
+	settings->channels[0].joined = TRUE;
+
+	memset(&test_settings, 0, sizeof(rdpSettings));
+	memset(&test_instance, 0, sizeof(freerdp));
+	test_settings.hostname = "testhost";
+	test_instance.settings = &test_settings;
+	test_instance.SendChannelData = test_rdpsnd_client_send_channel_data;
+
+	/* the client plays into the capture device, the plugin frees its data */
+	plugin_data = (RDP_PLUGIN_DATA*) xzalloc(sizeof(RDP_PLUGIN_DATA) * 2);
+	plugin_data[0].size = sizeof(RDP_PLUGIN_DATA);
+	plugin_data[0].data[0] = "test";
+
+	test_channels = freerdp_channels_new();
+	freerdp_channels_load_plugin(test_channels, &test_settings, "../channels/rdpsnd/rdpsnd.so", plugin_data);
+	freerdp_channels_pre_connect(test_channels, &test_instance);
+	freerdp_channels_post_connect(test_channels, &test_instance);
+
+	test_vcm = WTSCreateVirtualChannelManager(test_client);
+	test_context = rdpsnd_server_context_new(test_vcm);
+	test_context->server_formats = test_formats;
+	test_context->num_server_formats = sizeof(test_formats) / sizeof(rdpsndFormat);
+	test_context->src_format = test_src_format;
+	test_context->Activated = test_rdpsnd_activated;
+
+	test_activated = FALSE;
+	test_started = FALSE;
+	test_format_tag = 0;
+
+	CU_ASSERT(test_context->Initialize(test_context) == TRUE);
+
+	/* format negotiation goes through the client plugin */
+	CU_ASSERT(test_rdpsnd_loop((volatile UINT32*) &test_activated, TRUE, TRUE, 1000));
+	CU_ASSERT(test_context->num_client_formats == sizeof(test_formats) / sizeof(rdpsndFormat));
+
+	test_context->SelectFormat(test_context, format);
+}
+
+static void test_rdpsnd_close(void)
+{
+	test_rdpsnd_free_waves();
+
+	rdpsnd_server_context_free(test_context);
+	WTSDestroyVirtualChannelManager(test_vcm);
+	settings_free(test_client->settings);
+	free(test_client);
+
+	freerdp_channels_close(test_channels, &test_instance);
+	freerdp_channels_free(test_channels);
+}
+
+static INT16* test_rdpsnd_tone(int frames)
+{
+	int i;
+	INT16* samples;
+
+	samples = (INT16*) malloc(frames * 2 * sizeof(INT16));
+
+	for (i = 0; i < frames; i++)
+		samples[i * 2] = samples[i * 2 + 1] = (INT16) (12000.0 * sin(2.0 * 3.14159265358979 * 440.0 * i / 44100.0));
+
+	return samples;
+}
+
+/**
+ * Packet size the server picks from the measured jitter, for the PCM format.
+ */
+static int test_rdpsnd_packet_frames(void)
+{
+	int frames;
+
+	frames = (20 + 2 * test_context->jitter) * 44100 / 1000;
+	frames = ((frames + 440) / 441) * 441;
+
+	return MIN(frames, 0x4000 / 4);
+}
+
+void test_rdpsnd_pcm_packets(void)
+{
+	int i;
+	INT16* samples;
+
+	test_rdpsnd_open(TEST_FORMAT_PCM);
+	samples = test_rdpsnd_tone(882 * 4);
+
+	/* without confirms yet, packets carry 20 ms */
+	CU_ASSERT(test_context->SendSamples(test_context, samples, 882 * 4) == TRUE);
+	CU_ASSERT(test_rdpsnd_receive() == 4);
+	CU_ASSERT(test_format_tag == 0x01);
+
+	for (i = 0; i < test_wave_count; i++)
+	{
+		CU_ASSERT(test_waves[i].size == 882 * 4);
+		CU_ASSERT(memcmp(test_waves[i].data, &samples[i * 882 * 2], 882 * 4) == 0);
+	}
+
+	/* nothing pending, closing only sends the close PDU */
+	CU_ASSERT(test_context->Close(test_context) == TRUE);
+	CU_ASSERT(test_rdpsnd_receive() == 0);
+	CU_ASSERT(test_started == TRUE);
+
+	free(samples);
+	test_rdpsnd_close();
+}
+
+static void test_rdpsnd_adpcm_format(int format)
+{
+	int i;
+	int sent;
+	int size;
+	int blocks;
+	int length;
+	int block_frames;
+	BYTE* data;
+	BYTE* decoded;
+	ADPCM adpcm;
+	INT16* samples;
+	const rdpsndFormat* wf = &test_formats[format];
+
+	if (wf->wFormatTag == 0x11)
+		block_frames = (wf->nBlockAlign - 4 * wf->nChannels) * 2 / wf->nChannels;
+	else
+		block_frames = 2 + (wf->nBlockAlign - 7 * wf->nChannels) * 2 / wf->nChannels;
+
+	test_rdpsnd_open(format);
+	samples = test_rdpsnd_tone(44100);
+	data = (BYTE*) malloc(44100 * 4);
+	size = 0;
+
+	/* odd chunks, resampled to a varying number of frames per packet */
+	for (sent = 0; sent < 44100; sent += 1000)
+		test_context->SendSamples(test_context, &samples[sent * 2], MIN(1000, 44100 - sent));
+
+	test_rdpsnd_receive();
+	CU_ASSERT(test_format_tag == wf->wFormatTag);
+
+	for (i = 0; i < test_wave_count; i++)
+	{
+		CU_ASSERT(test_waves[i].size > 0);
+		CU_ASSERT(test_waves[i].size % wf->nBlockAlign == 0);
+		memcpy(&data[size], test_waves[i].data, test_waves[i].size);
+		size += test_waves[i].size;
+	}
+
+	/* the rest goes out on close, padded to a whole block */
+	CU_ASSERT(test_context->Close(test_context) == TRUE);
+	CU_ASSERT(test_rdpsnd_receive() == 1);
+	CU_ASSERT(test_waves[0].size % wf->nBlockAlign == 0);
+	memcpy(&data[size], test_waves[0].data, test_waves[0].size);
+	size += test_waves[0].size;
+
+	/* one second at 22050 Hz fits in that many blocks, unless partial blocks were padded */
+	blocks = size / wf->nBlockAlign;
+	CU_ASSERT(blocks >= (22050 - block_frames) / block_frames);
+	CU_ASSERT(blocks <= (22050 + block_frames - 1) / block_frames);
+
+	memset(&adpcm, 0, sizeof(ADPCM));
+
+	if (wf->wFormatTag == 0x11)
+	{
+		length = freerdp_dsp_decode_ima_adpcm_blocks(&adpcm, data, size, wf->nChannels, wf->nBlockAlign, NULL, 0);
+		decoded = (BYTE*) malloc(length);
+		CU_ASSERT(freerdp_dsp_decode_ima_adpcm_blocks(&adpcm, data, size,
+			wf->nChannels, wf->nBlockAlign, decoded, length) == length);
+	}
+	else
+	{
+		length = freerdp_dsp_decode_ms_adpcm_blocks(&adpcm, data, size, wf->nChannels, wf->nBlockAlign, NULL, 0);
+		decoded = (BYTE*) malloc(length);
+		CU_ASSERT(freerdp_dsp_decode_ms_adpcm_blocks(&adpcm, data, size,
+			wf->nChannels, wf->nBlockAlign, decoded, length) == length);
+	}
+
+	CU_ASSERT(length == blocks * block_frames * wf->nChannels * 2);
+
+	free(decoded);
+	free(data);
+	free(samples);
+	test_rdpsnd_close();
+}
+
+void test_rdpsnd_adpcm_whole_blocks(void)
+{
+	test_rdpsnd_adpcm_format(TEST_FORMAT_IMA_ADPCM);
+	test_rdpsnd_adpcm_format(TEST_FORMAT_MS_ADPCM);
+}
+
+void test_rdpsnd_confirm_latency(void)
+{
+	int frames;
+	INT16* samples;
+
+	test_rdpsnd_open(TEST_FORMAT_PCM);
+	samples = test_rdpsnd_tone(0x4000 / 4);
+
+	test_context->SendSamples(test_context, samples, 882);
+	CU_ASSERT(test_rdpsnd_receive() == 1);
+
+	/* the client holds the block before confirming it, and reports that delay */
+	CU_ASSERT(test_rdpsnd_loop(&test_context->confirmed_blocks, 1, TRUE, 1000));
+
+	CU_ASSERT(test_context->latency >= TEST_CLIENT_DELAY);
+	CU_ASSERT(test_context->latency < 1000);
+	CU_ASSERT(test_context->jitter == test_context->latency / 2);
+	CU_ASSERT(test_context->client_delay == TEST_CLIENT_DELAY);
+
+	/* the packet being filled was sized before the confirm */
+	test_context->SendSamples(test_context, samples, 882);
+	CU_ASSERT(test_rdpsnd_receive() == 1);
+	CU_ASSERT(test_waves[0].size == 882 * 4);
+
+	/* the next one covers the jitter */
+	frames = test_rdpsnd_packet_frames();
+	CU_ASSERT(frames > 882);
+	test_context->SendSamples(test_context, samples, frames);
+	CU_ASSERT(test_rdpsnd_receive() == 1);
+	CU_ASSERT(test_waves[0].size == frames * 4);
+
+	free(samples);
+	test_rdpsnd_close();
+}
+
+void test_rdpsnd_congestion(void)
+{
+	INT16* samples;
+
+	test_rdpsnd_open(TEST_FORMAT_PCM);
+	test_context->max_latency = 10;
+	samples = test_rdpsnd_tone(0x4000 / 4);
+
+	test_context->SendSamples(test_context, samples, 882);
+	CU_ASSERT(test_rdpsnd_receive() == 1);
+	CU_ASSERT(test_rdpsnd_loop(&test_context->confirmed_blocks, 1, TRUE, 1000));
+
+	/* a block left unconfirmed past the client delay and max_latency holds back new audio */
+	test_context->SendSamples(test_context, samples, 882);
+	CU_ASSERT(test_rdpsnd_receive() == 1);
+	freerdp_usleep((TEST_CLIENT_DELAY + 50) * 1000);
+
+	test_context->SendSamples(test_context, samples, 0x4000 / 4);
+	CU_ASSERT(test_rdpsnd_receive() == 0);
+	CU_ASSERT(test_context->dropped_frames > 0);
+
+	/* once the client's confirm gets through, audio flows again */
+	CU_ASSERT(test_rdpsnd_loop(&test_context->confirmed_blocks, 2, TRUE, 1000));
+	test_context->SendSamples(test_context, samples, 0x4000 / 4);
+	CU_ASSERT(test_rdpsnd_receive() >= 1);
+
+	free(samples);
+	test_rdpsnd_close();
+}
@@ -0,0 +1,143 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Channel Data Reassembly Unit Tests
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/freerdp.h>
+#include <freerdp/constants.h>
+#include <freerdp/utils/reassembly.h>
+
+#include "test_reassembly.h"
+
+int init_reassembly_suite(void)
+{
+	return 0;
+}
+
+int clean_reassembly_suite(void)
+{
+	return 0;
+}
+
+int add_reassembly_suite(void)
+{
+	add_test_suite(reassembly);
+
+	add_test_function(reassembly_fragments);
+	add_test_function(reassembly_limits);
+
+	return 0;
+}
+
+#define TEST_MESSAGE_LENGTH	(3 * REASSEMBLY_SEGMENT_SIZE + 123)
+
+void test_reassembly_fragments(void)
+{
+	int i;
+	STREAM* s;
+	UINT32 offset;
+	UINT32 length;
+	BYTE* message;
+	BYTE* buffer;
+	rdpSegmentPool* pool;
+	rdpReassembly* reassembly;
+	REASSEMBLY_CHAIN chain;
+
+	message = (BYTE*) malloc(TEST_MESSAGE_LENGTH);
+	buffer = (BYTE*) malloc(TEST_MESSAGE_LENGTH);
+
+	for (i = 0; i < TEST_MESSAGE_LENGTH; i++)
+		message[i] = (BYTE) (i * 7);
+
+	pool = segment_pool_new(0);
+	reassembly = reassembly_new(pool, 0);
+
+	/* feed the message in CHANNEL_CHUNK_LENGTH pieces, as the channel layer does */
+	CU_ASSERT(reassembly_begin(reassembly, TEST_MESSAGE_LENGTH) == TRUE);
+
+	for (offset = 0; offset < TEST_MESSAGE_LENGTH; offset += length)
+	{
+		length = TEST_MESSAGE_LENGTH - offset;
+
+		if (length > CHANNEL_CHUNK_LENGTH)
+			length = CHANNEL_CHUNK_LENGTH;
+
+		CU_ASSERT(reassembly_is_complete(reassembly) == FALSE);
+		CU_ASSERT(reassembly_append(reassembly, &message[offset], length) == TRUE);
+	}
+
+	CU_ASSERT(reassembly_is_complete(reassembly) == TRUE);
+	CU_ASSERT(reassembly_detach(reassembly, &chain) == TRUE);
+	CU_ASSERT(chain.length == TEST_MESSAGE_LENGTH);
+	CU_ASSERT(pool->allocated == 4);
+
+	CU_ASSERT(reassembly_chain_copy(&chain, buffer, TEST_MESSAGE_LENGTH) == TEST_MESSAGE_LENGTH);
+	CU_ASSERT(memcmp(buffer, message, TEST_MESSAGE_LENGTH) == 0);
+	reassembly_chain_free(&chain);
+
+	/* the second message must be served from recycled segments */
+	CU_ASSERT(pool->free_count == 4);
+	CU_ASSERT(reassembly_begin(reassembly, TEST_MESSAGE_LENGTH) == TRUE);
+	CU_ASSERT(reassembly_append(reassembly, message, TEST_MESSAGE_LENGTH) == TRUE);
+	CU_ASSERT(pool->allocated == 4);
+	CU_ASSERT(pool->free_count == 0);
+
+	s = reassembly_to_stream(reassembly);
+	CU_ASSERT(s != NULL);
+	CU_ASSERT(stream_get_size(s) == TEST_MESSAGE_LENGTH);
+	CU_ASSERT(stream_get_pos(s) == 0);
+	CU_ASSERT(memcmp(stream_get_head(s), message, TEST_MESSAGE_LENGTH) == 0);
+	CU_ASSERT(pool->free_count == 4);
+	stream_free(s);
+
+	reassembly_free(reassembly);
+	segment_pool_free(pool);
+
+	free(message);
+	free(buffer);
+}
+
+void test_reassembly_limits(void)
+{
+	BYTE data[64];
+	rdpSegmentPool* pool;
+	rdpReassembly* reassembly;
+
+	memset(data, 0xAB, sizeof(data));
+
+	pool = segment_pool_new(1);
+	reassembly = reassembly_new(pool, 1024);
+
+	/* an oversized announced length is refused without allocating anything */
+	CU_ASSERT(reassembly_begin(reassembly, 0xFFFFFFF0) == FALSE);
+	CU_ASSERT(reassembly_append(reassembly, data, sizeof(data)) == FALSE);
+	CU_ASSERT(pool->allocated == 0);
+
+	/* fragments past the announced length discard the message */
+	CU_ASSERT(reassembly_begin(reassembly, 100) == TRUE);
+	CU_ASSERT(reassembly_append(reassembly, data, sizeof(data)) == TRUE);
+	CU_ASSERT(reassembly_append(reassembly, data, sizeof(data)) == FALSE);
+	CU_ASSERT(reassembly_is_complete(reassembly) == FALSE);
+	CU_ASSERT(reassembly_to_stream(reassembly) == NULL);
+	CU_ASSERT(pool->free_count == 1);
+
+	/* a new message starts cleanly after an error */
+	CU_ASSERT(reassembly_begin(reassembly, sizeof(data)) == TRUE);
+	CU_ASSERT(reassembly_append(reassembly, data, sizeof(data)) == TRUE);
+	CU_ASSERT(reassembly_is_complete(reassembly) == TRUE);
+
+	reassembly_free(reassembly);
+	segment_pool_free(pool);
+}
@@ -0,0 +1,340 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Auto-Reconnect Unit Tests
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include <winpr/crt.h>
+
+#include "rdp.h"
+#include "mcs.h"
+#include "connection.h"
+#include "transport.h"
+
+#include <freerdp/freerdp.h>
+#include <freerdp/crypto/per.h>
+#include <freerdp/utils/time.h>
+
+#include "test_reconnect.h"
+
+int init_reconnect_suite(void)
+{
+	return 0;
+}
+
+int clean_reconnect_suite(void)
+{
+	return 0;
+}
+
+int add_reconnect_suite(void)
+{
+	add_test_suite(reconnect);
+
+	add_test_function(reconnect_no_cookie);
+	add_test_function(reconnect_reset);
+	add_test_function(reconnect_backoff);
+	add_test_function(reconnect_channel_join);
+
+	return 0;
+}
+
+/**
+ * A local port nothing listens on, connecting to it is refused right away.
+ */
+
+static UINT32 test_reconnect_closed_port(void)
+{
+	int sockfd;
+	struct sockaddr_in addr;
+	socklen_t length = sizeof(addr);
+
+	sockfd = socket(AF_INET, SOCK_STREAM, 0);
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	bind(sockfd, (struct sockaddr*) &addr, sizeof(addr));
+	getsockname(sockfd, (struct sockaddr*) &addr, &length);
+	close(sockfd);
+
+	return ntohs(addr.sin_port);
+}
+
+/**
+ * An active session that has lost its connection, with an auto-reconnect
+ * cookie from the server and a server that is no longer reachable.
+ */
+
+static freerdp* test_reconnect_instance_new(void)
+{
+	freerdp* instance;
+	rdpSettings* settings;
+
+	instance = freerdp_new();
+	freerdp_context_new(instance);
+
+	settings = instance->settings;
+	settings->hostname = _strdup("127.0.0.1");
+	settings->port = test_reconnect_closed_port();
+	settings->auto_reconnection = TRUE;
+	settings->auto_reconnect_max_retries = 3;
+	settings->server_auto_reconnect_cookie->cbLen = 28;
+	settings->server_auto_reconnect_cookie->version = AUTO_RECONNECT_VERSION_1;
+	settings->server_auto_reconnect_cookie->logonId = 1;
+
+	instance->context->rdp->state = CONNECTION_STATE_ACTIVE;
+
+	return instance;
+}
+
+static void test_reconnect_instance_free(freerdp* instance)
+{
+	freerdp_context_free(instance);
+	freerdp_free(instance);
+}
+
+void test_reconnect_no_cookie(void)
+{
+	freerdp* instance;
+	rdpRdp* rdp;
+
+	instance = test_reconnect_instance_new();
+	rdp = instance->context->rdp;
+
+	/* without a cookie the server cannot log us back on, the loss is final */
+	instance->settings->server_auto_reconnect_cookie->cbLen = 0;
+
+	CU_ASSERT(freerdp_check_fds(instance) == FALSE);
+	CU_ASSERT(rdp->reconnecting == FALSE);
+	CU_ASSERT(rdp->reconnect_event == NULL);
+
+	/* nor can it when it ended the session itself */
+	instance->settings->server_auto_reconnect_cookie->cbLen = 28;
+	rdp->errorInfo = ERRINFO_RPC_INITIATED_LOGOFF;
+
+	CU_ASSERT(freerdp_check_fds(instance) == FALSE);
+	CU_ASSERT(rdp->reconnecting == FALSE);
+
+	test_reconnect_instance_free(instance);
+}
+
+void test_reconnect_reset(void)
+{
+	freerdp* instance;
+	rdpRdp* rdp;
+	rdpUpdate* update;
+	rdpInput* input;
+	rdpGraphics* graphics;
+	rdpTransport* transport;
+	rdpSettings* settings;
+
+	instance = test_reconnect_instance_new();
+	rdp = instance->context->rdp;
+	settings = instance->settings;
+
+	update = instance->update;
+	input = instance->input;
+	graphics = instance->context->graphics;
+	transport = rdp->transport;
+
+	/* state of the lost connection that must not leak into the next one */
+	rdp->sec_flags = SEC_ENCRYPT;
+	rdp->do_crypt = TRUE;
+	rdp->encrypt_use_count = 100;
+	settings->client_random = (BYTE*) malloc(CLIENT_RANDOM_LENGTH);
+	settings->client_random_length = CLIENT_RANDOM_LENGTH;
+	settings->server_random = (BYTE*) malloc(32);
+	settings->server_random_length = 32;
+
+	CU_ASSERT(freerdp_reconnect(instance) == TRUE);
+	CU_ASSERT(rdp->reconnecting == TRUE);
+	CU_ASSERT(rdp->reconnect_retry == 1);
+
+	/* the connection layers are new, the client modules are kept */
+	CU_ASSERT(rdp->transport != transport);
+	CU_ASSERT(rdp->transport->metrics == rdp->metrics);
+	CU_ASSERT(rdp->nego->transport == rdp->transport);
+	CU_ASSERT(rdp->mcs->transport == rdp->transport);
+	CU_ASSERT(instance->update == update);
+	CU_ASSERT(instance->input == input);
+	CU_ASSERT(instance->context->graphics == graphics);
+	CU_ASSERT(rdp->update == update);
+
+	CU_ASSERT(rdp->sec_flags == 0);
+	CU_ASSERT(rdp->do_crypt == FALSE);
+	CU_ASSERT(rdp->encrypt_use_count == 0);
+	CU_ASSERT(settings->client_random == NULL);
+	CU_ASSERT(settings->server_random == NULL);
+	CU_ASSERT(settings->server_random_length == 0);
+
+	/* the cookie is kept for the next attempt */
+	CU_ASSERT(settings->server_auto_reconnect_cookie->cbLen == 28);
+	CU_ASSERT(settings->server_auto_reconnect_cookie->logonId == 1);
+
+	test_reconnect_instance_free(instance);
+}
+
+void test_reconnect_backoff(void)
+{
+	int rcount;
+	int wcount;
+	void* rfds[32];
+	void* wfds[32];
+	void* event_fds[1];
+	int event_count;
+	UINT32 start;
+	UINT32 elapsed;
+	freerdp* instance;
+	rdpRdp* rdp;
+
+	instance = test_reconnect_instance_new();
+	rdp = instance->context->rdp;
+
+	/* the lost connection is noticed by check_fds, the first attempt is made right away */
+	start = freerdp_get_tick_count();
+	CU_ASSERT(freerdp_check_fds(instance) == TRUE);
+	elapsed = freerdp_get_tick_count() - start;
+
+	CU_ASSERT(rdp->reconnecting == TRUE);
+	CU_ASSERT(rdp->reconnect_retry == 1);
+	CU_ASSERT(rdp->reconnect_delay == 500);
+	CU_ASSERT(elapsed < 400);
+
+	/* the event loop waits on the reconnect event rather than the lost transport */
+	rcount = wcount = 0;
+	event_count = 0;
+	CU_ASSERT(freerdp_get_fds(instance, rfds, &rcount, wfds, &wcount) == TRUE);
+	wait_obj_get_fds(rdp->reconnect_event, event_fds, &event_count);
+	CU_ASSERT(rcount == 1);
+	CU_ASSERT(rfds[0] == event_fds[0]);
+
+	/* nothing happens, and nothing blocks, until the next attempt is due */
+	start = freerdp_get_tick_count();
+	CU_ASSERT(freerdp_check_fds(instance) == TRUE);
+	CU_ASSERT(freerdp_check_fds(instance) == TRUE);
+	CU_ASSERT(rdp->reconnect_retry == 1);
+	CU_ASSERT(freerdp_get_tick_count() - start < 100);
+
+	wait_obj_select(&rdp->reconnect_event, 1, 5000);
+	elapsed = freerdp_get_tick_count() - start;
+	CU_ASSERT(elapsed >= 450);
+	CU_ASSERT(elapsed < 1500);
+
+	CU_ASSERT(freerdp_check_fds(instance) == TRUE);
+	CU_ASSERT(rdp->reconnect_retry == 2);
+	CU_ASSERT(rdp->reconnect_delay == 1000);
+
+	/* the delay doubles, and the last failed attempt gives up */
+	start = freerdp_get_tick_count();
+	wait_obj_select(&rdp->reconnect_event, 1, 5000);
+	elapsed = freerdp_get_tick_count() - start;
+	CU_ASSERT(elapsed >= 950);
+	CU_ASSERT(elapsed < 2500);
+
+	CU_ASSERT(freerdp_check_fds(instance) == FALSE);
+	CU_ASSERT(rdp->reconnect_retry == 3);
+	CU_ASSERT(rdp->reconnecting == FALSE);
+
+	rcount = wcount = 0;
+	CU_ASSERT(freerdp_get_fds(instance, rfds, &rcount, wfds, &wcount) == TRUE);
+	CU_ASSERT(rfds[0] != event_fds[0]);
+
+	test_reconnect_instance_free(instance);
+}
+
+/**
+ * A channel join confirm, as the server sends it.
+ */
+
+static STREAM* test_reconnect_join_confirm(rdpMcs* mcs, UINT16 channel_id)
+{
+	STREAM* s;
+
+	s = stream_new(15);
+	mcs_write_domain_mcspdu_header(s, DomainMCSPDU_ChannelJoinConfirm, 15, 2);
+	per_write_enumerated(s, 0, MCS_Result_enum_length);
+	per_write_integer16(s, mcs->user_id, MCS_BASE_CHANNEL_ID);
+	per_write_integer16(s, channel_id, 0);
+	per_write_integer16(s, channel_id, 0);
+	stream_seal(s);
+	stream_set_pos(s, 0);
+
+	return s;
+}
+
+static BOOL test_reconnect_recv_join_confirm(rdpRdp* rdp, UINT16 channel_id)
+{
+	BOOL status;
+	STREAM* s;
+
+	s = test_reconnect_join_confirm(rdp->mcs, channel_id);
+	status = rdp_client_connect_mcs_channel_join_confirm(rdp, s);
+	stream_free(s);
+
+	return status;
+}
+
+void test_reconnect_channel_join(void)
+{
+	freerdp* instance;
+	rdpRdp* rdp;
+	rdpSettings* settings;
+
+	instance = test_reconnect_instance_new();
+	rdp = instance->context->rdp;
+	settings = instance->settings;
+
+	/* two static channels, joined by the lost connection */
+	settings->num_channels = 2;
+	strcpy(settings->channels[0].name, "cliprdr");
+	settings->channels[0].channel_id = MCS_GLOBAL_CHANNEL_ID + 1;
+	settings->channels[0].joined = TRUE;
+	strcpy(settings->channels[1].name, "rdpsnd");
+	settings->channels[1].channel_id = MCS_GLOBAL_CHANNEL_ID + 2;
+	settings->channels[1].joined = TRUE;
+
+	CU_ASSERT(freerdp_reconnect(instance) == TRUE);
+	CU_ASSERT(settings->channels[0].joined == FALSE);
+	CU_ASSERT(settings->channels[1].joined == FALSE);
+	CU_ASSERT(rdp->mcs->user_channel_joined == FALSE);
+	CU_ASSERT(rdp->mcs->global_channel_joined == FALSE);
+
+	/* the new connection joins them again, in whatever order the confirms come */
+	rdp->mcs->user_id = MCS_GLOBAL_CHANNEL_ID + 4;
+	rdp->state = CONNECTION_STATE_MCS_CHANNEL_JOIN;
+
+	CU_ASSERT(test_reconnect_recv_join_confirm(rdp, MCS_GLOBAL_CHANNEL_ID + 1) == TRUE);
+	CU_ASSERT(settings->channels[0].joined == TRUE);
+	CU_ASSERT(test_reconnect_recv_join_confirm(rdp, rdp->mcs->user_id) == TRUE);
+	CU_ASSERT(rdp->mcs->user_channel_joined == TRUE);
+	CU_ASSERT(test_reconnect_recv_join_confirm(rdp, MCS_GLOBAL_CHANNEL_ID) == TRUE);
+	CU_ASSERT(rdp->mcs->global_channel_joined == TRUE);
+
+	/* repeated and unknown confirms are ignored */
+	CU_ASSERT(test_reconnect_recv_join_confirm(rdp, MCS_GLOBAL_CHANNEL_ID) == TRUE);
+	CU_ASSERT(test_reconnect_recv_join_confirm(rdp, MCS_GLOBAL_CHANNEL_ID + 1) == TRUE);
+	CU_ASSERT(test_reconnect_recv_join_confirm(rdp, MCS_GLOBAL_CHANNEL_ID + 9) == TRUE);
+	CU_ASSERT(settings->channels[1].joined == FALSE);
+	CU_ASSERT(rdp->state == CONNECTION_STATE_MCS_CHANNEL_JOIN);
+
+	test_reconnect_instance_free(instance);
+}
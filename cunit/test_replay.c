@@ -0,0 +1,299 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Session Replay Unit Tests
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "rdp.h"
+#include "transport.h"
+
+#include <freerdp/freerdp.h>
+#include <freerdp/replay.h>
+#include <freerdp/gdi/gdi.h>
+#include <freerdp/utils/pcap.h>
+
+#include "test_replay.h"
+
+/**
+ * The reference captures were recorded from a 256x128 32bpp session:
+ *
+ * surface.pcap: MPPC compressed fast-path updates, three frames of
+ * RemoteFX (a gradient, then fragmented noise) and NSCodec surface bits
+ *
+ * orders.pcap: fast-path opaque rect, dstblt, scrblt and patblt orders,
+ * fragmented uncompressed surface bits and a slow-path bitmap update
+ */
+
+#ifndef TEST_CAPTURES_PATH
+#define TEST_CAPTURES_PATH		"captures"
+#endif
+
+#define TEST_SURFACE_CAPTURE		TEST_CAPTURES_PATH "/surface.pcap"
+#define TEST_ORDERS_CAPTURE		TEST_CAPTURES_PATH "/orders.pcap"
+
+#define TEST_SURFACE_CHECKSUM		0x9D6D3E9A
+#define TEST_ORDERS_CHECKSUM		0x4D6AF0C5
+
+int init_replay_suite(void)
+{
+	return 0;
+}
+
+int clean_replay_suite(void)
+{
+	return 0;
+}
+
+int add_replay_suite(void)
+{
+	add_test_suite(replay);
+
+	add_test_function(replay_surface_commands);
+	add_test_function(replay_orders);
+	add_test_function(replay_skipped_records);
+	add_test_function(replay_dump_pdu);
+	add_test_function(replay_benchmark);
+
+	return 0;
+}
+
+static freerdp* test_replay_instance_new(void)
+{
+	freerdp* instance;
+
+	instance = freerdp_new();
+	freerdp_context_new(instance);
+
+	instance->settings->width = 256;
+	instance->settings->height = 128;
+	instance->settings->color_depth = 32;
+
+	gdi_init(instance, CLRCONV_ALPHA | CLRBUF_32BPP, NULL);
+
+	return instance;
+}
+
+static void test_replay_instance_free(freerdp* instance)
+{
+	gdi_free(instance);
+	freerdp_context_free(instance);
+	freerdp_free(instance);
+}
+
+static UINT32 test_replay_checksum(freerdp* instance)
+{
+	rdpGdi* gdi = instance->context->gdi;
+
+	return freerdp_replay_checksum(gdi->primary_buffer, gdi->width * gdi->height * gdi->bytesPerPixel);
+}
+
+void test_replay_surface_commands(void)
+{
+	freerdp* instance;
+	rdpReplayStats stats;
+
+	instance = test_replay_instance_new();
+
+	CU_ASSERT(freerdp_replay(instance, TEST_SURFACE_CAPTURE, &stats) == TRUE);
+
+	CU_ASSERT(stats.pdus == 10);
+	CU_ASSERT(stats.skipped == 0);
+	CU_ASSERT(stats.metrics.counters[METRICS_FASTPATH_FRAGMENTS] == 2);
+	CU_ASSERT(stats.metrics.counters[METRICS_MPPC_DECOMPRESS_OUTPUT_BYTES] > 0);
+	CU_ASSERT(stats.metrics.counters[METRICS_UPDATE_PIXELS] == (2 * 256 * 128) + (64 * 48));
+	CU_ASSERT(stats.metrics.histograms[METRICS_SURFACE_REMOTEFX].count == 2);
+	CU_ASSERT(stats.metrics.histograms[METRICS_SURFACE_NSCODEC].count == 1);
+	CU_ASSERT(stats.metrics.histograms[METRICS_RFX_RLGR_DECODE].count > 0);
+
+	CU_ASSERT(test_replay_checksum(instance) == TEST_SURFACE_CHECKSUM);
+
+	test_replay_instance_free(instance);
+}
+
+void test_replay_orders(void)
+{
+	freerdp* instance;
+	rdpReplayStats stats;
+
+	instance = test_replay_instance_new();
+
+	CU_ASSERT(freerdp_replay(instance, TEST_ORDERS_CAPTURE, &stats) == TRUE);
+
+	CU_ASSERT(stats.pdus == 10);
+	CU_ASSERT(stats.skipped == 0);
+	CU_ASSERT(stats.metrics.counters[METRICS_UPDATE_PIXELS] == (64 * 64) + (32 * 32));
+	CU_ASSERT(stats.metrics.histograms[METRICS_ORDERS].count == 7);
+	CU_ASSERT(stats.metrics.histograms[METRICS_SURFACE_UNCOMPRESSED].count == 1);
+	CU_ASSERT(stats.metrics.histograms[METRICS_BITMAP_DECOMPRESS].count == 1);
+
+	CU_ASSERT(test_replay_checksum(instance) == TEST_ORDERS_CHECKSUM);
+
+	test_replay_instance_free(instance);
+}
+
+/* a fast-path PDU encrypted with Standard RDP encryption */
+static BYTE test_encrypted_pdu[] = "\x80\x0E\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00";
+
+void test_replay_skipped_records(void)
+{
+	UINT32 checksum;
+	rdpPcap* pcap;
+	rdpPcap* capture;
+	freerdp* instance;
+	pcap_record record;
+	rdpReplayStats stats;
+	BYTE* records[16];
+	int count = 0;
+
+	/* truncate the first record and add an encrypted one */
+	capture = pcap_open(TEST_ORDERS_CAPTURE, FALSE);
+	pcap = pcap_open("/tmp/test_replay.pcap", TRUE);
+
+	while (pcap_get_next_record(capture, &record))
+	{
+		records[count++] = record.data;
+		pcap_add_record(pcap, record.data, (count == 1) ? record.length - 1 : record.length);
+	}
+
+	pcap_add_record(pcap, test_encrypted_pdu, sizeof(test_encrypted_pdu) - 1);
+	pcap_close(pcap);
+	pcap_close(capture);
+
+	while (count > 0)
+		free(records[--count]);
+
+	instance = test_replay_instance_new();
+
+	CU_ASSERT(freerdp_replay(instance, "/tmp/test_replay.pcap", &stats) == TRUE);
+	CU_ASSERT(stats.pdus == 9);
+	CU_ASSERT(stats.skipped == 2);
+
+	checksum = test_replay_checksum(instance);
+	CU_ASSERT(checksum != TEST_ORDERS_CHECKSUM);
+
+	CU_ASSERT(freerdp_replay(instance, "/tmp/nonexistent.pcap", &stats) == FALSE);
+
+	test_replay_instance_free(instance);
+}
+
+static int test_pdus_received;
+
+static BOOL test_replay_recv_callback(rdpTransport* transport, STREAM* s, void* extra)
+{
+	test_pdus_received++;
+	return TRUE;
+}
+
+void test_replay_dump_pdu(void)
+{
+	int fds[2];
+	int length;
+	rdpPcap* pcap;
+	rdpPcap* capture;
+	pcap_record record;
+	pcap_record dumped;
+	rdpRdp* rdp;
+	rdpTransport* transport;
+	int matching = 0;
+	int count = 0;
+
+	CU_ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+	rdp = rdp_new(NULL);
+	transport = rdp->transport;
+	transport_attach(transport, fds[0]);
+	transport->recv_callback = test_replay_recv_callback;
+	transport->pcap_pdu = pcap_open("/tmp/test_replay_dump.pcap", TRUE);
+
+	/* the PDUs of the capture arrive over the socket, back to back */
+	test_pdus_received = 0;
+	capture = pcap_open(TEST_SURFACE_CAPTURE, FALSE);
+
+	while (pcap_get_next_record(capture, &record))
+	{
+		length = write(fds[1], record.data, record.length);
+		CU_ASSERT(length == (int) record.length);
+		free(record.data);
+		count++;
+
+		transport_check_fds(&rdp->transport);
+	}
+
+	pcap_close(capture);
+	rdp_free(rdp);
+	close(fds[0]);
+	close(fds[1]);
+
+	CU_ASSERT(test_pdus_received == count);
+
+	/* the dump matches the capture record for record */
+	capture = pcap_open(TEST_SURFACE_CAPTURE, FALSE);
+	pcap = pcap_open("/tmp/test_replay_dump.pcap", FALSE);
+
+	while (pcap_get_next_record(capture, &record))
+	{
+		if (!pcap_get_next_record(pcap, &dumped))
+		{
+			free(record.data);
+			break;
+		}
+
+		if ((record.length == dumped.length) && (memcmp(record.data, dumped.data, record.length) == 0))
+			matching++;
+
+		free(record.data);
+		free(dumped.data);
+	}
+
+	CU_ASSERT(matching == count);
+	CU_ASSERT(pcap_has_next_record(pcap) == FALSE);
+
+	pcap_close(pcap);
+	pcap_close(capture);
+}
+
+void test_replay_benchmark(void)
+{
+	int i;
+	UINT64 pdus = 0;
+	UINT64 pixels = 0;
+	UINT64 elapsed = 0;
+	freerdp* instance;
+	rdpReplayStats stats;
+
+	for (i = 0; i < 20; i++)
+	{
+		instance = test_replay_instance_new();
+		freerdp_replay(instance, TEST_SURFACE_CAPTURE, &stats);
+		test_replay_instance_free(instance);
+
+		pdus += stats.pdus;
+		pixels += stats.metrics.counters[METRICS_UPDATE_PIXELS];
+		elapsed += stats.elapsed;
+	}
+
+	CU_ASSERT(elapsed > 0);
+
+	if (elapsed > 0)
+	{
+		printf("\nreplay: %d PDUs/s, %d Mpixels/s\n",
+			(int) ((pdus * 1000000000) / elapsed), (int) ((pixels * 1000) / elapsed));
+	}
+}
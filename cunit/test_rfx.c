@@ -25,6 +25,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/time.h>
 #include <freerdp/types.h>
 #include <freerdp/utils/print.h>
 #include <freerdp/utils/memory.h>
@@ -176,12 +177,15 @@ int add_rfx_suite(void)
 	add_test_function(bitstream);
 	add_test_function(bitstream_enc);
 	add_test_function(rlgr);
+	add_test_function(rlgr_fuzz);
 	add_test_function(differential);
 	add_test_function(quantization);
 	add_test_function(dwt);
 	add_test_function(decode);
 	add_test_function(encode);
 	add_test_function(message);
+	add_test_function(pipeline_benchmark);
+	add_test_function(rate_control);
 
 	return 0;
 }
@@ -217,6 +221,7 @@ void test_bitstream_enc(void)
 	{
 		rfx_bitstream_put_bits(bs, i, 5);
 	}
+	rfx_bitstream_flush(bs);
 	/*for (i = 0; i < sizeof(buffer); i++)
 	{
 		printf("%X ", buffer[i]);
@@ -408,3 +413,1057 @@ void test_message(void)
 	rfx_context_free(context);
 	free(rgb_data);
 }
+
+/**
+ * Reference bit-at-a-time RLGR coder, as implemented before the bitstream
+ * was moved to a 64-bit reservoir. The fuzz test checks that the current
+ * coder produces exactly the same bits and coefficients.
+ */
+
+struct _REF_BITSTREAM
+{
+	BYTE* buffer;
+	int nbytes;
+	int byte_pos;
+	int bits_left;
+};
+typedef struct _REF_BITSTREAM REF_BITSTREAM;
+
+#define ref_bitstream_attach(bs, _buffer, _nbytes) do { \
+	bs->buffer = (BYTE*) (_buffer); \
+	bs->nbytes = (_nbytes); \
+	bs->byte_pos = 0; \
+	bs->bits_left = 8; } while (0)
+
+#define ref_bitstream_get_bits(bs, _nbits, _r) do { \
+	int nbits = _nbits; \
+	int b; \
+	UINT16 n = 0; \
+	while (bs->byte_pos < bs->nbytes && nbits > 0) \
+	{ \
+		b = nbits; \
+		if (b > bs->bits_left) \
+			b = bs->bits_left; \
+		if (n) \
+			n <<= b; \
+		n |= (bs->buffer[bs->byte_pos] >> (bs->bits_left - b)) & ((1 << b) - 1); \
+		bs->bits_left -= b; \
+		nbits -= b; \
+		if (bs->bits_left == 0) \
+		{ \
+			bs->bits_left = 8; \
+			bs->byte_pos++; \
+		} \
+	} \
+	_r = n; } while (0)
+
+#define ref_bitstream_put_bits(bs, _bits, _nbits) do { \
+	UINT16 bits = (_bits); \
+	int nbits = (_nbits); \
+	int b; \
+	while (bs->byte_pos < bs->nbytes && nbits > 0) \
+	{ \
+		b = nbits; \
+		if (b > bs->bits_left) \
+			b = bs->bits_left; \
+		bs->buffer[bs->byte_pos] |= ((bits >> (nbits - b)) & ((1 << b) - 1)) << (bs->bits_left - b); \
+		bs->bits_left -= b; \
+		nbits -= b; \
+		if (bs->bits_left == 0) \
+		{ \
+			bs->bits_left = 8; \
+			bs->byte_pos++; \
+		} \
+	} } while (0)
+
+#define ref_bitstream_eos(_bs) ((_bs)->byte_pos >= (_bs)->nbytes)
+#define ref_bitstream_get_processed_bytes(_bs) ((_bs)->bits_left < 8 ? (_bs)->byte_pos + 1 : (_bs)->byte_pos)
+
+/* Constants used within the RLGR1/RLGR3 algorithm */
+#define KPMAX	(80)  /* max value for kp or krp */
+#define LSGR	(3)   /* shift count to convert kp to k */
+#define UP_GR	(4)   /* increase in kp after a zero run in RL mode */
+#define DN_GR	(6)   /* decrease in kp after a nonzero symbol in RL mode */
+#define UQ_GR	(3)   /* increase in kp after nonzero symbol in GR mode */
+#define DQ_GR	(3)   /* decrease in kp after zero symbol in GR mode */
+
+/* Gets (returns) the next nBits from the bitstream */
+#define GetBits(nBits, r) ref_bitstream_get_bits(bs, nBits, r)
+
+/* From current output pointer, write "value", check and update buffer_size */
+#define WriteValue(value) \
+{ \
+	if (buffer_size > 0) \
+		*dst++ = (value); \
+	buffer_size--; \
+}
+
+/* From current output pointer, write next nZeroes terms with value 0, check and update buffer_size */
+#define WriteZeroes(nZeroes) \
+{ \
+	int nZeroesWritten = (nZeroes); \
+	if (nZeroesWritten > buffer_size) \
+		nZeroesWritten = buffer_size; \
+	if (nZeroesWritten > 0) \
+	{ \
+		memset(dst, 0, nZeroesWritten * sizeof(INT16)); \
+		dst += nZeroesWritten; \
+	} \
+	buffer_size -= (nZeroes); \
+}
+
+/* Returns the least number of bits required to represent a given value */
+#define GetMinBits(_val, _nbits) \
+{ \
+	UINT32 _v = _val; \
+	_nbits = 0; \
+	while (_v) \
+	{ \
+		_v >>= 1; \
+		_nbits++; \
+	} \
+}
+
+/* Converts from (2 * magnitude - sign) to integer */
+#define GetIntFrom2MagSign(twoMs) (((twoMs) & 1) ? -1 * (INT16)(((twoMs) + 1) >> 1) : (INT16)((twoMs) >> 1))
+
+/*
+ * Update the passed parameter and clamp it to the range [0, KPMAX]
+ * Return the value of parameter right-shifted by LSGR
+ */
+#define UpdateParam(_param, _deltaP, _k) \
+{ \
+	_param += _deltaP; \
+	if (_param > KPMAX) \
+		_param = KPMAX; \
+	if (_param < 0) \
+		_param = 0; \
+	_k = (_param >> LSGR); \
+}
+
+/* Outputs the Golomb/Rice encoding of a non-negative integer */
+#define GetGRCode(krp, kr, vk, _mag) \
+	vk = 0; \
+	_mag = 0; \
+	/* chew up/count leading 1s and escape 0 */ \
+	do { \
+		GetBits(1, r); \
+		if (r == 1) \
+			vk++; \
+		else \
+			break; \
+	} while (1); \
+	/* get next *kr bits, and combine with leading 1s */ \
+	GetBits(*kr, _mag); \
+	_mag |= (vk << *kr); \
+	/* adjust krp and kr based on vk */ \
+	if (!vk) { \
+		UpdateParam(*krp, -2, *kr); \
+	} \
+	else if (vk != 1) { \
+		UpdateParam(*krp, vk, *kr); /* at 1, no change! */ \
+	}
+
+static int ref_rlgr_decode(RLGR_MODE mode, const BYTE* data, int data_size, INT16* buffer, int buffer_size)
+{
+	int k;
+	int kp;
+	int kr;
+	int krp;
+	UINT16 r;
+	INT16* dst;
+	REF_BITSTREAM* bs;
+
+	int vk;
+	UINT16 mag16;
+
+	bs = xnew(REF_BITSTREAM);
+	ref_bitstream_attach(bs, data, data_size);
+	dst = buffer;
+
+	/* initialize the parameters */
+	k = 1;
+	kp = k << LSGR;
+	kr = 1;
+	krp = kr << LSGR;
+
+	while (!ref_bitstream_eos(bs) && buffer_size > 0)
+	{
+		int run;
+		if (k)
+		{
+			int mag;
+			UINT32 sign;
+
+			/* RL MODE */
+			while (!ref_bitstream_eos(bs))
+			{
+				GetBits(1, r);
+				if (r)
+					break;
+				/* we have an RL escape "0", which translates to a run (1<<k) of zeros */
+				WriteZeroes(1 << k);
+				UpdateParam(kp, UP_GR, k); /* raise k and kp up because of zero run */
+			}
+
+			/* next k bits will contain remaining run or zeros */
+			GetBits(k, run);
+			WriteZeroes(run);
+
+			/* get nonzero value, starting with sign bit and then GRCode for magnitude -1 */
+			GetBits(1, sign);
+
+			/* magnitude - 1 was coded (because it was nonzero) */
+			GetGRCode(&krp, &kr, vk, mag16)
+			mag = (int) (mag16 + 1);
+
+			WriteValue(sign ? -mag : mag);
+			UpdateParam(kp, -DN_GR, k); /* lower k and kp because of nonzero term */
+		}
+		else
+		{
+			UINT32 mag;
+			UINT32 nIdx;
+			UINT32 val1;
+			UINT32 val2;
+
+			/* GR (GOLOMB-RICE) MODE */
+			GetGRCode(&krp, &kr, vk, mag16) /* values coded are 2 * magnitude - sign */
+			mag = (UINT32) mag16;
+
+			if (mode == RLGR1)
+			{
+				if (!mag)
+				{
+					WriteValue(0);
+					UpdateParam(kp, UQ_GR, k); /* raise k and kp due to zero */
+				}
+				else
+				{
+					WriteValue(GetIntFrom2MagSign(mag));
+					UpdateParam(kp, -DQ_GR, k); /* lower k and kp due to nonzero */
+				}
+			}
+			else /* mode == RLGR3 */
+			{
+				/*
+				 * In GR mode FOR RLGR3, we have encoded the
+				 * sum of two (2 * mag - sign) values
+				 */
+
+				/* maximum possible bits for first term */
+				GetMinBits(mag, nIdx);
+
+				/* decode val1 is first term's (2 * mag - sign) value */
+				GetBits(nIdx, val1);
+
+				/* val2 is second term's (2 * mag - sign) value */
+				val2 = mag - val1;
+
+				if (val1 && val2)
+				{
+					/* raise k and kp if both terms nonzero */
+					UpdateParam(kp, -2 * DQ_GR, k);
+				}
+				else if (!val1 && !val2)
+				{
+					/* lower k and kp if both terms zero */
+					UpdateParam(kp, 2 * UQ_GR, k);
+				}
+
+				WriteValue(GetIntFrom2MagSign(val1));
+				WriteValue(GetIntFrom2MagSign(val2));
+			}
+		}
+	}
+
+	free(bs);
+
+	return (dst - buffer);
+}
+
+/* Returns the next coefficient (a signed int) to encode, from the input stream */
+#define GetNextInput(_n) \
+{ \
+	if (data_size > 0) \
+	{ \
+		_n = *data++; \
+		data_size--; \
+	} \
+	else \
+	{ \
+		_n = 0; \
+	} \
+}
+
+/* Emit bitPattern to the output bitstream */
+#define OutputBits(numBits, bitPattern) ref_bitstream_put_bits(bs, bitPattern, numBits)
+
+/* Emit a bit (0 or 1), count number of times, to the output bitstream */
+#define OutputBit(count, bit) \
+{	\
+	UINT16 _b = (bit ? 0xFFFF : 0); \
+	int _c = (count); \
+	for (; _c > 0; _c -= 16) \
+		ref_bitstream_put_bits(bs, _b, (_c > 16 ? 16 : _c)); \
+}
+
+/* Converts the input value to (2 * abs(input) - sign(input)), where sign(input) = (input < 0 ? 1 : 0) and returns it */
+#define Get2MagSign(input) ((input) >= 0 ? 2 * (input) : -2 * (input) - 1)
+
+/* Outputs the Golomb/Rice encoding of a non-negative integer */
+#define CodeGR(krp, val) ref_rlgr_code_gr(bs, krp, val)
+
+static void ref_rlgr_code_gr(REF_BITSTREAM* bs, int* krp, UINT32 val)
+{
+	int kr = *krp >> LSGR;
+
+	/* unary part of GR code */
+
+	UINT32 vk = (val) >> kr;
+	OutputBit(vk, 1);
+	OutputBit(1, 0);
+
+	/* remainder part of GR code, if needed */
+	if (kr)
+	{
+		OutputBits(kr, val & ((1 << kr) - 1));
+	}
+
+	/* update krp, only if it is not equal to 1 */
+	if (vk == 0)
+	{
+		UpdateParam(*krp, -2, kr);
+	}
+ 	else if (vk > 1)
+	{
+		UpdateParam(*krp, vk, kr);
+	}
+}
+
+static int ref_rlgr_encode(RLGR_MODE mode, const INT16* data, int data_size, BYTE* buffer, int buffer_size)
+{
+	int k;
+	int kp;
+	int krp;
+	REF_BITSTREAM* bs;
+	int processed_size;
+
+	bs = xnew(REF_BITSTREAM);
+	ref_bitstream_attach(bs, buffer, buffer_size);
+
+	/* initialize the parameters */
+	k = 1;
+	kp = 1 << LSGR;
+	krp = 1 << LSGR;
+
+	/* process all the input coefficients */
+	while (data_size > 0)
+	{
+		int input;
+
+		if (k)
+		{
+			int numZeros;
+			int runmax;
+			int mag;
+			int sign;
+
+			/* RUN-LENGTH MODE */
+
+			/* collect the run of zeros in the input stream */
+			numZeros = 0;
+			GetNextInput(input);
+			while (input == 0 && data_size > 0)
+			{
+				numZeros++;
+				GetNextInput(input);
+			}
+
+			// emit output zeros
+			runmax = 1 << k;
+			while (numZeros >= runmax)
+			{
+				OutputBit(1, 0); /* output a zero bit */
+				numZeros -= runmax;
+				UpdateParam(kp, UP_GR, k); /* update kp, k */
+				runmax = 1 << k;
+			}
+
+			/* output a 1 to terminate runs */
+			OutputBit(1, 1);
+
+			/* output the remaining run length using k bits */
+			OutputBits(k, numZeros);
+
+			/* note: when we reach here and the last byte being encoded is 0, we still
+			   need to output the last two bits, otherwise mstsc will crash */
+
+			/* encode the nonzero value using GR coding */
+			mag = (input < 0 ? -input : input); /* absolute value of input coefficient */
+			sign = (input < 0 ? 1 : 0);  /* sign of input coefficient */
+
+			OutputBit(1, sign); /* output the sign bit */
+			CodeGR(&krp, mag ? mag - 1 : 0); /* output GR code for (mag - 1) */
+
+			UpdateParam(kp, -DN_GR, k);
+		}
+		else
+		{
+			/* GOLOMB-RICE MODE */
+
+			if (mode == RLGR1)
+			{
+				UINT32 twoMs;
+
+				/* RLGR1 variant */
+
+				/* convert input to (2*magnitude - sign), encode using GR code */
+				GetNextInput(input);
+				twoMs = Get2MagSign(input);
+				CodeGR(&krp, twoMs);
+
+				/* update k, kp */
+				/* NOTE: as of Aug 2011, the algorithm is still wrongly documented
+				   and the update direction is reversed */
+				if (twoMs)
+				{
+					UpdateParam(kp, -DQ_GR, k);
+				}
+				else
+				{
+					UpdateParam(kp, UQ_GR, k);
+				}
+			}
+			else /* mode == RLGR3 */
+			{
+				UINT32 twoMs1;
+				UINT32 twoMs2;
+				UINT32 sum2Ms;
+				UINT32 nIdx;
+
+				/* RLGR3 variant */
+
+				/* convert the next two input values to (2*magnitude - sign) and */
+				/* encode their sum using GR code */
+
+				GetNextInput(input);
+				twoMs1 = Get2MagSign(input);
+				GetNextInput(input);
+				twoMs2 = Get2MagSign(input);
+				sum2Ms = twoMs1 + twoMs2;
+
+				CodeGR(&krp, sum2Ms);
+
+				/* encode binary representation of the first input (twoMs1). */
+				GetMinBits(sum2Ms, nIdx);
+				OutputBits(nIdx, twoMs1);
+
+				/* update k,kp for the two input values */
+
+				if (twoMs1 && twoMs2)
+				{
+					UpdateParam(kp, -2 * DQ_GR, k);
+				}
+				else if (!twoMs1 && !twoMs2)
+				{
+					UpdateParam(kp, 2 * UQ_GR, k);
+				}
+			}
+		}
+	}
+
+	processed_size = ref_bitstream_get_processed_bytes(bs);
+	free(bs);
+
+	return processed_size;
+}
+
+static INT16 fuzz_data[4096];
+static INT16 fuzz_decoded[4096];
+static INT16 fuzz_ref_decoded[4096];
+static BYTE fuzz_encoded[65536];
+static BYTE fuzz_ref_encoded[65536];
+
+static void test_rlgr_fuzz_block(INT16* block, int kind)
+{
+	int i;
+
+	for (i = 0; i < 4096; i++)
+	{
+		switch (kind)
+		{
+			case 0: /* mostly zero, as in high frequency subbands */
+				block[i] = (rand() % 8) ? 0 : (rand() % 33) - 16;
+				break;
+
+			case 1: /* long runs of zeros */
+				block[i] = (rand() % 256) ? 0 : (rand() % 2047) - 1023;
+				break;
+
+			case 2: /* dense small values */
+				block[i] = (rand() % 513) - 256;
+				break;
+
+			default: /* widest range a RLGR3 pair sum can code */
+				block[i] = (rand() % 32767) - 16383;
+				break;
+		}
+	}
+}
+
+void test_rlgr_fuzz(void)
+{
+	int i, j;
+	int size;
+	int length;
+	int n, ref_n;
+	int enc_size, ref_enc_size;
+	RLGR_MODE mode;
+
+	srand(4096);
+
+	for (i = 0; i < 400; i++)
+	{
+		mode = (i & 1) ? RLGR3 : RLGR1;
+		test_rlgr_fuzz_block(fuzz_data, (i >> 1) % 4);
+
+		/* a trailing zero in run-length mode is coded as a one */
+		fuzz_data[4095] = 1;
+
+		/* every tenth block gets an output buffer too small to hold it */
+		size = ((i % 10) == 9) ? rand() % 2048 : sizeof(fuzz_encoded);
+
+		memset(fuzz_encoded, 0, sizeof(fuzz_encoded));
+		memset(fuzz_ref_encoded, 0, sizeof(fuzz_ref_encoded));
+
+		enc_size = rfx_rlgr_encode(mode, fuzz_data, 4096, fuzz_encoded, size);
+		ref_enc_size = ref_rlgr_encode(mode, fuzz_data, 4096, fuzz_ref_encoded, size);
+
+		CU_ASSERT(enc_size == ref_enc_size);
+		CU_ASSERT(memcmp(fuzz_encoded, fuzz_ref_encoded, sizeof(fuzz_encoded)) == 0);
+
+		n = rfx_rlgr_decode(mode, fuzz_encoded, enc_size, fuzz_decoded, 4096);
+		ref_n = ref_rlgr_decode(mode, fuzz_encoded, enc_size, fuzz_ref_decoded, 4096);
+
+		CU_ASSERT(n == ref_n);
+		CU_ASSERT(memcmp(fuzz_decoded, fuzz_ref_decoded, ref_n * sizeof(INT16)) == 0);
+
+		if (size == sizeof(fuzz_encoded))
+		{
+			CU_ASSERT(n == 4096);
+			CU_ASSERT(memcmp(fuzz_decoded, fuzz_data, sizeof(fuzz_data)) == 0);
+		}
+
+		/* arbitrary input has to decode to the same coefficients as well */
+		length = rand() % 1024;
+
+		for (j = 0; j < length; j++)
+			fuzz_encoded[j] = rand();
+
+		n = rfx_rlgr_decode(mode, fuzz_encoded, length, fuzz_decoded, 4096);
+		ref_n = ref_rlgr_decode(mode, fuzz_encoded, length, fuzz_ref_decoded, 4096);
+
+		CU_ASSERT(n == ref_n);
+		CU_ASSERT(memcmp(fuzz_decoded, fuzz_ref_decoded, ref_n * sizeof(INT16)) == 0);
+	}
+}
+
+#define TEST_RFX_TILES			8
+#define TEST_RFX_ITERATIONS		100
+
+#define TEST_RFX_STAGE_YCBCR		0
+#define TEST_RFX_STAGE_DWT		1
+#define TEST_RFX_STAGE_QUANT		2
+#define TEST_RFX_STAGE_DIFF		3
+#define TEST_RFX_STAGE_FUSED		4
+#define TEST_RFX_STAGE_RLGR		5
+#define TEST_RFX_STAGE_TOTAL		6
+#define TEST_RFX_STAGES			7
+
+static const char* test_rfx_stage_names[TEST_RFX_STAGES] =
+{
+	"ycbcr", "dwt", "quant", "diff", "fused", "rlgr", "total"
+};
+
+static UINT64 test_rfx_cycles(void)
+{
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+	UINT32 lo, hi;
+
+	__asm__ __volatile__ ("rdtsc" : "=a" (lo), "=d" (hi));
+
+	return ((UINT64) hi << 32) | lo;
+#else
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+
+	return ((UINT64) tv.tv_sec * 1000000) + tv.tv_usec;
+#endif
+}
+
+static UINT32 test_rfx_cpu_opt(void)
+{
+	UINT32 cpu_opt = 0;
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("sse2"))
+		cpu_opt |= CPU_SSE2;
+
+	if (__builtin_cpu_supports("avx2"))
+		cpu_opt |= CPU_AVX2;
+#endif
+
+	return cpu_opt;
+}
+
+/* Smooth gradients with a few edges and some noise, as in desktop content */
+static void test_rfx_tile(BYTE* rgb, int seed)
+{
+	int x, y;
+	BYTE* p = rgb;
+
+	srand(seed);
+
+	for (y = 0; y < 64; y++)
+	{
+		for (x = 0; x < 64; x++)
+		{
+			*p++ = (x * 3 + y * seed) & 0xFF;
+			*p++ = ((x > 20 + seed) ? 0xE0 : 0x20) + (rand() % 8);
+			*p++ = ((x * y) >> 4) + ((y & 8) ? 0x40 : 0);
+		}
+	}
+}
+
+static void test_rfx_encode_tile(RFX_CONTEXT* context, const BYTE* rgb, STREAM* s, int* sizes, UINT64* cycles)
+{
+	int i, c;
+	UINT64 start;
+	INT16* buffers[3];
+
+	buffers[0] = context->priv->y_r_buffer;
+	buffers[1] = context->priv->cb_g_buffer;
+	buffers[2] = context->priv->cr_b_buffer;
+
+	for (i = 0; i < 4096; i++)
+	{
+		buffers[0][i] = rgb[i * 3];
+		buffers[1][i] = rgb[i * 3 + 1];
+		buffers[2][i] = rgb[i * 3 + 2];
+	}
+
+	start = test_rfx_cycles();
+	context->encode_rgb_to_ycbcr(buffers[0], buffers[1], buffers[2]);
+	cycles[TEST_RFX_STAGE_YCBCR] += test_rfx_cycles() - start;
+
+	for (c = 0; c < 3; c++)
+	{
+		if (context->dwt_2d_quantization_encode)
+		{
+			start = test_rfx_cycles();
+			context->dwt_2d_quantization_encode(buffers[c], context->priv->dwt_buffer, test_quantization_values);
+			cycles[TEST_RFX_STAGE_FUSED] += test_rfx_cycles() - start;
+		}
+		else
+		{
+			start = test_rfx_cycles();
+			context->dwt_2d_encode(buffers[c], context->priv->dwt_buffer);
+			cycles[TEST_RFX_STAGE_DWT] += test_rfx_cycles() - start;
+
+			start = test_rfx_cycles();
+			context->quantization_encode(buffers[c], test_quantization_values);
+			cycles[TEST_RFX_STAGE_QUANT] += test_rfx_cycles() - start;
+
+			start = test_rfx_cycles();
+			rfx_differential_encode(buffers[c] + 4032, 64);
+			cycles[TEST_RFX_STAGE_DIFF] += test_rfx_cycles() - start;
+		}
+
+		stream_check_size(s, 8192);
+		start = test_rfx_cycles();
+		sizes[c] = rfx_rlgr_encode(context->mode, buffers[c], 4096, stream_get_tail(s), 8192);
+		cycles[TEST_RFX_STAGE_RLGR] += test_rfx_cycles() - start;
+		stream_seek(s, sizes[c]);
+	}
+}
+
+static void test_rfx_decode_tile(RFX_CONTEXT* context, STREAM* s, int* sizes, UINT64* cycles)
+{
+	int c;
+	UINT64 start;
+	INT16* buffers[3];
+
+	buffers[0] = context->priv->y_r_buffer;
+	buffers[1] = context->priv->cb_g_buffer;
+	buffers[2] = context->priv->cr_b_buffer;
+
+	for (c = 0; c < 3; c++)
+	{
+		start = test_rfx_cycles();
+		rfx_rlgr_decode(context->mode, stream_get_tail(s), sizes[c], buffers[c], 4096);
+		cycles[TEST_RFX_STAGE_RLGR] += test_rfx_cycles() - start;
+		stream_seek(s, sizes[c]);
+
+		if (context->dwt_2d_quantization_decode)
+		{
+			start = test_rfx_cycles();
+			context->dwt_2d_quantization_decode(buffers[c], context->priv->dwt_buffer, test_quantization_values);
+			cycles[TEST_RFX_STAGE_FUSED] += test_rfx_cycles() - start;
+		}
+		else
+		{
+			start = test_rfx_cycles();
+			rfx_differential_decode(buffers[c] + 4032, 64);
+			cycles[TEST_RFX_STAGE_DIFF] += test_rfx_cycles() - start;
+
+			start = test_rfx_cycles();
+			context->quantization_decode(buffers[c], test_quantization_values);
+			cycles[TEST_RFX_STAGE_QUANT] += test_rfx_cycles() - start;
+
+			start = test_rfx_cycles();
+			context->dwt_2d_decode(buffers[c], context->priv->dwt_buffer);
+			cycles[TEST_RFX_STAGE_DWT] += test_rfx_cycles() - start;
+		}
+	}
+
+	start = test_rfx_cycles();
+	context->decode_ycbcr_to_rgb(buffers[0], buffers[1], buffers[2]);
+	cycles[TEST_RFX_STAGE_YCBCR] += test_rfx_cycles() - start;
+}
+
+static void test_rfx_print_cycles(const char* name, const char* direction, UINT64* cycles, int tiles)
+{
+	int i;
+
+	printf("\n%-6s %s:", name, direction);
+
+	for (i = 0; i < TEST_RFX_STAGES; i++)
+	{
+		if (cycles[i])
+			printf(" %s %d", test_rfx_stage_names[i], (int) (cycles[i] / tiles));
+	}
+}
+
+void test_pipeline_benchmark(void)
+{
+	int i, j, p;
+	int tiles;
+	int size;
+	UINT32 cpu_opt;
+	UINT64 start;
+	RFX_CONTEXT* context;
+	STREAM* s;
+	BYTE* rgb;
+	BYTE* encoded[3];
+	BYTE* decoded[3];
+	int encoded_size[3];
+	int sizes[TEST_RFX_TILES][3];
+	UINT64 enc_cycles[TEST_RFX_STAGES];
+	UINT64 dec_cycles[TEST_RFX_STAGES];
+	BYTE decode_buffer[4096 * 3];
+	const char* names[3] = { "scalar", "sse2", "avx2" };
+	const UINT32 opts[3] = { 0, CPU_SSE2, CPU_SSE2 | CPU_AVX2 };
+
+	cpu_opt = test_rfx_cpu_opt();
+	tiles = TEST_RFX_TILES * TEST_RFX_ITERATIONS;
+	rgb = (BYTE*) malloc(TEST_RFX_TILES * 4096 * 3);
+
+	for (i = 0; i < TEST_RFX_TILES; i++)
+		test_rfx_tile(&rgb[i * 4096 * 3], i + 1);
+
+	for (p = 0; p < 3; p++)
+	{
+		encoded[p] = decoded[p] = NULL;
+
+		if ((opts[p] & cpu_opt) != opts[p])
+			continue;
+
+		context = rfx_context_new();
+		context->mode = RLGR3;
+		rfx_context_set_pixel_format(context, RDP_PIXEL_FORMAT_R8G8B8);
+		rfx_context_set_cpu_opt(context, opts[p]);
+
+		memset(enc_cycles, 0, sizeof(enc_cycles));
+		memset(dec_cycles, 0, sizeof(dec_cycles));
+
+		s = stream_new(65536);
+		stream_clear(s);
+
+		/* per stage */
+		for (j = 0; j < TEST_RFX_ITERATIONS; j++)
+		{
+			stream_set_pos(s, 0);
+
+			for (i = 0; i < TEST_RFX_TILES; i++)
+				test_rfx_encode_tile(context, &rgb[i * 4096 * 3], s, sizes[i], enc_cycles);
+		}
+
+		decoded[p] = (BYTE*) malloc(TEST_RFX_TILES * 4096 * 3);
+
+		for (j = 0; j < TEST_RFX_ITERATIONS; j++)
+		{
+			stream_set_pos(s, 0);
+
+			for (i = 0; i < TEST_RFX_TILES; i++)
+				test_rfx_decode_tile(context, s, sizes[i], dec_cycles);
+		}
+
+		/* whole tiles */
+		for (j = 0; j < TEST_RFX_ITERATIONS; j++)
+		{
+			stream_set_pos(s, 0);
+
+			for (i = 0; i < TEST_RFX_TILES; i++)
+			{
+				start = test_rfx_cycles();
+				rfx_encode_rgb(context, &rgb[i * 4096 * 3], 64, 64, 64 * 3,
+					test_quantization_values, test_quantization_values, test_quantization_values,
+					s, &sizes[i][0], &sizes[i][1], &sizes[i][2]);
+				enc_cycles[TEST_RFX_STAGE_TOTAL] += test_rfx_cycles() - start;
+			}
+
+			stream_set_pos(s, 0);
+
+			for (i = 0; i < TEST_RFX_TILES; i++)
+			{
+				start = test_rfx_cycles();
+				rfx_decode_rgb(context, s,
+					sizes[i][0], test_quantization_values,
+					sizes[i][1], test_quantization_values,
+					sizes[i][2], test_quantization_values,
+					decode_buffer);
+				dec_cycles[TEST_RFX_STAGE_TOTAL] += test_rfx_cycles() - start;
+			}
+		}
+
+		test_rfx_print_cycles(names[p], "encode", enc_cycles, tiles);
+		test_rfx_print_cycles(names[p], "decode", dec_cycles, tiles);
+
+		/**
+		 * The SSE2 color conversion rounds differently from the C one,
+		 * compare the remaining stages with the C conversion on all paths.
+		 */
+
+		context->encode_rgb_to_ycbcr = rfx_encode_rgb_to_ycbcr;
+		context->decode_ycbcr_to_rgb = rfx_decode_ycbcr_to_rgb;
+
+		stream_set_pos(s, 0);
+
+		for (i = 0; i < TEST_RFX_TILES; i++)
+		{
+			rfx_encode_rgb(context, &rgb[i * 4096 * 3], 64, 64, 64 * 3,
+				test_quantization_values, test_quantization_values, test_quantization_values,
+				s, &sizes[i][0], &sizes[i][1], &sizes[i][2]);
+		}
+
+		encoded_size[p] = size = stream_get_pos(s);
+		encoded[p] = (BYTE*) malloc(size);
+		memcpy(encoded[p], stream_get_head(s), size);
+
+		stream_set_pos(s, 0);
+
+		for (i = 0; i < TEST_RFX_TILES; i++)
+		{
+			rfx_decode_rgb(context, s,
+				sizes[i][0], test_quantization_values,
+				sizes[i][1], test_quantization_values,
+				sizes[i][2], test_quantization_values,
+				&decoded[p][i * 4096 * 3]);
+		}
+
+		stream_free(s);
+		rfx_context_free(context);
+	}
+
+	printf("\n");
+
+	/* all paths have to produce the same bitstream and pixels */
+	for (p = 1; p < 3; p++)
+	{
+		if (encoded[p] == NULL)
+			continue;
+
+		CU_ASSERT(encoded_size[p] == encoded_size[0]);
+		CU_ASSERT(memcmp(encoded[p], encoded[0], MIN(encoded_size[p], encoded_size[0])) == 0);
+		CU_ASSERT(memcmp(decoded[p], decoded[0], TEST_RFX_TILES * 4096 * 3) == 0);
+	}
+
+	for (p = 0; p < 3; p++)
+	{
+		free(encoded[p]);
+		free(decoded[p]);
+	}
+
+	free(rgb);
+}
+
+#define TEST_RATE_WIDTH			256
+#define TEST_RATE_HEIGHT		192
+#define TEST_RATE_FRAMES		8
+
+/* Flat areas, gradients, text-like stripes and noise, moving with the frame */
+static void test_rate_frame(BYTE* rgb, int frame)
+{
+	int x, y;
+	BYTE* p = rgb;
+
+	srand(frame);
+
+	for (y = 0; y < TEST_RATE_HEIGHT; y++)
+	{
+		for (x = 0; x < TEST_RATE_WIDTH; x++)
+		{
+			if (y < 64)
+			{
+				p[0] = 0xF0;
+				p[1] = 0xF0;
+				p[2] = (x + frame * 8 < 128) ? 0xF0 : 0x30;
+			}
+			else if (y < 128)
+			{
+				p[0] = x + frame;
+				p[1] = y * 2;
+				p[2] = (x + y) / 2;
+			}
+			else if (x < 128)
+			{
+				p[0] = p[1] = p[2] = (((x + frame) / 3 + y / 7) & 1) ? 0x10 : 0xE0;
+			}
+			else
+			{
+				p[0] = 0x80 + (rand() % 64);
+				p[1] = 0x40 + (rand() % 64);
+				p[2] = 0x20 + (rand() % 32);
+			}
+
+			p += 3;
+		}
+	}
+}
+
+/**
+ * Encode a frame, decode it again and return the size of the frame data
+ * along with the sum of the squared errors of the decoded samples.
+ */
+
+static int test_rate_encode(RFX_CONTEXT* encoder, RFX_CONTEXT* decoder, BYTE* rgb, UINT64* error)
+{
+	int i, x, y;
+	int size;
+	int pos;
+	int diff;
+	STREAM* s;
+	BYTE* src;
+	BYTE* dst;
+	RFX_TILE* tile;
+	RFX_MESSAGE* message;
+	RFX_RECT rect = { 0, 0, TEST_RATE_WIDTH, TEST_RATE_HEIGHT };
+
+	s = stream_new(1024);
+	rfx_compose_message_header(encoder, s);
+
+	pos = stream_get_pos(s);
+	rfx_compose_message(encoder, s, &rect, 1, rgb, TEST_RATE_WIDTH, TEST_RATE_HEIGHT, TEST_RATE_WIDTH * 3);
+	size = stream_get_pos(s) - pos;
+
+	stream_seal(s);
+	message = rfx_process_message(decoder, stream_get_head(s), stream_get_length(s));
+
+	*error = 0;
+
+	for (i = 0; i < message->num_tiles; i++)
+	{
+		tile = message->tiles[i];
+
+		for (y = 0; y < 64; y++)
+		{
+			src = &rgb[((tile->y + y) * TEST_RATE_WIDTH + tile->x) * 3];
+			dst = &tile->data[y * 64 * 3];
+
+			for (x = 0; x < 64 * 3; x++)
+			{
+				diff = src[x] - dst[x];
+				*error += diff * diff;
+			}
+		}
+	}
+
+	rfx_message_free(decoder, message);
+	stream_free(s);
+
+	return size;
+}
+
+/**
+ * Frames have to stay within the budget, with a 5% tolerance, without
+ * leaving most of it unused. At half the size of the fixed quantization
+ * the decoded frames have to keep a PSNR of 26 dB, a mean squared error
+ * of 163 for 8-bit samples.
+ */
+
+void test_rate_control(void)
+{
+	int i, k;
+	int size;
+	int full_size;
+	int total_size;
+	UINT32 budget;
+	UINT64 error;
+	UINT64 total_error;
+	BYTE* rgb;
+	RFX_CONTEXT* encoder;
+	RFX_CONTEXT* decoder;
+	int samples = TEST_RATE_WIDTH * TEST_RATE_HEIGHT * 3;
+
+	rgb = (BYTE*) malloc(samples);
+
+	encoder = rfx_context_new();
+	encoder->mode = RLGR3;
+	encoder->width = TEST_RATE_WIDTH;
+	encoder->height = TEST_RATE_HEIGHT;
+	rfx_context_set_pixel_format(encoder, RDP_PIXEL_FORMAT_R8G8B8);
+
+	decoder = rfx_context_new();
+	rfx_context_set_pixel_format(decoder, RDP_PIXEL_FORMAT_R8G8B8);
+
+	test_rate_frame(rgb, 0);
+	full_size = test_rate_encode(encoder, decoder, rgb, &error);
+	printf("\nfixed: %d bytes mse %d", full_size, (int) (error / samples));
+
+	for (k = 2; k <= 8; k *= 2)
+	{
+		budget = full_size / k;
+		rfx_context_set_frame_budget(encoder, budget);
+
+		total_size = 0;
+		total_error = 0;
+
+		for (i = 0; i < TEST_RATE_FRAMES; i++)
+		{
+			test_rate_frame(rgb, i);
+			size = test_rate_encode(encoder, decoder, rgb, &error);
+
+			CU_ASSERT(size <= budget + budget / 20);
+			CU_ASSERT(size >= budget / 2);
+
+			if (k == 2)
+				CU_ASSERT(error <= (UINT64) 163 * samples);
+
+			total_size += size;
+			total_error += error;
+		}
+
+		printf("\nbudget %d: %d bytes mse %d", budget, total_size / TEST_RATE_FRAMES,
+			(int) (total_error / TEST_RATE_FRAMES / samples));
+	}
+
+	printf("\n");
+
+	rfx_context_free(encoder);
+	rfx_context_free(decoder);
+	free(rgb);
+}
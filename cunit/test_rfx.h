@@ -26,9 +26,12 @@ int add_rfx_suite(void);
 void test_bitstream(void);
 void test_bitstream_enc(void);
 void test_rlgr(void);
+void test_rlgr_fuzz(void);
 void test_differential(void);
 void test_quantization(void);
 void test_dwt(void);
 void test_decode(void);
 void test_encode(void);
 void test_message(void);
+void test_pipeline_benchmark(void);
+void test_rate_control(void);
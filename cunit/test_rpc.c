@@ -0,0 +1,486 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * RPC over HTTP Unit Tests
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "rpc.h"
+
+#include <freerdp/freerdp.h>
+#include <freerdp/settings.h>
+#include <freerdp/utils/stream.h>
+#include <freerdp/utils/memory.h>
+
+#include "test_rpc.h"
+
+/**
+ * The gateway is replaced by an in-process endpoint: the OUT channel replays
+ * recorded response fragments in reads of a scripted size, a size of 0
+ * standing for a read that would block, and the IN channel records requests.
+ */
+
+static rdpSettings* settings;
+static rdpTransport* transport;
+static SecurityFunctionTable table;
+
+static STREAM* replay;
+static int replay_length;
+static int* replay_chunks;
+static int replay_chunk_count;
+static int replay_chunk_index;
+static int replay_reads;
+
+static STREAM* requests;
+static int request_count;
+
+static SECURITY_STATUS SEC_ENTRY test_rpc_query_context_attributes(PCtxtHandle phContext, ULONG ulAttribute, void* pBuffer)
+{
+	SecPkgContext_Sizes* ContextSizes = (SecPkgContext_Sizes*) pBuffer;
+
+	ContextSizes->cbMaxToken = 2010;
+	ContextSizes->cbMaxSignature = 16;
+	ContextSizes->cbBlockSize = 0;
+	ContextSizes->cbSecurityTrailer = 16;
+
+	return SEC_E_OK;
+}
+
+static SECURITY_STATUS SEC_ENTRY test_rpc_encrypt_message(PCtxtHandle phContext, ULONG fQOP, PSecBufferDesc pMessage, ULONG MessageSeqNo)
+{
+	BYTE* signature = (BYTE*) pMessage->pBuffers[1].pvBuffer;
+
+	memset(signature, 0, pMessage->pBuffers[1].cbBuffer);
+	signature[0] = 1; /* version */
+	memcpy(&signature[12], &MessageSeqNo, 4);
+
+	return SEC_E_OK;
+}
+
+static int test_rpc_channel_read(rdpRpc* rpc, BYTE* data, int length)
+{
+	int chunk;
+
+	replay_reads++;
+	chunk = length;
+
+	if (replay_chunk_count > 0)
+		chunk = replay_chunks[replay_chunk_index++ % replay_chunk_count];
+
+	chunk = MIN(chunk, length);
+	chunk = MIN(chunk, replay_length - (int) stream_get_pos(replay));
+
+	stream_read(replay, data, chunk);
+
+	return chunk;
+}
+
+static int test_rpc_channel_write(rdpRpc* rpc, BYTE* data, int length)
+{
+	if (data[2] != PTYPE_RTS)
+	{
+		stream_check_size(requests, length);
+		stream_write(requests, data, length);
+		request_count++;
+	}
+
+	return length;
+}
+
+int init_rpc_suite(void)
+{
+	settings = settings_new(NULL);
+	transport = xnew(rdpTransport);
+	transport->settings = settings;
+
+	table.QueryContextAttributes = test_rpc_query_context_attributes;
+	table.EncryptMessage = test_rpc_encrypt_message;
+
+	replay = stream_new(0x1000);
+	requests = stream_new(0x1000);
+
+	return 0;
+}
+
+int clean_rpc_suite(void)
+{
+	stream_free(replay);
+	stream_free(requests);
+	settings_free(settings);
+	free(transport);
+	return 0;
+}
+
+int add_rpc_suite(void)
+{
+	add_test_suite(rpc);
+
+	add_test_function(rpc_coalesced_fragments);
+	add_test_function(rpc_split_fragments);
+	add_test_function(rpc_short_reads);
+	add_test_function(rpc_multi_fragment_response);
+	add_test_function(rpc_pipelined_writes);
+	add_test_function(rpc_invalid_fragment);
+	add_test_function(rpc_benchmark);
+
+	return 0;
+}
+
+static rdpRpc* test_rpc_new(int* chunks, int count)
+{
+	rdpRpc* rpc;
+
+	rpc = rpc_new(transport);
+	rpc->ntlm->table = &table;
+	rpc->ChannelRead = test_rpc_channel_read;
+	rpc->ChannelWrite = test_rpc_channel_write;
+
+	replay_chunks = chunks;
+	replay_chunk_count = count;
+	replay_chunk_index = 0;
+	replay_reads = 0;
+	replay_length = stream_get_pos(replay);
+	stream_set_pos(replay, 0);
+
+	stream_set_pos(requests, 0);
+	request_count = 0;
+
+	return rpc;
+}
+
+/**
+ * Append a response fragment as the gateway sends it: header, stub data,
+ * auth padding, sec_trailer and a 16 byte auth_value.
+ */
+
+static void test_rpc_response(UINT32 call_id, BYTE flags, UINT32 alloc_hint, BYTE* stub, int length)
+{
+	int auth_pad_length;
+
+	auth_pad_length = (16 - ((24 + length + 8 + 16) % 16)) % 16;
+
+	stream_check_size(replay, 24 + length + auth_pad_length + 8 + 16);
+
+	stream_write_BYTE(replay, 5); /* rpc_vers */
+	stream_write_BYTE(replay, 0); /* rpc_vers_minor */
+	stream_write_BYTE(replay, PTYPE_RESPONSE); /* PTYPE */
+	stream_write_BYTE(replay, flags); /* pfc_flags */
+	stream_write_UINT32(replay, 0x00000010); /* packed_drep */
+	stream_write_UINT16(replay, 24 + length + auth_pad_length + 8 + 16); /* frag_length */
+	stream_write_UINT16(replay, 16); /* auth_length */
+	stream_write_UINT32(replay, call_id); /* call_id */
+	stream_write_UINT32(replay, alloc_hint); /* alloc_hint */
+	stream_write_UINT16(replay, 0); /* p_cont_id */
+	stream_write_BYTE(replay, 0); /* cancel_count */
+	stream_write_BYTE(replay, 0); /* reserved */
+	stream_write(replay, stub, length);
+	stream_write_zero(replay, auth_pad_length);
+	stream_write_BYTE(replay, 0x0A); /* auth_type */
+	stream_write_BYTE(replay, 0x05); /* auth_level */
+	stream_write_BYTE(replay, auth_pad_length); /* auth_pad_length */
+	stream_write_BYTE(replay, 0); /* auth_reserved */
+	stream_write_UINT32(replay, 0); /* auth_context_id */
+	stream_write_zero(replay, 16); /* auth_value */
+}
+
+static void test_rpc_fill(BYTE* data, int length, int seed)
+{
+	int i;
+
+	for (i = 0; i < length; i++)
+		data[i] = (BYTE) (seed + i * 7 + (i >> 5));
+}
+
+/**
+ * Record the receive pipe of a session: pipe data fragments of varying
+ * sizes, interleaved with the 4 byte responses to TsProxySendToServer.
+ */
+
+static int test_rpc_record_pipe(BYTE* expected, int count)
+{
+	int i;
+	int length;
+	int total = 0;
+	BYTE hresult[4] = { 0 };
+
+	stream_set_pos(replay, 0);
+
+	for (i = 0; i < count; i++)
+	{
+		length = 1 + ((i * 733) % 1500);
+		test_rpc_fill(&expected[total], length, i);
+		test_rpc_response(1, PFC_FIRST_FRAG | PFC_LAST_FRAG, length, &expected[total], length);
+		total += length;
+
+		if (i % 3 == 0)
+			test_rpc_response(2 + i, PFC_FIRST_FRAG | PFC_LAST_FRAG, 4, hresult, 4);
+	}
+
+	return total;
+}
+
+static int test_rpc_read_all(rdpRpc* rpc, BYTE* data, int total, int length)
+{
+	int status;
+	int read = 0;
+	int idle = 0;
+
+	while ((read < total) && (idle < 1000))
+	{
+		status = rpc_read(rpc, &data[read], MIN(length, total - read));
+
+		if (status < 0)
+			return status;
+
+		idle = (status == 0) ? idle + 1 : 0;
+		read += status;
+	}
+
+	return read;
+}
+
+void test_rpc_coalesced_fragments(void)
+{
+	int total;
+	rdpRpc* rpc;
+	BYTE* data;
+	BYTE* expected;
+
+	data = (BYTE*) malloc(64 * 1500);
+	expected = (BYTE*) malloc(64 * 1500);
+
+	total = test_rpc_record_pipe(expected, 64);
+	rpc = test_rpc_new(NULL, 0);
+	rpc->pipe_call_id = 1;
+
+	CU_ASSERT(test_rpc_read_all(rpc, data, total, 0x4000) == total);
+	CU_ASSERT(memcmp(data, expected, total) == 0);
+
+	/* every read of the channel returned several fragments */
+	CU_ASSERT(replay_reads < 16);
+
+	rpc_free(rpc);
+	free(expected);
+	free(data);
+}
+
+void test_rpc_split_fragments(void)
+{
+	int total;
+	rdpRpc* rpc;
+	BYTE* data;
+	BYTE* expected;
+	int chunks[] = { 1, 7, 0, 16, 3, 0, 0, 24, 100, 5, 1400, 9, 0, 33 };
+
+	data = (BYTE*) malloc(64 * 1500);
+	expected = (BYTE*) malloc(64 * 1500);
+
+	total = test_rpc_record_pipe(expected, 64);
+	rpc = test_rpc_new(chunks, sizeof(chunks) / sizeof(int));
+	rpc->pipe_call_id = 1;
+
+	CU_ASSERT(test_rpc_read_all(rpc, data, total, 0x4000) == total);
+	CU_ASSERT(memcmp(data, expected, total) == 0);
+
+	rpc_free(rpc);
+	free(expected);
+	free(data);
+}
+
+void test_rpc_short_reads(void)
+{
+	int total;
+	rdpRpc* rpc;
+	BYTE* data;
+	BYTE* expected;
+	int chunks[] = { 4096, 11, 0 };
+
+	data = (BYTE*) malloc(64 * 1500);
+	expected = (BYTE*) malloc(64 * 1500);
+
+	total = test_rpc_record_pipe(expected, 64);
+	rpc = test_rpc_new(chunks, sizeof(chunks) / sizeof(int));
+	rpc->pipe_call_id = 1;
+
+	/* stub data that does not fit the buffer is handed out by later reads */
+	CU_ASSERT(test_rpc_read_all(rpc, data, total, 10) == total);
+	CU_ASSERT(memcmp(data, expected, total) == 0);
+	CU_ASSERT(rpc->StubLength == 0);
+
+	rpc_free(rpc);
+	free(expected);
+	free(data);
+}
+
+void test_rpc_multi_fragment_response(void)
+{
+	rdpRpc* rpc;
+	BYTE data[3000];
+	BYTE expected[3000];
+
+	test_rpc_fill(expected, sizeof(expected), 3);
+
+	stream_set_pos(replay, 0);
+	test_rpc_response(5, PFC_FIRST_FRAG, 3000, expected, 1000);
+	test_rpc_response(5, 0, 2000, &expected[1000], 1000);
+	test_rpc_response(5, PFC_LAST_FRAG, 1000, &expected[2000], 1000);
+
+	rpc = test_rpc_new(NULL, 0);
+	rpc->OutstandingCalls = 1;
+
+	/* a single read returns the whole response */
+	CU_ASSERT(rpc_read(rpc, data, sizeof(data)) == sizeof(data));
+	CU_ASSERT(memcmp(data, expected, sizeof(expected)) == 0);
+	CU_ASSERT(rpc->OutstandingCalls == 0);
+
+	rpc_free(rpc);
+}
+
+void test_rpc_pipelined_writes(void)
+{
+	int i;
+	BYTE* pdu;
+	rdpRpc* rpc;
+	BYTE data[64];
+	BYTE stub[300];
+	BYTE hresult[4] = { 0 };
+	UINT16 frag_length;
+
+	test_rpc_fill(data, sizeof(data), 9);
+	test_rpc_fill(stub, sizeof(stub), 1);
+
+	stream_set_pos(replay, 0);
+	rpc = test_rpc_new(NULL, 0);
+
+	CU_ASSERT(rpc_tsg_write(rpc, stub, 24, 8) == 24);
+
+	/* requests go out back to back, none waits for its response */
+	for (i = 0; i < 8; i++)
+		CU_ASSERT(rpc_tsg_write(rpc, stub, 37 * (i + 1), 9) == 37 * (i + 1));
+
+	CU_ASSERT(request_count == 9);
+	CU_ASSERT(rpc->OutstandingCalls == 8);
+
+	pdu = requests->data;
+
+	for (i = 0; i < 9; i++)
+	{
+		frag_length = *(UINT16*)(pdu + 8);
+
+		CU_ASSERT(pdu[2] == PTYPE_REQUEST);
+		CU_ASSERT(frag_length % 16 == 0);
+		CU_ASSERT(*(UINT32*)(pdu + 12) == (UINT32) (i + 1)); /* call_id */
+		CU_ASSERT(*(UINT16*)(pdu + 22) == ((i == 0) ? 8 : 9)); /* opnum */
+		CU_ASSERT(memcmp(pdu + 24, stub, *(UINT32*)(pdu + 16)) == 0);
+		CU_ASSERT(*(UINT32*)(pdu + frag_length - 4) == (UINT32) i); /* signature sequence number */
+
+		pdu += frag_length;
+	}
+
+	CU_ASSERT(pdu == requests->p);
+
+	/* the responses arrive in one burst, interleaved with pipe data */
+	stream_set_pos(replay, 0);
+
+	for (i = 0; i < 8; i++)
+	{
+		test_rpc_response(2 + i, PFC_FIRST_FRAG | PFC_LAST_FRAG, 4, hresult, 4);
+
+		if (i % 2 == 0)
+			test_rpc_response(1, PFC_FIRST_FRAG | PFC_LAST_FRAG, 16, &data[i * 8], 16);
+	}
+
+	replay_length = stream_get_pos(replay);
+	stream_set_pos(replay, 0);
+
+	CU_ASSERT(test_rpc_read_all(rpc, stub, 64, 0x1000) == 64);
+	CU_ASSERT(memcmp(stub, data, 64) == 0);
+
+	rpc_read(rpc, stub, sizeof(stub));
+	CU_ASSERT(rpc->OutstandingCalls == 0);
+
+	rpc_free(rpc);
+}
+
+void test_rpc_invalid_fragment(void)
+{
+	rdpRpc* rpc;
+	BYTE data[256];
+
+	stream_set_pos(replay, 0);
+	stream_write_zero(replay, 16);
+	*(UINT16*)(replay->data + 8) = 8; /* frag_length */
+
+	rpc = test_rpc_new(NULL, 0);
+	CU_ASSERT(rpc_read(rpc, data, sizeof(data)) < 0);
+	rpc_free(rpc);
+
+	/* auth_length larger than the fragment */
+	stream_set_pos(replay, 0);
+	test_rpc_response(1, PFC_FIRST_FRAG | PFC_LAST_FRAG, 16, data, 16);
+	*(UINT16*)(replay->data + 10) = 200; /* auth_length */
+
+	rpc = test_rpc_new(NULL, 0);
+	CU_ASSERT(rpc_read(rpc, data, sizeof(data)) < 0);
+	rpc_free(rpc);
+}
+
+static long test_rpc_elapsed(struct timeval* start_time)
+{
+	struct timeval end_time;
+
+	gettimeofday(&end_time, NULL);
+
+	return ((end_time.tv_sec - start_time->tv_sec) * 1000000) + (end_time.tv_usec - start_time->tv_usec);
+}
+
+void test_rpc_benchmark(void)
+{
+	int i;
+	int total;
+	long elapsed;
+	rdpRpc* rpc;
+	BYTE* data;
+	BYTE* expected;
+	struct timeval start_time;
+
+	data = (BYTE*) malloc(64 * 1500);
+	expected = (BYTE*) malloc(64 * 1500);
+
+	total = test_rpc_record_pipe(expected, 64);
+
+	gettimeofday(&start_time, NULL);
+
+	for (i = 0; i < 200; i++)
+	{
+		rpc = test_rpc_new(NULL, 0);
+		rpc->pipe_call_id = 1;
+		test_rpc_read_all(rpc, data, total, 0x4000);
+		rpc_free(rpc);
+	}
+
+	elapsed = test_rpc_elapsed(&start_time);
+
+	printf("\nreceive pipe: %d bytes in %ld us, %d MB/s", total * 200, elapsed,
+			(int) ((total * 200.0) / (elapsed ? elapsed : 1)));
+
+	CU_ASSERT(memcmp(data, expected, total) == 0);
+
+	free(expected);
+	free(data);
+}
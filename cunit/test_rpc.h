@@ -0,0 +1,30 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * RPC over HTTP Unit Tests
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "test_freerdp.h"
+
+int init_rpc_suite(void);
+int clean_rpc_suite(void);
+int add_rpc_suite(void);
+
+void test_rpc_coalesced_fragments(void);
+void test_rpc_split_fragments(void);
+void test_rpc_short_reads(void);
+void test_rpc_multi_fragment_response(void);
+void test_rpc_pipelined_writes(void);
+void test_rpc_invalid_fragment(void);
+void test_rpc_benchmark(void);
@@ -0,0 +1,352 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Standard RDP Security Unit Tests
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "rdp.h"
+#include "security.h"
+
+#include <freerdp/freerdp.h>
+#include <freerdp/crypto/crypto.h>
+
+#include "test_security.h"
+
+static rdpRdp* rdp;
+static rdpRdp* ref;
+
+int init_security_suite(void)
+{
+	rdp = rdp_new(NULL);
+	ref = rdp_new(NULL);
+	return 0;
+}
+
+int clean_security_suite(void)
+{
+	rdp_free(rdp);
+	rdp_free(ref);
+	return 0;
+}
+
+int add_security_suite(void)
+{
+	add_test_suite(security);
+
+	add_test_function(security_mac_signature);
+	add_test_function(security_encrypt_mac);
+	add_test_function(security_decrypt_mac);
+	add_test_function(security_benchmark);
+
+	return 0;
+}
+
+/**
+ * Set up the keys of a connection the way security_establish_keys leaves
+ * them, with fixed keys instead of ones derived from the client random.
+ */
+
+static void test_security_keys(rdpRdp* rdp, int key_len, int use_count)
+{
+	int i;
+
+	for (i = 0; i < 16; i++)
+	{
+		rdp->sign_key[i] = 0xA0 + i;
+		rdp->encrypt_key[i] = 0x30 + i * 3;
+		rdp->decrypt_key[i] = 0x30 + i * 3;
+	}
+
+	rdp->rc4_key_len = key_len;
+	memcpy(rdp->encrypt_update_key, rdp->encrypt_key, 16);
+	memcpy(rdp->decrypt_update_key, rdp->decrypt_key, 16);
+
+	crypto_rc4_free(rdp->rc4_encrypt_key);
+	crypto_rc4_free(rdp->rc4_decrypt_key);
+	rdp->rc4_encrypt_key = crypto_rc4_init(rdp->encrypt_key, key_len);
+	rdp->rc4_decrypt_key = crypto_rc4_init(rdp->decrypt_key, key_len);
+
+	rdp->encrypt_use_count = use_count;
+	rdp->encrypt_checksum_use_count = use_count;
+	rdp->decrypt_use_count = use_count;
+	rdp->decrypt_checksum_use_count = use_count;
+
+	security_mac_init(rdp);
+}
+
+static void test_security_data(BYTE* data, int length, int seed)
+{
+	int i;
+
+	for (i = 0; i < length; i++)
+		data[i] = (BYTE) (i * 7 + 3 + seed);
+}
+
+/* Signatures computed with the MAC as implemented before the cached states */
+
+struct _TEST_SECURITY_KAT
+{
+	int key_len;
+	int length;
+	BYTE mac[8];
+	BYTE salted_mac[8];
+};
+typedef struct _TEST_SECURITY_KAT TEST_SECURITY_KAT;
+
+static const TEST_SECURITY_KAT test_security_kats[] =
+{
+	{ 16, 0, "\xfa\x7c\xd2\x45\xd7\x6e\xe0\x81", "\xe7\xfd\x83\xb7\x7f\x1a\xe1\x39" },
+	{ 16, 1, "\xe2\x1a\x6e\xa5\xf3\xd8\x95\xae", "\xc0\x4c\x9f\x02\x4c\xe4\x85\x60" },
+	{ 16, 64, "\xc6\x49\xac\x0a\x2c\x55\x3c\xd2", "\x7c\x54\x4d\xbc\x65\xe9\x65\xb8" },
+	{ 16, 1000, "\x89\x16\xe7\x43\xd2\x60\xfb\x26", "\x6f\x0e\xfe\xb8\x97\xcd\x3e\x32" },
+	{ 8, 0, "\x76\x7b\x08\xda\x84\xfa\x65\x42", "\x18\x11\xfc\x96\xa8\x4c\x52\x2d" },
+	{ 8, 1, "\xf9\x56\xeb\xdc\x3b\xf1\x83\x0a", "\xfa\x40\xe9\xe9\x71\x7d\x00\x5e" },
+	{ 8, 64, "\x92\xb6\xdd\xa2\x73\x8b\x9b\x17", "\xff\x43\x85\x26\xed\xa5\x7d\x01" },
+	{ 8, 1000, "\x8f\xa4\x8d\x0c\x46\x12\xac\x0d", "\x0d\xf4\x96\xcc\xdf\x9f\x18\x78" }
+};
+
+void test_security_mac_signature(void)
+{
+	int i;
+	BYTE mac[8];
+	BYTE data[1000];
+	const TEST_SECURITY_KAT* kat;
+
+	test_security_data(data, sizeof(data), 0);
+
+	for (i = 0; i < sizeof(test_security_kats) / sizeof(test_security_kats[0]); i++)
+	{
+		kat = &test_security_kats[i];
+		test_security_keys(rdp, kat->key_len, 5);
+
+		security_mac_signature(rdp, data, kat->length, mac);
+		CU_ASSERT(memcmp(mac, kat->mac, 8) == 0);
+
+		security_salted_mac_signature(rdp, data, kat->length, TRUE, mac);
+		CU_ASSERT(memcmp(mac, kat->salted_mac, 8) == 0);
+
+		/* the decrypt side uses the count before the PDU was decrypted */
+		rdp->decrypt_checksum_use_count = 6;
+		security_salted_mac_signature(rdp, data, kat->length, FALSE, mac);
+		CU_ASSERT(memcmp(mac, kat->salted_mac, 8) == 0);
+	}
+}
+
+#define TEST_SECURITY_PDUS		16
+
+static const int test_security_lengths[TEST_SECURITY_PDUS] =
+{
+	0, 1, 63, 64, 65, 200, 1400, 2047, 2048, 2049, 4000, 4096, 8191, 12000, 16000, 16383
+};
+
+/**
+ * A run of PDUs crossing the 4096 PDU key update, signed and encrypted in
+ * one pass on one connection and in separate passes on the other.
+ */
+
+void test_security_encrypt_mac(void)
+{
+	int i, k;
+	int length;
+	BYTE mac[8];
+	BYTE ref_mac[8];
+	BYTE data[16383];
+	BYTE ref_data[16383];
+	BOOL salted;
+
+	for (k = 0; k < 4; k++)
+	{
+		salted = (k & 1) ? TRUE : FALSE;
+		test_security_keys(rdp, (k & 2) ? 8 : 16, 4090);
+		test_security_keys(ref, (k & 2) ? 8 : 16, 4090);
+
+		for (i = 0; i < TEST_SECURITY_PDUS; i++)
+		{
+			length = test_security_lengths[i];
+			test_security_data(data, length, i);
+			test_security_data(ref_data, length, i);
+
+			if (salted)
+				security_salted_mac_signature(ref, ref_data, length, TRUE, ref_mac);
+			else
+				security_mac_signature(ref, ref_data, length, ref_mac);
+
+			security_encrypt(ref_data, length, ref);
+			security_encrypt_mac(data, length, salted, mac, rdp);
+
+			CU_ASSERT(memcmp(mac, ref_mac, 8) == 0);
+			CU_ASSERT(memcmp(data, ref_data, length) == 0);
+		}
+
+		CU_ASSERT(rdp->encrypt_use_count == ref->encrypt_use_count);
+		CU_ASSERT(rdp->encrypt_checksum_use_count == ref->encrypt_checksum_use_count);
+		CU_ASSERT(memcmp(rdp->encrypt_key, ref->encrypt_key, 16) == 0);
+	}
+}
+
+void test_security_decrypt_mac(void)
+{
+	int i, k;
+	int length;
+	BYTE mac[8];
+	BYTE ref_mac[8];
+	BYTE data[16383];
+	BYTE ref_data[16383];
+	BYTE plain[16383];
+	BOOL salted;
+
+	for (k = 0; k < 4; k++)
+	{
+		salted = (k & 1) ? TRUE : FALSE;
+		test_security_keys(rdp, (k & 2) ? 8 : 16, 4090);
+		test_security_keys(ref, (k & 2) ? 8 : 16, 4090);
+
+		for (i = 0; i < TEST_SECURITY_PDUS; i++)
+		{
+			length = test_security_lengths[i];
+			test_security_data(plain, length, i);
+			memcpy(data, plain, length);
+
+			/* the encrypt and decrypt keys are the same, encrypt with the reference */
+			security_encrypt(data, length, ref);
+			memcpy(ref_data, data, length);
+
+			security_decrypt(ref_data, length, ref);
+
+			if (salted)
+				security_salted_mac_signature(ref, ref_data, length, FALSE, ref_mac);
+			else
+				security_mac_signature(ref, ref_data, length, ref_mac);
+
+			security_decrypt_mac(data, length, salted, mac, rdp);
+
+			CU_ASSERT(memcmp(mac, ref_mac, 8) == 0);
+			CU_ASSERT(memcmp(data, plain, length) == 0);
+		}
+
+		CU_ASSERT(rdp->decrypt_use_count == ref->decrypt_use_count);
+		CU_ASSERT(rdp->decrypt_checksum_use_count == ref->decrypt_checksum_use_count);
+	}
+}
+
+/**
+ * Sign and encrypt the way the PDUs were before the cached states: both
+ * hashes allocated and keyed for each PDU, the data read once for the MAC
+ * and once more by RC4.
+ */
+
+static void test_security_encrypt_separate(BYTE* data, int length, BYTE* output, rdpRdp* rdp)
+{
+	CryptoMd5 md5;
+	CryptoSha1 sha1;
+	BYTE pad1[40];
+	BYTE pad2[48];
+	BYTE length_le[4];
+	BYTE md5_digest[CRYPTO_MD5_DIGEST_LENGTH];
+	BYTE sha1_digest[CRYPTO_SHA1_DIGEST_LENGTH];
+
+	length_le[0] = length & 0xFF;
+	length_le[1] = (length >> 8) & 0xFF;
+	length_le[2] = length_le[3] = 0;
+
+	memset(pad1, 0x36, sizeof(pad1));
+	memset(pad2, 0x5C, sizeof(pad2));
+
+	sha1 = crypto_sha1_init();
+	crypto_sha1_update(sha1, rdp->sign_key, rdp->rc4_key_len);
+	crypto_sha1_update(sha1, pad1, sizeof(pad1));
+	crypto_sha1_update(sha1, length_le, sizeof(length_le));
+	crypto_sha1_update(sha1, data, length);
+	crypto_sha1_final(sha1, sha1_digest);
+
+	md5 = crypto_md5_init();
+	crypto_md5_update(md5, rdp->sign_key, rdp->rc4_key_len);
+	crypto_md5_update(md5, pad2, sizeof(pad2));
+	crypto_md5_update(md5, sha1_digest, sizeof(sha1_digest));
+	crypto_md5_final(md5, md5_digest);
+
+	memcpy(output, md5_digest, 8);
+
+	security_encrypt(data, length, rdp);
+}
+
+static long test_security_elapsed(struct timeval* start_time)
+{
+	struct timeval end_time;
+
+	gettimeofday(&end_time, NULL);
+
+	return ((end_time.tv_sec - start_time->tv_sec) * 1000000) + (end_time.tv_usec - start_time->tv_usec);
+}
+
+#define TEST_BENCHMARK_SIZE		(16 * 1024 * 1024)
+
+void test_security_benchmark(void)
+{
+	int i, k;
+	int length;
+	int count;
+	long separate;
+	long fused;
+	BYTE mac[8];
+	BYTE ref_mac[8];
+	BYTE* data;
+	struct timeval start_time;
+	const int lengths[] = { 64, 512, 1400, 4096, 16383 };
+
+	data = (BYTE*) malloc(16383);
+	test_security_data(data, 16383, 0);
+
+	test_security_keys(rdp, 16, 0);
+	test_security_keys(ref, 16, 0);
+
+	/* the separate passes compute the same signatures */
+	test_security_encrypt_separate(data, 1400, ref_mac, ref);
+	test_security_data(data, 1400, 0);
+	security_encrypt_mac(data, 1400, FALSE, mac, rdp);
+	CU_ASSERT(memcmp(mac, ref_mac, 8) == 0);
+
+	for (k = 0; k < sizeof(lengths) / sizeof(lengths[0]); k++)
+	{
+		length = lengths[k];
+		count = TEST_BENCHMARK_SIZE / length;
+
+		gettimeofday(&start_time, NULL);
+
+		for (i = 0; i < count; i++)
+			test_security_encrypt_separate(data, length, mac, ref);
+
+		separate = test_security_elapsed(&start_time);
+
+		gettimeofday(&start_time, NULL);
+
+		for (i = 0; i < count; i++)
+			security_encrypt_mac(data, length, FALSE, mac, rdp);
+
+		fused = test_security_elapsed(&start_time);
+
+		printf("\n%5d byte PDUs: separate %4d MB/s %4d ns/PDU, fused %4d MB/s %4d ns/PDU", length,
+			(int) ((INT64) count * length / MAX(separate, 1)), (int) ((INT64) separate * 1000 / count),
+			(int) ((INT64) count * length / MAX(fused, 1)), (int) ((INT64) fused * 1000 / count));
+	}
+
+	printf("\n");
+
+	free(data);
+}
@@ -0,0 +1,393 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * RAIL Window List Unit Tests
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <freerdp/freerdp.h>
+#include <freerdp/rail/rail.h>
+#include <freerdp/rail/window_list.h>
+
+#include "test_window_list.h"
+
+static rdpRail* rail;
+static rdpSettings* settings;
+
+static int windows_created;
+static int windows_destroyed;
+
+/* the client window of a RAIL window, as its extraId */
+#define TEST_EXTRA_ID(_windowId)	((void*) (size_t) (0x4000000 + ((_windowId) * 8)))
+
+static void test_rail_CreateWindow(rdpRail* rail, rdpWindow* window)
+{
+	windows_created++;
+	window->extraId = TEST_EXTRA_ID(window->windowId);
+}
+
+static void test_rail_DestroyWindow(rdpRail* rail, rdpWindow* window)
+{
+	windows_destroyed++;
+	free(window->title);
+}
+
+int init_window_list_suite(void)
+{
+	settings = settings_new(NULL);
+	settings->num_icon_caches = 3;
+	settings->num_icon_cache_entries = 12;
+
+	rail = rail_new(settings);
+	rail->rail_CreateWindow = test_rail_CreateWindow;
+	rail->rail_DestroyWindow = test_rail_DestroyWindow;
+
+	return 0;
+}
+
+int clean_window_list_suite(void)
+{
+	rail_free(rail);
+	settings_free(settings);
+	return 0;
+}
+
+int add_window_list_suite(void)
+{
+	add_test_suite(window_list);
+
+	add_test_function(window_list_lookup);
+	add_test_function(window_list_notify_icons);
+	add_test_function(window_list_replay);
+
+	return 0;
+}
+
+static void test_window_order(int type, UINT32 windowId, UINT32 ownerWindowId)
+{
+	WINDOW_ORDER_INFO orderInfo;
+	WINDOW_STATE_ORDER window_state;
+
+	memset(&window_state, 0, sizeof(WINDOW_STATE_ORDER));
+	orderInfo.windowId = windowId;
+	orderInfo.notifyIconId = 0;
+	orderInfo.fieldFlags = WINDOW_ORDER_TYPE_WINDOW | WINDOW_ORDER_FIELD_OWNER;
+	window_state.ownerWindowId = ownerWindowId;
+
+	if (type == 0)
+	{
+		orderInfo.fieldFlags |= WINDOW_ORDER_STATE_NEW;
+		window_list_create(rail->list, &orderInfo, &window_state);
+	}
+	else if (type == 1)
+	{
+		window_list_update(rail->list, &orderInfo, &window_state);
+	}
+	else
+	{
+		orderInfo.fieldFlags = WINDOW_ORDER_TYPE_WINDOW | WINDOW_ORDER_STATE_DELETED;
+		window_list_delete(rail->list, &orderInfo);
+	}
+}
+
+static void test_notify_icon_order(int type, UINT32 windowId, UINT32 notifyIconId, UINT32 state)
+{
+	WINDOW_ORDER_INFO orderInfo;
+	NOTIFY_ICON_STATE_ORDER notify_icon_state;
+
+	memset(&notify_icon_state, 0, sizeof(NOTIFY_ICON_STATE_ORDER));
+	orderInfo.windowId = windowId;
+	orderInfo.notifyIconId = notifyIconId;
+	orderInfo.fieldFlags = WINDOW_ORDER_TYPE_NOTIFY | WINDOW_ORDER_FIELD_NOTIFY_STATE;
+	notify_icon_state.state = state;
+
+	if (type == 0)
+		window_list_notify_icon_create(rail->list, &orderInfo, &notify_icon_state);
+	else if (type == 1)
+		window_list_notify_icon_update(rail->list, &orderInfo, &notify_icon_state);
+	else
+		window_list_notify_icon_delete(rail->list, &orderInfo);
+}
+
+/* lookups as done before the hash tables, walking the window list */
+
+static rdpWindow* test_window_list_walk_by_id(rdpWindowList* list, UINT32 windowId)
+{
+	rdpWindow* window;
+
+	for (window = list->head; window != NULL; window = window->next)
+	{
+		if (window->windowId == windowId)
+			return window;
+	}
+
+	return NULL;
+}
+
+static rdpWindow* test_window_list_walk_by_extra_id(rdpWindowList* list, void* extraId)
+{
+	rdpWindow* window;
+
+	for (window = list->head; window != NULL; window = window->next)
+	{
+		if (window->extraId == extraId)
+			return window;
+	}
+
+	return NULL;
+}
+
+static rdpNotifyIcon* test_window_list_walk_notify_icon(rdpWindowList* list, UINT32 windowId, UINT32 notifyIconId)
+{
+	rdpNotifyIcon* icon;
+
+	for (icon = list->iconHead; icon != NULL; icon = icon->next)
+	{
+		if ((icon->windowId == windowId) && (icon->notifyIconId == notifyIconId))
+			return icon;
+	}
+
+	return NULL;
+}
+
+void test_window_list_lookup(void)
+{
+	int i;
+	rdpWindow* window;
+
+	windows_created = 0;
+	windows_destroyed = 0;
+
+	/* enough windows to grow the tables a few times */
+	for (i = 0; i < 300; i++)
+		test_window_order(0, 0x10000 + i * 4, 0);
+
+	CU_ASSERT(windows_created == 300);
+	CU_ASSERT(rail->list->count == 300);
+
+	for (i = 0; i < 300; i++)
+	{
+		window = window_list_get_by_id(rail->list, 0x10000 + i * 4);
+		CU_ASSERT(window != NULL && window->windowId == 0x10000 + i * 4);
+		CU_ASSERT(window_list_get_by_extra_id(rail->list, TEST_EXTRA_ID(0x10000 + i * 4)) == window);
+	}
+
+	CU_ASSERT(window_list_get_by_id(rail->list, 0x10001) == NULL);
+	CU_ASSERT(window_list_get_by_extra_id(rail->list, NULL) == NULL);
+
+	/* creating an existing window updates it */
+	test_window_order(0, 0x10000, 0x99);
+	CU_ASSERT(windows_created == 300);
+	CU_ASSERT(window_list_get_by_id(rail->list, 0x10000)->ownerWindowId == 0x99);
+
+	/* a client changing the extraId of a window is followed on the next order */
+	window = window_list_get_by_id(rail->list, 0x10008);
+	window->extraId = (void*) 0x1234;
+	test_window_order(1, 0x10008, 0);
+	CU_ASSERT(window_list_get_by_extra_id(rail->list, (void*) 0x1234) == window);
+	CU_ASSERT(window_list_get_by_extra_id(rail->list, TEST_EXTRA_ID(0x10008)) == NULL);
+
+	/* the list keeps the creation order */
+	window_list_rewind(rail->list);
+	i = 0;
+
+	while (window_list_has_next(rail->list))
+	{
+		window = window_list_get_next(rail->list);
+		CU_ASSERT(window->windowId == 0x10000 + i * 4);
+		i++;
+	}
+
+	CU_ASSERT(i == 300);
+
+	test_window_order(2, 0x10008, 0);
+	CU_ASSERT(window_list_get_by_id(rail->list, 0x10008) == NULL);
+	CU_ASSERT(window_list_get_by_extra_id(rail->list, (void*) 0x1234) == NULL);
+	CU_ASSERT(windows_destroyed == 1);
+
+	window_list_clear(rail->list);
+	CU_ASSERT(windows_destroyed == 300);
+	CU_ASSERT(rail->list->count == 0);
+	CU_ASSERT(window_list_get_by_id(rail->list, 0x10000) == NULL);
+	CU_ASSERT(window_list_get_by_extra_id(rail->list, TEST_EXTRA_ID(0x10000)) == NULL);
+}
+
+void test_window_list_notify_icons(void)
+{
+	int i;
+	rdpNotifyIcon* icon;
+
+	for (i = 0; i < 200; i++)
+		test_notify_icon_order(0, 0x500 + (i % 4), i, i);
+
+	CU_ASSERT(rail->list->iconCount == 200);
+
+	icon = window_list_get_notify_icon(rail->list, 0x501, 5);
+	CU_ASSERT(icon != NULL && icon->state == 5);
+	CU_ASSERT(window_list_get_notify_icon(rail->list, 0x500, 5) == NULL);
+
+	test_notify_icon_order(1, 0x501, 5, 77);
+	CU_ASSERT(icon->state == 77);
+
+	/* creating an existing icon updates it */
+	test_notify_icon_order(0, 0x501, 5, 78);
+	CU_ASSERT(icon->state == 78);
+	CU_ASSERT(rail->list->iconCount == 200);
+
+	test_notify_icon_order(2, 0x501, 5, 0);
+	CU_ASSERT(window_list_get_notify_icon(rail->list, 0x501, 5) == NULL);
+	CU_ASSERT(rail->list->iconCount == 199);
+
+	for (i = 0; i < 200; i++)
+	{
+		if (i != 5)
+			CU_ASSERT(window_list_get_notify_icon(rail->list, 0x500 + (i % 4), i)->state == (UINT32) i);
+	}
+
+	for (i = 0; i < 200; i++)
+	{
+		if (i != 5)
+			test_notify_icon_order(2, 0x500 + (i % 4), i, 0);
+	}
+
+	CU_ASSERT(rail->list->iconCount == 0);
+
+	/* clearing the list drops the notify icons along with the windows */
+	for (i = 0; i < 20; i++)
+		test_notify_icon_order(0, 0x500 + (i % 4), i, i);
+
+	window_list_clear(rail->list);
+	CU_ASSERT(rail->list->iconCount == 0);
+	CU_ASSERT(rail->list->iconHead == NULL);
+	CU_ASSERT(window_list_get_notify_icon(rail->list, 0x501, 5) == NULL);
+
+	test_notify_icon_order(0, 0x501, 5, 5);
+	CU_ASSERT(rail->list->iconCount == 1);
+	test_notify_icon_order(2, 0x501, 5, 0);
+}
+
+static long test_window_list_elapsed(struct timeval* start_time)
+{
+	struct timeval end_time;
+
+	gettimeofday(&end_time, NULL);
+
+	return ((end_time.tv_sec - start_time->tv_sec) * 1000000) + (end_time.tv_usec - start_time->tv_usec);
+}
+
+/**
+ * Replay a burst of window and notification icon orders over a few hundred
+ * windows, looking windows up after each order the way clients do, and
+ * check the hash tables against walks of the lists.
+ */
+
+#define TEST_REPLAY_ORDERS		10000
+#define TEST_REPLAY_WINDOWS		500
+#define TEST_REPLAY_LOOKUPS		8
+
+void test_window_list_replay(void)
+{
+	int i, k;
+	int type;
+	BOOL match;
+	UINT32 seed;
+	UINT32 windowId;
+	UINT32 notifyIconId;
+	UINT32 ids[TEST_REPLAY_LOOKUPS];
+	rdpWindowList* list;
+	long hashed, walked;
+	struct timeval start_time;
+
+	windows_created = 0;
+	windows_destroyed = 0;
+
+	list = rail->list;
+
+	seed = 777;
+	match = TRUE;
+	hashed = walked = 0;
+
+	for (i = 0; i < TEST_REPLAY_ORDERS; i++)
+	{
+		seed = seed * 1103515245 + 12345;
+		windowId = 0x20000 + ((seed >> 8) % TEST_REPLAY_WINDOWS) * 4;
+		notifyIconId = (seed >> 20) % 64;
+
+		/* mostly state updates, creates and deletes keep a few hundred windows */
+		type = (seed >> 16) % 8;
+
+		if (type < 3)
+			test_window_order(0, windowId, i);
+		else if (type < 7)
+			test_window_order(1, windowId, i);
+		else
+			test_window_order(2, windowId, 0);
+
+		if ((i % 4) == 0)
+			test_notify_icon_order((seed >> 24) % 3, windowId, notifyIconId, i);
+
+		for (k = 0; k < TEST_REPLAY_LOOKUPS; k++)
+		{
+			seed = seed * 1103515245 + 12345;
+			ids[k] = 0x20000 + ((seed >> 8) % TEST_REPLAY_WINDOWS) * 4;
+		}
+
+		for (k = 0; k < TEST_REPLAY_LOOKUPS; k++)
+		{
+			if (window_list_get_by_id(list, ids[k]) != test_window_list_walk_by_id(list, ids[k]))
+				match = FALSE;
+
+			if (window_list_get_by_extra_id(list, TEST_EXTRA_ID(ids[k])) !=
+					test_window_list_walk_by_extra_id(list, TEST_EXTRA_ID(ids[k])))
+				match = FALSE;
+
+			if (window_list_get_notify_icon(list, ids[k], notifyIconId) !=
+					test_window_list_walk_notify_icon(list, ids[k], notifyIconId))
+				match = FALSE;
+		}
+
+		gettimeofday(&start_time, NULL);
+
+		for (k = 0; k < TEST_REPLAY_LOOKUPS; k++)
+		{
+			window_list_get_by_id(list, ids[k]);
+			window_list_get_by_extra_id(list, TEST_EXTRA_ID(ids[k]));
+		}
+
+		hashed += test_window_list_elapsed(&start_time);
+
+		gettimeofday(&start_time, NULL);
+
+		for (k = 0; k < TEST_REPLAY_LOOKUPS; k++)
+		{
+			test_window_list_walk_by_id(list, ids[k]);
+			test_window_list_walk_by_extra_id(list, TEST_EXTRA_ID(ids[k]));
+		}
+
+		walked += test_window_list_elapsed(&start_time);
+	}
+
+	CU_ASSERT(match);
+	CU_ASSERT(list->count == (UINT32) (windows_created - windows_destroyed));
+	CU_ASSERT(list->count > TEST_REPLAY_WINDOWS / 2);
+
+	printf("\n%d orders, %d windows: hashed lookups %ld us, list walks %ld us\n",
+		TEST_REPLAY_ORDERS, list->count, hashed, walked);
+
+	window_list_clear(list);
+}
@@ -28,6 +28,9 @@
 typedef struct _GLYPH_CACHE GLYPH_CACHE;
 typedef struct _FRAGMENT_CACHE_ENTRY FRAGMENT_CACHE_ENTRY;
 typedef struct _FRAGMENT_CACHE FRAGMENT_CACHE;
+typedef struct _GLYPH_PLACEMENT GLYPH_PLACEMENT;
+typedef struct _GLYPH_RUN GLYPH_RUN;
+typedef struct _GLYPH_RUN_CACHE GLYPH_RUN_CACHE;
 typedef struct rdp_glyph_cache rdpGlyphCache;
 
 #include <freerdp/cache/cache.h>
@@ -36,6 +39,7 @@ struct _GLYPH_CACHE
 {
 	UINT32 number;
 	UINT32 maxCellSize;
+	UINT32 generation;
 	rdpGlyph** entries;
 };
 
@@ -50,10 +54,63 @@ struct _FRAGMENT_CACHE
 	FRAGMENT_CACHE_ENTRY* entries;
 };
 
+/**
+ * The glyph run cache keeps the glyphs of a text run composited into a
+ * single mono mask, so that a run drawn again takes one glyph draw instead
+ * of one per glyph. Runs are identified by the placement of their glyphs
+ * relative to the text origin. A run gets its mask the second time it is
+ * seen, text drawn only once never pays for compositing.
+ */
+
+#define GLYPH_RUN_CACHE_SIZE		256
+#define GLYPH_RUN_CACHE_BUCKETS		512
+#define GLYPH_RUN_MAX_MASK_SIZE		65536
+
+struct _GLYPH_PLACEMENT
+{
+	UINT32 index;
+	INT32 x;
+	INT32 y;
+	rdpGlyph* glyph;
+};
+
+struct _GLYPH_RUN
+{
+	UINT32 key;
+	UINT32 cacheId;
+	UINT32 generation;
+	UINT32 count;
+	GLYPH_PLACEMENT* placements;
+	rdpGlyph* glyph;
+
+	GLYPH_RUN* prev;
+	GLYPH_RUN* next;
+	GLYPH_RUN* chain;
+};
+
+struct _GLYPH_RUN_CACHE
+{
+	UINT32 count;
+	GLYPH_RUN* head;
+	GLYPH_RUN* tail;
+	GLYPH_RUN** buckets;
+
+	UINT32 hits;
+	UINT32 misses;
+	UINT32 evictions;
+
+	/* placements of the run being drawn */
+
+	UINT32 length;
+	UINT32 size;
+	GLYPH_PLACEMENT* placements;
+};
+
 struct rdp_glyph_cache
 {
 	FRAGMENT_CACHE fragCache;
 	GLYPH_CACHE glyphCache[10];
+	GLYPH_RUN_CACHE runCache;
 
 	rdpContext* context;
 	rdpSettings* settings;
@@ -65,6 +122,9 @@ FREERDP_API void glyph_cache_put(rdpGlyphCache* glyph_cache, UINT32 id, UINT32 i
 FREERDP_API void* glyph_cache_fragment_get(rdpGlyphCache* glyph, UINT32 index, UINT32* count);
 FREERDP_API void glyph_cache_fragment_put(rdpGlyphCache* glyph, UINT32 index, UINT32 count, void* entry);
 
+FREERDP_API void glyph_cache_draw_run(rdpGlyphCache* glyph_cache, UINT32 cacheId, int x, int y);
+FREERDP_API void glyph_cache_run_reset(rdpGlyphCache* glyph_cache);
+
 FREERDP_API void glyph_cache_register_callbacks(rdpUpdate* update);
 
 FREERDP_API rdpGlyphCache* glyph_cache_new(rdpSettings* settings);
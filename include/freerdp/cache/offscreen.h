@@ -30,15 +30,45 @@ typedef struct rdp_offscreen_cache rdpOffscreenCache;
 
 #include <freerdp/cache/cache.h>
 
+/**
+ * The offscreen cache keeps track of the bytes used by the offscreen
+ * bitmaps, counted at the session color depth as the server does. The
+ * ceiling is the negotiated offscreenCacheSize, none (maxBytes 0) when
+ * offscreen bitmaps are not supported. Bitmaps are kept in least recently
+ * used order, touched when created, selected as surface or drawn from.
+ * Each create that leaves the cache over the ceiling calls the
+ * OffscreenPressure callback. Nothing is deleted: the server still refers
+ * to its bitmaps by id, so only it can free them.
+ */
+
+typedef void (*pOffscreenPressure)(rdpContext* context, UINT32 usedBytes, UINT32 maxBytes);
+
+typedef struct _OFFSCREEN_CACHE_ENTRY OFFSCREEN_CACHE_ENTRY;
+
+struct _OFFSCREEN_CACHE_ENTRY
+{
+	UINT32 size;
+	OFFSCREEN_CACHE_ENTRY* prev;
+	OFFSCREEN_CACHE_ENTRY* next;
+};
+
 struct rdp_offscreen_cache
 {
 	UINT32 maxSize; /* 0 */
 	UINT32 maxEntries; /* 1 */
 	rdpBitmap** entries; /* 2 */
 	UINT32 currentSurface; /* 3 */
+	pOffscreenPressure OffscreenPressure; /* 4 */
 
 	/* internal */
 
+	UINT32 usedBytes;
+	UINT32 maxBytes;
+
+	OFFSCREEN_CACHE_ENTRY* lru;
+	OFFSCREEN_CACHE_ENTRY* head;
+	OFFSCREEN_CACHE_ENTRY* tail;
+
 	rdpUpdate* update;
 	rdpSettings* settings;
 };
@@ -31,6 +31,23 @@ typedef struct rdp_pointer_cache rdpPointerCache;
 
 #include <freerdp/cache/cache.h>
 
+/**
+ * Slots of the pointer cache share converted cursors. A cursor is identified
+ * by a hash of its attributes and mask data: when the server sends a cursor
+ * already held by another slot, the new slot takes a reference on the
+ * existing cursor instead of converting the masks again. There can be no
+ * more distinct cursors than slots, so a cursor is looked up in a table of
+ * cacheSize images.
+ */
+
+struct _POINTER_CACHE_IMAGE
+{
+	UINT32 key;
+	UINT32 refCount;
+	rdpPointer* pointer;
+};
+typedef struct _POINTER_CACHE_IMAGE POINTER_CACHE_IMAGE;
+
 struct rdp_pointer_cache
 {
 	UINT32 cacheSize; /* 0 */
@@ -38,12 +55,19 @@ struct rdp_pointer_cache
 
 	/* internal */
 
+	UINT32 imageCount;
+	POINTER_CACHE_IMAGE* images;
+
+	UINT32 hits;
+	UINT32 misses;
+
 	rdpUpdate* update;
 	rdpSettings* settings;
 };
 
 FREERDP_API rdpPointer* pointer_cache_get(rdpPointerCache* pointer_cache, UINT32 index);
 FREERDP_API void pointer_cache_put(rdpPointerCache* pointer_cache, UINT32 index, rdpPointer* pointer);
+FREERDP_API rdpPointer* pointer_cache_find(rdpPointerCache* pointer_cache, rdpPointer* pointer);
 
 FREERDP_API void pointer_cache_register_callbacks(rdpUpdate* update);
 
@@ -0,0 +1,85 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Server-Side Cache Manager
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __SERVER_CACHE_H
+#define __SERVER_CACHE_H
+
+#include <freerdp/api.h>
+#include <freerdp/types.h>
+#include <freerdp/settings.h>
+
+/**
+ * The server cache manager tracks what a client holds in its bitmap (revision 2)
+ * and glyph caches, so that a server knows when a MemBlt or GlyphIndex order can
+ * reference cached data and when a CacheBitmapV2 or CacheGlyph order has to be
+ * sent first. Caches are sized from the capabilities advertised by the client
+ * and evict their least recently used entry when full.
+ */
+
+#define SERVER_CACHE_NONE		0xFFFFFFFF
+
+typedef struct _SERVER_CACHE_ENTRY SERVER_CACHE_ENTRY;
+typedef struct _SERVER_CACHE SERVER_CACHE;
+typedef struct rdp_server_cache rdpServerCache;
+
+struct _SERVER_CACHE_ENTRY
+{
+	UINT64 key;
+	UINT32 prev;
+	UINT32 next;
+	UINT32 chain;
+};
+
+struct _SERVER_CACHE
+{
+	UINT32 number;
+	UINT32 maxCellSize;
+	UINT32 count;
+	UINT32 head;
+	UINT32 tail;
+	UINT32 mask;
+	UINT32* buckets;
+	SERVER_CACHE_ENTRY* entries;
+};
+
+struct rdp_server_cache
+{
+	UINT32 maxBitmapCells;
+	SERVER_CACHE bitmapCells[5];
+	SERVER_CACHE glyphCaches[10];
+
+	UINT32 hits;
+	UINT32 misses;
+	UINT32 evictions;
+
+	rdpSettings* settings;
+};
+
+FREERDP_API UINT64 server_cache_key(BYTE* data, int length);
+
+FREERDP_API int server_cache_bitmap_id(rdpServerCache* server_cache, int width, int height);
+FREERDP_API BOOL server_cache_bitmap_lookup(rdpServerCache* server_cache, UINT32 id, UINT64 key, UINT32* index);
+
+FREERDP_API int server_cache_glyph_id(rdpServerCache* server_cache, int size);
+FREERDP_API BOOL server_cache_glyph_lookup(rdpServerCache* server_cache, UINT32 id, UINT64 key, UINT32* index);
+
+FREERDP_API void server_cache_reset(rdpServerCache* server_cache);
+
+FREERDP_API rdpServerCache* server_cache_new(rdpSettings* settings);
+FREERDP_API void server_cache_free(rdpServerCache* server_cache);
+
+#endif /* __SERVER_CACHE_H */
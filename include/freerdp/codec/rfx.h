@@ -24,6 +24,7 @@
 #include <freerdp/types.h>
 #include <freerdp/constants.h>
 #include <freerdp/utils/stream.h>
+#include <freerdp/utils/metrics.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -100,6 +101,12 @@ struct _RFX_CONTEXT
 	BYTE quant_idx_cb;
 	BYTE quant_idx_cr;
 
+	/* encoder byte budget per frame, 0 for fixed quantization */
+	UINT32 frame_budget;
+
+	/* decoder stage timings are recorded here when set and enabled */
+	rdpMetrics* metrics;
+
 	/* routines */
 	void (*decode_ycbcr_to_rgb)(INT16* y_r_buf, INT16* cb_g_buf, INT16* cr_b_buf);
 	void (*encode_rgb_to_ycbcr)(INT16* y_r_buf, INT16* cb_g_buf, INT16* cr_b_buf);
@@ -108,6 +115,10 @@ struct _RFX_CONTEXT
 	void (*dwt_2d_decode)(INT16* buffer, INT16* dwt_buffer);
 	void (*dwt_2d_encode)(INT16* buffer, INT16* dwt_buffer);
 
+	/* fused differential coding, quantization and DWT, NULL when done in separate passes */
+	void (*dwt_2d_quantization_decode)(INT16* buffer, INT16* dwt_buffer, const UINT32* quantization_values);
+	void (*dwt_2d_quantization_encode)(INT16* buffer, INT16* dwt_buffer, const UINT32* quantization_values);
+
 	/* private definitions */
 	RFX_CONTEXT_PRIV* priv;
 };
@@ -117,6 +128,7 @@ FREERDP_API RFX_CONTEXT* rfx_context_new(void);
 FREERDP_API void rfx_context_free(RFX_CONTEXT* context);
 FREERDP_API void rfx_context_set_cpu_opt(RFX_CONTEXT* context, UINT32 cpu_opt);
 FREERDP_API void rfx_context_set_pixel_format(RFX_CONTEXT* context, RDP_PIXEL_FORMAT pixel_format);
+FREERDP_API void rfx_context_set_frame_budget(RFX_CONTEXT* context, UINT32 frame_budget);
 FREERDP_API void rfx_context_reset(RFX_CONTEXT* context);
 
 FREERDP_API RFX_MESSAGE* rfx_process_message(RFX_CONTEXT* context, BYTE* data, UINT32 length);
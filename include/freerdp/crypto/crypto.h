@@ -82,6 +82,8 @@ typedef struct crypto_sha1_struct* CryptoSha1;
 FREERDP_API CryptoSha1 crypto_sha1_init(void);
 FREERDP_API void crypto_sha1_update(CryptoSha1 sha1, const BYTE* data, UINT32 length);
 FREERDP_API void crypto_sha1_final(CryptoSha1 sha1, BYTE* out_data);
+FREERDP_API void crypto_sha1_reset(CryptoSha1 sha1);
+FREERDP_API void crypto_sha1_digest(CryptoSha1 sha1, BYTE* out_data);
 
 #define	CRYPTO_MD5_DIGEST_LENGTH	MD5_DIGEST_LENGTH
 typedef struct crypto_md5_struct* CryptoMd5;
@@ -89,6 +91,8 @@ typedef struct crypto_md5_struct* CryptoMd5;
 FREERDP_API CryptoMd5 crypto_md5_init(void);
 FREERDP_API void crypto_md5_update(CryptoMd5 md5, const BYTE* data, UINT32 length);
 FREERDP_API void crypto_md5_final(CryptoMd5 md5, BYTE* out_data);
+FREERDP_API void crypto_md5_reset(CryptoMd5 md5);
+FREERDP_API void crypto_md5_digest(CryptoMd5 md5, BYTE* out_data);
 
 typedef struct crypto_rc4_struct* CryptoRc4;
 
@@ -108,6 +112,7 @@ typedef struct crypto_hmac_struct* CryptoHmac;
 
 FREERDP_API CryptoHmac crypto_hmac_new(void);
 FREERDP_API void crypto_hmac_sha1_init(CryptoHmac hmac, const BYTE *data, UINT32 length);
+FREERDP_API void crypto_hmac_md5_init(CryptoHmac hmac, const BYTE *data, UINT32 length);
 FREERDP_API void crypto_hmac_update(CryptoHmac hmac, const BYTE *data, UINT32 length);
 FREERDP_API void crypto_hmac_final(CryptoHmac hmac, BYTE *out_data, UINT32 length);
 FREERDP_API void crypto_hmac_free(CryptoHmac hmac);
@@ -36,6 +36,7 @@ typedef struct rdp_freerdp_peer freerdp_peer;
 #include <freerdp/settings.h>
 #include <freerdp/extension.h>
 #include <freerdp/utils/stream.h>
+#include <freerdp/utils/metrics.h>
 
 #include <freerdp/input.h>
 #include <freerdp/update.h>
@@ -96,7 +97,8 @@ struct rdp_context
 	rdpCache* cache; /* 35 */
 	rdpChannels* channels; /* 36 */
 	rdpGraphics* graphics; /* 37 */
-	UINT32 paddingC[64 - 38]; /* 38 */
+	rdpMetrics* metrics; /* 38 */
+	UINT32 paddingC[64 - 39]; /* 39 */
 };
 
 /** Defines the options for a given instance of RDP connection.
@@ -181,18 +183,37 @@ struct rdp_freerdp
 	UINT32 paddingE[80 - 66]; /* 66 */
 };
 
+/* Client Connection Phases */
+enum CONNECT_PHASE
+{
+	CONNECT_PHASE_NEGO = 0,
+	CONNECT_PHASE_TLS,
+	CONNECT_PHASE_NLA,
+	CONNECT_PHASE_MCS,
+	CONNECT_PHASE_LICENSE,
+	CONNECT_PHASE_CAPABILITY,
+	CONNECT_PHASE_FINALIZATION,
+	CONNECT_PHASE_COUNT
+};
+
 FREERDP_API void freerdp_context_new(freerdp* instance);
 FREERDP_API void freerdp_context_free(freerdp* instance);
 
 FREERDP_API BOOL freerdp_connect(freerdp* instance);
 FREERDP_API BOOL freerdp_shall_disconnect(freerdp* instance);
 FREERDP_API BOOL freerdp_disconnect(freerdp* instance);
+FREERDP_API BOOL freerdp_reconnect(freerdp* instance);
 
 FREERDP_API BOOL freerdp_get_fds(freerdp* instance, void** rfds, int* rcount, void** wfds, int* wcount);
 FREERDP_API BOOL freerdp_check_fds(freerdp* instance);
 
 FREERDP_API UINT32 freerdp_error_info(freerdp* instance);
 
+FREERDP_API void freerdp_get_metrics(rdpContext* context, rdpMetricsSnapshot* snapshot);
+
+FREERDP_API UINT32 freerdp_get_connect_time(freerdp* instance, int phase);
+FREERDP_API const char* freerdp_get_connect_phase_string(int phase);
+
 FREERDP_API void freerdp_get_version(int* major, int* minor, int* revision);
 
 FREERDP_API freerdp* freerdp_new();
@@ -0,0 +1,41 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * GDI Raster Operation Engine
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __GDI_ROP_H
+#define __GDI_ROP_H
+
+#include <freerdp/api.h>
+#include <freerdp/freerdp.h>
+#include <freerdp/gdi/gdi.h>
+
+/**
+ * Operands of a ternary raster operation, from the truth table
+ * stored in the third byte of the operation code
+ */
+
+#define GDI_ROP_USES_SRC(_rop)		((((_rop) >> 2) & 0x330000) != ((_rop) & 0x330000))
+#define GDI_ROP_USES_PAT(_rop)		((((_rop) >> 4) & 0x0F0000) != ((_rop) & 0x0F0000))
+
+typedef void (*pRopRow)(BYTE* dstp, BYTE* srcp, BYTE* patp, int length);
+
+FREERDP_API pRopRow gdi_rop_get_row(int rop);
+FREERDP_API void gdi_rop_set_cpu_opt(UINT32 cpu_opt);
+
+FREERDP_API int gdi_rop_blt(HGDI_DC hdcDest, int nXDest, int nYDest, int nWidth, int nHeight,
+		HGDI_DC hdcSrc, int nXSrc, int nYSrc, int rop, BYTE* color);
+
+#endif /* __GDI_ROP_H */
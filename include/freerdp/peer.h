@@ -28,6 +28,36 @@
 
 #include <winpr/sspi.h>
 
+/**
+ * Surface frames the server keeps track of until the client acknowledges them.
+ * Frames beyond this count are no longer tracked and are treated as acknowledged.
+ */
+#define FREERDP_PEER_MAX_FRAMES_IN_FLIGHT	32
+
+struct rdp_peer_frame
+{
+	UINT32 frameId;
+	UINT32 sendTime;
+};
+typedef struct rdp_peer_frame rdpPeerFrame;
+
+/**
+ * Frame acknowledge statistics. Round trip times are in milliseconds
+ * and smoothed the way TCP smooths its round trip estimate.
+ */
+struct rdp_peer_frame_statistics
+{
+	UINT32 sent_frames;
+	UINT32 acked_frames;
+	UINT32 throttled_frames;
+	UINT32 in_flight;
+	UINT32 max_in_flight;
+	UINT32 last_rtt;
+	UINT32 rtt;
+	UINT32 rtt_var;
+};
+typedef struct rdp_peer_frame_statistics rdpPeerFrameStatistics;
+
 typedef void (*psPeerContextNew)(freerdp_peer* client, rdpContext* context);
 typedef void (*psPeerContextFree)(freerdp_peer* client, rdpContext* context);
 
@@ -74,6 +104,10 @@ struct rdp_freerdp_peer
 
 	int pId;
 	UINT32 ack_frame_id;
+	int frame_head;
+	int frame_count;
+	rdpPeerFrame frames[FREERDP_PEER_MAX_FRAMES_IN_FLIGHT];
+	rdpPeerFrameStatistics frame_statistics;
 	BOOL local;
 	BOOL connected;
 	BOOL activated;
@@ -87,5 +121,9 @@ FREERDP_API void freerdp_peer_context_free(freerdp_peer* client);
 FREERDP_API freerdp_peer* freerdp_peer_new(int sockfd);
 FREERDP_API void freerdp_peer_free(freerdp_peer* client);
 
+FREERDP_API BOOL freerdp_peer_can_send_frame(freerdp_peer* client);
+FREERDP_API void freerdp_peer_get_frame_statistics(freerdp_peer* client, rdpPeerFrameStatistics* statistics);
+FREERDP_API void freerdp_peer_get_metrics(freerdp_peer* client, rdpMetricsSnapshot* snapshot);
+
 #endif /* __FREERDP_PEER_H */
 
@@ -27,10 +27,13 @@
 #define PTR_MSG_TYPE_COLOR		0x0006
 #define PTR_MSG_TYPE_CACHED		0x0007
 #define PTR_MSG_TYPE_POINTER		0x0008
+#define PTR_MSG_TYPE_LARGE		0x0009
 
 #define SYSPTR_NULL			0x00000000
 #define SYSPTR_DEFAULT			0x00007F00
 
+#define LARGE_POINTER_MAX_SIZE		384
+
 struct _POINTER_POSITION_UPDATE
 {
 	UINT32 xPos;
@@ -65,6 +68,21 @@ struct _POINTER_NEW_UPDATE
 };
 typedef struct _POINTER_NEW_UPDATE POINTER_NEW_UPDATE;
 
+struct _POINTER_LARGE_UPDATE
+{
+	UINT32 xorBpp;
+	UINT32 cacheIndex;
+	UINT32 hotSpotX;
+	UINT32 hotSpotY;
+	UINT32 width;
+	UINT32 height;
+	UINT32 lengthAndMask;
+	UINT32 lengthXorMask;
+	BYTE* xorMaskData;
+	BYTE* andMaskData;
+};
+typedef struct _POINTER_LARGE_UPDATE POINTER_LARGE_UPDATE;
+
 struct _POINTER_CACHED_UPDATE
 {
 	UINT32 cacheIndex;
@@ -76,6 +94,7 @@ typedef void (*pPointerSystem)(rdpContext* context, POINTER_SYSTEM_UPDATE* point
 typedef void (*pPointerColor)(rdpContext* context, POINTER_COLOR_UPDATE* pointer_color);
 typedef void (*pPointerNew)(rdpContext* context, POINTER_NEW_UPDATE* pointer_new);
 typedef void (*pPointerCached)(rdpContext* context, POINTER_CACHED_UPDATE* pointer_cached);
+typedef void (*pPointerLarge)(rdpContext* context, POINTER_LARGE_UPDATE* pointer_large);
 
 struct rdp_pointer_update
 {
@@ -87,7 +106,8 @@ struct rdp_pointer_update
 	pPointerColor PointerColor; /* 18 */
 	pPointerNew PointerNew; /* 19 */
 	pPointerCached PointerCached; /* 20 */
-	UINT32 paddingB[32 - 21]; /* 21 */
+	pPointerLarge PointerLarge; /* 21 */
+	UINT32 paddingB[32 - 22]; /* 22 */
 
 	/* internal */
 
@@ -96,6 +116,7 @@ struct rdp_pointer_update
 	POINTER_COLOR_UPDATE pointer_color;
 	POINTER_NEW_UPDATE pointer_new;
 	POINTER_CACHED_UPDATE pointer_cached;
+	POINTER_LARGE_UPDATE pointer_large;
 };
 typedef struct rdp_pointer_update rdpPointerUpdate;
 
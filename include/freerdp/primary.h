@@ -416,6 +416,51 @@ struct _ELLIPSE_CB_ORDER
 };
 typedef struct _ELLIPSE_CB_ORDER ELLIPSE_CB_ORDER;
 
+/**
+ * An order batch holds the fixed-size primary orders of an orders update,
+ * decoded up front so that a renderer can process them in one call. The
+ * batch is flushed before any secondary or alternate secondary order,
+ * the remaining primary orders still go through the per-order callbacks.
+ * Entry types use the primary drawing order type values.
+ */
+
+#define ORDER_BATCH_DSTBLT		0x00
+#define ORDER_BATCH_PATBLT		0x01
+#define ORDER_BATCH_SCRBLT		0x02
+#define ORDER_BATCH_LINE_TO		0x09
+#define ORDER_BATCH_OPAQUE_RECT		0x0A
+#define ORDER_BATCH_MEMBLT		0x0D
+#define ORDER_BATCH_MEM3BLT		0x0E
+#define ORDER_BATCH_GLYPH_INDEX		0x1B
+
+struct _ORDER_BATCH_ENTRY
+{
+	UINT32 orderType;
+	BOOL bounded;
+	rdpBounds bounds;
+	BOOL skip;
+	union
+	{
+		DSTBLT_ORDER dstblt;
+		PATBLT_ORDER patblt;
+		SCRBLT_ORDER scrblt;
+		OPAQUE_RECT_ORDER opaque_rect;
+		LINE_TO_ORDER line_to;
+		MEMBLT_ORDER memblt;
+		MEM3BLT_ORDER mem3blt;
+		GLYPH_INDEX_ORDER glyph_index;
+	} order;
+};
+typedef struct _ORDER_BATCH_ENTRY ORDER_BATCH_ENTRY;
+
+struct _ORDER_BATCH
+{
+	UINT32 count;
+	UINT32 size;
+	ORDER_BATCH_ENTRY* entries;
+};
+typedef struct _ORDER_BATCH ORDER_BATCH;
+
 typedef void (*pDstBlt)(rdpContext* context, DSTBLT_ORDER* dstblt);
 typedef void (*pPatBlt)(rdpContext* context, PATBLT_ORDER* patblt);
 typedef void (*pScrBlt)(rdpContext* context, SCRBLT_ORDER* scrblt);
@@ -438,6 +483,7 @@ typedef void (*pPolygonSC)(rdpContext* context, POLYGON_SC_ORDER* polygon_sc);
 typedef void (*pPolygonCB)(rdpContext* context, POLYGON_CB_ORDER* polygon_cb);
 typedef void (*pEllipseSC)(rdpContext* context, ELLIPSE_SC_ORDER* ellipse_sc);
 typedef void (*pEllipseCB)(rdpContext* context, ELLIPSE_CB_ORDER* ellipse_cb);
+typedef void (*pOrderBatch)(rdpContext* context, ORDER_BATCH* batch);
 
 struct rdp_primary_update
 {
@@ -466,7 +512,8 @@ struct rdp_primary_update
 	pPolygonCB PolygonCB; /* 35 */
 	pEllipseSC EllipseSC; /* 36 */
 	pEllipseCB EllipseCB; /* 37 */
-	UINT32 paddingB[48 - 38]; /* 38 */
+	pOrderBatch OrderBatch; /* 38 */
+	UINT32 paddingB[48 - 39]; /* 39 */
 
 	/* internal */
 
@@ -493,6 +540,10 @@ struct rdp_primary_update
 	POLYGON_CB_ORDER polygon_cb;
 	ELLIPSE_SC_ORDER ellipse_sc;
 	ELLIPSE_CB_ORDER ellipse_cb;
+
+	BOOL bounded;
+	rdpBounds bounds;
+	ORDER_BATCH batch;
 };
 typedef struct rdp_primary_update rdpPrimaryUpdate;
 
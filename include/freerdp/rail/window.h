@@ -27,6 +27,7 @@
 #include <freerdp/utils/stream.h>
 
 typedef struct rdp_window rdpWindow;
+typedef struct rdp_notify_icon rdpNotifyIcon;
 
 #include <freerdp/rail/rail.h>
 #include <freerdp/rail/icon.h>
@@ -65,6 +66,23 @@ struct rdp_window
 	UINT32 visibleOffsetY;
 	UINT16 numVisibilityRects;
 	RECTANGLE_16* visibilityRects;
+
+	/* window list hash chains */
+	rdpWindow* idChain;
+	rdpWindow* extraIdChain;
+	void* extraIdKey;
+};
+
+struct rdp_notify_icon
+{
+	void* extra;
+	UINT32 windowId;
+	UINT32 notifyIconId;
+	UINT32 version;
+	UINT32 state;
+	rdpNotifyIcon* prev;
+	rdpNotifyIcon* next;
+	rdpNotifyIcon* chain;
 };
 
 FREERDP_API void window_state_update(rdpWindow* window, WINDOW_ORDER_INFO* orderInfo, WINDOW_STATE_ORDER* window_state);
@@ -30,12 +30,30 @@ typedef struct rdp_window_list rdpWindowList;
 #include <freerdp/rail/rail.h>
 #include <freerdp/rail/window.h>
 
+/**
+ * Windows are kept in a list in creation order, and in two hash tables to
+ * find them by windowId and by the extraId set by the client when it
+ * creates its window. Notification icons are kept the same way, keyed by
+ * windowId and notifyIconId. The tables grow with the number of windows.
+ */
+
 struct rdp_window_list
 {
 	rdpRail* rail;
 	rdpWindow* head;
 	rdpWindow* tail;
 	rdpWindow* iterator;
+
+	UINT32 count;
+	UINT32 mask;
+	rdpWindow** idBuckets;
+	rdpWindow** extraIdBuckets;
+
+	UINT32 iconCount;
+	UINT32 iconMask;
+	rdpNotifyIcon* iconHead;
+	rdpNotifyIcon* iconTail;
+	rdpNotifyIcon** iconBuckets;
 };
 
 FREERDP_API void window_list_rewind(rdpWindowList* list);
@@ -50,6 +68,12 @@ FREERDP_API void window_list_update(rdpWindowList* list, WINDOW_ORDER_INFO* orde
 FREERDP_API void window_list_delete(rdpWindowList* list, WINDOW_ORDER_INFO* orderInfo);
 FREERDP_API void window_list_clear(rdpWindowList* list);
 
+FREERDP_API rdpNotifyIcon* window_list_get_notify_icon(rdpWindowList* list, UINT32 windowId, UINT32 notifyIconId);
+
+FREERDP_API void window_list_notify_icon_create(rdpWindowList* list, WINDOW_ORDER_INFO* orderInfo, NOTIFY_ICON_STATE_ORDER* notify_icon_state);
+FREERDP_API void window_list_notify_icon_update(rdpWindowList* list, WINDOW_ORDER_INFO* orderInfo, NOTIFY_ICON_STATE_ORDER* notify_icon_state);
+FREERDP_API void window_list_notify_icon_delete(rdpWindowList* list, WINDOW_ORDER_INFO* orderInfo);
+
 FREERDP_API rdpWindowList* window_list_new(rdpRail* rail);
 FREERDP_API void window_list_free(rdpWindowList* list);
 
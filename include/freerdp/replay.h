@@ -0,0 +1,45 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Session Replay
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __FREERDP_REPLAY_H
+#define __FREERDP_REPLAY_H
+
+#include <freerdp/api.h>
+#include <freerdp/types.h>
+#include <freerdp/freerdp.h>
+#include <freerdp/utils/metrics.h>
+
+/**
+ * A capture holds one received PDU per pcap record, as written by the
+ * client with --dump-pdu. Records are replayed back to back, ignoring
+ * their timestamps, through the same receive path as a live connection.
+ */
+
+struct rdp_replay_stats
+{
+	UINT32 pdus; /* PDUs replayed */
+	UINT32 skipped; /* records not holding a single unencrypted PDU */
+	UINT64 bytes; /* bytes of the PDUs replayed */
+	UINT64 elapsed; /* nanoseconds spent replaying */
+	rdpMetricsSnapshot metrics; /* pixels and per-codec timings */
+};
+typedef struct rdp_replay_stats rdpReplayStats;
+
+FREERDP_API BOOL freerdp_replay(freerdp* instance, char* name, rdpReplayStats* stats);
+FREERDP_API UINT32 freerdp_replay_checksum(BYTE* data, int length);
+
+#endif /* __FREERDP_REPLAY_H */
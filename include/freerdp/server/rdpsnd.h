@@ -55,6 +55,20 @@ struct _rdpsnd_server_context
 	/* Last sent audio block number. */
 	int block_no;
 
+	/**
+	 * Audio still unconfirmed after the client's own playback delay plus this
+	 * many milliseconds is considered stale and new samples are dropped until
+	 * the client catches up. Set by server, 0 for the default.
+	 */
+	UINT32 max_latency;
+
+	/* Latency statistics from the client's Wave Confirm PDUs, in milliseconds. */
+	UINT32 latency;
+	UINT32 jitter;
+	UINT32 client_delay;
+	UINT32 confirmed_blocks;
+	UINT32 dropped_frames;
+
 	/*** APIs called by the server. ***/
 	/**
 	 * Initialize the channel. The caller should check the return value to see
@@ -214,6 +214,8 @@ struct _BITMAP_CACHE_V2_CELL_INFO
 {
 	UINT32 numEntries;
 	BOOL persistent;
+	UINT32 numPersistentKeys;
+	UINT64* persistentKeys;
 };
 typedef struct _BITMAP_CACHE_V2_CELL_INFO BITMAP_CACHE_V2_CELL_INFO;
 
@@ -358,7 +360,8 @@ struct rdp_settings
 	ALIGN64 BOOL auto_reconnection; /* 192 */
 	ALIGN64 ARC_CS_PRIVATE_PACKET* client_auto_reconnect_cookie; /* 193 */
 	ALIGN64 ARC_SC_PRIVATE_PACKET* server_auto_reconnect_cookie; /* 194 */
-	UINT64 paddingI[208 - 195]; /* 195 */
+	ALIGN64 UINT32 auto_reconnect_max_retries; /* 195 */
+	UINT64 paddingI[208 - 196]; /* 196 */
 
 	/* Time Zone */
 	ALIGN64 TIME_ZONE_INFO* client_time_zone; /* 208 */
@@ -398,7 +401,9 @@ struct rdp_settings
 	ALIGN64 char* rdp_key_file; /* 258 */
 	ALIGN64 rdpKey* server_key; /* 259 */
 	ALIGN64 char* certificate_name; /* 260 */
-	UINT64 paddingL[280 - 261]; /* 261 */
+	ALIGN64 BYTE* client_random; /* 261 */
+	ALIGN64 DWORD client_random_length; /* 262 */
+	UINT64 paddingL[280 - 263]; /* 263 */
 
 	/* Codecs */
 	ALIGN64 BOOL rfx_codec; /* 280 */
@@ -419,7 +424,9 @@ struct rdp_settings
 	ALIGN64 BOOL play_rfx; /* 297 */
 	ALIGN64 char* dump_rfx_file; /* 298 */
 	ALIGN64 char* play_rfx_file; /* 299 */
-	UINT64 paddingN[312 - 300]; /* 300 */
+	ALIGN64 BOOL dump_pdu; /* 300 */
+	ALIGN64 char* dump_pdu_file; /* 301 */
+	UINT64 paddingN[312 - 302]; /* 302 */
 
 	/* RemoteApp */
 	ALIGN64 BOOL remote_app; /* 312 */
@@ -441,7 +448,8 @@ struct rdp_settings
 	ALIGN64 UINT32 bitmapCacheV2NumCells; /* 331 */
 	ALIGN64 BITMAP_CACHE_V2_CELL_INFO* bitmapCacheV2CellInfo; /* 332 */
 	ALIGN64 BOOL allow_cache_waiting_list; /* 333 */
-	UINT64 paddingQ[344 - 334]; /* 334 */
+	ALIGN64 char* bitmap_cache_persist_file; /* 334 */
+	UINT64 paddingQ[344 - 335]; /* 335 */
 
 	/* Offscreen Bitmap Cache */
 	ALIGN64 BOOL offscreen_bitmap_cache; /* 344 */
@@ -0,0 +1,82 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Incremental Clipboard Format Conversion
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __CLIPBOARD_UTILS_H
+#define __CLIPBOARD_UTILS_H
+
+#include <freerdp/api.h>
+#include <freerdp/types.h>
+
+/**
+ * A clipboard stream converts clipboard data between the local
+ * representation (UTF-8, LF line endings, image/bmp, text/html) and the
+ * Windows clipboard formats (CF_TEXT, CF_UNICODETEXT, CF_DIB, CF_HTML)
+ * one chunk at a time, so that large payloads never have to be present
+ * twice in memory. Encoding converts local data to the Windows format,
+ * decoding goes the other way.
+ *
+ * Converted data is appended to data/length. A consumer sending the data
+ * in pieces may take what it needs and reset length to zero between writes.
+ */
+
+#define CLIPBOARD_HTML_HEADER_MAX		1024
+
+struct _CLIPBOARD_STREAM
+{
+	UINT32 format;
+	BOOL encode;
+
+	BYTE* data;
+	int length;
+	int size;
+
+	/* internal */
+
+	int total;
+	int expected;
+	BOOL failed;
+	BOOL done;
+	BOOL cr;
+
+	BYTE carry[4];
+	int carry_length;
+	BOOL has_odd;
+	BYTE odd;
+	WCHAR high;
+
+	BYTE* header;
+	int header_length;
+	BOOL parsed;
+	int start;
+	int end;
+
+	BOOL started;
+	BOOL utf16;
+	BOOL big_endian;
+	BOOL body;
+	int search;
+};
+typedef struct _CLIPBOARD_STREAM CLIPBOARD_STREAM;
+
+FREERDP_API BOOL clipboard_stream_write(CLIPBOARD_STREAM* stream, BYTE* data, int size);
+FREERDP_API BOOL clipboard_stream_finish(CLIPBOARD_STREAM* stream);
+FREERDP_API BYTE* clipboard_stream_detach(CLIPBOARD_STREAM* stream, int* size);
+
+FREERDP_API CLIPBOARD_STREAM* clipboard_stream_new(UINT32 format, BOOL encode, int length);
+FREERDP_API void clipboard_stream_free(CLIPBOARD_STREAM* stream);
+
+#endif /* __CLIPBOARD_UTILS_H */
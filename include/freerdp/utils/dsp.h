@@ -39,6 +39,18 @@ union _ADPCM
 };
 typedef union _ADPCM ADPCM;
 
+/**
+ * Resampler quality levels. NEAREST is the legacy nearest-neighbour
+ * resampler, the others use a polyphase windowed-sinc filter with
+ * 8, 16 or 32 taps per output sample.
+ */
+#define FREERDP_DSP_RESAMPLE_NEAREST		0
+#define FREERDP_DSP_RESAMPLE_LOW		1
+#define FREERDP_DSP_RESAMPLE_MEDIUM		2
+#define FREERDP_DSP_RESAMPLE_HIGH		3
+
+typedef struct _FREERDP_DSP_RESAMPLER FREERDP_DSP_RESAMPLER;
+
 typedef struct _FREERDP_DSP_CONTEXT FREERDP_DSP_CONTEXT;
 struct _FREERDP_DSP_CONTEXT
 {
@@ -47,6 +59,9 @@ struct _FREERDP_DSP_CONTEXT
 	UINT32 resampled_frames;
 	UINT32 resampled_maxlength;
 
+	int resample_quality;
+	FREERDP_DSP_RESAMPLER* resampler;
+
 	BYTE* adpcm_buffer;
 	UINT32 adpcm_size;
 	UINT32 adpcm_maxlength;
@@ -73,5 +88,24 @@ FREERDP_API FREERDP_DSP_CONTEXT* freerdp_dsp_context_new(void);
 FREERDP_API void freerdp_dsp_context_free(FREERDP_DSP_CONTEXT* context);
 #define freerdp_dsp_context_reset_adpcm(_c) memset(&_c->adpcm, 0, sizeof(ADPCM))
 
+FREERDP_API void freerdp_dsp_context_set_resample_quality(FREERDP_DSP_CONTEXT* context, int quality);
+FREERDP_API void freerdp_dsp_context_reset_resampler(FREERDP_DSP_CONTEXT* context);
+
+/**
+ * Block ADPCM codecs writing into a caller supplied buffer, for mono or stereo 16-bit PCM.
+ * With dst set to NULL they return the number of bytes the conversion produces,
+ * otherwise the number of bytes written, or -1 if the parameters are invalid or
+ * dst_size is too small.
+ */
+FREERDP_API BOOL freerdp_dsp_ima_adpcm_block_size_valid(int channels, int block_size);
+FREERDP_API int freerdp_dsp_decode_ima_adpcm_blocks(ADPCM* adpcm, const BYTE* src, int size,
+	int channels, int block_size, BYTE* dst, int dst_size);
+FREERDP_API int freerdp_dsp_encode_ima_adpcm_blocks(ADPCM* adpcm, const BYTE* src, int size,
+	int channels, int block_size, BYTE* dst, int dst_size);
+FREERDP_API int freerdp_dsp_decode_ms_adpcm_blocks(ADPCM* adpcm, const BYTE* src, int size,
+	int channels, int block_size, BYTE* dst, int dst_size);
+FREERDP_API int freerdp_dsp_encode_ms_adpcm_blocks(ADPCM* adpcm, const BYTE* src, int size,
+	int channels, int block_size, BYTE* dst, int dst_size);
+
 #endif /* __DSP_UTILS_H */
 
@@ -0,0 +1,127 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Runtime Metrics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __UTILS_METRICS_H
+#define __UTILS_METRICS_H
+
+#include <freerdp/api.h>
+#include <freerdp/types.h>
+
+/**
+ * Counters and histograms are recorded into a shard owned by the calling
+ * thread, so writers never contend. Shards are summed when a snapshot is
+ * taken. Recording is off until enabled with metrics_enable().
+ */
+
+enum METRICS_COUNTER
+{
+	METRICS_TRANSPORT_READS,
+	METRICS_TRANSPORT_READ_BYTES,
+	METRICS_TRANSPORT_WRITES,
+	METRICS_TRANSPORT_WRITE_BYTES,
+	METRICS_FASTPATH_UPDATES,
+	METRICS_FASTPATH_FRAGMENTS,
+	METRICS_MPPC_DECOMPRESS_INPUT_BYTES,
+	METRICS_MPPC_DECOMPRESS_OUTPUT_BYTES,
+	METRICS_MPPC_COMPRESS_INPUT_BYTES,
+	METRICS_MPPC_COMPRESS_OUTPUT_BYTES,
+	METRICS_UPDATE_PIXELS,
+	METRICS_COUNTER_COUNT
+};
+
+/* histograms of durations are in nanoseconds */
+
+enum METRICS_HISTOGRAM
+{
+	METRICS_RFX_RLGR_DECODE,
+	METRICS_RFX_DWT_DECODE,
+	METRICS_RFX_COLOR_CONVERT,
+	METRICS_CHANNEL_QUEUE_DEPTH,
+	METRICS_ORDERS,
+	METRICS_BITMAP_DECOMPRESS,
+	METRICS_SURFACE_REMOTEFX,
+	METRICS_SURFACE_NSCODEC,
+	METRICS_SURFACE_UNCOMPRESSED,
+	METRICS_HISTOGRAM_COUNT
+};
+
+/**
+ * Log-linear buckets: values below 4 have a bucket each, then every power
+ * of two is split in 4 buckets, which bounds the relative error to 25%
+ */
+
+#define METRICS_HISTOGRAM_SUB_BUCKETS	4
+#define METRICS_HISTOGRAM_BUCKETS	252
+
+/* threads past this many share an overflow shard updated with atomic adds */
+#define METRICS_MAX_SHARDS		64
+
+struct rdp_metrics_histogram
+{
+	UINT64 count;
+	UINT64 sum;
+	UINT64 buckets[METRICS_HISTOGRAM_BUCKETS];
+};
+typedef struct rdp_metrics_histogram rdpMetricsHistogram;
+
+struct rdp_metrics_shard
+{
+	UINT64 counters[METRICS_COUNTER_COUNT];
+	rdpMetricsHistogram histograms[METRICS_HISTOGRAM_COUNT];
+};
+typedef struct rdp_metrics_shard rdpMetricsShard;
+typedef struct rdp_metrics_shard rdpMetricsSnapshot;
+
+struct rdp_metrics
+{
+	BOOL enabled;
+	DWORD tls_index;
+	LONG shard_count;
+	rdpMetricsShard* volatile shards[METRICS_MAX_SHARDS];
+	rdpMetricsShard overflow;
+};
+typedef struct rdp_metrics rdpMetrics;
+
+FREERDP_API rdpMetrics* metrics_new(void);
+FREERDP_API void metrics_free(rdpMetrics* metrics);
+
+FREERDP_API void metrics_enable(rdpMetrics* metrics, BOOL enabled);
+
+FREERDP_API void metrics_add_counter(rdpMetrics* metrics, int counter, UINT64 value);
+FREERDP_API void metrics_record(rdpMetrics* metrics, int histogram, UINT64 value);
+
+FREERDP_API UINT64 metrics_time(void);
+FREERDP_API UINT64 metrics_start(rdpMetrics* metrics);
+FREERDP_API void metrics_stop(rdpMetrics* metrics, int histogram, UINT64 start);
+
+FREERDP_API void metrics_snapshot(rdpMetrics* metrics, rdpMetricsSnapshot* snapshot);
+
+FREERDP_API int metrics_histogram_bucket(UINT64 value);
+FREERDP_API UINT64 metrics_histogram_bucket_value(int bucket);
+FREERDP_API UINT64 metrics_histogram_percentile(rdpMetricsHistogram* histogram, int percent);
+
+#define METRICS_ENABLED(_m)		(((_m) != NULL) && (_m)->enabled)
+
+#define METRICS_ADD(_m, _counter, _value) do { \
+	if (METRICS_ENABLED(_m)) \
+		metrics_add_counter(_m, _counter, _value); } while (0)
+
+#define METRICS_RECORD(_m, _histogram, _value) do { \
+	if (METRICS_ENABLED(_m)) \
+		metrics_record(_m, _histogram, _value); } while (0)
+
+#endif /* __UTILS_METRICS_H */
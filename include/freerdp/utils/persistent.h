@@ -0,0 +1,71 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Persistent Bitmap Cache
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __UTILS_PERSISTENT_H
+#define __UTILS_PERSISTENT_H
+
+#include <freerdp/api.h>
+#include <freerdp/types.h>
+#include <freerdp/settings.h>
+
+#define PERSISTENT_CACHE_COMPRESSED		0x01
+
+/**
+ * A bitmap as it was received in a Cache Bitmap (Revision 2) order,
+ * identified by the 64-bit key the server attached to it. The bitmap
+ * data is kept in wire format and only decoded when it is first used.
+ */
+struct _PERSISTENT_CACHE_ENTRY
+{
+	UINT64 key;
+	UINT16 width;
+	UINT16 height;
+	BYTE bpp;
+	BYTE flags;
+	BYTE cacheId;
+	UINT32 length;
+	BYTE* data;
+	BOOL allocated;
+};
+typedef struct _PERSISTENT_CACHE_ENTRY PERSISTENT_CACHE_ENTRY;
+
+struct rdp_persistent_cache
+{
+	char* filename;
+
+	int count;
+	PERSISTENT_CACHE_ENTRY* entries;
+
+	/* internal */
+
+	BYTE* map;
+	UINT32 map_size;
+};
+typedef struct rdp_persistent_cache rdpPersistentCache;
+
+FREERDP_API int persistent_cache_open(rdpPersistentCache* persistent, char* filename);
+FREERDP_API BOOL persistent_cache_write(char* filename, PERSISTENT_CACHE_ENTRY** entries, int count);
+FREERDP_API int persistent_cache_load_keys(rdpPersistentCache* persistent, rdpSettings* settings, PERSISTENT_CACHE_ENTRY** cells);
+
+FREERDP_API void persistent_cache_entry_set(PERSISTENT_CACHE_ENTRY* entry, UINT64 key, int cacheId,
+		int width, int height, int bpp, BOOL compressed, BYTE* data, UINT32 length);
+FREERDP_API void persistent_cache_entry_clear(PERSISTENT_CACHE_ENTRY* entry);
+
+FREERDP_API rdpPersistentCache* persistent_cache_new(void);
+FREERDP_API void persistent_cache_free(rdpPersistentCache* persistent);
+
+#endif /* __UTILS_PERSISTENT_H */
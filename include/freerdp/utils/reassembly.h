@@ -0,0 +1,102 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Chunked Channel Data Reassembly
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __REASSEMBLY_UTILS_H
+#define __REASSEMBLY_UTILS_H
+
+#include <freerdp/api.h>
+#include <freerdp/types.h>
+#include <freerdp/utils/stream.h>
+
+#include <winpr/synch.h>
+
+/**
+ * Fragmented channel data is copied into fixed-size segments taken from a
+ * shared pool instead of a buffer sized from the (untrusted) total length
+ * announced in the first fragment. A completed message is exposed as a
+ * segment chain, and only made contiguous when the consumer asks for it.
+ *
+ * Messages longer than the context limit are discarded. The default limit
+ * can be raised per channel for channels expecting larger transfers.
+ */
+
+#define REASSEMBLY_SEGMENT_SIZE			16384
+#define REASSEMBLY_POOL_MAX_FREE		64
+#define REASSEMBLY_DEFAULT_MAX_LENGTH		(64 * 1024 * 1024)
+
+typedef struct _REASSEMBLY_SEGMENT REASSEMBLY_SEGMENT;
+
+struct _REASSEMBLY_SEGMENT
+{
+	UINT32 length;
+	REASSEMBLY_SEGMENT* next;
+	BYTE data[REASSEMBLY_SEGMENT_SIZE];
+};
+
+struct rdp_segment_pool
+{
+	HANDLE mutex;
+	REASSEMBLY_SEGMENT* free_list;
+	int free_count;
+	int max_free;
+	int allocated;
+};
+typedef struct rdp_segment_pool rdpSegmentPool;
+
+/* a completed message, detached from its reassembly context */
+struct _REASSEMBLY_CHAIN
+{
+	UINT32 length;
+	REASSEMBLY_SEGMENT* head;
+	rdpSegmentPool* pool;
+};
+typedef struct _REASSEMBLY_CHAIN REASSEMBLY_CHAIN;
+
+struct rdp_reassembly
+{
+	rdpSegmentPool* pool;
+	UINT32 max_length;
+
+	UINT32 length;
+	UINT32 total_length;
+	BOOL overflow;
+
+	REASSEMBLY_SEGMENT* head;
+	REASSEMBLY_SEGMENT* tail;
+};
+typedef struct rdp_reassembly rdpReassembly;
+
+FREERDP_API rdpSegmentPool* segment_pool_new(int max_free);
+FREERDP_API void segment_pool_free(rdpSegmentPool* pool);
+FREERDP_API REASSEMBLY_SEGMENT* segment_pool_take(rdpSegmentPool* pool);
+FREERDP_API void segment_pool_release(rdpSegmentPool* pool, REASSEMBLY_SEGMENT* segment);
+
+FREERDP_API rdpReassembly* reassembly_new(rdpSegmentPool* pool, UINT32 max_length);
+FREERDP_API void reassembly_free(rdpReassembly* reassembly);
+
+FREERDP_API BOOL reassembly_begin(rdpReassembly* reassembly, UINT32 total_length);
+FREERDP_API BOOL reassembly_append(rdpReassembly* reassembly, const BYTE* data, UINT32 length);
+FREERDP_API BOOL reassembly_is_complete(rdpReassembly* reassembly);
+FREERDP_API void reassembly_reset(rdpReassembly* reassembly);
+
+FREERDP_API BOOL reassembly_detach(rdpReassembly* reassembly, REASSEMBLY_CHAIN* chain);
+FREERDP_API STREAM* reassembly_to_stream(rdpReassembly* reassembly);
+
+FREERDP_API UINT32 reassembly_chain_copy(REASSEMBLY_CHAIN* chain, BYTE* buffer, UINT32 size);
+FREERDP_API void reassembly_chain_free(REASSEMBLY_CHAIN* chain);
+
+#endif /* __REASSEMBLY_UTILS_H */
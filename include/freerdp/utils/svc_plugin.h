@@ -39,12 +39,18 @@ struct rdp_svc_plugin
 
 	int interval_ms;
 
+	/* largest reassembled message accepted, 0 for REASSEMBLY_DEFAULT_MAX_LENGTH */
+	UINT32 max_data_length;
+
 	void (*connect_callback)(rdpSvcPlugin* plugin);
 	void (*receive_callback)(rdpSvcPlugin* plugin, STREAM* data_in);
 	void (*event_callback)(rdpSvcPlugin* plugin, RDP_EVENT* event);
 	void (*interval_callback)(rdpSvcPlugin* plugin);
 	void (*terminate_callback)(rdpSvcPlugin* plugin);
 
+	/* called on the plugin thread when a received message had to be discarded */
+	void (*drop_callback)(rdpSvcPlugin* plugin, UINT32 length);
+
 	rdpSvcPluginPrivate* priv;
 };
 
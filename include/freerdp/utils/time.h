@@ -34,5 +34,6 @@ FREERDP_API UINT64 freerdp_windows_gmtime();
 FREERDP_API UINT64 freerdp_get_windows_time_from_unix_time(time_t unix_time);
 FREERDP_API time_t freerdp_get_unix_time_from_windows_time(UINT64 windows_time);
 FREERDP_API time_t freerdp_get_unix_time_from_generalized_time(const char* generalized_time);
+FREERDP_API UINT32 freerdp_get_tick_count(void);
 
 #endif /* FREERDP_TIME_UTILS_H */
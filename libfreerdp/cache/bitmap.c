@@ -30,6 +30,18 @@
 
 #include <freerdp/cache/bitmap.h>
 
+static PERSISTENT_CACHE_ENTRY* bitmap_cache_get_persistent(rdpBitmapCache* bitmap_cache, UINT32 id, UINT32 index)
+{
+	if ((id >= bitmap_cache->maxCells) || (bitmap_cache->cells[id].persistent == NULL))
+		return NULL;
+
+	/* bitmaps on the waiting list are not kept across sessions */
+	if (index >= bitmap_cache->cells[id].number)
+		return NULL;
+
+	return &bitmap_cache->cells[id].persistent[index];
+}
+
 void update_gdi_memblt(rdpContext* context, MEMBLT_ORDER* memblt)
 {
 	rdpBitmap* bitmap;
@@ -73,6 +85,7 @@ void update_gdi_cache_bitmap(rdpContext* context, CACHE_BITMAP_ORDER* cache_bitm
 {
 	rdpBitmap* bitmap;
 	rdpBitmap* prevBitmap;
+	PERSISTENT_CACHE_ENTRY* entry;
 	rdpCache* cache = context->cache;
 
 	bitmap = Bitmap_Alloc(context);
@@ -86,6 +99,11 @@ void update_gdi_cache_bitmap(rdpContext* context, CACHE_BITMAP_ORDER* cache_bitm
 
 	bitmap->New(context, bitmap);
 
+	entry = bitmap_cache_get_persistent(cache->bitmap, cache_bitmap->cacheId, cache_bitmap->cacheIndex);
+
+	if (entry != NULL)
+		persistent_cache_entry_clear(entry);
+
 	prevBitmap = bitmap_cache_get(cache->bitmap, cache_bitmap->cacheId, cache_bitmap->cacheIndex);
 
 	if (prevBitmap != NULL)
@@ -98,6 +116,7 @@ void update_gdi_cache_bitmap_v2(rdpContext* context, CACHE_BITMAP_V2_ORDER* cach
 {
 	rdpBitmap* bitmap;
 	rdpBitmap* prevBitmap;
+	PERSISTENT_CACHE_ENTRY* entry;
 	rdpCache* cache = context->cache;
 
 	bitmap = Bitmap_Alloc(context);
@@ -117,18 +136,32 @@ void update_gdi_cache_bitmap_v2(rdpContext* context, CACHE_BITMAP_V2_ORDER* cach
 
 	bitmap->New(context, bitmap);
 
+	entry = bitmap_cache_get_persistent(cache->bitmap, cache_bitmap_v2->cacheId, cache_bitmap_v2->cacheIndex);
+
+	if (entry != NULL)
+		persistent_cache_entry_clear(entry);
+
 	prevBitmap = bitmap_cache_get(cache->bitmap, cache_bitmap_v2->cacheId, cache_bitmap_v2->cacheIndex);
 
 	if (prevBitmap != NULL)
 		Bitmap_Free(context, prevBitmap);
 
 	bitmap_cache_put(cache->bitmap, cache_bitmap_v2->cacheId, cache_bitmap_v2->cacheIndex, bitmap);
+
+	if ((entry != NULL) && (cache_bitmap_v2->flags & CBR2_PERSISTENT_KEY_PRESENT))
+	{
+		persistent_cache_entry_set(entry,
+				((UINT64) cache_bitmap_v2->key2 << 32) | cache_bitmap_v2->key1, cache_bitmap_v2->cacheId,
+				cache_bitmap_v2->bitmapWidth, cache_bitmap_v2->bitmapHeight, cache_bitmap_v2->bitmapBpp,
+				cache_bitmap_v2->compressed, cache_bitmap_v2->bitmapDataStream, cache_bitmap_v2->bitmapLength);
+	}
 }
 
 void update_gdi_cache_bitmap_v3(rdpContext* context, CACHE_BITMAP_V3_ORDER* cache_bitmap_v3)
 {
 	rdpBitmap* bitmap;
 	rdpBitmap* prevBitmap;
+	PERSISTENT_CACHE_ENTRY* entry;
 	rdpCache* cache = context->cache;
 	BITMAP_DATA_EX* bitmapData = &cache_bitmap_v3->bitmapData;
 
@@ -149,6 +182,11 @@ void update_gdi_cache_bitmap_v3(rdpContext* context, CACHE_BITMAP_V3_ORDER* cach
 
 	bitmap->New(context, bitmap);
 
+	entry = bitmap_cache_get_persistent(cache->bitmap, cache_bitmap_v3->cacheId, cache_bitmap_v3->cacheIndex);
+
+	if (entry != NULL)
+		persistent_cache_entry_clear(entry);
+
 	prevBitmap = bitmap_cache_get(cache->bitmap, cache_bitmap_v3->cacheId, cache_bitmap_v3->cacheIndex);
 
 	if (prevBitmap != NULL)
@@ -226,6 +264,32 @@ rdpBitmap* bitmap_cache_get(rdpBitmapCache* bitmap_cache, UINT32 id, UINT32 inde
 
 	bitmap = bitmap_cache->cells[id].entries[index];
 
+	if (bitmap == NULL)
+	{
+		PERSISTENT_CACHE_ENTRY* entry;
+
+		entry = bitmap_cache_get_persistent(bitmap_cache, id, index);
+
+		/* bitmaps restored from the cache file are decoded when they are first used */
+		if ((entry != NULL) && (entry->data != NULL))
+		{
+			rdpContext* context = bitmap_cache->context;
+
+			bitmap = Bitmap_Alloc(context);
+
+			Bitmap_SetDimensions(context, bitmap, entry->width, entry->height);
+
+			bitmap->Decompress(context, bitmap,
+					entry->data, entry->width, entry->height,
+					entry->bpp, entry->length,
+					(entry->flags & PERSISTENT_CACHE_COMPRESSED) ? TRUE : FALSE, CODEC_ID_NONE);
+
+			bitmap->New(context, bitmap);
+
+			bitmap_cache->cells[id].entries[index] = bitmap;
+		}
+	}
+
 	return bitmap;
 }
 
@@ -267,6 +331,62 @@ void bitmap_cache_register_callbacks(rdpUpdate* update)
 	update->BitmapUpdate = update_gdi_bitmap_update;
 }
 
+static void bitmap_cache_open_persistent(rdpBitmapCache* bitmap_cache)
+{
+	int i;
+	PERSISTENT_CACHE_ENTRY** cells;
+
+	cells = (PERSISTENT_CACHE_ENTRY**) xzalloc(sizeof(PERSISTENT_CACHE_ENTRY*) * bitmap_cache->maxCells);
+
+	for (i = 0; i < (int) bitmap_cache->maxCells; i++)
+	{
+		bitmap_cache->cells[i].persistent = (PERSISTENT_CACHE_ENTRY*)
+			xzalloc(sizeof(PERSISTENT_CACHE_ENTRY) * (bitmap_cache->cells[i].number + 1));
+		cells[i] = bitmap_cache->cells[i].persistent;
+	}
+
+	/**
+	 * The keys may have been advertised already, from the same file, when the
+	 * connection was made. Loading them again yields the same order.
+	 */
+
+	bitmap_cache->persistent = persistent_cache_new();
+	persistent_cache_load_keys(bitmap_cache->persistent, bitmap_cache->settings, cells);
+
+	free(cells);
+}
+
+static void bitmap_cache_save_persistent(rdpBitmapCache* bitmap_cache)
+{
+	int i, j;
+	int count = 0;
+	int total = 0;
+	BITMAP_V2_CELL* cell;
+	PERSISTENT_CACHE_ENTRY** entries;
+	rdpSettings* settings = bitmap_cache->settings;
+
+	for (i = 0; i < (int) bitmap_cache->maxCells; i++)
+		total += bitmap_cache->cells[i].number;
+
+	entries = (PERSISTENT_CACHE_ENTRY**) xzalloc(sizeof(PERSISTENT_CACHE_ENTRY*) * (total + 1));
+
+	for (i = 0; i < (int) bitmap_cache->maxCells; i++)
+	{
+		cell = &bitmap_cache->cells[i];
+
+		for (j = 0; j < (int) cell->number; j++)
+		{
+			if (cell->persistent[j].data != NULL)
+				entries[count++] = &cell->persistent[j];
+		}
+	}
+
+	if (!persistent_cache_write(settings->bitmap_cache_persist_file, entries, count))
+		printf("failed to save bitmap cache to %s\n", settings->bitmap_cache_persist_file);
+
+	free(entries);
+}
+
 rdpBitmapCache* bitmap_cache_new(rdpSettings* settings)
 {
 	int i;
@@ -290,6 +410,9 @@ rdpBitmapCache* bitmap_cache_new(rdpSettings* settings)
 			/* allocate an extra entry for BITMAP_CACHE_WAITING_LIST_INDEX */
 			bitmap_cache->cells[i].entries = (rdpBitmap**) xzalloc(sizeof(rdpBitmap*) * (bitmap_cache->cells[i].number + 1));
 		}
+
+		if (settings->persistent_bitmap_cache)
+			bitmap_cache_open_persistent(bitmap_cache);
 	}
 
 	return bitmap_cache;
@@ -302,8 +425,23 @@ void bitmap_cache_free(rdpBitmapCache* bitmap_cache)
 
 	if (bitmap_cache != NULL)
 	{
+		if (bitmap_cache->persistent != NULL)
+			bitmap_cache_save_persistent(bitmap_cache);
+
 		for (i = 0; i < (int) bitmap_cache->maxCells; i++)
 		{
+			if (bitmap_cache->cells[i].persistent != NULL)
+			{
+				for (j = 0; j < (int) bitmap_cache->cells[i].number; j++)
+					persistent_cache_entry_clear(&bitmap_cache->cells[i].persistent[j]);
+
+				free(bitmap_cache->cells[i].persistent);
+
+				free(bitmap_cache->settings->bitmapCacheV2CellInfo[i].persistentKeys);
+				bitmap_cache->settings->bitmapCacheV2CellInfo[i].persistentKeys = NULL;
+				bitmap_cache->settings->bitmapCacheV2CellInfo[i].numPersistentKeys = 0;
+			}
+
 			for (j = 0; j < (int) bitmap_cache->cells[i].number + 1; j++)
 			{
 				bitmap = bitmap_cache->cells[i].entries[j];
@@ -320,6 +458,8 @@ void bitmap_cache_free(rdpBitmapCache* bitmap_cache)
 		if (bitmap_cache->bitmap != NULL)
 			Bitmap_Free(bitmap_cache->context, bitmap_cache->bitmap);
 
+		persistent_cache_free(bitmap_cache->persistent);
+
 		free(bitmap_cache->cells);
 		free(bitmap_cache);
 	}
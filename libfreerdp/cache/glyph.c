@@ -22,6 +22,8 @@
 #endif
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include <freerdp/freerdp.h>
 #include <freerdp/utils/stream.h>
@@ -29,6 +31,24 @@
 
 #include <freerdp/cache/glyph.h>
 
+static void glyph_cache_add_placement(rdpGlyphCache* glyph_cache, UINT32 index, rdpGlyph* glyph, int x, int y)
+{
+	GLYPH_PLACEMENT* placement;
+	GLYPH_RUN_CACHE* runCache = &(glyph_cache->runCache);
+
+	if (runCache->length >= runCache->size)
+	{
+		runCache->size = (runCache->size > 0) ? runCache->size * 2 : 64;
+		runCache->placements = (GLYPH_PLACEMENT*) realloc(runCache->placements, sizeof(GLYPH_PLACEMENT) * runCache->size);
+	}
+
+	placement = &runCache->placements[runCache->length++];
+	placement->index = index;
+	placement->x = x;
+	placement->y = y;
+	placement->glyph = glyph;
+}
+
 void update_process_glyph(rdpContext* context, BYTE* data, int* index,
 		int* x, int* y, UINT32 cacheId, UINT32 ulCharInc, UINT32 flAccel)
 {
@@ -65,7 +85,7 @@ void update_process_glyph(rdpContext* context, BYTE* data, int* index,
 
 	if (glyph != NULL)
 	{
-		Glyph_Draw(context, glyph, glyph->x + *x, glyph->y + *y);
+		glyph_cache_add_placement(glyph_cache, cacheIndex, glyph, glyph->x + *x, glyph->y + *y);
 
 		if (flAccel & SO_CHAR_INC_EQUAL_BM_BASE)
 			*x += glyph->cx;
@@ -80,6 +100,8 @@ void update_process_glyph_fragments(rdpContext* context, BYTE* data, UINT32 leng
 	UINT32 id;
 	UINT32 size;
 	int index = 0;
+	int originX;
+	int originY;
 	BYTE* fragments;
 	rdpGraphics* graphics;
 	rdpGlyphCache* glyph_cache;
@@ -87,6 +109,10 @@ void update_process_glyph_fragments(rdpContext* context, BYTE* data, UINT32 leng
 	graphics = context->graphics;
 	glyph_cache = context->cache->glyph;
 
+	originX = x;
+	originY = y;
+	glyph_cache->runCache.length = 0;
+
 	if (opWidth > 0 && opHeight > 0)
 		Glyph_BeginDraw(context, opX, opY, opWidth, opHeight, bgcolor, fgcolor);
 	else
@@ -161,6 +187,8 @@ void update_process_glyph_fragments(rdpContext* context, BYTE* data, UINT32 leng
 		}
 	}
 
+	glyph_cache_draw_run(glyph_cache, cacheId, originX, originY);
+
 	if (opWidth > 0 && opHeight > 0)
 		Glyph_EndDraw(context, opX, opY, opWidth, opHeight, bgcolor, fgcolor);
 	else
@@ -404,6 +432,9 @@ void glyph_cache_put(rdpGlyphCache* glyph_cache, UINT32 id, UINT32 index, rdpGly
 
 	if (prevGlyph != NULL)
 	{
+		/* runs using the previous glyph are rebuilt when next drawn */
+		glyph_cache->glyphCache[id].generation++;
+
 		Glyph_Free(glyph_cache->context, prevGlyph);
 		free(prevGlyph->aj);
 		free(prevGlyph);
@@ -442,6 +473,287 @@ void glyph_cache_fragment_put(rdpGlyphCache* glyph_cache, UINT32 index, UINT32 s
 	}
 }
 
+static UINT32 glyph_cache_run_hash(UINT32 cacheId, GLYPH_PLACEMENT* placements, UINT32 count)
+{
+	UINT32 i;
+	UINT32 hash = 2166136261U;
+
+	hash = (hash ^ cacheId) * 16777619U;
+
+	for (i = 0; i < count; i++)
+	{
+		hash = (hash ^ placements[i].index) * 16777619U;
+		hash = (hash ^ (UINT32) placements[i].x) * 16777619U;
+		hash = (hash ^ (UINT32) placements[i].y) * 16777619U;
+	}
+
+	return hash;
+}
+
+static BOOL glyph_cache_run_equal(GLYPH_RUN* run, UINT32 cacheId, GLYPH_PLACEMENT* placements, UINT32 count)
+{
+	UINT32 i;
+
+	if ((run->cacheId != cacheId) || (run->count != count))
+		return FALSE;
+
+	for (i = 0; i < count; i++)
+	{
+		if ((run->placements[i].index != placements[i].index) ||
+				(run->placements[i].x != placements[i].x) ||
+				(run->placements[i].y != placements[i].y))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+/**
+ * Composite the glyphs of a run into a single mono glyph.
+ * The glyph position is relative to the origin of the run.
+ */
+
+static rdpGlyph* glyph_cache_run_composite(rdpContext* context, GLYPH_PLACEMENT* placements, UINT32 count)
+{
+	BYTE* aj;
+	BYTE* src;
+	BYTE* dst;
+	BYTE mask;
+	UINT32 i;
+	int row, col;
+	int shift, scanline;
+	int glyphScanline;
+	int left, top, right, bottom;
+	rdpGlyph* glyph;
+	GLYPH_PLACEMENT* placement;
+
+	left = top = 0x7FFFFFFF;
+	right = bottom = -0x7FFFFFFF;
+
+	for (i = 0; i < count; i++)
+	{
+		placement = &placements[i];
+		left = MIN(left, placement->x);
+		top = MIN(top, placement->y);
+		right = MAX(right, placement->x + (int) placement->glyph->cx);
+		bottom = MAX(bottom, placement->y + (int) placement->glyph->cy);
+	}
+
+	if ((right <= left) || (bottom <= top))
+		return NULL;
+
+	scanline = (right - left + 7) / 8;
+
+	if (scanline * (bottom - top) > GLYPH_RUN_MAX_MASK_SIZE)
+		return NULL;
+
+	aj = (BYTE*) xzalloc(scanline * (bottom - top));
+
+	for (i = 0; i < count; i++)
+	{
+		placement = &placements[i];
+		glyph = placement->glyph;
+		glyphScanline = (glyph->cx + 7) / 8;
+		shift = (placement->x - left) % 8;
+
+		for (row = 0; row < (int) glyph->cy; row++)
+		{
+			src = &glyph->aj[row * glyphScanline];
+			dst = &aj[(placement->y - top + row) * scanline + (placement->x - left) / 8];
+
+			for (col = 0; col < glyphScanline; col++)
+			{
+				mask = src[col];
+
+				/* drop the padding bits at the end of the glyph row */
+				if ((col == glyphScanline - 1) && (glyph->cx % 8))
+					mask &= 0xFF << (8 - (glyph->cx % 8));
+
+				dst[col] |= mask >> shift;
+
+				if (shift && ((mask << (8 - shift)) & 0xFF))
+					dst[col + 1] |= (BYTE) (mask << (8 - shift));
+			}
+		}
+	}
+
+	glyph = Glyph_Alloc(context);
+	glyph->x = left;
+	glyph->y = top;
+	glyph->cx = right - left;
+	glyph->cy = bottom - top;
+	glyph->cb = scanline * glyph->cy;
+	glyph->aj = aj;
+	Glyph_New(context, glyph);
+
+	return glyph;
+}
+
+static void glyph_cache_run_free_glyph(rdpGlyphCache* glyph_cache, GLYPH_RUN* run)
+{
+	if (run->glyph != NULL)
+	{
+		Glyph_Free(glyph_cache->context, run->glyph);
+		free(run->glyph->aj);
+		free(run->glyph);
+		run->glyph = NULL;
+	}
+}
+
+static void glyph_cache_run_unlink(GLYPH_RUN_CACHE* runCache, GLYPH_RUN* run)
+{
+	if (run->prev != NULL)
+		run->prev->next = run->next;
+	else
+		runCache->head = run->next;
+
+	if (run->next != NULL)
+		run->next->prev = run->prev;
+	else
+		runCache->tail = run->prev;
+
+	run->prev = run->next = NULL;
+}
+
+static void glyph_cache_run_link(GLYPH_RUN_CACHE* runCache, GLYPH_RUN* run)
+{
+	run->prev = NULL;
+	run->next = runCache->head;
+
+	if (runCache->head != NULL)
+		runCache->head->prev = run;
+	else
+		runCache->tail = run;
+
+	runCache->head = run;
+}
+
+static void glyph_cache_run_evict(rdpGlyphCache* glyph_cache)
+{
+	GLYPH_RUN** chain;
+	GLYPH_RUN* run;
+	GLYPH_RUN_CACHE* runCache = &(glyph_cache->runCache);
+
+	run = runCache->tail;
+	glyph_cache_run_unlink(runCache, run);
+
+	chain = &runCache->buckets[run->key % GLYPH_RUN_CACHE_BUCKETS];
+
+	while (*chain != run)
+		chain = &((*chain)->chain);
+
+	*chain = run->chain;
+
+	glyph_cache_run_free_glyph(glyph_cache, run);
+	free(run->placements);
+	free(run);
+
+	runCache->count--;
+	runCache->evictions++;
+}
+
+/**
+ * Draw the glyphs placed since the beginning of the current text run.
+ * Runs of more than one glyph are looked up in the run cache and drawn
+ * from their composited mask once one exists.
+ * @param glyph_cache glyph cache
+ * @param cacheId glyph cache id of the run
+ * @param x x coordinate of the origin of the run
+ * @param y y coordinate of the origin of the run
+ */
+
+void glyph_cache_draw_run(rdpGlyphCache* glyph_cache, UINT32 cacheId, int x, int y)
+{
+	UINT32 i;
+	UINT32 key;
+	UINT32 generation;
+	GLYPH_RUN* run;
+	GLYPH_PLACEMENT* placements;
+	rdpContext* context = glyph_cache->context;
+	GLYPH_RUN_CACHE* runCache = &(glyph_cache->runCache);
+
+	placements = runCache->placements;
+
+	for (i = 0; i < runCache->length; i++)
+	{
+		placements[i].x -= x;
+		placements[i].y -= y;
+	}
+
+	if ((runCache->length > 1) && (cacheId < 10))
+	{
+		generation = glyph_cache->glyphCache[cacheId].generation;
+		key = glyph_cache_run_hash(cacheId, placements, runCache->length);
+
+		for (run = runCache->buckets[key % GLYPH_RUN_CACHE_BUCKETS]; run != NULL; run = run->chain)
+		{
+			if ((run->key == key) && glyph_cache_run_equal(run, cacheId, placements, runCache->length))
+				break;
+		}
+
+		if (run != NULL)
+		{
+			glyph_cache_run_unlink(runCache, run);
+			glyph_cache_run_link(runCache, run);
+
+			if (run->generation != generation)
+			{
+				glyph_cache_run_free_glyph(glyph_cache, run);
+				run->generation = generation;
+			}
+			else if (run->glyph == NULL)
+			{
+				run->glyph = glyph_cache_run_composite(context, placements, runCache->length);
+			}
+		}
+		else
+		{
+			if (runCache->count >= GLYPH_RUN_CACHE_SIZE)
+				glyph_cache_run_evict(glyph_cache);
+
+			run = (GLYPH_RUN*) xzalloc(sizeof(GLYPH_RUN));
+			run->key = key;
+			run->cacheId = cacheId;
+			run->generation = generation;
+			run->count = runCache->length;
+			run->placements = (GLYPH_PLACEMENT*) malloc(sizeof(GLYPH_PLACEMENT) * run->count);
+			memcpy(run->placements, placements, sizeof(GLYPH_PLACEMENT) * run->count);
+
+			run->chain = runCache->buckets[key % GLYPH_RUN_CACHE_BUCKETS];
+			runCache->buckets[key % GLYPH_RUN_CACHE_BUCKETS] = run;
+			glyph_cache_run_link(runCache, run);
+			runCache->count++;
+		}
+
+		if (run->glyph != NULL)
+		{
+			runCache->hits++;
+			Glyph_Draw(context, run->glyph, x + run->glyph->x, y + run->glyph->y);
+			runCache->length = 0;
+			return;
+		}
+
+		runCache->misses++;
+	}
+
+	for (i = 0; i < runCache->length; i++)
+		Glyph_Draw(context, placements[i].glyph, x + placements[i].x, y + placements[i].y);
+
+	runCache->length = 0;
+}
+
+void glyph_cache_run_reset(rdpGlyphCache* glyph_cache)
+{
+	GLYPH_RUN_CACHE* runCache = &(glyph_cache->runCache);
+
+	while (runCache->tail != NULL)
+		glyph_cache_run_evict(glyph_cache);
+
+	runCache->hits = 0;
+	runCache->misses = 0;
+	runCache->evictions = 0;
+}
+
 void glyph_cache_register_callbacks(rdpUpdate* update)
 {
 	update->primary->GlyphIndex = update_gdi_glyph_index;
@@ -472,6 +784,7 @@ rdpGlyphCache* glyph_cache_new(rdpSettings* settings)
 		}
 
 		glyph->fragCache.entries = xzalloc(sizeof(FRAGMENT_CACHE_ENTRY) * 256);
+		glyph->runCache.buckets = (GLYPH_RUN**) xzalloc(sizeof(GLYPH_RUN*) * GLYPH_RUN_CACHE_BUCKETS);
 	}
 
 	return glyph;
@@ -511,6 +824,11 @@ void glyph_cache_free(rdpGlyphCache* glyph_cache)
 		}
 
 		free(glyph_cache->fragCache.entries);
+
+		glyph_cache_run_reset(glyph_cache);
+		free(glyph_cache->runCache.buckets);
+		free(glyph_cache->runCache.placements);
+
 		free(glyph_cache);
 	}
 }
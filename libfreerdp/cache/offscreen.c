@@ -35,6 +35,14 @@ void update_gdi_create_offscreen_bitmap(rdpContext* context, CREATE_OFFSCREEN_BI
 	rdpBitmap* bitmap;
 	rdpCache* cache = context->cache;
 
+	/* the server counts on the deleted bitmaps to make room for the new one */
+
+	for (i = 0; i < (int) create_offscreen_bitmap->deleteList.cIndices; i++)
+	{
+		index = create_offscreen_bitmap->deleteList.indices[i];
+		offscreen_cache_delete(cache->offscreen, index);
+	}
+
 	bitmap = Bitmap_Alloc(context);
 
 	bitmap->width = create_offscreen_bitmap->cx;
@@ -42,17 +50,10 @@ void update_gdi_create_offscreen_bitmap(rdpContext* context, CREATE_OFFSCREEN_BI
 
 	bitmap->New(context, bitmap);
 
-	offscreen_cache_delete(cache->offscreen, create_offscreen_bitmap->id);
 	offscreen_cache_put(cache->offscreen, create_offscreen_bitmap->id, bitmap);
 
 	if(cache->offscreen->currentSurface == create_offscreen_bitmap->id)
 		Bitmap_SetSurface(context, bitmap, FALSE);
-
-	for (i = 0; i < (int) create_offscreen_bitmap->deleteList.cIndices; i++)
-	{
-		index = create_offscreen_bitmap->deleteList.indices[i];
-		offscreen_cache_delete(cache->offscreen, index);
-	}
 }
 
 void update_gdi_switch_surface(rdpContext* context, SWITCH_SURFACE_ORDER* switch_surface)
@@ -73,6 +74,56 @@ void update_gdi_switch_surface(rdpContext* context, SWITCH_SURFACE_ORDER* switch
 	cache->offscreen->currentSurface = switch_surface->bitmapId;
 }
 
+static void offscreen_cache_unlink(rdpOffscreenCache* offscreen, OFFSCREEN_CACHE_ENTRY* entry)
+{
+	if (entry->prev != NULL)
+		entry->prev->next = entry->next;
+	else
+		offscreen->head = entry->next;
+
+	if (entry->next != NULL)
+		entry->next->prev = entry->prev;
+	else
+		offscreen->tail = entry->prev;
+
+	entry->prev = entry->next = NULL;
+}
+
+static void offscreen_cache_touch(rdpOffscreenCache* offscreen, OFFSCREEN_CACHE_ENTRY* entry)
+{
+	if (offscreen->head == entry)
+		return;
+
+	/* an entry other than the head is linked if it has a previous one */
+
+	if (entry->prev != NULL)
+		offscreen_cache_unlink(offscreen, entry);
+
+	entry->next = offscreen->head;
+
+	if (offscreen->head != NULL)
+		offscreen->head->prev = entry;
+	else
+		offscreen->tail = entry;
+
+	offscreen->head = entry;
+}
+
+/**
+ * Report a cache over its ceiling. The server owns the offscreen bitmaps and
+ * will draw from them again, so they are left to the application to act on.
+ */
+
+static void offscreen_cache_check_budget(rdpOffscreenCache* offscreen)
+{
+	/* no ceiling without offscreen bitmap support */
+
+	if ((offscreen->maxBytes == 0) || (offscreen->usedBytes <= offscreen->maxBytes))
+		return;
+
+	IFCALL(offscreen->OffscreenPressure, offscreen->update->context, offscreen->usedBytes, offscreen->maxBytes);
+}
+
 rdpBitmap* offscreen_cache_get(rdpOffscreenCache* offscreen_cache, UINT32 index)
 {
 	rdpBitmap* bitmap;
@@ -91,11 +142,16 @@ rdpBitmap* offscreen_cache_get(rdpOffscreenCache* offscreen_cache, UINT32 index)
 		return NULL;
 	}
 
+	offscreen_cache_touch(offscreen_cache, &offscreen_cache->lru[index]);
+
 	return bitmap;
 }
 
 void offscreen_cache_put(rdpOffscreenCache* offscreen, UINT32 index, rdpBitmap* bitmap)
 {
+	UINT32 bpp;
+	OFFSCREEN_CACHE_ENTRY* entry;
+
 	if (index >= offscreen->maxEntries)
 	{
 		printf("invalid offscreen bitmap index: 0x%04X\n", index);
@@ -104,11 +160,24 @@ void offscreen_cache_put(rdpOffscreenCache* offscreen, UINT32 index, rdpBitmap*
 
 	offscreen_cache_delete(offscreen, index);
 	offscreen->entries[index] = bitmap;
+
+	if (bitmap == NULL)
+		return;
+
+	bpp = (offscreen->settings->color_depth + 7) / 8;
+
+	entry = &offscreen->lru[index];
+	entry->size = bitmap->width * bitmap->height * bpp;
+	offscreen->usedBytes += entry->size;
+	offscreen_cache_touch(offscreen, entry);
+
+	offscreen_cache_check_budget(offscreen);
 }
 
 void offscreen_cache_delete(rdpOffscreenCache* offscreen, UINT32 index)
 {
 	rdpBitmap* prevBitmap;
+	OFFSCREEN_CACHE_ENTRY* entry;
 
 	if (index >= offscreen->maxEntries)
 	{
@@ -119,7 +188,14 @@ void offscreen_cache_delete(rdpOffscreenCache* offscreen, UINT32 index)
 	prevBitmap = offscreen->entries[index];
 
 	if (prevBitmap != NULL)
+	{
+		entry = &offscreen->lru[index];
+		offscreen->usedBytes -= entry->size;
+		entry->size = 0;
+		offscreen_cache_unlink(offscreen, entry);
+
 		Bitmap_Free(offscreen->update->context, prevBitmap);
+	}
 
 	offscreen->entries[index] = NULL;
 }
@@ -142,13 +218,25 @@ rdpOffscreenCache* offscreen_cache_new(rdpSettings* settings)
 		offscreen_cache->update = ((freerdp*) settings->instance)->update;
 
 		offscreen_cache->currentSurface = SCREEN_BITMAP_SURFACE;
-		offscreen_cache->maxSize = 7680;
-		offscreen_cache->maxEntries = 2000;
+		offscreen_cache->maxSize = settings->offscreen_bitmap_cache_size;
+		offscreen_cache->maxEntries = settings->offscreen_bitmap_cache_entries;
+
+		/* offscreenCacheSize is in kilobytes, 7680 at most */
+
+		if ((offscreen_cache->maxSize == 0) || (offscreen_cache->maxSize > 7680))
+			offscreen_cache->maxSize = 7680;
+
+		if (offscreen_cache->maxEntries == 0)
+			offscreen_cache->maxEntries = 2000;
 
 		settings->offscreen_bitmap_cache_size = offscreen_cache->maxSize;
 		settings->offscreen_bitmap_cache_entries = offscreen_cache->maxEntries;
 
+		if (settings->offscreen_bitmap_cache)
+			offscreen_cache->maxBytes = offscreen_cache->maxSize * 1024;
+
 		offscreen_cache->entries = (rdpBitmap**) xzalloc(sizeof(rdpBitmap*) * offscreen_cache->maxEntries);
+		offscreen_cache->lru = (OFFSCREEN_CACHE_ENTRY*) xzalloc(sizeof(OFFSCREEN_CACHE_ENTRY) * offscreen_cache->maxEntries);
 	}
 
 	return offscreen_cache;
@@ -170,6 +258,7 @@ void offscreen_cache_free(rdpOffscreenCache* offscreen_cache)
 		}
 
 		free(offscreen_cache->entries);
+		free(offscreen_cache->lru);
 		free(offscreen_cache);
 	}
 }
@@ -1,6 +1,6 @@
 /**
  * FreeRDP: A Remote Desktop Protocol Implementation
- * Glyph Cache
+ * Pointer Cache
  *
  * Copyright 2011 Marc-Andre Moreau <marcandre.moreau@gmail.com>
  *
@@ -22,6 +22,8 @@
 #endif
 
 #include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
 
 #include <freerdp/utils/stream.h>
 #include <freerdp/utils/memory.h>
@@ -50,54 +52,114 @@ void update_pointer_system(rdpContext* context, POINTER_SYSTEM_UPDATE* pointer_s
 	}
 }
 
-void update_pointer_color(rdpContext* context, POINTER_COLOR_UPDATE* pointer_color)
+/**
+ * Set a cache slot to a cursor and make it the current one. The cursor is
+ * converted only if no identical cursor is cached already, the mask data
+ * belongs to the cache afterwards.
+ */
+
+static void update_pointer_put(rdpContext* context, UINT32 index, rdpPointer* attributes)
 {
 	rdpPointer* pointer;
-	rdpCache* cache = context->cache;
+	rdpPointerCache* pointer_cache = context->cache->pointer;
+
+	if (index >= pointer_cache->cacheSize)
+	{
+		printf("invalid pointer index:%d\n", index);
+		free(attributes->xorMaskData);
+		free(attributes->andMaskData);
+		return;
+	}
 
-	pointer = Pointer_Alloc(context);
+	pointer = pointer_cache_find(pointer_cache, attributes);
 
 	if (pointer != NULL)
 	{
-		pointer->xorBpp = 24;
-		pointer->xPos = pointer_color->xPos;
-		pointer->yPos = pointer_color->yPos;
-		pointer->width = pointer_color->width;
-		pointer->height = pointer_color->height;
-		pointer->lengthAndMask = pointer_color->lengthAndMask;
-		pointer->lengthXorMask = pointer_color->lengthXorMask;
-		pointer->xorMaskData = pointer_color->xorMaskData;
-		pointer->andMaskData = pointer_color->andMaskData;
+		pointer_cache->hits++;
+		free(attributes->xorMaskData);
+		free(attributes->andMaskData);
+	}
+	else
+	{
+		pointer = Pointer_Alloc(context);
+
+		if (pointer == NULL)
+		{
+			free(attributes->xorMaskData);
+			free(attributes->andMaskData);
+			return;
+		}
+
+		pointer->xorBpp = attributes->xorBpp;
+		pointer->xPos = attributes->xPos;
+		pointer->yPos = attributes->yPos;
+		pointer->width = attributes->width;
+		pointer->height = attributes->height;
+		pointer->lengthAndMask = attributes->lengthAndMask;
+		pointer->lengthXorMask = attributes->lengthXorMask;
+		pointer->xorMaskData = attributes->xorMaskData;
+		pointer->andMaskData = attributes->andMaskData;
 
 		pointer->New(context, pointer);
-		pointer_cache_put(cache->pointer, pointer_color->cacheIndex, pointer);
-		Pointer_Set(context, pointer);
+		pointer_cache->misses++;
 	}
+
+	pointer_cache_put(pointer_cache, index, pointer);
+	Pointer_Set(context, pointer);
+}
+
+void update_pointer_color(rdpContext* context, POINTER_COLOR_UPDATE* pointer_color)
+{
+	rdpPointer attributes;
+
+	attributes.xorBpp = 24;
+	attributes.xPos = pointer_color->xPos;
+	attributes.yPos = pointer_color->yPos;
+	attributes.width = pointer_color->width;
+	attributes.height = pointer_color->height;
+	attributes.lengthAndMask = pointer_color->lengthAndMask;
+	attributes.lengthXorMask = pointer_color->lengthXorMask;
+	attributes.xorMaskData = pointer_color->xorMaskData;
+	attributes.andMaskData = pointer_color->andMaskData;
+
+	update_pointer_put(context, pointer_color->cacheIndex, &attributes);
 }
 
 void update_pointer_new(rdpContext* context, POINTER_NEW_UPDATE* pointer_new)
 {
-	rdpPointer* pointer;
-	rdpCache* cache = context->cache;
+	rdpPointer attributes;
+
+	attributes.xorBpp = pointer_new->xorBpp;
+	attributes.xPos = pointer_new->colorPtrAttr.xPos;
+	attributes.yPos = pointer_new->colorPtrAttr.yPos;
+	attributes.width = pointer_new->colorPtrAttr.width;
+	attributes.height = pointer_new->colorPtrAttr.height;
+	attributes.lengthAndMask = pointer_new->colorPtrAttr.lengthAndMask;
+	attributes.lengthXorMask = pointer_new->colorPtrAttr.lengthXorMask;
+	attributes.xorMaskData = pointer_new->colorPtrAttr.xorMaskData;
+	attributes.andMaskData = pointer_new->colorPtrAttr.andMaskData;
+
+	update_pointer_put(context, pointer_new->colorPtrAttr.cacheIndex, &attributes);
+}
 
-	pointer = Pointer_Alloc(context);
+void update_pointer_large(rdpContext* context, POINTER_LARGE_UPDATE* pointer_large)
+{
+	rdpPointer attributes;
 
-	if (pointer != NULL)
-	{
-		pointer->xorBpp = pointer_new->xorBpp;
-		pointer->xPos = pointer_new->colorPtrAttr.xPos;
-		pointer->yPos = pointer_new->colorPtrAttr.yPos;
-		pointer->width = pointer_new->colorPtrAttr.width;
-		pointer->height = pointer_new->colorPtrAttr.height;
-		pointer->lengthAndMask = pointer_new->colorPtrAttr.lengthAndMask;
-		pointer->lengthXorMask = pointer_new->colorPtrAttr.lengthXorMask;
-		pointer->xorMaskData = pointer_new->colorPtrAttr.xorMaskData;
-		pointer->andMaskData = pointer_new->colorPtrAttr.andMaskData;
+	if ((pointer_large->width == 0) || (pointer_large->height == 0))
+		return;
 
-		pointer->New(context, pointer);
-		pointer_cache_put(cache->pointer, pointer_new->colorPtrAttr.cacheIndex, pointer);
-		Pointer_Set(context, pointer);
-	}
+	attributes.xorBpp = pointer_large->xorBpp;
+	attributes.xPos = pointer_large->hotSpotX;
+	attributes.yPos = pointer_large->hotSpotY;
+	attributes.width = pointer_large->width;
+	attributes.height = pointer_large->height;
+	attributes.lengthAndMask = pointer_large->lengthAndMask;
+	attributes.lengthXorMask = pointer_large->lengthXorMask;
+	attributes.xorMaskData = pointer_large->xorMaskData;
+	attributes.andMaskData = pointer_large->andMaskData;
+
+	update_pointer_put(context, pointer_large->cacheIndex, &attributes);
 }
 
 void update_pointer_cached(rdpContext* context, POINTER_CACHED_UPDATE* pointer_cached)
@@ -111,6 +173,103 @@ void update_pointer_cached(rdpContext* context, POINTER_CACHED_UPDATE* pointer_c
 		Pointer_Set(context, pointer);
 }
 
+static UINT32 pointer_cache_hash(rdpPointer* pointer)
+{
+	UINT32 i;
+	UINT32 hash = 2166136261U;
+
+	hash = (hash ^ pointer->xorBpp) * 16777619U;
+	hash = (hash ^ pointer->xPos) * 16777619U;
+	hash = (hash ^ pointer->yPos) * 16777619U;
+	hash = (hash ^ pointer->width) * 16777619U;
+	hash = (hash ^ pointer->height) * 16777619U;
+
+	for (i = 0; i < pointer->lengthXorMask; i++)
+		hash = (hash ^ pointer->xorMaskData[i]) * 16777619U;
+
+	for (i = 0; i < pointer->lengthAndMask; i++)
+		hash = (hash ^ pointer->andMaskData[i]) * 16777619U;
+
+	return hash;
+}
+
+static BOOL pointer_cache_equal(rdpPointer* pointer1, rdpPointer* pointer2)
+{
+	if ((pointer1->xorBpp != pointer2->xorBpp) ||
+			(pointer1->xPos != pointer2->xPos) || (pointer1->yPos != pointer2->yPos) ||
+			(pointer1->width != pointer2->width) || (pointer1->height != pointer2->height) ||
+			(pointer1->lengthXorMask != pointer2->lengthXorMask) ||
+			(pointer1->lengthAndMask != pointer2->lengthAndMask))
+		return FALSE;
+
+	if ((pointer1->lengthXorMask > 0) &&
+			(memcmp(pointer1->xorMaskData, pointer2->xorMaskData, pointer1->lengthXorMask) != 0))
+		return FALSE;
+
+	if ((pointer1->lengthAndMask > 0) &&
+			(memcmp(pointer1->andMaskData, pointer2->andMaskData, pointer1->lengthAndMask) != 0))
+		return FALSE;
+
+	return TRUE;
+}
+
+static POINTER_CACHE_IMAGE* pointer_cache_image(rdpPointerCache* pointer_cache, rdpPointer* pointer)
+{
+	UINT32 i;
+
+	for (i = 0; i < pointer_cache->imageCount; i++)
+	{
+		if (pointer_cache->images[i].pointer == pointer)
+			return &pointer_cache->images[i];
+	}
+
+	return NULL;
+}
+
+static void pointer_cache_release(rdpPointerCache* pointer_cache, rdpPointer* pointer)
+{
+	POINTER_CACHE_IMAGE* image;
+
+	image = pointer_cache_image(pointer_cache, pointer);
+
+	if (image == NULL)
+		return;
+
+	image->refCount--;
+
+	if (image->refCount == 0)
+	{
+		Pointer_Free(pointer_cache->update->context, pointer);
+		*image = pointer_cache->images[--pointer_cache->imageCount];
+	}
+}
+
+/**
+ * Find a cached cursor with the same attributes and masks as a new one.
+ * @param pointer_cache pointer cache
+ * @param pointer cursor attributes and mask data
+ * @return cached cursor, NULL if none matches
+ */
+
+rdpPointer* pointer_cache_find(rdpPointerCache* pointer_cache, rdpPointer* pointer)
+{
+	UINT32 i;
+	UINT32 key;
+	POINTER_CACHE_IMAGE* image;
+
+	key = pointer_cache_hash(pointer);
+
+	for (i = 0; i < pointer_cache->imageCount; i++)
+	{
+		image = &pointer_cache->images[i];
+
+		if ((image->key == key) && pointer_cache_equal(image->pointer, pointer))
+			return image->pointer;
+	}
+
+	return NULL;
+}
+
 rdpPointer* pointer_cache_get(rdpPointerCache* pointer_cache, UINT32 index)
 {
 	rdpPointer* pointer;
@@ -126,9 +285,15 @@ rdpPointer* pointer_cache_get(rdpPointerCache* pointer_cache, UINT32 index)
 	return pointer;
 }
 
+/**
+ * Set a cache slot. The slot takes a reference on the cursor, the cursor
+ * previously in the slot is freed when no other slot refers to it.
+ */
+
 void pointer_cache_put(rdpPointerCache* pointer_cache, UINT32 index, rdpPointer* pointer)
 {
 	rdpPointer* prevPointer;
+	POINTER_CACHE_IMAGE* image;
 
 	if (index >= pointer_cache->cacheSize)
 	{
@@ -136,10 +301,25 @@ void pointer_cache_put(rdpPointerCache* pointer_cache, UINT32 index, rdpPointer*
 		return;
 	}
 
+	if (pointer != NULL)
+	{
+		image = pointer_cache_image(pointer_cache, pointer);
+
+		if (image == NULL)
+		{
+			image = &pointer_cache->images[pointer_cache->imageCount++];
+			image->key = pointer_cache_hash(pointer);
+			image->refCount = 0;
+			image->pointer = pointer;
+		}
+
+		image->refCount++;
+	}
+
 	prevPointer = pointer_cache->entries[index];
 
 	if (prevPointer != NULL)
-		Pointer_Free(pointer_cache->update->context, prevPointer);
+		pointer_cache_release(pointer_cache, prevPointer);
 
 	pointer_cache->entries[index] = pointer;
 }
@@ -153,6 +333,7 @@ void pointer_cache_register_callbacks(rdpUpdate* update)
 	pointer->PointerColor = update_pointer_color;
 	pointer->PointerNew = update_pointer_new;
 	pointer->PointerCached = update_pointer_cached;
+	pointer->PointerLarge = update_pointer_large;
 }
 
 rdpPointerCache* pointer_cache_new(rdpSettings* settings)
@@ -167,6 +348,9 @@ rdpPointerCache* pointer_cache_new(rdpSettings* settings)
 		pointer_cache->cacheSize = settings->pointer_cache_size;
 		pointer_cache->update = ((freerdp*) settings->instance)->update;
 		pointer_cache->entries = (rdpPointer**) xzalloc(sizeof(rdpPointer*) * pointer_cache->cacheSize);
+
+		/* one more image than slots, a slot takes its new cursor before releasing the old one */
+		pointer_cache->images = (POINTER_CACHE_IMAGE*) xzalloc(sizeof(POINTER_CACHE_IMAGE) * (pointer_cache->cacheSize + 1));
 	}
 
 	return pointer_cache;
@@ -176,17 +360,12 @@ void pointer_cache_free(rdpPointerCache* pointer_cache)
 {
 	if (pointer_cache != NULL)
 	{
-		int i;
-		rdpPointer* pointer;
+		UINT32 i;
 
-		for (i = 0; i < (int) pointer_cache->cacheSize; i++)
-		{
-			pointer = pointer_cache->entries[i];
-
-			if (pointer != NULL)
-				Pointer_Free(pointer_cache->update->context, pointer);
-		}
+		for (i = 0; i < pointer_cache->imageCount; i++)
+			Pointer_Free(pointer_cache->update->context, pointer_cache->images[i].pointer);
 
+		free(pointer_cache->images);
 		free(pointer_cache->entries);
 		free(pointer_cache);
 	}
@@ -0,0 +1,357 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Server-Side Cache Manager
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <freerdp/utils/memory.h>
+
+#include <freerdp/cache/server.h>
+
+/**
+ * Each cache keeps its entries in an array indexed by cache index, a hash table
+ * of chained entries to find a key, and a doubly linked list in order of use.
+ * The head of the list is the most recently used entry, the tail is evicted.
+ */
+
+static UINT32 server_cache_hash(UINT64 key)
+{
+	return ((UINT32) (key ^ (key >> 32))) * 0x9E3779B1;
+}
+
+static void server_cache_clear(SERVER_CACHE* cache)
+{
+	cache->count = 0;
+	cache->head = SERVER_CACHE_NONE;
+	cache->tail = SERVER_CACHE_NONE;
+
+	if (cache->buckets != NULL)
+		memset(cache->buckets, 0xFF, sizeof(UINT32) * (cache->mask + 1));
+}
+
+static void server_cache_init(SERVER_CACHE* cache, UINT32 number, UINT32 maxCellSize)
+{
+	UINT32 size;
+
+	cache->number = number;
+	cache->maxCellSize = maxCellSize;
+
+	if (number > 0)
+	{
+		for (size = 16; size < number * 2; size <<= 1);
+
+		cache->mask = size - 1;
+		cache->buckets = (UINT32*) malloc(sizeof(UINT32) * size);
+		cache->entries = (SERVER_CACHE_ENTRY*) xzalloc(sizeof(SERVER_CACHE_ENTRY) * number);
+	}
+
+	server_cache_clear(cache);
+}
+
+static void server_cache_uninit(SERVER_CACHE* cache)
+{
+	free(cache->buckets);
+	free(cache->entries);
+}
+
+static void server_cache_unlink(SERVER_CACHE* cache, UINT32 index)
+{
+	SERVER_CACHE_ENTRY* entry = &cache->entries[index];
+
+	if (entry->prev != SERVER_CACHE_NONE)
+		cache->entries[entry->prev].next = entry->next;
+	else
+		cache->head = entry->next;
+
+	if (entry->next != SERVER_CACHE_NONE)
+		cache->entries[entry->next].prev = entry->prev;
+	else
+		cache->tail = entry->prev;
+}
+
+static void server_cache_push(SERVER_CACHE* cache, UINT32 index)
+{
+	SERVER_CACHE_ENTRY* entry = &cache->entries[index];
+
+	entry->prev = SERVER_CACHE_NONE;
+	entry->next = cache->head;
+
+	if (cache->head != SERVER_CACHE_NONE)
+		cache->entries[cache->head].prev = index;
+	else
+		cache->tail = index;
+
+	cache->head = index;
+}
+
+static void server_cache_remove_key(SERVER_CACHE* cache, UINT32 index)
+{
+	UINT32* link;
+
+	link = &cache->buckets[server_cache_hash(cache->entries[index].key) & cache->mask];
+
+	while (*link != index)
+		link = &cache->entries[*link].chain;
+
+	*link = cache->entries[index].chain;
+}
+
+static BOOL server_cache_lookup(rdpServerCache* server_cache, SERVER_CACHE* cache, UINT64 key, UINT32* index)
+{
+	UINT32 i;
+	UINT32 bucket;
+
+	if (cache->number < 1)
+	{
+		*index = SERVER_CACHE_NONE;
+		return FALSE;
+	}
+
+	bucket = server_cache_hash(key) & cache->mask;
+
+	for (i = cache->buckets[bucket]; i != SERVER_CACHE_NONE; i = cache->entries[i].chain)
+	{
+		if (cache->entries[i].key == key)
+		{
+			if (cache->head != i)
+			{
+				server_cache_unlink(cache, i);
+				server_cache_push(cache, i);
+			}
+
+			server_cache->hits++;
+			*index = i;
+			return TRUE;
+		}
+	}
+
+	server_cache->misses++;
+
+	if (cache->count < cache->number)
+	{
+		i = cache->count++;
+	}
+	else
+	{
+		i = cache->tail;
+		server_cache_unlink(cache, i);
+		server_cache_remove_key(cache, i);
+		server_cache->evictions++;
+	}
+
+	cache->entries[i].key = key;
+	cache->entries[i].chain = cache->buckets[bucket];
+	cache->buckets[bucket] = i;
+	server_cache_push(cache, i);
+
+	*index = i;
+	return FALSE;
+}
+
+/**
+ * Compute a cache key for bitmap or glyph data (64-bit FNV-1a).
+ * @param data data to identify
+ * @param length length of the data
+ * @return cache key
+ */
+
+UINT64 server_cache_key(BYTE* data, int length)
+{
+	int i;
+	UINT64 hash = 0xCBF29CE484222325ULL;
+
+	for (i = 0; i < length; i++)
+	{
+		hash ^= data[i];
+		hash *= 0x100000001B3ULL;
+	}
+
+	return hash;
+}
+
+/**
+ * Find the bitmap cell for a bitmap of the given size.
+ * Cells follow the usual revision 2 layout of 256, 1024, 4096... pixels.
+ * @param server_cache server cache
+ * @param width bitmap width
+ * @param height bitmap height
+ * @return cell id, or -1 if no cell advertised by the client can hold the bitmap
+ */
+
+int server_cache_bitmap_id(rdpServerCache* server_cache, int width, int height)
+{
+	UINT32 id;
+	SERVER_CACHE* cell;
+
+	for (id = 0; id < server_cache->maxBitmapCells; id++)
+	{
+		cell = &server_cache->bitmapCells[id];
+
+		if ((cell->number > 0) && ((UINT32) (width * height) <= cell->maxCellSize))
+			return id;
+	}
+
+	return -1;
+}
+
+/**
+ * Look up a bitmap in a bitmap cell.
+ * On a miss the bitmap is assigned an index, evicting the least recently used
+ * bitmap when the cell is full, and has to be sent with a CacheBitmapV2 order.
+ * @param server_cache server cache
+ * @param id bitmap cell id
+ * @param key bitmap key
+ * @param index cache index of the bitmap
+ * @return TRUE if the client already holds the bitmap
+ */
+
+BOOL server_cache_bitmap_lookup(rdpServerCache* server_cache, UINT32 id, UINT64 key, UINT32* index)
+{
+	if (id >= server_cache->maxBitmapCells)
+	{
+		printf("server_cache_bitmap_lookup: invalid bitmap cell id: %d\n", id);
+		*index = SERVER_CACHE_NONE;
+		return FALSE;
+	}
+
+	return server_cache_lookup(server_cache, &server_cache->bitmapCells[id], key, index);
+}
+
+/**
+ * Find the glyph cache for glyph data of the given size.
+ * @param server_cache server cache
+ * @param size size of the glyph bitmap in bytes
+ * @return glyph cache id, or -1 if no glyph cache advertised by the client can hold the glyph
+ */
+
+int server_cache_glyph_id(rdpServerCache* server_cache, int size)
+{
+	UINT32 id;
+	SERVER_CACHE* cache;
+
+	for (id = 0; id < ARRAY_SIZE(server_cache->glyphCaches); id++)
+	{
+		cache = &server_cache->glyphCaches[id];
+
+		if ((cache->number > 0) && ((UINT32) size <= cache->maxCellSize))
+			return id;
+	}
+
+	return -1;
+}
+
+/**
+ * Look up a glyph in a glyph cache.
+ * On a miss the glyph is assigned an index, evicting the least recently used
+ * glyph when the cache is full, and has to be sent with a CacheGlyph order.
+ * @param server_cache server cache
+ * @param id glyph cache id
+ * @param key glyph key
+ * @param index cache index of the glyph
+ * @return TRUE if the client already holds the glyph
+ */
+
+BOOL server_cache_glyph_lookup(rdpServerCache* server_cache, UINT32 id, UINT64 key, UINT32* index)
+{
+	if (id >= ARRAY_SIZE(server_cache->glyphCaches))
+	{
+		printf("server_cache_glyph_lookup: invalid glyph cache id: %d\n", id);
+		*index = SERVER_CACHE_NONE;
+		return FALSE;
+	}
+
+	return server_cache_lookup(server_cache, &server_cache->glyphCaches[id], key, index);
+}
+
+/**
+ * Forget all cached entries, as the client does on reactivation.
+ * @param server_cache server cache
+ */
+
+void server_cache_reset(rdpServerCache* server_cache)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(server_cache->bitmapCells); i++)
+		server_cache_clear(&server_cache->bitmapCells[i]);
+
+	for (i = 0; i < ARRAY_SIZE(server_cache->glyphCaches); i++)
+		server_cache_clear(&server_cache->glyphCaches[i]);
+
+	server_cache->hits = 0;
+	server_cache->misses = 0;
+	server_cache->evictions = 0;
+}
+
+rdpServerCache* server_cache_new(rdpSettings* settings)
+{
+	int i;
+	rdpServerCache* server_cache;
+
+	server_cache = (rdpServerCache*) xzalloc(sizeof(rdpServerCache));
+
+	if (server_cache != NULL)
+	{
+		server_cache->settings = settings;
+
+		if (settings->bitmap_cache)
+		{
+			server_cache->maxBitmapCells = settings->bitmapCacheV2NumCells;
+
+			if (server_cache->maxBitmapCells > ARRAY_SIZE(server_cache->bitmapCells))
+				server_cache->maxBitmapCells = ARRAY_SIZE(server_cache->bitmapCells);
+		}
+
+		for (i = 0; i < (int) server_cache->maxBitmapCells; i++)
+		{
+			server_cache_init(&server_cache->bitmapCells[i],
+					settings->bitmapCacheV2CellInfo[i].numEntries, 256 << (i * 2));
+		}
+
+		for (i = 0; i < ARRAY_SIZE(server_cache->glyphCaches); i++)
+		{
+			if (settings->glyphSupportLevel == GLYPH_SUPPORT_NONE)
+				break;
+
+			server_cache_init(&server_cache->glyphCaches[i],
+					settings->glyphCache[i].cacheEntries, settings->glyphCache[i].cacheMaximumCellSize);
+		}
+	}
+
+	return server_cache;
+}
+
+void server_cache_free(rdpServerCache* server_cache)
+{
+	int i;
+
+	if (server_cache != NULL)
+	{
+		for (i = 0; i < ARRAY_SIZE(server_cache->bitmapCells); i++)
+			server_cache_uninit(&server_cache->bitmapCells[i]);
+
+		for (i = 0; i < ARRAY_SIZE(server_cache->glyphCaches); i++)
+			server_cache_uninit(&server_cache->glyphCaches[i]);
+
+		free(server_cache);
+	}
+}
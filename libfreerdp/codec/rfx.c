@@ -48,6 +48,10 @@
 #include "rfx_neon.h"
 #endif
 
+#ifdef WITH_AVX2
+#include "rfx_avx2.h"
+#endif
+
 #ifndef RFX_INIT_SIMD
 #define RFX_INIT_SIMD(_rfx_context) do { } while (0)
 #endif
@@ -69,6 +73,35 @@ static const UINT32 rfx_default_quantization_values[] =
 	6, 6, 6, 6, 7, 7, 8, 8, 8, 9
 };
 
+/**
+ * With a frame budget, the encoder sends these quantization sets and picks
+ * one of them for each tile. The first one holds the default values, the
+ * following ones get coarser, the high frequencies first since they matter
+ * least for the quality.
+ */
+static const UINT32 rfx_rate_quantization_values[RFX_RATE_LEVELS * 10] =
+{
+	6, 6, 6, 6, 7, 7, 8, 8, 8, 9,
+	6, 6, 6, 6, 7, 7, 8, 9, 9, 10,
+	6, 6, 6, 6, 8, 8, 9, 10, 10, 11,
+	6, 7, 7, 7, 8, 8, 9, 11, 11, 12,
+	6, 7, 7, 7, 9, 9, 10, 12, 12, 13,
+	7, 8, 8, 8, 10, 10, 11, 13, 13, 14,
+	7, 8, 8, 9, 10, 10, 11, 14, 14, 15,
+	7, 9, 9, 10, 11, 11, 12, 15, 15, 15,
+	8, 9, 9, 10, 12, 12, 13, 15, 15, 15,
+	8, 10, 10, 11, 13, 13, 14, 15, 15, 15,
+	9, 10, 10, 11, 14, 14, 15, 15, 15, 15,
+	9, 11, 11, 12, 15, 15, 15, 15, 15, 15,
+	10, 12, 12, 13, 15, 15, 15, 15, 15, 15,
+	11, 13, 13, 14, 15, 15, 15, 15, 15, 15,
+	12, 14, 14, 15, 15, 15, 15, 15, 15, 15,
+	13, 15, 15, 15, 15, 15, 15, 15, 15, 15
+};
+
+/* smallest size a tile is assumed to take at the coarsest level */
+#define RFX_RATE_MIN_TILE_SIZE		64
+
 static void rfx_profiler_create(RFX_CONTEXT* context)
 {
 	PROFILER_CREATE(context->priv->prof_rfx_decode_rgb, "rfx_decode_rgb");
@@ -77,6 +110,7 @@ static void rfx_profiler_create(RFX_CONTEXT* context)
 	PROFILER_CREATE(context->priv->prof_rfx_differential_decode, "rfx_differential_decode");
 	PROFILER_CREATE(context->priv->prof_rfx_quantization_decode, "rfx_quantization_decode");
 	PROFILER_CREATE(context->priv->prof_rfx_dwt_2d_decode, "rfx_dwt_2d_decode");
+	PROFILER_CREATE(context->priv->prof_rfx_dwt_2d_quantization_decode, "rfx_dwt_2d_quantization_decode");
 	PROFILER_CREATE(context->priv->prof_rfx_decode_ycbcr_to_rgb, "rfx_decode_ycbcr_to_rgb");
 	PROFILER_CREATE(context->priv->prof_rfx_decode_format_rgb, "rfx_decode_format_rgb");
 
@@ -86,6 +120,7 @@ static void rfx_profiler_create(RFX_CONTEXT* context)
 	PROFILER_CREATE(context->priv->prof_rfx_differential_encode, "rfx_differential_encode");
 	PROFILER_CREATE(context->priv->prof_rfx_quantization_encode, "rfx_quantization_encode");
 	PROFILER_CREATE(context->priv->prof_rfx_dwt_2d_encode, "rfx_dwt_2d_encode");
+	PROFILER_CREATE(context->priv->prof_rfx_dwt_2d_quantization_encode, "rfx_dwt_2d_quantization_encode");
 	PROFILER_CREATE(context->priv->prof_rfx_encode_rgb_to_ycbcr, "rfx_encode_rgb_to_ycbcr");
 	PROFILER_CREATE(context->priv->prof_rfx_encode_format_rgb, "rfx_encode_format_rgb");
 }
@@ -98,6 +133,7 @@ static void rfx_profiler_free(RFX_CONTEXT* context)
 	PROFILER_FREE(context->priv->prof_rfx_differential_decode);
 	PROFILER_FREE(context->priv->prof_rfx_quantization_decode);
 	PROFILER_FREE(context->priv->prof_rfx_dwt_2d_decode);
+	PROFILER_FREE(context->priv->prof_rfx_dwt_2d_quantization_decode);
 	PROFILER_FREE(context->priv->prof_rfx_decode_ycbcr_to_rgb);
 	PROFILER_FREE(context->priv->prof_rfx_decode_format_rgb);
 
@@ -107,6 +143,7 @@ static void rfx_profiler_free(RFX_CONTEXT* context)
 	PROFILER_FREE(context->priv->prof_rfx_differential_encode);
 	PROFILER_FREE(context->priv->prof_rfx_quantization_encode);
 	PROFILER_FREE(context->priv->prof_rfx_dwt_2d_encode);
+	PROFILER_FREE(context->priv->prof_rfx_dwt_2d_quantization_encode);
 	PROFILER_FREE(context->priv->prof_rfx_encode_rgb_to_ycbcr);
 	PROFILER_FREE(context->priv->prof_rfx_encode_format_rgb);
 }
@@ -121,6 +158,7 @@ static void rfx_profiler_print(RFX_CONTEXT* context)
 	PROFILER_PRINT(context->priv->prof_rfx_differential_decode);
 	PROFILER_PRINT(context->priv->prof_rfx_quantization_decode);
 	PROFILER_PRINT(context->priv->prof_rfx_dwt_2d_decode);
+	PROFILER_PRINT(context->priv->prof_rfx_dwt_2d_quantization_decode);
 	PROFILER_PRINT(context->priv->prof_rfx_decode_ycbcr_to_rgb);
 	PROFILER_PRINT(context->priv->prof_rfx_decode_format_rgb);
 
@@ -130,6 +168,7 @@ static void rfx_profiler_print(RFX_CONTEXT* context)
 	PROFILER_PRINT(context->priv->prof_rfx_differential_encode);
 	PROFILER_PRINT(context->priv->prof_rfx_quantization_encode);
 	PROFILER_PRINT(context->priv->prof_rfx_dwt_2d_encode);
+	PROFILER_PRINT(context->priv->prof_rfx_dwt_2d_quantization_encode);
 	PROFILER_PRINT(context->priv->prof_rfx_encode_rgb_to_ycbcr);
 	PROFILER_PRINT(context->priv->prof_rfx_encode_format_rgb);
 
@@ -173,11 +212,18 @@ void rfx_context_set_cpu_opt(RFX_CONTEXT* context, UINT32 cpu_opt)
 	/* enable SIMD CPU acceleration if detected */
 	if (cpu_opt & CPU_SSE2)
 		RFX_INIT_SIMD(context);
+
+#ifdef WITH_AVX2
+	if (cpu_opt & CPU_AVX2)
+		rfx_init_avx2(context);
+#endif
 }
 
 void rfx_context_free(RFX_CONTEXT* context)
 {
 	free(context->quants);
+	free(context->priv->rate_sizes);
+	free(context->priv->rate_levels);
 
 	rfx_pool_free(context->priv->pool);
 
@@ -217,6 +263,17 @@ void rfx_context_set_pixel_format(RFX_CONTEXT* context, RDP_PIXEL_FORMAT pixel_f
 	}
 }
 
+/**
+ * Set the number of bytes the encoder aims at for the data of each frame,
+ * from the frame begin to the frame end block. Tiles are quantized more
+ * coarsely until the frame fits, 0 goes back to the fixed quantization.
+ */
+
+void rfx_context_set_frame_budget(RFX_CONTEXT* context, UINT32 frame_budget)
+{
+	context->frame_budget = frame_budget;
+}
+
 void rfx_context_reset(RFX_CONTEXT* context)
 {
 	context->header_processed = FALSE;
@@ -739,7 +796,7 @@ static void rfx_compose_message_region(RFX_CONTEXT* context, STREAM* s,
 	stream_write_UINT16(s, 1); /* numTilesets */
 }
 
-static void rfx_compose_message_tile(RFX_CONTEXT* context, STREAM* s,
+static int rfx_compose_message_tile(RFX_CONTEXT* context, STREAM* s,
 	BYTE* tile_data, int tile_width, int tile_height, int rowstride,
 	const UINT32* quantVals, int quantIdxY, int quantIdxCb, int quantIdxCr,
 	int xIdx, int yIdx)
@@ -779,10 +836,143 @@ static void rfx_compose_message_tile(RFX_CONTEXT* context, STREAM* s,
 	stream_write_UINT16(s, CrLen);
 
 	stream_set_pos(s, end_pos);
+
+	return end_pos - start_pos;
+}
+
+/**
+ * Encode a tile in at most max_size bytes at the given quantization level,
+ * or at the first coarser one the tile fits in.
+ */
+
+static int rfx_compose_message_tile_budget(RFX_CONTEXT* context, STREAM* s,
+	BYTE* tile_data, int tile_width, int tile_height, int rowstride,
+	const UINT32* quantVals, int xIdx, int yIdx, int max_size, int* level)
+{
+	int size;
+	int start_pos;
+
+	start_pos = stream_get_pos(s);
+
+	while (1)
+	{
+		size = rfx_compose_message_tile(context, s, tile_data, tile_width, tile_height, rowstride,
+			quantVals, *level, *level, *level, xIdx, yIdx);
+
+		if ((size <= max_size) || (*level == RFX_RATE_LEVELS - 1))
+			break;
+
+		stream_set_pos(s, start_pos);
+		(*level)++;
+	}
+
+	return size;
+}
+
+/**
+ * Size a tile of the previous frame would have had at another level,
+ * assuming a tile shrinks by a fifth with each coarser level.
+ */
+
+static int rfx_rate_predict(RFX_CONTEXT_PRIV* priv, int tileIdx, int level)
+{
+	int l;
+	int size;
+
+	size = priv->rate_sizes[tileIdx];
+
+	for (l = priv->rate_levels[tileIdx]; l < level; l++)
+		size = size * 4 / 5;
+
+	for (l = priv->rate_levels[tileIdx]; l > level; l--)
+		size = size * 5 / 4;
+
+	return size;
+}
+
+/**
+ * Choose the finest quantization level the previous frame would have fit
+ * the budget with. The expected size of each tile at that level is left
+ * in rate_sizes as a running total, to pace the frame against.
+ */
+
+static int rfx_rate_begin_frame(RFX_CONTEXT* context, int budget, int numTiles)
+{
+	int i;
+	int level;
+	INT64 total;
+	RFX_CONTEXT_PRIV* priv = context->priv;
+
+	if (priv->rate_num_tiles != numTiles)
+	{
+		priv->rate_sizes = (int*) realloc(priv->rate_sizes, numTiles * sizeof(int));
+		priv->rate_levels = (int*) realloc(priv->rate_levels, numTiles * sizeof(int));
+		priv->rate_num_tiles = numTiles;
+
+		/* no history, spend the budget evenly from the level of the last tile */
+		for (i = 0; i < numTiles; i++)
+		{
+			priv->rate_sizes[i] = 1;
+			priv->rate_levels[i] = priv->rate_level;
+		}
+
+		level = priv->rate_level;
+	}
+	else
+	{
+		for (level = 0; level < RFX_RATE_LEVELS - 1; level++)
+		{
+			total = 0;
+
+			for (i = 0; i < numTiles; i++)
+				total += rfx_rate_predict(priv, i, level);
+
+			if (total <= budget)
+				break;
+		}
+
+		for (i = 0; i < numTiles; i++)
+			priv->rate_sizes[i] = rfx_rate_predict(priv, i, level);
+	}
+
+	for (i = 1; i < numTiles; i++)
+		priv->rate_sizes[i] += priv->rate_sizes[i - 1];
+
+	return level;
+}
+
+/**
+ * Record the size and level of a tile and pick the level of the next one,
+ * coarser when the frame spends its budget faster than expected, finer
+ * when it spends it slower.
+ */
+
+static int rfx_rate_end_tile(RFX_CONTEXT* context, int budget, int spent,
+	int tileIdx, int numTiles, int size, int level)
+{
+	int pace;
+	int share;
+	INT64 expected;
+	RFX_CONTEXT_PRIV* priv = context->priv;
+
+	expected = priv->rate_sizes[numTiles - 1];
+	pace = (expected > 0) ? (int) ((INT64) budget * priv->rate_sizes[tileIdx] / expected) : budget;
+	share = budget / numTiles;
+
+	priv->rate_sizes[tileIdx] = size;
+	priv->rate_levels[tileIdx] = level;
+	priv->rate_level = level;
+
+	if ((spent > pace + share) && (level < RFX_RATE_LEVELS - 1))
+		level++;
+	else if ((spent < pace - share) && (level > 0))
+		level--;
+
+	return level;
 }
 
 static void rfx_compose_message_tileset(RFX_CONTEXT* context, STREAM* s,
-	BYTE* image_data, int width, int height, int rowstride)
+	BYTE* image_data, int width, int height, int rowstride, int budget)
 {
 	int size;
 	int start_pos, end_pos;
@@ -799,8 +989,23 @@ static void rfx_compose_message_tileset(RFX_CONTEXT* context, STREAM* s,
 	int xIdx;
 	int yIdx;
 	int tilesDataSize;
-
-	if (context->num_quants == 0)
+	int tileIdx;
+	int tileSize;
+	int level;
+	int spent;
+	BYTE* tile_data;
+	int tile_width;
+	int tile_height;
+
+	if (context->frame_budget > 0)
+	{
+		numQuants = RFX_RATE_LEVELS;
+		quantVals = rfx_rate_quantization_values;
+		quantIdxY = 0;
+		quantIdxCb = 0;
+		quantIdxCr = 0;
+	}
+	else if (context->num_quants == 0)
 	{
 		numQuants = 1;
 		quantVals = rfx_default_quantization_values;
@@ -846,18 +1051,43 @@ static void rfx_compose_message_tileset(RFX_CONTEXT* context, STREAM* s,
 
 	DEBUG_RFX("width:%d height:%d rowstride:%d", width, height, rowstride);
 
+	budget -= size;
+	spent = 0;
+	tileIdx = 0;
+	level = 0;
+
+	if (context->frame_budget > 0)
+		level = rfx_rate_begin_frame(context, budget, numTiles);
+
 	end_pos = stream_get_pos(s);
 	for (yIdx = 0; yIdx < numTilesY; yIdx++)
 	{
 		for (xIdx = 0; xIdx < numTilesX; xIdx++)
 		{
-			rfx_compose_message_tile(context, s,
-				image_data + yIdx * 64 * rowstride + xIdx * 8 * context->bits_per_pixel,
-				(xIdx < numTilesX - 1) ? 64 : width - xIdx * 64,
-				(yIdx < numTilesY - 1) ? 64 : height - yIdx * 64,
-				rowstride, quantVals, quantIdxY, quantIdxCb, quantIdxCr, xIdx, yIdx);
+			tile_data = image_data + yIdx * 64 * rowstride + xIdx * 8 * context->bits_per_pixel;
+			tile_width = (xIdx < numTilesX - 1) ? 64 : width - xIdx * 64;
+			tile_height = (yIdx < numTilesY - 1) ? 64 : height - yIdx * 64;
+
+			if (context->frame_budget > 0)
+			{
+				/* leave enough for the remaining tiles at the coarsest level */
+				tileSize = rfx_compose_message_tile_budget(context, s, tile_data, tile_width, tile_height,
+					rowstride, quantVals, xIdx, yIdx,
+					budget - spent - (numTiles - tileIdx - 1) * RFX_RATE_MIN_TILE_SIZE, &level);
+
+				spent += tileSize;
+				level = rfx_rate_end_tile(context, budget, spent, tileIdx, numTiles, tileSize, level);
+			}
+			else
+			{
+				rfx_compose_message_tile(context, s, tile_data, tile_width, tile_height,
+					rowstride, quantVals, quantIdxY, quantIdxCb, quantIdxCr, xIdx, yIdx);
+			}
+
+			tileIdx++;
 		}
 	}
+
 	tilesDataSize = stream_get_pos(s) - end_pos;
 	size += tilesDataSize;
 	end_pos = stream_get_pos(s);
@@ -883,9 +1113,18 @@ static void rfx_compose_message_frame_end(RFX_CONTEXT* context, STREAM* s)
 static void rfx_compose_message_data(RFX_CONTEXT* context, STREAM* s,
 	const RFX_RECT* rects, int num_rects, BYTE* image_data, int width, int height, int rowstride)
 {
+	int budget;
+	int start_pos;
+
+	start_pos = stream_get_pos(s);
+
 	rfx_compose_message_frame_begin(context, s);
 	rfx_compose_message_region(context, s, rects, num_rects);
-	rfx_compose_message_tileset(context, s, image_data, width, height, rowstride);
+
+	/* what is left for the tileset once the frame blocks are accounted for */
+	budget = (int) context->frame_budget - (stream_get_pos(s) - start_pos) - 8;
+
+	rfx_compose_message_tileset(context, s, image_data, width, height, rowstride, budget);
 	rfx_compose_message_frame_end(context, s);
 }
 
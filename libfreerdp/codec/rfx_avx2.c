@@ -0,0 +1,581 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * RemoteFX Codec Library - AVX2 Optimizations
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * The AVX2 routines run the whole coefficient pipeline of a component in one
+ * go instead of separate passes over the 4096 coefficients: quantization is
+ * applied as the DWT writes a sub-band and the differential coding of LL3
+ * happens as the last DWT level writes it. Decoding does the reverse while
+ * reading the sub-bands. The results are identical to the separate passes.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <immintrin.h>
+
+#include "rfx_types.h"
+#include "rfx_avx2.h"
+
+#ifdef _MSC_VER
+#define	__attribute__(...)
+#endif
+
+#define RFX_AVX2_INLINE static __inline __m256i __attribute__((__gnu_inline__, __always_inline__, __artificial__))
+
+/* [prev[15], v[0], ..., v[14]] */
+RFX_AVX2_INLINE _mm256_shift_in_prev_epi16(__m256i v, __m256i prev)
+{
+	return _mm256_alignr_epi8(v, _mm256_permute2x128_si256(prev, v, 0x21), 14);
+}
+
+/* [v[1], ..., v[15], next[0]] */
+RFX_AVX2_INLINE _mm256_shift_in_next_epi16(__m256i v, __m256i next)
+{
+	return _mm256_alignr_epi8(_mm256_permute2x128_si256(v, next, 0x21), v, 2);
+}
+
+RFX_AVX2_INLINE _mm256_first_epi16(__m256i v)
+{
+	return _mm256_broadcastw_epi16(_mm256_castsi256_si128(v));
+}
+
+RFX_AVX2_INLINE _mm256_last_epi16(__m256i v)
+{
+	return _mm256_set1_epi16(_mm256_extract_epi16(v, 15));
+}
+
+/* q = (v + half) >> factor, followed by the 11.5 fixed-point scaling (q + 16) >> 5 */
+RFX_AVX2_INLINE _mm256_quantize_epi16(__m256i v, __m256i half, __m128i factor)
+{
+	v = _mm256_sra_epi16(_mm256_add_epi16(v, half), factor);
+	return _mm256_srai_epi16(_mm256_add_epi16(v, _mm256_set1_epi16(16)), 5);
+}
+
+static __inline void __attribute__((__gnu_inline__, __always_inline__, __artificial__))
+_mm256_deinterleave_epi16(INT16* src, __m256i* even, __m256i* odd)
+{
+	__m256i a;
+	__m256i b;
+	const __m256i mask = _mm256_setr_epi8(0, 1, 4, 5, 8, 9, 12, 13, 2, 3, 6, 7, 10, 11, 14, 15,
+		0, 1, 4, 5, 8, 9, 12, 13, 2, 3, 6, 7, 10, 11, 14, 15);
+
+	/* even and odd coefficients in the low and high quadword of each lane */
+	a = _mm256_shuffle_epi8(_mm256_loadu_si256((__m256i*) src), mask);
+	b = _mm256_shuffle_epi8(_mm256_loadu_si256((__m256i*) (src + 16)), mask);
+
+	a = _mm256_permute4x64_epi64(a, 0xD8);
+	b = _mm256_permute4x64_epi64(b, 0xD8);
+
+	*even = _mm256_permute2x128_si256(a, b, 0x20);
+	*odd = _mm256_permute2x128_si256(a, b, 0x31);
+}
+
+static __inline void __attribute__((__gnu_inline__, __always_inline__, __artificial__))
+_mm256_interleave_epi16(INT16* dst, __m256i even, __m256i odd)
+{
+	__m256i lo = _mm256_unpacklo_epi16(even, odd);
+	__m256i hi = _mm256_unpackhi_epi16(even, odd);
+
+	_mm256_storeu_si256((__m256i*) dst, _mm256_permute2x128_si256(lo, hi, 0x20));
+	_mm256_storeu_si256((__m256i*) (dst + 16), _mm256_permute2x128_si256(lo, hi, 0x31));
+}
+
+static INT16 rfx_quantization_encode_value(INT16 value, int factor)
+{
+	if (factor > 0)
+		value = (value + (1 << (factor - 1))) >> factor;
+
+	return (value + 16) >> 5;
+}
+
+static void rfx_dwt_2d_encode_block_vert_avx2(INT16* src, INT16* l, INT16* h, int subband_width)
+{
+	int x;
+	int n;
+	int total_width;
+	__m256i src_2n;
+	__m256i src_2n_1;
+	__m256i src_2n_2;
+	__m256i h_n;
+	__m256i h_n_m;
+	__m256i l_n;
+
+	total_width = subband_width << 1;
+
+	for (n = 0; n < subband_width; n++)
+	{
+		for (x = 0; x < total_width; x += 16)
+		{
+			src_2n = _mm256_loadu_si256((__m256i*) src);
+			src_2n_1 = _mm256_loadu_si256((__m256i*) (src + total_width));
+
+			if (n < subband_width - 1)
+				src_2n_2 = _mm256_loadu_si256((__m256i*) (src + 2 * total_width));
+			else
+				src_2n_2 = src_2n;
+
+			/* h[n] = (src[2n + 1] - ((src[2n] + src[2n + 2]) >> 1)) >> 1 */
+
+			h_n = _mm256_srai_epi16(_mm256_add_epi16(src_2n, src_2n_2), 1);
+			h_n = _mm256_srai_epi16(_mm256_sub_epi16(src_2n_1, h_n), 1);
+
+			_mm256_storeu_si256((__m256i*) h, h_n);
+
+			/* l[n] = src[2n] + ((h[n - 1] + h[n]) >> 1) */
+
+			if (n == 0)
+			{
+				l_n = _mm256_add_epi16(src_2n, h_n);
+			}
+			else
+			{
+				h_n_m = _mm256_loadu_si256((__m256i*) (h - total_width));
+				l_n = _mm256_srai_epi16(_mm256_add_epi16(h_n_m, h_n), 1);
+				l_n = _mm256_add_epi16(src_2n, l_n);
+			}
+
+			_mm256_storeu_si256((__m256i*) l, l_n);
+
+			src += 16;
+			l += 16;
+			h += 16;
+		}
+
+		src += total_width;
+	}
+}
+
+/**
+ * Horizontal DWT of 16 or 32 wide sub-bands. Negative factors leave the
+ * output unquantized, as for the LL band that feeds the next level.
+ */
+
+static void rfx_dwt_2d_encode_block_horiz_avx2(INT16* src, INT16* l, INT16* h, int subband_width,
+	int l_factor, int h_factor)
+{
+	int y;
+	int k;
+	int blocks;
+	__m256i even[2];
+	__m256i odd[2];
+	__m256i h_n[2];
+	__m256i h_q;
+	__m256i next;
+	__m256i prev;
+	__m256i l_n;
+	__m256i l_half;
+	__m256i h_half;
+	__m128i l_shift;
+	__m128i h_shift;
+
+	blocks = subband_width / 16;
+
+	l_half = _mm256_set1_epi16(l_factor > 0 ? 1 << (l_factor - 1) : 0);
+	h_half = _mm256_set1_epi16(h_factor > 0 ? 1 << (h_factor - 1) : 0);
+	l_shift = _mm_cvtsi32_si128(l_factor > 0 ? l_factor : 0);
+	h_shift = _mm_cvtsi32_si128(h_factor > 0 ? h_factor : 0);
+
+	for (y = 0; y < subband_width; y++)
+	{
+		for (k = 0; k < blocks; k++)
+			_mm256_deinterleave_epi16(&src[k * 32], &even[k], &odd[k]);
+
+		/* h[n] = (src[2n + 1] - ((src[2n] + src[2n + 2]) >> 1)) >> 1 */
+
+		for (k = 0; k < blocks; k++)
+		{
+			next = (k < blocks - 1) ? even[k + 1] : _mm256_last_epi16(even[k]);
+			next = _mm256_shift_in_next_epi16(even[k], next);
+
+			h_n[k] = _mm256_srai_epi16(_mm256_add_epi16(even[k], next), 1);
+			h_n[k] = _mm256_srai_epi16(_mm256_sub_epi16(odd[k], h_n[k]), 1);
+		}
+
+		/* l[n] = src[2n] + ((h[n - 1] + h[n]) >> 1) */
+
+		for (k = 0; k < blocks; k++)
+		{
+			prev = (k > 0) ? h_n[k - 1] : _mm256_first_epi16(h_n[0]);
+			prev = _mm256_shift_in_prev_epi16(h_n[k], prev);
+
+			l_n = _mm256_srai_epi16(_mm256_add_epi16(prev, h_n[k]), 1);
+			l_n = _mm256_add_epi16(even[k], l_n);
+
+			if (l_factor >= 0)
+				l_n = _mm256_quantize_epi16(l_n, l_half, l_shift);
+
+			/* h[n] is still needed unquantized for the next block */
+			if (h_factor >= 0)
+				h_q = _mm256_quantize_epi16(h_n[k], h_half, h_shift);
+			else
+				h_q = h_n[k];
+
+			_mm256_storeu_si256((__m256i*) &l[k * 16], l_n);
+			_mm256_storeu_si256((__m256i*) &h[k * 16], h_q);
+		}
+
+		src += subband_width << 1;
+		l += subband_width;
+		h += subband_width;
+	}
+}
+
+/**
+ * Horizontal DWT of the 8 wide third level, where the coefficients of a row
+ * do not fill a vector. With prev set, the L output is differentially coded.
+ */
+
+static void rfx_dwt_2d_encode_block_horiz_8(INT16* src, INT16* l, INT16* h,
+	int l_factor, int h_factor, INT16* prev)
+{
+	int x, y;
+	int n;
+	INT16 h_n[8];
+	INT16 l_n;
+
+	for (y = 0; y < 8; y++)
+	{
+		for (n = 0; n < 8; n++)
+		{
+			x = n << 1;
+			h_n[n] = (src[x + 1] - ((src[x] + src[n < 7 ? x + 2 : x]) >> 1)) >> 1;
+		}
+
+		for (n = 0; n < 8; n++)
+		{
+			x = n << 1;
+			l_n = src[x] + (n == 0 ? h_n[n] : (h_n[n - 1] + h_n[n]) >> 1);
+			l_n = rfx_quantization_encode_value(l_n, l_factor);
+
+			if (prev)
+			{
+				l[n] = l_n - *prev;
+				*prev = l_n;
+			}
+			else
+			{
+				l[n] = l_n;
+			}
+
+			h[n] = rfx_quantization_encode_value(h_n[n], h_factor);
+		}
+
+		src += 16;
+		l += 8;
+		h += 8;
+	}
+}
+
+static void rfx_dwt_2d_encode_block_avx2(INT16* buffer, INT16* dwt, int subband_width,
+	int hl_factor, int lh_factor, int hh_factor)
+{
+	INT16 *hl, *lh, *hh, *ll;
+	INT16 *l_src, *h_src;
+
+	l_src = dwt;
+	h_src = dwt + subband_width * subband_width * 2;
+
+	rfx_dwt_2d_encode_block_vert_avx2(buffer, l_src, h_src, subband_width);
+
+	ll = buffer + subband_width * subband_width * 3;
+	hl = buffer;
+
+	lh = buffer + subband_width * subband_width;
+	hh = buffer + subband_width * subband_width * 2;
+
+	rfx_dwt_2d_encode_block_horiz_avx2(l_src, ll, hl, subband_width, -1, hl_factor);
+	rfx_dwt_2d_encode_block_horiz_avx2(h_src, lh, hh, subband_width, lh_factor, hh_factor);
+}
+
+static void rfx_dwt_2d_encode_block_8_avx2(INT16* buffer, INT16* dwt,
+	int ll_factor, int hl_factor, int lh_factor, int hh_factor)
+{
+	INT16 prev = 0;
+
+	rfx_dwt_2d_encode_block_vert_avx2(buffer, dwt, dwt + 128, 8);
+
+	rfx_dwt_2d_encode_block_horiz_8(dwt, buffer + 192, buffer, ll_factor, hl_factor, &prev);
+	rfx_dwt_2d_encode_block_horiz_8(dwt + 128, buffer + 64, buffer + 128, lh_factor, hh_factor, NULL);
+}
+
+/**
+ * DWT, quantization and differential coding of LL3 in a single pass per level.
+ * The quantization values are in the LL3, LH3, HL3, HH3, LH2, HL2, HH2, LH1, HL1, HH1 order.
+ */
+
+static void rfx_dwt_2d_quantization_encode_avx2(INT16* buffer, INT16* dwt_buffer, const UINT32* quantization_values)
+{
+	const UINT32* q = quantization_values;
+
+	rfx_dwt_2d_encode_block_avx2(buffer, dwt_buffer, 32, q[8] - 6, q[7] - 6, q[9] - 6);
+	rfx_dwt_2d_encode_block_avx2(buffer + 3072, dwt_buffer, 16, q[5] - 6, q[4] - 6, q[6] - 6);
+	rfx_dwt_2d_encode_block_8_avx2(buffer + 3840, dwt_buffer, q[0] - 6, q[2] - 6, q[1] - 6, q[3] - 6);
+}
+
+static void rfx_dwt_2d_decode_block_vert_avx2(INT16* l, INT16* h, INT16* dst, int subband_width)
+{
+	int x;
+	int n;
+	int total_width;
+	INT16* l_ptr = l;
+	INT16* h_ptr = h;
+	INT16* dst_ptr = dst;
+	__m256i l_n;
+	__m256i h_n;
+	__m256i h_n_m;
+	__m256i tmp_n;
+	__m256i dst_n_m;
+	__m256i dst_n_p;
+	const __m256i one = _mm256_set1_epi16(1);
+
+	total_width = subband_width << 1;
+
+	/* Even coefficients */
+	for (n = 0; n < subband_width; n++)
+	{
+		for (x = 0; x < total_width; x += 16)
+		{
+			/* dst[2n] = l[n] - ((h[n - 1] + h[n] + 1) >> 1) */
+
+			l_n = _mm256_loadu_si256((__m256i*) l_ptr);
+			h_n = _mm256_loadu_si256((__m256i*) h_ptr);
+			h_n_m = (n > 0) ? _mm256_loadu_si256((__m256i*) (h_ptr - total_width)) : h_n;
+
+			tmp_n = _mm256_add_epi16(_mm256_add_epi16(h_n_m, h_n), one);
+			tmp_n = _mm256_srai_epi16(tmp_n, 1);
+
+			_mm256_storeu_si256((__m256i*) dst_ptr, _mm256_sub_epi16(l_n, tmp_n));
+
+			l_ptr += 16;
+			h_ptr += 16;
+			dst_ptr += 16;
+		}
+
+		dst_ptr += total_width;
+	}
+
+	h_ptr = h;
+	dst_ptr = dst + total_width;
+
+	/* Odd coefficients */
+	for (n = 0; n < subband_width; n++)
+	{
+		for (x = 0; x < total_width; x += 16)
+		{
+			/* dst[2n + 1] = (h[n] << 1) + ((dst[2n] + dst[2n + 2]) >> 1) */
+
+			h_n = _mm256_slli_epi16(_mm256_loadu_si256((__m256i*) h_ptr), 1);
+			dst_n_m = _mm256_loadu_si256((__m256i*) (dst_ptr - total_width));
+
+			if (n < subband_width - 1)
+			{
+				dst_n_p = _mm256_loadu_si256((__m256i*) (dst_ptr + total_width));
+				tmp_n = _mm256_srai_epi16(_mm256_add_epi16(dst_n_m, dst_n_p), 1);
+			}
+			else
+			{
+				tmp_n = dst_n_m;
+			}
+
+			_mm256_storeu_si256((__m256i*) dst_ptr, _mm256_add_epi16(tmp_n, h_n));
+
+			h_ptr += 16;
+			dst_ptr += 16;
+		}
+
+		dst_ptr += total_width;
+	}
+}
+
+/**
+ * Inverse horizontal DWT of 16 or 32 wide sub-bands, the inputs are
+ * dequantized by the given shifts as they are loaded.
+ */
+
+static void rfx_dwt_2d_decode_block_horiz_avx2(INT16* l, INT16* h, INT16* dst, int subband_width,
+	int l_shift, int h_shift)
+{
+	int y;
+	int k;
+	int blocks;
+	__m256i l_n;
+	__m256i h_n[2];
+	__m256i even[2];
+	__m256i prev;
+	__m256i next;
+	__m256i odd;
+	__m128i l_count;
+	__m128i h_count;
+	const __m256i one = _mm256_set1_epi16(1);
+
+	blocks = subband_width / 16;
+	l_count = _mm_cvtsi32_si128(l_shift);
+	h_count = _mm_cvtsi32_si128(h_shift);
+
+	for (y = 0; y < subband_width; y++)
+	{
+		for (k = 0; k < blocks; k++)
+			h_n[k] = _mm256_sll_epi16(_mm256_loadu_si256((__m256i*) &h[k * 16]), h_count);
+
+		/* dst[2n] = l[n] - ((h[n - 1] + h[n] + 1) >> 1) */
+
+		for (k = 0; k < blocks; k++)
+		{
+			l_n = _mm256_sll_epi16(_mm256_loadu_si256((__m256i*) &l[k * 16]), l_count);
+
+			prev = (k > 0) ? h_n[k - 1] : _mm256_first_epi16(h_n[0]);
+			prev = _mm256_shift_in_prev_epi16(h_n[k], prev);
+
+			even[k] = _mm256_add_epi16(_mm256_add_epi16(prev, h_n[k]), one);
+			even[k] = _mm256_sub_epi16(l_n, _mm256_srai_epi16(even[k], 1));
+		}
+
+		/* dst[2n + 1] = (h[n] << 1) + ((dst[2n] + dst[2n + 2]) >> 1) */
+
+		for (k = 0; k < blocks; k++)
+		{
+			next = (k < blocks - 1) ? even[k + 1] : _mm256_last_epi16(even[k]);
+			next = _mm256_shift_in_next_epi16(even[k], next);
+
+			odd = _mm256_srai_epi16(_mm256_add_epi16(even[k], next), 1);
+			odd = _mm256_add_epi16(odd, _mm256_slli_epi16(h_n[k], 1));
+
+			_mm256_interleave_epi16(&dst[k * 32], even[k], odd);
+		}
+
+		l += subband_width;
+		h += subband_width;
+		dst += subband_width << 1;
+	}
+}
+
+/**
+ * Inverse horizontal DWT of the 8 wide third level. With sum set, the L input
+ * is differentially coded and accumulated as it is read.
+ */
+
+static void rfx_dwt_2d_decode_block_horiz_8(INT16* l, INT16* h, INT16* dst,
+	int l_shift, int h_shift, INT16* sum)
+{
+	int x, y;
+	int n;
+	INT16 l_n[8];
+	INT16 h_n[8];
+
+	for (y = 0; y < 8; y++)
+	{
+		for (n = 0; n < 8; n++)
+		{
+			if (sum)
+			{
+				*sum += l[n];
+				l_n[n] = *sum << l_shift;
+			}
+			else
+			{
+				l_n[n] = l[n] << l_shift;
+			}
+
+			h_n[n] = h[n] << h_shift;
+		}
+
+		/* Even coefficients */
+		dst[0] = l_n[0] - ((h_n[0] + h_n[0] + 1) >> 1);
+
+		for (n = 1; n < 8; n++)
+		{
+			x = n << 1;
+			dst[x] = l_n[n] - ((h_n[n - 1] + h_n[n] + 1) >> 1);
+		}
+
+		/* Odd coefficients */
+		for (n = 0; n < 7; n++)
+		{
+			x = n << 1;
+			dst[x + 1] = (h_n[n] << 1) + ((dst[x] + dst[x + 2]) >> 1);
+		}
+
+		dst[15] = (h_n[7] << 1) + dst[14];
+
+		l += 8;
+		h += 8;
+		dst += 16;
+	}
+}
+
+static void rfx_dwt_2d_decode_block_avx2(INT16* buffer, INT16* idwt, int subband_width,
+	int hl_shift, int lh_shift, int hh_shift)
+{
+	INT16 *hl, *lh, *hh, *ll;
+	INT16 *l_dst, *h_dst;
+
+	ll = buffer + subband_width * subband_width * 3;
+	hl = buffer;
+	l_dst = idwt;
+
+	lh = buffer + subband_width * subband_width;
+	hh = buffer + subband_width * subband_width * 2;
+	h_dst = idwt + subband_width * subband_width * 2;
+
+	/* the LL band is the output of the previous level and already dequantized */
+	rfx_dwt_2d_decode_block_horiz_avx2(ll, hl, l_dst, subband_width, 0, hl_shift);
+	rfx_dwt_2d_decode_block_horiz_avx2(lh, hh, h_dst, subband_width, lh_shift, hh_shift);
+
+	rfx_dwt_2d_decode_block_vert_avx2(l_dst, h_dst, buffer, subband_width);
+}
+
+static void rfx_dwt_2d_decode_block_8_avx2(INT16* buffer, INT16* idwt,
+	int ll_shift, int hl_shift, int lh_shift, int hh_shift)
+{
+	INT16 sum = 0;
+
+	rfx_dwt_2d_decode_block_horiz_8(buffer + 192, buffer, idwt, ll_shift, hl_shift, &sum);
+	rfx_dwt_2d_decode_block_horiz_8(buffer + 64, buffer + 128, idwt + 128, lh_shift, hh_shift, NULL);
+
+	rfx_dwt_2d_decode_block_vert_avx2(idwt, idwt + 128, buffer, 8);
+}
+
+/**
+ * Differential decoding of LL3, dequantization and inverse DWT in a single pass per level.
+ * A sub-band is scaled by << 5 to 11.5 fixed-point and by << (quantization value - 6).
+ */
+
+static void rfx_dwt_2d_quantization_decode_avx2(INT16* buffer, INT16* dwt_buffer, const UINT32* quantization_values)
+{
+	const UINT32* q = quantization_values;
+
+	rfx_dwt_2d_decode_block_8_avx2(buffer + 3840, dwt_buffer, q[0] - 1, q[2] - 1, q[1] - 1, q[3] - 1);
+	rfx_dwt_2d_decode_block_avx2(buffer + 3072, dwt_buffer, 16, q[5] - 1, q[4] - 1, q[6] - 1);
+	rfx_dwt_2d_decode_block_avx2(buffer, dwt_buffer, 32, q[8] - 1, q[7] - 1, q[9] - 1);
+}
+
+void rfx_init_avx2(RFX_CONTEXT* context)
+{
+	DEBUG_RFX("Using AVX2 optimizations");
+
+	IF_PROFILER(context->priv->prof_rfx_dwt_2d_quantization_decode->name = "rfx_dwt_2d_quantization_decode_avx2");
+	IF_PROFILER(context->priv->prof_rfx_dwt_2d_quantization_encode->name = "rfx_dwt_2d_quantization_encode_avx2");
+
+	context->dwt_2d_quantization_decode = rfx_dwt_2d_quantization_decode_avx2;
+	context->dwt_2d_quantization_encode = rfx_dwt_2d_quantization_encode_avx2;
+}
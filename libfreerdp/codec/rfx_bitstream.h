@@ -22,64 +22,204 @@
 
 #include <freerdp/codec/rfx.h>
 
+/**
+ * Bits are moved through a 64-bit reservoir instead of one at a time.
+ * When reading, the next bit to be consumed is the most significant bit of
+ * the reservoir and bits counts how many of them are valid. When writing,
+ * pending bits are the least significant ones and go out as 32-bit words.
+ */
+
 struct _RFX_BITSTREAM
 {
 	BYTE* buffer;
 	int nbytes;
 	int byte_pos;
-	int bits_left;
+	UINT64 reservoir;
+	int bits;
 };
 typedef struct _RFX_BITSTREAM RFX_BITSTREAM;
 
+#if defined(__GNUC__)
+#define rfx_bitstream_clz32(_v)		__builtin_clz(_v)
+#define rfx_bitstream_clz64(_v)		__builtin_clzll(_v)
+#else
+static INLINE int rfx_bitstream_clz64(UINT64 v)
+{
+	int n = 0;
+
+	while (!(v & 0x8000000000000000ULL))
+	{
+		v <<= 1;
+		n++;
+	}
+
+	return n;
+}
+
+#define rfx_bitstream_clz32(_v)		(rfx_bitstream_clz64(_v) - 32)
+#endif
+
 #define rfx_bitstream_attach(bs, _buffer, _nbytes) do { \
 	bs->buffer = (BYTE*) (_buffer); \
 	bs->nbytes = (_nbytes); \
 	bs->byte_pos = 0; \
-	bs->bits_left = 8; } while (0)
+	bs->reservoir = 0; \
+	bs->bits = 0; } while (0)
+
+/* Refill the reservoir so that it holds at least 57 bits, or what is left */
+static INLINE void rfx_bitstream_fill(RFX_BITSTREAM* bs)
+{
+	BYTE* p;
+
+	if (bs->byte_pos + 8 <= bs->nbytes)
+	{
+		p = &bs->buffer[bs->byte_pos];
+
+		/* bits below the counted ones are the start of the next byte */
+		bs->reservoir |= (((UINT64) p[0] << 56) | ((UINT64) p[1] << 48) |
+			((UINT64) p[2] << 40) | ((UINT64) p[3] << 32) |
+			((UINT64) p[4] << 24) | ((UINT64) p[5] << 16) |
+			((UINT64) p[6] << 8) | (UINT64) p[7]) >> bs->bits;
+
+		bs->byte_pos += (63 - bs->bits) >> 3;
+		bs->bits |= 56;
+	}
+	else
+	{
+		while (bs->bits <= 56 && bs->byte_pos < bs->nbytes)
+		{
+			bs->reservoir |= (UINT64) bs->buffer[bs->byte_pos++] << (56 - bs->bits);
+			bs->bits += 8;
+		}
+	}
+}
+
+static INLINE void rfx_bitstream_skip(RFX_BITSTREAM* bs, int nbits)
+{
+	bs->reservoir = (nbits < 64) ? (bs->reservoir << nbits) : 0;
+	bs->bits -= nbits;
+}
+
+/* Read up to 32 bits, at the end of the stream only the bits left are returned */
+static INLINE UINT32 rfx_bitstream_read(RFX_BITSTREAM* bs, int nbits)
+{
+	UINT32 n;
+
+	if (bs->bits < nbits)
+	{
+		rfx_bitstream_fill(bs);
+
+		if (bs->bits < nbits)
+			nbits = bs->bits;
+	}
+
+	if (nbits < 1)
+		return 0;
+
+	n = (UINT32) (bs->reservoir >> (64 - nbits));
+	rfx_bitstream_skip(bs, nbits);
+
+	return n;
+}
+
+/* Count and consume a run of 1 bits along with the 0 bit terminating it */
+static INLINE UINT32 rfx_bitstream_read_ones(RFX_BITSTREAM* bs)
+{
+	int n;
+	UINT32 count = 0;
+
+	while (1)
+	{
+		if (bs->bits < 1)
+		{
+			rfx_bitstream_fill(bs);
+
+			if (bs->bits < 1)
+				break;
+		}
+
+		n = (~bs->reservoir) ? rfx_bitstream_clz64(~bs->reservoir) : 64;
+
+		if (n < bs->bits)
+		{
+			count += n;
+			rfx_bitstream_skip(bs, n + 1);
+			break;
+		}
+
+		count += bs->bits;
+		rfx_bitstream_skip(bs, bs->bits);
+	}
+
+	return count;
+}
+
+static INLINE void rfx_bitstream_write_byte(RFX_BITSTREAM* bs, BYTE b)
+{
+	if (bs->byte_pos < bs->nbytes)
+		bs->buffer[bs->byte_pos++] = b;
+}
+
+/* Write up to 32 bits, bits past the end of the buffer are dropped */
+static INLINE void rfx_bitstream_write(RFX_BITSTREAM* bs, UINT32 value, int nbits)
+{
+	UINT32 w;
+	BYTE* p;
+
+	if (nbits < 1)
+		return;
+
+	bs->reservoir = (bs->reservoir << nbits) | (value & (0xFFFFFFFF >> (32 - nbits)));
+	bs->bits += nbits;
+
+	if (bs->bits >= 32)
+	{
+		bs->bits -= 32;
+		w = (UINT32) (bs->reservoir >> bs->bits);
+
+		if (bs->byte_pos + 4 <= bs->nbytes)
+		{
+			p = &bs->buffer[bs->byte_pos];
+			p[0] = (BYTE) (w >> 24);
+			p[1] = (BYTE) (w >> 16);
+			p[2] = (BYTE) (w >> 8);
+			p[3] = (BYTE) w;
+			bs->byte_pos += 4;
+		}
+		else
+		{
+			rfx_bitstream_write_byte(bs, (BYTE) (w >> 24));
+			rfx_bitstream_write_byte(bs, (BYTE) (w >> 16));
+			rfx_bitstream_write_byte(bs, (BYTE) (w >> 8));
+			rfx_bitstream_write_byte(bs, (BYTE) w);
+		}
+	}
+}
+
+/* Write out pending bits, padding the last byte with zeroes */
+static INLINE void rfx_bitstream_flush(RFX_BITSTREAM* bs)
+{
+	while (bs->bits >= 8)
+	{
+		bs->bits -= 8;
+		rfx_bitstream_write_byte(bs, (BYTE) (bs->reservoir >> bs->bits));
+	}
+
+	if (bs->bits > 0)
+		rfx_bitstream_write_byte(bs, (BYTE) (bs->reservoir << (8 - bs->bits)));
+
+	bs->reservoir = 0;
+	bs->bits = 0;
+}
 
 #define rfx_bitstream_get_bits(bs, _nbits, _r) do { \
-	int nbits = _nbits; \
-	int b; \
-	UINT16 n = 0; \
-	while (bs->byte_pos < bs->nbytes && nbits > 0) \
-	{ \
-		b = nbits; \
-		if (b > bs->bits_left) \
-			b = bs->bits_left; \
-		if (n) \
-			n <<= b; \
-		n |= (bs->buffer[bs->byte_pos] >> (bs->bits_left - b)) & ((1 << b) - 1); \
-		bs->bits_left -= b; \
-		nbits -= b; \
-		if (bs->bits_left == 0) \
-		{ \
-			bs->bits_left = 8; \
-			bs->byte_pos++; \
-		} \
-	} \
-	_r = n; } while (0)
+	_r = rfx_bitstream_read(bs, _nbits); } while (0)
 
 #define rfx_bitstream_put_bits(bs, _bits, _nbits) do { \
-	UINT16 bits = (_bits); \
-	int nbits = (_nbits); \
-	int b; \
-	while (bs->byte_pos < bs->nbytes && nbits > 0) \
-	{ \
-		b = nbits; \
-		if (b > bs->bits_left) \
-			b = bs->bits_left; \
-		bs->buffer[bs->byte_pos] |= ((bits >> (nbits - b)) & ((1 << b) - 1)) << (bs->bits_left - b); \
-		bs->bits_left -= b; \
-		nbits -= b; \
-		if (bs->bits_left == 0) \
-		{ \
-			bs->bits_left = 8; \
-			bs->byte_pos++; \
-		} \
-	} } while (0)
-
-#define rfx_bitstream_eos(_bs) ((_bs)->byte_pos >= (_bs)->nbytes)
-#define rfx_bitstream_left(_bs) ((_bs)->byte_pos >= (_bs)->nbytes ? 0 : ((_bs)->nbytes - (_bs)->byte_pos - 1) * 8 + (_bs)->bits_left)
-#define rfx_bitstream_get_processed_bytes(_bs) ((_bs)->bits_left < 8 ? (_bs)->byte_pos + 1 : (_bs)->byte_pos)
+	rfx_bitstream_write(bs, _bits, _nbits); } while (0)
+
+#define rfx_bitstream_eos(_bs) ((_bs)->bits < 1 && (_bs)->byte_pos >= (_bs)->nbytes)
+#define rfx_bitstream_left(_bs) (((_bs)->nbytes - (_bs)->byte_pos) * 8 + (_bs)->bits)
+#define rfx_bitstream_get_processed_bytes(_bs) ((_bs)->byte_pos)
 
 #endif /* __RFX_BITSTREAM_H */
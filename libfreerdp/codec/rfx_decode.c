@@ -152,23 +152,41 @@ void rfx_decode_ycbcr_to_rgb(INT16* y_r_buf, INT16* cb_g_buf, INT16* cr_b_buf)
 static void rfx_decode_component(RFX_CONTEXT* context, const UINT32* quantization_values,
 	const BYTE* data, int size, INT16* buffer)
 {
+	UINT64 start;
+
 	PROFILER_ENTER(context->priv->prof_rfx_decode_component);
 
+	start = metrics_start(context->metrics);
+
 	PROFILER_ENTER(context->priv->prof_rfx_rlgr_decode);
 		rfx_rlgr_decode(context->mode, data, size, buffer, 4096);
 	PROFILER_EXIT(context->priv->prof_rfx_rlgr_decode);
 
-	PROFILER_ENTER(context->priv->prof_rfx_differential_decode);
-		rfx_differential_decode(buffer + 4032, 64);
-	PROFILER_EXIT(context->priv->prof_rfx_differential_decode);
+	metrics_stop(context->metrics, METRICS_RFX_RLGR_DECODE, start);
+	start = metrics_start(context->metrics);
 
-	PROFILER_ENTER(context->priv->prof_rfx_quantization_decode);
-		context->quantization_decode(buffer, quantization_values);
-	PROFILER_EXIT(context->priv->prof_rfx_quantization_decode);
+	if (context->dwt_2d_quantization_decode)
+	{
+		PROFILER_ENTER(context->priv->prof_rfx_dwt_2d_quantization_decode);
+			context->dwt_2d_quantization_decode(buffer, context->priv->dwt_buffer, quantization_values);
+		PROFILER_EXIT(context->priv->prof_rfx_dwt_2d_quantization_decode);
+	}
+	else
+	{
+		PROFILER_ENTER(context->priv->prof_rfx_differential_decode);
+			rfx_differential_decode(buffer + 4032, 64);
+		PROFILER_EXIT(context->priv->prof_rfx_differential_decode);
+
+		PROFILER_ENTER(context->priv->prof_rfx_quantization_decode);
+			context->quantization_decode(buffer, quantization_values);
+		PROFILER_EXIT(context->priv->prof_rfx_quantization_decode);
 
-	PROFILER_ENTER(context->priv->prof_rfx_dwt_2d_decode);
-		context->dwt_2d_decode(buffer, context->priv->dwt_buffer);
-	PROFILER_EXIT(context->priv->prof_rfx_dwt_2d_decode);
+		PROFILER_ENTER(context->priv->prof_rfx_dwt_2d_decode);
+			context->dwt_2d_decode(buffer, context->priv->dwt_buffer);
+		PROFILER_EXIT(context->priv->prof_rfx_dwt_2d_decode);
+	}
+
+	metrics_stop(context->metrics, METRICS_RFX_DWT_DECODE, start);
 
 	PROFILER_EXIT(context->priv->prof_rfx_decode_component);
 }
@@ -178,6 +196,8 @@ void rfx_decode_rgb(RFX_CONTEXT* context, STREAM* data_in,
 	int cb_size, const UINT32 * cb_quants,
 	int cr_size, const UINT32 * cr_quants, BYTE* rgb_buffer)
 {
+	UINT64 start;
+
 	PROFILER_ENTER(context->priv->prof_rfx_decode_rgb);
 
 	rfx_decode_component(context, y_quants, stream_get_tail(data_in), y_size, context->priv->y_r_buffer); /* YData */
@@ -187,6 +207,8 @@ void rfx_decode_rgb(RFX_CONTEXT* context, STREAM* data_in,
 	rfx_decode_component(context, cr_quants, stream_get_tail(data_in), cr_size, context->priv->cr_b_buffer); /* CrData */
 	stream_seek(data_in, cr_size);
 
+	start = metrics_start(context->metrics);
+
 	PROFILER_ENTER(context->priv->prof_rfx_decode_ycbcr_to_rgb);
 		context->decode_ycbcr_to_rgb(context->priv->y_r_buffer, context->priv->cb_g_buffer, context->priv->cr_b_buffer);
 	PROFILER_EXIT(context->priv->prof_rfx_decode_ycbcr_to_rgb);
@@ -195,6 +217,8 @@ void rfx_decode_rgb(RFX_CONTEXT* context, STREAM* data_in,
 		rfx_decode_format_rgb(context->priv->y_r_buffer, context->priv->cb_g_buffer, context->priv->cr_b_buffer,
 			context->pixel_format, rgb_buffer);
 	PROFILER_EXIT(context->priv->prof_rfx_decode_format_rgb);
-	
+
+	metrics_stop(context->metrics, METRICS_RFX_COLOR_CONVERT, start);
+
 	PROFILER_EXIT(context->priv->prof_rfx_decode_rgb);
 }
@@ -227,17 +227,26 @@ static void rfx_encode_component(RFX_CONTEXT* context, const UINT32* quantizatio
 {
 	PROFILER_ENTER(context->priv->prof_rfx_encode_component);
 
-	PROFILER_ENTER(context->priv->prof_rfx_dwt_2d_encode);
-		context->dwt_2d_encode(data, context->priv->dwt_buffer);
-	PROFILER_EXIT(context->priv->prof_rfx_dwt_2d_encode);
+	if (context->dwt_2d_quantization_encode)
+	{
+		PROFILER_ENTER(context->priv->prof_rfx_dwt_2d_quantization_encode);
+			context->dwt_2d_quantization_encode(data, context->priv->dwt_buffer, quantization_values);
+		PROFILER_EXIT(context->priv->prof_rfx_dwt_2d_quantization_encode);
+	}
+	else
+	{
+		PROFILER_ENTER(context->priv->prof_rfx_dwt_2d_encode);
+			context->dwt_2d_encode(data, context->priv->dwt_buffer);
+		PROFILER_EXIT(context->priv->prof_rfx_dwt_2d_encode);
 
-	PROFILER_ENTER(context->priv->prof_rfx_quantization_encode);
-		context->quantization_encode(data, quantization_values);
-	PROFILER_EXIT(context->priv->prof_rfx_quantization_encode);
+		PROFILER_ENTER(context->priv->prof_rfx_quantization_encode);
+			context->quantization_encode(data, quantization_values);
+		PROFILER_EXIT(context->priv->prof_rfx_quantization_encode);
 
-	PROFILER_ENTER(context->priv->prof_rfx_differential_encode);
-		rfx_differential_encode(data + 4032, 64);
-	PROFILER_EXIT(context->priv->prof_rfx_differential_encode);
+		PROFILER_ENTER(context->priv->prof_rfx_differential_encode);
+			rfx_differential_encode(data + 4032, 64);
+		PROFILER_EXIT(context->priv->prof_rfx_differential_encode);
+	}
 
 	PROFILER_ENTER(context->priv->prof_rfx_rlgr_encode);
 		*size = rfx_rlgr_encode(context->mode, data, 4096, buffer, buffer_size);
@@ -73,12 +73,7 @@
 #define GetMinBits(_val, _nbits) \
 { \
 	UINT32 _v = _val; \
-	_nbits = 0; \
-	while (_v) \
-	{ \
-		_v >>= 1; \
-		_nbits++; \
-	} \
+	_nbits = _v ? 32 - rfx_bitstream_clz32(_v) : 0; \
 }
 
 /* Converts from (2 * magnitude - sign) to integer */
@@ -103,13 +98,7 @@
 	vk = 0; \
 	_mag = 0; \
 	/* chew up/count leading 1s and escape 0 */ \
-	do { \
-		GetBits(1, r); \
-		if (r == 1) \
-			vk++; \
-		else \
-			break; \
-	} while (1); \
+	vk = rfx_bitstream_read_ones(bs); \
 	/* get next *kr bits, and combine with leading 1s */ \
 	GetBits(*kr, _mag); \
 	_mag |= (vk << *kr); \
@@ -130,11 +119,12 @@ int rfx_rlgr_decode(RLGR_MODE mode, const BYTE* data, int data_size, INT16* buff
 	UINT16 r;
 	INT16* dst;
 	RFX_BITSTREAM* bs;
+	RFX_BITSTREAM bitstream;
 
 	int vk;
 	UINT16 mag16;
 
-	bs = xnew(RFX_BITSTREAM);
+	bs = &bitstream;
 	rfx_bitstream_attach(bs, data, data_size);
 	dst = buffer;
 
@@ -234,8 +224,6 @@ int rfx_rlgr_decode(RLGR_MODE mode, const BYTE* data, int data_size, INT16* buff
 		}
 	}
 
-	free(bs);
-
 	return (dst - buffer);
 }
 
@@ -259,10 +247,10 @@ int rfx_rlgr_decode(RLGR_MODE mode, const BYTE* data, int data_size, INT16* buff
 /* Emit a bit (0 or 1), count number of times, to the output bitstream */
 #define OutputBit(count, bit) \
 {	\
-	UINT16 _b = (bit ? 0xFFFF : 0); \
+	UINT32 _b = (bit ? 0xFFFFFFFF : 0); \
 	int _c = (count); \
-	for (; _c > 0; _c -= 16) \
-		rfx_bitstream_put_bits(bs, _b, (_c > 16 ? 16 : _c)); \
+	for (; _c > 0; _c -= 32) \
+		rfx_bitstream_put_bits(bs, _b, (_c > 32 ? 32 : _c)); \
 }
 
 /* Converts the input value to (2 * abs(input) - sign(input)), where sign(input) = (input < 0 ? 1 : 0) and returns it */
@@ -278,13 +266,22 @@ static void rfx_rlgr_code_gr(RFX_BITSTREAM* bs, int* krp, UINT32 val)
 	/* unary part of GR code */
 
 	UINT32 vk = (val) >> kr;
-	OutputBit(vk, 1);
-	OutputBit(1, 0);
 
-	/* remainder part of GR code, if needed */
-	if (kr)
+	if (vk + 1 + kr <= 32)
+	{
+		/* unary part, escape 0 and remainder in a single word */
+		OutputBits(vk + 1 + kr, (((1U << vk) - 1) << (kr + 1)) | (val & ((1 << kr) - 1)));
+	}
+	else
 	{
-		OutputBits(kr, val & ((1 << kr) - 1));
+		OutputBit(vk, 1);
+		OutputBit(1, 0);
+
+		/* remainder part of GR code, if needed */
+		if (kr)
+		{
+			OutputBits(kr, val & ((1 << kr) - 1));
+		}
 	}
 
 	/* update krp, only if it is not equal to 1 */
@@ -304,9 +301,9 @@ int rfx_rlgr_encode(RLGR_MODE mode, const INT16* data, int data_size, BYTE* buff
 	int kp;
 	int krp;
 	RFX_BITSTREAM* bs;
-	int processed_size;
+	RFX_BITSTREAM bitstream;
 
-	bs = xnew(RFX_BITSTREAM);
+	bs = &bitstream;
 	rfx_bitstream_attach(bs, buffer, buffer_size);
 
 	/* initialize the parameters */
@@ -430,8 +427,7 @@ int rfx_rlgr_encode(RLGR_MODE mode, const INT16* data, int data_size, BYTE* buff
 		}
 	}
 
-	processed_size = rfx_bitstream_get_processed_bytes(bs);
-	free(bs);
+	rfx_bitstream_flush(bs);
 
-	return processed_size;
+	return rfx_bitstream_get_processed_bytes(bs);
 }
@@ -35,6 +35,9 @@
 
 #include "rfx_pool.h"
 
+/* number of quantization sets the encoder rate control chooses from */
+#define RFX_RATE_LEVELS		16
+
 struct _RFX_CONTEXT_PRIV
 {
 	/* pre-allocated buffers */
@@ -53,6 +56,12 @@ struct _RFX_CONTEXT_PRIV
 
 	INT16* dwt_buffer;
 
+	/* encoder rate control */
+	int rate_level; /* level of the last tile */
+	int rate_num_tiles;
+	int* rate_sizes; /* sizes of the tiles in the previous frame */
+	int* rate_levels; /* levels of the tiles in the previous frame */
+
 	/* profilers */
 	PROFILER_DEFINE(prof_rfx_decode_rgb);
 	PROFILER_DEFINE(prof_rfx_decode_component);
@@ -60,6 +69,7 @@ struct _RFX_CONTEXT_PRIV
 	PROFILER_DEFINE(prof_rfx_differential_decode);
 	PROFILER_DEFINE(prof_rfx_quantization_decode);
 	PROFILER_DEFINE(prof_rfx_dwt_2d_decode);
+	PROFILER_DEFINE(prof_rfx_dwt_2d_quantization_decode);
 	PROFILER_DEFINE(prof_rfx_decode_ycbcr_to_rgb);
 	PROFILER_DEFINE(prof_rfx_decode_format_rgb);
 
@@ -69,6 +79,7 @@ struct _RFX_CONTEXT_PRIV
 	PROFILER_DEFINE(prof_rfx_differential_encode);
 	PROFILER_DEFINE(prof_rfx_quantization_encode);
 	PROFILER_DEFINE(prof_rfx_dwt_2d_encode);
+	PROFILER_DEFINE(prof_rfx_dwt_2d_quantization_encode);
 	PROFILER_DEFINE(prof_rfx_encode_rgb_to_ycbcr);
 	PROFILER_DEFINE(prof_rfx_encode_format_rgb);
 };
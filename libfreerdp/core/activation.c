@@ -23,6 +23,8 @@
 
 #include "activation.h"
 
+#include <freerdp/utils/persistent.h>
+
 /*
 static const char* const CTRLACTION_STRINGS[] =
 {
@@ -182,33 +184,141 @@ void rdp_write_persistent_list_entry(STREAM* s, UINT32 key1, UINT32 key2)
 	stream_write_UINT32(s, key2); /* key2 (4 bytes) */
 }
 
-void rdp_write_client_persistent_key_list_pdu(STREAM* s, rdpSettings* settings)
+void rdp_write_client_persistent_key_list_pdu(STREAM* s, UINT16* numEntries, UINT16* totalEntries, BYTE flags)
 {
-	stream_write_UINT16(s, 0); /* numEntriesCache0 (2 bytes) */
-	stream_write_UINT16(s, 0); /* numEntriesCache1 (2 bytes) */
-	stream_write_UINT16(s, 0); /* numEntriesCache2 (2 bytes) */
-	stream_write_UINT16(s, 0); /* numEntriesCache3 (2 bytes) */
-	stream_write_UINT16(s, 0); /* numEntriesCache4 (2 bytes) */
-	stream_write_UINT16(s, 0); /* totalEntriesCache0 (2 bytes) */
-	stream_write_UINT16(s, 0); /* totalEntriesCache1 (2 bytes) */
-	stream_write_UINT16(s, 0); /* totalEntriesCache2 (2 bytes) */
-	stream_write_UINT16(s, 0); /* totalEntriesCache3 (2 bytes) */
-	stream_write_UINT16(s, 0); /* totalEntriesCache4 (2 bytes) */
-	stream_write_BYTE(s, PERSIST_FIRST_PDU | PERSIST_LAST_PDU); /* bBitMask (1 byte) */
+	stream_write_UINT16(s, numEntries[0]); /* numEntriesCache0 (2 bytes) */
+	stream_write_UINT16(s, numEntries[1]); /* numEntriesCache1 (2 bytes) */
+	stream_write_UINT16(s, numEntries[2]); /* numEntriesCache2 (2 bytes) */
+	stream_write_UINT16(s, numEntries[3]); /* numEntriesCache3 (2 bytes) */
+	stream_write_UINT16(s, numEntries[4]); /* numEntriesCache4 (2 bytes) */
+	stream_write_UINT16(s, totalEntries[0]); /* totalEntriesCache0 (2 bytes) */
+	stream_write_UINT16(s, totalEntries[1]); /* totalEntriesCache1 (2 bytes) */
+	stream_write_UINT16(s, totalEntries[2]); /* totalEntriesCache2 (2 bytes) */
+	stream_write_UINT16(s, totalEntries[3]); /* totalEntriesCache3 (2 bytes) */
+	stream_write_UINT16(s, totalEntries[4]); /* totalEntriesCache4 (2 bytes) */
+	stream_write_BYTE(s, flags); /* bBitMask (1 byte) */
 	stream_write_BYTE(s, 0); /* pad1 (1 byte) */
 	stream_write_UINT16(s, 0); /* pad3 (2 bytes) */
 
 	/* entries */
 }
 
+/**
+ * Load the keys of the persistent bitmap cache so that they can be advertised,
+ * unless the bitmap cache did already. Clients usually create the bitmap cache
+ * once connected, after the key list has been sent.
+ * @param rdp rdp module
+ */
+
+void rdp_client_load_persistent_keys(rdpRdp* rdp)
+{
+	rdpPersistentCache* persistent;
+	rdpSettings* settings = rdp->settings;
+
+	if (!settings->persistent_bitmap_cache || (settings->bitmapCacheV2NumCells < 1))
+		return;
+
+	if (settings->bitmapCacheV2CellInfo[0].persistentKeys != NULL)
+		return;
+
+	persistent = persistent_cache_new();
+	persistent_cache_load_keys(persistent, settings, NULL);
+	persistent_cache_free(persistent);
+}
+
+/**
+ * Send the keys of the bitmaps restored from the persistent bitmap cache.
+ * Keys are sent in cache index order, spread over as many PDUs as needed.
+ * @param rdp rdp module
+ */
+
 BOOL rdp_send_client_persistent_key_list_pdu(rdpRdp* rdp)
 {
+	int i, j;
 	STREAM* s;
+	BYTE flags;
+	UINT64 key;
+	UINT32 left;
+	UINT32 count;
+	UINT32 sent = 0;
+	UINT32 total = 0;
+	UINT32 index[5];
+	UINT16 numEntries[5];
+	UINT16 totalEntries[5];
+	rdpSettings* settings = rdp->settings;
+	BITMAP_CACHE_V2_CELL_INFO* cellInfo;
+
+	for (i = 0; i < 5; i++)
+	{
+		index[i] = 0;
+		totalEntries[i] = 0;
 
-	s = rdp_data_pdu_init(rdp);
-	rdp_write_client_persistent_key_list_pdu(s, rdp->settings);
+		if (!settings->persistent_bitmap_cache || (i >= (int) settings->bitmapCacheV2NumCells))
+			continue;
+
+		cellInfo = &settings->bitmapCacheV2CellInfo[i];
+
+		if (cellInfo->persistent && (cellInfo->persistentKeys != NULL))
+			totalEntries[i] = (UINT16) MIN(cellInfo->numPersistentKeys, 0xFFFF);
+
+		total += totalEntries[i];
+	}
 
-	return rdp_send_data_pdu(rdp, s, DATA_PDU_TYPE_BITMAP_CACHE_PERSISTENT_LIST, rdp->mcs->user_id);
+	if (total > PERSIST_MAX_ENTRIES)
+	{
+		/* advertise only the keys that fit, the others are not restored */
+		left = PERSIST_MAX_ENTRIES;
+
+		for (i = 0; i < 5; i++)
+		{
+			totalEntries[i] = (UINT16) MIN(totalEntries[i], left);
+			left -= totalEntries[i];
+		}
+
+		total = PERSIST_MAX_ENTRIES;
+	}
+
+	do
+	{
+		count = 0;
+
+		for (i = 0; i < 5; i++)
+		{
+			numEntries[i] = (UINT16) MIN(totalEntries[i] - index[i], PERSIST_MAX_PDU_ENTRIES - count);
+			count += numEntries[i];
+		}
+
+		flags = 0;
+
+		if (sent == 0)
+			flags |= PERSIST_FIRST_PDU;
+
+		if (sent + count >= total)
+			flags |= PERSIST_LAST_PDU;
+
+		s = rdp_data_pdu_init(rdp);
+		stream_check_size(s, 24 + count * 8);
+		rdp_write_client_persistent_key_list_pdu(s, numEntries, totalEntries, flags);
+
+		for (i = 0; i < 5; i++)
+		{
+			for (j = 0; j < numEntries[i]; j++)
+			{
+				key = settings->bitmapCacheV2CellInfo[i].persistentKeys[index[i] + j];
+				rdp_write_persistent_list_entry(s, (UINT32) (key & 0xFFFFFFFF), (UINT32) (key >> 32));
+			}
+
+			index[i] += numEntries[i];
+		}
+
+		if (!rdp_send_data_pdu(rdp, s, DATA_PDU_TYPE_BITMAP_CACHE_PERSISTENT_LIST, rdp->mcs->user_id))
+			return FALSE;
+
+		sent += count;
+	}
+	while (sent < total);
+
+	return TRUE;
 }
 
 BOOL rdp_recv_client_font_list_pdu(STREAM* s)
@@ -35,6 +35,9 @@
 #define PERSIST_FIRST_PDU		0x01
 #define PERSIST_LAST_PDU		0x02
 
+#define PERSIST_MAX_PDU_ENTRIES		169
+#define PERSIST_MAX_ENTRIES		262144
+
 #define FONTLIST_FIRST			0x0001
 #define FONTLIST_LAST			0x0002
 
@@ -51,6 +54,7 @@ BOOL rdp_recv_server_control_pdu(rdpRdp* rdp, STREAM* s);
 BOOL rdp_send_server_control_cooperate_pdu(rdpRdp* rdp);
 BOOL rdp_send_server_control_granted_pdu(rdpRdp* rdp);
 BOOL rdp_send_client_control_pdu(rdpRdp* rdp, UINT16 action);
+void rdp_client_load_persistent_keys(rdpRdp* rdp);
 BOOL rdp_send_client_persistent_key_list_pdu(rdpRdp* rdp);
 BOOL rdp_recv_client_font_list_pdu(STREAM* s);
 BOOL rdp_send_client_font_list_pdu(rdpRdp* rdp, UINT16 flags);
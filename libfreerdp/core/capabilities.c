@@ -140,6 +140,9 @@ void rdp_read_general_capability_set(STREAM* s, UINT16 length, rdpSettings* sett
 	if (!(extraFlags & FASTPATH_OUTPUT_SUPPORTED))
 		settings->fastpath_output = FALSE;
 
+	if (!(extraFlags & AUTORECONNECT_SUPPORTED))
+		settings->auto_reconnection = FALSE;
+
 	if (refreshRectSupport == FALSE)
 		settings->refresh_rect = FALSE;
 
@@ -840,10 +843,14 @@ void rdp_write_cache_definition(STREAM* s, GLYPH_CACHE_DEFINITION* cache_definit
 
 void rdp_read_glyph_cache_capability_set(STREAM* s, UINT16 length, rdpSettings* settings)
 {
+	int i;
 	UINT16 glyphSupportLevel;
 
-	stream_seek(s, 40); /* glyphCache (40 bytes) */
-	stream_seek_UINT32(s); /* fragCache (4 bytes) */
+	/* glyphCache (40 bytes) */
+	for (i = 0; i < 10; i++)
+		rdp_read_cache_definition(s, &(settings->glyphCache[i])); /* glyphCache0..9 (4 bytes) */
+
+	rdp_read_cache_definition(s, settings->fragCache); /* fragCache (4 bytes) */
 	stream_read_UINT16(s, glyphSupportLevel); /* glyphSupportLevel (2 bytes) */
 	stream_seek_UINT16(s); /* pad2Octets (2 bytes) */
 
@@ -936,14 +943,10 @@ void rdp_write_offscreen_bitmap_cache_capability_set(STREAM* s, rdpSettings* set
 
 void rdp_read_bitmap_cache_host_support_capability_set(STREAM* s, UINT16 length, rdpSettings* settings)
 {
-	BYTE cacheVersion;
-
-	stream_read_BYTE(s, cacheVersion); /* cacheVersion (1 byte) */
+	/* whether the bitmap cache is persisted is up to the client, see persistent_bitmap_cache */
+	stream_seek_BYTE(s); /* cacheVersion (1 byte) */
 	stream_seek_BYTE(s); /* pad1 (1 byte) */
 	stream_seek_UINT16(s); /* pad2 (2 bytes) */
-
-	if (cacheVersion & BITMAP_CACHE_V2)
-		settings->persistent_bitmap_cache = TRUE;
 }
 
 /**
@@ -966,6 +969,16 @@ void rdp_write_bitmap_cache_host_support_capability_set(STREAM* s, rdpSettings*
 	rdp_capability_set_finish(s, header, CAPSET_TYPE_BITMAP_CACHE_HOST_SUPPORT);
 }
 
+void rdp_read_bitmap_cache_cell_info(STREAM* s, BITMAP_CACHE_V2_CELL_INFO* cellInfo)
+{
+	UINT32 info;
+
+	stream_read_UINT32(s, info);
+
+	cellInfo->numEntries = (info & 0x7FFFFFFF);
+	cellInfo->persistent = (info & 0x80000000) ? TRUE : FALSE;
+}
+
 void rdp_write_bitmap_cache_cell_info(STREAM* s, BITMAP_CACHE_V2_CELL_INFO* cellInfo)
 {
 	UINT32 info;
@@ -988,15 +1001,20 @@ void rdp_write_bitmap_cache_cell_info(STREAM* s, BITMAP_CACHE_V2_CELL_INFO* cell
 
 void rdp_read_bitmap_cache_v2_capability_set(STREAM* s, UINT16 length, rdpSettings* settings)
 {
+	int i;
+	BYTE numCellCaches;
+
 	stream_seek_UINT16(s); /* cacheFlags (2 bytes) */
 	stream_seek_BYTE(s); /* pad2 (1 byte) */
-	stream_seek_BYTE(s); /* numCellCaches (1 byte) */
-	stream_seek(s, 4); /* bitmapCache0CellInfo (4 bytes) */
-	stream_seek(s, 4); /* bitmapCache1CellInfo (4 bytes) */
-	stream_seek(s, 4); /* bitmapCache2CellInfo (4 bytes) */
-	stream_seek(s, 4); /* bitmapCache3CellInfo (4 bytes) */
-	stream_seek(s, 4); /* bitmapCache4CellInfo (4 bytes) */
+	stream_read_BYTE(s, numCellCaches); /* numCellCaches (1 byte) */
+
+	/* bitmapCache0CellInfo..bitmapCache4CellInfo (4 bytes each) */
+	for (i = 0; i < 5; i++)
+		rdp_read_bitmap_cache_cell_info(s, &(settings->bitmapCacheV2CellInfo[i]));
+
 	stream_seek(s, 12); /* pad3 (12 bytes) */
+
+	settings->bitmapCacheV2NumCells = (numCellCaches <= 5) ? numCellCaches : 5;
 }
 
 /**
@@ -1370,7 +1388,7 @@ void rdp_write_large_pointer_capability_set(STREAM* s, rdpSettings* settings)
 
 	header = rdp_capability_set_start(s);
 
-	largePointerSupportFlags = (settings->large_pointer) ? LARGE_POINTER_FLAG_96x96 : 0;
+	largePointerSupportFlags = (settings->large_pointer) ? (LARGE_POINTER_FLAG_96x96 | LARGE_POINTER_FLAG_384x384) : 0;
 
 	stream_write_UINT16(s, largePointerSupportFlags); /* largePointerSupportFlags (2 bytes) */
 
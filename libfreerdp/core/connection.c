@@ -30,6 +30,7 @@
 #include <winpr/crt.h>
 
 #include <freerdp/errorcodes.h>
+#include <freerdp/utils/time.h>
 
 /**
  *                                      Connection Sequence\n
@@ -61,6 +62,27 @@
  *
  */
 
+#ifdef WITH_DEBUG_RDP
+#endif
+
+static int rdp_client_connect_phase(int state)
+{
+	switch (state)
+	{
+		case CONNECTION_STATE_LICENSE:
+			return CONNECT_PHASE_LICENSE;
+
+		case CONNECTION_STATE_CAPABILITY:
+			return CONNECT_PHASE_CAPABILITY;
+
+		case CONNECTION_STATE_FINALIZATION:
+			return CONNECT_PHASE_FINALIZATION;
+
+		default:
+			return CONNECT_PHASE_MCS;
+	}
+}
+
 /**
  * Establish RDP Connection based on the settings given in the 'rdp' parameter.
  * @msdn{cc240452}
@@ -70,8 +92,20 @@
 
 BOOL rdp_client_connect(rdpRdp* rdp)
 {
+#ifdef WITH_DEBUG_RDP
+	int i;
+#endif
+	int state;
+	UINT32 now;
+	UINT32 start;
 	rdpSettings* settings = rdp->settings;
 
+	memset(rdp->connect_time, 0, sizeof(rdp->connect_time));
+	start = freerdp_get_tick_count();
+
+	/* the cell info and the key list are sent before the bitmap cache is created */
+	rdp_client_load_persistent_keys(rdp);
+
 	nego_init(rdp->nego);
 	nego_set_target(rdp->nego, settings->hostname, settings->port);
 
@@ -127,6 +161,12 @@ BOOL rdp_client_connect(rdpRdp* rdp)
 		return FALSE;
 	}
 
+	now = freerdp_get_tick_count();
+	rdp->connect_time[CONNECT_PHASE_TLS] = rdp->transport->tls_time;
+	rdp->connect_time[CONNECT_PHASE_NLA] = rdp->transport->nla_time;
+	rdp->connect_time[CONNECT_PHASE_NEGO] = (now - start) - rdp->transport->tls_time - rdp->transport->nla_time;
+	start = now;
+
 	if ((rdp->nego->selected_protocol & PROTOCOL_TLS) || (rdp->nego->selected_protocol == PROTOCOL_RDP))
 	{
 		if ((settings->username != NULL) && ((settings->password != NULL) ||
@@ -151,11 +191,25 @@ BOOL rdp_client_connect(rdpRdp* rdp)
 	rdp->transport->process_single_pdu = TRUE;
 	while (rdp->state != CONNECTION_STATE_ACTIVE)
 	{
+		state = rdp->state;
+
 		if (rdp_check_fds(rdp) < 0)
 			return FALSE;
+
+		if (rdp->state != state)
+		{
+			now = freerdp_get_tick_count();
+			rdp->connect_time[rdp_client_connect_phase(state)] += now - start;
+			start = now;
+		}
 	}
 	rdp->transport->process_single_pdu = FALSE;
 
+#ifdef WITH_DEBUG_RDP
+	for (i = 0; i < CONNECT_PHASE_COUNT; i++)
+		DEBUG_RDP("connection phase %s: %d ms", freerdp_get_connect_phase_string(i), rdp->connect_time[i]);
+#endif
+
 	return TRUE;
 }
 
@@ -164,10 +218,15 @@ BOOL rdp_client_disconnect(rdpRdp* rdp)
 	return transport_disconnect(rdp->transport);
 }
 
-BOOL rdp_client_redirect(rdpRdp* rdp)
+/**
+ * Tear down the connection layers and the session keys, keeping the update,
+ * input and channel modules so that the client state survives a new connection.
+ */
+
+static void rdp_client_reset(rdpRdp* rdp)
 {
+	int i;
 	rdpSettings* settings = rdp->settings;
-	rdpRedirection* redirection = rdp->redirection;
 
 	rdp_client_disconnect(rdp);
 
@@ -181,17 +240,59 @@ BOOL rdp_client_redirect(rdpRdp* rdp)
 	nego_free(rdp->nego);
 	license_free(rdp->license);
 	transport_free(rdp->transport);
+	mppc_dec_free(rdp->mppc_dec);
+
+	rdp->rc4_decrypt_key = NULL;
+	rdp->rc4_encrypt_key = NULL;
+	rdp->fips_encrypt = NULL;
+	rdp->fips_decrypt = NULL;
+	rdp->fips_hmac = NULL;
+	rdp->decrypt_use_count = 0;
+	rdp->decrypt_checksum_use_count = 0;
+	rdp->encrypt_use_count = 0;
+	rdp->encrypt_checksum_use_count = 0;
+	rdp->sec_flags = 0;
+	rdp->do_crypt = FALSE;
+	rdp->do_secure_checksum = FALSE;
+	rdp->errorInfo = 0;
 
 	free(settings->server_random);
 	free(settings->server_certificate);
+	free(settings->client_random);
 	free(settings->ip_address);
 
+	settings->server_random = NULL;
+	settings->server_random_length = 0;
+	settings->server_certificate = NULL;
+	settings->server_certificate_length = 0;
+	settings->client_random = NULL;
+	settings->client_random_length = 0;
+	settings->ip_address = NULL;
+
 	rdp->transport = transport_new(settings);
+	rdp->transport->metrics = rdp->metrics;
 	rdp->license = license_new(rdp);
 	rdp->nego = nego_new(rdp->transport);
 	rdp->mcs = mcs_new(rdp->transport);
+	rdp->mppc_dec = mppc_dec_new();
 
 	rdp->transport->layer = TRANSPORT_LAYER_TCP;
+
+	for (i = 0; i < settings->num_channels; i++)
+		settings->channels[i].joined = FALSE;
+}
+
+BOOL rdp_client_redirect(rdpRdp* rdp)
+{
+	rdpSettings* settings = rdp->settings;
+	rdpRedirection* redirection = rdp->redirection;
+
+	rdp_client_reset(rdp);
+
+	/* an auto-reconnect cookie is only valid for the server that issued it */
+	ZeroMemory(settings->server_auto_reconnect_cookie, sizeof(ARC_SC_PRIVATE_PACKET));
+	ZeroMemory(settings->client_auto_reconnect_cookie, sizeof(ARC_CS_PRIVATE_PACKET));
+
 	settings->redirected_session_id = redirection->sessionID;
 
 	if (redirection->flags & LB_LOAD_BALANCE_INFO)
@@ -238,6 +339,35 @@ BOOL rdp_client_redirect(rdpRdp* rdp)
 	return rdp_client_connect(rdp);
 }
 
+/**
+ * Reconnect to the same server after the connection was lost, presenting the
+ * auto-reconnect cookie received in the previous session so that the server can
+ * log the user back on without prompting for credentials.\n
+ * The update, input and channel modules as well as the caches of the client are kept,
+ * only the connection layers are rebuilt.
+ * @msdn{cc240709}
+ * @param rdp rdp module
+ * @return TRUE if the session was reconnected
+ */
+
+BOOL rdp_client_reconnect(rdpRdp* rdp)
+{
+	rdp_client_reset(rdp);
+
+	rdp->disconnect = FALSE;
+	rdp->state = CONNECTION_STATE_INITIAL;
+
+	return rdp_client_connect(rdp);
+}
+
+static void rdp_save_client_random(rdpSettings* settings, BYTE* client_random)
+{
+	free(settings->client_random);
+	settings->client_random_length = CLIENT_RANDOM_LENGTH;
+	settings->client_random = (BYTE*) malloc(CLIENT_RANDOM_LENGTH);
+	CopyMemory(settings->client_random, client_random, CLIENT_RANDOM_LENGTH);
+}
+
 static BOOL rdp_client_establish_keys(rdpRdp* rdp)
 {
 	BYTE client_random[CLIENT_RANDOM_LENGTH];
@@ -281,6 +411,8 @@ static BOOL rdp_client_establish_keys(rdpRdp* rdp)
 		return FALSE;
 	}
 
+	rdp_save_client_random(rdp->settings, client_random);
+
 	rdp->do_crypt = TRUE;
 	if (rdp->settings->salted_checksum)
 		rdp->do_secure_checksum = TRUE;
@@ -353,6 +485,8 @@ static BOOL rdp_server_establish_keys(rdpRdp* rdp, STREAM* s)
 		return FALSE;
 	}
 
+	rdp_save_client_random(rdp->settings, client_random);
+
 	rdp->do_crypt = TRUE;
 	if (rdp->settings->salted_checksum)
 		rdp->do_secure_checksum = TRUE;
@@ -394,12 +528,35 @@ BOOL rdp_client_connect_mcs_connect_response(rdpRdp* rdp, STREAM* s)
 
 BOOL rdp_client_connect_mcs_attach_user_confirm(rdpRdp* rdp, STREAM* s)
 {
+	int i;
+
 	if (!mcs_recv_attach_user_confirm(rdp->mcs, s))
 		return FALSE;
 
+	/**
+	 * Send all channel join requests back to back rather than waiting for
+	 * each confirm, which would cost one round trip per channel.
+	 * The confirms are matched by channel id as they come in.
+	 */
+
+	rdp->mcs->user_channel_joined = FALSE;
+	rdp->mcs->global_channel_joined = FALSE;
+
+	for (i = 0; i < rdp->settings->num_channels; i++)
+		rdp->settings->channels[i].joined = FALSE;
+
 	if (!mcs_send_channel_join_request(rdp->mcs, rdp->mcs->user_id))
 		return FALSE;
 
+	if (!mcs_send_channel_join_request(rdp->mcs, MCS_GLOBAL_CHANNEL_ID))
+		return FALSE;
+
+	for (i = 0; i < rdp->settings->num_channels; i++)
+	{
+		if (!mcs_send_channel_join_request(rdp->mcs, rdp->settings->channels[i].channel_id))
+			return FALSE;
+	}
+
 	rdp->state = CONNECTION_STATE_MCS_CHANNEL_JOIN;
 
 	return TRUE;
@@ -414,28 +571,13 @@ BOOL rdp_client_connect_mcs_channel_join_confirm(rdpRdp* rdp, STREAM* s)
 	if (!mcs_recv_channel_join_confirm(rdp->mcs, s, &channel_id))
 		return FALSE;
 
-	if (!rdp->mcs->user_channel_joined)
+	if ((channel_id == rdp->mcs->user_id) && !rdp->mcs->user_channel_joined)
 	{
-		if (channel_id != rdp->mcs->user_id)
-			return FALSE;
 		rdp->mcs->user_channel_joined = TRUE;
-
-		if (!mcs_send_channel_join_request(rdp->mcs, MCS_GLOBAL_CHANNEL_ID))
-			return FALSE;
 	}
-	else if (!rdp->mcs->global_channel_joined)
+	else if ((channel_id == MCS_GLOBAL_CHANNEL_ID) && !rdp->mcs->global_channel_joined)
 	{
-		if (channel_id != MCS_GLOBAL_CHANNEL_ID)
-			return FALSE;
 		rdp->mcs->global_channel_joined = TRUE;
-
-		if (rdp->settings->num_channels > 0)
-		{
-			if (!mcs_send_channel_join_request(rdp->mcs, rdp->settings->channels[0].channel_id))
-				return FALSE;
-
-			all_joined = FALSE;
-		}
 	}
 	else
 	{
@@ -444,19 +586,24 @@ BOOL rdp_client_connect_mcs_channel_join_confirm(rdpRdp* rdp, STREAM* s)
 			if (rdp->settings->channels[i].joined)
 				continue;
 
-			if (rdp->settings->channels[i].channel_id != channel_id)
-				return FALSE;
-
-			rdp->settings->channels[i].joined = TRUE;
-			break;
+			if (rdp->settings->channels[i].channel_id == channel_id)
+				break;
 		}
-		if (i + 1 < rdp->settings->num_channels)
+
+		if (i >= rdp->settings->num_channels)
 		{
-			if (!mcs_send_channel_join_request(rdp->mcs, rdp->settings->channels[i + 1].channel_id))
-				return FALSE;
+			/* a repeated or unknown confirm does not change what is still pending */
+			DEBUG_RDP("ignoring join confirm for channel %d", channel_id);
+			return TRUE;
+		}
+
+		rdp->settings->channels[i].joined = TRUE;
+	}
 
+	for (i = 0; i < rdp->settings->num_channels; i++)
+	{
+		if (!rdp->settings->channels[i].joined)
 			all_joined = FALSE;
-		}
 	}
 
 	if (rdp->mcs->user_channel_joined && rdp->mcs->global_channel_joined && all_joined)
@@ -47,6 +47,7 @@ enum CONNECTION_STATE
 
 BOOL rdp_client_connect(rdpRdp* rdp);
 BOOL rdp_client_redirect(rdpRdp* rdp);
+BOOL rdp_client_reconnect(rdpRdp* rdp);
 BOOL rdp_client_connect_mcs_connect_response(rdpRdp* rdp, STREAM* s);
 BOOL rdp_client_connect_mcs_attach_user_confirm(rdpRdp* rdp, STREAM* s);
 BOOL rdp_client_connect_mcs_channel_join_confirm(rdpRdp* rdp, STREAM* s);
@@ -62,6 +62,7 @@ static const char* const FASTPATH_UPDATETYPE_STRINGS[] =
 	"Color Pointer",					/* 0x9 */
 	"Cached Pointer",					/* 0xA */
 	"New Pointer",						/* 0xB */
+	"Large Pointer",					/* 0xC */
 };
 #endif
 
@@ -145,18 +146,28 @@ UINT16 fastpath_read_header_rdp(rdpFastPath* fastpath, STREAM* s)
 
 static BOOL fastpath_recv_orders(rdpFastPath* fastpath, STREAM* s)
 {
-	rdpUpdate* update = fastpath->rdp->update;
+	UINT64 start;
 	UINT16 numberOrders;
+	rdpUpdate* update = fastpath->rdp->update;
+
+	start = metrics_start(fastpath->rdp->metrics);
 
 	stream_read_UINT16(s, numberOrders); /* numberOrders (2 bytes) */
 
 	while (numberOrders > 0)
 	{
 		if (!update_recv_order(update, s))
+		{
+			update_flush_order_batch(update);
 			return FALSE;
+		}
+
 		numberOrders--;
 	}
 
+	update_flush_order_batch(update);
+	metrics_stop(fastpath->rdp->metrics, METRICS_ORDERS, start);
+
 	return TRUE;
 }
 
@@ -249,6 +260,11 @@ static BOOL fastpath_recv_update(rdpFastPath* fastpath, BYTE updateCode, UINT32
 			IFCALL(pointer->PointerNew, context, &pointer->pointer_new);
 			break;
 
+		case FASTPATH_UPDATETYPE_LARGE_POINTER:
+			update_read_pointer_large(s, &pointer->pointer_large);
+			IFCALL(pointer->PointerLarge, context, &pointer->pointer_large);
+			break;
+
 		default:
 			DEBUG_WARN("unknown updateCode 0x%X", updateCode);
 			break;
@@ -289,6 +305,12 @@ static BOOL fastpath_recv_update_data(rdpFastPath* fastpath, STREAM* s)
 	{
 		if (decompress_rdp(rdp->mppc_dec, s->p, size, compressionFlags, &roff, &rlen))
 		{
+			if (METRICS_ENABLED(rdp->metrics))
+			{
+				metrics_add_counter(rdp->metrics, METRICS_MPPC_DECOMPRESS_INPUT_BYTES, size);
+				metrics_add_counter(rdp->metrics, METRICS_MPPC_DECOMPRESS_OUTPUT_BYTES, rlen);
+			}
+
 			comp_stream = stream_new(0);
 			comp_stream->data = rdp->mppc_dec->history_buf + roff;
 			comp_stream->p = comp_stream->data;
@@ -310,6 +332,8 @@ static BOOL fastpath_recv_update_data(rdpFastPath* fastpath, STREAM* s)
 	}
 	else
 	{
+		METRICS_ADD(rdp->metrics, METRICS_FASTPATH_FRAGMENTS, 1);
+
 		if (fragmentation == FASTPATH_FRAGMENT_FIRST)
 			stream_set_pos(fastpath->updateData, 0);
 
@@ -326,6 +350,8 @@ static BOOL fastpath_recv_update_data(rdpFastPath* fastpath, STREAM* s)
 
 	if (update_stream)
 	{
+		METRICS_ADD(rdp->metrics, METRICS_FASTPATH_UPDATES, 1);
+
 		if (!fastpath_recv_update(fastpath, updateCode, totalSize, update_stream))
 			return FALSE;
 	}
@@ -605,11 +631,8 @@ BOOL fastpath_send_input_pdu(rdpFastPath* fastpath, STREAM* s)
 
 		fpInputEvents = stream_get_tail(s) + sec_bytes;
 		fpInputEvents_length = length - 3 - sec_bytes;
-		if (rdp->sec_flags & SEC_SECURE_CHECKSUM)
-			security_salted_mac_signature(rdp, fpInputEvents, fpInputEvents_length, TRUE, stream_get_tail(s));
-		else
-			security_mac_signature(rdp, fpInputEvents, fpInputEvents_length, stream_get_tail(s));
-		security_encrypt(fpInputEvents, fpInputEvents_length, rdp);
+		security_encrypt_mac(fpInputEvents, fpInputEvents_length,
+			(rdp->sec_flags & SEC_SECURE_CHECKSUM) ? TRUE : FALSE, stream_get_tail(s), rdp);
 	}
 
 	rdp->sec_flags = 0;
@@ -693,6 +716,12 @@ BOOL fastpath_send_update_pdu(rdpFastPath* fastpath, BYTE updateCode, STREAM* s)
 			}
 			else
 				printf("fastpath_send_update_pdu: mppc_encode failed\n");
+
+			if (METRICS_ENABLED(rdp->metrics))
+			{
+				metrics_add_counter(rdp->metrics, METRICS_MPPC_COMPRESS_INPUT_BYTES, dlen);
+				metrics_add_counter(rdp->metrics, METRICS_MPPC_COMPRESS_OUTPUT_BYTES, pdu_data_bytes);
+			}
 		}
 
 		totalLength -= dlen;
@@ -735,11 +764,8 @@ BOOL fastpath_send_update_pdu(rdpFastPath* fastpath, BYTE updateCode, STREAM* s)
 			/* does this work ? */
 			ptr_to_crypt = bm + 3 + sec_bytes;
 			ptr_sig = bm + 3;
-			if (rdp->sec_flags & SEC_SECURE_CHECKSUM)
-				security_salted_mac_signature(rdp, ptr_to_crypt, bytes_to_crypt, TRUE, ptr_sig);
-			else
-				security_mac_signature(rdp, ptr_to_crypt, bytes_to_crypt, ptr_sig);
-			security_encrypt(ptr_to_crypt, bytes_to_crypt, rdp);
+			security_encrypt_mac(ptr_to_crypt, bytes_to_crypt,
+				(rdp->sec_flags & SEC_SECURE_CHECKSUM) ? TRUE : FALSE, ptr_sig, rdp);
 		}
 
 		if (transport_write(fastpath->rdp->transport, update) < 0)
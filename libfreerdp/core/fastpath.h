@@ -61,7 +61,8 @@ enum FASTPATH_UPDATETYPE
 	FASTPATH_UPDATETYPE_PTR_POSITION = 0x8,
 	FASTPATH_UPDATETYPE_COLOR = 0x9,
 	FASTPATH_UPDATETYPE_CACHED = 0xA,
-	FASTPATH_UPDATETYPE_POINTER = 0xB
+	FASTPATH_UPDATETYPE_POINTER = 0xB,
+	FASTPATH_UPDATETYPE_LARGE_POINTER = 0xC
 };
 
 enum FASTPATH_FRAGMENT
@@ -36,6 +36,9 @@
 
 /* connectErrorCode is 'extern' in errorcodes.h. See comment there.*/
 
+#define RECONNECT_INITIAL_DELAY		500
+#define RECONNECT_MAX_DELAY		16000
+
 /** Creates a new connection based on the settings found in the "instance" parameter
  *  It will use the callbacks registered on the structure to process the pre/post connect operations
  *  that the caller requires.
@@ -98,6 +101,15 @@ BOOL freerdp_connect(freerdp* instance)
 				instance->update->dump_rfx = TRUE;
 		}
 
+		if (instance->settings->dump_pdu)
+		{
+			/* replaying needs the PDUs in the clear */
+			if (instance->settings->encryption)
+				printf("PDUs cannot be dumped with Standard RDP encryption\n");
+			else
+				rdp->transport->pcap_pdu = pcap_open(instance->settings->dump_pdu_file, TRUE);
+		}
+
 		extension_post_connect(rdp->extension);
 
 		IFCALLRET(instance->PostConnect, status, instance);
@@ -162,11 +174,37 @@ BOOL freerdp_get_fds(freerdp* instance, void** rfds, int* rcount, void** wfds, i
 	rdpRdp* rdp;
 
 	rdp = instance->context->rdp;
-	transport_get_fds(rdp->transport, rfds, rcount);
+
+	/* the lost transport has nothing to read, wait for the next reconnection attempt instead */
+	if (rdp->reconnecting)
+		wait_obj_get_fds(rdp->reconnect_event, rfds, rcount);
+	else
+		transport_get_fds(rdp->transport, rfds, rcount);
 
 	return TRUE;
 }
 
+/**
+ * The connection can be resumed if it was lost while the session was active,
+ * the server gave us an auto-reconnect cookie and it did not end the session itself.
+ */
+
+static BOOL freerdp_can_reconnect(rdpRdp* rdp)
+{
+	rdpSettings* settings = rdp->settings;
+
+	if (!settings->auto_reconnection || (settings->auto_reconnect_max_retries == 0))
+		return FALSE;
+
+	if (settings->server_auto_reconnect_cookie->cbLen == 0)
+		return FALSE;
+
+	if (rdp->disconnect || (rdp->errorInfo != 0))
+		return FALSE;
+
+	return (rdp->state == CONNECTION_STATE_ACTIVE) ? TRUE : FALSE;
+}
+
 BOOL freerdp_check_fds(freerdp* instance)
 {
 	int status;
@@ -174,10 +212,106 @@ BOOL freerdp_check_fds(freerdp* instance)
 
 	rdp = instance->context->rdp;
 
+	if (rdp->reconnecting)
+		return freerdp_reconnect(instance);
+
 	status = rdp_check_fds(rdp);
 
 	if (status < 0)
+	{
+		if (freerdp_can_reconnect(rdp))
+			return freerdp_reconnect(instance);
+
 		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/**
+ * Sets the reconnect event once the backoff delay has elapsed, so that the
+ * event loop sleeps in select() instead of in freerdp_reconnect().
+ */
+
+static void* freerdp_reconnect_timer(void* arg)
+{
+	rdpRdp* rdp = (rdpRdp*) arg;
+	freerdp_thread* thread = rdp->reconnect_timer;
+
+	freerdp_thread_wait_timeout(thread, rdp->reconnect_delay);
+
+	if (!freerdp_thread_is_stopped(thread))
+		wait_obj_set(rdp->reconnect_event);
+
+	freerdp_thread_quit(thread);
+
+	return NULL;
+}
+
+/** Reconnects to the server after the connection was lost.
+ *  The session is resumed with the auto-reconnect cookie received from the server, and the
+ *  context (graphics, caches, channels) is kept as it is, so PreConnect and PostConnect are not called again.
+ *  The first call makes an attempt right away. Failed attempts are retried with an exponential backoff,
+ *  up to settings->auto_reconnect_max_retries times, from freerdp_check_fds() once the reconnect event
+ *  returned by freerdp_get_fds() is set. The event loop is never blocked between attempts.
+ *
+ *  @param instance - pointer to a connected rdp_freerdp structure.
+ *
+ *  @return TRUE if the session was resumed or another attempt is scheduled. FALSE once reconnection is given up.
+ */
+BOOL freerdp_reconnect(freerdp* instance)
+{
+	rdpRdp* rdp;
+	rdpSettings* settings;
+
+	rdp = instance->context->rdp;
+	settings = instance->settings;
+
+	if (!rdp->reconnecting)
+	{
+		if (rdp->reconnect_event == NULL)
+		{
+			rdp->reconnect_event = wait_obj_new();
+			rdp->reconnect_timer = freerdp_thread_new();
+		}
+
+		rdp->reconnecting = TRUE;
+		rdp->reconnect_retry = 0;
+		rdp->reconnect_delay = RECONNECT_INITIAL_DELAY;
+		wait_obj_set(rdp->reconnect_event);
+	}
+
+	if (!wait_obj_is_set(rdp->reconnect_event))
+		return TRUE;
+
+	wait_obj_clear(rdp->reconnect_event);
+	rdp->reconnect_retry++;
+
+	DEBUG_RDP("connection lost, reconnecting (attempt %d of %d)",
+			rdp->reconnect_retry, settings->auto_reconnect_max_retries);
+
+	if (rdp_client_reconnect(rdp))
+	{
+		rdp->reconnecting = FALSE;
+		return TRUE;
+	}
+
+	/* the server refused to resume the session, or we are out of retries */
+	if (rdp->disconnect || (rdp->errorInfo != 0) ||
+			(rdp->reconnect_retry >= settings->auto_reconnect_max_retries))
+	{
+		DEBUG_RDP("unable to reconnect to %s", settings->hostname);
+		rdp->reconnecting = FALSE;
+		return FALSE;
+	}
+
+	if (rdp->reconnect_retry > 1)
+		rdp->reconnect_delay = MIN(rdp->reconnect_delay * 2, RECONNECT_MAX_DELAY);
+
+	/* a previous timer has quit by now, it set the event this attempt was woken up by */
+	freerdp_thread_stop(rdp->reconnect_timer);
+	wait_obj_clear(rdp->reconnect_timer->signals[0]);
+	freerdp_thread_start(rdp->reconnect_timer, freerdp_reconnect_timer, rdp);
 
 	return TRUE;
 }
@@ -237,6 +371,7 @@ void freerdp_context_new(freerdp* instance)
 	instance->context->graphics = graphics_new(instance->context);
 	instance->context->instance = instance;
 	instance->context->rdp = rdp;
+	instance->context->metrics = rdp->metrics;
 
 	instance->update->context = instance->context;
 	instance->update->pointer->context = instance->context;
@@ -278,6 +413,48 @@ UINT32 freerdp_error_info(freerdp* instance)
 	return instance->context->rdp->errorInfo;
 }
 
+/**
+ * Take a snapshot of the runtime metrics of a connection. Metrics are only
+ * recorded once enabled with metrics_enable(context->metrics, TRUE).
+ */
+
+void freerdp_get_metrics(rdpContext* context, rdpMetricsSnapshot* snapshot)
+{
+	metrics_snapshot(context->metrics, snapshot);
+}
+
+static const char* const CONNECT_PHASE_STRINGS[] =
+{
+	"nego",
+	"tls",
+	"nla",
+	"mcs",
+	"license",
+	"capability",
+	"finalization"
+};
+
+/**
+ * Time spent in a phase of the last connection, in milliseconds.
+ * @param phase one of the CONNECT_PHASE values
+ */
+
+UINT32 freerdp_get_connect_time(freerdp* instance, int phase)
+{
+	if ((phase < 0) || (phase >= CONNECT_PHASE_COUNT))
+		return 0;
+
+	return instance->context->rdp->connect_time[phase];
+}
+
+const char* freerdp_get_connect_phase_string(int phase)
+{
+	if ((phase < 0) || (phase >= CONNECT_PHASE_COUNT))
+		return "unknown";
+
+	return CONNECT_PHASE_STRINGS[phase];
+}
+
 /** Allocator function for the rdp_freerdp structure.
  *  @return an allocated structure filled with 0s. Need to be deallocated using freerdp_free()
  */
@@ -21,7 +21,10 @@
 #include "config.h"
 #endif
 
+#include <winpr/crt.h>
+
 #include <freerdp/utils/unicode.h>
+#include <freerdp/crypto/crypto.h>
 
 #include "timezone.h"
 
@@ -60,6 +63,58 @@ void rdp_read_server_auto_reconnect_cookie(STREAM* s, rdpSettings* settings)
 	stream_read(s, autoReconnectCookie->arcRandomBits, 16); /* arcRandomBits (16 bytes) */
 }
 
+/**
+ * Write Server Auto Reconnect Cookie (ARC_SC_PRIVATE_PACKET).\n
+ * @msdn{cc240540}
+ * @param s stream
+ * @param settings settings
+ */
+
+void rdp_write_server_auto_reconnect_cookie(STREAM* s, rdpSettings* settings)
+{
+	ARC_SC_PRIVATE_PACKET* autoReconnectCookie;
+	autoReconnectCookie = settings->server_auto_reconnect_cookie;
+
+	stream_write_UINT32(s, autoReconnectCookie->cbLen); /* cbLen (4 bytes) */
+	stream_write_UINT32(s, autoReconnectCookie->version); /* version (4 bytes) */
+	stream_write_UINT32(s, autoReconnectCookie->logonId); /* LogonId (4 bytes) */
+	stream_write(s, autoReconnectCookie->arcRandomBits, 16); /* arcRandomBits (16 bytes) */
+}
+
+/**
+ * Compute the Client Auto Reconnect Cookie from the cookie received in the previous session.\n
+ * SecurityVerifier = HMAC_MD5(ArcRandomBits, ClientRandom), where ClientRandom is the client
+ * random of the new connection, or 32 zero bytes when Standard RDP Security is not used.
+ * @msdn{cc240541}
+ * @param settings settings
+ */
+
+void rdp_compute_client_auto_reconnect_cookie(rdpSettings* settings)
+{
+	CryptoHmac hmac;
+	BYTE client_random[CLIENT_RANDOM_LENGTH];
+	ARC_CS_PRIVATE_PACKET* clientCookie;
+	ARC_SC_PRIVATE_PACKET* serverCookie;
+
+	clientCookie = settings->client_auto_reconnect_cookie;
+	serverCookie = settings->server_auto_reconnect_cookie;
+
+	ZeroMemory(client_random, sizeof(client_random));
+
+	if ((settings->client_random != NULL) && (settings->client_random_length >= CLIENT_RANDOM_LENGTH))
+		CopyMemory(client_random, settings->client_random, CLIENT_RANDOM_LENGTH);
+
+	hmac = crypto_hmac_new();
+	crypto_hmac_md5_init(hmac, serverCookie->arcRandomBits, 16);
+	crypto_hmac_update(hmac, client_random, sizeof(client_random));
+	crypto_hmac_final(hmac, clientCookie->securityVerifier, 16);
+	crypto_hmac_free(hmac);
+
+	clientCookie->cbLen = 28;
+	clientCookie->version = serverCookie->version;
+	clientCookie->logonId = serverCookie->logonId;
+}
+
 /**
  * Read Client Auto Reconnect Cookie (ARC_CS_PRIVATE_PACKET).\n
  * @msdn{cc240541}
@@ -461,6 +516,10 @@ BOOL rdp_send_client_info(rdpRdp* rdp)
 {
 	STREAM* s;
 
+	/* a cookie from a previous session is only valid for the client random of this one */
+	if (rdp->settings->auto_reconnection && (rdp->settings->server_auto_reconnect_cookie->cbLen > 0))
+		rdp_compute_client_auto_reconnect_cookie(rdp->settings);
+
 	//rdp->settings->crypt_flags |= SEC_INFO_PKT;
 	rdp->sec_flags |= SEC_INFO_PKT;
 	s = rdp_send_stream_init(rdp);
@@ -568,3 +627,38 @@ BOOL rdp_recv_save_session_info(rdpRdp* rdp, STREAM* s)
 	return TRUE;
 }
 
+/**
+ * Send Save Session Info PDU carrying a Logon Info Extended structure with the
+ * Server Auto Reconnect Cookie. A new cookie is generated unless one was set up
+ * by the server application.
+ * @msdn{cc240636}
+ * @param rdp rdp module
+ */
+
+BOOL rdp_send_save_session_info_auto_reconnect_cookie(rdpRdp* rdp)
+{
+	STREAM* s;
+	ARC_SC_PRIVATE_PACKET* autoReconnectCookie;
+
+	autoReconnectCookie = rdp->settings->server_auto_reconnect_cookie;
+
+	if (autoReconnectCookie->cbLen == 0)
+	{
+		autoReconnectCookie->cbLen = 28;
+		autoReconnectCookie->version = AUTO_RECONNECT_VERSION_1;
+		crypto_nonce(autoReconnectCookie->arcRandomBits, 16);
+	}
+
+	s = rdp_data_pdu_init(rdp);
+
+	stream_check_size(s, 4 + 6 + 4 + 28 + 570);
+
+	stream_write_UINT32(s, INFO_TYPE_LOGON_EXTENDED_INF); /* infoType (4 bytes) */
+	stream_write_UINT16(s, 6 + 4 + 28); /* Length (2 bytes) */
+	stream_write_UINT32(s, LOGON_EX_AUTORECONNECTCOOKIE); /* fieldsPresent (4 bytes) */
+	stream_write_UINT32(s, 28); /* cbFieldData (4 bytes) */
+	rdp_write_server_auto_reconnect_cookie(s, rdp->settings);
+	stream_write_zero(s, 570); /* pad */
+
+	return rdp_send_data_pdu(rdp, s, DATA_PDU_TYPE_SAVE_SESSION_INFO, rdp->mcs->user_id);
+}
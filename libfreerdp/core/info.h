@@ -76,6 +76,8 @@ void rdp_get_client_time_zone(STREAM* s, rdpSettings* settings);
 BOOL rdp_read_client_time_zone(STREAM* s, rdpSettings* settings);
 void rdp_write_client_time_zone(STREAM* s, rdpSettings* settings);
 void rdp_read_server_auto_reconnect_cookie(STREAM* s, rdpSettings* settings);
+void rdp_write_server_auto_reconnect_cookie(STREAM* s, rdpSettings* settings);
+void rdp_compute_client_auto_reconnect_cookie(rdpSettings* settings);
 BOOL rdp_read_client_auto_reconnect_cookie(STREAM* s, rdpSettings* settings);
 void rdp_write_client_auto_reconnect_cookie(STREAM* s, rdpSettings* settings);
 void rdp_write_auto_reconnect_cookie(STREAM* s, rdpSettings* settings);
@@ -86,5 +88,6 @@ void rdp_write_info_packet(STREAM* s, rdpSettings* settings);
 BOOL rdp_recv_client_info(rdpRdp* rdp, STREAM* s);
 BOOL rdp_send_client_info(rdpRdp* rdp);
 BOOL rdp_recv_save_session_info(rdpRdp* rdp, STREAM* s);
+BOOL rdp_send_save_session_info_auto_reconnect_cookie(rdpRdp* rdp);
 
 #endif /* __INFO_H */
@@ -1702,6 +1702,127 @@ void update_read_bounds(STREAM* s, rdpBounds* bounds)
 		update_read_coord(s, &bounds->bottom, TRUE);
 }
 
+static void update_batch_brush(rdpBrush* brush, rdpBrush* last)
+{
+	if (brush->data == (BYTE*) last->p8x8)
+		brush->data = (BYTE*) brush->p8x8;
+}
+
+/**
+ * Decode a primary order into the order batch.
+ * @param update update
+ * @param s stream
+ * @param flags control flags
+ * @return FALSE if the order type cannot be batched
+ */
+
+static BOOL update_batch_primary_order(rdpUpdate* update, STREAM* s, BYTE flags)
+{
+	ORDER_BATCH* batch;
+	ORDER_BATCH_ENTRY* entry;
+	ORDER_INFO* orderInfo;
+	rdpPrimaryUpdate* primary = update->primary;
+
+	batch = &(primary->batch);
+	orderInfo = &(primary->order_info);
+
+	switch (orderInfo->orderType)
+	{
+		case ORDER_TYPE_DSTBLT:
+		case ORDER_TYPE_PATBLT:
+		case ORDER_TYPE_SCRBLT:
+		case ORDER_TYPE_OPAQUE_RECT:
+		case ORDER_TYPE_LINE_TO:
+		case ORDER_TYPE_MEMBLT:
+		case ORDER_TYPE_MEM3BLT:
+		case ORDER_TYPE_GLYPH_INDEX:
+			break;
+
+		default:
+			return FALSE;
+	}
+
+	if (batch->count >= batch->size)
+	{
+		batch->size = (batch->size > 0) ? batch->size * 2 : 64;
+		batch->entries = (ORDER_BATCH_ENTRY*) realloc(batch->entries, sizeof(ORDER_BATCH_ENTRY) * batch->size);
+	}
+
+	entry = &batch->entries[batch->count++];
+	entry->orderType = orderInfo->orderType;
+	entry->bounded = (flags & ORDER_BOUNDS) ? TRUE : FALSE;
+	entry->skip = FALSE;
+
+	if (entry->bounded)
+		memcpy(&entry->bounds, &orderInfo->bounds, sizeof(rdpBounds));
+
+	switch (orderInfo->orderType)
+	{
+		case ORDER_TYPE_DSTBLT:
+			update_read_dstblt_order(s, orderInfo, &(primary->dstblt));
+			memcpy(&entry->order.dstblt, &primary->dstblt, sizeof(DSTBLT_ORDER));
+			break;
+
+		case ORDER_TYPE_PATBLT:
+			update_read_patblt_order(s, orderInfo, &(primary->patblt));
+			memcpy(&entry->order.patblt, &primary->patblt, sizeof(PATBLT_ORDER));
+			update_batch_brush(&entry->order.patblt.brush, &primary->patblt.brush);
+			break;
+
+		case ORDER_TYPE_SCRBLT:
+			update_read_scrblt_order(s, orderInfo, &(primary->scrblt));
+			memcpy(&entry->order.scrblt, &primary->scrblt, sizeof(SCRBLT_ORDER));
+			break;
+
+		case ORDER_TYPE_OPAQUE_RECT:
+			update_read_opaque_rect_order(s, orderInfo, &(primary->opaque_rect));
+			memcpy(&entry->order.opaque_rect, &primary->opaque_rect, sizeof(OPAQUE_RECT_ORDER));
+			break;
+
+		case ORDER_TYPE_LINE_TO:
+			update_read_line_to_order(s, orderInfo, &(primary->line_to));
+			memcpy(&entry->order.line_to, &primary->line_to, sizeof(LINE_TO_ORDER));
+			break;
+
+		case ORDER_TYPE_MEMBLT:
+			update_read_memblt_order(s, orderInfo, &(primary->memblt));
+			memcpy(&entry->order.memblt, &primary->memblt, sizeof(MEMBLT_ORDER));
+			break;
+
+		case ORDER_TYPE_MEM3BLT:
+			update_read_mem3blt_order(s, orderInfo, &(primary->mem3blt));
+			memcpy(&entry->order.mem3blt, &primary->mem3blt, sizeof(MEM3BLT_ORDER));
+			update_batch_brush(&entry->order.mem3blt.brush, &primary->mem3blt.brush);
+			break;
+
+		case ORDER_TYPE_GLYPH_INDEX:
+			update_read_glyph_index_order(s, orderInfo, &(primary->glyph_index));
+			memcpy(&entry->order.glyph_index, &primary->glyph_index, sizeof(GLYPH_INDEX_ORDER));
+			update_batch_brush(&entry->order.glyph_index.brush, &primary->glyph_index.brush);
+			break;
+	}
+
+	return TRUE;
+}
+
+/**
+ * Hand the pending order batch to the renderer.
+ * Only renderers registering OrderBatch (currently the software GDI) batch
+ * orders; the others keep receiving them one at a time.
+ * @param update update
+ */
+
+void update_flush_order_batch(rdpUpdate* update)
+{
+	rdpPrimaryUpdate* primary = update->primary;
+
+	if (primary->batch.count < 1)
+		return;
+
+	IFCALL(primary->OrderBatch, update->context, &primary->batch);
+	primary->batch.count = 0;
+}
+
 BOOL update_recv_primary_order(rdpUpdate* update, STREAM* s, BYTE flags)
 {
 	ORDER_INFO* orderInfo;
@@ -1726,8 +1847,6 @@ BOOL update_recv_primary_order(rdpUpdate* update, STREAM* s, BYTE flags)
 	{
 		if (!(flags & ORDER_ZERO_BOUNDS_DELTAS))
 			update_read_bounds(s, &orderInfo->bounds);
-
-		IFCALL(update->SetBounds, context, &orderInfo->bounds);
 	}
 
 	orderInfo->deltaCoordinates = (flags & ORDER_DELTA_COORDINATES) ? TRUE : FALSE;
@@ -1736,6 +1855,17 @@ BOOL update_recv_primary_order(rdpUpdate* update, STREAM* s, BYTE flags)
 	printf("%s Primary Drawing Order (0x%02X)\n", PRIMARY_DRAWING_ORDER_STRINGS[orderInfo->orderType], orderInfo->orderType);
 #endif
 
+	if (primary->OrderBatch != NULL)
+	{
+		if (update_batch_primary_order(update, s, flags))
+			return TRUE;
+
+		update_flush_order_batch(update);
+	}
+
+	if (flags & ORDER_BOUNDS)
+		IFCALL(update->SetBounds, context, &orderInfo->bounds);
+
 	switch (orderInfo->orderType)
 	{
 		case ORDER_TYPE_DSTBLT:
@@ -2034,6 +2164,11 @@ BOOL update_recv_order(rdpUpdate* update, STREAM* s)
 
 	stream_read_BYTE(s, controlFlags); /* controlFlags (1 byte) */
 
+	/* secondary and alternate secondary orders may change what batched orders refer to */
+
+	if ((controlFlags & (ORDER_STANDARD | ORDER_SECONDARY)) != ORDER_STANDARD)
+		update_flush_order_batch(update);
+
 	if (!(controlFlags & ORDER_STANDARD))
 		update_recv_altsec_order(update, s, controlFlags);
 	else if (controlFlags & ORDER_SECONDARY)
@@ -2046,3 +2181,859 @@ BOOL update_recv_order(rdpUpdate* update, STREAM* s)
 
 	return TRUE;
 }
+
+/* Drawing Order Encoding */
+
+static const BYTE BPP_CBR2[] =
+{
+		0, 0, 0, 0, 0, 0, 0, 0, 3, 0, 0, 0, 0, 0, 0, 0,
+		4, 0, 0, 0, 0, 0, 0, 0, 5, 0, 0, 0, 0, 0, 0, 0, 6
+};
+
+static INLINE BOOL update_check_delta(INT32 value, INT32 last)
+{
+	return ((value - last) >= -128) && ((value - last) <= 127);
+}
+
+static INLINE void update_write_coord(STREAM* s, INT32 coord, INT32 last, BOOL delta)
+{
+	if (delta)
+		stream_write_BYTE(s, (BYTE) (coord - last));
+	else
+		stream_write_UINT16(s, (UINT16) coord);
+}
+
+static INLINE void update_write_color(STREAM* s, UINT32 color)
+{
+	stream_write_BYTE(s, color & 0xFF);
+	stream_write_BYTE(s, (color >> 8) & 0xFF);
+	stream_write_BYTE(s, (color >> 16) & 0xFF);
+}
+
+static INLINE void update_write_2byte_unsigned(STREAM* s, UINT32 value)
+{
+	if (value > 0x7F)
+	{
+		stream_write_BYTE(s, ((value >> 8) & 0x7F) | 0x80);
+		stream_write_BYTE(s, value & 0xFF);
+	}
+	else
+	{
+		stream_write_BYTE(s, value);
+	}
+}
+
+static INLINE void update_write_4byte_unsigned(STREAM* s, UINT32 value)
+{
+	if (value <= 0x3F)
+	{
+		stream_write_BYTE(s, value);
+	}
+	else if (value <= 0x3FFF)
+	{
+		stream_write_BYTE(s, (value >> 8) | 0x40);
+		stream_write_BYTE(s, value & 0xFF);
+	}
+	else if (value <= 0x3FFFFF)
+	{
+		stream_write_BYTE(s, (value >> 16) | 0x80);
+		stream_write_BYTE(s, (value >> 8) & 0xFF);
+		stream_write_BYTE(s, value & 0xFF);
+	}
+	else
+	{
+		stream_write_BYTE(s, ((value >> 24) & 0x3F) | 0xC0);
+		stream_write_BYTE(s, (value >> 16) & 0xFF);
+		stream_write_BYTE(s, (value >> 8) & 0xFF);
+		stream_write_BYTE(s, value & 0xFF);
+	}
+}
+
+static INLINE BYTE* update_brush_data(rdpBrush* brush)
+{
+	return (brush->data != NULL) ? brush->data : brush->p8x8;
+}
+
+static INLINE void update_write_brush(STREAM* s, rdpBrush* brush, BYTE fieldFlags)
+{
+	BYTE* data;
+
+	if (fieldFlags & ORDER_FIELD_01)
+		stream_write_BYTE(s, brush->x);
+
+	if (fieldFlags & ORDER_FIELD_02)
+		stream_write_BYTE(s, brush->y);
+
+	if (fieldFlags & ORDER_FIELD_03)
+		stream_write_BYTE(s, brush->style);
+
+	if (fieldFlags & ORDER_FIELD_04)
+		stream_write_BYTE(s, brush->hatch);
+
+	if (fieldFlags & ORDER_FIELD_05)
+	{
+		data = update_brush_data(brush);
+		stream_write_BYTE(s, data[7]);
+		stream_write_BYTE(s, data[6]);
+		stream_write_BYTE(s, data[5]);
+		stream_write_BYTE(s, data[4]);
+		stream_write_BYTE(s, data[3]);
+		stream_write_BYTE(s, data[2]);
+		stream_write_BYTE(s, data[1]);
+	}
+}
+
+static INLINE void update_copy_brush(rdpBrush* brush, rdpBrush* last)
+{
+	memcpy(last->p8x8, update_brush_data(brush), 8);
+	last->x = brush->x;
+	last->y = brush->y;
+	last->bpp = brush->bpp;
+	last->style = brush->style;
+	last->hatch = brush->hatch;
+	last->index = brush->index;
+	last->data = last->p8x8;
+}
+
+/**
+ * The prepare functions compare an order against the last order of the same
+ * type sent on the connection. Only fields that changed are flagged, and
+ * coordinates are sent as one byte deltas when all changed coordinates allow it.
+ */
+
+static INLINE void update_prepare_coord(ORDER_INFO* orderInfo, UINT32 field, INT32 coord, INT32 last)
+{
+	if (coord != last)
+	{
+		orderInfo->fieldFlags |= field;
+
+		if (!update_check_delta(coord, last))
+			orderInfo->deltaCoordinates = FALSE;
+	}
+}
+
+static INLINE void update_prepare_field(ORDER_INFO* orderInfo, UINT32 field, UINT32 value, UINT32 last)
+{
+	if (value != last)
+		orderInfo->fieldFlags |= field;
+}
+
+static INLINE UINT32 update_prepare_brush(rdpBrush* brush, rdpBrush* last)
+{
+	UINT32 fieldFlags = 0;
+
+	if (brush->x != last->x)
+		fieldFlags |= ORDER_FIELD_01;
+
+	if (brush->y != last->y)
+		fieldFlags |= ORDER_FIELD_02;
+
+	if (brush->style != last->style)
+		fieldFlags |= ORDER_FIELD_03;
+
+	if (brush->hatch != last->hatch)
+		fieldFlags |= ORDER_FIELD_04;
+
+	if (memcmp(&update_brush_data(brush)[1], &update_brush_data(last)[1], 7) != 0)
+		fieldFlags |= ORDER_FIELD_05;
+
+	return fieldFlags;
+}
+
+static void update_prepare_dstblt_order(ORDER_INFO* orderInfo, DSTBLT_ORDER* dstblt, DSTBLT_ORDER* last)
+{
+	update_prepare_coord(orderInfo, ORDER_FIELD_01, dstblt->nLeftRect, last->nLeftRect);
+	update_prepare_coord(orderInfo, ORDER_FIELD_02, dstblt->nTopRect, last->nTopRect);
+	update_prepare_coord(orderInfo, ORDER_FIELD_03, dstblt->nWidth, last->nWidth);
+	update_prepare_coord(orderInfo, ORDER_FIELD_04, dstblt->nHeight, last->nHeight);
+	update_prepare_field(orderInfo, ORDER_FIELD_05, dstblt->bRop, last->bRop);
+}
+
+static void update_prepare_patblt_order(ORDER_INFO* orderInfo, PATBLT_ORDER* patblt, PATBLT_ORDER* last)
+{
+	update_prepare_coord(orderInfo, ORDER_FIELD_01, patblt->nLeftRect, last->nLeftRect);
+	update_prepare_coord(orderInfo, ORDER_FIELD_02, patblt->nTopRect, last->nTopRect);
+	update_prepare_coord(orderInfo, ORDER_FIELD_03, patblt->nWidth, last->nWidth);
+	update_prepare_coord(orderInfo, ORDER_FIELD_04, patblt->nHeight, last->nHeight);
+	update_prepare_field(orderInfo, ORDER_FIELD_05, patblt->bRop, last->bRop);
+	update_prepare_field(orderInfo, ORDER_FIELD_06, patblt->backColor, last->backColor);
+	update_prepare_field(orderInfo, ORDER_FIELD_07, patblt->foreColor, last->foreColor);
+	orderInfo->fieldFlags |= update_prepare_brush(&patblt->brush, &last->brush) << 7;
+}
+
+static void update_prepare_scrblt_order(ORDER_INFO* orderInfo, SCRBLT_ORDER* scrblt, SCRBLT_ORDER* last)
+{
+	update_prepare_coord(orderInfo, ORDER_FIELD_01, scrblt->nLeftRect, last->nLeftRect);
+	update_prepare_coord(orderInfo, ORDER_FIELD_02, scrblt->nTopRect, last->nTopRect);
+	update_prepare_coord(orderInfo, ORDER_FIELD_03, scrblt->nWidth, last->nWidth);
+	update_prepare_coord(orderInfo, ORDER_FIELD_04, scrblt->nHeight, last->nHeight);
+	update_prepare_field(orderInfo, ORDER_FIELD_05, scrblt->bRop, last->bRop);
+	update_prepare_coord(orderInfo, ORDER_FIELD_06, scrblt->nXSrc, last->nXSrc);
+	update_prepare_coord(orderInfo, ORDER_FIELD_07, scrblt->nYSrc, last->nYSrc);
+}
+
+static void update_prepare_opaque_rect_order(ORDER_INFO* orderInfo, OPAQUE_RECT_ORDER* opaque_rect, OPAQUE_RECT_ORDER* last)
+{
+	update_prepare_coord(orderInfo, ORDER_FIELD_01, opaque_rect->nLeftRect, last->nLeftRect);
+	update_prepare_coord(orderInfo, ORDER_FIELD_02, opaque_rect->nTopRect, last->nTopRect);
+	update_prepare_coord(orderInfo, ORDER_FIELD_03, opaque_rect->nWidth, last->nWidth);
+	update_prepare_coord(orderInfo, ORDER_FIELD_04, opaque_rect->nHeight, last->nHeight);
+	update_prepare_field(orderInfo, ORDER_FIELD_05, opaque_rect->color & 0xFF, last->color & 0xFF);
+	update_prepare_field(orderInfo, ORDER_FIELD_06, opaque_rect->color & 0xFF00, last->color & 0xFF00);
+	update_prepare_field(orderInfo, ORDER_FIELD_07, opaque_rect->color & 0xFF0000, last->color & 0xFF0000);
+}
+
+static void update_prepare_line_to_order(ORDER_INFO* orderInfo, LINE_TO_ORDER* line_to, LINE_TO_ORDER* last)
+{
+	update_prepare_field(orderInfo, ORDER_FIELD_01, line_to->backMode, last->backMode);
+	update_prepare_coord(orderInfo, ORDER_FIELD_02, line_to->nXStart, last->nXStart);
+	update_prepare_coord(orderInfo, ORDER_FIELD_03, line_to->nYStart, last->nYStart);
+	update_prepare_coord(orderInfo, ORDER_FIELD_04, line_to->nXEnd, last->nXEnd);
+	update_prepare_coord(orderInfo, ORDER_FIELD_05, line_to->nYEnd, last->nYEnd);
+	update_prepare_field(orderInfo, ORDER_FIELD_06, line_to->backColor, last->backColor);
+	update_prepare_field(orderInfo, ORDER_FIELD_07, line_to->bRop2, last->bRop2);
+	update_prepare_field(orderInfo, ORDER_FIELD_08, line_to->penStyle, last->penStyle);
+	update_prepare_field(orderInfo, ORDER_FIELD_09, line_to->penWidth, last->penWidth);
+	update_prepare_field(orderInfo, ORDER_FIELD_10, line_to->penColor, last->penColor);
+}
+
+static void update_prepare_memblt_order(ORDER_INFO* orderInfo, MEMBLT_ORDER* memblt, MEMBLT_ORDER* last)
+{
+	/* the parser resets colorIndex when the cacheId field is omitted */
+
+	if ((memblt->cacheId != last->cacheId) || (memblt->colorIndex != 0))
+		orderInfo->fieldFlags |= ORDER_FIELD_01;
+
+	update_prepare_coord(orderInfo, ORDER_FIELD_02, memblt->nLeftRect, last->nLeftRect);
+	update_prepare_coord(orderInfo, ORDER_FIELD_03, memblt->nTopRect, last->nTopRect);
+	update_prepare_coord(orderInfo, ORDER_FIELD_04, memblt->nWidth, last->nWidth);
+	update_prepare_coord(orderInfo, ORDER_FIELD_05, memblt->nHeight, last->nHeight);
+	update_prepare_field(orderInfo, ORDER_FIELD_06, memblt->bRop, last->bRop);
+	update_prepare_coord(orderInfo, ORDER_FIELD_07, memblt->nXSrc, last->nXSrc);
+	update_prepare_coord(orderInfo, ORDER_FIELD_08, memblt->nYSrc, last->nYSrc);
+	update_prepare_field(orderInfo, ORDER_FIELD_09, memblt->cacheIndex, last->cacheIndex);
+}
+
+static void update_prepare_mem3blt_order(ORDER_INFO* orderInfo, MEM3BLT_ORDER* mem3blt, MEM3BLT_ORDER* last)
+{
+	if ((mem3blt->cacheId != last->cacheId) || (mem3blt->colorIndex != 0))
+		orderInfo->fieldFlags |= ORDER_FIELD_01;
+
+	update_prepare_coord(orderInfo, ORDER_FIELD_02, mem3blt->nLeftRect, last->nLeftRect);
+	update_prepare_coord(orderInfo, ORDER_FIELD_03, mem3blt->nTopRect, last->nTopRect);
+	update_prepare_coord(orderInfo, ORDER_FIELD_04, mem3blt->nWidth, last->nWidth);
+	update_prepare_coord(orderInfo, ORDER_FIELD_05, mem3blt->nHeight, last->nHeight);
+	update_prepare_field(orderInfo, ORDER_FIELD_06, mem3blt->bRop, last->bRop);
+	update_prepare_coord(orderInfo, ORDER_FIELD_07, mem3blt->nXSrc, last->nXSrc);
+	update_prepare_coord(orderInfo, ORDER_FIELD_08, mem3blt->nYSrc, last->nYSrc);
+	update_prepare_field(orderInfo, ORDER_FIELD_09, mem3blt->backColor, last->backColor);
+	update_prepare_field(orderInfo, ORDER_FIELD_10, mem3blt->foreColor, last->foreColor);
+	orderInfo->fieldFlags |= update_prepare_brush(&mem3blt->brush, &last->brush) << 10;
+	update_prepare_field(orderInfo, ORDER_FIELD_16, mem3blt->cacheIndex, last->cacheIndex);
+}
+
+static void update_prepare_glyph_index_order(ORDER_INFO* orderInfo, GLYPH_INDEX_ORDER* glyph_index, GLYPH_INDEX_ORDER* last)
+{
+	update_prepare_field(orderInfo, ORDER_FIELD_01, glyph_index->cacheId, last->cacheId);
+	update_prepare_field(orderInfo, ORDER_FIELD_02, glyph_index->flAccel, last->flAccel);
+	update_prepare_field(orderInfo, ORDER_FIELD_03, glyph_index->ulCharInc, last->ulCharInc);
+	update_prepare_field(orderInfo, ORDER_FIELD_04, glyph_index->fOpRedundant, last->fOpRedundant);
+	update_prepare_field(orderInfo, ORDER_FIELD_05, glyph_index->backColor, last->backColor);
+	update_prepare_field(orderInfo, ORDER_FIELD_06, glyph_index->foreColor, last->foreColor);
+	update_prepare_field(orderInfo, ORDER_FIELD_07, glyph_index->bkLeft, last->bkLeft);
+	update_prepare_field(orderInfo, ORDER_FIELD_08, glyph_index->bkTop, last->bkTop);
+	update_prepare_field(orderInfo, ORDER_FIELD_09, glyph_index->bkRight, last->bkRight);
+	update_prepare_field(orderInfo, ORDER_FIELD_10, glyph_index->bkBottom, last->bkBottom);
+	update_prepare_field(orderInfo, ORDER_FIELD_11, glyph_index->opLeft, last->opLeft);
+	update_prepare_field(orderInfo, ORDER_FIELD_12, glyph_index->opTop, last->opTop);
+	update_prepare_field(orderInfo, ORDER_FIELD_13, glyph_index->opRight, last->opRight);
+	update_prepare_field(orderInfo, ORDER_FIELD_14, glyph_index->opBottom, last->opBottom);
+	orderInfo->fieldFlags |= update_prepare_brush(&glyph_index->brush, &last->brush) << 14;
+	update_prepare_field(orderInfo, ORDER_FIELD_20, glyph_index->x, last->x);
+	update_prepare_field(orderInfo, ORDER_FIELD_21, glyph_index->y, last->y);
+
+	if ((glyph_index->cbData != last->cbData) ||
+			(memcmp(glyph_index->data, last->data, glyph_index->cbData) != 0))
+		orderInfo->fieldFlags |= ORDER_FIELD_22;
+}
+
+/* Primary Drawing Orders */
+
+void update_write_dstblt_order(STREAM* s, ORDER_INFO* orderInfo, DSTBLT_ORDER* dstblt, DSTBLT_ORDER* last)
+{
+	if (orderInfo->fieldFlags & ORDER_FIELD_01)
+		update_write_coord(s, dstblt->nLeftRect, last->nLeftRect, orderInfo->deltaCoordinates);
+
+	if (orderInfo->fieldFlags & ORDER_FIELD_02)
+		update_write_coord(s, dstblt->nTopRect, last->nTopRect, orderInfo->deltaCoordinates);
+
+	if (orderInfo->fieldFlags & ORDER_FIELD_03)
+		update_write_coord(s, dstblt->nWidth, last->nWidth, orderInfo->deltaCoordinates);
+
+	if (orderInfo->fieldFlags & ORDER_FIELD_04)
+		update_write_coord(s, dstblt->nHeight, last->nHeight, orderInfo->deltaCoordinates);
+
+	if (orderInfo->fieldFlags & ORDER_FIELD_05)
+		stream_write_BYTE(s, dstblt->bRop);
+}
+
+void update_write_patblt_order(STREAM* s, ORDER_INFO* orderInfo, PATBLT_ORDER* patblt, PATBLT_ORDER* last)
+{
+	if (orderInfo->fieldFlags & ORDER_FIELD_01)
+		update_write_coord(s, patblt->nLeftRect, last->nLeftRect, orderInfo->deltaCoordinates);
+
+	if (orderInfo->fieldFlags & ORDER_FIELD_02)
+		update_write_coord(s, patblt->nTopRect, last->nTopRect, orderInfo->deltaCoordinates);
+
+	if (orderInfo->fieldFlags & ORDER_FIELD_03)
+		update_write_coord(s, patblt->nWidth, last->nWidth, orderInfo->deltaCoordinates);
+
+	if (orderInfo->fieldFlags & ORDER_FIELD_04)
+		update_write_coord(s, patblt->nHeight, last->nHeight, orderInfo->deltaCoordinates);
+
+	if (orderInfo->fieldFlags & ORDER_FIELD_05)
+		stream_write_BYTE(s, patblt->bRop);
+
+	if (orderInfo->fieldFlags & ORDER_FIELD_06)
+		update_write_color(s, patblt->backColor);
+
+	if (orderInfo->fieldFlags & ORDER_FIELD_07)
+		update_write_color(s, patblt->foreColor);
+
+	update_write_brush(s, &patblt->brush, orderInfo->fieldFlags >> 7);
+}
+
+void update_write_scrblt_order(STREAM* s, ORDER_INFO* orderInfo, SCRBLT_ORDER* scrblt, SCRBLT_ORDER* last)
+{
+	if (orderInfo->fieldFlags & ORDER_FIELD_01)
+		update_write_coord(s, scrblt->nLeftRect, last->nLeftRect, orderInfo->deltaCoordinates);
+
+	if (orderInfo->fieldFlags & ORDER_FIELD_02)
+		update_write_coord(s, scrblt->nTopRect, last->nTopRect, orderInfo->deltaCoordinates);
+
+	if (orderInfo->fieldFlags & ORDER_FIELD_03)
+		update_write_coord(s, scrblt->nWidth, last->nWidth, orderInfo->deltaCoordinates);
+
+	if (orderInfo->fieldFlags & ORDER_FIELD_04)
+		update_write_coord(s, scrblt->nHeight, last->nHeight, orderInfo->deltaCoordinates);
+
+	if (orderInfo->fieldFlags & ORDER_FIELD_05)
+		stream_write_BYTE(s, scrblt->bRop);
+
+	if (orderInfo->fieldFlags & ORDER_FIELD_06)
+		update_write_coord(s, scrblt->nXSrc, last->nXSrc, orderInfo->deltaCoordinates);
+
+	if (orderInfo->fieldFlags & ORDER_FIELD_07)
+		update_write_coord(s, scrblt->nYSrc, last->nYSrc, orderInfo->deltaCoordinates);
+}
+
+void update_write_opaque_rect_order(STREAM* s, ORDER_INFO* orderInfo, OPAQUE_RECT_ORDER* opaque_rect, OPAQUE_RECT_ORDER* last)
+{
+	if (orderInfo->fieldFlags & ORDER_FIELD_01)
+		update_write_coord(s, opaque_rect->nLeftRect, last->nLeftRect, orderInfo->deltaCoordinates);
+
+	if (orderInfo->fieldFlags & ORDER_FIELD_02)
+		update_write_coord(s, opaque_rect->nTopRect, last->nTopRect, orderInfo->deltaCoordinates);
+
+	if (orderInfo->fieldFlags & ORDER_FIELD_03)
+		update_write_coord(s, opaque_rect->nWidth, last->nWidth, orderInfo->deltaCoordinates);
+
+	if (orderInfo->fieldFlags & ORDER_FIELD_04)
+		update_write_coord(s, opaque_rect->nHeight, last->nHeight, orderInfo->deltaCoordinates);
+
+	if (orderInfo->fieldFlags & ORDER_FIELD_05)
+		stream_write_BYTE(s, opaque_rect->color & 0xFF);
+
+	if (orderInfo->fieldFlags & ORDER_FIELD_06)
+		stream_write_BYTE(s, (opaque_rect->color >> 8) & 0xFF);
+
+	if (orderInfo->fieldFlags & ORDER_FIELD_07)
+		stream_write_BYTE(s, (opaque_rect->color >> 16) & 0xFF);
+}
+
+void update_write_line_to_order(STREAM* s, ORDER_INFO* orderInfo, LINE_TO_ORDER* line_to, LINE_TO_ORDER* last)
+{
+	if (orderInfo->fieldFlags & ORDER_FIELD_01)
+		stream_write_UINT16(s, line_to->backMode);
+
+	if (orderInfo->fieldFlags & ORDER_FIELD_02)
+		update_write_coord(s, line_to->nXStart, last->nXStart, orderInfo->deltaCoordinates);
+
+	if (orderInfo->fieldFlags & ORDER_FIELD_03)
+		update_write_coord(s, line_to->nYStart, last->nYStart, orderInfo->deltaCoordinates);
+
+	if (orderInfo->fieldFlags & ORDER_FIELD_04)
+		update_write_coord(s, line_to->nXEnd, last->nXEnd, orderInfo->deltaCoordinates);
+
+	if (orderInfo->fieldFlags & ORDER_FIELD_05)
+		update_write_coord(s, line_to->nYEnd, last->nYEnd, orderInfo->deltaCoordinates);
+
+	if (orderInfo->fieldFlags & ORDER_FIELD_06)
+		update_write_color(s, line_to->backColor);
+
+	if (orderInfo->fieldFlags & ORDER_FIELD_07)
+		stream_write_BYTE(s, line_to->bRop2);
+
+	if (orderInfo->fieldFlags & ORDER_FIELD_08)
+		stream_write_BYTE(s, line_to->penStyle);
+
+	if (orderInfo->fieldFlags & ORDER_FIELD_09)
+		stream_write_BYTE(s, line_to->penWidth);
+
+	if (orderInfo->fieldFlags & ORDER_FIELD_10)
+		update_write_color(s, line_to->penColor);
+}
+
+void update_write_memblt_order(STREAM* s, ORDER_INFO* orderInfo, MEMBLT_ORDER* memblt, MEMBLT_ORDER* last)
+{
+	if (orderInfo->fieldFlags & ORDER_FIELD_01)
+		stream_write_UINT16(s, (memblt->cacheId & 0xFF) | ((memblt->colorIndex & 0xFF) << 8));
+
+	if (orderInfo->fieldFlags & ORDER_FIELD_02)
+		update_write_coord(s, memblt->nLeftRect, last->nLeftRect, orderInfo->deltaCoordinates);
+
+	if (orderInfo->fieldFlags & ORDER_FIELD_03)
+		update_write_coord(s, memblt->nTopRect, last->nTopRect, orderInfo->deltaCoordinates);
+
+	if (orderInfo->fieldFlags & ORDER_FIELD_04)
+		update_write_coord(s, memblt->nWidth, last->nWidth, orderInfo->deltaCoordinates);
+
+	if (orderInfo->fieldFlags & ORDER_FIELD_05)
+		update_write_coord(s, memblt->nHeight, last->nHeight, orderInfo->deltaCoordinates);
+
+	if (orderInfo->fieldFlags & ORDER_FIELD_06)
+		stream_write_BYTE(s, memblt->bRop);
+
+	if (orderInfo->fieldFlags & ORDER_FIELD_07)
+		update_write_coord(s, memblt->nXSrc, last->nXSrc, orderInfo->deltaCoordinates);
+
+	if (orderInfo->fieldFlags & ORDER_FIELD_08)
+		update_write_coord(s, memblt->nYSrc, last->nYSrc, orderInfo->deltaCoordinates);
+
+	if (orderInfo->fieldFlags & ORDER_FIELD_09)
+		stream_write_UINT16(s, memblt->cacheIndex);
+}
+
+void update_write_mem3blt_order(STREAM* s, ORDER_INFO* orderInfo, MEM3BLT_ORDER* mem3blt, MEM3BLT_ORDER* last)
+{
+	if (orderInfo->fieldFlags & ORDER_FIELD_01)
+		stream_write_UINT16(s, (mem3blt->cacheId & 0xFF) | ((mem3blt->colorIndex & 0xFF) << 8));
+
+	if (orderInfo->fieldFlags & ORDER_FIELD_02)
+		update_write_coord(s, mem3blt->nLeftRect, last->nLeftRect, orderInfo->deltaCoordinates);
+
+	if (orderInfo->fieldFlags & ORDER_FIELD_03)
+		update_write_coord(s, mem3blt->nTopRect, last->nTopRect, orderInfo->deltaCoordinates);
+
+	if (orderInfo->fieldFlags & ORDER_FIELD_04)
+		update_write_coord(s, mem3blt->nWidth, last->nWidth, orderInfo->deltaCoordinates);
+
+	if (orderInfo->fieldFlags & ORDER_FIELD_05)
+		update_write_coord(s, mem3blt->nHeight, last->nHeight, orderInfo->deltaCoordinates);
+
+	if (orderInfo->fieldFlags & ORDER_FIELD_06)
+		stream_write_BYTE(s, mem3blt->bRop);
+
+	if (orderInfo->fieldFlags & ORDER_FIELD_07)
+		update_write_coord(s, mem3blt->nXSrc, last->nXSrc, orderInfo->deltaCoordinates);
+
+	if (orderInfo->fieldFlags & ORDER_FIELD_08)
+		update_write_coord(s, mem3blt->nYSrc, last->nYSrc, orderInfo->deltaCoordinates);
+
+	if (orderInfo->fieldFlags & ORDER_FIELD_09)
+		update_write_color(s, mem3blt->backColor);
+
+	if (orderInfo->fieldFlags & ORDER_FIELD_10)
+		update_write_color(s, mem3blt->foreColor);
+
+	update_write_brush(s, &mem3blt->brush, orderInfo->fieldFlags >> 10);
+
+	if (orderInfo->fieldFlags & ORDER_FIELD_16)
+		stream_write_UINT16(s, mem3blt->cacheIndex);
+}
+
+void update_write_glyph_index_order(STREAM* s, ORDER_INFO* orderInfo, GLYPH_INDEX_ORDER* glyph_index, GLYPH_INDEX_ORDER* last)
+{
+	if (orderInfo->fieldFlags & ORDER_FIELD_01)
+		stream_write_BYTE(s, glyph_index->cacheId);
+
+	if (orderInfo->fieldFlags & ORDER_FIELD_02)
+		stream_write_BYTE(s, glyph_index->flAccel);
+
+	if (orderInfo->fieldFlags & ORDER_FIELD_03)
+		stream_write_BYTE(s, glyph_index->ulCharInc);
+
+	if (orderInfo->fieldFlags & ORDER_FIELD_04)
+		stream_write_BYTE(s, glyph_index->fOpRedundant);
+
+	if (orderInfo->fieldFlags & ORDER_FIELD_05)
+		update_write_color(s, glyph_index->backColor);
+
+	if (orderInfo->fieldFlags & ORDER_FIELD_06)
+		update_write_color(s, glyph_index->foreColor);
+
+	if (orderInfo->fieldFlags & ORDER_FIELD_07)
+		stream_write_UINT16(s, glyph_index->bkLeft);
+
+	if (orderInfo->fieldFlags & ORDER_FIELD_08)
+		stream_write_UINT16(s, glyph_index->bkTop);
+
+	if (orderInfo->fieldFlags & ORDER_FIELD_09)
+		stream_write_UINT16(s, glyph_index->bkRight);
+
+	if (orderInfo->fieldFlags & ORDER_FIELD_10)
+		stream_write_UINT16(s, glyph_index->bkBottom);
+
+	if (orderInfo->fieldFlags & ORDER_FIELD_11)
+		stream_write_UINT16(s, glyph_index->opLeft);
+
+	if (orderInfo->fieldFlags & ORDER_FIELD_12)
+		stream_write_UINT16(s, glyph_index->opTop);
+
+	if (orderInfo->fieldFlags & ORDER_FIELD_13)
+		stream_write_UINT16(s, glyph_index->opRight);
+
+	if (orderInfo->fieldFlags & ORDER_FIELD_14)
+		stream_write_UINT16(s, glyph_index->opBottom);
+
+	update_write_brush(s, &glyph_index->brush, orderInfo->fieldFlags >> 14);
+
+	if (orderInfo->fieldFlags & ORDER_FIELD_20)
+		stream_write_UINT16(s, glyph_index->x);
+
+	if (orderInfo->fieldFlags & ORDER_FIELD_21)
+		stream_write_UINT16(s, glyph_index->y);
+
+	if (orderInfo->fieldFlags & ORDER_FIELD_22)
+	{
+		stream_write_BYTE(s, glyph_index->cbData);
+		stream_write(s, glyph_index->data, glyph_index->cbData);
+	}
+}
+
+/* Secondary Drawing Orders */
+
+void update_write_cache_bitmap_v2_order(STREAM* s, CACHE_BITMAP_V2_ORDER* cache_bitmap_v2_order, BOOL compressed, UINT16* flags)
+{
+	BYTE bitsPerPixelId;
+	UINT32 orderFlags;
+
+	stream_check_size(s, 32 + (int) cache_bitmap_v2_order->bitmapLength);
+
+	bitsPerPixelId = (cache_bitmap_v2_order->bitmapBpp <= 32) ? BPP_CBR2[cache_bitmap_v2_order->bitmapBpp] : 0;
+
+	orderFlags = cache_bitmap_v2_order->flags & ~CBR2_HEIGHT_SAME_AS_WIDTH;
+
+	if (cache_bitmap_v2_order->bitmapWidth == cache_bitmap_v2_order->bitmapHeight)
+		orderFlags |= CBR2_HEIGHT_SAME_AS_WIDTH;
+
+	*flags = (cache_bitmap_v2_order->cacheId & 0x0003) | (bitsPerPixelId << 3) | ((orderFlags << 7) & 0xFF80);
+
+	if (orderFlags & CBR2_PERSISTENT_KEY_PRESENT)
+	{
+		stream_write_UINT32(s, cache_bitmap_v2_order->key1); /* key1 (4 bytes) */
+		stream_write_UINT32(s, cache_bitmap_v2_order->key2); /* key2 (4 bytes) */
+	}
+
+	update_write_2byte_unsigned(s, cache_bitmap_v2_order->bitmapWidth); /* bitmapWidth */
+
+	if (!(orderFlags & CBR2_HEIGHT_SAME_AS_WIDTH))
+		update_write_2byte_unsigned(s, cache_bitmap_v2_order->bitmapHeight); /* bitmapHeight */
+
+	if (compressed && !(orderFlags & CBR2_NO_BITMAP_COMPRESSION_HDR))
+	{
+		/* bitmapLength covers the compression header and the bitmap data */
+
+		update_write_4byte_unsigned(s, cache_bitmap_v2_order->bitmapLength + 8); /* bitmapLength */
+		update_write_2byte_unsigned(s, cache_bitmap_v2_order->cacheIndex); /* cacheIndex */
+
+		stream_write_UINT16(s, cache_bitmap_v2_order->cbCompFirstRowSize); /* cbCompFirstRowSize (2 bytes) */
+		stream_write_UINT16(s, cache_bitmap_v2_order->bitmapLength); /* cbCompMainBodySize (2 bytes) */
+		stream_write_UINT16(s, cache_bitmap_v2_order->cbScanWidth); /* cbScanWidth (2 bytes) */
+		stream_write_UINT16(s, cache_bitmap_v2_order->cbUncompressedSize); /* cbUncompressedSize (2 bytes) */
+	}
+	else
+	{
+		update_write_4byte_unsigned(s, cache_bitmap_v2_order->bitmapLength); /* bitmapLength */
+		update_write_2byte_unsigned(s, cache_bitmap_v2_order->cacheIndex); /* cacheIndex */
+	}
+
+	stream_write(s, cache_bitmap_v2_order->bitmapDataStream, cache_bitmap_v2_order->bitmapLength);
+}
+
+void update_write_cache_glyph_order(STREAM* s, CACHE_GLYPH_ORDER* cache_glyph_order, UINT16* flags)
+{
+	int i;
+	UINT32 cb;
+	GLYPH_DATA* glyph;
+
+	*flags = (cache_glyph_order->unicodeCharacters != NULL) ? CG_GLYPH_UNICODE_PRESENT : 0;
+
+	stream_check_size(s, 2);
+	stream_write_BYTE(s, cache_glyph_order->cacheId); /* cacheId (1 byte) */
+	stream_write_BYTE(s, cache_glyph_order->cGlyphs); /* cGlyphs (1 byte) */
+
+	for (i = 0; i < (int) cache_glyph_order->cGlyphs; i++)
+	{
+		glyph = cache_glyph_order->glyphData[i];
+
+		cb = ((glyph->cx + 7) / 8) * glyph->cy;
+		cb += ((cb % 4) > 0) ? 4 - (cb % 4) : 0;
+
+		stream_check_size(s, 10 + (int) cb);
+
+		stream_write_UINT16(s, glyph->cacheIndex);
+		stream_write_UINT16(s, glyph->x);
+		stream_write_UINT16(s, glyph->y);
+		stream_write_UINT16(s, glyph->cx);
+		stream_write_UINT16(s, glyph->cy);
+
+		if (glyph->cb < cb)
+		{
+			stream_write(s, glyph->aj, glyph->cb);
+			stream_write_zero(s, cb - glyph->cb);
+		}
+		else
+		{
+			stream_write(s, glyph->aj, cb);
+		}
+	}
+
+	if (*flags & CG_GLYPH_UNICODE_PRESENT)
+	{
+		stream_check_size(s, cache_glyph_order->cGlyphs * 2);
+		stream_write(s, cache_glyph_order->unicodeCharacters, cache_glyph_order->cGlyphs * 2);
+	}
+}
+
+void update_write_field_flags(STREAM* s, UINT32 fieldFlags, BYTE flags, BYTE fieldBytes)
+{
+	int i;
+
+	if (flags & ORDER_ZERO_FIELD_BYTE_BIT0)
+		fieldBytes--;
+
+	if (flags & ORDER_ZERO_FIELD_BYTE_BIT1)
+	{
+		if (fieldBytes > 1)
+			fieldBytes -= 2;
+		else
+			fieldBytes = 0;
+	}
+
+	for (i = 0; i < fieldBytes; i++)
+		stream_write_BYTE(s, (fieldFlags >> (i * 8)) & 0xFF);
+}
+
+static INLINE BYTE update_prepare_bound(INT32 bound, INT32 last, BYTE absolute, BYTE delta)
+{
+	if (bound == last)
+		return 0;
+
+	return update_check_delta(bound, last) ? delta : absolute;
+}
+
+void update_write_bounds(STREAM* s, rdpBounds* bounds, rdpBounds* last)
+{
+	BYTE flags;
+
+	flags = update_prepare_bound(bounds->left, last->left, BOUND_LEFT, BOUND_DELTA_LEFT);
+	flags |= update_prepare_bound(bounds->top, last->top, BOUND_TOP, BOUND_DELTA_TOP);
+	flags |= update_prepare_bound(bounds->right, last->right, BOUND_RIGHT, BOUND_DELTA_RIGHT);
+	flags |= update_prepare_bound(bounds->bottom, last->bottom, BOUND_BOTTOM, BOUND_DELTA_BOTTOM);
+
+	stream_write_BYTE(s, flags); /* field flags */
+
+	if (flags & (BOUND_LEFT | BOUND_DELTA_LEFT))
+		update_write_coord(s, bounds->left, last->left, (flags & BOUND_DELTA_LEFT) ? TRUE : FALSE);
+
+	if (flags & (BOUND_TOP | BOUND_DELTA_TOP))
+		update_write_coord(s, bounds->top, last->top, (flags & BOUND_DELTA_TOP) ? TRUE : FALSE);
+
+	if (flags & (BOUND_RIGHT | BOUND_DELTA_RIGHT))
+		update_write_coord(s, bounds->right, last->right, (flags & BOUND_DELTA_RIGHT) ? TRUE : FALSE);
+
+	if (flags & (BOUND_BOTTOM | BOUND_DELTA_BOTTOM))
+		update_write_coord(s, bounds->bottom, last->bottom, (flags & BOUND_DELTA_BOTTOM) ? TRUE : FALSE);
+}
+
+/**
+ * Write a primary drawing order, including its control flags.
+ * The order is encoded against the last order of the same type written with
+ * the same primary update state, which mirrors the state kept by the receiver.
+ * Bounds set with primary->bounded and primary->bounds are applied to the order.
+ * @param s stream
+ * @param primary primary update holding the encoder state
+ * @param orderType primary drawing order type
+ * @param order primary drawing order
+ * @return FALSE if the order type is not supported by the encoder
+ */
+
+BOOL update_write_primary_order(STREAM* s, rdpPrimaryUpdate* primary, BYTE orderType, void* order)
+{
+	BYTE flags;
+	BYTE fieldBytes;
+	BYTE zeroBytes;
+	ORDER_INFO orderInfo;
+	ORDER_INFO* lastInfo = &(primary->order_info);
+
+	memset(&orderInfo, 0, sizeof(ORDER_INFO));
+	orderInfo.orderType = orderType;
+	orderInfo.deltaCoordinates = TRUE;
+
+	switch (orderType)
+	{
+		case ORDER_TYPE_DSTBLT:
+			update_prepare_dstblt_order(&orderInfo, (DSTBLT_ORDER*) order, &(primary->dstblt));
+			break;
+
+		case ORDER_TYPE_PATBLT:
+			update_prepare_patblt_order(&orderInfo, (PATBLT_ORDER*) order, &(primary->patblt));
+			break;
+
+		case ORDER_TYPE_SCRBLT:
+			update_prepare_scrblt_order(&orderInfo, (SCRBLT_ORDER*) order, &(primary->scrblt));
+			break;
+
+		case ORDER_TYPE_OPAQUE_RECT:
+			update_prepare_opaque_rect_order(&orderInfo, (OPAQUE_RECT_ORDER*) order, &(primary->opaque_rect));
+			break;
+
+		case ORDER_TYPE_LINE_TO:
+			update_prepare_line_to_order(&orderInfo, (LINE_TO_ORDER*) order, &(primary->line_to));
+			break;
+
+		case ORDER_TYPE_MEMBLT:
+			update_prepare_memblt_order(&orderInfo, (MEMBLT_ORDER*) order, &(primary->memblt));
+			break;
+
+		case ORDER_TYPE_MEM3BLT:
+			update_prepare_mem3blt_order(&orderInfo, (MEM3BLT_ORDER*) order, &(primary->mem3blt));
+			break;
+
+		case ORDER_TYPE_GLYPH_INDEX:
+			update_prepare_glyph_index_order(&orderInfo, (GLYPH_INDEX_ORDER*) order, &(primary->glyph_index));
+			break;
+
+		default:
+			printf("update_write_primary_order: unsupported order type 0x%02X\n", orderType);
+			return FALSE;
+	}
+
+	/* the largest encoded order is a glyph index order carrying 255 bytes of glyph data */
+	stream_check_size(s, 320);
+
+	flags = ORDER_STANDARD;
+
+	if (orderType != lastInfo->orderType)
+		flags |= ORDER_TYPE_CHANGE;
+
+	if (orderInfo.deltaCoordinates)
+		flags |= ORDER_DELTA_COORDINATES;
+
+	fieldBytes = PRIMARY_DRAWING_ORDER_FIELD_BYTES[orderType];
+
+	for (zeroBytes = 0; zeroBytes < fieldBytes; zeroBytes++)
+	{
+		if ((orderInfo.fieldFlags >> ((fieldBytes - zeroBytes - 1) * 8)) & 0xFF)
+			break;
+	}
+
+	if (zeroBytes & 1)
+		flags |= ORDER_ZERO_FIELD_BYTE_BIT0;
+
+	if (zeroBytes & 2)
+		flags |= ORDER_ZERO_FIELD_BYTE_BIT1;
+
+	if (primary->bounded)
+	{
+		flags |= ORDER_BOUNDS;
+
+		if (memcmp(&(primary->bounds), &(lastInfo->bounds), sizeof(rdpBounds)) == 0)
+			flags |= ORDER_ZERO_BOUNDS_DELTAS;
+	}
+
+	stream_write_BYTE(s, flags); /* controlFlags (1 byte) */
+
+	if (flags & ORDER_TYPE_CHANGE)
+		stream_write_BYTE(s, orderType); /* orderType (1 byte) */
+
+	update_write_field_flags(s, orderInfo.fieldFlags, flags, fieldBytes);
+
+	if ((flags & ORDER_BOUNDS) && !(flags & ORDER_ZERO_BOUNDS_DELTAS))
+	{
+		update_write_bounds(s, &(primary->bounds), &(lastInfo->bounds));
+		memcpy(&(lastInfo->bounds), &(primary->bounds), sizeof(rdpBounds));
+	}
+
+	lastInfo->orderType = orderType;
+
+	switch (orderType)
+	{
+		case ORDER_TYPE_DSTBLT:
+			update_write_dstblt_order(s, &orderInfo, (DSTBLT_ORDER*) order, &(primary->dstblt));
+			memcpy(&(primary->dstblt), order, sizeof(DSTBLT_ORDER));
+			break;
+
+		case ORDER_TYPE_PATBLT:
+			update_write_patblt_order(s, &orderInfo, (PATBLT_ORDER*) order, &(primary->patblt));
+			memcpy(&(primary->patblt), order, sizeof(PATBLT_ORDER));
+			update_copy_brush(&((PATBLT_ORDER*) order)->brush, &(primary->patblt.brush));
+			break;
+
+		case ORDER_TYPE_SCRBLT:
+			update_write_scrblt_order(s, &orderInfo, (SCRBLT_ORDER*) order, &(primary->scrblt));
+			memcpy(&(primary->scrblt), order, sizeof(SCRBLT_ORDER));
+			break;
+
+		case ORDER_TYPE_OPAQUE_RECT:
+			update_write_opaque_rect_order(s, &orderInfo, (OPAQUE_RECT_ORDER*) order, &(primary->opaque_rect));
+			memcpy(&(primary->opaque_rect), order, sizeof(OPAQUE_RECT_ORDER));
+			break;
+
+		case ORDER_TYPE_LINE_TO:
+			update_write_line_to_order(s, &orderInfo, (LINE_TO_ORDER*) order, &(primary->line_to));
+			memcpy(&(primary->line_to), order, sizeof(LINE_TO_ORDER));
+			break;
+
+		case ORDER_TYPE_MEMBLT:
+			update_write_memblt_order(s, &orderInfo, (MEMBLT_ORDER*) order, &(primary->memblt));
+			memcpy(&(primary->memblt), order, sizeof(MEMBLT_ORDER));
+			break;
+
+		case ORDER_TYPE_MEM3BLT:
+			update_write_mem3blt_order(s, &orderInfo, (MEM3BLT_ORDER*) order, &(primary->mem3blt));
+			memcpy(&(primary->mem3blt), order, sizeof(MEM3BLT_ORDER));
+			update_copy_brush(&((MEM3BLT_ORDER*) order)->brush, &(primary->mem3blt.brush));
+			break;
+
+		case ORDER_TYPE_GLYPH_INDEX:
+			update_write_glyph_index_order(s, &orderInfo, (GLYPH_INDEX_ORDER*) order, &(primary->glyph_index));
+			memcpy(&(primary->glyph_index), order, sizeof(GLYPH_INDEX_ORDER));
+			update_copy_brush(&((GLYPH_INDEX_ORDER*) order)->brush, &(primary->glyph_index.brush));
+			break;
+
+		default:
+			break;
+	}
+
+	return TRUE;
+}
+
+/**
+ * Write the header of a secondary drawing order.
+ * The header is written in front of an order body of the given length,
+ * leaving room for it with SECONDARY_ORDER_HEADER_LENGTH bytes.
+ * @param s stream
+ * @param length length of the order body
+ * @param extraFlags order specific flags
+ * @param orderType secondary drawing order type
+ */
+
+void update_write_secondary_order_info(STREAM* s, int length, UINT16 extraFlags, BYTE orderType)
+{
+	stream_write_BYTE(s, ORDER_STANDARD | ORDER_SECONDARY); /* controlFlags (1 byte) */
+	stream_write_UINT16(s, (UINT16) (length - 7)); /* orderLength (2 bytes) */
+	stream_write_UINT16(s, extraFlags); /* extraFlags (2 bytes) */
+	stream_write_BYTE(s, orderType); /* orderType (1 byte) */
+}
@@ -184,7 +184,11 @@
 
 #define CG_GLYPH_UNICODE_PRESENT		0x0010
 
+/* controlFlags, orderLength, extraFlags and orderType */
+#define SECONDARY_ORDER_HEADER_LENGTH		6
+
 BOOL update_recv_order(rdpUpdate* update, STREAM* s);
+void update_flush_order_batch(rdpUpdate* update);
 
 void update_read_dstblt_order(STREAM* s, ORDER_INFO* orderInfo, DSTBLT_ORDER* dstblt);
 void update_read_patblt_order(STREAM* s, ORDER_INFO* orderInfo, PATBLT_ORDER* patblt);
@@ -230,4 +234,22 @@ void update_read_draw_gdiplus_cache_first_order(STREAM* s, DRAW_GDIPLUS_CACHE_FI
 void update_read_draw_gdiplus_cache_next_order(STREAM* s, DRAW_GDIPLUS_CACHE_NEXT_ORDER* draw_gdiplus_cache_next);
 void update_read_draw_gdiplus_cache_end_order(STREAM* s, DRAW_GDIPLUS_CACHE_END_ORDER* draw_gdiplus_cache_end);
 
+BOOL update_write_primary_order(STREAM* s, rdpPrimaryUpdate* primary, BYTE orderType, void* order);
+void update_write_secondary_order_info(STREAM* s, int length, UINT16 extraFlags, BYTE orderType);
+
+void update_write_field_flags(STREAM* s, UINT32 fieldFlags, BYTE flags, BYTE fieldBytes);
+void update_write_bounds(STREAM* s, rdpBounds* bounds, rdpBounds* last);
+
+void update_write_dstblt_order(STREAM* s, ORDER_INFO* orderInfo, DSTBLT_ORDER* dstblt, DSTBLT_ORDER* last);
+void update_write_patblt_order(STREAM* s, ORDER_INFO* orderInfo, PATBLT_ORDER* patblt, PATBLT_ORDER* last);
+void update_write_scrblt_order(STREAM* s, ORDER_INFO* orderInfo, SCRBLT_ORDER* scrblt, SCRBLT_ORDER* last);
+void update_write_opaque_rect_order(STREAM* s, ORDER_INFO* orderInfo, OPAQUE_RECT_ORDER* opaque_rect, OPAQUE_RECT_ORDER* last);
+void update_write_line_to_order(STREAM* s, ORDER_INFO* orderInfo, LINE_TO_ORDER* line_to, LINE_TO_ORDER* last);
+void update_write_memblt_order(STREAM* s, ORDER_INFO* orderInfo, MEMBLT_ORDER* memblt, MEMBLT_ORDER* last);
+void update_write_mem3blt_order(STREAM* s, ORDER_INFO* orderInfo, MEM3BLT_ORDER* mem3blt, MEM3BLT_ORDER* last);
+void update_write_glyph_index_order(STREAM* s, ORDER_INFO* orderInfo, GLYPH_INDEX_ORDER* glyph_index, GLYPH_INDEX_ORDER* last);
+
+void update_write_cache_bitmap_v2_order(STREAM* s, CACHE_BITMAP_V2_ORDER* cache_bitmap_v2_order, BOOL compressed, UINT16* flags);
+void update_write_cache_glyph_order(STREAM* s, CACHE_GLYPH_ORDER* cache_glyph_order, UINT16* flags);
+
 #endif /* __ORDERS_H */
@@ -23,13 +23,97 @@
 
 #include "certificate.h"
 #include <freerdp/utils/tcp.h>
+#include <freerdp/utils/time.h>
 
+#include "info.h"
 #include "peer.h"
 
+/* frames the client has not acknowledged after this many milliseconds no longer hold back new ones */
+#define PEER_FRAME_TIMEOUT			2000
+
+/* sent by the client to announce it suspends frame acknowledgement */
+#define SUSPEND_FRAME_ACKNOWLEDGEMENT		0xFFFFFFFF
+
+static void peer_drop_frames(freerdp_peer* client, int count)
+{
+	client->frame_head = (client->frame_head + count) % FREERDP_PEER_MAX_FRAMES_IN_FLIGHT;
+	client->frame_count -= count;
+	client->frame_statistics.in_flight = client->frame_count;
+}
+
+void peer_frame_sent(freerdp_peer* client, UINT32 frameId)
+{
+	int index;
+	rdpPeerFrameStatistics* statistics = &client->frame_statistics;
+
+	if (client->frame_count >= FREERDP_PEER_MAX_FRAMES_IN_FLIGHT)
+		peer_drop_frames(client, 1);
+
+	index = (client->frame_head + client->frame_count) % FREERDP_PEER_MAX_FRAMES_IN_FLIGHT;
+	client->frames[index].frameId = frameId;
+	client->frames[index].sendTime = freerdp_get_tick_count();
+	client->frame_count++;
+
+	statistics->sent_frames++;
+	statistics->in_flight = client->frame_count;
+
+	if (statistics->in_flight > statistics->max_in_flight)
+		statistics->max_in_flight = statistics->in_flight;
+}
+
+static void peer_recv_frame_acknowledge(freerdp_peer* client, UINT32 frameId)
+{
+	int i;
+	int index;
+	UINT32 rtt;
+	UINT32 delta;
+	rdpPeerFrameStatistics* statistics = &client->frame_statistics;
+
+	client->ack_frame_id = frameId;
+
+	if (frameId == SUSPEND_FRAME_ACKNOWLEDGEMENT)
+	{
+		client->settings->frame_acknowledge = 0;
+		peer_drop_frames(client, client->frame_count);
+		return;
+	}
+
+	/**
+	 * Acknowledgements are cumulative: once a frame is acknowledged,
+	 * every frame sent before it has been processed by the client as well.
+	 */
+	for (i = 0; i < client->frame_count; i++)
+	{
+		index = (client->frame_head + i) % FREERDP_PEER_MAX_FRAMES_IN_FLIGHT;
+
+		if (client->frames[index].frameId != frameId)
+			continue;
+
+		rtt = freerdp_get_tick_count() - client->frames[index].sendTime;
+
+		if (statistics->acked_frames == 0)
+		{
+			statistics->rtt = rtt;
+			statistics->rtt_var = rtt / 2;
+		}
+		else
+		{
+			delta = (rtt > statistics->rtt) ? rtt - statistics->rtt : statistics->rtt - rtt;
+			statistics->rtt_var = (3 * statistics->rtt_var + delta) / 4;
+			statistics->rtt = (7 * statistics->rtt + rtt) / 8;
+		}
+
+		statistics->last_rtt = rtt;
+		statistics->acked_frames += i + 1;
+
+		peer_drop_frames(client, i + 1);
+		break;
+	}
+}
+
 static BOOL freerdp_peer_initialize(freerdp_peer* client)
 {
 	client->context->rdp->settings->server_mode = TRUE;
-	client->context->rdp->settings->frame_acknowledge = 0;
 	client->context->rdp->settings->local = client->local;
 	client->context->rdp->state = CONNECTION_STATE_INITIAL;
 
@@ -70,6 +154,7 @@ static BOOL peer_recv_data_pdu(freerdp_peer* client, STREAM* s)
 	BYTE type;
 	UINT16 length;
 	UINT32 share_id;
+	UINT32 frame_id;
 	BYTE compressed_type;
 	UINT16 compressed_len;
 
@@ -113,6 +198,10 @@ static BOOL peer_recv_data_pdu(freerdp_peer* client, STREAM* s)
 
 				if (!client->connected)
 					return FALSE;
+
+				/* give the client a cookie to resume the session with if the connection is lost */
+				if (client->settings->auto_reconnection)
+					rdp_send_save_session_info_auto_reconnect_cookie(client->context->rdp);
 			}
 
 			if (!client->activated)
@@ -132,7 +221,10 @@ static BOOL peer_recv_data_pdu(freerdp_peer* client, STREAM* s)
 			return FALSE;
 
 		case DATA_PDU_TYPE_FRAME_ACKNOWLEDGE:
-			stream_read_UINT32(s, client->ack_frame_id);
+			if (stream_get_left(s) < 4)
+				return FALSE;
+			stream_read_UINT32(s, frame_id);
+			peer_recv_frame_acknowledge(client, frame_id);
 			break;
 
 		case DATA_PDU_TYPE_REFRESH_RECT:
@@ -367,6 +459,7 @@ void freerdp_peer_context_new(freerdp_peer* client)
 	client->context = (rdpContext*) xzalloc(client->context_size);
 	client->context->rdp = rdp;
 	client->context->peer = client;
+	client->context->metrics = rdp->metrics;
 
 	client->update->context = client->context;
 	client->input->context = client->context;
@@ -419,3 +512,51 @@ void freerdp_peer_free(freerdp_peer* client)
 		free(client);
 	}
 }
+
+/**
+ * Check if the server may send another surface frame to the client.
+ * Once the client has advertised a frame acknowledge depth and that many
+ * frames are still unacknowledged, the server should hold back and merge
+ * its updates into a later frame instead of queuing them on the link.
+ * @param client peer
+ * @return TRUE if a new frame can be sent
+ */
+
+BOOL freerdp_peer_can_send_frame(freerdp_peer* client)
+{
+	UINT32 now;
+	rdpPeerFrame* frame;
+	rdpSettings* settings = client->settings;
+
+	if (!settings->received_caps[CAPSET_TYPE_FRAME_ACKNOWLEDGE] || (settings->frame_acknowledge == 0))
+		return TRUE;
+
+	now = freerdp_get_tick_count();
+
+	while (client->frame_count > 0)
+	{
+		frame = &client->frames[client->frame_head];
+
+		if ((now - frame->sendTime) < PEER_FRAME_TIMEOUT)
+			break;
+
+		peer_drop_frames(client, 1);
+	}
+
+	if (client->frame_count < (int) settings->frame_acknowledge)
+		return TRUE;
+
+	client->frame_statistics.throttled_frames++;
+
+	return FALSE;
+}
+
+void freerdp_peer_get_frame_statistics(freerdp_peer* client, rdpPeerFrameStatistics* statistics)
+{
+	memcpy(statistics, &client->frame_statistics, sizeof(rdpPeerFrameStatistics));
+}
+
+void freerdp_peer_get_metrics(freerdp_peer* client, rdpMetricsSnapshot* snapshot)
+{
+	metrics_snapshot(client->context->metrics, snapshot);
+}
@@ -23,5 +23,7 @@
 #include "rdp.h"
 #include <freerdp/peer.h>
 
+void peer_frame_sent(freerdp_peer* client, UINT32 frameId);
+
 #endif /* __PEER */
 
@@ -340,12 +340,8 @@ static UINT32 rdp_security_stream_out(rdpRdp* rdp, STREAM* s, int length)
 			{
 				data = s->p + 8;
 				length = length - (data - s->data);
-				if (sec_flags & SEC_SECURE_CHECKSUM)
-					security_salted_mac_signature(rdp, data, length, TRUE, s->p);
-				else
-					security_mac_signature(rdp, data, length, s->p);
+				security_encrypt_mac(data, length, (sec_flags & SEC_SECURE_CHECKSUM) ? TRUE : FALSE, s->p, rdp);
 				stream_seek(s, 8);
-				security_encrypt(s->p, length, rdp);
 			}
 		}
 
@@ -492,6 +488,12 @@ BOOL rdp_recv_data_pdu(rdpRdp* rdp, STREAM* s)
 	{
 		if (decompress_rdp(rdp->mppc_dec, s->p, compressed_len - 18, compressed_type, &roff, &rlen))
 		{
+			if (METRICS_ENABLED(rdp->metrics))
+			{
+				metrics_add_counter(rdp->metrics, METRICS_MPPC_DECOMPRESS_INPUT_BYTES, compressed_len - 18);
+				metrics_add_counter(rdp->metrics, METRICS_MPPC_DECOMPRESS_OUTPUT_BYTES, rlen);
+			}
+
 			comp_stream = stream_new(0);
 			comp_stream->data = rdp->mppc_dec->history_buf + roff;
 			comp_stream->p = comp_stream->data;
@@ -675,11 +677,7 @@ BOOL rdp_decrypt(rdpRdp* rdp, STREAM* s, int length, UINT16 securityFlags)
 
 	stream_read(s, wmac, sizeof(wmac));
 	length -= sizeof(wmac);
-	security_decrypt(s->p, length, rdp);
-	if (securityFlags & SEC_SECURE_CHECKSUM)
-		security_salted_mac_signature(rdp, s->p, length, FALSE, cmac);
-	else
-		security_mac_signature(rdp, s->p, length, cmac);
+	security_decrypt_mac(s->p, length, (securityFlags & SEC_SECURE_CHECKSUM) ? TRUE : FALSE, cmac, rdp);
 	if (memcmp(wmac, cmac, sizeof(wmac)) != 0)
 	{
 		printf("WARNING: invalid packet signature\n");
@@ -935,6 +933,10 @@ rdpRdp* rdp_new(freerdp* instance)
 		rdp->redirection = redirection_new();
 		rdp->mppc_dec = mppc_dec_new();
 		rdp->mppc_enc = mppc_enc_new(PROTO_RDP_50);
+		rdp->metrics = metrics_new();
+		rdp->transport->metrics = rdp->metrics;
+		rdp->transport->recv_callback = rdp_recv_callback;
+		rdp->transport->recv_extra = rdp;
 	}
 
 	return rdp;
@@ -966,6 +968,15 @@ void rdp_free(rdpRdp* rdp)
 		redirection_free(rdp->redirection);
 		mppc_dec_free(rdp->mppc_dec);
 		mppc_enc_free(rdp->mppc_enc);
+		metrics_free(rdp->metrics);
+
+		if (rdp->reconnect_timer != NULL)
+		{
+			freerdp_thread_stop(rdp->reconnect_timer);
+			freerdp_thread_free(rdp->reconnect_timer);
+			wait_obj_free(rdp->reconnect_event);
+		}
+
 		free(rdp);
 	}
 }
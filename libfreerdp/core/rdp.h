@@ -43,8 +43,10 @@
 
 #include <freerdp/freerdp.h>
 #include <freerdp/settings.h>
+#include <freerdp/crypto/crypto.h>
 #include <freerdp/utils/debug.h>
 #include <freerdp/utils/stream.h>
+#include <freerdp/utils/thread.h>
 #include <freerdp/codec/mppc_dec.h>
 #include <freerdp/codec/mppc_enc.h>
 
@@ -131,6 +133,7 @@ struct rdp_rdp
 	struct rdp_extension* extension;
 	struct rdp_mppc_dec* mppc_dec;
 	struct rdp_mppc_enc* mppc_enc;
+	struct rdp_metrics* metrics;
 	struct crypto_rc4_struct* rc4_decrypt_key;
 	int decrypt_use_count;
 	int decrypt_checksum_use_count;
@@ -144,6 +147,8 @@ struct rdp_rdp
 	BOOL do_crypt;
 	BOOL do_secure_checksum;
 	BYTE sign_key[16];
+	struct crypto_sha1_struct sign_sha1; /* SHA1 state after MACKeyN + pad1 */
+	struct crypto_md5_struct sign_md5; /* MD5 state after MACKeyN + pad2 */
 	BYTE decrypt_key[16];
 	BYTE encrypt_key[16];
 	BYTE decrypt_update_key[16];
@@ -155,6 +160,12 @@ struct rdp_rdp
 	UINT32 errorInfo;
 	UINT32 finalize_sc_pdus;
 	BOOL disconnect;
+	UINT32 connect_time[CONNECT_PHASE_COUNT]; /* wall time per connection phase, in milliseconds */
+	BOOL reconnecting;
+	UINT32 reconnect_retry;
+	UINT32 reconnect_delay; /* backoff before the next attempt, in milliseconds */
+	struct wait_obj* reconnect_event; /* set when the next reconnection attempt is due */
+	freerdp_thread* reconnect_timer;
 };
 
 void rdp_read_security_header(STREAM* s, UINT16* flags);
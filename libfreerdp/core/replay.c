@@ -0,0 +1,166 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Session Replay
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <winpr/crt.h>
+
+#include <freerdp/replay.h>
+#include <freerdp/utils/pcap.h>
+#include <freerdp/utils/stream.h>
+
+#include "rdp.h"
+
+/* grows to the largest record of the capture */
+#define REPLAY_BUFFER_SIZE	0x4000
+
+/**
+ * Check that a record holds exactly one PDU which can be processed without
+ * the session keys.
+ */
+
+static BOOL replay_check_pdu(STREAM* s)
+{
+	UINT16 length;
+
+	if (stream_get_size(s) < 3)
+		return FALSE;
+
+	if (tpkt_verify_header(s))
+	{
+		if (stream_get_size(s) < 4)
+			return FALSE;
+
+		length = tpkt_read_header(s);
+	}
+	else
+	{
+		if ((stream_get_head(s)[0] >> 6) & FASTPATH_OUTPUT_ENCRYPTED)
+			return FALSE;
+
+		if (stream_get_size(s) < fastpath_header_length(s))
+			return FALSE;
+
+		length = fastpath_read_header(NULL, s);
+	}
+
+	stream_set_pos(s, 0);
+
+	return (length == stream_get_size(s)) ? TRUE : FALSE;
+}
+
+/**
+ * Replay a capture into a client instance, as fast as it can be processed.
+ * The instance is put in the active state without connecting: its settings
+ * (desktop size, color depth, codecs) must match the recorded session and
+ * its update callbacks are called as for a live connection. Metrics of the
+ * instance are enabled for the replay.
+ * @param instance client instance
+ * @param name capture file name
+ * @param stats replay statistics
+ * @return FALSE if the capture cannot be opened or a PDU fails to process
+ */
+
+BOOL freerdp_replay(freerdp* instance, char* name, rdpReplayStats* stats)
+{
+	STREAM* s;
+	STREAM* pdu;
+	STREAM _pdu;
+	rdpRdp* rdp;
+	rdpPcap* pcap;
+	UINT64 start;
+	BOOL status = TRUE;
+	pcap_record record;
+	rdpTransport* transport;
+
+	ZeroMemory(stats, sizeof(rdpReplayStats));
+
+	pcap = pcap_open(name, FALSE);
+
+	if (pcap == NULL)
+		return FALSE;
+
+	rdp = instance->context->rdp;
+	rdp->settings->encryption = FALSE;
+	rdp->state = CONNECTION_STATE_ACTIVE;
+
+	transport = rdp->transport;
+	metrics_enable(rdp->metrics, TRUE);
+
+	pdu = &_pdu;
+	s = stream_new(REPLAY_BUFFER_SIZE);
+	start = metrics_time();
+
+	while (pcap_get_next_record_header(pcap, &record))
+	{
+		stream_set_pos(s, 0);
+		stream_check_size(s, record.length);
+		record.data = stream_get_head(s);
+		pcap_get_next_record_content(pcap, &record);
+
+		/* the buffer keeps its size, PDUs are read through a view of it */
+		stream_attach(pdu, record.data, record.length);
+
+		if (!replay_check_pdu(pdu))
+		{
+			stats->skipped++;
+			continue;
+		}
+
+		if (transport->recv_callback(transport, pdu, transport->recv_extra) == FALSE)
+		{
+			printf("freerdp_replay: failed to process PDU %d\n", stats->pdus);
+			status = FALSE;
+			break;
+		}
+
+		stats->pdus++;
+		stats->bytes += record.length;
+	}
+
+	stats->elapsed = metrics_time() - start;
+	metrics_snapshot(rdp->metrics, &stats->metrics);
+
+	stream_free(s);
+	pcap_close(pcap);
+
+	return status;
+}
+
+/**
+ * FNV-1a hash of a frame buffer, to compare the outcome of a replay.
+ */
+
+UINT32 freerdp_replay_checksum(BYTE* data, int length)
+{
+	int i;
+	UINT32 hash = 0x811C9DC5;
+
+	for (i = 0; i < length; i++)
+	{
+		hash ^= data[i];
+		hash *= 0x01000193;
+	}
+
+	return hash;
+}
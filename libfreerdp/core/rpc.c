@@ -451,7 +451,7 @@ int rpc_in_write(rdpRpc* rpc, BYTE* data, int length)
 	printf("\n");
 #endif
 
-	status = tls_write_all(rpc->tls_in, data, length);
+	status = rpc->ChannelWrite(rpc, data, length);
 
 	if (status > 0)
 		rpc->VirtualConnection->DefaultInChannel->BytesSent += status;
@@ -459,6 +459,16 @@ int rpc_in_write(rdpRpc* rpc, BYTE* data, int length)
 	return status;
 }
 
+static int rpc_tls_out_read(rdpRpc* rpc, BYTE* data, int length)
+{
+	return tls_read(rpc->tls_out, data, length);
+}
+
+static int rpc_tls_in_write(rdpRpc* rpc, BYTE* data, int length)
+{
+	return tls_write_all(rpc->tls_in, data, length);
+}
+
 BOOL rpc_send_bind_pdu(rdpRpc* rpc)
 {
 	STREAM* pdu;
@@ -588,47 +598,38 @@ BOOL rpc_send_bind_pdu(rdpRpc* rpc)
 
 int rpc_recv_bind_ack_pdu(rdpRpc* rpc)
 {
-	BYTE* p;
-	STREAM* s;
-	int status;
 	BYTE* pdu;
+	int status;
 	BYTE* auth_data;
-	RPC_PDU_HEADER header;
-	int pdu_length = 0x8FFF;
-
-	pdu = malloc(pdu_length);
-
-	if (pdu == NULL)
-		return -1;
+	UINT16 frag_length;
+	UINT16 auth_length;
 
-	status = rpc_out_read(rpc, pdu, pdu_length);
+	status = rpc_recv_fragment(rpc, &pdu);
 
 	if (status > 0)
 	{
-		s = stream_new(0);
-		stream_attach(s, pdu, pdu_length);
-		rpc_pdu_header_read(s, &header);
-		stream_detach(s);
-		stream_free(s);
+		frag_length = *(UINT16*)(pdu + 8);
+		auth_length = *(UINT16*)(pdu + 10);
 
-		auth_data = malloc(header.auth_length);
-
-		if (auth_data == NULL)
+		if (auth_length > frag_length - 16)
 		{
-			free(pdu);
+			printf("rpc_recv_bind_ack_pdu error: invalid auth_length: %d\n", auth_length);
 			return -1;
 		}
 
-		p = (pdu + (header.frag_length - header.auth_length));
-		memcpy(auth_data, p, header.auth_length);
+		auth_data = malloc(auth_length);
+
+		if (auth_data == NULL)
+			return -1;
+
+		memcpy(auth_data, pdu + (frag_length - auth_length), auth_length);
 
 		rpc->ntlm->inputBuffer.pvBuffer = auth_data;
-		rpc->ntlm->inputBuffer.cbBuffer = header.auth_length;
+		rpc->ntlm->inputBuffer.cbBuffer = auth_length;
 
 		ntlm_authenticate(rpc->ntlm);
 	}
 
-	free(pdu);
 	return status;
 }
 
@@ -687,92 +688,119 @@ BOOL rpc_send_rpc_auth_3_pdu(rdpRpc* rpc)
 	return TRUE;
 }
 
-int rpc_out_read(rdpRpc* rpc, BYTE* data, int length)
+/**
+ * Make sure at least length bytes of the OUT channel are buffered. Whatever
+ * the channel has available is read ahead, so coalesced fragments cost one
+ * read, and a fragment split across reads is completed by the next call.
+ * @return 1 when enough data is buffered, 0 if the channel has no more for now
+ */
+
+static int rpc_out_fill(rdpRpc* rpc, UINT32 length)
 {
-	STREAM* s;
 	int status;
+	UINT32 end;
+
+	if (rpc->FragmentOffset + length > RPC_FRAGMENT_BUFFER_SIZE)
+	{
+		memmove(rpc->FragmentBuffer, &rpc->FragmentBuffer[rpc->FragmentOffset], rpc->FragmentLength);
+		rpc->FragmentOffset = 0;
+	}
+
+	while (rpc->FragmentLength < length)
+	{
+		end = rpc->FragmentOffset + rpc->FragmentLength;
+		status = rpc->ChannelRead(rpc, &rpc->FragmentBuffer[end], RPC_FRAGMENT_BUFFER_SIZE - end);
+
+		if (status <= 0)
+			return status;
+
+		rpc->FragmentLength += status;
+	}
+
+	return 1;
+}
+
+/**
+ * Receive the next PDU fragment from the OUT channel. The fragment is not
+ * copied, it stays valid in the fragment buffer until the channel is read again.
+ * @param rpc rpc
+ * @param fragment receives a pointer to the fragment
+ * @return fragment length, 0 if no complete fragment is available, -1 on error
+ */
+
+int rpc_recv_fragment(rdpRpc* rpc, BYTE** fragment)
+{
 	BYTE* pdu;
-	int content_length;
-	RPC_PDU_HEADER header;
+	int status;
+	UINT16 frag_length;
 
 	if (rpc->VirtualConnection->DefaultOutChannel->ReceiverAvailableWindow < 0x00008FFF) /* Just a simple workaround */
 		rts_send_flow_control_ack_pdu(rpc);  /* Send FlowControlAck every time AvailableWindow reaches the half */
 
-	pdu = malloc(0xFFFF);
+	status = rpc_out_fill(rpc, 16); /* first 16 bytes are the RPC PDU Header */
+
+	if (status <= 0)
+		return status;
 
-	if (pdu == NULL)
+	frag_length = *(UINT16*)(&rpc->FragmentBuffer[rpc->FragmentOffset] + 8);
+
+	if (frag_length < 16)
 	{
-		printf("rpc_out_read error: memory allocation failed") ;
+		printf("rpc_recv_fragment error: invalid frag_length: %d\n", frag_length);
 		return -1;
 	}
 
-	status = tls_read(rpc->tls_out, pdu, 16); /* read first 16 bytes to get RPC PDU Header */
+	status = rpc_out_fill(rpc, frag_length);
 
 	if (status <= 0)
-	{
-		free(pdu);
 		return status;
-	}
 
-	s = stream_new(0);
-	stream_attach(s, pdu, 16);
+	pdu = &rpc->FragmentBuffer[rpc->FragmentOffset];
 
-	rpc_pdu_header_read(s, &header);
+	rpc->FragmentOffset += frag_length;
+	rpc->FragmentLength -= frag_length;
 
-	stream_detach(s);
-	stream_free(s);
-
-	content_length = header.frag_length - 16;
-	status = tls_read(rpc->tls_out, pdu + 16, content_length);
-
-	if (status < 0)
-	{
-		free(pdu);
-		return status;
-	}
+	if (rpc->FragmentLength == 0)
+		rpc->FragmentOffset = 0;
 
-	if (header.ptype == PTYPE_RTS) /* RTS PDU */
+	if (pdu[2] == PTYPE_RTS) /* RTS PDU */
 	{
-		printf("rpc_out_read error: Unexpected RTS PDU\n");
-		free(pdu);
+		printf("rpc_recv_fragment error: Unexpected RTS PDU\n");
 		return -1;
 	}
 	else
 	{
 		/* RTS PDUs are not subject to flow control */
-		rpc->VirtualConnection->DefaultOutChannel->BytesReceived += header.frag_length;
-		rpc->VirtualConnection->DefaultOutChannel->ReceiverAvailableWindow -= header.frag_length;
+		rpc->VirtualConnection->DefaultOutChannel->BytesReceived += frag_length;
+		rpc->VirtualConnection->DefaultOutChannel->ReceiverAvailableWindow -= frag_length;
 	}
 
-	if (length < header.frag_length)
-	{
-		printf("rpc_out_read error! receive buffer is not large enough\n");
-		free(pdu);
-		return -1;
-	}
-
-	memcpy(data, pdu, header.frag_length);
-
 #ifdef WITH_DEBUG_RPC
-	printf("rpc_out_read(): length: %d\n", header.frag_length);
-	freerdp_hexdump(data, header.frag_length);
+	printf("rpc_recv_fragment(): length: %d\n", frag_length);
+	freerdp_hexdump(pdu, frag_length);
 	printf("\n");
 #endif
 
-	free(pdu);
-	return header.frag_length;
+	*fragment = pdu;
+	return frag_length;
 }
 
+/**
+ * Send a request on the IN channel. The request is built in a send stream
+ * kept across calls and does not wait for its response, so several requests
+ * can be in flight. Responses are matched by call_id when read.
+ */
+
 int rpc_tsg_write(rdpRpc* rpc, BYTE* data, int length, UINT16 opnum)
 {
-	int i;
+	STREAM* s;
 	int status;
-	STREAM* pdu;
 	rdpNtlm* ntlm;
+	UINT32 call_id;
+	UINT32 frag_length;
 	SecBuffer Buffers[2];
 	SecBufferDesc Message;
 	SECURITY_STATUS encrypt_status;
-	rpcconn_request_hdr_t* request_pdu;
 
 	BYTE auth_pad_length = 16 - ((24 + length + 8 + 16) % 16);
 
@@ -781,71 +809,66 @@ int rpc_tsg_write(rdpRpc* rpc, BYTE* data, int length, UINT16 opnum)
 	if (auth_pad_length == 16)
 		auth_pad_length = 0;
 
-	request_pdu = xnew(rpcconn_request_hdr_t);
-	request_pdu->rpc_vers = 5;
-	request_pdu->rpc_vers_minor = 0;
-	request_pdu->PTYPE = PTYPE_REQUEST;
-	request_pdu->pfc_flags = PFC_FIRST_FRAG | PFC_LAST_FRAG;
-	request_pdu->packed_drep[0] = 0x10;
-	request_pdu->packed_drep[1] = 0x00;
-	request_pdu->packed_drep[2] = 0x00;
-	request_pdu->packed_drep[3] = 0x00;
-	request_pdu->frag_length = 24 + length + auth_pad_length + 8 + 16;
-	request_pdu->auth_length = 16;
-	request_pdu->call_id = ++rpc->call_id;
+	frag_length = 24 + length + auth_pad_length + 8 + 16;
 
-	/* opnum=8 means [MS-TSGU] TsProxySetupReceivePipe, save call_id for checking pipe responses */
-
-	if (opnum == 8)
-		rpc->pipe_call_id = rpc->call_id;
-
-	request_pdu->alloc_hint = length;
-	request_pdu->p_cont_id = 0x0000;
-	request_pdu->opnum = opnum;
-	request_pdu->stub_data = data;
-	request_pdu->auth_verifier.auth_type = 0x0A; /* :01  which authentication service */
-	request_pdu->auth_verifier.auth_level = 0x05; /* :01  which level within service */
-	request_pdu->auth_verifier.auth_pad_length = auth_pad_length; /* :01 */
-	request_pdu->auth_verifier.auth_pad = malloc(auth_pad_length); /* align(4); size_is(auth_pad_length) p */
-
-	for (i = 0; i < auth_pad_length; i++)
+	if (frag_length > 0xFFFF)
 	{
-		request_pdu->auth_verifier.auth_pad[i] = 0x00;
+		printf("rpc_tsg_write error: request too large: %d\n", length);
+		return -1;
 	}
 
-	request_pdu->auth_verifier.auth_reserved = 0x00; /* :01 reserved, m.b.z. */
-	request_pdu->auth_verifier.auth_context_id = 0x00000000; /* :04 */
-	request_pdu->auth_verifier.auth_value = malloc(request_pdu->auth_length); /* credentials; size_is(auth_length) p */
-
-	pdu = stream_new(request_pdu->frag_length);
+	/* the sizes do not change for the lifetime of the context */
 
-	stream_write(pdu, request_pdu, 24);
-	stream_write(pdu, request_pdu->stub_data, request_pdu->alloc_hint);
-
-	if (request_pdu->auth_verifier.auth_pad_length > 0)
-		stream_write(pdu, request_pdu->auth_verifier.auth_pad, request_pdu->auth_verifier.auth_pad_length);
+	if (ntlm->ContextSizes.cbMaxSignature == 0)
+	{
+		if (ntlm->table->QueryContextAttributes(&ntlm->context, SECPKG_ATTR_SIZES, &ntlm->ContextSizes) != SEC_E_OK)
+		{
+			printf("QueryContextAttributes SECPKG_ATTR_SIZES failure\n");
+			return 0;
+		}
+	}
 
-	stream_write(pdu, &request_pdu->auth_verifier.auth_type, 8);
+	call_id = ++rpc->call_id;
 
-	free(request_pdu->auth_verifier.auth_value);
-	free(request_pdu->auth_verifier.auth_pad);
-	free(request_pdu);
+	/* opnum=8 means [MS-TSGU] TsProxySetupReceivePipe, save call_id for checking pipe responses */
 
-	if (ntlm->table->QueryContextAttributes(&ntlm->context, SECPKG_ATTR_SIZES, &ntlm->ContextSizes) != SEC_E_OK)
-	{
-		printf("QueryContextAttributes SECPKG_ATTR_SIZES failure\n");
-		stream_free(pdu) ;
-		return 0;
-	}
+	if (opnum == 8)
+		rpc->pipe_call_id = call_id;
+
+	s = rpc->SendStream;
+	stream_set_pos(s, 0);
+	stream_check_size(s, frag_length - 16 + ntlm->ContextSizes.cbMaxSignature);
+
+	stream_write_BYTE(s, 5); /* rpc_vers (1 byte) */
+	stream_write_BYTE(s, 0); /* rpc_vers_minor (1 byte) */
+	stream_write_BYTE(s, PTYPE_REQUEST); /* PTYPE (1 byte) */
+	stream_write_BYTE(s, PFC_FIRST_FRAG | PFC_LAST_FRAG); /* pfc_flags (1 byte) */
+	stream_write_UINT32(s, 0x00000010); /* packed_drep (4 bytes) */
+	stream_write_UINT16(s, frag_length); /* frag_length (2 bytes) */
+	stream_write_UINT16(s, 16); /* auth_length (2 bytes) */
+	stream_write_UINT32(s, call_id); /* call_id (4 bytes) */
+	stream_write_UINT32(s, length); /* alloc_hint (4 bytes) */
+	stream_write_UINT16(s, 0x0000); /* p_cont_id (2 bytes) */
+	stream_write_UINT16(s, opnum); /* opnum (2 bytes) */
+
+	stream_write(s, data, length); /* stub_data */
+	stream_write_zero(s, auth_pad_length); /* auth_pad */
+
+	stream_write_BYTE(s, 0x0A); /* auth_type (1 byte) */
+	stream_write_BYTE(s, 0x05); /* auth_level (1 byte) */
+	stream_write_BYTE(s, auth_pad_length); /* auth_pad_length (1 byte) */
+	stream_write_BYTE(s, 0x00); /* auth_reserved (1 byte) */
+	stream_write_UINT32(s, 0x00000000); /* auth_context_id (4 bytes) */
 
 	Buffers[0].BufferType = SECBUFFER_DATA; /* auth_data */
 	Buffers[1].BufferType = SECBUFFER_TOKEN; /* signature */
 
-	Buffers[0].pvBuffer = pdu->data;
-	Buffers[0].cbBuffer = stream_get_length(pdu);
+	Buffers[0].pvBuffer = s->data;
+	Buffers[0].cbBuffer = stream_get_length(s);
 
+	/* the signature is written straight into the auth_value */
 	Buffers[1].cbBuffer = ntlm->ContextSizes.cbMaxSignature;
-	Buffers[1].pvBuffer = xzalloc(Buffers[1].cbBuffer);
+	Buffers[1].pvBuffer = stream_get_tail(s);
 
 	Message.cBuffers = 2;
 	Message.ulVersion = SECBUFFER_VERSION;
@@ -856,15 +879,12 @@ int rpc_tsg_write(rdpRpc* rpc, BYTE* data, int length, UINT16 opnum)
 	if (encrypt_status != SEC_E_OK)
 	{
 		printf("EncryptMessage status: 0x%08X\n", encrypt_status);
-		stream_free(pdu) ;
 		return 0;
 	}
 
-	stream_write(pdu, Buffers[1].pvBuffer, Buffers[1].cbBuffer);
-
-	status = rpc_in_write(rpc, pdu->data, pdu->p - pdu->data);
+	stream_seek(s, Buffers[1].cbBuffer);
 
-	stream_free(pdu) ;
+	status = rpc_in_write(rpc, s->data, stream_get_length(s));
 
 	if (status < 0)
 	{
@@ -872,94 +892,106 @@ int rpc_tsg_write(rdpRpc* rpc, BYTE* data, int length, UINT16 opnum)
 		return -1;
 	}
 
+	if (opnum != 8)
+		rpc->OutstandingCalls++;
+
 	return length;
 }
 
+/**
+ * Read the stub data of RPC responses into the caller's buffer. Stub data
+ * that does not fit is left in the fragment buffer for the next call.
+ */
+
 int rpc_read(rdpRpc* rpc, BYTE* data, int length)
 {
 	int status;
 	int read = 0;
+	BYTE* fragment;
 	int data_length;
+	UINT32 call_id;
+	UINT32 alloc_hint;
 	UINT16 frag_length;
 	UINT16 auth_length;
 	BYTE auth_pad_length;
-	UINT32 call_id = -1;
-	int rpc_length = length + 0xFF;
-	BYTE* rpc_data = malloc(rpc_length);
 
-	if (rpc_data == NULL)
+	if (rpc->StubLength > 0)
 	{
-		printf("rpc_read error: memory allocation failed\n") ;
-		return -1 ;
-	}
+		read = MIN(rpc->StubLength, (UINT32) length);
+		memcpy(data, &rpc->FragmentBuffer[rpc->StubOffset], read);
 
-	if (rpc->read_buffer_len > 0)
-	{
-		if (rpc->read_buffer_len > (UINT32) length)
-		{
-			printf("rpc_read error: receiving buffer is not large enough\n");
-			free(rpc_data);
-			return -1;
-		}
+		rpc->StubOffset += read;
+		rpc->StubLength -= read;
 
-		memcpy(data, rpc->read_buffer, rpc->read_buffer_len);
-		read += rpc->read_buffer_len;
-		free(rpc->read_buffer);
-		rpc->read_buffer_len = 0;
+		if (read == length)
+			return read;
 	}
 
 	while (TRUE)
 	{
-		status = rpc_out_read(rpc, rpc_data, rpc_length);
+		status = rpc_recv_fragment(rpc, &fragment);
 
 		if (status == 0)
 		{
-			free(rpc_data);
 			return read;
 		}
 		else if (status < 0)
 		{
-			printf("Error! rpc_out_read() returned negative value. BytesSent: %d, BytesReceived: %d\n",
+			printf("Error! rpc_recv_fragment() returned negative value. BytesSent: %d, BytesReceived: %d\n",
 					rpc->VirtualConnection->DefaultInChannel->BytesSent,
 					rpc->VirtualConnection->DefaultOutChannel->BytesReceived);
 
-			free(rpc_data);
 			return status;
 		}
 
-		frag_length = *(UINT16*)(rpc_data + 8);
-		auth_length = *(UINT16*)(rpc_data + 10);
-		call_id = *(UINT32*)(rpc_data + 12);
-		status = *(UINT32*)(rpc_data + 16); /* alloc_hint */
-		auth_pad_length = *(rpc_data + frag_length - auth_length - 6); /* -6 = -8 + 2 (sec_trailer + 2) */
+		frag_length = *(UINT16*)(fragment + 8);
+		auth_length = *(UINT16*)(fragment + 10);
+		call_id = *(UINT32*)(fragment + 12);
+		alloc_hint = *(UINT32*)(fragment + 16);
+
+		if (frag_length < 24 + 8 + auth_length)
+		{
+			printf("rpc_read error: invalid frag_length: %d\n", frag_length);
+			return -1;
+		}
+
+		auth_pad_length = *(fragment + frag_length - auth_length - 6); /* -6 = -8 + 2 (sec_trailer + 2) */
 
 		/* data_length must be calculated because alloc_hint carries size of more than one pdu */
 		data_length = frag_length - auth_length - 24 - 8 - auth_pad_length; /* 24 is header; 8 is sec_trailer */
 
-		if (status == 4)
+		if (data_length < 0)
+		{
+			printf("rpc_read error: invalid auth_pad_length: %d\n", auth_pad_length);
+			return -1;
+		}
+
+		/* the last fragment of a response completes its call, except for the receive pipe */
+
+		if ((call_id != rpc->pipe_call_id) && (fragment[3] & PFC_LAST_FRAG) && (rpc->OutstandingCalls > 0))
+			rpc->OutstandingCalls--;
+
+		if (alloc_hint == 4)
 			continue;
 
 		if (read + data_length > length) /* if read data is greater then given buffer */
 		{
-			rpc->read_buffer_len = read + data_length - length;
-			rpc->read_buffer = malloc(rpc->read_buffer_len);
+			rpc->StubOffset = (fragment - rpc->FragmentBuffer) + 24 + (length - read);
+			rpc->StubLength = read + data_length - length;
 
-			data_length -= rpc->read_buffer_len;
-
-			memcpy(rpc->read_buffer, rpc_data + 24 + data_length, rpc->read_buffer_len);
+			data_length = length - read;
 		}
 
-		memcpy(data + read, rpc_data + 24, data_length);
+		memcpy(data + read, fragment + 24, data_length);
 
 		read += data_length;
 
-		if (status > data_length && read < length)
+		if (alloc_hint > (UINT32) data_length && read < length)
 			continue;
 
 		break;
 	}
 
-	free(rpc_data);
 	return read;
 }
 
@@ -1099,10 +1131,17 @@ rdpRpc* rpc_new(rdpTransport* transport)
 		rpc_ntlm_http_init_channel(rpc, rpc->ntlm_http_in, TSG_CHANNEL_IN);
 		rpc_ntlm_http_init_channel(rpc, rpc->ntlm_http_out, TSG_CHANNEL_OUT);
 
-		rpc->read_buffer = NULL;
-		rpc->write_buffer = NULL;
-		rpc->read_buffer_len = 0;
-		rpc->write_buffer_len = 0;
+		rpc->ChannelRead = rpc_tls_out_read;
+		rpc->ChannelWrite = rpc_tls_in_write;
+
+		rpc->FragmentBuffer = (BYTE*) malloc(RPC_FRAGMENT_BUFFER_SIZE);
+		rpc->FragmentOffset = 0;
+		rpc->FragmentLength = 0;
+		rpc->StubOffset = 0;
+		rpc->StubLength = 0;
+
+		rpc->SendStream = stream_new(0x1000);
+		rpc->OutstandingCalls = 0;
 
 		rpc->ReceiveWindow = 0x00010000;
 		rpc->VirtualConnection = rpc_client_virtual_connection_new(rpc);
@@ -1120,6 +1159,8 @@ void rpc_free(rdpRpc* rpc)
 		ntlm_http_free(rpc->ntlm_http_in);
 		ntlm_http_free(rpc->ntlm_http_out);
 		rpc_client_virtual_connection_free(rpc->VirtualConnection);
+		stream_free(rpc->SendStream);
+		free(rpc->FragmentBuffer);
 		free(rpc);
 	}
 }
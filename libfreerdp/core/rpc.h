@@ -636,6 +636,16 @@ struct rpc_virtual_connection
 };
 typedef struct rpc_virtual_connection RpcVirtualConnection;
 
+/**
+ * Received PDUs are kept in a persistent fragment buffer large enough for
+ * the largest fragment plus read-ahead, and are parsed where they lie
+ */
+
+#define RPC_FRAGMENT_BUFFER_SIZE	0x00020000
+
+typedef int (*pRpcChannelRead)(rdpRpc* rpc, BYTE* data, int length);
+typedef int (*pRpcChannelWrite)(rdpRpc* rpc, BYTE* data, int length);
+
 struct rdp_rpc
 {
 	rdpTls* tls_in;
@@ -650,10 +660,18 @@ struct rdp_rpc
 	rdpSettings* settings;
 	rdpTransport* transport;
 
-	BYTE* write_buffer;
-	UINT32 write_buffer_len;
-	BYTE* read_buffer;
-	UINT32 read_buffer_len;
+	pRpcChannelRead ChannelRead;
+	pRpcChannelWrite ChannelWrite;
+
+	BYTE* FragmentBuffer;
+	UINT32 FragmentOffset;
+	UINT32 FragmentLength;
+
+	UINT32 StubOffset;
+	UINT32 StubLength;
+
+	STREAM* SendStream;
+	UINT32 OutstandingCalls;
 
 	UINT32 call_id;
 	UINT32 pipe_call_id;
@@ -681,7 +699,7 @@ void rpc_pdu_header_read(STREAM* s, RPC_PDU_HEADER* header);
 int rpc_out_write(rdpRpc* rpc, BYTE* data, int length);
 int rpc_in_write(rdpRpc* rpc, BYTE* data, int length);
 
-int rpc_out_read(rdpRpc* rpc, BYTE* data, int length);
+int rpc_recv_fragment(rdpRpc* rpc, BYTE** fragment);
 
 int rpc_tsg_write(rdpRpc* rpc, BYTE* data, int length, UINT16 opnum);
 int rpc_read(rdpRpc* rpc, BYTE* data, int length);
@@ -227,44 +227,64 @@ void security_mac_data(BYTE* mac_salt_key, BYTE* data, UINT32 length, BYTE* outp
 	crypto_md5_final(md5, output);
 }
 
-void security_mac_signature(rdpRdp *rdp, BYTE* data, UINT32 length, BYTE* output)
+/**
+ * The MAC keys only change when the keys are established, so the hash
+ * states after the MACKeyN + pad1 and MACKeyN + pad2 prefixes are kept in
+ * rdpRdp and copied for each PDU instead of hashing the prefixes again.
+ */
+
+void security_mac_init(rdpRdp* rdp)
+{
+	crypto_sha1_reset(&rdp->sign_sha1);
+	crypto_sha1_update(&rdp->sign_sha1, rdp->sign_key, rdp->rc4_key_len); /* MacKeyN */
+	crypto_sha1_update(&rdp->sign_sha1, pad1, sizeof(pad1)); /* pad1 */
+
+	crypto_md5_reset(&rdp->sign_md5);
+	crypto_md5_update(&rdp->sign_md5, rdp->sign_key, rdp->rc4_key_len); /* MacKeyN */
+	crypto_md5_update(&rdp->sign_md5, pad2, sizeof(pad2)); /* pad2 */
+}
+
+static void security_mac_begin(rdpRdp* rdp, UINT32 length, CryptoSha1 sha1)
 {
-	CryptoMd5 md5;
-	CryptoSha1 sha1;
 	BYTE length_le[4];
-	BYTE md5_digest[CRYPTO_MD5_DIGEST_LENGTH];
-	BYTE sha1_digest[CRYPTO_SHA1_DIGEST_LENGTH];
 
 	security_UINT32_le(length_le, length); /* length must be little-endian */
 
 	/* SHA1_Digest = SHA1(MACKeyN + pad1 + length + data) */
-	sha1 = crypto_sha1_init();
-	crypto_sha1_update(sha1, rdp->sign_key, rdp->rc4_key_len); /* MacKeyN */
-	crypto_sha1_update(sha1, pad1, sizeof(pad1)); /* pad1 */
+	*sha1 = rdp->sign_sha1; /* MacKeyN + pad1 */
 	crypto_sha1_update(sha1, length_le, sizeof(length_le)); /* length */
-	crypto_sha1_update(sha1, data, length); /* data */
-	crypto_sha1_final(sha1, sha1_digest);
+}
+
+static void security_mac_end(rdpRdp* rdp, CryptoSha1 sha1, BYTE* output)
+{
+	struct crypto_md5_struct md5;
+	BYTE md5_digest[CRYPTO_MD5_DIGEST_LENGTH];
+	BYTE sha1_digest[CRYPTO_SHA1_DIGEST_LENGTH];
+
+	crypto_sha1_digest(sha1, sha1_digest);
 
 	/* MACSignature = First64Bits(MD5(MACKeyN + pad2 + SHA1_Digest)) */
-	md5 = crypto_md5_init();
-	crypto_md5_update(md5, rdp->sign_key, rdp->rc4_key_len); /* MacKeyN */
-	crypto_md5_update(md5, pad2, sizeof(pad2)); /* pad2 */
-	crypto_md5_update(md5, sha1_digest, sizeof(sha1_digest)); /* SHA1_Digest */
-	crypto_md5_final(md5, md5_digest);
+	md5 = rdp->sign_md5; /* MacKeyN + pad2 */
+	crypto_md5_update(&md5, sha1_digest, sizeof(sha1_digest)); /* SHA1_Digest */
+	crypto_md5_digest(&md5, md5_digest);
 
 	memcpy(output, md5_digest, 8);
 }
 
+void security_mac_signature(rdpRdp *rdp, BYTE* data, UINT32 length, BYTE* output)
+{
+	struct crypto_sha1_struct sha1;
+
+	security_mac_begin(rdp, length, &sha1);
+	crypto_sha1_update(&sha1, data, length); /* data */
+	security_mac_end(rdp, &sha1, output);
+}
+
 void security_salted_mac_signature(rdpRdp *rdp, BYTE* data, UINT32 length, BOOL encryption, BYTE* output)
 {
-	CryptoMd5 md5;
-	CryptoSha1 sha1;
-	BYTE length_le[4];
 	BYTE use_count_le[4];
-	BYTE md5_digest[CRYPTO_MD5_DIGEST_LENGTH];
-	BYTE sha1_digest[CRYPTO_SHA1_DIGEST_LENGTH];
+	struct crypto_sha1_struct sha1;
 
-	security_UINT32_le(length_le, length); /* length must be little-endian */
 	if (encryption)
 	{
 		security_UINT32_le(use_count_le, rdp->encrypt_checksum_use_count);
@@ -279,23 +299,10 @@ void security_salted_mac_signature(rdpRdp *rdp, BYTE* data, UINT32 length, BOOL
 		security_UINT32_le(use_count_le, rdp->decrypt_checksum_use_count - 1);
 	}
 
-	/* SHA1_Digest = SHA1(MACKeyN + pad1 + length + data) */
-	sha1 = crypto_sha1_init();
-	crypto_sha1_update(sha1, rdp->sign_key, rdp->rc4_key_len); /* MacKeyN */
-	crypto_sha1_update(sha1, pad1, sizeof(pad1)); /* pad1 */
-	crypto_sha1_update(sha1, length_le, sizeof(length_le)); /* length */
-	crypto_sha1_update(sha1, data, length); /* data */
-	crypto_sha1_update(sha1, use_count_le, sizeof(use_count_le)); /* encryptionCount */
-	crypto_sha1_final(sha1, sha1_digest);
-
-	/* MACSignature = First64Bits(MD5(MACKeyN + pad2 + SHA1_Digest)) */
-	md5 = crypto_md5_init();
-	crypto_md5_update(md5, rdp->sign_key, rdp->rc4_key_len); /* MacKeyN */
-	crypto_md5_update(md5, pad2, sizeof(pad2)); /* pad2 */
-	crypto_md5_update(md5, sha1_digest, sizeof(sha1_digest)); /* SHA1_Digest */
-	crypto_md5_final(md5, md5_digest);
-
-	memcpy(output, md5_digest, 8);
+	security_mac_begin(rdp, length, &sha1);
+	crypto_sha1_update(&sha1, data, length); /* data */
+	crypto_sha1_update(&sha1, use_count_le, sizeof(use_count_le)); /* encryptionCount */
+	security_mac_end(rdp, &sha1, output);
 }
 
 static void security_A(BYTE* master_secret, BYTE* client_random, BYTE* server_random, BYTE* output)
@@ -425,6 +432,8 @@ BOOL security_establish_keys(BYTE* client_random, rdpRdp* rdp)
 		rdp->rc4_key_len = 16;
 	}
 
+	security_mac_init(rdp);
+
 	memcpy(rdp->decrypt_update_key, rdp->decrypt_key, 16);
 	memcpy(rdp->encrypt_update_key, rdp->encrypt_key, 16);
 	rdp->decrypt_use_count = 0;
@@ -465,7 +474,7 @@ BOOL security_key_update(BYTE* key, BYTE* update_key, int key_len)
 	return TRUE;
 }
 
-BOOL security_encrypt(BYTE* data, int length, rdpRdp* rdp)
+static void security_encrypt_update_key(rdpRdp* rdp)
 {
 	if (rdp->encrypt_use_count >= 4096)
 	{
@@ -474,13 +483,9 @@ BOOL security_encrypt(BYTE* data, int length, rdpRdp* rdp)
 		rdp->rc4_encrypt_key = crypto_rc4_init(rdp->encrypt_key, rdp->rc4_key_len);
 		rdp->encrypt_use_count = 0;
 	}
-	crypto_rc4(rdp->rc4_encrypt_key, length, data, data);
-	rdp->encrypt_use_count++;
-	rdp->encrypt_checksum_use_count++;
-	return TRUE;
 }
 
-BOOL security_decrypt(BYTE* data, int length, rdpRdp* rdp)
+static void security_decrypt_update_key(rdpRdp* rdp)
 {
 	if (rdp->decrypt_use_count >= 4096)
 	{
@@ -489,12 +494,99 @@ BOOL security_decrypt(BYTE* data, int length, rdpRdp* rdp)
 		rdp->rc4_decrypt_key = crypto_rc4_init(rdp->decrypt_key, rdp->rc4_key_len);
 		rdp->decrypt_use_count = 0;
 	}
+}
+
+BOOL security_encrypt(BYTE* data, int length, rdpRdp* rdp)
+{
+	security_encrypt_update_key(rdp);
+	crypto_rc4(rdp->rc4_encrypt_key, length, data, data);
+	rdp->encrypt_use_count++;
+	rdp->encrypt_checksum_use_count++;
+	return TRUE;
+}
+
+BOOL security_decrypt(BYTE* data, int length, rdpRdp* rdp)
+{
+	security_decrypt_update_key(rdp);
 	crypto_rc4(rdp->rc4_decrypt_key, length, data, data);
 	rdp->decrypt_use_count += 1;
 	rdp->decrypt_checksum_use_count++;
 	return TRUE;
 }
 
+/**
+ * Sign and encrypt data in one pass, as security_mac_signature or
+ * security_salted_mac_signature followed by security_encrypt. The data is
+ * hashed and encrypted in chunks small enough to still be in the cache
+ * when RC4 reads them back.
+ */
+
+BOOL security_encrypt_mac(BYTE* data, int length, BOOL salted, BYTE* output, rdpRdp* rdp)
+{
+	int size;
+	int offset;
+	BYTE use_count_le[4];
+	struct crypto_sha1_struct sha1;
+
+	security_encrypt_update_key(rdp);
+	security_mac_begin(rdp, length, &sha1);
+
+	for (offset = 0; offset < length; offset += size)
+	{
+		size = MIN(length - offset, SECURITY_CHUNK_SIZE);
+		crypto_sha1_update(&sha1, &data[offset], size); /* data */
+		crypto_rc4(rdp->rc4_encrypt_key, size, &data[offset], &data[offset]);
+	}
+
+	if (salted)
+	{
+		security_UINT32_le(use_count_le, rdp->encrypt_checksum_use_count);
+		crypto_sha1_update(&sha1, use_count_le, sizeof(use_count_le)); /* encryptionCount */
+	}
+
+	security_mac_end(rdp, &sha1, output);
+
+	rdp->encrypt_use_count++;
+	rdp->encrypt_checksum_use_count++;
+	return TRUE;
+}
+
+/**
+ * Decrypt data and compute the signature of the plain text in one pass,
+ * as security_decrypt followed by security_mac_signature or
+ * security_salted_mac_signature.
+ */
+
+BOOL security_decrypt_mac(BYTE* data, int length, BOOL salted, BYTE* output, rdpRdp* rdp)
+{
+	int size;
+	int offset;
+	BYTE use_count_le[4];
+	struct crypto_sha1_struct sha1;
+
+	security_decrypt_update_key(rdp);
+	security_mac_begin(rdp, length, &sha1);
+
+	for (offset = 0; offset < length; offset += size)
+	{
+		size = MIN(length - offset, SECURITY_CHUNK_SIZE);
+		crypto_rc4(rdp->rc4_decrypt_key, size, &data[offset], &data[offset]);
+		crypto_sha1_update(&sha1, &data[offset], size); /* data */
+	}
+
+	if (salted)
+	{
+		security_UINT32_le(use_count_le, rdp->decrypt_checksum_use_count);
+		crypto_sha1_update(&sha1, use_count_le, sizeof(use_count_le)); /* encryptionCount */
+	}
+
+	security_mac_end(rdp, &sha1, output);
+
+	rdp->decrypt_use_count += 1;
+	rdp->decrypt_checksum_use_count++;
+	return TRUE;
+}
+
 void security_hmac_signature(BYTE* data, int length, BYTE* output, rdpRdp* rdp)
 {
 	BYTE buf[20];
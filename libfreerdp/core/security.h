@@ -32,12 +32,18 @@ void security_mac_salt_key(BYTE* session_key_blob, BYTE* client_random, BYTE* se
 void security_licensing_encryption_key(BYTE* session_key_blob, BYTE* client_random, BYTE* server_random, BYTE* output);
 void security_mac_data(BYTE* mac_salt_key, BYTE* data, UINT32 length, BYTE* output);
 
+/* data is signed and encrypted in chunks of this many bytes */
+#define SECURITY_CHUNK_SIZE	2048
+
+void security_mac_init(rdpRdp* rdp);
 void security_mac_signature(rdpRdp *rdp, BYTE* data, UINT32 length, BYTE* output);
 void security_salted_mac_signature(rdpRdp *rdp, BYTE* data, UINT32 length, BOOL encryption, BYTE* output);
 BOOL security_establish_keys(BYTE* client_random, rdpRdp* rdp);
 
 BOOL security_encrypt(BYTE* data, int length, rdpRdp* rdp);
 BOOL security_decrypt(BYTE* data, int length, rdpRdp* rdp);
+BOOL security_encrypt_mac(BYTE* data, int length, BOOL salted, BYTE* output, rdpRdp* rdp);
+BOOL security_decrypt_mac(BYTE* data, int length, BOOL salted, BYTE* output, rdpRdp* rdp);
 
 void security_hmac_signature(BYTE* data, int length, BYTE* output, rdpRdp* rdp);
 BOOL security_fips_encrypt(BYTE* data, int length, rdpRdp* rdp);
@@ -237,6 +237,7 @@ rdpSettings* settings_new(void* instance)
 				PERF_DISABLE_WALLPAPER;
 
 		settings->auto_reconnection = TRUE;
+		settings->auto_reconnect_max_retries = 20;
 
 		settings->encryption_method = ENCRYPTION_METHOD_NONE;
 		settings->encryption_level = ENCRYPTION_LEVEL_NONE;
@@ -377,6 +378,8 @@ rdpSettings* settings_new(void* instance)
 
 void settings_free(rdpSettings* settings)
 {
+	int i;
+
 	if (settings != NULL)
 	{
 		free(settings->hostname);
@@ -394,13 +397,20 @@ void settings_free(rdpSettings* settings)
 		free(settings->client_hostname);
 		free(settings->client_product_id);
 		free(settings->server_random);
+		free(settings->client_random);
 		free(settings->server_certificate);
 		free(settings->rdp_key_file);
 		certificate_free(settings->server_cert);
 		free(settings->client_auto_reconnect_cookie);
 		free(settings->server_auto_reconnect_cookie);
 		free(settings->client_time_zone);
+
+		for (i = 0; i < (int) settings->bitmapCacheV2NumCells; i++)
+			free(settings->bitmapCacheV2CellInfo[i].persistentKeys);
+
 		free(settings->bitmapCacheV2CellInfo);
+		free(settings->bitmap_cache_persist_file);
+		free(settings->dump_pdu_file);
 		free(settings->glyphCache);
 		free(settings->fragCache);
 		key_free(settings->server_key);
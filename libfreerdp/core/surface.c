@@ -43,6 +43,8 @@ static int update_recv_surfcmd_surface_bits(rdpUpdate* update, STREAM* s)
 	pos = stream_get_pos(s) + cmd->bitmapDataLength;
 	cmd->bitmapData = stream_get_tail(s);
 
+	METRICS_ADD(update->context->rdp->metrics, METRICS_UPDATE_PIXELS, cmd->width * cmd->height);
+
 	IFCALL(update->SurfaceBits, update->context, cmd);
 
 	stream_set_pos(s, pos);
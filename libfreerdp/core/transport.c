@@ -30,6 +30,7 @@
 #include <freerdp/utils/stream.h>
 #include <freerdp/utils/memory.h>
 #include <freerdp/utils/hexdump.h>
+#include <freerdp/utils/time.h>
 #include <freerdp/errorcodes.h>
 
 #include <time.h>
@@ -87,12 +88,16 @@ BOOL transport_connect_rdp(rdpTransport* transport)
 
 BOOL transport_connect_tls(rdpTransport* transport)
 {
+	UINT32 start;
+
 	if (transport->tls == NULL)
 		transport->tls = tls_new(transport->settings);
 
 	transport->layer = TRANSPORT_LAYER_TLS;
 	transport->tls->sockfd = transport->tcp->sockfd;
 
+	start = freerdp_get_tick_count();
+
 	if (tls_connect(transport->tls) != TRUE)
 	{
 		if (!connectErrorCode)                    
@@ -103,11 +108,14 @@ BOOL transport_connect_tls(rdpTransport* transport)
 		return FALSE;
 	}
 
+	transport->tls_time = freerdp_get_tick_count() - start;
+
 	return TRUE;
 }
 
 BOOL transport_connect_nla(rdpTransport* transport)
 {
+	UINT32 start;
 	freerdp* instance;
 	rdpSettings* settings;
 
@@ -117,6 +125,8 @@ BOOL transport_connect_nla(rdpTransport* transport)
 	transport->layer = TRANSPORT_LAYER_TLS;
 	transport->tls->sockfd = transport->tcp->sockfd;
 
+	start = freerdp_get_tick_count();
+
 	if (tls_connect(transport->tls) != TRUE)
 	{
 		if (!connectErrorCode)                    
@@ -127,6 +137,8 @@ BOOL transport_connect_nla(rdpTransport* transport)
 		return FALSE;
 	}
 
+	transport->tls_time = freerdp_get_tick_count() - start;
+
 	/* Network Level Authentication */
 
 	if (transport->settings->authentication != TRUE)
@@ -138,6 +150,8 @@ BOOL transport_connect_nla(rdpTransport* transport)
 	if (transport->credssp == NULL)
 		transport->credssp = credssp_new(instance, transport->tls, settings);
 
+	start = freerdp_get_tick_count();
+
 	if (credssp_authenticate(transport->credssp) < 0)
 	{
 		if (!connectErrorCode)                    
@@ -150,6 +164,8 @@ BOOL transport_connect_nla(rdpTransport* transport)
 		return FALSE;
 	}
 
+	transport->nla_time = freerdp_get_tick_count() - start;
+
 	credssp_free(transport->credssp);
 
 	return TRUE;
@@ -290,6 +306,12 @@ int transport_read(rdpTransport* transport, STREAM* s)
 		break;
 	}
 
+	if ((status > 0) && METRICS_ENABLED(transport->metrics))
+	{
+		metrics_add_counter(transport->metrics, METRICS_TRANSPORT_READS, 1);
+		metrics_add_counter(transport->metrics, METRICS_TRANSPORT_READ_BYTES, status);
+	}
+
 #ifdef WITH_DEBUG_TRANSPORT
 	if (status > 0)
 	{
@@ -362,6 +384,12 @@ int transport_write(rdpTransport* transport, STREAM* s)
 		stream_seek(s, status);
 	}
 
+	if ((status >= 0) && METRICS_ENABLED(transport->metrics))
+	{
+		metrics_add_counter(transport->metrics, METRICS_TRANSPORT_WRITES, 1);
+		metrics_add_counter(transport->metrics, METRICS_TRANSPORT_WRITE_BYTES, stream_get_pos(s));
+	}
+
 	if (status < 0)
 	{
 		/* A write error indicates that the peer has dropped the connection */
@@ -462,6 +490,12 @@ int transport_check_fds(rdpTransport** ptransport)
 		stream_seal(received);
 		stream_set_pos(received, 0);
 
+		if (transport->pcap_pdu != NULL)
+		{
+			pcap_add_record(transport->pcap_pdu, stream_get_head(received), length);
+			pcap_flush(transport->pcap_pdu);
+		}
+
 		if (transport->recv_callback(transport, received, transport->recv_extra) == FALSE)
 			status = -1;
 
@@ -541,6 +575,9 @@ void transport_free(rdpTransport* transport)
 		tcp_free(transport->tcp_in);
 		tsg_free(transport->tsg);
 
+		if (transport->pcap_pdu != NULL)
+			pcap_close(transport->pcap_pdu);
+
 		free(transport);
 	}
 }
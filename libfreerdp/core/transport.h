@@ -40,7 +40,9 @@ typedef struct rdp_transport rdpTransport;
 #include <time.h>
 #include <freerdp/types.h>
 #include <freerdp/settings.h>
+#include <freerdp/utils/pcap.h>
 #include <freerdp/utils/stream.h>
+#include <freerdp/utils/metrics.h>
 #include <freerdp/utils/wait_obj.h>
 
 typedef BOOL (*TransportRecv) (rdpTransport* transport, STREAM* stream, void* extra);
@@ -66,6 +68,10 @@ struct rdp_transport
 	struct wait_obj* recv_event;
 	BOOL blocking;
 	BOOL process_single_pdu; /* process single pdu in transport_check_fds */
+	UINT32 tls_time; /* milliseconds spent in the TLS handshake */
+	UINT32 nla_time; /* milliseconds spent in Network Level Authentication */
+	rdpMetrics* metrics;
+	rdpPcap* pcap_pdu; /* received PDUs are recorded here when set */
 };
 
 STREAM* transport_recv_stream_init(rdpTransport* transport, int size);
@@ -23,6 +23,7 @@
 
 #include "update.h"
 #include "surface.h"
+#include "peer.h"
 
 #include <freerdp/peer.h>
 #include <freerdp/codec/bitmap.h>
@@ -39,7 +40,11 @@ static const char* const UPDATE_TYPE_STRINGS[] =
 
 BOOL update_recv_orders(rdpUpdate* update, STREAM* s)
 {
+	UINT64 start;
 	UINT16 numberOrders;
+	rdpMetrics* metrics = update->context->rdp->metrics;
+
+	start = metrics_start(metrics);
 
 	stream_seek_UINT16(s); /* pad2OctetsA (2 bytes) */
 	stream_read_UINT16(s, numberOrders); /* numberOrders (2 bytes) */
@@ -48,10 +53,17 @@ BOOL update_recv_orders(rdpUpdate* update, STREAM* s)
 	while (numberOrders > 0)
 	{
 		if (!update_recv_order(update, s))
+		{
+			update_flush_order_batch(update);
 			return FALSE;
+		}
+
 		numberOrders--;
 	}
 
+	update_flush_order_batch(update);
+	metrics_stop(metrics, METRICS_ORDERS, start);
+
 	return TRUE;
 }
 
@@ -115,6 +127,9 @@ void update_read_bitmap(rdpUpdate* update, STREAM* s, BITMAP_UPDATE* bitmap_upda
 	for (i = 0; i < (int) bitmap_update->number; i++)
 	{
 		update_read_bitmap_data(s, &bitmap_update->rectangles[i]);
+
+		METRICS_ADD(update->context->rdp->metrics, METRICS_UPDATE_PIXELS,
+				bitmap_update->rectangles[i].width * bitmap_update->rectangles[i].height);
 	}
 }
 
@@ -199,12 +214,20 @@ void update_read_pointer_color(STREAM* s, POINTER_COLOR_UPDATE* pointer_color)
 		pointer_color->xorMaskData = (BYTE*) malloc(pointer_color->lengthXorMask);
 		stream_read(s, pointer_color->xorMaskData, pointer_color->lengthXorMask);
 	}
+	else
+	{
+		pointer_color->xorMaskData = NULL;
+	}
 
 	if (pointer_color->lengthAndMask > 0)
 	{
 		pointer_color->andMaskData = (BYTE*) malloc(pointer_color->lengthAndMask);
 		stream_read(s, pointer_color->andMaskData, pointer_color->lengthAndMask);
 	}
+	else
+	{
+		pointer_color->andMaskData = NULL;
+	}
 
 	if (stream_get_left(s) > 0)
 		stream_seek_BYTE(s); /* pad (1 byte) */
@@ -221,6 +244,69 @@ void update_read_pointer_cached(STREAM* s, POINTER_CACHED_UPDATE* pointer_cached
 	stream_read_UINT16(s, pointer_cached->cacheIndex); /* cacheIndex (2 bytes) */
 }
 
+void update_read_pointer_large(STREAM* s, POINTER_LARGE_UPDATE* pointer_large)
+{
+	UINT32 scanlineXorMask;
+	UINT32 scanlineAndMask;
+
+	pointer_large->xorMaskData = NULL;
+	pointer_large->andMaskData = NULL;
+
+	if (stream_get_left(s) < 20)
+	{
+		DEBUG_WARN("truncated large pointer");
+		pointer_large->width = pointer_large->height = 0;
+		pointer_large->lengthXorMask = pointer_large->lengthAndMask = 0;
+		return;
+	}
+
+	stream_read_UINT16(s, pointer_large->xorBpp); /* xorBpp (2 bytes) */
+	stream_read_UINT16(s, pointer_large->cacheIndex); /* cacheIndex (2 bytes) */
+	stream_read_UINT16(s, pointer_large->hotSpotX); /* hotSpot.xPos (2 bytes) */
+	stream_read_UINT16(s, pointer_large->hotSpotY); /* hotSpot.yPos (2 bytes) */
+	stream_read_UINT16(s, pointer_large->width); /* width (2 bytes) */
+	stream_read_UINT16(s, pointer_large->height); /* height (2 bytes) */
+	stream_read_UINT32(s, pointer_large->lengthAndMask); /* lengthAndMask (4 bytes) */
+	stream_read_UINT32(s, pointer_large->lengthXorMask); /* lengthXorMask (4 bytes) */
+
+	if (pointer_large->hotSpotX >= pointer_large->width)
+		pointer_large->hotSpotX = 0;
+	if (pointer_large->hotSpotY >= pointer_large->height)
+		pointer_large->hotSpotY = 0;
+
+	/* both masks have their scanlines padded to 2 bytes, the AND mask is 1 bpp */
+	scanlineXorMask = ((pointer_large->width * pointer_large->xorBpp + 15) / 16) * 2;
+	scanlineAndMask = ((pointer_large->width + 15) / 16) * 2;
+
+	if ((pointer_large->width > LARGE_POINTER_MAX_SIZE) || (pointer_large->height > LARGE_POINTER_MAX_SIZE) ||
+			(pointer_large->xorBpp > 32) ||
+			(pointer_large->lengthXorMask < scanlineXorMask * pointer_large->height) ||
+			(pointer_large->lengthAndMask < scanlineAndMask * pointer_large->height) ||
+			(pointer_large->lengthXorMask > (UINT32) stream_get_left(s)) ||
+			(pointer_large->lengthAndMask > (UINT32) stream_get_left(s) - pointer_large->lengthXorMask))
+	{
+		DEBUG_WARN("invalid large pointer %dx%d", pointer_large->width, pointer_large->height);
+		pointer_large->width = pointer_large->height = 0;
+		pointer_large->lengthXorMask = pointer_large->lengthAndMask = 0;
+		return;
+	}
+
+	if (pointer_large->lengthXorMask > 0)
+	{
+		pointer_large->xorMaskData = (BYTE*) malloc(pointer_large->lengthXorMask);
+		stream_read(s, pointer_large->xorMaskData, pointer_large->lengthXorMask);
+	}
+
+	if (pointer_large->lengthAndMask > 0)
+	{
+		pointer_large->andMaskData = (BYTE*) malloc(pointer_large->lengthAndMask);
+		stream_read(s, pointer_large->andMaskData, pointer_large->lengthAndMask);
+	}
+
+	if (stream_get_left(s) > 0)
+		stream_seek_BYTE(s); /* pad (1 byte) */
+}
+
 void update_recv_pointer(rdpUpdate* update, STREAM* s)
 {
 	UINT16 messageType;
@@ -257,6 +343,11 @@ void update_recv_pointer(rdpUpdate* update, STREAM* s)
 			IFCALL(pointer->PointerCached, context, &pointer->pointer_cached);
 			break;
 
+		case PTR_MSG_TYPE_LARGE:
+			update_read_pointer_large(s, &pointer->pointer_large);
+			IFCALL(pointer->PointerLarge, context, &pointer->pointer_large);
+			break;
+
 		default:
 			break;
 	}
@@ -332,6 +423,7 @@ void update_reset_state(rdpUpdate* update)
 	memset(&primary->polygon_cb, 0, sizeof(POLYGON_CB_ORDER));
 	memset(&primary->ellipse_sc, 0, sizeof(ELLIPSE_SC_ORDER));
 	memset(&primary->ellipse_cb, 0, sizeof(ELLIPSE_CB_ORDER));
+	primary->batch.count = 0;
 
 	primary->order_info.orderType = ORDER_TYPE_PATBLT;
 	altsec->switch_surface.bitmapId = SCREEN_BITMAP_SURFACE;
@@ -437,6 +529,9 @@ static void update_send_surface_frame_marker(rdpContext* context, SURFACE_FRAME_
 	s = fastpath_update_pdu_init(rdp->fastpath);
 	update_write_surfcmd_frame_marker(s, surface_frame_marker->frameAction, surface_frame_marker->frameId);
 	fastpath_send_update_pdu(rdp->fastpath, FASTPATH_UPDATETYPE_SURFCMDS, s);
+
+	if ((context->peer != NULL) && (surface_frame_marker->frameAction == SURFACECMD_FRAMEACTION_END))
+		peer_frame_sent(context->peer, surface_frame_marker->frameId);
 }
 
 static void update_send_synchronize(rdpContext* context)
@@ -457,25 +552,116 @@ static void update_send_desktop_resize(rdpContext* context)
 	rdp_server_reactivate(context->rdp);
 }
 
+static void update_set_bounds(rdpContext* context, rdpBounds* bounds)
+{
+	rdpPrimaryUpdate* primary = context->rdp->update->primary;
+
+	primary->bounded = (bounds != NULL) ? TRUE : FALSE;
+
+	if (bounds != NULL)
+		memcpy(&(primary->bounds), bounds, sizeof(rdpBounds));
+}
+
+static void update_send_primary_order(rdpContext* context, BYTE orderType, void* order)
+{
+	STREAM* s;
+	rdpRdp* rdp = context->rdp;
+
+	s = fastpath_update_pdu_init(rdp->fastpath);
+	stream_write_UINT16(s, 1); /* numberOrders (2 bytes) */
+
+	if (update_write_primary_order(s, context->rdp->update->primary, orderType, order))
+		fastpath_send_update_pdu(rdp->fastpath, FASTPATH_UPDATETYPE_ORDERS, s);
+}
+
+static void update_send_dstblt(rdpContext* context, DSTBLT_ORDER* dstblt)
+{
+	update_send_primary_order(context, ORDER_TYPE_DSTBLT, dstblt);
+}
+
+static void update_send_patblt(rdpContext* context, PATBLT_ORDER* patblt)
+{
+	update_send_primary_order(context, ORDER_TYPE_PATBLT, patblt);
+}
+
 static void update_send_scrblt(rdpContext* context, SCRBLT_ORDER* scrblt)
+{
+	update_send_primary_order(context, ORDER_TYPE_SCRBLT, scrblt);
+}
+
+static void update_send_opaque_rect(rdpContext* context, OPAQUE_RECT_ORDER* opaque_rect)
+{
+	update_send_primary_order(context, ORDER_TYPE_OPAQUE_RECT, opaque_rect);
+}
+
+static void update_send_line_to(rdpContext* context, LINE_TO_ORDER* line_to)
+{
+	update_send_primary_order(context, ORDER_TYPE_LINE_TO, line_to);
+}
+
+static void update_send_memblt(rdpContext* context, MEMBLT_ORDER* memblt)
+{
+	update_send_primary_order(context, ORDER_TYPE_MEMBLT, memblt);
+}
+
+static void update_send_mem3blt(rdpContext* context, MEM3BLT_ORDER* mem3blt)
+{
+	update_send_primary_order(context, ORDER_TYPE_MEM3BLT, mem3blt);
+}
+
+static void update_send_glyph_index(rdpContext* context, GLYPH_INDEX_ORDER* glyph_index)
+{
+	update_send_primary_order(context, ORDER_TYPE_GLYPH_INDEX, glyph_index);
+}
+
+static void update_send_cache_bitmap_v2(rdpContext* context, CACHE_BITMAP_V2_ORDER* cache_bitmap_v2)
 {
 	STREAM* s;
+	int bm, em;
+	BYTE orderType;
+	UINT16 extraFlags;
 	rdpRdp* rdp = context->rdp;
 
+	orderType = cache_bitmap_v2->compressed ?
+			ORDER_TYPE_BITMAP_COMPRESSED_V2 : ORDER_TYPE_BITMAP_UNCOMPRESSED_V2;
+
 	s = fastpath_update_pdu_init(rdp->fastpath);
+	stream_write_UINT16(s, 1); /* numberOrders (2 bytes) */
+
+	bm = stream_get_pos(s);
+	stream_check_size(s, SECONDARY_ORDER_HEADER_LENGTH);
+	stream_seek(s, SECONDARY_ORDER_HEADER_LENGTH);
+
+	update_write_cache_bitmap_v2_order(s, cache_bitmap_v2, cache_bitmap_v2->compressed, &extraFlags);
+
+	em = stream_get_pos(s);
+	stream_set_pos(s, bm);
+	update_write_secondary_order_info(s, em - bm - SECONDARY_ORDER_HEADER_LENGTH, extraFlags, orderType);
+	stream_set_pos(s, em);
 
+	fastpath_send_update_pdu(rdp->fastpath, FASTPATH_UPDATETYPE_ORDERS, s);
+}
+
+static void update_send_cache_glyph(rdpContext* context, CACHE_GLYPH_ORDER* cache_glyph)
+{
+	STREAM* s;
+	int bm, em;
+	UINT16 extraFlags;
+	rdpRdp* rdp = context->rdp;
+
+	s = fastpath_update_pdu_init(rdp->fastpath);
 	stream_write_UINT16(s, 1); /* numberOrders (2 bytes) */
-	stream_write_BYTE(s, ORDER_STANDARD | ORDER_TYPE_CHANGE); /* controlFlags (1 byte) */
-	stream_write_BYTE(s, ORDER_TYPE_SCRBLT); /* orderType (1 byte) */
-	stream_write_BYTE(s, 0x7F); /* fieldFlags (variable) */
-
-	stream_write_UINT16(s, scrblt->nLeftRect);
-	stream_write_UINT16(s, scrblt->nTopRect);
-	stream_write_UINT16(s, scrblt->nWidth);
-	stream_write_UINT16(s, scrblt->nHeight);
-	stream_write_BYTE(s, scrblt->bRop);
-	stream_write_UINT16(s, scrblt->nXSrc);
-	stream_write_UINT16(s, scrblt->nYSrc);
+
+	bm = stream_get_pos(s);
+	stream_check_size(s, SECONDARY_ORDER_HEADER_LENGTH);
+	stream_seek(s, SECONDARY_ORDER_HEADER_LENGTH);
+
+	update_write_cache_glyph_order(s, cache_glyph, &extraFlags);
+
+	em = stream_get_pos(s);
+	stream_set_pos(s, bm);
+	update_write_secondary_order_info(s, em - bm - SECONDARY_ORDER_HEADER_LENGTH, extraFlags, ORDER_TYPE_CACHE_GLYPH);
+	stream_set_pos(s, em);
 
 	fastpath_send_update_pdu(rdp->fastpath, FASTPATH_UPDATETYPE_ORDERS, s);
 }
@@ -600,12 +786,22 @@ void update_register_server_callbacks(rdpUpdate* update)
 {
 	update->BeginPaint = update_begin_paint;
 	update->EndPaint = update_end_paint;
+	update->SetBounds = update_set_bounds;
 	update->Synchronize = update_send_synchronize;
 	update->DesktopResize = update_send_desktop_resize;
 	update->SurfaceBits = update_send_surface_bits;
 	update->SurfaceFrameMarker = update_send_surface_frame_marker;
 	update->SurfaceCommand = update_send_surface_command;
+	update->primary->DstBlt = update_send_dstblt;
+	update->primary->PatBlt = update_send_patblt;
 	update->primary->ScrBlt = update_send_scrblt;
+	update->primary->OpaqueRect = update_send_opaque_rect;
+	update->primary->LineTo = update_send_line_to;
+	update->primary->MemBlt = update_send_memblt;
+	update->primary->Mem3Blt = update_send_mem3blt;
+	update->primary->GlyphIndex = update_send_glyph_index;
+	update->secondary->CacheBitmapV2 = update_send_cache_bitmap_v2;
+	update->secondary->CacheGlyph = update_send_cache_glyph;
 	update->pointer->PointerSystem = update_send_pointer_system;
 	update->pointer->PointerColor = update_send_pointer_color;
 	update->pointer->PointerNew = update_send_pointer_new;
@@ -660,6 +856,7 @@ void update_free(rdpUpdate* update)
 		free(update->pointer);
 		free(update->primary->polyline.points);
 		free(update->primary->polygon_sc.points);
+		free(update->primary->batch.entries);
 		free(update->primary);
 		free(update->secondary);
 		free(update->altsec);
@@ -51,6 +51,7 @@ void update_read_pointer_system(STREAM* s, POINTER_SYSTEM_UPDATE* pointer_system
 void update_read_pointer_color(STREAM* s, POINTER_COLOR_UPDATE* pointer_color);
 void update_read_pointer_new(STREAM* s, POINTER_NEW_UPDATE* pointer_new);
 void update_read_pointer_cached(STREAM* s, POINTER_CACHED_UPDATE* pointer_cached);
+void update_read_pointer_large(STREAM* s, POINTER_LARGE_UPDATE* pointer_large);
 
 BOOL update_read_refresh_rect(rdpUpdate* update, STREAM* s);
 BOOL update_read_suppress_output(rdpUpdate* update, STREAM* s);
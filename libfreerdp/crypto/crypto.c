@@ -41,6 +41,22 @@ void crypto_sha1_final(CryptoSha1 sha1, BYTE* out_data)
 	free(sha1);
 }
 
+/**
+ * Reset and finalize a context owned by the caller, such as one on the
+ * stack or a copy of a saved state. Unlike crypto_sha1_final,
+ * crypto_sha1_digest does not free the context.
+ */
+
+void crypto_sha1_reset(CryptoSha1 sha1)
+{
+	SHA1_Init(&sha1->sha_ctx);
+}
+
+void crypto_sha1_digest(CryptoSha1 sha1, BYTE* out_data)
+{
+	SHA1_Final(out_data, &sha1->sha_ctx);
+}
+
 CryptoMd5 crypto_md5_init(void)
 {
 	CryptoMd5 md5 = malloc(sizeof(*md5));
@@ -59,6 +75,16 @@ void crypto_md5_final(CryptoMd5 md5, BYTE* out_data)
 	free(md5);
 }
 
+void crypto_md5_reset(CryptoMd5 md5)
+{
+	MD5_Init(&md5->md5_ctx);
+}
+
+void crypto_md5_digest(CryptoMd5 md5, BYTE* out_data)
+{
+	MD5_Final(out_data, &md5->md5_ctx);
+}
+
 CryptoRc4 crypto_rc4_init(const BYTE* key, UINT32 length)
 {
 	CryptoRc4 rc4 = malloc(sizeof(*rc4));
@@ -130,6 +156,11 @@ void crypto_hmac_sha1_init(CryptoHmac hmac, const BYTE* data, UINT32 length)
 	HMAC_Init_ex(&hmac->hmac_ctx, data, length, EVP_sha1(), NULL);
 }
 
+void crypto_hmac_md5_init(CryptoHmac hmac, const BYTE* data, UINT32 length)
+{
+	HMAC_Init_ex(&hmac->hmac_ctx, data, length, EVP_md5(), NULL);
+}
+
 void crypto_hmac_update(CryptoHmac hmac, const BYTE* data, UINT32 length)
 {
 	HMAC_Update(&hmac->hmac_ctx, data, length);
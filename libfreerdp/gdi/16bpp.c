@@ -35,6 +35,7 @@
 #include <freerdp/gdi/region.h>
 #include <freerdp/gdi/clipping.h>
 #include <freerdp/gdi/drawing.h>
+#include <freerdp/gdi/rop.h>
 
 #include <freerdp/gdi/16bpp.h>
 
@@ -198,549 +199,10 @@ static int BitBlt_SRCCOPY_16bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int nWi
 	return 0;
 }
 
-static int BitBlt_NOTSRCCOPY_16bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int nWidth, int nHeight, HGDI_DC hdcSrc, int nXSrc, int nYSrc)
-{
-	int x, y;
-	UINT16* srcp;
-	UINT16* dstp;
-	
-	for (y = 0; y < nHeight; y++)
-	{
-		srcp = (UINT16*) gdi_get_bitmap_pointer(hdcSrc, nXSrc, nYSrc + y);
-		dstp = (UINT16*) gdi_get_bitmap_pointer(hdcDest, nXDest, nYDest + y);
-
-		if (dstp != 0)
-		{
-			for (x = 0; x < nWidth; x++)
-			{
-				*dstp = ~(*srcp);
-				srcp++;
-				dstp++;
-			}
-		}
-	}
-
-	return 0;
-}
-
-static int BitBlt_DSTINVERT_16bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int nWidth, int nHeight)
-{
-	int x, y;
-	UINT16* dstp;
-		
-	for (y = 0; y < nHeight; y++)
-	{
-		dstp = (UINT16*) gdi_get_bitmap_pointer(hdcDest, nXDest, nYDest + y);
-
-		if (dstp != 0)
-		{
-			for (x = 0; x < nWidth; x++)
-			{
-				*dstp = ~(*dstp);
-				dstp++;
-			}
-		}
-	}
-
-	return 0;
-}
-
-static int BitBlt_SRCERASE_16bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int nWidth, int nHeight, HGDI_DC hdcSrc, int nXSrc, int nYSrc)
-{
-	int x, y;
-	UINT16* srcp;
-	UINT16* dstp;
-		
-	for (y = 0; y < nHeight; y++)
-	{
-		srcp = (UINT16*) gdi_get_bitmap_pointer(hdcSrc, nXSrc, nYSrc + y);
-		dstp = (UINT16*) gdi_get_bitmap_pointer(hdcDest, nXDest, nYDest + y);
-
-		if (dstp != 0)
-		{
-			for (x = 0; x < nWidth; x++)
-			{
-				*dstp = *srcp & ~(*dstp);
-				srcp++;
-				dstp++;
-			}
-		}
-	}
-
-	return 0;
-}
-
-static int BitBlt_NOTSRCERASE_16bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int nWidth, int nHeight, HGDI_DC hdcSrc, int nXSrc, int nYSrc)
-{
-	int x, y;
-	UINT16* srcp;
-	UINT16* dstp;
-		
-	for (y = 0; y < nHeight; y++)
-	{
-		srcp = (UINT16*) gdi_get_bitmap_pointer(hdcSrc, nXSrc, nYSrc + y);
-		dstp = (UINT16*) gdi_get_bitmap_pointer(hdcDest, nXDest, nYDest + y);
-
-		if (dstp != 0)
-		{
-			for (x = 0; x < nWidth; x++)
-			{
-				*dstp = ~(*srcp) & ~(*dstp);
-				srcp++;
-				dstp++;
-			}
-		}
-	}
-
-	return 0;
-}
-
-static int BitBlt_SRCINVERT_16bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int nWidth, int nHeight, HGDI_DC hdcSrc, int nXSrc, int nYSrc)
-{
-	int x, y;
-	UINT16* srcp;
-	UINT16* dstp;
-		
-	for (y = 0; y < nHeight; y++)
-	{
-		srcp = (UINT16*) gdi_get_bitmap_pointer(hdcSrc, nXSrc, nYSrc + y);
-		dstp = (UINT16*) gdi_get_bitmap_pointer(hdcDest, nXDest, nYDest + y);
-
-		if (dstp != 0)
-		{
-			for (x = 0; x < nWidth; x++)
-			{
-				*dstp ^= *srcp;
-				srcp++;
-				dstp++;
-			}
-		}
-	}
-
-	return 0;
-}
-
-static int BitBlt_SRCAND_16bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int nWidth, int nHeight, HGDI_DC hdcSrc, int nXSrc, int nYSrc)
-{
-	int x, y;
-	UINT16* srcp;
-	UINT16* dstp;
-		
-	for (y = 0; y < nHeight; y++)
-	{
-		srcp = (UINT16*) gdi_get_bitmap_pointer(hdcSrc, nXSrc, nYSrc + y);
-		dstp = (UINT16*) gdi_get_bitmap_pointer(hdcDest, nXDest, nYDest + y);
-
-		if (dstp != 0)
-		{
-			for (x = 0; x < nWidth; x++)
-			{
-				*dstp &= *srcp;
-				srcp++;
-				dstp++;
-			}
-		}
-	}
-
-	return 0;
-}
-
-static int BitBlt_SRCPAINT_16bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int nWidth, int nHeight, HGDI_DC hdcSrc, int nXSrc, int nYSrc)
-{
-	int x, y;
-	UINT16* srcp;
-	UINT16* dstp;
-		
-	for (y = 0; y < nHeight; y++)
-	{
-		srcp = (UINT16*) gdi_get_bitmap_pointer(hdcSrc, nXSrc, nYSrc + y);
-		dstp = (UINT16*) gdi_get_bitmap_pointer(hdcDest, nXDest, nYDest + y);
-
-		if (dstp != 0)
-		{
-			for (x = 0; x < nWidth; x++)
-			{
-				*dstp |= *srcp;
-				srcp++;
-				dstp++;
-			}
-		}
-	}
-
-	return 0;
-}
-
-static int BitBlt_DSPDxax_16bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int nWidth, int nHeight, HGDI_DC hdcSrc, int nXSrc, int nYSrc)
-{	
-	int x, y;
-	BYTE* srcp;
-	UINT16* dstp;
-	UINT16 src16;
-	UINT16 color16;
-	HGDI_BITMAP hSrcBmp;
-
-	/* D = (S & P) | (~S & D) */
-	/* DSPDxax, used to draw glyphs */
-
-	color16 = gdi_get_color_16bpp(hdcDest, hdcDest->textColor);
-
-	hSrcBmp = (HGDI_BITMAP) hdcSrc->selectedObject;
-
-	if (hdcSrc->bytesPerPixel != 1)
-	{
-		printf("BitBlt_DSPDxax expects 1 bpp, unimplemented for %d\n", hdcSrc->bytesPerPixel);
-		return 0;
-	}
-	
-	for (y = 0; y < nHeight; y++)
-	{
-		srcp = (BYTE*) gdi_get_bitmap_pointer(hdcSrc, nXSrc, nYSrc + y);
-		dstp = (UINT16*) gdi_get_bitmap_pointer(hdcDest, nXDest, nYDest + y);
-
-		if (dstp != 0)
-		{
-			for (x = 0; x < nWidth; x++)
-			{
-				src16 = (*srcp << 8) | *srcp;
-				*dstp = (src16 & color16) | (~src16 & *dstp);
-				srcp++;
-				dstp++;
-			}
-		}
-	}
-
-	return 0;
-}
-
-static int BitBlt_PSDPxax_16bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int nWidth, int nHeight, HGDI_DC hdcSrc, int nXSrc, int nYSrc)
-{
-	int x, y;
-	UINT16* srcp;
-	UINT16* dstp;
-	UINT16* patp;
-	UINT16 color16;
-
-	/* D = (S & D) | (~S & P) */
-
-	if (hdcDest->brush->style == GDI_BS_SOLID)
-	{
-		color16 = gdi_get_color_16bpp(hdcDest, hdcDest->brush->color);
-		patp = (UINT16*) &color16;
-
-		for (y = 0; y < nHeight; y++)
-		{
-			srcp = (UINT16*) gdi_get_bitmap_pointer(hdcSrc, nXSrc, nYSrc + y);
-			dstp = (UINT16*) gdi_get_bitmap_pointer(hdcDest, nXDest, nYDest + y);
-
-			if (dstp != 0)
-			{
-				for (x = 0; x < nWidth; x++)
-				{
-					*dstp = (*srcp & *dstp) | (~(*srcp) & *patp);
-					srcp++;
-					dstp++;
-				}
-			}
-		}
-	}
-	else
-	{
-		for (y = 0; y < nHeight; y++)
-		{
-			srcp = (UINT16*) gdi_get_bitmap_pointer(hdcSrc, nXSrc, nYSrc + y);
-			dstp = (UINT16*) gdi_get_bitmap_pointer(hdcDest, nXDest, nYDest + y);
-
-			if (dstp != 0)
-			{
-				for (x = 0; x < nWidth; x++)
-				{
-					patp = (UINT16*) gdi_get_brush_pointer(hdcDest, x, y);
-					*dstp = (*srcp & *dstp) | (~(*srcp) & *patp);
-					srcp++;
-					dstp++;
-				}
-			}
-		}
-	}
-
-	return 0;
-}
-
-static int BitBlt_SPna_16bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int nWidth, int nHeight, HGDI_DC hdcSrc, int nXSrc, int nYSrc)
-{
-	int x, y;
-	UINT16* srcp;
-	UINT16* dstp;
-	UINT16* patp;
-	
-	for (y = 0; y < nHeight; y++)
-	{
-		srcp = (UINT16*) gdi_get_bitmap_pointer(hdcSrc, nXSrc, nYSrc + y);
-		dstp = (UINT16*) gdi_get_bitmap_pointer(hdcDest, nXDest, nYDest + y);
-
-		if (dstp != 0)
-		{
-			for (x = 0; x < nWidth; x++)
-			{
-				patp = (UINT16*) gdi_get_brush_pointer(hdcDest, x, y);
-				*dstp = *srcp & ~(*patp);
-				srcp++;
-				dstp++;
-			}
-		}
-	}
-	
-	return 0;
-}
-
-static int BitBlt_DPa_16bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int nWidth, int nHeight)
-{
-	int x, y;
-	UINT16* dstp;
-	UINT16* patp;
-
-	for (y = 0; y < nHeight; y++)
-	{
-		dstp = (UINT16*) gdi_get_bitmap_pointer(hdcDest, nXDest, nYDest + y);
-
-		if (dstp != 0)
-		{
-			for (x = 0; x < nWidth; x++)
-			{
-				patp = (UINT16*) gdi_get_brush_pointer(hdcDest, x, y);
-
-				*dstp = *dstp & *patp;
-				dstp++;
-			}
-		}
-	}
-
-	return 0;
-}
-
-static int BitBlt_PDxn_16bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int nWidth, int nHeight)
-{
-	int x, y;
-	UINT16* dstp;
-	UINT16* patp;
-
-	for (y = 0; y < nHeight; y++)
-	{
-		dstp = (UINT16*) gdi_get_bitmap_pointer(hdcDest, nXDest, nYDest + y);
-
-		if (dstp != 0)
-		{
-			for (x = 0; x < nWidth; x++)
-			{
-				patp = (UINT16*) gdi_get_brush_pointer(hdcDest, x, y);
-				*dstp = *dstp ^ ~(*patp);
-				dstp++;
-			}
-		}
-	}
-
-	return 0;
-}
-
-static int BitBlt_DSna_16bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int nWidth, int nHeight, HGDI_DC hdcSrc, int nXSrc, int nYSrc)
-{
-	int x, y;
-	UINT16* srcp;
-	UINT16* dstp;
-
-	for (y = 0; y < nHeight; y++)
-	{
-		srcp = (UINT16*) gdi_get_bitmap_pointer(hdcSrc, nXSrc, nYSrc + y);
-		dstp = (UINT16*) gdi_get_bitmap_pointer(hdcDest, nXDest, nYDest + y);
-
-		if (dstp != 0)
-		{
-			for (x = 0; x < nWidth; x++)
-			{
-				*dstp = ~(*srcp) & (*dstp);
-				srcp++;
-				dstp++;
-			}
-		}
-	}
-
-	return 0;
-}
-
-
-static int BitBlt_MERGECOPY_16bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int nWidth, int nHeight, HGDI_DC hdcSrc, int nXSrc, int nYSrc)
-{
-	int x, y;
-	UINT16* srcp;
-	UINT16* dstp;
-	UINT16* patp;
-	
-	for (y = 0; y < nHeight; y++)
-	{
-		srcp = (UINT16*) gdi_get_bitmap_pointer(hdcSrc, nXSrc, nYSrc + y);
-		dstp = (UINT16*) gdi_get_bitmap_pointer(hdcDest, nXDest, nYDest + y);
-
-		if (dstp != 0)
-		{
-			for (x = 0; x < nWidth; x++)
-			{
-				patp = (UINT16*) gdi_get_brush_pointer(hdcDest, x, y);
-				*dstp = *srcp & *patp;
-				srcp++;
-				dstp++;
-			}
-		}
-	}
-	
-	return 0;
-}
-
-static int BitBlt_MERGEPAINT_16bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int nWidth, int nHeight, HGDI_DC hdcSrc, int nXSrc, int nYSrc)
-{
-	int x, y;
-	UINT16* srcp;
-	UINT16* dstp;
-	
-	for (y = 0; y < nHeight; y++)
-	{
-		srcp = (UINT16*) gdi_get_bitmap_pointer(hdcSrc, nXSrc, nYSrc + y);
-		dstp = (UINT16*) gdi_get_bitmap_pointer(hdcDest, nXDest, nYDest + y);
-
-		if (dstp != 0)
-		{
-			for (x = 0; x < nWidth; x++)
-			{				
-				*dstp = ~(*srcp) | *dstp;
-				srcp++;
-				dstp++;
-			}
-		}
-	}
-	
-	return 0;
-}
-
-static int BitBlt_PATCOPY_16bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int nWidth, int nHeight)
-{
-	int x, y;
-	UINT16* dstp;
-	UINT16* patp;
-	UINT16 color16;
-
-	if (hdcDest->brush->style == GDI_BS_SOLID)
-	{
-		color16 = gdi_get_color_16bpp(hdcDest, hdcDest->brush->color);
-
-		for (y = 0; y < nHeight; y++)
-		{
-			dstp = (UINT16*) gdi_get_bitmap_pointer(hdcDest, nXDest, nYDest + y);
-
-			if (dstp != 0)
-			{
-				for (x = 0; x < nWidth; x++)
-				{
-					*dstp = color16;
-					dstp++;
-				}
-			}
-		}
-	}
-	else
-	{
-		for (y = 0; y < nHeight; y++)
-		{
-			dstp = (UINT16*) gdi_get_bitmap_pointer(hdcDest, nXDest, nYDest + y);
-
-			if (dstp != 0)
-			{
-				for (x = 0; x < nWidth; x++)
-				{
-					patp = (UINT16*) gdi_get_brush_pointer(hdcDest, x, y);
-					*dstp = *patp;
-					dstp++;
-				}
-			}
-		}
-	}
-
-	return 0;
-}
-
-static int BitBlt_PATINVERT_16bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int nWidth, int nHeight)
+int BitBlt_16bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int nWidth, int nHeight, HGDI_DC hdcSrc, int nXSrc, int nYSrc, int rop)
 {
-	int x, y;
-	UINT16* dstp;
-	UINT16* patp;
 	UINT16 color16;
 
-	if (hdcDest->brush->style == GDI_BS_SOLID)
-	{
-		color16 = gdi_get_color_16bpp(hdcDest, hdcDest->brush->color);
-
-		for (y = 0; y < nHeight; y++)
-		{
-			dstp = (UINT16*) gdi_get_bitmap_pointer(hdcDest, nXDest, nYDest + y);
-
-			if (dstp != 0)
-			{
-				for (x = 0; x < nWidth; x++)
-				{
-					*dstp ^= color16;
-					dstp++;
-				}
-			}
-		}
-	}
-	else
-	{
-		for (y = 0; y < nHeight; y++)
-		{
-			dstp = (UINT16*) gdi_get_bitmap_pointer(hdcDest, nXDest, nYDest + y);
-
-			if (dstp != 0)
-			{
-				for (x = 0; x < nWidth; x++)
-				{
-					patp = (UINT16*) gdi_get_brush_pointer(hdcDest, x, y);
-					*dstp = *patp ^ *dstp;
-					dstp++;
-				}
-			}
-		}
-	}
-	
-	return 0;
-}
-
-static int BitBlt_PATPAINT_16bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int nWidth, int nHeight, HGDI_DC hdcSrc, int nXSrc, int nYSrc)
-{
-	int x, y;
-	UINT16* srcp;
-	UINT16* dstp;
-	UINT16* patp;
-	
-	for (y = 0; y < nHeight; y++)
-	{
-		srcp = (UINT16*) gdi_get_bitmap_pointer(hdcSrc, nXSrc, nYSrc + y);
-		dstp = (UINT16*) gdi_get_bitmap_pointer(hdcDest, nXDest, nYDest + y);
-
-		if (dstp != 0)
-		{
-			for (x = 0; x < nWidth; x++)
-			{
-				patp = (UINT16*) gdi_get_brush_pointer(hdcDest, x, y);
-				*dstp = *dstp | (*patp | ~(*srcp));
-				srcp++;
-				dstp++;
-			}
-		}
-	}
-	
-	return 0;
-}
-
-int BitBlt_16bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int nWidth, int nHeight, HGDI_DC hdcSrc, int nXSrc, int nYSrc, int rop)
-{
 	if (hdcSrc != NULL)
 	{
 		if (gdi_ClipCoords(hdcDest, &nXDest, &nYDest, &nWidth, &nHeight, &nXSrc, &nYSrc) == 0)
@@ -768,68 +230,34 @@ int BitBlt_16bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int nWidth, int nHeigh
 			return BitBlt_SRCCOPY_16bpp(hdcDest, nXDest, nYDest, nWidth, nHeight, hdcSrc, nXSrc, nYSrc);
 			break;
 
-		case GDI_SPna:
-			return BitBlt_SPna_16bpp(hdcDest, nXDest, nYDest, nWidth, nHeight, hdcSrc, nXSrc, nYSrc);
-			break;
-
-		case GDI_DSna:
-			return BitBlt_DSna_16bpp(hdcDest, nXDest, nYDest, nWidth, nHeight, hdcSrc, nXSrc, nYSrc);
-			break;
-
 		case GDI_DSPDxax:
-			return BitBlt_DSPDxax_16bpp(hdcDest, nXDest, nYDest, nWidth, nHeight, hdcSrc, nXSrc, nYSrc);
+			color16 = gdi_get_color_16bpp(hdcDest, hdcDest->textColor);
+			return gdi_rop_blt(hdcDest, nXDest, nYDest, nWidth, nHeight, hdcSrc, nXSrc, nYSrc, rop, (BYTE*) &color16);
 			break;
-			
+
 		case GDI_PSDPxax:
-			return BitBlt_PSDPxax_16bpp(hdcDest, nXDest, nYDest, nWidth, nHeight, hdcSrc, nXSrc, nYSrc);
+		case GDI_PATCOPY:
+		case GDI_PATINVERT:
+			color16 = gdi_get_color_16bpp(hdcDest, hdcDest->brush->color);
+			return gdi_rop_blt(hdcDest, nXDest, nYDest, nWidth, nHeight, hdcSrc, nXSrc, nYSrc, rop,
+					(hdcDest->brush->style == GDI_BS_SOLID) ? (BYTE*) &color16 : NULL);
 			break;
 
+		case GDI_SPna:
+		case GDI_DSna:
+		case GDI_DPa:
+		case GDI_PDxn:
 		case GDI_NOTSRCCOPY:
-			return BitBlt_NOTSRCCOPY_16bpp(hdcDest, nXDest, nYDest, nWidth, nHeight, hdcSrc, nXSrc, nYSrc);
-			break;
-
 		case GDI_DSTINVERT:
-			return BitBlt_DSTINVERT_16bpp(hdcDest, nXDest, nYDest, nWidth, nHeight);
-			break;
-
 		case GDI_SRCERASE:
-			return BitBlt_SRCERASE_16bpp(hdcDest, nXDest, nYDest, nWidth, nHeight, hdcSrc, nXSrc, nYSrc);
-			break;
-
 		case GDI_NOTSRCERASE:
-			return BitBlt_NOTSRCERASE_16bpp(hdcDest, nXDest, nYDest, nWidth, nHeight, hdcSrc, nXSrc, nYSrc);
-			break;
-
 		case GDI_SRCINVERT:
-			return BitBlt_SRCINVERT_16bpp(hdcDest, nXDest, nYDest, nWidth, nHeight, hdcSrc, nXSrc, nYSrc);
-			break;
-
 		case GDI_SRCAND:
-			return BitBlt_SRCAND_16bpp(hdcDest, nXDest, nYDest, nWidth, nHeight, hdcSrc, nXSrc, nYSrc);
-			break;
-
 		case GDI_SRCPAINT:
-			return BitBlt_SRCPAINT_16bpp(hdcDest, nXDest, nYDest, nWidth, nHeight, hdcSrc, nXSrc, nYSrc);
-			break;
-
 		case GDI_MERGECOPY:
-			return BitBlt_MERGECOPY_16bpp(hdcDest, nXDest, nYDest, nWidth, nHeight, hdcSrc, nXSrc, nYSrc);
-			break;
-
 		case GDI_MERGEPAINT:
-			return BitBlt_MERGEPAINT_16bpp(hdcDest, nXDest, nYDest, nWidth, nHeight, hdcSrc, nXSrc, nYSrc);
-			break;
-
-		case GDI_PATCOPY:
-			return BitBlt_PATCOPY_16bpp(hdcDest, nXDest, nYDest, nWidth, nHeight);
-			break;
-
-		case GDI_PATINVERT:
-			return BitBlt_PATINVERT_16bpp(hdcDest, nXDest, nYDest, nWidth, nHeight);
-			break;
-
 		case GDI_PATPAINT:
-			return BitBlt_PATPAINT_16bpp(hdcDest, nXDest, nYDest, nWidth, nHeight, hdcSrc, nXSrc, nYSrc);
+			return gdi_rop_blt(hdcDest, nXDest, nYDest, nWidth, nHeight, hdcSrc, nXSrc, nYSrc, rop, NULL);
 			break;
 	}
 	
@@ -839,6 +267,8 @@ int BitBlt_16bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int nWidth, int nHeigh
 
 int PatBlt_16bpp(HGDI_DC hdc, int nXLeft, int nYLeft, int nWidth, int nHeight, int rop)
 {
+	UINT16 color16;
+
 	if (gdi_ClipCoords(hdc, &nXLeft, &nYLeft, &nWidth, &nHeight, NULL, NULL) == 0)
 		return 0;
 	
@@ -847,15 +277,10 @@ int PatBlt_16bpp(HGDI_DC hdc, int nXLeft, int nYLeft, int nWidth, int nHeight, i
 	switch (rop)
 	{
 		case GDI_PATCOPY:
-			return BitBlt_PATCOPY_16bpp(hdc, nXLeft, nYLeft, nWidth, nHeight);
-			break;
-
 		case GDI_PATINVERT:
-			return BitBlt_PATINVERT_16bpp(hdc, nXLeft, nYLeft, nWidth, nHeight);
-			break;
-			
-		case GDI_DSTINVERT:
-			return BitBlt_DSTINVERT_16bpp(hdc, nXLeft, nYLeft, nWidth, nHeight);
+			color16 = gdi_get_color_16bpp(hdc, hdc->brush->color);
+			return gdi_rop_blt(hdc, nXLeft, nYLeft, nWidth, nHeight, NULL, 0, 0, rop,
+					(hdc->brush->style == GDI_BS_SOLID) ? (BYTE*) &color16 : NULL);
 			break;
 
 		case GDI_BLACKNESS:
@@ -866,12 +291,10 @@ int PatBlt_16bpp(HGDI_DC hdc, int nXLeft, int nYLeft, int nWidth, int nHeight, i
 			return BitBlt_WHITENESS_16bpp(hdc, nXLeft, nYLeft, nWidth, nHeight);
 			break;
 
+		case GDI_DSTINVERT:
 		case GDI_DPa:
-			return BitBlt_DPa_16bpp(hdc, nXLeft, nYLeft, nWidth, nHeight);
-			break;
-
 		case GDI_PDxn:
-			return BitBlt_PDxn_16bpp(hdc, nXLeft, nYLeft, nWidth, nHeight);
+			return gdi_rop_blt(hdc, nXLeft, nYLeft, nWidth, nHeight, NULL, 0, 0, rop, NULL);
 			break;
 
 		default:
@@ -684,12 +684,286 @@ void gdi_ellipse_cb(rdpContext* context, ELLIPSE_CB_ORDER* ellipse_cb)
 	printf("EllipseCB\n");
 }
 
+/* number of following orders searched for an opaque rectangle covering an order */
+#define GDI_BATCH_LOOKAHEAD	32
+
+static BOOL gdi_batch_entry_rect(ORDER_BATCH_ENTRY* entry, rdpBounds* rect)
+{
+	INT32 x, y, w, h;
+
+	switch (entry->orderType)
+	{
+		case ORDER_BATCH_DSTBLT:
+			x = entry->order.dstblt.nLeftRect;
+			y = entry->order.dstblt.nTopRect;
+			w = entry->order.dstblt.nWidth;
+			h = entry->order.dstblt.nHeight;
+			break;
+
+		case ORDER_BATCH_PATBLT:
+			x = entry->order.patblt.nLeftRect;
+			y = entry->order.patblt.nTopRect;
+			w = entry->order.patblt.nWidth;
+			h = entry->order.patblt.nHeight;
+			break;
+
+		case ORDER_BATCH_SCRBLT:
+			x = entry->order.scrblt.nLeftRect;
+			y = entry->order.scrblt.nTopRect;
+			w = entry->order.scrblt.nWidth;
+			h = entry->order.scrblt.nHeight;
+			break;
+
+		case ORDER_BATCH_OPAQUE_RECT:
+			x = entry->order.opaque_rect.nLeftRect;
+			y = entry->order.opaque_rect.nTopRect;
+			w = entry->order.opaque_rect.nWidth;
+			h = entry->order.opaque_rect.nHeight;
+			break;
+
+		case ORDER_BATCH_MEMBLT:
+			x = entry->order.memblt.nLeftRect;
+			y = entry->order.memblt.nTopRect;
+			w = entry->order.memblt.nWidth;
+			h = entry->order.memblt.nHeight;
+			break;
+
+		case ORDER_BATCH_MEM3BLT:
+			x = entry->order.mem3blt.nLeftRect;
+			y = entry->order.mem3blt.nTopRect;
+			w = entry->order.mem3blt.nWidth;
+			h = entry->order.mem3blt.nHeight;
+			break;
+
+		default:
+			return FALSE;
+	}
+
+	rect->left = x;
+	rect->top = y;
+	rect->right = x + w - 1;
+	rect->bottom = y + h - 1;
+
+	if (entry->bounded)
+	{
+		rect->left = MAX(rect->left, entry->bounds.left);
+		rect->top = MAX(rect->top, entry->bounds.top);
+		rect->right = MIN(rect->right, entry->bounds.right);
+		rect->bottom = MIN(rect->bottom, entry->bounds.bottom);
+	}
+
+	return TRUE;
+}
+
+static BOOL gdi_batch_rect_contains(rdpBounds* outer, rdpBounds* inner)
+{
+	return (inner->left >= outer->left) && (inner->top >= outer->top) &&
+			(inner->right <= outer->right) && (inner->bottom <= outer->bottom);
+}
+
+static void gdi_batch_set_opaque_rect(OPAQUE_RECT_ORDER* opaque_rect, rdpBounds* rect)
+{
+	opaque_rect->nLeftRect = rect->left;
+	opaque_rect->nTopRect = rect->top;
+	opaque_rect->nWidth = rect->right - rect->left + 1;
+	opaque_rect->nHeight = rect->bottom - rect->top + 1;
+}
+
+/**
+ * Merge an opaque rectangle into the previous one if they have the
+ * same color and together form a rectangle.
+ */
+
+static BOOL gdi_batch_merge_opaque_rect(ORDER_BATCH_ENTRY* last, ORDER_BATCH_ENTRY* entry)
+{
+	rdpBounds a, b;
+
+	if ((last->orderType != ORDER_BATCH_OPAQUE_RECT) || (entry->orderType != ORDER_BATCH_OPAQUE_RECT))
+		return FALSE;
+
+	if (last->order.opaque_rect.color != entry->order.opaque_rect.color)
+		return FALSE;
+
+	gdi_batch_entry_rect(last, &a);
+	gdi_batch_entry_rect(entry, &b);
+
+	if ((a.top == b.top) && (a.bottom == b.bottom) &&
+			(b.left <= a.right + 1) && (a.left <= b.right + 1))
+	{
+		a.left = MIN(a.left, b.left);
+		a.right = MAX(a.right, b.right);
+	}
+	else if ((a.left == b.left) && (a.right == b.right) &&
+			(b.top <= a.bottom + 1) && (a.top <= b.bottom + 1))
+	{
+		a.top = MIN(a.top, b.top);
+		a.bottom = MAX(a.bottom, b.bottom);
+	}
+	else
+	{
+		return FALSE;
+	}
+
+	gdi_batch_set_opaque_rect(&last->order.opaque_rect, &a);
+
+	return TRUE;
+}
+
+/**
+ * Render a batch of primary drawing orders.
+ * Bounded opaque rectangles are clipped up front, orders entirely covered by
+ * a later opaque rectangle are skipped, adjacent opaque rectangles of the same
+ * color are merged and the clipping region only changes when the bounds do.
+ * Orders that do not reference a cache are drawn directly; PatBlt, MemBlt,
+ * Mem3Blt and GlyphIndex still go through the update callbacks so that the
+ * brush, bitmap and glyph caches can resolve their cache indices.
+ * @param context current context
+ * @param batch order batch
+ */
+
+void gdi_order_batch(rdpContext* context, ORDER_BATCH* batch)
+{
+	int i, j, n;
+	rdpBounds rect;
+	rdpBounds cover;
+	BOOL bounded = FALSE;
+	rdpBounds bounds = { 0 };
+	ORDER_BATCH_ENTRY* last = NULL;
+	ORDER_BATCH_ENTRY* entry;
+	rdpPrimaryUpdate* primary = context->instance->update->primary;
+
+	n = (int) batch->count;
+
+	for (i = 0; i < n; i++)
+	{
+		entry = &batch->entries[i];
+
+		if ((entry->orderType == ORDER_BATCH_OPAQUE_RECT) && entry->bounded)
+		{
+			gdi_batch_entry_rect(entry, &rect);
+			gdi_batch_set_opaque_rect(&entry->order.opaque_rect, &rect);
+			entry->bounded = FALSE;
+		}
+	}
+
+	for (i = 0; i < n; i++)
+	{
+		entry = &batch->entries[i];
+
+		if (!gdi_batch_entry_rect(entry, &rect))
+			continue;
+
+		if ((rect.left > rect.right) || (rect.top > rect.bottom))
+		{
+			entry->skip = TRUE;
+			continue;
+		}
+
+		for (j = i + 1; (j < n) && (j <= i + GDI_BATCH_LOOKAHEAD); j++)
+		{
+			/* screen to screen blits read what earlier orders have drawn */
+
+			if (batch->entries[j].orderType == ORDER_BATCH_SCRBLT)
+				break;
+
+			if (batch->entries[j].orderType != ORDER_BATCH_OPAQUE_RECT)
+				continue;
+
+			gdi_batch_entry_rect(&batch->entries[j], &cover);
+
+			if (gdi_batch_rect_contains(&cover, &rect))
+			{
+				entry->skip = TRUE;
+				break;
+			}
+		}
+	}
+
+	for (i = 0; i < n; i++)
+	{
+		entry = &batch->entries[i];
+
+		if (entry->skip)
+			continue;
+
+		if ((last != NULL) && gdi_batch_merge_opaque_rect(last, entry))
+		{
+			entry->skip = TRUE;
+			continue;
+		}
+
+		last = entry;
+	}
+
+	for (i = 0; i < n; i++)
+	{
+		entry = &batch->entries[i];
+
+		if (entry->skip)
+			continue;
+
+		if (entry->bounded)
+		{
+			if (!bounded || (memcmp(&bounds, &entry->bounds, sizeof(rdpBounds)) != 0))
+			{
+				memcpy(&bounds, &entry->bounds, sizeof(rdpBounds));
+				gdi_set_bounds(context, &bounds);
+				bounded = TRUE;
+			}
+		}
+		else if (bounded)
+		{
+			gdi_set_bounds(context, NULL);
+			bounded = FALSE;
+		}
+
+		switch (entry->orderType)
+		{
+			case ORDER_BATCH_DSTBLT:
+				gdi_dstblt(context, &entry->order.dstblt);
+				break;
+
+			case ORDER_BATCH_PATBLT:
+				IFCALL(primary->PatBlt, context, &entry->order.patblt);
+				break;
+
+			case ORDER_BATCH_SCRBLT:
+				gdi_scrblt(context, &entry->order.scrblt);
+				break;
+
+			case ORDER_BATCH_OPAQUE_RECT:
+				gdi_opaque_rect(context, &entry->order.opaque_rect);
+				break;
+
+			case ORDER_BATCH_LINE_TO:
+				gdi_line_to(context, &entry->order.line_to);
+				break;
+
+			case ORDER_BATCH_MEMBLT:
+				IFCALL(primary->MemBlt, context, &entry->order.memblt);
+				break;
+
+			case ORDER_BATCH_MEM3BLT:
+				IFCALL(primary->Mem3Blt, context, &entry->order.mem3blt);
+				break;
+
+			case ORDER_BATCH_GLYPH_INDEX:
+				IFCALL(primary->GlyphIndex, context, &entry->order.glyph_index);
+				break;
+		}
+	}
+
+	if (bounded)
+		gdi_set_bounds(context, NULL);
+}
+
 int tilenum = 0;
 
 void gdi_surface_bits(rdpContext* context, SURFACE_BITS_COMMAND* surface_bits_command)
 {
 	int i, j;
 	int tx, ty;
+	UINT64 start;
 	char* tile_bitmap;
 	RFX_MESSAGE* message;
 	rdpGdi* gdi = context->gdi;
@@ -705,6 +979,7 @@ void gdi_surface_bits(rdpContext* context, SURFACE_BITS_COMMAND* surface_bits_co
 		surface_bits_command->bitmapDataLength);
 
 	tile_bitmap = (char*) xzalloc(32);
+	start = metrics_start(context->metrics);
 
 	if (surface_bits_command->codecID == CODEC_ID_REMOTEFX)
 	{
@@ -739,6 +1014,8 @@ void gdi_surface_bits(rdpContext* context, SURFACE_BITS_COMMAND* surface_bits_co
 
 		gdi_SetNullClipRgn(gdi->primary->hdc);
 		rfx_message_free(rfx_context, message);
+
+		metrics_stop(context->metrics, METRICS_SURFACE_REMOTEFX, start);
 	}
 	else if (surface_bits_command->codecID == CODEC_ID_NSCODEC)
 	{
@@ -751,6 +1028,8 @@ void gdi_surface_bits(rdpContext* context, SURFACE_BITS_COMMAND* surface_bits_co
 		gdi->image->bitmap->data = (BYTE*) realloc(gdi->image->bitmap->data, gdi->image->bitmap->width * gdi->image->bitmap->height * 4);
 		freerdp_image_flip(nsc_context->bmpdata, gdi->image->bitmap->data, gdi->image->bitmap->width, gdi->image->bitmap->height, 32);
 		gdi_BitBlt(gdi->primary->hdc, surface_bits_command->destLeft, surface_bits_command->destTop, surface_bits_command->width, surface_bits_command->height, gdi->image->hdc, 0, 0, GDI_SRCCOPY);
+
+		metrics_stop(context->metrics, METRICS_SURFACE_NSCODEC, start);
 	} 
 	else if (surface_bits_command->codecID == CODEC_ID_NONE)
 	{
@@ -786,6 +1065,8 @@ void gdi_surface_bits(rdpContext* context, SURFACE_BITS_COMMAND* surface_bits_co
 
 		gdi_BitBlt(gdi->primary->hdc, surface_bits_command->destLeft, surface_bits_command->destTop,
 				surface_bits_command->width, surface_bits_command->height, gdi->image->hdc, 0, 0, GDI_SRCCOPY);
+
+		metrics_stop(context->metrics, METRICS_SURFACE_UNCOMPRESSED, start);
 	}
 	else
 	{
@@ -831,6 +1112,7 @@ void gdi_register_update_callbacks(rdpUpdate* update)
 	primary->PolygonCB = gdi_polygon_cb;
 	primary->EllipseSC = gdi_ellipse_sc;
 	primary->EllipseCB = gdi_ellipse_cb;
+	primary->OrderBatch = gdi_order_batch;
 
 	update->SurfaceBits = gdi_surface_bits;
 }
@@ -964,6 +1246,8 @@ int gdi_init(freerdp* instance, UINT32 flags, BYTE* buffer)
 	gdi->rfx_context = rfx_context_new();
 	gdi->nsc_context = nsc_context_new();
 
+	((RFX_CONTEXT*) gdi->rfx_context)->metrics = instance->context->metrics;
+
 	return 0;
 }
 
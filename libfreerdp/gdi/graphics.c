@@ -104,7 +104,9 @@ void gdi_Bitmap_Decompress(rdpContext* context, rdpBitmap* bitmap,
 	int xindex;
 	rdpGdi* gdi;
 	BOOL status;
+	UINT64 start;
 
+	start = metrics_start(context->metrics);
 	size = width * height * (bpp + 7) / 8;
 
 	if (bitmap->data == NULL)
@@ -172,6 +174,8 @@ void gdi_Bitmap_Decompress(rdpContext* context, rdpBitmap* bitmap,
 	bitmap->compressed = FALSE;
 	bitmap->length = size;
 	bitmap->bpp = bpp;
+
+	metrics_stop(context->metrics, METRICS_BITMAP_DECOMPRESS, start);
 }
 
 void gdi_Bitmap_SetSurface(rdpContext* context, rdpBitmap* bitmap, BOOL primary)
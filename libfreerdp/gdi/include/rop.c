@@ -0,0 +1,132 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * GDI Raster Operation Kernels
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* do not include this file directly! */
+
+/**
+ * Raster operations are bitwise, so a kernel computes D = f(D, S, P) over a
+ * row of bytes regardless of the color depth. The including file provides
+ * the vector type and operations:
+ *
+ * ROP_VECTOR, ROP_VECTOR_SIZE: vector type and its size in bytes
+ * ROP_LOAD(p), ROP_STORE(p, v): unaligned load and store
+ * ROP_AND(a, b), ROP_OR(a, b), ROP_XOR(a, b), ROP_NOT(a)
+ * ROP_ANDNOT(a, b): ~a & b
+ * ROP_KERNEL(name): name of the kernel function
+ * ROP_INIT: name of the function filling in a kernel table
+ *
+ * The bytes left over after the last full vector go through a vector sized
+ * buffer, operands a kernel does not use point to the destination row.
+ */
+
+#define ROP_INDEX_NOTSRCCOPY		0
+#define ROP_INDEX_DSTINVERT		1
+#define ROP_INDEX_SRCERASE		2
+#define ROP_INDEX_NOTSRCERASE		3
+#define ROP_INDEX_SRCINVERT		4
+#define ROP_INDEX_SRCAND		5
+#define ROP_INDEX_SRCPAINT		6
+#define ROP_INDEX_DSPDxax		7
+#define ROP_INDEX_PSDPxax		8
+#define ROP_INDEX_SPna			9
+#define ROP_INDEX_DSna			10
+#define ROP_INDEX_DPa			11
+#define ROP_INDEX_PDxn			12
+#define ROP_INDEX_MERGECOPY		13
+#define ROP_INDEX_MERGEPAINT		14
+#define ROP_INDEX_PATCOPY		15
+#define ROP_INDEX_PATINVERT		16
+#define ROP_INDEX_PATPAINT		17
+#define ROP_KERNEL_COUNT		18
+
+#define D	ROP_LOAD(&dstp[i])
+#define S	ROP_LOAD(&srcp[i])
+#define P	ROP_LOAD(&patp[i])
+
+#define ROP_ROW(_name, _op) \
+static void ROP_KERNEL(_name)(BYTE* dstp, BYTE* srcp, BYTE* patp, int length) \
+{ \
+	int i, n; \
+	BYTE* tail; \
+	BYTE d[ROP_VECTOR_SIZE]; \
+	BYTE s[ROP_VECTOR_SIZE]; \
+	BYTE p[ROP_VECTOR_SIZE]; \
+\
+	for (i = 0; i + ROP_VECTOR_SIZE <= length; i += ROP_VECTOR_SIZE) \
+		ROP_STORE(&dstp[i], _op); \
+\
+	if (i < length) \
+	{ \
+		n = length - i; \
+		tail = &dstp[i]; \
+		memcpy(d, tail, n); \
+		memcpy(s, &srcp[i], n); \
+		memcpy(p, &patp[i], n); \
+		dstp = d; \
+		srcp = s; \
+		patp = p; \
+		i = 0; \
+		ROP_STORE(&dstp[i], _op); \
+		memcpy(tail, d, n); \
+	} \
+}
+
+ROP_ROW(NOTSRCCOPY, ROP_NOT(S))
+ROP_ROW(DSTINVERT, ROP_NOT(D))
+ROP_ROW(SRCERASE, ROP_ANDNOT(D, S))
+ROP_ROW(NOTSRCERASE, ROP_NOT(ROP_OR(S, D)))
+ROP_ROW(SRCINVERT, ROP_XOR(S, D))
+ROP_ROW(SRCAND, ROP_AND(S, D))
+ROP_ROW(SRCPAINT, ROP_OR(S, D))
+ROP_ROW(DSPDxax, ROP_OR(ROP_AND(S, P), ROP_ANDNOT(S, D)))
+ROP_ROW(PSDPxax, ROP_OR(ROP_AND(S, D), ROP_ANDNOT(S, P)))
+ROP_ROW(SPna, ROP_ANDNOT(P, S))
+ROP_ROW(DSna, ROP_ANDNOT(S, D))
+ROP_ROW(DPa, ROP_AND(D, P))
+ROP_ROW(PDxn, ROP_NOT(ROP_XOR(D, P)))
+ROP_ROW(MERGECOPY, ROP_AND(S, P))
+ROP_ROW(MERGEPAINT, ROP_OR(ROP_NOT(S), D))
+ROP_ROW(PATCOPY, P)
+ROP_ROW(PATINVERT, ROP_XOR(P, D))
+ROP_ROW(PATPAINT, ROP_OR(D, ROP_OR(P, ROP_NOT(S))))
+
+void ROP_INIT(pRopRow* rows)
+{
+	rows[ROP_INDEX_NOTSRCCOPY] = ROP_KERNEL(NOTSRCCOPY);
+	rows[ROP_INDEX_DSTINVERT] = ROP_KERNEL(DSTINVERT);
+	rows[ROP_INDEX_SRCERASE] = ROP_KERNEL(SRCERASE);
+	rows[ROP_INDEX_NOTSRCERASE] = ROP_KERNEL(NOTSRCERASE);
+	rows[ROP_INDEX_SRCINVERT] = ROP_KERNEL(SRCINVERT);
+	rows[ROP_INDEX_SRCAND] = ROP_KERNEL(SRCAND);
+	rows[ROP_INDEX_SRCPAINT] = ROP_KERNEL(SRCPAINT);
+	rows[ROP_INDEX_DSPDxax] = ROP_KERNEL(DSPDxax);
+	rows[ROP_INDEX_PSDPxax] = ROP_KERNEL(PSDPxax);
+	rows[ROP_INDEX_SPna] = ROP_KERNEL(SPna);
+	rows[ROP_INDEX_DSna] = ROP_KERNEL(DSna);
+	rows[ROP_INDEX_DPa] = ROP_KERNEL(DPa);
+	rows[ROP_INDEX_PDxn] = ROP_KERNEL(PDxn);
+	rows[ROP_INDEX_MERGECOPY] = ROP_KERNEL(MERGECOPY);
+	rows[ROP_INDEX_MERGEPAINT] = ROP_KERNEL(MERGEPAINT);
+	rows[ROP_INDEX_PATCOPY] = ROP_KERNEL(PATCOPY);
+	rows[ROP_INDEX_PATINVERT] = ROP_KERNEL(PATINVERT);
+	rows[ROP_INDEX_PATPAINT] = ROP_KERNEL(PATPAINT);
+}
+
+#undef ROP_ROW
+#undef D
+#undef S
+#undef P
@@ -0,0 +1,388 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * GDI Raster Operation Engine
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <freerdp/api.h>
+#include <freerdp/freerdp.h>
+#include <freerdp/constants.h>
+#include <freerdp/gdi/gdi.h>
+#include <freerdp/gdi/region.h>
+
+#include <freerdp/gdi/rop.h>
+
+#ifdef WITH_SSE2
+#include "rop_sse2.h"
+#endif
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+
+#define ROP_VECTOR			uint8x16_t
+#define ROP_VECTOR_SIZE			16
+#define ROP_LOAD(_p)			vld1q_u8(_p)
+#define ROP_STORE(_p, _v)		vst1q_u8(_p, _v)
+#define ROP_AND(_a, _b)			vandq_u8(_a, _b)
+#define ROP_OR(_a, _b)			vorrq_u8(_a, _b)
+#define ROP_XOR(_a, _b)			veorq_u8(_a, _b)
+#define ROP_NOT(_a)			vmvnq_u8(_a)
+#define ROP_ANDNOT(_a, _b)		vbicq_u8(_b, _a)
+#else
+static INLINE UINT32 gdi_rop_load(BYTE* p)
+{
+	UINT32 v;
+	memcpy(&v, p, sizeof(UINT32));
+	return v;
+}
+
+static INLINE void gdi_rop_store(BYTE* p, UINT32 v)
+{
+	memcpy(p, &v, sizeof(UINT32));
+}
+
+#define ROP_VECTOR			UINT32
+#define ROP_VECTOR_SIZE			4
+#define ROP_LOAD(_p)			gdi_rop_load(_p)
+#define ROP_STORE(_p, _v)		gdi_rop_store(_p, _v)
+#define ROP_AND(_a, _b)			((_a) & (_b))
+#define ROP_OR(_a, _b)			((_a) | (_b))
+#define ROP_XOR(_a, _b)			((_a) ^ (_b))
+#define ROP_NOT(_a)			(~(_a))
+#define ROP_ANDNOT(_a, _b)		(~(_a) & (_b))
+#endif
+
+#define ROP_KERNEL(_name)		gdi_rop_##_name
+#define ROP_INIT			gdi_rop_init
+#include "include/rop.c"
+
+/**
+ * Rows of up to this many bytes of expanded pattern and source
+ * are kept on the stack, larger blits allocate them
+ */
+
+#define GDI_ROP_STACK_SIZE		4096
+
+static pRopRow gdi_rop_rows[ROP_KERNEL_COUNT];
+static BOOL gdi_rop_initialized = FALSE;
+
+/**
+ * Select the kernels used by the raster operation engine. Until this is
+ * called, SSE2 kernels are used where the compiler targets SSE2 anyway.
+ * @param cpu_opt CPU optimization flags (CPU_SSE2)
+ */
+
+void gdi_rop_set_cpu_opt(UINT32 cpu_opt)
+{
+	gdi_rop_init(gdi_rop_rows);
+
+#ifdef WITH_SSE2
+	if (cpu_opt & CPU_SSE2)
+		gdi_rop_init_sse2(gdi_rop_rows);
+#endif
+
+	gdi_rop_initialized = TRUE;
+}
+
+pRopRow gdi_rop_get_row(int rop)
+{
+	if (!gdi_rop_initialized)
+	{
+#if defined(__SSE2__) || defined(_M_X64)
+		gdi_rop_set_cpu_opt(CPU_SSE2);
+#else
+		gdi_rop_set_cpu_opt(0);
+#endif
+	}
+
+	switch (rop)
+	{
+		case GDI_NOTSRCCOPY:
+			return gdi_rop_rows[ROP_INDEX_NOTSRCCOPY];
+
+		case GDI_DSTINVERT:
+			return gdi_rop_rows[ROP_INDEX_DSTINVERT];
+
+		case GDI_SRCERASE:
+			return gdi_rop_rows[ROP_INDEX_SRCERASE];
+
+		case GDI_NOTSRCERASE:
+			return gdi_rop_rows[ROP_INDEX_NOTSRCERASE];
+
+		case GDI_SRCINVERT:
+			return gdi_rop_rows[ROP_INDEX_SRCINVERT];
+
+		case GDI_SRCAND:
+			return gdi_rop_rows[ROP_INDEX_SRCAND];
+
+		case GDI_SRCPAINT:
+			return gdi_rop_rows[ROP_INDEX_SRCPAINT];
+
+		case GDI_DSPDxax:
+			return gdi_rop_rows[ROP_INDEX_DSPDxax];
+
+		case GDI_PSDPxax:
+			return gdi_rop_rows[ROP_INDEX_PSDPxax];
+
+		case GDI_SPna:
+			return gdi_rop_rows[ROP_INDEX_SPna];
+
+		case GDI_DSna:
+			return gdi_rop_rows[ROP_INDEX_DSna];
+
+		case GDI_DPa:
+			return gdi_rop_rows[ROP_INDEX_DPa];
+
+		case GDI_PDxn:
+			return gdi_rop_rows[ROP_INDEX_PDxn];
+
+		case GDI_MERGECOPY:
+			return gdi_rop_rows[ROP_INDEX_MERGECOPY];
+
+		case GDI_MERGEPAINT:
+			return gdi_rop_rows[ROP_INDEX_MERGEPAINT];
+
+		case GDI_PATCOPY:
+			return gdi_rop_rows[ROP_INDEX_PATCOPY];
+
+		case GDI_PATINVERT:
+			return gdi_rop_rows[ROP_INDEX_PATINVERT];
+
+		case GDI_PATPAINT:
+			return gdi_rop_rows[ROP_INDEX_PATPAINT];
+
+		default:
+			break;
+	}
+
+	return NULL;
+}
+
+/**
+ * Repeat the first period bytes of a row over the whole row.
+ */
+
+static void gdi_rop_repeat(BYTE* row, int period, int length)
+{
+	int n;
+
+	for (n = period; n < length; n *= 2)
+		memcpy(&row[n], row, MIN(n, length - n));
+}
+
+static void gdi_rop_expand_pattern(BYTE* row, HGDI_BITMAP hBmpBrush, int y, int bpp, int length)
+{
+	int x;
+	int width;
+	BYTE* patp;
+
+	width = MIN(hBmpBrush->width, length / bpp);
+	patp = hBmpBrush->data + (y * hBmpBrush->scanline);
+
+	for (x = 0; x < width; x++)
+		memcpy(&row[x * bpp], &patp[x * hBmpBrush->bytesPerPixel], bpp);
+
+	gdi_rop_repeat(row, width * bpp, length);
+}
+
+static void gdi_rop_expand_mono(BYTE* row, BYTE* srcp, int bpp, int width)
+{
+	int x;
+	UINT16 v16;
+	UINT32 v32;
+
+	if (bpp == 4)
+	{
+		for (x = 0; x < width; x++)
+		{
+			v32 = srcp[x] * 0x01010101;
+			memcpy(&row[x * 4], &v32, 4);
+		}
+	}
+	else if (bpp == 2)
+	{
+		for (x = 0; x < width; x++)
+		{
+			v16 = srcp[x] * 0x0101;
+			memcpy(&row[x * 2], &v16, 2);
+		}
+	}
+	else
+	{
+		for (x = 0; x < width; x++)
+			memset(&row[x * bpp], srcp[x], bpp);
+	}
+}
+
+/**
+ * Perform a ternary raster operation on a clipped rectangle. The pattern is
+ * a solid color when one is given, the brush pattern of the destination
+ * otherwise. Pattern rows are expanded once per blit, a 1bpp source is
+ * expanded to the destination depth row by row, as glyphs drawn with DSPDxax.
+ * Overlapping blits within a bitmap behave as if the source was copied first.
+ * @param hdcDest destination device context
+ * @param nXDest destination x1
+ * @param nYDest destination y1
+ * @param nWidth width
+ * @param nHeight height
+ * @param hdcSrc source device context
+ * @param nXSrc source x1
+ * @param nYSrc source y1
+ * @param rop raster operation code
+ * @param color solid pattern color in the destination format, or NULL
+ * @return 0 on success, 1 for an unsupported raster operation
+ */
+
+int gdi_rop_blt(HGDI_DC hdcDest, int nXDest, int nYDest, int nWidth, int nHeight,
+		HGDI_DC hdcSrc, int nXSrc, int nYSrc, int rop, BYTE* color)
+{
+	int i, y;
+	int bpp;
+	int size;
+	int length;
+	int patRows;
+	BYTE* srcp;
+	BYTE* dstp;
+	BYTE* patp;
+	BYTE* buffer;
+	BYTE* srcRow;
+	BYTE* patRow;
+	BOOL bottomUp;
+	BOOL useSrc, usePat;
+	BOOL expandSrc, copySrc;
+	HGDI_BITMAP hBmpBrush;
+	pRopRow row;
+	BYTE stack[GDI_ROP_STACK_SIZE];
+
+	row = gdi_rop_get_row(rop);
+
+	if (row == NULL)
+		return 1;
+
+	useSrc = GDI_ROP_USES_SRC(rop);
+	usePat = GDI_ROP_USES_PAT(rop);
+
+	if (useSrc && (hdcSrc == NULL))
+		return 1;
+
+	if ((nWidth <= 0) || (nHeight <= 0))
+		return 0;
+
+	bpp = hdcDest->bytesPerPixel;
+	length = nWidth * bpp;
+
+	patRows = 0;
+	hBmpBrush = NULL;
+
+	if (usePat)
+	{
+		if ((color == NULL) && (hdcDest->brush != NULL) && (hdcDest->brush->style == GDI_BS_PATTERN))
+		{
+			hBmpBrush = hdcDest->brush->pattern;
+			patRows = hBmpBrush->height;
+		}
+		else
+		{
+			if (color == NULL)
+				color = (BYTE*) &hdcDest->textColor;
+
+			patRows = 1;
+		}
+	}
+
+	bottomUp = FALSE;
+	expandSrc = copySrc = FALSE;
+
+	if (useSrc)
+	{
+		if ((hdcSrc->bytesPerPixel == 1) && (bpp > 1))
+		{
+			expandSrc = TRUE;
+		}
+		else if ((hdcSrc->selectedObject == hdcDest->selectedObject) &&
+				gdi_CopyOverlap(nXDest, nYDest, nWidth, nHeight, nXSrc, nYSrc))
+		{
+			bottomUp = (nYSrc < nYDest) ? TRUE : FALSE;
+			copySrc = (nYSrc == nYDest) ? TRUE : FALSE;
+		}
+	}
+
+	size = (patRows + ((expandSrc || copySrc) ? 1 : 0)) * length;
+	buffer = (size > GDI_ROP_STACK_SIZE) ? (BYTE*) malloc(size) : stack;
+
+	if (buffer == NULL)
+		return 1;
+
+	patRow = buffer;
+	srcRow = &buffer[patRows * length];
+
+	if (hBmpBrush != NULL)
+	{
+		for (y = 0; y < patRows; y++)
+			gdi_rop_expand_pattern(&patRow[y * length], hBmpBrush, y, bpp, length);
+	}
+	else if (usePat)
+	{
+		memcpy(patRow, color, bpp);
+		gdi_rop_repeat(patRow, bpp, length);
+	}
+
+	for (i = 0; i < nHeight; i++)
+	{
+		y = bottomUp ? (nHeight - 1 - i) : i;
+		dstp = gdi_get_bitmap_pointer(hdcDest, nXDest, nYDest + y);
+
+		if (dstp == NULL)
+			continue;
+
+		srcp = patp = dstp;
+
+		if (useSrc)
+		{
+			srcp = gdi_get_bitmap_pointer(hdcSrc, nXSrc, nYSrc + y);
+
+			if (srcp == NULL)
+				continue;
+
+			if (expandSrc)
+			{
+				gdi_rop_expand_mono(srcRow, srcp, bpp, nWidth);
+				srcp = srcRow;
+			}
+			else if (copySrc)
+			{
+				memcpy(srcRow, srcp, length);
+				srcp = srcRow;
+			}
+		}
+
+		if (usePat)
+			patp = &patRow[(y % patRows) * length];
+
+		row(dstp, srcp, patp, length);
+	}
+
+	if (buffer != stack)
+		free(buffer);
+
+	return 0;
+}
@@ -0,0 +1,42 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * GDI Raster Operation Engine - SSE2 Optimizations
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <emmintrin.h>
+
+#include "rop_sse2.h"
+
+#define ROP_VECTOR			__m128i
+#define ROP_VECTOR_SIZE			16
+#define ROP_LOAD(_p)			_mm_loadu_si128((__m128i*) (_p))
+#define ROP_STORE(_p, _v)		_mm_storeu_si128((__m128i*) (_p), _v)
+#define ROP_AND(_a, _b)			_mm_and_si128(_a, _b)
+#define ROP_OR(_a, _b)			_mm_or_si128(_a, _b)
+#define ROP_XOR(_a, _b)			_mm_xor_si128(_a, _b)
+#define ROP_NOT(_a)			_mm_xor_si128(_a, _mm_set1_epi32(-1))
+#define ROP_ANDNOT(_a, _b)		_mm_andnot_si128(_a, _b)
+
+#define ROP_KERNEL(_name)		gdi_rop_##_name##_sse2
+#define ROP_INIT			gdi_rop_init_sse2
+#include "include/rop.c"
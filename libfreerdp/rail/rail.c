@@ -85,17 +85,20 @@ static void rail_WindowCachedIcon(rdpContext* context, WINDOW_ORDER_INFO* orderI
 
 static void rail_NotifyIconCreate(rdpContext* context, WINDOW_ORDER_INFO* orderInfo, NOTIFY_ICON_STATE_ORDER* notify_icon_state)
 {
-
+	rdpRail* rail = context->rail;
+	window_list_notify_icon_create(rail->list, orderInfo, notify_icon_state);
 }
 
 static void rail_NotifyIconUpdate(rdpContext* context, WINDOW_ORDER_INFO* orderInfo, NOTIFY_ICON_STATE_ORDER* notify_icon_state)
 {
-
+	rdpRail* rail = context->rail;
+	window_list_notify_icon_update(rail->list, orderInfo, notify_icon_state);
 }
 
 static void rail_NotifyIconDelete(rdpContext* context, WINDOW_ORDER_INFO* orderInfo)
 {
-
+	rdpRail* rail = context->rail;
+	window_list_notify_icon_delete(rail->list, orderInfo);
 }
 
 static void rail_MonitoredDesktop(rdpContext* context, WINDOW_ORDER_INFO* orderInfo, MONITORED_DESKTOP_ORDER* monitored_desktop)
@@ -21,6 +21,8 @@
 #include "config.h"
 #endif
 
+#include <string.h>
+
 #include <freerdp/utils/stream.h>
 #include <freerdp/utils/memory.h>
 
@@ -57,21 +59,137 @@ rdpWindow* window_list_get_next(rdpWindowList* list)
 	return next;
 }
 
-rdpWindow* window_list_get_by_extra_id(rdpWindowList* list, void* extraId)
+#define WINDOW_LIST_MIN_BUCKETS		64
+
+static UINT32 window_list_hash(UINT32 key)
+{
+	UINT32 hash = key * 0x9E3779B1;
+	return hash ^ (hash >> 16);
+}
+
+static UINT32 window_list_hash_extra_id(void* extraId)
+{
+	UINT64 key = (UINT64) (size_t) extraId;
+	return window_list_hash((UINT32) (key ^ (key >> 32)));
+}
+
+static UINT32 window_list_hash_notify_icon(UINT32 windowId, UINT32 notifyIconId)
+{
+	return window_list_hash(windowId ^ window_list_hash(notifyIconId));
+}
+
+static void window_list_link_id(rdpWindowList* list, rdpWindow* window)
+{
+	rdpWindow** bucket;
+
+	bucket = &list->idBuckets[window_list_hash(window->windowId) & list->mask];
+	window->idChain = *bucket;
+	*bucket = window;
+}
+
+static void window_list_link_extra_id(rdpWindowList* list, rdpWindow* window)
+{
+	rdpWindow** bucket;
+
+	bucket = &list->extraIdBuckets[window_list_hash_extra_id(window->extraIdKey) & list->mask];
+	window->extraIdChain = *bucket;
+	*bucket = window;
+}
+
+static void window_list_unlink_id(rdpWindowList* list, rdpWindow* window)
+{
+	rdpWindow** link;
+
+	link = &list->idBuckets[window_list_hash(window->windowId) & list->mask];
+
+	while (*link != window)
+		link = &(*link)->idChain;
+
+	*link = window->idChain;
+}
+
+static void window_list_unlink_extra_id(rdpWindowList* list, rdpWindow* window)
+{
+	rdpWindow** link;
+
+	if (window->extraIdKey == NULL)
+		return;
+
+	link = &list->extraIdBuckets[window_list_hash_extra_id(window->extraIdKey) & list->mask];
+
+	while (*link != window)
+		link = &(*link)->extraIdChain;
+
+	*link = window->extraIdChain;
+	window->extraIdKey = NULL;
+}
+
+/**
+ * The client sets the extraId of a window when it creates its own window,
+ * index it again if it changed since the window was last indexed.
+ */
+
+static void window_list_update_extra_id(rdpWindowList* list, rdpWindow* window)
+{
+	if (window->extraId == window->extraIdKey)
+		return;
+
+	window_list_unlink_extra_id(list, window);
+	window->extraIdKey = window->extraId;
+
+	if (window->extraIdKey != NULL)
+		window_list_link_extra_id(list, window);
+}
+
+static BOOL window_list_resize(rdpWindowList* list, UINT32 size)
 {
 	rdpWindow* window;
+	rdpWindow** idBuckets;
+	rdpWindow** extraIdBuckets;
 
-	window = list->head;
+	idBuckets = (rdpWindow**) xzalloc(sizeof(rdpWindow*) * size);
+	extraIdBuckets = (rdpWindow**) xzalloc(sizeof(rdpWindow*) * size);
 
-	if (window == NULL)
+	if ((idBuckets == NULL) || (extraIdBuckets == NULL))
+	{
+		free(idBuckets);
+		free(extraIdBuckets);
+		return FALSE;
+	}
+
+	free(list->idBuckets);
+	free(list->extraIdBuckets);
+
+	list->idBuckets = idBuckets;
+	list->extraIdBuckets = extraIdBuckets;
+	list->mask = size - 1;
+
+	for (window = list->head; window != NULL; window = window->next)
+	{
+		window_list_link_id(list, window);
+
+		if (window->extraIdKey != NULL)
+			window_list_link_extra_id(list, window);
+	}
+
+	return TRUE;
+}
+
+rdpWindow* window_list_get_by_extra_id(rdpWindowList* list, void* extraId)
+{
+	rdpWindow* window;
+
+	if (extraId == NULL)
 		return NULL;
 
+	window = list->extraIdBuckets[window_list_hash_extra_id(extraId) & list->mask];
+
 	while (window != NULL)
 	{
-		if (window->extraId == extraId)
+		if (window->extraIdKey == extraId)
 			return window;
 
-		window = window->next;
+		window = window->extraIdChain;
 	}
 
 	return NULL;
@@ -81,17 +199,14 @@ rdpWindow* window_list_get_by_id(rdpWindowList* list, UINT32 windowId)
 {
 	rdpWindow* window;
 
-	window = list->head;
-
-	if (window == NULL)
-		return NULL;
+	window = list->idBuckets[window_list_hash(windowId) & list->mask];
 
 	while (window != NULL)
 	{
 		if (window->windowId == windowId)
 			return window;
 
-		window = window->next;
+		window = window->idChain;
 	}
 
 	return NULL;
@@ -103,14 +218,17 @@ void window_list_create(rdpWindowList* list, WINDOW_ORDER_INFO* orderInfo, WINDO
 
 	/* See if the window already exists */
 	window = window_list_get_by_id(list, orderInfo->windowId);
-	 
-        /* If the window already exists, just update the existing window */
+
+	/* If the window already exists, just update the existing window */
 	if (window != NULL)
 	{
-	        window_list_update(list, orderInfo, window_state);
-	        return;
+		window_list_update(list, orderInfo, window_state);
+		return;
 	}
 
+	if (list->count > list->mask)
+		window_list_resize(list, (list->mask + 1) * 2);
+
 	window = (rdpWindow*) xzalloc(sizeof(rdpWindow));
 
 	if (window == NULL)
@@ -132,11 +250,14 @@ void window_list_create(rdpWindowList* list, WINDOW_ORDER_INFO* orderInfo, WINDO
 		list->tail = window;
 	}
 
-	window->windowId = orderInfo->windowId;
+	window_list_link_id(list, window);
+	list->count++;
 
 	window_state_update(window, orderInfo, window_state);
 
 	rail_CreateWindow(list->rail, window);
+
+	window_list_update_extra_id(list, window);
 }
 
 void window_list_update(rdpWindowList* list, WINDOW_ORDER_INFO* orderInfo, WINDOW_STATE_ORDER* window_state)
@@ -151,6 +272,8 @@ void window_list_update(rdpWindowList* list, WINDOW_ORDER_INFO* orderInfo, WINDO
 	window_state_update(window, orderInfo, window_state);
 
 	rail_UpdateWindow(list->rail, window);
+
+	window_list_update_extra_id(list, window);
 }
 
 void window_list_delete(rdpWindowList* list, WINDOW_ORDER_INFO* orderInfo)
@@ -164,6 +287,10 @@ void window_list_delete(rdpWindowList* list, WINDOW_ORDER_INFO* orderInfo)
 	if (window == NULL)
 		return;
 
+	window_list_unlink_id(list, window);
+	window_list_unlink_extra_id(list, window);
+	list->count--;
+
 	prev = window->prev;
 	next = window->next;
 
@@ -186,21 +313,183 @@ void window_list_delete(rdpWindowList* list, WINDOW_ORDER_INFO* orderInfo)
 			list->tail = prev;
 	}
 
+	if (list->iterator == window)
+		list->iterator = next;
+
 	rail_DestroyWindow(list->rail, window);
 }
 
+static void window_list_clear_notify_icons(rdpWindowList* list)
+{
+	rdpNotifyIcon* icon;
+
+	while (list->iconHead != NULL)
+	{
+		icon = list->iconHead;
+		list->iconHead = icon->next;
+		free(icon);
+	}
+
+	list->iconTail = NULL;
+	list->iconCount = 0;
+}
+
 void window_list_clear(rdpWindowList* list)
 {
-       rdpWindow* current = list->head;
+	rdpWindow* current = list->head;
+
+	while (current != NULL)
+	{
+		list->head = current->next;
+		rail_DestroyWindow(list->rail, current);
+		current = list->head;
+	}
+
+	list->tail = NULL;
+	list->iterator = NULL;
+	list->count = 0;
+
+	memset(list->idBuckets, 0, sizeof(rdpWindow*) * (list->mask + 1));
+	memset(list->extraIdBuckets, 0, sizeof(rdpWindow*) * (list->mask + 1));
+
+	window_list_clear_notify_icons(list);
+	memset(list->iconBuckets, 0, sizeof(rdpNotifyIcon*) * (list->iconMask + 1));
+}
+
+static BOOL window_list_resize_notify_icons(rdpWindowList* list, UINT32 size)
+{
+	rdpNotifyIcon* icon;
+	rdpNotifyIcon** bucket;
+	rdpNotifyIcon** iconBuckets;
+
+	iconBuckets = (rdpNotifyIcon**) xzalloc(sizeof(rdpNotifyIcon*) * size);
+
+	if (iconBuckets == NULL)
+		return FALSE;
+
+	free(list->iconBuckets);
+	list->iconBuckets = iconBuckets;
+	list->iconMask = size - 1;
+
+	for (icon = list->iconHead; icon != NULL; icon = icon->next)
+	{
+		bucket = &list->iconBuckets[window_list_hash_notify_icon(icon->windowId, icon->notifyIconId) & list->iconMask];
+		icon->chain = *bucket;
+		*bucket = icon;
+	}
+
+	return TRUE;
+}
+
+rdpNotifyIcon* window_list_get_notify_icon(rdpWindowList* list, UINT32 windowId, UINT32 notifyIconId)
+{
+	rdpNotifyIcon* icon;
+
+	icon = list->iconBuckets[window_list_hash_notify_icon(windowId, notifyIconId) & list->iconMask];
+
+	while (icon != NULL)
+	{
+		if ((icon->windowId == windowId) && (icon->notifyIconId == notifyIconId))
+			return icon;
+
+		icon = icon->chain;
+	}
+
+	return NULL;
+}
+
+static void window_list_notify_icon_state(rdpNotifyIcon* icon, WINDOW_ORDER_INFO* orderInfo, NOTIFY_ICON_STATE_ORDER* notify_icon_state)
+{
+	if (orderInfo->fieldFlags & WINDOW_ORDER_FIELD_NOTIFY_VERSION)
+		icon->version = notify_icon_state->version;
+
+	if (orderInfo->fieldFlags & WINDOW_ORDER_FIELD_NOTIFY_STATE)
+		icon->state = notify_icon_state->state;
+}
+
+void window_list_notify_icon_create(rdpWindowList* list, WINDOW_ORDER_INFO* orderInfo, NOTIFY_ICON_STATE_ORDER* notify_icon_state)
+{
+	rdpNotifyIcon* icon;
+	rdpNotifyIcon** bucket;
+
+	icon = window_list_get_notify_icon(list, orderInfo->windowId, orderInfo->notifyIconId);
+
+	if (icon != NULL)
+	{
+		window_list_notify_icon_state(icon, orderInfo, notify_icon_state);
+		return;
+	}
+
+	if (list->iconCount > list->iconMask)
+		window_list_resize_notify_icons(list, (list->iconMask + 1) * 2);
+
+	icon = (rdpNotifyIcon*) xzalloc(sizeof(rdpNotifyIcon));
+
+	if (icon == NULL)
+		return;
+
+	icon->windowId = orderInfo->windowId;
+	icon->notifyIconId = orderInfo->notifyIconId;
+
+	icon->prev = list->iconTail;
+	icon->next = NULL;
+
+	if (list->iconTail != NULL)
+		list->iconTail->next = icon;
+	else
+		list->iconHead = icon;
+
+	list->iconTail = icon;
+
+	bucket = &list->iconBuckets[window_list_hash_notify_icon(icon->windowId, icon->notifyIconId) & list->iconMask];
+	icon->chain = *bucket;
+	*bucket = icon;
+	list->iconCount++;
+
+	window_list_notify_icon_state(icon, orderInfo, notify_icon_state);
+}
+
+void window_list_notify_icon_update(rdpWindowList* list, WINDOW_ORDER_INFO* orderInfo, NOTIFY_ICON_STATE_ORDER* notify_icon_state)
+{
+	rdpNotifyIcon* icon;
+
+	icon = window_list_get_notify_icon(list, orderInfo->windowId, orderInfo->notifyIconId);
 
-       while (current != NULL)
-       {
-               list->head = current->next;
-               rail_DestroyWindow(list->rail, current);
-               current = list->head;
-       }       
-       
-       list->tail = NULL;
+	if (icon == NULL)
+		return;
+
+	window_list_notify_icon_state(icon, orderInfo, notify_icon_state);
+}
+
+void window_list_notify_icon_delete(rdpWindowList* list, WINDOW_ORDER_INFO* orderInfo)
+{
+	rdpNotifyIcon* icon;
+	rdpNotifyIcon** link;
+
+	icon = window_list_get_notify_icon(list, orderInfo->windowId, orderInfo->notifyIconId);
+
+	if (icon == NULL)
+		return;
+
+	link = &list->iconBuckets[window_list_hash_notify_icon(icon->windowId, icon->notifyIconId) & list->iconMask];
+
+	while (*link != icon)
+		link = &(*link)->chain;
+
+	*link = icon->chain;
+	list->iconCount--;
+
+	if (icon->prev != NULL)
+		icon->prev->next = icon->next;
+	else
+		list->iconHead = icon->next;
+
+	if (icon->next != NULL)
+		icon->next->prev = icon->prev;
+	else
+		list->iconTail = icon->prev;
+
+	free(icon);
 }
 
 rdpWindowList* window_list_new(rdpRail* rail)
@@ -214,6 +503,9 @@ rdpWindowList* window_list_new(rdpRail* rail)
 		list->head = NULL;
 		list->tail = NULL;
 		list->rail = rail;
+
+		window_list_resize(list, WINDOW_LIST_MIN_BUCKETS);
+		window_list_resize_notify_icons(list, WINDOW_LIST_MIN_BUCKETS);
 	}
 
 	return list;
@@ -223,6 +515,11 @@ void window_list_free(rdpWindowList* list)
 {
 	if (list != NULL)
 	{
+		window_list_clear_notify_icons(list);
+
+		free(list->idBuckets);
+		free(list->extraIdBuckets);
+		free(list->iconBuckets);
 		free(list);
 	}
 }
@@ -153,11 +153,14 @@ int freerdp_parse_args(rdpSettings* settings, int argc, char** argv,
 				"  --no-osb: disable offscreen bitmaps\n"
 				"  --no-bmp-cache: disable bitmap cache\n"
 				"  --bcv3: codec for bitmap cache v3 (rfx, nsc, jpeg)\n"
+				"  --persist-cache: keep the bitmap cache across sessions\n"
+				"  --persist-cache-file: bitmap cache file, default is bmpcache.bin in the config directory\n"
 				"  --plugin: load a virtual channel plugin\n"
 				"  --rfx: enable RemoteFX\n"
 				"  --rfx-mode: RemoteFX operational flags (v[ideo], i[mage]), default is video\n"
 				"  --frame-ack: number of frames pending to be acknowledged, default is 2 (disable with 0)\n"
 				"  --nsc: enable NSCodec (experimental)\n"
+				"  --dump-pdu: record received PDUs to a pcap file, to be replayed with freerdp-replay\n"
 #ifdef WITH_JPEG
 				"  --jpeg: enable jpeg codec, uses 75 quality\n"
 				"  --jpegex: enable jpeg and set quality(1..99)\n"
@@ -430,6 +433,22 @@ int freerdp_parse_args(rdpSettings* settings, int argc, char** argv,
 				return FREERDP_ARGS_PARSE_FAILURE;
 			}
 		}
+		else if (strcmp("--persist-cache", argv[index]) == 0)
+		{
+			settings->persistent_bitmap_cache = TRUE;
+		}
+		else if (strcmp("--persist-cache-file", argv[index]) == 0)
+		{
+			index++;
+			if (index == argc)
+			{
+				printf("missing cache file name\n");
+				return FREERDP_ARGS_PARSE_FAILURE;
+			}
+			free(settings->bitmap_cache_persist_file);
+			settings->bitmap_cache_persist_file = _strdup(argv[index]);
+			settings->persistent_bitmap_cache = TRUE;
+		}
 		else if (strcmp("--bcv3", argv[index]) == 0)
 		{
 			index++;
@@ -552,6 +571,17 @@ int freerdp_parse_args(rdpSettings* settings, int argc, char** argv,
 			settings->play_rfx_file = _strdup(argv[index]);
 			settings->play_rfx = TRUE;
 		}
+		else if (strcmp("--dump-pdu", argv[index]) == 0)
+		{
+			index++;
+			if (index == argc)
+			{
+				printf("missing file name\n");
+				return FREERDP_ARGS_PARSE_FAILURE;
+			}
+			settings->dump_pdu_file = _strdup(argv[index]);
+			settings->dump_pdu = TRUE;
+		}
 		else if (strcmp("--fonts", argv[index]) == 0)
 		{
 			settings->smooth_fonts = TRUE;
@@ -0,0 +1,961 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Incremental Clipboard Format Conversion
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include <winpr/crt.h>
+
+#include <freerdp/types.h>
+#include <freerdp/utils/stream.h>
+#include <freerdp/utils/memory.h>
+#include <freerdp/client/cliprdr.h>
+
+#include <freerdp/utils/clipboard.h>
+
+/* number of UTF-16 code units converted at once */
+#define CLIPBOARD_SLICE_LENGTH		4096
+
+#define CLIPBOARD_BMP_HEADER_LENGTH	14
+#define CLIPBOARD_DIB_HEADER_LENGTH	40
+#define CLIPBOARD_BI_BITFIELDS		3
+
+static const char clipboard_html_header[] =
+	"Version:0.9\r\n"
+	"StartHTML:0000000000\r\n"
+	"EndHTML:0000000000\r\n"
+	"StartFragment:0000000000\r\n"
+	"EndFragment:0000000000\r\n";
+
+#define CLIPBOARD_HTML_HEADER_LENGTH	(sizeof(clipboard_html_header) - 1)
+
+static BOOL clipboard_stream_reserve(CLIPBOARD_STREAM* stream, int length)
+{
+	int size;
+	BYTE* data;
+
+	if (stream->failed)
+		return FALSE;
+
+	if (length <= stream->size - stream->length)
+		return TRUE;
+
+	if (length > 0x7FFFFFFF - stream->length)
+	{
+		stream->failed = TRUE;
+		return FALSE;
+	}
+
+	size = (stream->size > 0) ? stream->size : 4096;
+
+	while (size - stream->length < length)
+		size = (size > 0x3FFFFFFF) ? stream->length + length : size * 2;
+
+	data = (BYTE*) realloc(stream->data, size);
+
+	if (data == NULL)
+	{
+		printf("clipboard_stream_reserve: failed to allocate %d bytes\n", size);
+		stream->failed = TRUE;
+		return FALSE;
+	}
+
+	stream->data = data;
+	stream->size = size;
+
+	return TRUE;
+}
+
+static void clipboard_stream_append(CLIPBOARD_STREAM* stream, const BYTE* data, int length)
+{
+	if ((length < 1) || !clipboard_stream_reserve(stream, length))
+		return;
+
+	memcpy(&stream->data[stream->length], data, length);
+	stream->length += length;
+}
+
+/**
+ * Line ending conversions. The state of the last byte is kept in the
+ * stream, so a CR/LF pair split between two chunks is handled correctly.
+ */
+
+static void clipboard_stream_lf2crlf(CLIPBOARD_STREAM* stream, BYTE* data, int size)
+{
+	int count;
+	BYTE* lf;
+	BYTE* out;
+	BYTE* end;
+	BYTE* next;
+
+	if (size < 1)
+		return;
+
+	count = 0;
+	end = data + size;
+
+	for (next = data; (lf = (BYTE*) memchr(next, '\n', end - next)) != NULL; next = lf + 1)
+	{
+		if ((lf == data) ? !stream->cr : (lf[-1] != '\r'))
+			count++;
+	}
+
+	if (!clipboard_stream_reserve(stream, size + count))
+		return;
+
+	out = &stream->data[stream->length];
+
+	for (next = data; (lf = (BYTE*) memchr(next, '\n', end - next)) != NULL; next = lf + 1)
+	{
+		memcpy(out, next, lf - next);
+		out += lf - next;
+
+		if ((lf == data) ? !stream->cr : (lf[-1] != '\r'))
+			*out++ = '\r';
+
+		*out++ = '\n';
+	}
+
+	memcpy(out, next, end - next);
+	out += end - next;
+
+	stream->cr = (end[-1] == '\r') ? TRUE : FALSE;
+	stream->length = out - stream->data;
+}
+
+/**
+ * The source may lie inside the output buffer, at or after the current
+ * length plus one byte for a pending CR. The caller reserves the space.
+ */
+
+static void clipboard_stream_crlf2lf(CLIPBOARD_STREAM* stream, BYTE* data, int size)
+{
+	int length;
+	BYTE* cr;
+	BYTE* out;
+	BYTE* end;
+
+	out = &stream->data[stream->length];
+	end = data + size;
+
+	while (data < end)
+	{
+		if (stream->cr)
+		{
+			stream->cr = FALSE;
+
+			if (*data != '\n')
+				*out++ = '\r';
+		}
+
+		cr = (BYTE*) memchr(data, '\r', end - data);
+		length = ((cr != NULL) ? cr : end) - data;
+
+		memmove(out, data, length);
+		out += length;
+		data += length;
+
+		if (cr != NULL)
+		{
+			stream->cr = TRUE;
+			data++;
+		}
+	}
+
+	stream->length = out - stream->data;
+}
+
+static void clipboard_stream_write_lf(CLIPBOARD_STREAM* stream, BYTE* data, int size)
+{
+	if ((size < 1) || !clipboard_stream_reserve(stream, size + 1))
+		return;
+
+	clipboard_stream_crlf2lf(stream, data, size);
+}
+
+/**
+ * Charset conversions. A UTF-8 sequence or UTF-16 surrogate pair split
+ * between two chunks is held back until the rest of it arrives.
+ */
+
+static int clipboard_utf8_sequence_length(BYTE c)
+{
+	if (c >= 0xF0)
+		return 4;
+	else if (c >= 0xE0)
+		return 3;
+	else if (c >= 0xC0)
+		return 2;
+
+	return 1;
+}
+
+static void clipboard_stream_utf8_to_utf16(CLIPBOARD_STREAM* stream, BYTE* data, int size)
+{
+	int i;
+	int count;
+	int length;
+	BYTE* lf;
+	BYTE* end;
+	BYTE* next;
+	WCHAR unit;
+	WCHAR* src;
+	WCHAR* dst;
+
+	if (size < 1)
+		return;
+
+	/* LF and CR map to single code units, so line feeds can be counted on the input */
+
+	count = 0;
+	end = data + size;
+
+	for (next = data; (lf = (BYTE*) memchr(next, '\n', end - next)) != NULL; next = lf + 1)
+	{
+		if ((lf == data) ? !stream->cr : (lf[-1] != '\r'))
+			count++;
+	}
+
+	if (!clipboard_stream_reserve(stream, (size + count) * 2))
+		return;
+
+	dst = (WCHAR*) &stream->data[stream->length];
+	src = dst + count;
+
+	length = MultiByteToWideChar(CP_UTF8, 0, (LPCSTR) data, size, src, size);
+
+	for (i = 0; i < length; i++)
+	{
+		unit = src[i];
+
+		if ((unit == '\n') && !stream->cr)
+			*dst++ = '\r';
+
+		*dst++ = unit;
+		stream->cr = (unit == '\r') ? TRUE : FALSE;
+	}
+
+	stream->length = (BYTE*) dst - stream->data;
+}
+
+static void clipboard_stream_write_utf8(CLIPBOARD_STREAM* stream, BYTE* data, int size)
+{
+	int i;
+	int need;
+
+	if (stream->carry_length > 0)
+	{
+		need = clipboard_utf8_sequence_length(stream->carry[0]);
+
+		while ((stream->carry_length < need) && (size > 0) && ((*data & 0xC0) == 0x80))
+		{
+			stream->carry[stream->carry_length++] = *data++;
+			size--;
+		}
+
+		if ((stream->carry_length < need) && (size < 1))
+			return;
+
+		clipboard_stream_utf8_to_utf16(stream, stream->carry, stream->carry_length);
+		stream->carry_length = 0;
+	}
+
+	for (i = 1; (i <= 3) && (i <= size); i++)
+	{
+		if ((data[size - i] & 0xC0) == 0x80)
+			continue;
+
+		if (clipboard_utf8_sequence_length(data[size - i]) > i)
+		{
+			memcpy(stream->carry, &data[size - i], i);
+			stream->carry_length = i;
+			size -= i;
+		}
+
+		break;
+	}
+
+	clipboard_stream_utf8_to_utf16(stream, data, size);
+}
+
+static void clipboard_stream_utf16_to_utf8(CLIPBOARD_STREAM* stream, WCHAR* units, int count, BOOL lf)
+{
+	int pad;
+	int length;
+	BYTE* out;
+
+	if (count < 1)
+		return;
+
+	pad = (lf && stream->cr) ? 1 : 0;
+
+	if (!clipboard_stream_reserve(stream, count * 3 + pad))
+		return;
+
+	out = &stream->data[stream->length + pad];
+	length = WideCharToMultiByte(CP_UTF8, 0, units, count, (LPSTR) out, count * 3, NULL, NULL);
+
+	if (lf)
+		clipboard_stream_crlf2lf(stream, out, length);
+	else
+		stream->length += length;
+}
+
+static void clipboard_stream_write_utf16(CLIPBOARD_STREAM* stream, BYTE* data, int size, BOOL lf)
+{
+	int count;
+	BYTE b0, b1;
+	WCHAR unit;
+	WCHAR units[CLIPBOARD_SLICE_LENGTH];
+
+	count = 0;
+
+	if (stream->high != 0)
+	{
+		units[count++] = stream->high;
+		stream->high = 0;
+	}
+
+	while (size > 0)
+	{
+		if (stream->has_odd)
+		{
+			b0 = stream->odd;
+			b1 = *data++;
+			size--;
+			stream->has_odd = FALSE;
+		}
+		else if (size < 2)
+		{
+			stream->odd = *data;
+			stream->has_odd = TRUE;
+			break;
+		}
+		else
+		{
+			b0 = data[0];
+			b1 = data[1];
+			data += 2;
+			size -= 2;
+		}
+
+		unit = stream->big_endian ? ((b0 << 8) | b1) : (b0 | (b1 << 8));
+
+		if (unit == 0)
+		{
+			stream->done = TRUE;
+			break;
+		}
+
+		units[count++] = unit;
+
+		if (count == CLIPBOARD_SLICE_LENGTH)
+		{
+			if ((unit & 0xFC00) == 0xD800)
+			{
+				clipboard_stream_utf16_to_utf8(stream, units, count - 1, lf);
+				units[0] = unit;
+				count = 1;
+			}
+			else
+			{
+				clipboard_stream_utf16_to_utf8(stream, units, count, lf);
+				count = 0;
+			}
+		}
+	}
+
+	if ((count > 0) && !stream->done && ((units[count - 1] & 0xFC00) == 0xD800))
+		stream->high = units[--count];
+
+	clipboard_stream_utf16_to_utf8(stream, units, count, lf);
+}
+
+/**
+ * Leading bytes needed before the conversion can start (the DIB header, the
+ * CF_HTML description) are collected in a small buffer of their own.
+ */
+
+static int clipboard_stream_buffer_header(CLIPBOARD_STREAM* stream, BYTE* data, int size, int length)
+{
+	int count;
+
+	if (stream->header == NULL)
+		stream->header = (BYTE*) xzalloc(CLIPBOARD_HTML_HEADER_MAX + 1);
+
+	count = length - stream->header_length;
+
+	if (count > size)
+		count = size;
+
+	memcpy(&stream->header[stream->header_length], data, count);
+	stream->header_length += count;
+
+	return count;
+}
+
+static void clipboard_stream_encode_html_begin(CLIPBOARD_STREAM* stream)
+{
+	clipboard_stream_append(stream, (BYTE*) clipboard_html_header, CLIPBOARD_HTML_HEADER_LENGTH);
+	clipboard_stream_append(stream, (BYTE*) "<!--StartFragment-->", 20);
+
+	stream->search = stream->length;
+	stream->started = TRUE;
+}
+
+static void clipboard_stream_encode_html_content(CLIPBOARD_STREAM* stream, BYTE* data, int size)
+{
+	int offset;
+	BYTE* end;
+	BYTE* tag;
+
+	if (stream->done)
+		return;
+
+	if (stream->utf16)
+	{
+		clipboard_stream_write_utf16(stream, data, size, FALSE);
+	}
+	else
+	{
+		end = (BYTE*) memchr(data, 0, size);
+
+		if (end != NULL)
+		{
+			size = end - data;
+			stream->done = TRUE;
+		}
+
+		clipboard_stream_append(stream, data, size);
+	}
+
+	/* the document is only wrapped in a body element if it lacks one */
+
+	while (!stream->body && !stream->failed && (stream->search < stream->length))
+	{
+		tag = (BYTE*) memchr(&stream->data[stream->search], '<', stream->length - stream->search);
+
+		if (tag == NULL)
+		{
+			stream->search = stream->length;
+			break;
+		}
+
+		offset = tag - stream->data;
+
+		if (offset + 5 > stream->length)
+		{
+			stream->search = offset;
+			break;
+		}
+
+		if ((memcmp(&tag[1], "body", 4) == 0) || (memcmp(&tag[1], "BODY", 4) == 0))
+			stream->body = TRUE;
+		else
+			stream->search = offset + 1;
+	}
+}
+
+static void clipboard_stream_encode_html(CLIPBOARD_STREAM* stream, BYTE* data, int size)
+{
+	if (!stream->started)
+	{
+		/* look for a byte order mark */
+
+		while ((stream->carry_length < 2) && (size > 0))
+		{
+			stream->carry[stream->carry_length++] = *data++;
+			size--;
+		}
+
+		if (stream->carry_length < 2)
+			return;
+
+		clipboard_stream_encode_html_begin(stream);
+
+		if ((stream->carry[0] == 0xFE) && (stream->carry[1] == 0xFF))
+		{
+			stream->utf16 = TRUE;
+			stream->big_endian = TRUE;
+		}
+		else if ((stream->carry[0] == 0xFF) && (stream->carry[1] == 0xFE))
+		{
+			stream->utf16 = TRUE;
+		}
+		else
+		{
+			clipboard_stream_encode_html_content(stream, stream->carry, 2);
+		}
+
+		stream->carry_length = 0;
+	}
+
+	clipboard_stream_encode_html_content(stream, data, size);
+}
+
+static void clipboard_stream_encode_html_offset(CLIPBOARD_STREAM* stream, int position, int offset)
+{
+	char num[11];
+
+	snprintf(num, sizeof(num), "%010lu", (unsigned long) offset);
+	memcpy(&stream->data[position], num, 10);
+}
+
+static void clipboard_stream_encode_html_end(CLIPBOARD_STREAM* stream)
+{
+	int fragment;
+	int end_fragment;
+
+	if (!stream->started)
+	{
+		clipboard_stream_encode_html_begin(stream);
+		clipboard_stream_encode_html_content(stream, stream->carry, stream->carry_length);
+		stream->carry_length = 0;
+	}
+
+	if (stream->high != 0)
+	{
+		clipboard_stream_utf16_to_utf8(stream, &stream->high, 1, FALSE);
+		stream->high = 0;
+	}
+
+	fragment = CLIPBOARD_HTML_HEADER_LENGTH + 20;
+
+	if (!stream->body)
+	{
+		if (!clipboard_stream_reserve(stream, 12))
+			return;
+
+		memmove(&stream->data[CLIPBOARD_HTML_HEADER_LENGTH + 12], &stream->data[CLIPBOARD_HTML_HEADER_LENGTH],
+				stream->length - CLIPBOARD_HTML_HEADER_LENGTH);
+		memcpy(&stream->data[CLIPBOARD_HTML_HEADER_LENGTH], "<HTML><BODY>", 12);
+		stream->length += 12;
+		fragment += 12;
+	}
+
+	end_fragment = stream->length;
+	clipboard_stream_append(stream, (BYTE*) "<!--EndFragment-->", 18);
+
+	if (!stream->body)
+		clipboard_stream_append(stream, (BYTE*) "</BODY></HTML>", 14);
+
+	if (stream->failed)
+		return;
+
+	clipboard_stream_encode_html_offset(stream, 23, CLIPBOARD_HTML_HEADER_LENGTH); /* StartHTML */
+	clipboard_stream_encode_html_offset(stream, 43, stream->length); /* EndHTML */
+	clipboard_stream_encode_html_offset(stream, 69, fragment); /* StartFragment */
+	clipboard_stream_encode_html_offset(stream, 93, end_fragment); /* EndFragment */
+
+	clipboard_stream_append(stream, (BYTE*) "", 1);
+}
+
+static void clipboard_stream_decode_dib_header(CLIPBOARD_STREAM* stream)
+{
+	STREAM* s;
+	UINT16 bpp;
+	UINT32 offset;
+	UINT32 ncolors;
+	UINT32 header_size;
+	UINT32 compression;
+	BYTE bmp[CLIPBOARD_BMP_HEADER_LENGTH];
+
+	s = stream_new(0);
+	stream_attach(s, stream->header, CLIPBOARD_DIB_HEADER_LENGTH);
+	stream_read_UINT32(s, header_size);
+	stream_seek(s, 10);
+	stream_read_UINT16(s, bpp);
+	stream_read_UINT32(s, compression);
+	stream_seek(s, 12);
+	stream_read_UINT32(s, ncolors);
+	stream_detach(s);
+
+	if (header_size < CLIPBOARD_DIB_HEADER_LENGTH)
+	{
+		printf("clipboard_stream_decode_dib_header: invalid header size %d\n", header_size);
+		stream->failed = TRUE;
+		stream_free(s);
+		return;
+	}
+
+	offset = CLIPBOARD_BMP_HEADER_LENGTH + header_size;
+
+	if (bpp <= 8)
+		offset += (ncolors == 0 ? (1 << bpp) : ncolors) * 4;
+	else if ((compression == CLIPBOARD_BI_BITFIELDS) && (header_size == CLIPBOARD_DIB_HEADER_LENGTH))
+		offset += 12;
+
+	stream_attach(s, bmp, sizeof(bmp));
+	stream_write_BYTE(s, 'B');
+	stream_write_BYTE(s, 'M');
+	stream_write_UINT32(s, CLIPBOARD_BMP_HEADER_LENGTH + stream->expected);
+	stream_write_UINT32(s, 0);
+	stream_write_UINT32(s, offset);
+	stream_detach(s);
+	stream_free(s);
+
+	clipboard_stream_append(stream, bmp, sizeof(bmp));
+	clipboard_stream_append(stream, stream->header, stream->header_length);
+	stream->parsed = TRUE;
+}
+
+static BOOL clipboard_stream_decode_html_number(char* str, BOOL final, int* value)
+{
+	char* digits;
+
+	digits = str;
+
+	while (isdigit(*str))
+		str++;
+
+	if ((str == digits) || ((*str == '\0') && !final))
+		return FALSE;
+
+	*value = atoi(digits);
+
+	return TRUE;
+}
+
+static BOOL clipboard_stream_decode_html_header(CLIPBOARD_STREAM* stream, BOOL final)
+{
+	char* end_str;
+	char* start_str;
+
+	stream->header[stream->header_length] = '\0';
+
+	start_str = strstr((char*) stream->header, "StartHTML:");
+	end_str = strstr((char*) stream->header, "EndHTML:");
+
+	if ((start_str == NULL) || (end_str == NULL))
+		return FALSE;
+
+	if (!clipboard_stream_decode_html_number(start_str + 10, final, &stream->start) ||
+			!clipboard_stream_decode_html_number(end_str + 8, final, &stream->end))
+		return FALSE;
+
+	stream->parsed = TRUE;
+
+	if ((stream->start >= stream->end) || ((stream->expected > 0) && (stream->end > stream->expected)))
+	{
+		printf("clipboard_stream_decode_html_header: invalid HTML offsets %d-%d\n", stream->start, stream->end);
+		stream->failed = TRUE;
+	}
+
+	return TRUE;
+}
+
+static void clipboard_stream_decode_html_range(CLIPBOARD_STREAM* stream, BYTE* data, int size, int offset)
+{
+	int end;
+	int start;
+
+	start = (stream->start > offset) ? stream->start : offset;
+	end = (stream->end < offset + size) ? stream->end : offset + size;
+
+	if (start < end)
+		clipboard_stream_write_lf(stream, &data[start - offset], end - start);
+}
+
+static void clipboard_stream_encode(CLIPBOARD_STREAM* stream, BYTE* data, int size)
+{
+	int skip;
+
+	switch (stream->format)
+	{
+		case CB_FORMAT_TEXT:
+			clipboard_stream_lf2crlf(stream, data, size);
+			break;
+
+		case CB_FORMAT_UNICODETEXT:
+			clipboard_stream_write_utf8(stream, data, size);
+			break;
+
+		case CB_FORMAT_DIB:
+			/* strip the bitmap file header */
+			skip = CLIPBOARD_BMP_HEADER_LENGTH - stream->total;
+			skip = (skip < 0) ? 0 : ((skip > size) ? size : skip);
+			clipboard_stream_append(stream, &data[skip], size - skip);
+			break;
+
+		case CB_FORMAT_HTML:
+			clipboard_stream_encode_html(stream, data, size);
+			break;
+
+		default:
+			clipboard_stream_append(stream, data, size);
+			break;
+	}
+}
+
+static void clipboard_stream_decode(CLIPBOARD_STREAM* stream, BYTE* data, int size)
+{
+	int count;
+	BYTE* end;
+
+	switch (stream->format)
+	{
+		case CB_FORMAT_TEXT:
+			end = (BYTE*) memchr(data, 0, size);
+
+			if (end != NULL)
+			{
+				size = end - data;
+				stream->done = TRUE;
+			}
+
+			clipboard_stream_write_lf(stream, data, size);
+			break;
+
+		case CB_FORMAT_UNICODETEXT:
+			clipboard_stream_write_utf16(stream, data, size, TRUE);
+			break;
+
+		case CB_FORMAT_DIB:
+			if (!stream->parsed)
+			{
+				count = clipboard_stream_buffer_header(stream, data, size, CLIPBOARD_DIB_HEADER_LENGTH);
+				data += count;
+				size -= count;
+
+				if (stream->header_length < CLIPBOARD_DIB_HEADER_LENGTH)
+					break;
+
+				clipboard_stream_decode_dib_header(stream);
+			}
+
+			clipboard_stream_append(stream, data, size);
+			break;
+
+		case CB_FORMAT_HTML:
+			if (!stream->parsed)
+			{
+				count = clipboard_stream_buffer_header(stream, data, size, CLIPBOARD_HTML_HEADER_MAX);
+
+				if (!clipboard_stream_decode_html_header(stream, FALSE))
+				{
+					if (stream->header_length == CLIPBOARD_HTML_HEADER_MAX)
+					{
+						printf("clipboard_stream_decode: invalid HTML clipboard format\n");
+						stream->failed = TRUE;
+					}
+
+					break;
+				}
+
+				clipboard_stream_decode_html_range(stream, stream->header, stream->header_length, 0);
+				clipboard_stream_decode_html_range(stream, &data[count], size - count, stream->total + count);
+			}
+			else
+			{
+				clipboard_stream_decode_html_range(stream, data, size, stream->total);
+			}
+			break;
+
+		default:
+			clipboard_stream_append(stream, data, size);
+			break;
+	}
+}
+
+/**
+ * Convert the next chunk of clipboard data.
+ * @param stream clipboard stream
+ * @param data chunk of data
+ * @param size chunk size
+ * @return FALSE if the data could not be converted
+ */
+
+BOOL clipboard_stream_write(CLIPBOARD_STREAM* stream, BYTE* data, int size)
+{
+	if (stream->failed)
+		return FALSE;
+
+	if ((size < 1) || stream->done)
+		return TRUE;
+
+	if (stream->encode)
+		clipboard_stream_encode(stream, data, size);
+	else
+		clipboard_stream_decode(stream, data, size);
+
+	stream->total += size;
+
+	return (stream->failed) ? FALSE : TRUE;
+}
+
+/**
+ * Flush the conversion state and terminate the converted data
+ * as required by its format.
+ * @param stream clipboard stream
+ * @return FALSE if the data could not be converted
+ */
+
+BOOL clipboard_stream_finish(CLIPBOARD_STREAM* stream)
+{
+	if (stream->failed)
+		return FALSE;
+
+	if (stream->encode)
+	{
+		switch (stream->format)
+		{
+			case CB_FORMAT_TEXT:
+				clipboard_stream_append(stream, (BYTE*) "", 1);
+				break;
+
+			case CB_FORMAT_UNICODETEXT:
+				clipboard_stream_utf8_to_utf16(stream, stream->carry, stream->carry_length);
+				stream->carry_length = 0;
+				clipboard_stream_append(stream, (BYTE*) "\0", 2);
+				break;
+
+			case CB_FORMAT_DIB:
+				/* length should be at least BMP header (14) + sizeof(BITMAPINFOHEADER) */
+				if (stream->total < CLIPBOARD_BMP_HEADER_LENGTH + CLIPBOARD_DIB_HEADER_LENGTH)
+					stream->failed = TRUE;
+				break;
+
+			case CB_FORMAT_HTML:
+				clipboard_stream_encode_html_end(stream);
+				break;
+		}
+	}
+	else
+	{
+		switch (stream->format)
+		{
+			case CB_FORMAT_DIB:
+				/* size should be at least sizeof(BITMAPINFOHEADER) */
+				if (!stream->parsed)
+					stream->failed = TRUE;
+				break;
+
+			case CB_FORMAT_HTML:
+				if (!stream->parsed)
+				{
+					if ((stream->header == NULL) || !clipboard_stream_decode_html_header(stream, TRUE))
+					{
+						stream->failed = TRUE;
+						break;
+					}
+
+					clipboard_stream_decode_html_range(stream, stream->header, stream->header_length, 0);
+				}
+				/* fall through */
+
+			case CB_FORMAT_TEXT:
+			case CB_FORMAT_UNICODETEXT:
+				if ((stream->high != 0) && !stream->done)
+					clipboard_stream_utf16_to_utf8(stream, &stream->high, 1, TRUE);
+
+				stream->high = 0;
+
+				if (stream->cr)
+				{
+					stream->cr = FALSE;
+					clipboard_stream_append(stream, (BYTE*) "\r", 1);
+				}
+				break;
+		}
+	}
+
+	return (stream->failed) ? FALSE : TRUE;
+}
+
+/**
+ * Take ownership of the converted data.
+ * @param stream clipboard stream
+ * @param size receives the length of the converted data
+ * @return converted data, to be released with free()
+ */
+
+BYTE* clipboard_stream_detach(CLIPBOARD_STREAM* stream, int* size)
+{
+	BYTE* data;
+
+	data = stream->data;
+	*size = stream->length;
+
+	stream->data = NULL;
+	stream->length = 0;
+	stream->size = 0;
+
+	return data;
+}
+
+/**
+ * Create a clipboard stream.
+ * @param format clipboard format (CB_FORMAT_*)
+ * @param encode TRUE to convert local data to the Windows format, FALSE for the reverse
+ * @param length expected input length, or 0 if not known in advance
+ * @return new clipboard stream, or NULL if the format is not supported
+ */
+
+CLIPBOARD_STREAM* clipboard_stream_new(UINT32 format, BOOL encode, int length)
+{
+	CLIPBOARD_STREAM* stream;
+
+	switch (format)
+	{
+		case CB_FORMAT_RAW:
+		case CB_FORMAT_TEXT:
+		case CB_FORMAT_DIB:
+		case CB_FORMAT_UNICODETEXT:
+		case CB_FORMAT_HTML:
+		case CB_FORMAT_PNG:
+		case CB_FORMAT_JPEG:
+		case CB_FORMAT_GIF:
+			break;
+
+		default:
+			return NULL;
+	}
+
+	stream = xnew(CLIPBOARD_STREAM);
+
+	stream->format = format;
+	stream->encode = encode;
+	stream->expected = (length > 0) ? length : 0;
+
+	/* the whole output is kept when encoding, size it from the input */
+
+	if (encode && (length > 0) && (length < 0x10000000))
+	{
+		if (format == CB_FORMAT_UNICODETEXT)
+			clipboard_stream_reserve(stream, length * 2 + length / 16 + 2);
+		else
+			clipboard_stream_reserve(stream, length + length / 16 + 256);
+	}
+
+	return stream;
+}
+
+void clipboard_stream_free(CLIPBOARD_STREAM* stream)
+{
+	if (stream != NULL)
+	{
+		free(stream->data);
+		free(stream->header);
+		free(stream);
+	}
+}
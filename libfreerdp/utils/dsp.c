@@ -21,15 +21,29 @@
 #include "config.h"
 #endif
 
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#ifdef HAVE_STDINT_H
+#include <stdint.h>
+#endif
+
+#ifdef WITH_SSE2
+#include <emmintrin.h>
+#elif defined(WITH_NEON)
+#include <arm_neon.h>
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
 
 #include <freerdp/types.h>
 #include <freerdp/utils/memory.h>
 #include <freerdp/utils/dsp.h>
 
-static void freerdp_dsp_resample(FREERDP_DSP_CONTEXT* context,
+static void freerdp_dsp_resample_nearest(FREERDP_DSP_CONTEXT* context,
 	const BYTE* src, int bytes_per_sample,
 	UINT32 schan, UINT32 srate, int sframes,
 	UINT32 rchan, UINT32 rrate)
@@ -75,181 +89,489 @@ static void freerdp_dsp_resample(FREERDP_DSP_CONTEXT* context,
 }
 
 /**
- * Microsoft IMA ADPCM specification:
+ * Polyphase windowed-sinc resampler
  *
- * http://wiki.multimedia.cx/index.php?title=Microsoft_IMA_ADPCM
- * http://wiki.multimedia.cx/index.php?title=IMA_ADPCM
+ * The filter is tabulated for RESAMPLE_PHASES fractional positions between two
+ * input samples, as Q14 fixed point coefficients normalized to unity DC gain.
+ * Input frames are deinterleaved into per-channel INT16 histories which carry
+ * the last (taps - 1) frames over to the next call, together with the
+ * fractional read position, so consecutive chunks join without discontinuity.
  */
 
-static const INT16 ima_step_index_table[] =
+#define RESAMPLE_PHASE_BITS	8
+#define RESAMPLE_PHASES		(1 << RESAMPLE_PHASE_BITS)
+#define RESAMPLE_COEFF_BITS	14
+
+struct _FREERDP_DSP_RESAMPLER
 {
-	-1, -1, -1, -1, 2, 4, 6, 8,
-	-1, -1, -1, -1, 2, 4, 6, 8
+	int quality;
+	int bytes_per_sample;
+	UINT32 schan;
+	UINT32 srate;
+	UINT32 rchan;
+	UINT32 rrate;
+
+	int taps;
+	INT16* filter;
+	void* filter_mem;
+
+	UINT32 fchan;
+	INT16* history;
+	int history_frames;
+	int history_capacity;
+
+	UINT64 step;
+	UINT64 position;
 };
 
-static const INT16 ima_step_size_table[] =
+static const struct
 {
-	7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 
-	19, 21, 23, 25, 28, 31, 34, 37, 41, 45, 
-	50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 
-	130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
-	337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
-	876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 
-	2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358,
-	5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899, 
-	15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767 
+	int taps;
+	double rolloff;
+} resample_quality_table[] =
+{
+	{ 0, 0.0 },	/* FREERDP_DSP_RESAMPLE_NEAREST */
+	{ 8, 0.80 },	/* FREERDP_DSP_RESAMPLE_LOW */
+	{ 16, 0.88 },	/* FREERDP_DSP_RESAMPLE_MEDIUM */
+	{ 32, 0.94 }	/* FREERDP_DSP_RESAMPLE_HIGH */
 };
 
-static UINT16 dsp_decode_ima_adpcm_sample(ADPCM* adpcm,
-	int channel, BYTE sample)
+static INT32 dsp_resample_dot_product(const INT16* x, const INT16* h, int taps)
 {
-	INT32 ss;
-	INT32 d;
+#if defined(WITH_SSE2)
+	int i;
+	__m128i acc = _mm_setzero_si128();
 
-	ss = ima_step_size_table[adpcm->ima.last_step[channel]];
-	d = (ss >> 3);
-	if (sample & 1)
-		d += (ss >> 2);
-	if (sample & 2)
-		d += (ss >> 1);
-	if (sample & 4)
-		d += ss;
-	if (sample & 8)
-		d = -d;
-	d += adpcm->ima.last_sample[channel];
+	for (i = 0; i < taps; i += 8)
+	{
+		acc = _mm_add_epi32(acc, _mm_madd_epi16(
+			_mm_loadu_si128((const __m128i*) &x[i]),
+			_mm_load_si128((const __m128i*) &h[i])));
+	}
 
-	if (d < -32768)
-		d = -32768;
-	else if (d > 32767)
-		d = 32767;
+	acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+	acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+
+	return _mm_cvtsi128_si32(acc);
+#elif defined(WITH_NEON)
+	int i;
+	int32x2_t sum;
+	int32x4_t acc = vdupq_n_s32(0);
+
+	for (i = 0; i < taps; i += 8)
+	{
+		int16x8_t vx = vld1q_s16(&x[i]);
+		int16x8_t vh = vld1q_s16(&h[i]);
+		acc = vmlal_s16(acc, vget_low_s16(vx), vget_low_s16(vh));
+		acc = vmlal_s16(acc, vget_high_s16(vx), vget_high_s16(vh));
+	}
+
+	sum = vadd_s32(vget_low_s32(acc), vget_high_s32(acc));
+	sum = vpadd_s32(sum, sum);
 
-	adpcm->ima.last_sample[channel] = (INT16) d;
+	return vget_lane_s32(sum, 0);
+#else
+	int i;
+	INT32 acc = 0;
 
-	adpcm->ima.last_step[channel] += ima_step_index_table[sample];
-	if (adpcm->ima.last_step[channel] < 0)
-		adpcm->ima.last_step[channel] = 0;
-	else if (adpcm->ima.last_step[channel] > 88)
-		adpcm->ima.last_step[channel] = 88;
+	for (i = 0; i < taps; i++)
+		acc += x[i] * h[i];
 
-	return (UINT16) d;
+	return acc;
+#endif
 }
 
-static void freerdp_dsp_decode_ima_adpcm(FREERDP_DSP_CONTEXT* context,
-	const BYTE* src, int size, int channels, int block_size)
+static void dsp_resampler_build_filter(FREERDP_DSP_RESAMPLER* resampler)
+{
+	int p, k;
+	int half;
+	INT32 sum;
+	double d, u;
+	double cutoff;
+	double norm;
+	double coeffs[64];
+	INT16* row;
+
+	half = resampler->taps / 2;
+	cutoff = resample_quality_table[resampler->quality].rolloff;
+
+	/* when downsampling, the cutoff follows the output Nyquist frequency */
+	if (resampler->rrate < resampler->srate)
+		cutoff = cutoff * resampler->rrate / resampler->srate;
+
+	for (p = 0; p < RESAMPLE_PHASES; p++)
+	{
+		norm = 0.0;
+
+		for (k = 0; k < resampler->taps; k++)
+		{
+			/* distance between input tap k and the output position (half - 1) + p / RESAMPLE_PHASES */
+			d = (k - (half - 1)) - ((double) p / RESAMPLE_PHASES);
+			u = d / half;
+
+			coeffs[k] = (d == 0.0) ? cutoff : sin(M_PI * cutoff * d) / (M_PI * d);
+			coeffs[k] *= 0.42 + 0.5 * cos(M_PI * u) + 0.08 * cos(2.0 * M_PI * u); /* Blackman */
+			norm += coeffs[k];
+		}
+
+		row = &resampler->filter[p * resampler->taps];
+		sum = 0;
+
+		for (k = 0; k < resampler->taps; k++)
+		{
+			row[k] = (INT16) floor(coeffs[k] * (1 << RESAMPLE_COEFF_BITS) / norm + 0.5);
+			sum += row[k];
+		}
+
+		/* make every phase exactly unity gain so DC and silence pass through unchanged */
+		row[half - 1 + (p >= RESAMPLE_PHASES / 2)] += (1 << RESAMPLE_COEFF_BITS) - sum;
+	}
+}
+
+static void dsp_resampler_free(FREERDP_DSP_RESAMPLER* resampler)
+{
+	if (resampler)
+	{
+		free(resampler->filter_mem);
+		free(resampler->history);
+		free(resampler);
+	}
+}
+
+static FREERDP_DSP_RESAMPLER* dsp_resampler_new(int quality, int bytes_per_sample,
+	UINT32 schan, UINT32 srate, UINT32 rchan, UINT32 rrate)
+{
+	FREERDP_DSP_RESAMPLER* resampler;
+
+	resampler = xnew(FREERDP_DSP_RESAMPLER);
+
+	resampler->quality = quality;
+	resampler->bytes_per_sample = bytes_per_sample;
+	resampler->schan = schan;
+	resampler->srate = srate;
+	resampler->rchan = rchan;
+	resampler->rrate = rrate;
+	resampler->fchan = (rchan < schan) ? rchan : schan;
+	resampler->taps = resample_quality_table[quality].taps;
+	resampler->step = (((UINT64) srate) << 32) / rrate;
+
+	/* 16-byte aligned rows for the SIMD dot product */
+	resampler->filter_mem = malloc(RESAMPLE_PHASES * resampler->taps * sizeof(INT16) + 16);
+	resampler->filter = (INT16*) (((uintptr_t) resampler->filter_mem + 16) & ~ 0x0F);
+	dsp_resampler_build_filter(resampler);
+
+	/* prime the history so the first output frame lines up with the first input frame */
+	resampler->history_capacity = 4096;
+	resampler->history = (INT16*) xzalloc(resampler->fchan * resampler->history_capacity * sizeof(INT16));
+	resampler->history_frames = resampler->taps / 2 - 1;
+
+	return resampler;
+}
+
+static void dsp_resampler_append(FREERDP_DSP_RESAMPLER* resampler, const BYTE* src, int sframes)
 {
-	BYTE* dst;
-	BYTE sample;
-	UINT16 decoded;
-	UINT32 out_size;
-	int channel;
 	int i;
+	UINT32 c, k;
+	INT32 mix;
+	INT16* dst;
+	int capacity;
+	INT16* history;
+	UINT32 schan = resampler->schan;
 
-	out_size = size * 4;
-	if (out_size > context->adpcm_maxlength)
+	if (resampler->history_frames + sframes > resampler->history_capacity)
 	{
-		context->adpcm_maxlength = out_size + 1024;
-		context->adpcm_buffer = realloc(context->adpcm_buffer, context->adpcm_maxlength);
+		capacity = resampler->history_frames + sframes + 1024;
+		history = (INT16*) malloc(resampler->fchan * capacity * sizeof(INT16));
+
+		for (c = 0; c < resampler->fchan; c++)
+		{
+			memcpy(&history[c * capacity], &resampler->history[c * resampler->history_capacity],
+				resampler->history_frames * sizeof(INT16));
+		}
+
+		free(resampler->history);
+		resampler->history = history;
+		resampler->history_capacity = capacity;
 	}
-	dst = context->adpcm_buffer;
-	while (size > 0)
+
+	for (c = 0; c < resampler->fchan; c++)
 	{
-		if (size % block_size == 0)
+		dst = &resampler->history[c * resampler->history_capacity + resampler->history_frames];
+
+		if (resampler->bytes_per_sample == 2)
 		{
-			context->adpcm.ima.last_sample[0] = (INT16) (((UINT16)(*src)) | (((UINT16)(*(src + 1))) << 8));
-			context->adpcm.ima.last_step[0] = (INT16) (*(src + 2));
-			src += 4;
-			size -= 4;
-			out_size -= 16;
-			if (channels > 1)
+			const INT16* in = ((const INT16*) src) + c;
+
+			if ((resampler->fchan == 1) && (schan > 1))
+			{
+				/* downmix to mono */
+				for (i = 0; i < sframes; i++, in += schan)
+				{
+					for (mix = 0, k = 0; k < schan; k++)
+						mix += in[k];
+					dst[i] = (INT16) (mix / (INT32) schan);
+				}
+			}
+			else
+			{
+				for (i = 0; i < sframes; i++, in += schan)
+					dst[i] = *in;
+			}
+		}
+		else
+		{
+			const BYTE* in = src + c;
+
+			if ((resampler->fchan == 1) && (schan > 1))
 			{
-				context->adpcm.ima.last_sample[1] = (INT16) (((UINT16)(*src)) | (((UINT16)(*(src + 1))) << 8));
-				context->adpcm.ima.last_step[1] = (INT16) (*(src + 2));
-				src += 4;
-				size -= 4;
-				out_size -= 16;
+				for (i = 0; i < sframes; i++, in += schan)
+				{
+					for (mix = 0, k = 0; k < schan; k++)
+						mix += in[k];
+					dst[i] = (INT16) (((mix / (INT32) schan) - 128) << 8);
+				}
+			}
+			else
+			{
+				for (i = 0; i < sframes; i++, in += schan)
+					dst[i] = (INT16) ((*in - 128) << 8);
 			}
 		}
+	}
+
+	resampler->history_frames += sframes;
+}
+
+static void freerdp_dsp_resample_polyphase(FREERDP_DSP_CONTEXT* context,
+	const BYTE* src, int bytes_per_sample,
+	UINT32 schan, UINT32 srate, int sframes,
+	UINT32 rchan, UINT32 rrate)
+{
+	BYTE* p;
+	int index;
+	int taps;
+	int rsize;
+	int rframes;
+	int max_frames;
+	INT32 value;
+	UINT32 c;
+	UINT32 phase;
+	INT32 out[8];
+	const INT16* filter;
+	FREERDP_DSP_RESAMPLER* resampler = context->resampler;
+
+	if (!resampler || (resampler->quality != context->resample_quality) ||
+		(resampler->bytes_per_sample != bytes_per_sample) ||
+		(resampler->schan != schan) || (resampler->srate != srate) ||
+		(resampler->rchan != rchan) || (resampler->rrate != rrate))
+	{
+		dsp_resampler_free(resampler);
+		resampler = dsp_resampler_new(context->resample_quality, bytes_per_sample, schan, srate, rchan, rrate);
+		context->resampler = resampler;
+	}
+
+	dsp_resampler_append(resampler, src, sframes);
 
-		if (channels > 1)
+	taps = resampler->taps;
+	max_frames = (int) ((((UINT64) resampler->history_frames << 32) / resampler->step) + 1);
+	rsize = max_frames * bytes_per_sample * rchan;
+
+	if (rsize > (int) context->resampled_maxlength)
+	{
+		context->resampled_maxlength = rsize + 1024;
+		context->resampled_buffer = (BYTE*) realloc(context->resampled_buffer, context->resampled_maxlength);
+	}
+
+	p = context->resampled_buffer;
+	rframes = 0;
+
+	while ((int) (resampler->position >> 32) + taps <= resampler->history_frames)
+	{
+		index = (int) (resampler->position >> 32);
+		phase = (UINT32) (resampler->position >> (32 - RESAMPLE_PHASE_BITS)) & (RESAMPLE_PHASES - 1);
+		filter = &resampler->filter[phase * taps];
+
+		for (c = 0; c < resampler->fchan && c < 8; c++)
+		{
+			value = dsp_resample_dot_product(&resampler->history[c * resampler->history_capacity + index], filter, taps);
+			value = (value + (1 << (RESAMPLE_COEFF_BITS - 1))) >> RESAMPLE_COEFF_BITS;
+
+			if (value > 32767)
+				value = 32767;
+			else if (value < -32768)
+				value = -32768;
+
+			out[c] = value;
+		}
+
+		for (c = 0; c < rchan; c++)
 		{
-			for (i = 0; i < 8; i++)
+			value = out[(c % resampler->fchan) & 7];
+
+			if (bytes_per_sample == 2)
 			{
-				channel = (i < 4 ? 0 : 1);
-				sample = ((*src) & 0x0f);
-				decoded = dsp_decode_ima_adpcm_sample(&context->adpcm, channel, sample);
-				dst[((i & 3) << 3) + (channel << 1)] = (decoded & 0xff);
-				dst[((i & 3) << 3) + (channel << 1) + 1] = (decoded >> 8);
-				sample = ((*src) >> 4);
-				decoded = dsp_decode_ima_adpcm_sample(&context->adpcm, channel, sample);
-				dst[((i & 3) << 3) + (channel << 1) + 4] = (decoded & 0xff);
-				dst[((i & 3) << 3) + (channel << 1) + 5] = (decoded >> 8);
-				src++;
+				*p++ = (BYTE) (value & 0xFF);
+				*p++ = (BYTE) ((value >> 8) & 0xFF);
+			}
+			else
+			{
+				*p++ = (BYTE) ((value >> 8) + 128);
 			}
-			dst += 32;
-			size -= 8;
 		}
-		else
+
+		resampler->position += resampler->step;
+		rframes++;
+	}
+
+	/* drop the consumed input, keeping what the next output frames still need */
+	index = (int) (resampler->position >> 32);
+
+	if (index > 0)
+	{
+		for (c = 0; c < resampler->fchan; c++)
 		{
-			sample = ((*src) & 0x0f);
-			decoded = dsp_decode_ima_adpcm_sample(&context->adpcm, 0, sample);
-			*dst++ = (decoded & 0xff);
-			*dst++ = (decoded >> 8);
-			sample = ((*src) >> 4);
-			decoded = dsp_decode_ima_adpcm_sample(&context->adpcm, 0, sample);
-			*dst++ = (decoded & 0xff);
-			*dst++ = (decoded >> 8);
-			src++;
-			size--;
+			INT16* history = &resampler->history[c * resampler->history_capacity];
+			memmove(history, &history[index], (resampler->history_frames - index) * sizeof(INT16));
 		}
+
+		resampler->history_frames -= index;
+		resampler->position -= ((UINT64) index) << 32;
+	}
+
+	context->resampled_frames = rframes;
+	context->resampled_size = rframes * bytes_per_sample * rchan;
+}
+
+static void freerdp_dsp_resample(FREERDP_DSP_CONTEXT* context,
+	const BYTE* src, int bytes_per_sample,
+	UINT32 schan, UINT32 srate, int sframes,
+	UINT32 rchan, UINT32 rrate)
+{
+	if ((context->resample_quality == FREERDP_DSP_RESAMPLE_NEAREST) ||
+		((bytes_per_sample != 1) && (bytes_per_sample != 2)) ||
+		(schan < 1) || (rchan < 1) || (schan > 8) || (srate < 1) || (rrate < 1))
+	{
+		freerdp_dsp_resample_nearest(context, src, bytes_per_sample,
+			schan, srate, sframes, rchan, rrate);
+		return;
 	}
 
-	context->adpcm_size = dst - context->adpcm_buffer;
+	freerdp_dsp_resample_polyphase(context, src, bytes_per_sample,
+		schan, srate, sframes, rchan, rrate);
+}
+
+void freerdp_dsp_context_set_resample_quality(FREERDP_DSP_CONTEXT* context, int quality)
+{
+	if (quality < FREERDP_DSP_RESAMPLE_NEAREST)
+		quality = FREERDP_DSP_RESAMPLE_NEAREST;
+	else if (quality > FREERDP_DSP_RESAMPLE_HIGH)
+		quality = FREERDP_DSP_RESAMPLE_HIGH;
+
+	context->resample_quality = quality;
 }
 
 /**
- * 0     1     2     3
- * 2 0   6 4   10 8  14 12   <left>
+ * Drops the resampler history, to be called when a new, unrelated stream starts.
+ */
+void freerdp_dsp_context_reset_resampler(FREERDP_DSP_CONTEXT* context)
+{
+	dsp_resampler_free(context->resampler);
+	context->resampler = NULL;
+}
+
+/**
+ * Microsoft IMA ADPCM specification:
  *
- * 4     5     6     7
- * 3 1   7 5   11 9  15 13   <right>
+ * http://wiki.multimedia.cx/index.php?title=Microsoft_IMA_ADPCM
+ * http://wiki.multimedia.cx/index.php?title=IMA_ADPCM
  */
-static const struct
+
+static const INT16 ima_step_index_table[] =
 {
-	BYTE byte_num;
-	BYTE byte_shift;
-} ima_stereo_encode_map[] =
-{
-	{ 0, 0 },
-	{ 4, 0 },
-	{ 0, 4 },
-	{ 4, 4 },
-	{ 1, 0 },
-	{ 5, 0 },
-	{ 1, 4 },
-	{ 5, 4 },
-	{ 2, 0 },
-	{ 6, 0 },
-	{ 2, 4 },
-	{ 6, 4 },
-	{ 3, 0 },
-	{ 7, 0 },
-	{ 3, 4 },
-	{ 7, 4 }
+	-1, -1, -1, -1, 2, 4, 6, 8,
+	-1, -1, -1, -1, 2, 4, 6, 8
 };
 
-static BYTE dsp_encode_ima_adpcm_sample(ADPCM* adpcm,
-	int channel, INT16 sample)
+static const INT16 ima_step_size_table[] =
+{
+	7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 
+	19, 21, 23, 25, 28, 31, 34, 37, 41, 45, 
+	50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 
+	130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+	337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
+	876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 
+	2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358,
+	5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899, 
+	15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767 
+};
+
+#define IMA_STEP_DIFFS(_ss) { \
+	((_ss) >> 3), \
+	((_ss) >> 3) + ((_ss) >> 2), \
+	((_ss) >> 3) + ((_ss) >> 1), \
+	((_ss) >> 3) + ((_ss) >> 2) + ((_ss) >> 1), \
+	((_ss) >> 3) + (_ss), \
+	((_ss) >> 3) + ((_ss) >> 2) + (_ss), \
+	((_ss) >> 3) + ((_ss) >> 1) + (_ss), \
+	((_ss) >> 3) + ((_ss) >> 2) + ((_ss) >> 1) + (_ss) }
+
+/**
+ * Magnitude of the difference coded by the three low bits of a nibble,
+ * for each step index, as the reference decoder computes it bit by bit.
+ */
+static const UINT16 ima_step_diff_table[89][8] =
+{
+	IMA_STEP_DIFFS(7), IMA_STEP_DIFFS(8), IMA_STEP_DIFFS(9), IMA_STEP_DIFFS(10), IMA_STEP_DIFFS(11), IMA_STEP_DIFFS(12),
+	IMA_STEP_DIFFS(13), IMA_STEP_DIFFS(14), IMA_STEP_DIFFS(16), IMA_STEP_DIFFS(17), IMA_STEP_DIFFS(19), IMA_STEP_DIFFS(21),
+	IMA_STEP_DIFFS(23), IMA_STEP_DIFFS(25), IMA_STEP_DIFFS(28), IMA_STEP_DIFFS(31), IMA_STEP_DIFFS(34), IMA_STEP_DIFFS(37),
+	IMA_STEP_DIFFS(41), IMA_STEP_DIFFS(45), IMA_STEP_DIFFS(50), IMA_STEP_DIFFS(55), IMA_STEP_DIFFS(60), IMA_STEP_DIFFS(66),
+	IMA_STEP_DIFFS(73), IMA_STEP_DIFFS(80), IMA_STEP_DIFFS(88), IMA_STEP_DIFFS(97), IMA_STEP_DIFFS(107), IMA_STEP_DIFFS(118),
+	IMA_STEP_DIFFS(130), IMA_STEP_DIFFS(143), IMA_STEP_DIFFS(157), IMA_STEP_DIFFS(173), IMA_STEP_DIFFS(190), IMA_STEP_DIFFS(209),
+	IMA_STEP_DIFFS(230), IMA_STEP_DIFFS(253), IMA_STEP_DIFFS(279), IMA_STEP_DIFFS(307), IMA_STEP_DIFFS(337), IMA_STEP_DIFFS(371),
+	IMA_STEP_DIFFS(408), IMA_STEP_DIFFS(449), IMA_STEP_DIFFS(494), IMA_STEP_DIFFS(544), IMA_STEP_DIFFS(598), IMA_STEP_DIFFS(658),
+	IMA_STEP_DIFFS(724), IMA_STEP_DIFFS(796), IMA_STEP_DIFFS(876), IMA_STEP_DIFFS(963), IMA_STEP_DIFFS(1060), IMA_STEP_DIFFS(1166),
+	IMA_STEP_DIFFS(1282), IMA_STEP_DIFFS(1411), IMA_STEP_DIFFS(1552), IMA_STEP_DIFFS(1707), IMA_STEP_DIFFS(1878), IMA_STEP_DIFFS(2066),
+	IMA_STEP_DIFFS(2272), IMA_STEP_DIFFS(2499), IMA_STEP_DIFFS(2749), IMA_STEP_DIFFS(3024), IMA_STEP_DIFFS(3327), IMA_STEP_DIFFS(3660),
+	IMA_STEP_DIFFS(4026), IMA_STEP_DIFFS(4428), IMA_STEP_DIFFS(4871), IMA_STEP_DIFFS(5358), IMA_STEP_DIFFS(5894), IMA_STEP_DIFFS(6484),
+	IMA_STEP_DIFFS(7132), IMA_STEP_DIFFS(7845), IMA_STEP_DIFFS(8630), IMA_STEP_DIFFS(9493), IMA_STEP_DIFFS(10442), IMA_STEP_DIFFS(11487),
+	IMA_STEP_DIFFS(12635), IMA_STEP_DIFFS(13899), IMA_STEP_DIFFS(15289), IMA_STEP_DIFFS(16818), IMA_STEP_DIFFS(18500), IMA_STEP_DIFFS(20350),
+	IMA_STEP_DIFFS(22385), IMA_STEP_DIFFS(24623), IMA_STEP_DIFFS(27086), IMA_STEP_DIFFS(29794), IMA_STEP_DIFFS(32767)
+};
+
+#define IMA_HEADER_SIZE		4
+
+static INLINE INT32 dsp_decode_ima_adpcm_nibble(INT32* last_sample, INT32* last_step, BYTE nibble)
 {
-	INT32 e;
 	INT32 d;
+
+	d = ima_step_diff_table[*last_step][nibble & 7];
+	d = (nibble & 8) ? *last_sample - d : *last_sample + d;
+
+	if (d < -32768)
+		d = -32768;
+	else if (d > 32767)
+		d = 32767;
+
+	*last_sample = d;
+
+	*last_step += ima_step_index_table[nibble];
+	if (*last_step < 0)
+		*last_step = 0;
+	else if (*last_step > 88)
+		*last_step = 88;
+
+	return d;
+}
+
+static INLINE BYTE dsp_encode_ima_adpcm_nibble(INT32* last_sample, INT32* last_step, INT32 sample)
+{
+	INT32 e;
 	INT32 ss;
-	BYTE enc;
-	INT32 diff;
+	BYTE enc = 0;
+
+	ss = ima_step_size_table[*last_step];
+	e = sample - *last_sample;
 
-	ss = ima_step_size_table[adpcm->ima.last_step[channel]];
-	d = e = sample - adpcm->ima.last_sample[channel];
-	diff = ss >> 3;
-	enc = 0;
 	if (e < 0)
 	{
 		enc = 8;
@@ -268,92 +590,248 @@ static BYTE dsp_encode_ima_adpcm_sample(ADPCM* adpcm,
 	}
 	ss >>= 1;
 	if (e >= ss)
-	{
 		enc |= 1;
-		e -= ss;
+
+	/* the encoder tracks the decoder output, so both share the reconstruction */
+	dsp_decode_ima_adpcm_nibble(last_sample, last_step, enc);
+
+	return enc;
+}
+
+/**
+ * IMA ADPCM block data: mono bytes carry two samples, low nibble first.
+ * Stereo data comes in 8 byte groups, four bytes (eight samples) of the left
+ * channel followed by four bytes of the right channel:
+ *
+ * 0     1     2     3
+ * 2 0   6 4   10 8  14 12   <left>
+ *
+ * 4     5     6     7
+ * 3 1   7 5   11 9  15 13   <right>
+ */
+static int dsp_ima_adpcm_data_size(int size, int channels)
+{
+	return (channels > 1) ? (size & ~7) : size;
+}
+
+static void dsp_decode_ima_adpcm_data(ADPCM* adpcm, const BYTE* src, int size, int channels, BYTE* dst)
+{
+	int c, i;
+	INT32 value;
+	INT32 last_sample;
+	INT32 last_step;
+	BYTE* out;
+
+	if (channels < 2)
+	{
+		last_sample = adpcm->ima.last_sample[0];
+		last_step = adpcm->ima.last_step[0];
+
+		for (i = 0; i < size; i++)
+		{
+			value = dsp_decode_ima_adpcm_nibble(&last_sample, &last_step, src[i] & 0x0F);
+			*dst++ = (BYTE) (value & 0xFF);
+			*dst++ = (BYTE) ((value >> 8) & 0xFF);
+			value = dsp_decode_ima_adpcm_nibble(&last_sample, &last_step, src[i] >> 4);
+			*dst++ = (BYTE) (value & 0xFF);
+			*dst++ = (BYTE) ((value >> 8) & 0xFF);
+		}
+
+		adpcm->ima.last_sample[0] = (INT16) last_sample;
+		adpcm->ima.last_step[0] = (INT16) last_step;
+		return;
 	}
 
-	if (d < 0)
-		diff = d + e - diff;
-	else
-		diff = d - e + diff;
+	for (c = 0; c < 2; c++)
+	{
+		last_sample = adpcm->ima.last_sample[c];
+		last_step = adpcm->ima.last_step[c];
+		out = dst + (c << 1);
 
-	diff += adpcm->ima.last_sample[channel];
-	if (diff < -32768)
-		diff = -32768;
-	else if (diff > 32767)
-		diff = 32767;
-	adpcm->ima.last_sample[channel] = (INT16) diff;
+		for (i = c * 4; i + 8 <= size + c * 4; i += 8)
+		{
+			int k;
 
-	adpcm->ima.last_step[channel] += ima_step_index_table[enc];
-	if (adpcm->ima.last_step[channel] < 0)
-		adpcm->ima.last_step[channel] = 0;
-	else if (adpcm->ima.last_step[channel] > 88)
-		adpcm->ima.last_step[channel] = 88;
+			for (k = 0; k < 4; k++, out += 8)
+			{
+				value = dsp_decode_ima_adpcm_nibble(&last_sample, &last_step, src[i + k] & 0x0F);
+				out[0] = (BYTE) (value & 0xFF);
+				out[1] = (BYTE) ((value >> 8) & 0xFF);
+				value = dsp_decode_ima_adpcm_nibble(&last_sample, &last_step, src[i + k] >> 4);
+				out[4] = (BYTE) (value & 0xFF);
+				out[5] = (BYTE) ((value >> 8) & 0xFF);
+			}
+		}
 
-	return enc;
+		adpcm->ima.last_sample[c] = (INT16) last_sample;
+		adpcm->ima.last_step[c] = (INT16) last_step;
+	}
 }
 
-static void freerdp_dsp_encode_ima_adpcm(FREERDP_DSP_CONTEXT* context,
-	const BYTE* src, int size, int channels, int block_size)
+static void dsp_encode_ima_adpcm_data(ADPCM* adpcm, const BYTE* src, int groups, int channels, BYTE* dst)
 {
-	BYTE* dst;
+	int c, g, k;
 	INT16 sample;
 	BYTE encoded;
-	UINT32 out_size;
-	int i;
+	INT32 last_sample;
+	INT32 last_step;
+	const BYTE* in;
 
-	out_size = size / 2;
-	if (out_size > context->adpcm_maxlength)
+	if (channels < 2)
 	{
-		context->adpcm_maxlength = out_size + 1024;
-		context->adpcm_buffer = realloc(context->adpcm_buffer, context->adpcm_maxlength);
+		last_sample = adpcm->ima.last_sample[0];
+		last_step = adpcm->ima.last_step[0];
+
+		for (g = 0; g < groups; g++, src += 4)
+		{
+			sample = (INT16) (((UINT16) src[0]) | (((UINT16) src[1]) << 8));
+			encoded = dsp_encode_ima_adpcm_nibble(&last_sample, &last_step, sample);
+			sample = (INT16) (((UINT16) src[2]) | (((UINT16) src[3]) << 8));
+			encoded |= dsp_encode_ima_adpcm_nibble(&last_sample, &last_step, sample) << 4;
+			*dst++ = encoded;
+		}
+
+		adpcm->ima.last_sample[0] = (INT16) last_sample;
+		adpcm->ima.last_step[0] = (INT16) last_step;
+		return;
 	}
-	dst = context->adpcm_buffer;
-	while (size > 0)
+
+	for (c = 0; c < 2; c++)
 	{
-		if ((dst - context->adpcm_buffer) % block_size == 0)
+		last_sample = adpcm->ima.last_sample[c];
+		last_step = adpcm->ima.last_step[c];
+		in = src + (c << 1);
+
+		for (g = 0; g < groups; g++)
 		{
-			*dst++ = context->adpcm.ima.last_sample[0] & 0xff;
-			*dst++ = (context->adpcm.ima.last_sample[0] >> 8) & 0xff;
-			*dst++ = (BYTE) context->adpcm.ima.last_step[0];
-			*dst++ = 0;
-			if (channels > 1)
+			for (k = 0; k < 4; k++, in += 8)
 			{
-				*dst++ = context->adpcm.ima.last_sample[1] & 0xff;
-				*dst++ = (context->adpcm.ima.last_sample[1] >> 8) & 0xff;
-				*dst++ = (BYTE) context->adpcm.ima.last_step[1];
-				*dst++ = 0;
+				sample = (INT16) (((UINT16) in[0]) | (((UINT16) in[1]) << 8));
+				encoded = dsp_encode_ima_adpcm_nibble(&last_sample, &last_step, sample);
+				sample = (INT16) (((UINT16) in[4]) | (((UINT16) in[5]) << 8));
+				encoded |= dsp_encode_ima_adpcm_nibble(&last_sample, &last_step, sample) << 4;
+				dst[(g << 3) + (c << 2) + k] = encoded;
 			}
 		}
 
-		if (channels > 1)
+		adpcm->ima.last_sample[c] = (INT16) last_sample;
+		adpcm->ima.last_step[c] = (INT16) last_step;
+	}
+}
+
+/**
+ * Stereo blocks only hold whole 8 byte groups after the header, a block size
+ * leaving a partial group cannot be decoded.
+ */
+BOOL freerdp_dsp_ima_adpcm_block_size_valid(int channels, int block_size)
+{
+	int header = IMA_HEADER_SIZE * channels;
+
+	if ((channels < 1) || (channels > 2) || (block_size <= header))
+		return FALSE;
+
+	if ((block_size - header) % ((channels > 1) ? 8 : 1) != 0)
+		return FALSE;
+
+	return TRUE;
+}
+
+int freerdp_dsp_decode_ima_adpcm_blocks(ADPCM* adpcm, const BYTE* src, int size,
+	int channels, int block_size, BYTE* dst, int dst_size)
+{
+	int c;
+	int length;
+	int leading;
+	int blocks;
+	int header = IMA_HEADER_SIZE * channels;
+
+	if ((size < 0) || !freerdp_dsp_ima_adpcm_block_size_valid(channels, block_size))
+		return -1;
+
+	/* blocks are aligned on the end of the input, anything before the first one continues the previous block */
+	leading = size % block_size;
+	blocks = size / block_size;
+	length = (dsp_ima_adpcm_data_size(leading, channels) +
+		blocks * dsp_ima_adpcm_data_size(block_size - header, channels)) * 4;
+
+	if (dst == NULL)
+		return length;
+
+	if (dst_size < length)
+		return -1;
+
+	dsp_decode_ima_adpcm_data(adpcm, src, leading, channels, dst);
+	src += leading;
+	dst += dsp_ima_adpcm_data_size(leading, channels) * 4;
+
+	while (blocks-- > 0)
+	{
+		for (c = 0; c < channels; c++)
 		{
-			memset(dst, 0, 8);
-			for (i = 0; i < 16; i++)
-			{
-				sample = (INT16) (((UINT16)(*src)) | (((UINT16)(*(src + 1))) << 8));
-				src += 2;
-				encoded = dsp_encode_ima_adpcm_sample(&context->adpcm, i % 2, sample);
-				dst[ima_stereo_encode_map[i].byte_num] |= encoded << ima_stereo_encode_map[i].byte_shift;
-			}
-			dst += 8;
-			size -= 32;
+			adpcm->ima.last_sample[c] = (INT16) (((UINT16) src[0]) | (((UINT16) src[1]) << 8));
+			adpcm->ima.last_step[c] = (src[2] > 88) ? 88 : (INT16) src[2];
+			src += IMA_HEADER_SIZE;
 		}
-		else
+
+		dsp_decode_ima_adpcm_data(adpcm, src, block_size - header, channels, dst);
+		src += block_size - header;
+		dst += dsp_ima_adpcm_data_size(block_size - header, channels) * 4;
+	}
+
+	return length;
+}
+
+int freerdp_dsp_encode_ima_adpcm_blocks(ADPCM* adpcm, const BYTE* src, int size,
+	int channels, int block_size, BYTE* dst, int dst_size)
+{
+	int c;
+	int length;
+	int groups;
+	int group_in;
+	int group_out;
+	int block_groups;
+	int header = IMA_HEADER_SIZE * channels;
+
+	if ((size < 0) || !freerdp_dsp_ima_adpcm_block_size_valid(channels, block_size))
+		return -1;
+
+	/* a group is one output byte in mono, or 8 interleaved bytes in stereo */
+	group_out = (channels > 1) ? 8 : 1;
+	group_in = group_out * 4;
+
+	block_groups = (block_size - header) / group_out;
+	groups = size / group_in;
+	length = (groups / block_groups) * block_size;
+
+	if (groups % block_groups)
+		length += header + (groups % block_groups) * group_out;
+
+	if (dst == NULL)
+		return length;
+
+	if (dst_size < length)
+		return -1;
+
+	while (groups > 0)
+	{
+		for (c = 0; c < channels; c++)
 		{
-			sample = (INT16) (((UINT16)(*src)) | (((UINT16)(*(src + 1))) << 8));
-			src += 2;
-			encoded = dsp_encode_ima_adpcm_sample(&context->adpcm, 0, sample);
-			sample = (INT16) (((UINT16)(*src)) | (((UINT16)(*(src + 1))) << 8));
-			src += 2;
-			encoded |= dsp_encode_ima_adpcm_sample(&context->adpcm, 0, sample) << 4;
-			*dst++ = encoded;
-			size -= 4;
+			*dst++ = adpcm->ima.last_sample[c] & 0xFF;
+			*dst++ = (adpcm->ima.last_sample[c] >> 8) & 0xFF;
+			*dst++ = (BYTE) adpcm->ima.last_step[c];
+			*dst++ = 0;
 		}
+
+		if (block_groups > groups)
+			block_groups = groups;
+
+		dsp_encode_ima_adpcm_data(adpcm, src, block_groups, channels, dst);
+		src += block_groups * group_in;
+		dst += block_groups * group_out;
+		groups -= block_groups;
 	}
-	
-	context->adpcm_size = dst - context->adpcm_buffer;
+
+	return length;
 }
 
 /**
@@ -378,217 +856,366 @@ static const INT16 ms_adpcm_coeff2_table[] =
 	0, -256, 0, 64, 0, -208, -232
 };
 
-static INT16 freerdp_dsp_decode_ms_adpcm_sample(ADPCM* adpcm, BYTE sample, int channel)
+#define MS_ADPCM_HEADER_SIZE	7
+
+typedef struct
+{
+	INT32 coeff1;
+	INT32 coeff2;
+	INT32 delta;
+	INT32 sample1;
+	INT32 sample2;
+} MS_ADPCM_CHANNEL;
+
+static INLINE void dsp_ms_adpcm_load(ADPCM* adpcm, int channel, MS_ADPCM_CHANNEL* state)
+{
+	BYTE predictor = adpcm->ms.predictor[channel];
+
+	/* predictors come from the peer, out of range ones fall back to the first pair */
+	if (predictor > 6)
+		predictor = 0;
+
+	state->coeff1 = ms_adpcm_coeff1_table[predictor];
+	state->coeff2 = ms_adpcm_coeff2_table[predictor];
+	state->delta = adpcm->ms.delta[channel];
+	state->sample1 = adpcm->ms.sample1[channel];
+	state->sample2 = adpcm->ms.sample2[channel];
+}
+
+static INLINE void dsp_ms_adpcm_store(ADPCM* adpcm, int channel, MS_ADPCM_CHANNEL* state)
+{
+	adpcm->ms.delta[channel] = state->delta;
+	adpcm->ms.sample1[channel] = state->sample1;
+	adpcm->ms.sample2[channel] = state->sample2;
+}
+
+static INLINE INT16 dsp_decode_ms_adpcm_nibble(MS_ADPCM_CHANNEL* state, BYTE sample)
 {
-	INT8 nibble;
+	INT32 nibble;
 	INT32 presample;
 
-	nibble = (sample & 0x08 ? (INT8)sample - 16 : sample);
-	presample = ((adpcm->ms.sample1[channel] * ms_adpcm_coeff1_table[adpcm->ms.predictor[channel]]) +
-		(adpcm->ms.sample2[channel] * ms_adpcm_coeff2_table[adpcm->ms.predictor[channel]])) / 256;
-	presample += nibble * adpcm->ms.delta[channel];
+	nibble = (sample & 0x08) ? (INT32) sample - 16 : sample;
+	presample = ((state->sample1 * state->coeff1) + (state->sample2 * state->coeff2)) / 256;
+	presample += nibble * state->delta;
+
 	if (presample > 32767)
 		presample = 32767;
 	else if (presample < -32768)
 		presample = -32768;
-	adpcm->ms.sample2[channel] = adpcm->ms.sample1[channel];
-	adpcm->ms.sample1[channel] = presample;
-	adpcm->ms.delta[channel] = adpcm->ms.delta[channel] * ms_adpcm_adaptation_table[sample] / 256;
-	if (adpcm->ms.delta[channel] < 16)
-		adpcm->ms.delta[channel] = 16;
-	return (INT16) presample;
-}
-
-static void freerdp_dsp_decode_ms_adpcm(FREERDP_DSP_CONTEXT* context,
-	const BYTE* src, int size, int channels, int block_size)
-{
-	BYTE* dst;
-	BYTE sample;
-	UINT32 out_size;
 
-	out_size = size * 4;
-	if (out_size > context->adpcm_maxlength)
-	{
-		context->adpcm_maxlength = out_size + 1024;
-		context->adpcm_buffer = realloc(context->adpcm_buffer, context->adpcm_maxlength);
-	}
-	dst = context->adpcm_buffer;
-	while (size > 0)
-	{
-		if (size % block_size == 0)
-		{
-			if (channels > 1)
-			{
-				context->adpcm.ms.predictor[0] = *src++;
-				context->adpcm.ms.predictor[1] = *src++;
-				context->adpcm.ms.delta[0] = *((INT16*)src);
-				src += 2;
-				context->adpcm.ms.delta[1] = *((INT16*)src);
-				src += 2;
-				context->adpcm.ms.sample1[0] = *((INT16*)src);
-				src += 2;
-				context->adpcm.ms.sample1[1] = *((INT16*)src);
-				src += 2;
-				context->adpcm.ms.sample2[0] = *((INT16*)src);
-				src += 2;
-				context->adpcm.ms.sample2[1] = *((INT16*)src);
-				src += 2;
-				size -= 14;
-
-				*((INT16*)dst) = context->adpcm.ms.sample2[0];
-				dst += 2;
-				*((INT16*)dst) = context->adpcm.ms.sample2[1];
-				dst += 2;
-				*((INT16*)dst) = context->adpcm.ms.sample1[0];
-				dst += 2;
-				*((INT16*)dst) = context->adpcm.ms.sample1[1];
-				dst += 2;
-			}
-			else
-			{
-				context->adpcm.ms.predictor[0] = *src++;
-				context->adpcm.ms.delta[0] = *((INT16*)src);
-				src += 2;
-				context->adpcm.ms.sample1[0] = *((INT16*)src);
-				src += 2;
-				context->adpcm.ms.sample2[0] = *((INT16*)src);
-				src += 2;
-				size -= 7;
-
-				*((INT16*)dst) = context->adpcm.ms.sample2[0];
-				dst += 2;
-				*((INT16*)dst) = context->adpcm.ms.sample1[0];
-				dst += 2;
-			}
-		}
+	state->sample2 = state->sample1;
+	state->sample1 = presample;
+	state->delta = state->delta * ms_adpcm_adaptation_table[sample] / 256;
 
-		if (channels > 1)
-		{
-			sample = *src++;
-			size--;
-			*((INT16*)dst) = freerdp_dsp_decode_ms_adpcm_sample(&context->adpcm, sample >> 4, 0);
-			dst += 2;
-			*((INT16*)dst) = freerdp_dsp_decode_ms_adpcm_sample(&context->adpcm, sample & 0x0F, 1);
-			dst += 2;
-
-			sample = *src++;
-			size--;
-			*((INT16*)dst) = freerdp_dsp_decode_ms_adpcm_sample(&context->adpcm, sample >> 4, 0);
-			dst += 2;
-			*((INT16*)dst) = freerdp_dsp_decode_ms_adpcm_sample(&context->adpcm, sample & 0x0F, 1);
-			dst += 2;
-		}
-		else
-		{
-			sample = *src++;
-			size--;
-			*((INT16*)dst) = freerdp_dsp_decode_ms_adpcm_sample(&context->adpcm, sample >> 4, 0);
-			dst += 2;
-			*((INT16*)dst) = freerdp_dsp_decode_ms_adpcm_sample(&context->adpcm, sample & 0x0F, 0);
-			dst += 2;
-		}
-	}
+	if (state->delta < 16)
+		state->delta = 16;
 
-	context->adpcm_size = dst - context->adpcm_buffer;
+	return (INT16) presample;
 }
 
-static BYTE freerdp_dsp_encode_ms_adpcm_sample(ADPCM* adpcm, INT32 sample, int channel)
+static INLINE BYTE dsp_encode_ms_adpcm_nibble(MS_ADPCM_CHANNEL* state, INT32 sample)
 {
 	INT32 presample;
 	INT32 errordelta;
 
-	presample = ((adpcm->ms.sample1[channel] * ms_adpcm_coeff1_table[adpcm->ms.predictor[channel]]) +
-		(adpcm->ms.sample2[channel] * ms_adpcm_coeff2_table[adpcm->ms.predictor[channel]])) / 256;
-	errordelta = (sample - presample) / adpcm->ms.delta[channel];
-	if ((sample - presample) % adpcm->ms.delta[channel] > adpcm->ms.delta[channel] / 2)
+	presample = ((state->sample1 * state->coeff1) + (state->sample2 * state->coeff2)) / 256;
+	errordelta = (sample - presample) / state->delta;
+
+	if ((sample - presample) % state->delta > state->delta / 2)
 		errordelta++;
+
 	if (errordelta > 7)
 		errordelta = 7;
 	else if (errordelta < -8)
 		errordelta = -8;
-	presample += adpcm->ms.delta[channel] * errordelta;
+
+	presample += state->delta * errordelta;
+
 	if (presample > 32767)
 		presample = 32767;
 	else if (presample < -32768)
 		presample = -32768;
-	adpcm->ms.sample2[channel] = adpcm->ms.sample1[channel];
-	adpcm->ms.sample1[channel] = presample;
-	adpcm->ms.delta[channel] = adpcm->ms.delta[channel] * ms_adpcm_adaptation_table[(((BYTE)errordelta) & 0x0F)] / 256;
-	if (adpcm->ms.delta[channel] < 16)
-		adpcm->ms.delta[channel] = 16;
-	return ((BYTE)errordelta) & 0x0F;
+
+	state->sample2 = state->sample1;
+	state->sample1 = presample;
+	state->delta = state->delta * ms_adpcm_adaptation_table[((BYTE) errordelta) & 0x0F] / 256;
+
+	if (state->delta < 16)
+		state->delta = 16;
+
+	return ((BYTE) errordelta) & 0x0F;
 }
 
-static void freerdp_dsp_encode_ms_adpcm(FREERDP_DSP_CONTEXT* context,
-	const BYTE* src, int size, int channels, int block_size)
+/**
+ * MS ADPCM block data: each byte carries two samples, high nibble first.
+ * In stereo the high nibble is the left channel and the low nibble the right one.
+ */
+static int dsp_ms_adpcm_data_size(int size, int channels)
 {
-	BYTE* dst;
-	INT32 sample;
-	UINT32 out_size;
+	return (channels > 1) ? (size & ~1) : size;
+}
+
+static void dsp_decode_ms_adpcm_data(ADPCM* adpcm, const BYTE* src, int size, int channels, BYTE* dst)
+{
+	int i;
+	INT16 value;
+	MS_ADPCM_CHANNEL state[2];
+	MS_ADPCM_CHANNEL* second;
 
-	out_size = size / 2;
-	if (out_size > context->adpcm_maxlength)
+	dsp_ms_adpcm_load(adpcm, 0, &state[0]);
+
+	if (channels > 1)
+		dsp_ms_adpcm_load(adpcm, 1, &state[1]);
+
+	second = (channels > 1) ? &state[1] : &state[0];
+	size = dsp_ms_adpcm_data_size(size, channels);
+
+	for (i = 0; i < size; i++)
 	{
-		context->adpcm_maxlength = out_size + 1024;
-		context->adpcm_buffer = realloc(context->adpcm_buffer, context->adpcm_maxlength);
+		value = dsp_decode_ms_adpcm_nibble(&state[0], src[i] >> 4);
+		*dst++ = (BYTE) (value & 0xFF);
+		*dst++ = (BYTE) ((value >> 8) & 0xFF);
+		value = dsp_decode_ms_adpcm_nibble(second, src[i] & 0x0F);
+		*dst++ = (BYTE) (value & 0xFF);
+		*dst++ = (BYTE) ((value >> 8) & 0xFF);
+	}
+
+	dsp_ms_adpcm_store(adpcm, 0, &state[0]);
+
+	if (channels > 1)
+		dsp_ms_adpcm_store(adpcm, 1, &state[1]);
+}
+
+static void dsp_encode_ms_adpcm_data(ADPCM* adpcm, const BYTE* src, int size, int channels, BYTE* dst)
+{
+	int i;
+	INT16 sample;
+	BYTE encoded;
+	MS_ADPCM_CHANNEL state[2];
+	MS_ADPCM_CHANNEL* second;
+
+	dsp_ms_adpcm_load(adpcm, 0, &state[0]);
+
+	if (channels > 1)
+		dsp_ms_adpcm_load(adpcm, 1, &state[1]);
+
+	second = (channels > 1) ? &state[1] : &state[0];
+
+	for (i = 0; i < size; i++, src += 4)
+	{
+		sample = (INT16) (((UINT16) src[0]) | (((UINT16) src[1]) << 8));
+		encoded = dsp_encode_ms_adpcm_nibble(&state[0], sample) << 4;
+		sample = (INT16) (((UINT16) src[2]) | (((UINT16) src[3]) << 8));
+		encoded += dsp_encode_ms_adpcm_nibble(second, sample);
+		*dst++ = encoded;
 	}
-	dst = context->adpcm_buffer;
 
-	if (context->adpcm.ms.delta[0] < 16)
-		context->adpcm.ms.delta[0] = 16;
-	if (context->adpcm.ms.delta[1] < 16)
-		context->adpcm.ms.delta[1] = 16;
+	dsp_ms_adpcm_store(adpcm, 0, &state[0]);
+
+	if (channels > 1)
+		dsp_ms_adpcm_store(adpcm, 1, &state[1]);
+}
+
+int freerdp_dsp_decode_ms_adpcm_blocks(ADPCM* adpcm, const BYTE* src, int size,
+	int channels, int block_size, BYTE* dst, int dst_size)
+{
+	int c;
+	int length;
+	int leading;
+	int blocks;
+	int header = MS_ADPCM_HEADER_SIZE * channels;
+
+	if ((size < 0) || (channels < 1) || (channels > 2) || (block_size <= header))
+		return -1;
+
+	/* blocks are aligned on the end of the input, anything before the first one continues the previous block */
+	leading = size % block_size;
+	blocks = size / block_size;
+	length = (dsp_ms_adpcm_data_size(leading, channels) +
+		blocks * dsp_ms_adpcm_data_size(block_size - header, channels)) * 4 + blocks * channels * 4;
+
+	if (dst == NULL)
+		return length;
 
-	while (size > 0)
+	if (dst_size < length)
+		return -1;
+
+	dsp_decode_ms_adpcm_data(adpcm, src, leading, channels, dst);
+	src += leading;
+	dst += dsp_ms_adpcm_data_size(leading, channels) * 4;
+
+	while (blocks-- > 0)
 	{
-		if ((dst - context->adpcm_buffer) % block_size == 0)
+		/* predictors, deltas, then the two initial samples of each channel */
+		for (c = 0; c < channels; c++)
+			adpcm->ms.predictor[c] = src[c];
+		src += channels;
+
+		for (c = 0; c < channels; c++, src += 2)
+			adpcm->ms.delta[c] = (INT16) (((UINT16) src[0]) | (((UINT16) src[1]) << 8));
+
+		for (c = 0; c < channels; c++, src += 2)
+			adpcm->ms.sample1[c] = (INT16) (((UINT16) src[0]) | (((UINT16) src[1]) << 8));
+
+		for (c = 0; c < channels; c++, src += 2)
+			adpcm->ms.sample2[c] = (INT16) (((UINT16) src[0]) | (((UINT16) src[1]) << 8));
+
+		/* the header samples are output oldest first */
+		for (c = 0; c < channels; c++)
 		{
-			if (channels > 1)
-			{
-				*dst++ = context->adpcm.ms.predictor[0];
-				*dst++ = context->adpcm.ms.predictor[1];
-				*dst++ = (BYTE) (context->adpcm.ms.delta[0] & 0xff);
-				*dst++ = (BYTE) ((context->adpcm.ms.delta[0] >> 8) & 0xff);
-				*dst++ = (BYTE) (context->adpcm.ms.delta[1] & 0xff);
-				*dst++ = (BYTE) ((context->adpcm.ms.delta[1] >> 8) & 0xff);
-				context->adpcm.ms.sample1[0] = *((INT16*) (src + 4));
-				context->adpcm.ms.sample1[1] = *((INT16*) (src + 6));
-				context->adpcm.ms.sample2[0] = *((INT16*) (src + 0));
-				context->adpcm.ms.sample2[1] = *((INT16*) (src + 2));
-				*((INT16*) (dst + 0)) = (INT16) context->adpcm.ms.sample1[0];
-				*((INT16*) (dst + 2)) = (INT16) context->adpcm.ms.sample1[1];
-				*((INT16*) (dst + 4)) = (INT16) context->adpcm.ms.sample2[0];
-				*((INT16*) (dst + 6)) = (INT16) context->adpcm.ms.sample2[1];
-				dst += 8;
-				src += 8;
-				size -= 8;
-			}
-			else
-			{
-				*dst++ = context->adpcm.ms.predictor[0];
-				*dst++ = (BYTE) (context->adpcm.ms.delta[0] & 0xff);
-				*dst++ = (BYTE) ((context->adpcm.ms.delta[0] >> 8) & 0xff);
-				context->adpcm.ms.sample1[0] = *((INT16*) (src + 2));
-				context->adpcm.ms.sample2[0] = *((INT16*) (src + 0));
-				*((INT16*) (dst + 0)) = (INT16) context->adpcm.ms.sample1[0];
-				*((INT16*) (dst + 2)) = (INT16) context->adpcm.ms.sample2[0];
-				dst += 4;
-				src += 4;
-				size -= 4;
-			}
+			*dst++ = (BYTE) (adpcm->ms.sample2[c] & 0xFF);
+			*dst++ = (BYTE) ((adpcm->ms.sample2[c] >> 8) & 0xFF);
+		}
+
+		for (c = 0; c < channels; c++)
+		{
+			*dst++ = (BYTE) (adpcm->ms.sample1[c] & 0xFF);
+			*dst++ = (BYTE) ((adpcm->ms.sample1[c] >> 8) & 0xFF);
+		}
+
+		dsp_decode_ms_adpcm_data(adpcm, src, block_size - header, channels, dst);
+		src += block_size - header;
+		dst += dsp_ms_adpcm_data_size(block_size - header, channels) * 4;
+	}
+
+	return length;
+}
+
+int freerdp_dsp_encode_ms_adpcm_blocks(ADPCM* adpcm, const BYTE* src, int size,
+	int channels, int block_size, BYTE* dst, int dst_size)
+{
+	int c;
+	int count;
+	int length;
+	int block_in;
+	int header_in;
+	int header = MS_ADPCM_HEADER_SIZE * channels;
+
+	if ((size < 0) || (channels < 1) || (channels > 2) || (block_size <= header))
+		return -1;
+
+	/* each block starts with two frames stored verbatim in the header */
+	header_in = 4 * channels;
+	block_in = header_in + (block_size - header) * 4;
+	length = (size / block_in) * block_size;
+
+	if ((size % block_in) >= header_in)
+		length += header + ((size % block_in) - header_in) / 4;
+
+	if (dst == NULL)
+		return length;
+
+	if (dst_size < length)
+		return -1;
+
+	if (adpcm->ms.delta[0] < 16)
+		adpcm->ms.delta[0] = 16;
+	if (adpcm->ms.delta[1] < 16)
+		adpcm->ms.delta[1] = 16;
+
+	while (size >= header_in)
+	{
+		for (c = 0; c < channels; c++)
+			*dst++ = adpcm->ms.predictor[c];
+
+		for (c = 0; c < channels; c++)
+		{
+			*dst++ = (BYTE) (adpcm->ms.delta[c] & 0xFF);
+			*dst++ = (BYTE) ((adpcm->ms.delta[c] >> 8) & 0xFF);
+		}
+
+		for (c = 0; c < channels; c++)
+		{
+			adpcm->ms.sample2[c] = (INT16) (((UINT16) src[c * 2]) | (((UINT16) src[c * 2 + 1]) << 8));
+			adpcm->ms.sample1[c] = (INT16) (((UINT16) src[header_in / 2 + c * 2]) |
+				(((UINT16) src[header_in / 2 + c * 2 + 1]) << 8));
+		}
+
+		for (c = 0; c < channels; c++)
+		{
+			*dst++ = (BYTE) (adpcm->ms.sample1[c] & 0xFF);
+			*dst++ = (BYTE) ((adpcm->ms.sample1[c] >> 8) & 0xFF);
+		}
+
+		for (c = 0; c < channels; c++)
+		{
+			*dst++ = (BYTE) (adpcm->ms.sample2[c] & 0xFF);
+			*dst++ = (BYTE) ((adpcm->ms.sample2[c] >> 8) & 0xFF);
 		}
 
-		sample = *((INT16*) src);
-		src += 2;
-		*dst = freerdp_dsp_encode_ms_adpcm_sample(&context->adpcm, sample, 0) << 4;
-		sample = *((INT16*) src);
-		src += 2;
-		*dst += freerdp_dsp_encode_ms_adpcm_sample(&context->adpcm, sample, channels > 1 ? 1 : 0);
-		dst++;
-		size -= 4;
+		src += header_in;
+		size -= header_in;
+
+		count = size / 4;
+
+		if (count > block_size - header)
+			count = block_size - header;
+
+		dsp_encode_ms_adpcm_data(adpcm, src, count, channels, dst);
+		src += count * 4;
+		dst += count;
+		size -= count * 4;
+
+		if (count < block_size - header)
+			break;
+	}
+
+	return length;
+}
+
+typedef int (*pAdpcmCodec)(ADPCM* adpcm, const BYTE* src, int size,
+	int channels, int block_size, BYTE* dst, int dst_size);
+
+/**
+ * Runs a block codec into the context buffer, which only grows when a
+ * larger payload than ever before comes through.
+ */
+static void dsp_adpcm_convert(FREERDP_DSP_CONTEXT* context, pAdpcmCodec codec,
+	const BYTE* src, int size, int channels, int block_size)
+{
+	int length;
+
+	context->adpcm_size = 0;
+	length = codec(&context->adpcm, src, size, channels, block_size, NULL, 0);
+
+	if (length <= 0)
+		return;
+
+	if (length > (int) context->adpcm_maxlength)
+	{
+		context->adpcm_maxlength = length;
+		context->adpcm_buffer = realloc(context->adpcm_buffer, context->adpcm_maxlength);
 	}
-	
-	context->adpcm_size = dst - context->adpcm_buffer;
+
+	length = codec(&context->adpcm, src, size, channels, block_size,
+		context->adpcm_buffer, context->adpcm_maxlength);
+
+	if (length > 0)
+		context->adpcm_size = length;
+}
+
+static void freerdp_dsp_decode_ima_adpcm(FREERDP_DSP_CONTEXT* context,
+	const BYTE* src, int size, int channels, int block_size)
+{
+	dsp_adpcm_convert(context, freerdp_dsp_decode_ima_adpcm_blocks, src, size, channels, block_size);
+}
+
+static void freerdp_dsp_encode_ima_adpcm(FREERDP_DSP_CONTEXT* context,
+	const BYTE* src, int size, int channels, int block_size)
+{
+	dsp_adpcm_convert(context, freerdp_dsp_encode_ima_adpcm_blocks, src, size, channels, block_size);
+}
+
+static void freerdp_dsp_decode_ms_adpcm(FREERDP_DSP_CONTEXT* context,
+	const BYTE* src, int size, int channels, int block_size)
+{
+	dsp_adpcm_convert(context, freerdp_dsp_decode_ms_adpcm_blocks, src, size, channels, block_size);
+}
+
+static void freerdp_dsp_encode_ms_adpcm(FREERDP_DSP_CONTEXT* context,
+	const BYTE* src, int size, int channels, int block_size)
+{
+	dsp_adpcm_convert(context, freerdp_dsp_encode_ms_adpcm_blocks, src, size, channels, block_size);
 }
 
 FREERDP_DSP_CONTEXT* freerdp_dsp_context_new(void)
@@ -598,6 +1225,7 @@ FREERDP_DSP_CONTEXT* freerdp_dsp_context_new(void)
 	context = xnew(FREERDP_DSP_CONTEXT);
 
 	context->resample = freerdp_dsp_resample;
+	context->resample_quality = FREERDP_DSP_RESAMPLE_MEDIUM;
 	context->decode_ima_adpcm = freerdp_dsp_decode_ima_adpcm;
 	context->encode_ima_adpcm = freerdp_dsp_encode_ima_adpcm;
 	context->decode_ms_adpcm = freerdp_dsp_decode_ms_adpcm;
@@ -612,6 +1240,7 @@ void freerdp_dsp_context_free(FREERDP_DSP_CONTEXT* context)
 	{
 		if (context->resampled_buffer)
 			free(context->resampled_buffer);
+		dsp_resampler_free(context->resampler);
 		if (context->adpcm_buffer)
 			free(context->adpcm_buffer);
 		free(context);
@@ -0,0 +1,341 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Runtime Metrics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <time.h>
+#include <sys/time.h>
+#endif
+
+#include <winpr/crt.h>
+#include <winpr/thread.h>
+#include <winpr/interlocked.h>
+
+#include <freerdp/utils/memory.h>
+#include <freerdp/utils/metrics.h>
+
+rdpMetrics* metrics_new(void)
+{
+	rdpMetrics* metrics;
+
+	metrics = (rdpMetrics*) xzalloc(sizeof(rdpMetrics));
+
+	if (metrics != NULL)
+	{
+		metrics->enabled = FALSE;
+		metrics->tls_index = TlsAlloc();
+		metrics->shard_count = 0;
+	}
+
+	return metrics;
+}
+
+void metrics_free(rdpMetrics* metrics)
+{
+	int index;
+
+	if (metrics == NULL)
+		return;
+
+	if (metrics->tls_index != TLS_OUT_OF_INDEXES)
+		TlsFree(metrics->tls_index);
+
+	for (index = 0; index < METRICS_MAX_SHARDS; index++)
+		free(metrics->shards[index]);
+
+	free(metrics);
+}
+
+void metrics_enable(rdpMetrics* metrics, BOOL enabled)
+{
+	metrics->enabled = enabled;
+}
+
+/**
+ * Get the shard of the calling thread, claiming a slot the first time the
+ * thread records something. Slots are never given back, so the counts of a
+ * thread that exited remain part of the totals.
+ * @return the shard, NULL if the thread has to use the overflow shard
+ */
+
+static rdpMetricsShard* metrics_get_shard(rdpMetrics* metrics)
+{
+	LONG index;
+	rdpMetricsShard* shard;
+
+	if (metrics->tls_index == TLS_OUT_OF_INDEXES)
+		return NULL;
+
+	shard = (rdpMetricsShard*) TlsGetValue(metrics->tls_index);
+
+	if (shard != NULL)
+		return shard;
+
+	if (metrics->shard_count >= METRICS_MAX_SHARDS)
+		return NULL;
+
+	index = InterlockedIncrement(&metrics->shard_count) - 1;
+
+	if (index >= METRICS_MAX_SHARDS)
+		return NULL;
+
+	shard = (rdpMetricsShard*) xzalloc(sizeof(rdpMetricsShard));
+
+	if (shard == NULL)
+		return NULL;
+
+	metrics->shards[index] = shard;
+	TlsSetValue(metrics->tls_index, shard);
+
+	return shard;
+}
+
+static void metrics_atomic_add(UINT64* target, UINT64 value)
+{
+	LONGLONG old;
+
+	do
+	{
+		old = *((volatile LONGLONG*) target);
+	}
+	while (InterlockedCompareExchange64((LONGLONG*) target, old + value, old) != old);
+}
+
+void metrics_add_counter(rdpMetrics* metrics, int counter, UINT64 value)
+{
+	rdpMetricsShard* shard;
+
+	if (!metrics->enabled)
+		return;
+
+	shard = metrics_get_shard(metrics);
+
+	if (shard != NULL)
+		shard->counters[counter] += value;
+	else
+		metrics_atomic_add(&metrics->overflow.counters[counter], value);
+}
+
+/**
+ * Map a value to its log-linear bucket: the position of the highest bit
+ * set selects the power of two, the two bits below it the sub-bucket.
+ */
+
+int metrics_histogram_bucket(UINT64 value)
+{
+	int shift;
+	int exponent;
+
+	if (value < METRICS_HISTOGRAM_SUB_BUCKETS)
+		return (int) value;
+
+	exponent = 0;
+
+	for (shift = 32; shift > 0; shift >>= 1)
+	{
+		if (value >> (exponent + shift))
+			exponent += shift;
+	}
+
+	return ((exponent - 1) * METRICS_HISTOGRAM_SUB_BUCKETS) + (int) ((value >> (exponent - 2)) & 3);
+}
+
+/**
+ * Lowest value falling into a bucket.
+ */
+
+UINT64 metrics_histogram_bucket_value(int bucket)
+{
+	int exponent;
+
+	if (bucket < METRICS_HISTOGRAM_SUB_BUCKETS)
+		return bucket;
+
+	exponent = (bucket / METRICS_HISTOGRAM_SUB_BUCKETS) + 1;
+
+	return ((UINT64) (METRICS_HISTOGRAM_SUB_BUCKETS + (bucket % METRICS_HISTOGRAM_SUB_BUCKETS))) << (exponent - 2);
+}
+
+void metrics_record(rdpMetrics* metrics, int histogram, UINT64 value)
+{
+	int bucket;
+	rdpMetricsShard* shard;
+	rdpMetricsHistogram* entry;
+
+	if (!metrics->enabled)
+		return;
+
+	bucket = metrics_histogram_bucket(value);
+	shard = metrics_get_shard(metrics);
+
+	if (shard != NULL)
+	{
+		entry = &shard->histograms[histogram];
+		entry->count++;
+		entry->sum += value;
+		entry->buckets[bucket]++;
+	}
+	else
+	{
+		entry = &metrics->overflow.histograms[histogram];
+		metrics_atomic_add(&entry->count, 1);
+		metrics_atomic_add(&entry->sum, value);
+		metrics_atomic_add(&entry->buckets[bucket], 1);
+	}
+}
+
+/**
+ * Monotonic time in nanoseconds.
+ */
+
+UINT64 metrics_time(void)
+{
+#ifdef _WIN32
+	LARGE_INTEGER counter;
+	LARGE_INTEGER frequency;
+
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+
+	return ((counter.QuadPart / frequency.QuadPart) * 1000000000) +
+		(((counter.QuadPart % frequency.QuadPart) * 1000000000) / frequency.QuadPart);
+#elif defined(CLOCK_MONOTONIC)
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ((UINT64) ts.tv_sec * 1000000000) + ts.tv_nsec;
+#else
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+
+	return ((UINT64) tv.tv_sec * 1000000000) + (tv.tv_usec * 1000);
+#endif
+}
+
+/**
+ * Start timing a stage.
+ * @return start time, 0 when recording is disabled
+ */
+
+UINT64 metrics_start(rdpMetrics* metrics)
+{
+	if (!METRICS_ENABLED(metrics))
+		return 0;
+
+	return metrics_time();
+}
+
+void metrics_stop(rdpMetrics* metrics, int histogram, UINT64 start)
+{
+	if ((start == 0) || !METRICS_ENABLED(metrics))
+		return;
+
+	metrics_record(metrics, histogram, metrics_time() - start);
+}
+
+static void metrics_merge(rdpMetricsSnapshot* snapshot, rdpMetricsShard* shard)
+{
+	int i, j;
+	rdpMetricsHistogram* src;
+	rdpMetricsHistogram* dst;
+
+	for (i = 0; i < METRICS_COUNTER_COUNT; i++)
+		snapshot->counters[i] += shard->counters[i];
+
+	for (i = 0; i < METRICS_HISTOGRAM_COUNT; i++)
+	{
+		src = &shard->histograms[i];
+		dst = &snapshot->histograms[i];
+
+		if (src->count == 0)
+			continue;
+
+		dst->count += src->count;
+		dst->sum += src->sum;
+
+		for (j = 0; j < METRICS_HISTOGRAM_BUCKETS; j++)
+			dst->buckets[j] += src->buckets[j];
+	}
+}
+
+/**
+ * Sum all shards into a snapshot. Writers are not stopped, a snapshot taken
+ * while threads record is exact for every value it read, not across values.
+ */
+
+void metrics_snapshot(rdpMetrics* metrics, rdpMetricsSnapshot* snapshot)
+{
+	int index;
+	int count;
+	rdpMetricsShard* shard;
+
+	ZeroMemory(snapshot, sizeof(rdpMetricsSnapshot));
+
+	if (metrics == NULL)
+		return;
+
+	metrics_merge(snapshot, &metrics->overflow);
+
+	count = MIN(metrics->shard_count, METRICS_MAX_SHARDS);
+
+	for (index = 0; index < count; index++)
+	{
+		shard = metrics->shards[index];
+
+		/* the slot is claimed but the shard not published yet */
+		if (shard == NULL)
+			continue;
+
+		metrics_merge(snapshot, shard);
+	}
+}
+
+/**
+ * Estimate a percentile from a histogram.
+ * @return lowest value of the bucket holding the percentile
+ */
+
+UINT64 metrics_histogram_percentile(rdpMetricsHistogram* histogram, int percent)
+{
+	int bucket;
+	UINT64 rank;
+	UINT64 seen = 0;
+
+	rank = ((histogram->count * percent) + 99) / 100;
+
+	if (rank == 0)
+		return 0;
+
+	for (bucket = 0; bucket < METRICS_HISTOGRAM_BUCKETS; bucket++)
+	{
+		seen += histogram->buckets[bucket];
+
+		if (seen >= rank)
+			return metrics_histogram_bucket_value(bucket);
+	}
+
+	return 0;
+}
@@ -193,14 +193,30 @@ rdpPcap* pcap_open(char* name, BOOL write)
 	return pcap;
 }
 
+/**
+ * Write the records added since the last flush. Records do not own their
+ * data, so they are released once written and the data can be reused.
+ */
+
 void pcap_flush(rdpPcap* pcap)
 {
+	pcap_record* record;
+
 	while (pcap->record != NULL)
 	{
 		pcap_write_record(pcap, pcap->record);
 		pcap->record = pcap->record->next;
 	}
 
+	while (pcap->head != NULL)
+	{
+		record = pcap->head;
+		pcap->head = record->next;
+		free(record);
+	}
+
+	pcap->tail = NULL;
+
 	if (pcap->fp != NULL)
 		fflush(pcap->fp);
 }
@@ -211,4 +227,6 @@ void pcap_close(rdpPcap* pcap)
 
 	if (pcap->fp != NULL)
 		fclose(pcap->fp);
+
+	free(pcap);
 }
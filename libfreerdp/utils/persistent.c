@@ -0,0 +1,452 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Persistent Bitmap Cache
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include <winpr/crt.h>
+
+#include <freerdp/utils/file.h>
+#include <freerdp/utils/stream.h>
+#include <freerdp/utils/memory.h>
+
+#include <freerdp/utils/persistent.h>
+
+/**
+ * Cache file layout, all fields little endian:
+ *
+ * header: signature (4 bytes), version (4 bytes), count (4 bytes), reserved (4 bytes)
+ * entry: key (8 bytes), width (2 bytes), height (2 bytes), bpp (1 byte), flags (1 byte),
+ *        cacheId (1 byte), pad (1 byte), length (4 bytes), crc (4 bytes), data (length bytes)
+ *
+ * The crc of an entry covers the 20 bytes preceding it as well as the bitmap data.
+ */
+
+#define PERSISTENT_CACHE_SIGNATURE		0x434D4250 /* "PBMC" */
+#define PERSISTENT_CACHE_VERSION		1
+#define PERSISTENT_CACHE_HEADER_LENGTH		16
+#define PERSISTENT_CACHE_ENTRY_LENGTH		24
+
+static UINT32 crc32_table[256];
+static BOOL crc32_table_ready = FALSE;
+
+static void persistent_cache_init_crc32(void)
+{
+	int i, j;
+	UINT32 crc;
+
+	for (i = 0; i < 256; i++)
+	{
+		crc = (UINT32) i;
+
+		for (j = 0; j < 8; j++)
+			crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320 : (crc >> 1);
+
+		crc32_table[i] = crc;
+	}
+
+	crc32_table_ready = TRUE;
+}
+
+static UINT32 persistent_cache_crc32(UINT32 crc, BYTE* data, UINT32 length)
+{
+	UINT32 i;
+
+	if (!crc32_table_ready)
+		persistent_cache_init_crc32();
+
+	crc = ~crc;
+
+	for (i = 0; i < length; i++)
+		crc = crc32_table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+
+	return ~crc;
+}
+
+static BOOL persistent_cache_map(rdpPersistentCache* persistent, char* filename)
+{
+#ifndef _WIN32
+	int fd;
+	void* map;
+	struct stat st;
+
+	fd = open(filename, O_RDONLY);
+
+	if (fd < 0)
+		return FALSE;
+
+	if ((fstat(fd, &st) != 0) || (st.st_size < PERSISTENT_CACHE_HEADER_LENGTH) || (st.st_size > 0x7FFFFFFF))
+	{
+		close(fd);
+		return FALSE;
+	}
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (map == MAP_FAILED)
+		return FALSE;
+
+	persistent->map = (BYTE*) map;
+	persistent->map_size = (UINT32) st.st_size;
+#else
+	FILE* fp;
+	long size;
+
+	fp = fopen(filename, "rb");
+
+	if (fp == NULL)
+		return FALSE;
+
+	fseek(fp, 0, SEEK_END);
+	size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+
+	if (size < PERSISTENT_CACHE_HEADER_LENGTH)
+	{
+		fclose(fp);
+		return FALSE;
+	}
+
+	persistent->map = (BYTE*) malloc(size);
+
+	if (fread(persistent->map, size, 1, fp) != 1)
+	{
+		free(persistent->map);
+		persistent->map = NULL;
+		fclose(fp);
+		return FALSE;
+	}
+
+	fclose(fp);
+	persistent->map_size = (UINT32) size;
+#endif
+
+	return TRUE;
+}
+
+static void persistent_cache_unmap(rdpPersistentCache* persistent)
+{
+	if (persistent->map == NULL)
+		return;
+
+#ifndef _WIN32
+	munmap(persistent->map, persistent->map_size);
+#else
+	free(persistent->map);
+#endif
+
+	persistent->map = NULL;
+	persistent->map_size = 0;
+}
+
+/**
+ * Load the entries of a cache file. The bitmap data is not copied,
+ * entries point into the mapped file until the cache is freed.
+ * Loading stops at the first truncated or corrupted entry, a missing
+ * file simply yields an empty cache.
+ * @param persistent persistent cache
+ * @param filename cache file
+ * @return number of entries loaded, or -1 if the file is not a cache file
+ */
+
+int persistent_cache_open(rdpPersistentCache* persistent, char* filename)
+{
+	STREAM* s;
+	BYTE* mark;
+	UINT32 crc;
+	UINT32 count;
+	UINT32 version;
+	UINT32 signature;
+	PERSISTENT_CACHE_ENTRY* entry;
+
+	free(persistent->entries);
+	persistent->entries = NULL;
+	persistent->count = 0;
+	persistent_cache_unmap(persistent);
+
+	free(persistent->filename);
+	persistent->filename = _strdup(filename);
+
+	if (!persistent_cache_map(persistent, filename))
+		return 0;
+
+	s = stream_new(0);
+	stream_attach(s, persistent->map, persistent->map_size);
+
+	stream_read_UINT32(s, signature); /* signature (4 bytes) */
+	stream_read_UINT32(s, version); /* version (4 bytes) */
+	stream_read_UINT32(s, count); /* count (4 bytes) */
+	stream_seek_UINT32(s); /* reserved (4 bytes) */
+
+	if ((signature != PERSISTENT_CACHE_SIGNATURE) || (version != PERSISTENT_CACHE_VERSION) ||
+		(count > (persistent->map_size - PERSISTENT_CACHE_HEADER_LENGTH) / PERSISTENT_CACHE_ENTRY_LENGTH))
+	{
+		printf("persistent_cache_open: %s is not a bitmap cache file\n", filename);
+		stream_detach(s);
+		stream_free(s);
+		persistent_cache_unmap(persistent);
+		return -1;
+	}
+
+	persistent->entries = (PERSISTENT_CACHE_ENTRY*) xzalloc(sizeof(PERSISTENT_CACHE_ENTRY) * (count + 1));
+
+	while (persistent->count < (int) count)
+	{
+		if (stream_get_left(s) < PERSISTENT_CACHE_ENTRY_LENGTH)
+			break;
+
+		entry = &persistent->entries[persistent->count];
+		stream_get_mark(s, mark);
+
+		stream_read_UINT64(s, entry->key); /* key (8 bytes) */
+		stream_read_UINT16(s, entry->width); /* width (2 bytes) */
+		stream_read_UINT16(s, entry->height); /* height (2 bytes) */
+		stream_read_BYTE(s, entry->bpp); /* bpp (1 byte) */
+		stream_read_BYTE(s, entry->flags); /* flags (1 byte) */
+		stream_read_BYTE(s, entry->cacheId); /* cacheId (1 byte) */
+		stream_seek_BYTE(s); /* pad (1 byte) */
+		stream_read_UINT32(s, entry->length); /* length (4 bytes) */
+		stream_read_UINT32(s, crc); /* crc (4 bytes) */
+
+		if (stream_get_left(s) < (int) entry->length)
+			break;
+
+		entry->data = stream_get_tail(s);
+
+		if (persistent_cache_crc32(persistent_cache_crc32(0, mark, 20), entry->data, entry->length) != crc)
+		{
+			printf("persistent_cache_open: corrupted entry %d in %s\n", persistent->count, filename);
+			break;
+		}
+
+		stream_seek(s, entry->length);
+		persistent->count++;
+	}
+
+	memset(&persistent->entries[persistent->count], 0, sizeof(PERSISTENT_CACHE_ENTRY));
+
+	stream_detach(s);
+	stream_free(s);
+
+	return persistent->count;
+}
+
+/**
+ * Open the cache file of the settings and spread its entries over the bitmap
+ * cache cells, in file order and up to the size of each cell. The keys go to
+ * the cell info of the settings in the order of the persistent key list, which
+ * is how the server maps them to cache indices.
+ * @param persistent persistent cache
+ * @param settings settings
+ * @param cells if not NULL, receives the entries of each cell
+ * @return number of keys loaded
+ */
+
+int persistent_cache_load_keys(rdpPersistentCache* persistent, rdpSettings* settings, PERSISTENT_CACHE_ENTRY** cells)
+{
+	int i;
+	UINT32 id;
+	int count = 0;
+	PERSISTENT_CACHE_ENTRY* entry;
+	BITMAP_CACHE_V2_CELL_INFO* cellInfo;
+
+	if (settings->bitmap_cache_persist_file == NULL)
+	{
+		settings->bitmap_cache_persist_file =
+			freerdp_construct_path(freerdp_get_config_path(settings), "bmpcache.bin");
+	}
+
+	for (i = 0; i < (int) settings->bitmapCacheV2NumCells; i++)
+	{
+		cellInfo = &settings->bitmapCacheV2CellInfo[i];
+
+		free(cellInfo->persistentKeys);
+		cellInfo->persistent = TRUE;
+		cellInfo->numPersistentKeys = 0;
+		cellInfo->persistentKeys = (UINT64*) xzalloc(sizeof(UINT64) * (cellInfo->numEntries + 1));
+	}
+
+	if (persistent_cache_open(persistent, settings->bitmap_cache_persist_file) <= 0)
+		return 0;
+
+	for (i = 0; i < persistent->count; i++)
+	{
+		entry = &persistent->entries[i];
+		id = entry->cacheId;
+
+		if (id >= settings->bitmapCacheV2NumCells)
+			continue;
+
+		cellInfo = &settings->bitmapCacheV2CellInfo[id];
+
+		if (cellInfo->numPersistentKeys >= cellInfo->numEntries)
+			continue;
+
+		if (cells != NULL)
+			cells[id][cellInfo->numPersistentKeys] = *entry;
+
+		cellInfo->persistentKeys[cellInfo->numPersistentKeys] = entry->key;
+		cellInfo->numPersistentKeys++;
+		count++;
+	}
+
+	return count;
+}
+
+/**
+ * Write a cache file. The file is written next to the target and renamed
+ * over it once complete, so a cache file that is currently mapped stays valid.
+ * @param filename cache file
+ * @param entries entries to save
+ * @param count number of entries
+ * @return TRUE on success
+ */
+
+BOOL persistent_cache_write(char* filename, PERSISTENT_CACHE_ENTRY** entries, int count)
+{
+	int i;
+	FILE* fp;
+	STREAM* s;
+	UINT32 crc;
+	char* tmpname;
+	BOOL status = TRUE;
+	PERSISTENT_CACHE_ENTRY* entry;
+
+	tmpname = (char*) malloc(strlen(filename) + 5);
+	sprintf(tmpname, "%s.tmp", filename);
+
+	fp = fopen(tmpname, "wb");
+
+	if (fp == NULL)
+	{
+		free(tmpname);
+		return FALSE;
+	}
+
+	s = stream_new(PERSISTENT_CACHE_ENTRY_LENGTH);
+
+	stream_write_UINT32(s, PERSISTENT_CACHE_SIGNATURE); /* signature (4 bytes) */
+	stream_write_UINT32(s, PERSISTENT_CACHE_VERSION); /* version (4 bytes) */
+	stream_write_UINT32(s, count); /* count (4 bytes) */
+	stream_write_UINT32(s, 0); /* reserved (4 bytes) */
+
+	if (fwrite(stream_get_head(s), PERSISTENT_CACHE_HEADER_LENGTH, 1, fp) != 1)
+		status = FALSE;
+
+	for (i = 0; (i < count) && status; i++)
+	{
+		entry = entries[i];
+		stream_set_pos(s, 0);
+
+		stream_write_UINT64(s, entry->key); /* key (8 bytes) */
+		stream_write_UINT16(s, entry->width); /* width (2 bytes) */
+		stream_write_UINT16(s, entry->height); /* height (2 bytes) */
+		stream_write_BYTE(s, entry->bpp); /* bpp (1 byte) */
+		stream_write_BYTE(s, entry->flags); /* flags (1 byte) */
+		stream_write_BYTE(s, entry->cacheId); /* cacheId (1 byte) */
+		stream_write_BYTE(s, 0); /* pad (1 byte) */
+		stream_write_UINT32(s, entry->length); /* length (4 bytes) */
+
+		crc = persistent_cache_crc32(persistent_cache_crc32(0, stream_get_head(s), 20), entry->data, entry->length);
+		stream_write_UINT32(s, crc); /* crc (4 bytes) */
+
+		if (fwrite(stream_get_head(s), PERSISTENT_CACHE_ENTRY_LENGTH, 1, fp) != 1)
+			status = FALSE;
+		else if ((entry->length > 0) && (fwrite(entry->data, entry->length, 1, fp) != 1))
+			status = FALSE;
+	}
+
+	stream_free(s);
+
+	if (fclose(fp) != 0)
+		status = FALSE;
+
+	if (status)
+	{
+#ifdef _WIN32
+		remove(filename);
+#endif
+		if (rename(tmpname, filename) != 0)
+			status = FALSE;
+	}
+
+	if (!status)
+		remove(tmpname);
+
+	free(tmpname);
+
+	return status;
+}
+
+void persistent_cache_entry_set(PERSISTENT_CACHE_ENTRY* entry, UINT64 key, int cacheId,
+		int width, int height, int bpp, BOOL compressed, BYTE* data, UINT32 length)
+{
+	persistent_cache_entry_clear(entry);
+
+	entry->key = key;
+	entry->width = width;
+	entry->height = height;
+	entry->bpp = bpp;
+	entry->flags = compressed ? PERSISTENT_CACHE_COMPRESSED : 0;
+	entry->cacheId = cacheId;
+	entry->length = length;
+	entry->data = (BYTE*) malloc(length > 0 ? length : 1);
+	entry->allocated = TRUE;
+
+	memcpy(entry->data, data, length);
+}
+
+void persistent_cache_entry_clear(PERSISTENT_CACHE_ENTRY* entry)
+{
+	if (entry->allocated)
+		free(entry->data);
+
+	memset(entry, 0, sizeof(PERSISTENT_CACHE_ENTRY));
+}
+
+rdpPersistentCache* persistent_cache_new(void)
+{
+	rdpPersistentCache* persistent;
+
+	persistent = (rdpPersistentCache*) xzalloc(sizeof(rdpPersistentCache));
+
+	return persistent;
+}
+
+void persistent_cache_free(rdpPersistentCache* persistent)
+{
+	if (persistent != NULL)
+	{
+		persistent_cache_unmap(persistent);
+		free(persistent->entries);
+		free(persistent->filename);
+		free(persistent);
+	}
+}
@@ -0,0 +1,353 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Chunked Channel Data Reassembly
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <freerdp/utils/memory.h>
+#include <freerdp/utils/reassembly.h>
+
+/**
+ * Allocates a segment pool.
+ * Released segments are kept on a free list (up to max_free of them) and handed
+ * out again by segment_pool_take(), so steady channel traffic does not hit malloc.
+ * The pool is thread-safe and may be shared by several reassembly contexts.
+ *
+ * @param max_free - maximum number of idle segments kept around, 0 for the default.
+ */
+rdpSegmentPool* segment_pool_new(int max_free)
+{
+	rdpSegmentPool* pool;
+
+	pool = xnew(rdpSegmentPool);
+
+	if (pool != NULL)
+	{
+		pool->mutex = CreateMutex(NULL, FALSE, NULL);
+		pool->max_free = (max_free > 0) ? max_free : REASSEMBLY_POOL_MAX_FREE;
+	}
+
+	return pool;
+}
+
+void segment_pool_free(rdpSegmentPool* pool)
+{
+	REASSEMBLY_SEGMENT* segment;
+
+	if (pool == NULL)
+		return;
+
+	while (pool->free_list != NULL)
+	{
+		segment = pool->free_list;
+		pool->free_list = segment->next;
+		free(segment);
+	}
+
+	CloseHandle(pool->mutex);
+	free(pool);
+}
+
+REASSEMBLY_SEGMENT* segment_pool_take(rdpSegmentPool* pool)
+{
+	REASSEMBLY_SEGMENT* segment;
+
+	WaitForSingleObject(pool->mutex, INFINITE);
+
+	segment = pool->free_list;
+
+	if (segment != NULL)
+	{
+		pool->free_list = segment->next;
+		pool->free_count--;
+	}
+	else
+	{
+		pool->allocated++;
+	}
+
+	ReleaseMutex(pool->mutex);
+
+	if (segment == NULL)
+	{
+		segment = (REASSEMBLY_SEGMENT*) malloc(sizeof(REASSEMBLY_SEGMENT));
+
+		if (segment == NULL)
+		{
+			WaitForSingleObject(pool->mutex, INFINITE);
+			pool->allocated--;
+			ReleaseMutex(pool->mutex);
+			return NULL;
+		}
+	}
+
+	segment->length = 0;
+	segment->next = NULL;
+
+	return segment;
+}
+
+/**
+ * Returns a segment chain to the pool.
+ * Segments beyond the pool's free list limit are freed.
+ */
+void segment_pool_release(rdpSegmentPool* pool, REASSEMBLY_SEGMENT* segment)
+{
+	REASSEMBLY_SEGMENT* next;
+
+	WaitForSingleObject(pool->mutex, INFINITE);
+
+	while (segment != NULL)
+	{
+		next = segment->next;
+
+		if (pool->free_count < pool->max_free)
+		{
+			segment->next = pool->free_list;
+			pool->free_list = segment;
+			pool->free_count++;
+		}
+		else
+		{
+			pool->allocated--;
+			free(segment);
+		}
+
+		segment = next;
+	}
+
+	ReleaseMutex(pool->mutex);
+}
+
+/**
+ * Allocates a reassembly context for one channel.
+ *
+ * @param pool - segment pool the context takes its segments from.
+ * @param max_length - largest message accepted, 0 for the default.
+ */
+rdpReassembly* reassembly_new(rdpSegmentPool* pool, UINT32 max_length)
+{
+	rdpReassembly* reassembly;
+
+	reassembly = xnew(rdpReassembly);
+
+	if (reassembly != NULL)
+	{
+		reassembly->pool = pool;
+		reassembly->max_length = (max_length > 0) ? max_length : REASSEMBLY_DEFAULT_MAX_LENGTH;
+	}
+
+	return reassembly;
+}
+
+void reassembly_free(rdpReassembly* reassembly)
+{
+	if (reassembly == NULL)
+		return;
+
+	reassembly_reset(reassembly);
+	free(reassembly);
+}
+
+/**
+ * Drops any partially reassembled message and returns its segments to the pool.
+ */
+void reassembly_reset(rdpReassembly* reassembly)
+{
+	if (reassembly->head != NULL)
+		segment_pool_release(reassembly->pool, reassembly->head);
+
+	reassembly->head = NULL;
+	reassembly->tail = NULL;
+	reassembly->length = 0;
+	reassembly->total_length = 0;
+	reassembly->overflow = FALSE;
+}
+
+/**
+ * Starts a new message. Nothing is allocated up front: the announced total
+ * length is only used to validate the fragments that follow.
+ *
+ * @return FALSE if the announced length exceeds the context limit, in which case
+ * the fragments of this message are discarded until the next reassembly_begin().
+ */
+BOOL reassembly_begin(rdpReassembly* reassembly, UINT32 total_length)
+{
+	reassembly_reset(reassembly);
+	reassembly->total_length = total_length;
+
+	if (total_length > reassembly->max_length)
+	{
+		reassembly->overflow = TRUE;
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+BOOL reassembly_append(rdpReassembly* reassembly, const BYTE* data, UINT32 length)
+{
+	UINT32 count;
+	REASSEMBLY_SEGMENT* segment;
+
+	if (reassembly->overflow)
+		return FALSE;
+
+	if (length > reassembly->total_length - reassembly->length)
+	{
+		/* more data than announced in the first fragment */
+		reassembly_reset(reassembly);
+		reassembly->overflow = TRUE;
+		return FALSE;
+	}
+
+	while (length > 0)
+	{
+		segment = reassembly->tail;
+
+		if ((segment == NULL) || (segment->length == REASSEMBLY_SEGMENT_SIZE))
+		{
+			segment = segment_pool_take(reassembly->pool);
+
+			if (segment == NULL)
+			{
+				reassembly_reset(reassembly);
+				reassembly->overflow = TRUE;
+				return FALSE;
+			}
+
+			if (reassembly->tail != NULL)
+				reassembly->tail->next = segment;
+			else
+				reassembly->head = segment;
+
+			reassembly->tail = segment;
+		}
+
+		count = REASSEMBLY_SEGMENT_SIZE - segment->length;
+
+		if (count > length)
+			count = length;
+
+		memcpy(&segment->data[segment->length], data, count);
+		segment->length += count;
+		reassembly->length += count;
+
+		data += count;
+		length -= count;
+	}
+
+	return TRUE;
+}
+
+BOOL reassembly_is_complete(rdpReassembly* reassembly)
+{
+	return (!reassembly->overflow && (reassembly->length == reassembly->total_length));
+}
+
+/**
+ * Hands the completed message over as a segment chain, without copying it.
+ * The chain must be released with reassembly_chain_free().
+ */
+BOOL reassembly_detach(rdpReassembly* reassembly, REASSEMBLY_CHAIN* chain)
+{
+	if (!reassembly_is_complete(reassembly))
+		return FALSE;
+
+	chain->length = reassembly->length;
+	chain->head = reassembly->head;
+	chain->pool = reassembly->pool;
+
+	reassembly->head = NULL;
+	reassembly_reset(reassembly);
+
+	return TRUE;
+}
+
+/**
+ * Makes the completed message contiguous, for consumers that parse it as a STREAM.
+ * The stream is sized from the bytes actually received, and the segments go back to the pool.
+ *
+ * @return NULL if the message is not complete or the buffer cannot be allocated,
+ * in which case the message is discarded.
+ */
+STREAM* reassembly_to_stream(rdpReassembly* reassembly)
+{
+	STREAM* s;
+	BYTE* buffer;
+	UINT32 length;
+	REASSEMBLY_CHAIN chain;
+
+	if (!reassembly_detach(reassembly, &chain))
+		return NULL;
+
+	length = chain.length;
+	buffer = (BYTE*) malloc(length > 0 ? length : 1);
+
+	if (buffer == NULL)
+	{
+		reassembly_chain_free(&chain);
+		return NULL;
+	}
+
+	reassembly_chain_copy(&chain, buffer, length);
+	reassembly_chain_free(&chain);
+
+	s = stream_new(0);
+	stream_attach(s, buffer, length);
+
+	return s;
+}
+
+/**
+ * Copies a segment chain into a contiguous buffer.
+ *
+ * @return number of bytes copied
+ */
+UINT32 reassembly_chain_copy(REASSEMBLY_CHAIN* chain, BYTE* buffer, UINT32 size)
+{
+	UINT32 count;
+	UINT32 copied = 0;
+	REASSEMBLY_SEGMENT* segment;
+
+	for (segment = chain->head; segment && (copied < size); segment = segment->next)
+	{
+		count = segment->length;
+
+		if (count > size - copied)
+			count = size - copied;
+
+		memcpy(&buffer[copied], segment->data, count);
+		copied += count;
+	}
+
+	return copied;
+}
+
+void reassembly_chain_free(REASSEMBLY_CHAIN* chain)
+{
+	if (chain->head != NULL)
+		segment_pool_release(chain->pool, chain->head);
+
+	chain->head = NULL;
+	chain->length = 0;
+}
@@ -33,6 +33,7 @@
 #include <freerdp/utils/list.h>
 #include <freerdp/utils/thread.h>
 #include <freerdp/utils/event.h>
+#include <freerdp/utils/reassembly.h>
 #include <freerdp/utils/svc_plugin.h>
 
 /* The list of all plugin instances. */
@@ -49,11 +50,16 @@ static rdpSvcPluginList* g_svc_plugin_list = NULL;
 /* For locking the global resources */
 static HANDLE g_mutex = NULL;
 
+/* Segments shared by all plugin instances for reassembling fragmented data */
+static rdpSegmentPool* g_segment_pool = NULL;
+
 /* Queue for receiving packets */
 struct _svc_data_in_item
 {
 	STREAM* data_in;
 	RDP_EVENT* event_in;
+	BOOL dropped;
+	UINT32 dropped_length;
 };
 typedef struct _svc_data_in_item svc_data_in_item;
 
@@ -76,7 +82,7 @@ struct rdp_svc_plugin_private
 {
 	void* init_handle;
 	UINT32 open_handle;
-	STREAM* data_in;
+	rdpReassembly* data_in;
 
 	LIST* data_in_list;
 	freerdp_thread* thread;
@@ -150,6 +156,21 @@ static void svc_plugin_remove(rdpSvcPlugin* plugin)
 	ReleaseMutex(g_mutex);
 }
 
+static void svc_plugin_process_dropped(rdpSvcPlugin* plugin, UINT32 totalLength)
+{
+	svc_data_in_item* item;
+
+	item = xnew(svc_data_in_item);
+	item->dropped = TRUE;
+	item->dropped_length = totalLength;
+
+	freerdp_thread_lock(plugin->priv->thread);
+	list_enqueue(plugin->priv->data_in_list, item);
+	freerdp_thread_unlock(plugin->priv->thread);
+
+	freerdp_thread_signal(plugin->priv->thread);
+}
+
 static void svc_plugin_process_received(rdpSvcPlugin* plugin, void* pData, UINT32 dataLength,
 	UINT32 totalLength, UINT32 dataFlags)
 {
@@ -165,36 +186,59 @@ static void svc_plugin_process_received(rdpSvcPlugin* plugin, void* pData, UINT3
 		return;
 	}
 
-	if (dataFlags & CHANNEL_FLAG_FIRST)
+	if ((dataFlags & CHANNEL_FLAG_FIRST) && (dataFlags & CHANNEL_FLAG_LAST))
 	{
-		if (plugin->priv->data_in != NULL)
-			stream_free(plugin->priv->data_in);
-		plugin->priv->data_in = stream_new(totalLength);
-	}
+		/* unfragmented message: skip the reassembly segments entirely */
+		reassembly_reset(plugin->priv->data_in);
 
-	data_in = plugin->priv->data_in;
-	stream_check_size(data_in, (int) dataLength);
-	stream_write(data_in, pData, dataLength);
-
-	if (dataFlags & CHANNEL_FLAG_LAST)
+		data_in = stream_new(dataLength > 0 ? dataLength : 1);
+		stream_write(data_in, pData, dataLength);
+		stream_seal(data_in);
+		stream_set_pos(data_in, 0);
+	}
+	else
 	{
-		if (stream_get_size(data_in) != stream_get_length(data_in))
+		if (dataFlags & CHANNEL_FLAG_FIRST)
 		{
-			printf("svc_plugin_process_received: read error\n");
+			if (!reassembly_begin(plugin->priv->data_in, totalLength))
+			{
+				printf("svc_plugin_process_received: message too large (%d bytes), discarded\n", totalLength);
+				svc_plugin_process_dropped(plugin, totalLength);
+			}
 		}
 
-		plugin->priv->data_in = NULL;
-		stream_set_pos(data_in, 0);
+		if (plugin->priv->data_in->overflow)
+			return;
 
-		item = xnew(svc_data_in_item);
-		item->data_in = data_in;
+		if (!reassembly_append(plugin->priv->data_in, (BYTE*) pData, dataLength))
+		{
+			printf("svc_plugin_process_received: fragment exceeds total length, discarded\n");
+			svc_plugin_process_dropped(plugin, totalLength);
+			return;
+		}
 
-		freerdp_thread_lock(plugin->priv->thread);
-		list_enqueue(plugin->priv->data_in_list, item);
-		freerdp_thread_unlock(plugin->priv->thread);
+		if (!(dataFlags & CHANNEL_FLAG_LAST))
+			return;
+
+		data_in = reassembly_to_stream(plugin->priv->data_in);
 
-		freerdp_thread_signal(plugin->priv->thread);
+		if (data_in == NULL)
+		{
+			printf("svc_plugin_process_received: read error\n");
+			reassembly_reset(plugin->priv->data_in);
+			svc_plugin_process_dropped(plugin, totalLength);
+			return;
+		}
 	}
+
+	item = xnew(svc_data_in_item);
+	item->data_in = data_in;
+
+	freerdp_thread_lock(plugin->priv->thread);
+	list_enqueue(plugin->priv->data_in_list, item);
+	freerdp_thread_unlock(plugin->priv->thread);
+
+	freerdp_thread_signal(plugin->priv->thread);
 }
 
 static void svc_plugin_process_event(rdpSvcPlugin* plugin, RDP_EVENT* event_in)
@@ -264,6 +308,8 @@ static void svc_plugin_process_data_in(rdpSvcPlugin* plugin)
 				IFCALL(plugin->receive_callback, plugin, item->data_in);
 			if (item->event_in)
 				IFCALL(plugin->event_callback, plugin, item->event_in);
+			if (item->dropped)
+				IFCALL(plugin->drop_callback, plugin, item->dropped_length);
 			free(item);
 		}
 		else
@@ -316,6 +362,7 @@ static void svc_plugin_process_connected(rdpSvcPlugin* plugin, void* pData, UINT
 		return;
 	}
 
+	plugin->priv->data_in = reassembly_new(g_segment_pool, plugin->max_data_length);
 	plugin->priv->data_in_list = list_new();
 	plugin->priv->thread = freerdp_thread_new();
 
@@ -340,7 +387,7 @@ static void svc_plugin_process_terminated(rdpSvcPlugin* plugin)
 
 	if (plugin->priv->data_in != NULL)
 	{
-		stream_free(plugin->priv->data_in);
+		reassembly_free(plugin->priv->data_in);
 		plugin->priv->data_in = NULL;
 	}
 	free(plugin->priv);
@@ -389,6 +436,9 @@ void svc_plugin_init(rdpSvcPlugin* plugin, CHANNEL_ENTRY_POINTS* pEntryPoints)
 	if (g_mutex == NULL)
 		g_mutex = CreateMutex(NULL, FALSE, NULL);
 
+	if (g_segment_pool == NULL)
+		g_segment_pool = segment_pool_new(0);
+
 	memcpy(&plugin->channel_entry_points, pEntryPoints, pEntryPoints->cbSize);
 
 	plugin->priv = xnew(rdpSvcPluginPrivate);
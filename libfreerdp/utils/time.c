@@ -25,6 +25,11 @@
 #include <stdlib.h>
 #include <string.h>
 
+#ifndef _WIN32
+#include <time.h>
+#include <sys/time.h>
+#endif
+
 #include <winpr/windows.h>
 
 #include <freerdp/utils/time.h>
@@ -84,3 +89,22 @@ time_t freerdp_get_unix_time_from_generalized_time(const char* generalized_time)
 
 	return unix_time;
 }
+
+/**
+ * Millisecond monotonic clock for measuring intervals, wraps around every 49 days.
+ */
+
+UINT32 freerdp_get_tick_count(void)
+{
+#ifdef _WIN32
+	return GetTickCount();
+#elif defined(CLOCK_MONOTONIC)
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec * 1000) + (ts.tv_nsec / 1000000);
+#else
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return (tv.tv_sec * 1000) + (tv.tv_usec / 1000);
+#endif
+}
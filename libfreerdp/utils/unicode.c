@@ -33,6 +33,8 @@
 
 int freerdp_AsciiToUnicodeAlloc(const CHAR* str, WCHAR** wstr, int length)
 {
+	int wlength;
+
 	if (!str)
 	{
 		*wstr = NULL;
@@ -42,22 +44,30 @@ int freerdp_AsciiToUnicodeAlloc(const CHAR* str, WCHAR** wstr, int length)
 	if (length < 1)
 		length = strlen(str);
 
-	length = MultiByteToWideChar(CP_UTF8, 0, str, length, NULL, 0);
-	*wstr = (WCHAR*) malloc((length + 1) * sizeof(WCHAR));
+	wlength = MultiByteToWideChar(CP_UTF8, 0, str, length, NULL, 0);
+	*wstr = (WCHAR*) malloc((wlength + 1) * sizeof(WCHAR));
+
+	if (wlength > 0)
+		MultiByteToWideChar(CP_UTF8, 0, str, length, (LPWSTR) (*wstr), wlength);
 
-	MultiByteToWideChar(CP_UTF8, 0, str, length, (LPWSTR) (*wstr), length * sizeof(WCHAR));
-	(*wstr)[length] = 0;
+	(*wstr)[wlength] = 0;
 
-	return length;
+	return wlength;
 }
 
 int freerdp_UnicodeToAsciiAlloc(const WCHAR* wstr, CHAR** str, int length)
 {
-	*str = malloc((length * 2) + 1);
-	memset(*str, 0, (length * 2) + 1);
+	int size = 0;
+
+	if (length > 0)
+		size = WideCharToMultiByte(CP_UTF8, 0, wstr, length, NULL, 0, NULL, NULL);
+
+	*str = (CHAR*) malloc(size + 1);
+
+	if (size > 0)
+		WideCharToMultiByte(CP_UTF8, 0, wstr, length, *str, size, NULL, NULL);
 
-	WideCharToMultiByte(CP_UTF8, 0, wstr, length, *str, length, NULL, NULL);
-	(*str)[length] = 0;
+	(*str)[size] = 0;
 
-	return length;
+	return size;
 }
@@ -395,6 +395,30 @@ void xf_peer_dump_rfx(freerdp_peer* client)
 	}
 }
 
+static void xf_peer_begin_frame(freerdp_peer* client)
+{
+	rdpUpdate* update = client->update;
+	SURFACE_FRAME_MARKER* fm = &update->surface_frame_marker;
+	xfPeerContext* xfp = (xfPeerContext*) client->context;
+
+	fm->frameAction = SURFACECMD_FRAMEACTION_BEGIN;
+	fm->frameId = xfp->frame_id;
+	update->SurfaceFrameMarker(update->context, fm);
+}
+
+static void xf_peer_end_frame(freerdp_peer* client)
+{
+	rdpUpdate* update = client->update;
+	SURFACE_FRAME_MARKER* fm = &update->surface_frame_marker;
+	xfPeerContext* xfp = (xfPeerContext*) client->context;
+
+	fm->frameAction = SURFACECMD_FRAMEACTION_END;
+	fm->frameId = xfp->frame_id;
+	update->SurfaceFrameMarker(update->context, fm);
+
+	xfp->frame_id++;
+}
+
 void xf_peer_rfx_update(freerdp_peer* client, int x, int y, int width, int height)
 {
 	STREAM* s;
@@ -511,14 +535,20 @@ BOOL xf_peer_check_fds(freerdp_peer* client)
 			event = xf_event_pop(xfp->event_queue);
 			invalid_region = xfp->hdc->hwnd->invalid;
 
-			if (invalid_region->null == FALSE)
+			/**
+			 * While the client is behind on acknowledging frames, keep accumulating
+			 * the invalid region so that it goes out merged in a later frame.
+			 */
+			if ((invalid_region->null == FALSE) && freerdp_peer_can_send_frame(client))
 			{
+				xf_peer_begin_frame(client);
 				xf_peer_rfx_update(client, invalid_region->x, invalid_region->y,
 					invalid_region->w, invalid_region->h);
-			}
+				xf_peer_end_frame(client);
 
-			invalid_region->null = 1;
-			xfp->hdc->hwnd->ninvalid = 0;
+				invalid_region->null = 1;
+				xfp->hdc->hwnd->ninvalid = 0;
+			}
 
 			xf_event_free(event);
 		}
@@ -38,6 +38,7 @@ struct xf_peer_context
 
 	int fps;
 	STREAM* s;
+	UINT32 frame_id;
 	HGDI_DC hdc;
 	xfInfo* info;
 	int activations;
@@ -44,6 +44,8 @@
 #define MB_USEGLYPHCHARS		0x00000004
 #define MB_ERR_INVALID_CHARS		0x00000008
 
+#define WC_ERR_INVALID_CHARS		0x00000080
+
 WINPR_API char* _strdup(const char* strSource);
 WINPR_API WCHAR* _wcsdup(const WCHAR* strSource);
 
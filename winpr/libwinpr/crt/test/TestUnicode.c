@@ -0,0 +1,393 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <winpr/crt.h>
+#include <winpr/windows.h>
+
+#define FUZZ_ITERATIONS		2000
+#define FUZZ_MAX_LENGTH		256
+
+#define BENCHMARK_LENGTH	(1024 * 1024)
+#define BENCHMARK_ITERATIONS	16
+
+struct unicode_test_vector
+{
+	const char* utf8;
+	int utf8_length;
+	WCHAR utf16[8];
+	int utf16_length;
+	BOOL valid;
+};
+
+static struct unicode_test_vector test_vectors[] =
+{
+	{ "abc", 3, { 'a', 'b', 'c' }, 3, TRUE },
+	{ "\xC3\xA9", 2, { 0x00E9 }, 1, TRUE },
+	{ "\xE2\x82\xAC", 3, { 0x20AC }, 1, TRUE },
+	{ "\xEF\xBF\xBF", 3, { 0xFFFF }, 1, TRUE },
+	{ "\xF0\x9F\x98\x80", 4, { 0xD83D, 0xDE00 }, 2, TRUE },
+	{ "\xF4\x8F\xBF\xBF", 4, { 0xDBFF, 0xDFFF }, 2, TRUE },
+	{ "a\xC0\xAF" "b", 4, { 'a', 0xFFFD, 0xFFFD, 'b' }, 4, FALSE },
+	{ "\xE0\x80\x80", 3, { 0xFFFD, 0xFFFD, 0xFFFD }, 3, FALSE },
+	{ "\xED\xA0\x80", 3, { 0xFFFD, 0xFFFD, 0xFFFD }, 3, FALSE },
+	{ "\xF4\x90\x80\x80", 4, { 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD }, 4, FALSE },
+	{ "\xE2\x82" "a", 3, { 0xFFFD, 'a' }, 2, FALSE },
+	{ "\xF0\x9F\x98", 3, { 0xFFFD }, 1, FALSE },
+	{ "\x80\xBF", 2, { 0xFFFD, 0xFFFD }, 2, FALSE },
+	{ "\xFE\xFF", 2, { 0xFFFD, 0xFFFD }, 2, FALSE }
+};
+
+static int test_unicode_random_code_point(void)
+{
+	switch (rand() % 4)
+	{
+		case 0:
+			return rand() % 0x80;
+
+		case 1:
+			return 0x80 + (rand() % (0x800 - 0x80));
+
+		case 2:
+			do
+			{
+				int code = 0x800 + (rand() % (0x10000 - 0x800));
+
+				if ((code < 0xD800) || (code > 0xDFFF))
+					return code;
+			}
+			while (1);
+
+		default:
+			return 0x10000 + (rand() % (0x110000 - 0x10000));
+	}
+}
+
+static int test_unicode_encode_utf8(int code, BYTE* dst)
+{
+	if (code < 0x80)
+	{
+		dst[0] = code;
+		return 1;
+	}
+	else if (code < 0x800)
+	{
+		dst[0] = 0xC0 | (code >> 6);
+		dst[1] = 0x80 | (code & 0x3F);
+		return 2;
+	}
+	else if (code < 0x10000)
+	{
+		dst[0] = 0xE0 | (code >> 12);
+		dst[1] = 0x80 | ((code >> 6) & 0x3F);
+		dst[2] = 0x80 | (code & 0x3F);
+		return 3;
+	}
+
+	dst[0] = 0xF0 | (code >> 18);
+	dst[1] = 0x80 | ((code >> 12) & 0x3F);
+	dst[2] = 0x80 | ((code >> 6) & 0x3F);
+	dst[3] = 0x80 | (code & 0x3F);
+	return 4;
+}
+
+static int test_unicode_encode_utf16(int code, WCHAR* dst)
+{
+	if (code < 0x10000)
+	{
+		dst[0] = code;
+		return 1;
+	}
+
+	code -= 0x10000;
+	dst[0] = 0xD800 + (code >> 10);
+	dst[1] = 0xDC00 + (code & 0x3FF);
+	return 2;
+}
+
+static int test_unicode_vectors(void)
+{
+	int i;
+	int length;
+	WCHAR utf16[16];
+	BYTE utf8[32];
+	struct unicode_test_vector* vector;
+
+	for (i = 0; i < sizeof(test_vectors) / sizeof(test_vectors[0]); i++)
+	{
+		vector = &test_vectors[i];
+
+		length = MultiByteToWideChar(CP_UTF8, 0, vector->utf8, vector->utf8_length, NULL, 0);
+
+		if (length != vector->utf16_length)
+		{
+			printf("MultiByteToWideChar: vector %d: length mismatch: Actual: %d, Expected: %d\n",
+				i, length, vector->utf16_length);
+			return -1;
+		}
+
+		length = MultiByteToWideChar(CP_UTF8, 0, vector->utf8, vector->utf8_length, utf16, 16);
+
+		if ((length != vector->utf16_length) || (memcmp(utf16, vector->utf16, length * sizeof(WCHAR)) != 0))
+		{
+			printf("MultiByteToWideChar: vector %d: conversion mismatch\n", i);
+			return -1;
+		}
+
+		length = MultiByteToWideChar(CP_UTF8, MB_ERR_INVALID_CHARS, vector->utf8, vector->utf8_length, utf16, 16);
+
+		if ((length != 0) != vector->valid)
+		{
+			printf("MultiByteToWideChar: vector %d: validation mismatch\n", i);
+			return -1;
+		}
+
+		if (!vector->valid)
+			continue;
+
+		length = WideCharToMultiByte(CP_UTF8, 0, vector->utf16, vector->utf16_length, NULL, 0, NULL, NULL);
+
+		if (length != vector->utf8_length)
+		{
+			printf("WideCharToMultiByte: vector %d: length mismatch: Actual: %d, Expected: %d\n",
+				i, length, vector->utf8_length);
+			return -1;
+		}
+
+		length = WideCharToMultiByte(CP_UTF8, 0, vector->utf16, vector->utf16_length, (LPSTR) utf8, 32, NULL, NULL);
+
+		if ((length != vector->utf8_length) || (memcmp(utf8, vector->utf8, length) != 0))
+		{
+			printf("WideCharToMultiByte: vector %d: conversion mismatch\n", i);
+			return -1;
+		}
+	}
+
+	/* unpaired surrogates */
+
+	utf16[0] = 'a';
+	utf16[1] = 0xDC00;
+	utf16[2] = 0xD800;
+	utf16[3] = 'b';
+
+	length = WideCharToMultiByte(CP_UTF8, 0, utf16, 4, (LPSTR) utf8, 32, NULL, NULL);
+
+	if ((length != 8) || (memcmp(utf8, "a\xEF\xBF\xBD\xEF\xBF\xBD" "b", 8) != 0))
+	{
+		printf("WideCharToMultiByte: unpaired surrogates not replaced\n");
+		return -1;
+	}
+
+	if (WideCharToMultiByte(CP_UTF8, WC_ERR_INVALID_CHARS, utf16, 4, (LPSTR) utf8, 32, NULL, NULL) != 0)
+	{
+		printf("WideCharToMultiByte: unpaired surrogates not rejected\n");
+		return -1;
+	}
+
+	/* null-terminated strings include the terminator */
+
+	if (MultiByteToWideChar(CP_UTF8, 0, "\xC3\xA9t\xC3\xA9", -1, utf16, 16) != 4)
+	{
+		printf("MultiByteToWideChar: null-terminated length mismatch\n");
+		return -1;
+	}
+
+	if ((utf16[3] != 0) || (WideCharToMultiByte(CP_UTF8, 0, utf16, -1, (LPSTR) utf8, 32, NULL, NULL) != 6))
+	{
+		printf("WideCharToMultiByte: null-terminated length mismatch\n");
+		return -1;
+	}
+
+	/* insufficient buffers fail instead of truncating */
+
+	if (MultiByteToWideChar(CP_UTF8, 0, "abc\xF0\x9F\x98\x80", 7, utf16, 4) != 0)
+	{
+		printf("MultiByteToWideChar: insufficient buffer not detected\n");
+		return -1;
+	}
+
+	if (WideCharToMultiByte(CP_UTF8, 0, test_vectors[2].utf16, 1, (LPSTR) utf8, 2, NULL, NULL) != 0)
+	{
+		printf("WideCharToMultiByte: insufficient buffer not detected\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+static int test_unicode_fuzz(void)
+{
+	int i, j;
+	int code;
+	int count;
+	int length;
+	int utf8_length;
+	int utf16_length;
+	BYTE utf8[FUZZ_MAX_LENGTH * 4];
+	BYTE output8[FUZZ_MAX_LENGTH * 4];
+	WCHAR utf16[FUZZ_MAX_LENGTH * 2];
+	WCHAR output16[FUZZ_MAX_LENGTH * 4];
+
+	srand(1);
+
+	for (i = 0; i < FUZZ_ITERATIONS; i++)
+	{
+		/* valid strings, with ASCII runs long enough for the vector paths */
+
+		count = 1 + (rand() % FUZZ_MAX_LENGTH);
+		utf8_length = utf16_length = 0;
+
+		for (j = 0; j < count; j++)
+		{
+			code = (rand() % 2) ? (rand() % 0x80) : test_unicode_random_code_point();
+			utf8_length += test_unicode_encode_utf8(code, &utf8[utf8_length]);
+			utf16_length += test_unicode_encode_utf16(code, &utf16[utf16_length]);
+		}
+
+		length = MultiByteToWideChar(CP_UTF8, MB_ERR_INVALID_CHARS, (LPCSTR) utf8, utf8_length, NULL, 0);
+
+		if (length != utf16_length)
+		{
+			printf("MultiByteToWideChar: fuzz %d: length mismatch: Actual: %d, Expected: %d\n",
+				i, length, utf16_length);
+			return -1;
+		}
+
+		length = MultiByteToWideChar(CP_UTF8, MB_ERR_INVALID_CHARS, (LPCSTR) utf8, utf8_length, output16, utf16_length);
+
+		if ((length != utf16_length) || (memcmp(output16, utf16, length * sizeof(WCHAR)) != 0))
+		{
+			printf("MultiByteToWideChar: fuzz %d: conversion mismatch\n", i);
+			return -1;
+		}
+
+		length = WideCharToMultiByte(CP_UTF8, WC_ERR_INVALID_CHARS, utf16, utf16_length, NULL, 0, NULL, NULL);
+
+		if (length != utf8_length)
+		{
+			printf("WideCharToMultiByte: fuzz %d: length mismatch: Actual: %d, Expected: %d\n",
+				i, length, utf8_length);
+			return -1;
+		}
+
+		length = WideCharToMultiByte(CP_UTF8, WC_ERR_INVALID_CHARS, utf16, utf16_length,
+				(LPSTR) output8, utf8_length, NULL, NULL);
+
+		if ((length != utf8_length) || (memcmp(output8, utf8, length) != 0))
+		{
+			printf("WideCharToMultiByte: fuzz %d: conversion mismatch\n", i);
+			return -1;
+		}
+
+		/* random bytes: the replaced output must be valid and convert back to itself */
+
+		utf8_length = 1 + (rand() % FUZZ_MAX_LENGTH);
+
+		for (j = 0; j < utf8_length; j++)
+			utf8[j] = (rand() % 4) ? (rand() % 0x80) : (rand() % 0x100);
+
+		utf16_length = MultiByteToWideChar(CP_UTF8, 0, (LPCSTR) utf8, utf8_length, NULL, 0);
+		length = MultiByteToWideChar(CP_UTF8, 0, (LPCSTR) utf8, utf8_length, utf16, FUZZ_MAX_LENGTH * 2);
+
+		if ((length != utf16_length) || (length < 1) || (length > utf8_length))
+		{
+			printf("MultiByteToWideChar: fuzz %d: invalid input length mismatch\n", i);
+			return -1;
+		}
+
+		length = WideCharToMultiByte(CP_UTF8, WC_ERR_INVALID_CHARS, utf16, utf16_length,
+				(LPSTR) output8, FUZZ_MAX_LENGTH * 4, NULL, NULL);
+
+		if (length < 1)
+		{
+			printf("MultiByteToWideChar: fuzz %d: produced unpaired surrogates\n", i);
+			return -1;
+		}
+
+		if ((MultiByteToWideChar(CP_UTF8, MB_ERR_INVALID_CHARS, (LPCSTR) output8, length, output16, FUZZ_MAX_LENGTH * 4) != utf16_length) ||
+			(memcmp(output16, utf16, utf16_length * sizeof(WCHAR)) != 0))
+		{
+			printf("MultiByteToWideChar: fuzz %d: replaced output does not round-trip\n", i);
+			return -1;
+		}
+
+		/* random UTF-16 units, including unpaired surrogates */
+
+		utf16_length = 1 + (rand() % FUZZ_MAX_LENGTH);
+
+		for (j = 0; j < utf16_length; j++)
+			utf16[j] = (rand() % 2) ? (rand() % 0x80) : (0xD000 + (rand() % 0x1000));
+
+		length = WideCharToMultiByte(CP_UTF8, 0, utf16, utf16_length, NULL, 0, NULL, NULL);
+
+		if (WideCharToMultiByte(CP_UTF8, 0, utf16, utf16_length, (LPSTR) output8, FUZZ_MAX_LENGTH * 4, NULL, NULL) != length)
+		{
+			printf("WideCharToMultiByte: fuzz %d: invalid input length mismatch\n", i);
+			return -1;
+		}
+
+		if (MultiByteToWideChar(CP_UTF8, MB_ERR_INVALID_CHARS, (LPCSTR) output8, length, output16, FUZZ_MAX_LENGTH * 4) < 1)
+		{
+			printf("WideCharToMultiByte: fuzz %d: produced invalid UTF-8\n", i);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+static void test_unicode_benchmark(void)
+{
+	int i;
+	int length = 0;
+	BYTE* utf8;
+	WCHAR* utf16;
+	clock_t start;
+	double seconds;
+
+	utf8 = (BYTE*) malloc(BENCHMARK_LENGTH);
+	utf16 = (WCHAR*) malloc(BENCHMARK_LENGTH * sizeof(WCHAR));
+
+	/* mostly ASCII text with the occasional accented character */
+
+	for (i = 0; i < BENCHMARK_LENGTH; i++)
+		utf8[i] = 'a' + (i % 26);
+
+	for (i = 0; i + 2 <= BENCHMARK_LENGTH; i += 97)
+	{
+		utf8[i] = 0xC3;
+		utf8[i + 1] = 0xA9;
+	}
+
+	start = clock();
+
+	for (i = 0; i < BENCHMARK_ITERATIONS; i++)
+		length = MultiByteToWideChar(CP_UTF8, 0, (LPCSTR) utf8, BENCHMARK_LENGTH, utf16, BENCHMARK_LENGTH);
+
+	seconds = (double) (clock() - start) / CLOCKS_PER_SEC;
+	printf("MultiByteToWideChar: %.1f MB/s\n", seconds > 0 ? (BENCHMARK_ITERATIONS * (BENCHMARK_LENGTH / 1048576.0)) / seconds : 0.0);
+
+	start = clock();
+
+	for (i = 0; i < BENCHMARK_ITERATIONS; i++)
+		WideCharToMultiByte(CP_UTF8, 0, utf16, length, (LPSTR) utf8, BENCHMARK_LENGTH, NULL, NULL);
+
+	seconds = (double) (clock() - start) / CLOCKS_PER_SEC;
+	printf("WideCharToMultiByte: %.1f MB/s\n", seconds > 0 ? (BENCHMARK_ITERATIONS * (BENCHMARK_LENGTH / 1048576.0)) / seconds : 0.0);
+
+	free(utf8);
+	free(utf16);
+}
+
+int TestUnicode(int argc, char* argv[])
+{
+	if (test_unicode_vectors() < 0)
+		return -1;
+
+	if (test_unicode_fuzz() < 0)
+		return -1;
+
+	test_unicode_benchmark();
+
+	return 0;
+}
@@ -0,0 +1,448 @@
+/**
+ * WinPR: Windows Portable Runtime
+ * Unicode Conversion (CRT)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <winpr/crt.h>
+
+#ifndef _WIN32
+
+#ifdef WITH_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+/**
+ * UTF-8 <-> UTF-16LE transcoding. The code page is ignored, multibyte
+ * strings are always UTF-8. Runs of ASCII characters are converted 16 (UTF-8)
+ * or 8 (UTF-16) at a time, everything else goes through a validating decoder:
+ * overlong forms, encoded surrogates, code points above U+10FFFF and unpaired
+ * surrogates are either rejected or replaced with U+FFFD, one replacement
+ * character per maximal invalid subsequence.
+ *
+ * Without an output buffer the converters only count, so that the length
+ * returned by a size query is the exact length of the conversion.
+ */
+
+#define UNICODE_REPLACEMENT_CHARACTER	0xFFFD
+
+#define UNICODE_INVALID			-1
+#define UNICODE_INSUFFICIENT_BUFFER	-2
+
+/**
+ * Copy the leading ASCII characters of a UTF-8 string, widening them to UTF-16.
+ * @return number of characters copied
+ */
+
+static int unicode_widen_ascii(const BYTE* src, int length, WCHAR* dst)
+{
+	int i = 0;
+
+#if defined(WITH_SSE2)
+	__m128i zero = _mm_setzero_si128();
+
+	for (; i + 16 <= length; i += 16)
+	{
+		__m128i bytes = _mm_loadu_si128((const __m128i*) &src[i]);
+
+		if (_mm_movemask_epi8(bytes) != 0)
+			break;
+
+		if (dst)
+		{
+			_mm_storeu_si128((__m128i*) &dst[i], _mm_unpacklo_epi8(bytes, zero));
+			_mm_storeu_si128((__m128i*) &dst[i + 8], _mm_unpackhi_epi8(bytes, zero));
+		}
+	}
+#elif defined(__ARM_NEON__)
+	for (; i + 16 <= length; i += 16)
+	{
+		uint8x16_t bytes = vld1q_u8(&src[i]);
+		uint8x8_t high = vorr_u8(vget_low_u8(bytes), vget_high_u8(bytes));
+
+		if (vget_lane_u64(vreinterpret_u64_u8(high), 0) & 0x8080808080808080ULL)
+			break;
+
+		if (dst)
+		{
+			vst1q_u16((uint16_t*) &dst[i], vmovl_u8(vget_low_u8(bytes)));
+			vst1q_u16((uint16_t*) &dst[i + 8], vmovl_u8(vget_high_u8(bytes)));
+		}
+	}
+#endif
+
+	if (dst)
+	{
+		for (; (i < length) && (src[i] < 0x80); i++)
+			dst[i] = (WCHAR) src[i];
+	}
+	else
+	{
+		for (; (i < length) && (src[i] < 0x80); i++);
+	}
+
+	return i;
+}
+
+/**
+ * Copy the leading ASCII characters of a UTF-16 string, narrowing them to UTF-8.
+ * @return number of characters copied
+ */
+
+static int unicode_narrow_ascii(const WCHAR* src, int length, BYTE* dst)
+{
+	int i = 0;
+
+#if defined(WITH_SSE2)
+	__m128i zero = _mm_setzero_si128();
+	__m128i mask = _mm_set1_epi16((short) 0xFF80);
+
+	for (; i + 8 <= length; i += 8)
+	{
+		__m128i words = _mm_loadu_si128((const __m128i*) &src[i]);
+
+		if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(words, mask), zero)) != 0xFFFF)
+			break;
+
+		if (dst)
+			_mm_storel_epi64((__m128i*) &dst[i], _mm_packus_epi16(words, words));
+	}
+#elif defined(__ARM_NEON__)
+	for (; i + 8 <= length; i += 8)
+	{
+		uint16x8_t words = vld1q_u16((const uint16_t*) &src[i]);
+		uint16x4_t high = vorr_u16(vget_low_u16(words), vget_high_u16(words));
+
+		if (vget_lane_u64(vreinterpret_u64_u16(high), 0) & 0xFF80FF80FF80FF80ULL)
+			break;
+
+		if (dst)
+			vst1_u8(&dst[i], vmovn_u16(words));
+	}
+#endif
+
+	if (dst)
+	{
+		for (; (i < length) && (src[i] < 0x80); i++)
+			dst[i] = (BYTE) src[i];
+	}
+	else
+	{
+		for (; (i < length) && (src[i] < 0x80); i++);
+	}
+
+	return i;
+}
+
+/**
+ * Decode one multibyte UTF-8 sequence.
+ * @param src sequence, src[0] >= 0x80
+ * @param length bytes available
+ * @param code decoded code point
+ * @return bytes consumed, negated if the sequence is invalid
+ */
+
+static int unicode_decode_utf8(const BYTE* src, int length, UINT32* code)
+{
+	int i;
+	int count;
+	BYTE lower = 0x80;
+	BYTE upper = 0xBF;
+	UINT32 c = src[0];
+
+	if ((c >= 0xC2) && (c <= 0xDF))
+	{
+		count = 2;
+		c &= 0x1F;
+	}
+	else if ((c >= 0xE0) && (c <= 0xEF))
+	{
+		count = 3;
+		c &= 0x0F;
+
+		if (src[0] == 0xE0)
+			lower = 0xA0; /* overlong */
+		else if (src[0] == 0xED)
+			upper = 0x9F; /* surrogates */
+	}
+	else if ((c >= 0xF0) && (c <= 0xF4))
+	{
+		count = 4;
+		c &= 0x07;
+
+		if (src[0] == 0xF0)
+			lower = 0x90; /* overlong */
+		else if (src[0] == 0xF4)
+			upper = 0x8F; /* above U+10FFFF */
+	}
+	else
+	{
+		return -1;
+	}
+
+	for (i = 1; i < count; i++)
+	{
+		if ((i >= length) || (src[i] < lower) || (src[i] > upper))
+			return -i;
+
+		c = (c << 6) | (src[i] & 0x3F);
+		lower = 0x80;
+		upper = 0xBF;
+	}
+
+	*code = c;
+
+	return count;
+}
+
+static int unicode_utf8_to_utf16(const BYTE* src, int length, WCHAR* dst, int size, BOOL strict)
+{
+	int i = 0;
+	int n = 0;
+	int count;
+	int limit;
+	UINT32 code;
+
+	while (i < length)
+	{
+		limit = length - i;
+
+		if (dst && (limit > size - n))
+			limit = size - n;
+
+		count = unicode_widen_ascii(&src[i], limit, dst ? &dst[n] : NULL);
+		i += count;
+		n += count;
+
+		if (i >= length)
+			break;
+
+		if (src[i] < 0x80)
+			return UNICODE_INSUFFICIENT_BUFFER;
+
+		count = unicode_decode_utf8(&src[i], length - i, &code);
+
+		if (count < 0)
+		{
+			if (strict)
+				return UNICODE_INVALID;
+
+			code = UNICODE_REPLACEMENT_CHARACTER;
+			count = -count;
+		}
+
+		i += count;
+
+		if (code < 0x10000)
+		{
+			if (dst)
+			{
+				if (n + 1 > size)
+					return UNICODE_INSUFFICIENT_BUFFER;
+
+				dst[n] = (WCHAR) code;
+			}
+
+			n++;
+		}
+		else
+		{
+			if (dst)
+			{
+				if (n + 2 > size)
+					return UNICODE_INSUFFICIENT_BUFFER;
+
+				code -= 0x10000;
+				dst[n] = (WCHAR) (0xD800 + (code >> 10));
+				dst[n + 1] = (WCHAR) (0xDC00 + (code & 0x3FF));
+			}
+
+			n += 2;
+		}
+	}
+
+	return n;
+}
+
+static int unicode_utf16_to_utf8(const WCHAR* src, int length, BYTE* dst, int size, BOOL strict)
+{
+	int i = 0;
+	int n = 0;
+	int count;
+	int limit;
+	UINT32 code;
+
+	while (i < length)
+	{
+		limit = length - i;
+
+		if (dst && (limit > size - n))
+			limit = size - n;
+
+		count = unicode_narrow_ascii(&src[i], limit, dst ? &dst[n] : NULL);
+		i += count;
+		n += count;
+
+		if (i >= length)
+			break;
+
+		code = src[i++];
+
+		if (code < 0x80)
+			return UNICODE_INSUFFICIENT_BUFFER;
+
+		if ((code >= 0xD800) && (code <= 0xDFFF))
+		{
+			if ((code <= 0xDBFF) && (i < length) && (src[i] >= 0xDC00) && (src[i] <= 0xDFFF))
+			{
+				code = 0x10000 + ((code - 0xD800) << 10) + (src[i++] - 0xDC00);
+			}
+			else
+			{
+				if (strict)
+					return UNICODE_INVALID;
+
+				code = UNICODE_REPLACEMENT_CHARACTER;
+			}
+		}
+
+		if (code < 0x800)
+			count = 2;
+		else if (code < 0x10000)
+			count = 3;
+		else
+			count = 4;
+
+		if (dst)
+		{
+			if (n + count > size)
+				return UNICODE_INSUFFICIENT_BUFFER;
+
+			switch (count)
+			{
+				case 2:
+					dst[n] = (BYTE) (0xC0 | (code >> 6));
+					dst[n + 1] = (BYTE) (0x80 | (code & 0x3F));
+					break;
+
+				case 3:
+					dst[n] = (BYTE) (0xE0 | (code >> 12));
+					dst[n + 1] = (BYTE) (0x80 | ((code >> 6) & 0x3F));
+					dst[n + 2] = (BYTE) (0x80 | (code & 0x3F));
+					break;
+
+				default:
+					dst[n] = (BYTE) (0xF0 | (code >> 18));
+					dst[n + 1] = (BYTE) (0x80 | ((code >> 12) & 0x3F));
+					dst[n + 2] = (BYTE) (0x80 | ((code >> 6) & 0x3F));
+					dst[n + 3] = (BYTE) (0x80 | (code & 0x3F));
+					break;
+			}
+		}
+
+		n += count;
+	}
+
+	return n;
+}
+
+/*
+ * Conversion *to* Unicode
+ * MultiByteToWideChar: http://msdn.microsoft.com/en-us/library/windows/desktop/dd319072/
+ */
+
+int MultiByteToWideChar(UINT CodePage, DWORD dwFlags, LPCSTR lpMultiByteStr,
+		int cbMultiByte, LPWSTR lpWideCharStr, int cchWideChar)
+{
+	int length;
+
+	if ((lpMultiByteStr == NULL) || (cbMultiByte == 0))
+		return 0;
+
+	/* cbMultiByte is set to -1 if the string is null-terminated, the terminator is converted as well */
+
+	if (cbMultiByte < 0)
+		cbMultiByte = strlen(lpMultiByteStr) + 1;
+
+	/* if cchWideChar is set to 0, the function returns the required buffer size */
+
+	if (cchWideChar < 1)
+	{
+		lpWideCharStr = NULL;
+		cchWideChar = 0;
+	}
+
+	length = unicode_utf8_to_utf16((BYTE*) lpMultiByteStr, cbMultiByte, lpWideCharStr, cchWideChar,
+			(dwFlags & MB_ERR_INVALID_CHARS) ? TRUE : FALSE);
+
+	if (length == UNICODE_INSUFFICIENT_BUFFER)
+	{
+		printf("MultiByteToWideChar: insufficient buffer size %d\n", cchWideChar);
+		return 0;
+	}
+
+	if (length < 0)
+		return 0;
+
+	return length;
+}
+
+/*
+ * Conversion *from* Unicode
+ * WideCharToMultiByte: http://msdn.microsoft.com/en-us/library/windows/desktop/dd374130/
+ */
+
+int WideCharToMultiByte(UINT CodePage, DWORD dwFlags, LPCWSTR lpWideCharStr, int cchWideChar,
+		LPSTR lpMultiByteStr, int cbMultiByte, LPCSTR lpDefaultChar, LPBOOL lpUsedDefaultChar)
+{
+	int length;
+
+	if ((lpWideCharStr == NULL) || (cchWideChar == 0))
+		return 0;
+
+	/* cchWideChar is set to -1 if the string is null-terminated, the terminator is converted as well */
+
+	if (cchWideChar < 0)
+		cchWideChar = lstrlenW(lpWideCharStr) + 1;
+
+	/* if cbMultiByte is set to 0, the function returns the required buffer size */
+
+	if (cbMultiByte < 1)
+	{
+		lpMultiByteStr = NULL;
+		cbMultiByte = 0;
+	}
+
+	length = unicode_utf16_to_utf8(lpWideCharStr, cchWideChar, (BYTE*) lpMultiByteStr, cbMultiByte,
+			(dwFlags & WC_ERR_INVALID_CHARS) ? TRUE : FALSE);
+
+	if (length == UNICODE_INSUFFICIENT_BUFFER)
+	{
+		printf("WideCharToMultiByte: insufficient buffer size %d\n", cbMultiByte);
+		return 0;
+	}
+
+	if (length < 0)
+		return 0;
+
+	return length;
+}
+
+#endif
@@ -290,7 +290,7 @@ void sspi_SetAuthIdentity(SEC_WINNT_AUTH_IDENTITY* identity, char* user, char* d
 	{
 		identity->UserLength = MultiByteToWideChar(CP_UTF8, 0, user, strlen(user), NULL, 0);
 		identity->User = (UINT16*) malloc((identity->UserLength + 1) * sizeof(WCHAR));
-		MultiByteToWideChar(CP_UTF8, 0, user, identity->UserLength, (LPWSTR) identity->User, identity->UserLength * sizeof(WCHAR));
+		MultiByteToWideChar(CP_UTF8, 0, user, strlen(user), (LPWSTR) identity->User, identity->UserLength);
 		identity->User[identity->UserLength] = 0;
 	}
 	else
@@ -303,7 +303,7 @@ void sspi_SetAuthIdentity(SEC_WINNT_AUTH_IDENTITY* identity, char* user, char* d
 	{
 		identity->DomainLength = MultiByteToWideChar(CP_UTF8, 0, domain, strlen(domain), NULL, 0);
 		identity->Domain = (UINT16*) malloc((identity->DomainLength + 1) * sizeof(WCHAR));
-		MultiByteToWideChar(CP_UTF8, 0, domain, identity->DomainLength, (LPWSTR) identity->Domain, identity->DomainLength * sizeof(WCHAR));
+		MultiByteToWideChar(CP_UTF8, 0, domain, strlen(domain), (LPWSTR) identity->Domain, identity->DomainLength);
 		identity->Domain[identity->DomainLength] = 0;
 	}
 	else
@@ -316,7 +316,7 @@ void sspi_SetAuthIdentity(SEC_WINNT_AUTH_IDENTITY* identity, char* user, char* d
 	{
 		identity->PasswordLength = MultiByteToWideChar(CP_UTF8, 0, password, strlen(password), NULL, 0);
 		identity->Password = (UINT16*) malloc((identity->PasswordLength + 1) * sizeof(WCHAR));
-		MultiByteToWideChar(CP_UTF8, 0, password, identity->PasswordLength, (LPWSTR) identity->Password, identity->PasswordLength * sizeof(WCHAR));
+		MultiByteToWideChar(CP_UTF8, 0, password, strlen(password), (LPWSTR) identity->Password, identity->PasswordLength);
 		identity->Password[identity->PasswordLength] = 0;
 	}
 	else